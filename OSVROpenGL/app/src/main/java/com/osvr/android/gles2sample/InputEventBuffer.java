@@ -0,0 +1,85 @@
+/*
+ * Copyright (C) 2015 Sensics, Inc. and contributors.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+package com.osvr.android.gles2sample;
+
+import java.nio.ByteBuffer;
+import java.nio.ByteOrder;
+
+/**
+ * A batch of OSVR button and location2D reports, filled once per frame by
+ * MainActivityJNILib.drainInputEvents(). The backing direct buffer is allocated
+ * once and reused; events are read in place with absolute gets, so reading a
+ * frame's events does not allocate.
+ *
+ * The record layout must match PackedInputEvent in jni/InputEventQueue.h.
+ */
+public class InputEventBuffer {
+
+    public static final int TYPE_BUTTON = 1;
+    public static final int TYPE_LOCATION2D = 2;
+
+    public static final int SOURCE_CENTER = 0;
+    public static final int SOURCE_DOWN = 1;
+    public static final int SOURCE_RIGHT = 2;
+    public static final int SOURCE_LEFT = 3;
+    public static final int SOURCE_UP = 4;
+    public static final int SOURCE_VOLUME_UP = 5;
+    public static final int SOURCE_VOLUME_DOWN = 6;
+    public static final int SOURCE_BACK = 7;
+    public static final int SOURCE_MOUSE = 8;
+
+    public static final int EVENT_SIZE = 40;
+    private static final int OFFSET_TYPE = 0;
+    private static final int OFFSET_SOURCE = 2;
+    private static final int OFFSET_SENSOR = 4;
+    private static final int OFFSET_SECONDS = 8;
+    private static final int OFFSET_MICROSECONDS = 16;
+    private static final int OFFSET_BUTTON_STATE = 20;
+    private static final int OFFSET_X = 24;
+    private static final int OFFSET_Y = 32;
+
+    private final ByteBuffer mBuffer;
+    private int mCount = 0;
+
+    /**
+     * @param maxEvents the maximum number of events delivered per frame. Events
+     *                  that don't fit stay queued natively until the next frame.
+     */
+    public InputEventBuffer(int maxEvents) {
+        mBuffer = ByteBuffer.allocateDirect(maxEvents * EVENT_SIZE).order(ByteOrder.nativeOrder());
+    }
+
+    /**
+     * Replaces the contents of this buffer with the events queued since the last call.
+     * @return the number of events now in the buffer
+     */
+    public int drain() {
+        mCount = MainActivityJNILib.drainInputEvents(mBuffer);
+        return mCount;
+    }
+
+    public int getCount() { return mCount; }
+
+    public int getType(int index) { return mBuffer.getShort(index * EVENT_SIZE + OFFSET_TYPE); }
+    public int getSource(int index) { return mBuffer.getShort(index * EVENT_SIZE + OFFSET_SOURCE); }
+    public int getSensor(int index) { return mBuffer.getInt(index * EVENT_SIZE + OFFSET_SENSOR); }
+    public long getTimestampSeconds(int index) { return mBuffer.getLong(index * EVENT_SIZE + OFFSET_SECONDS); }
+    public int getTimestampMicroseconds(int index) { return mBuffer.getInt(index * EVENT_SIZE + OFFSET_MICROSECONDS); }
+    public int getButtonState(int index) { return mBuffer.getInt(index * EVENT_SIZE + OFFSET_BUTTON_STATE); }
+    public double getX(int index) { return mBuffer.getDouble(index * EVENT_SIZE + OFFSET_X); }
+    public double getY(int index) { return mBuffer.getDouble(index * EVENT_SIZE + OFFSET_Y); }
+}
@@ -29,6 +29,8 @@ import android.util.Log;
 import android.view.KeyEvent;
 import android.view.View;
 
+import java.io.File;
+
 import com.osvr.common.jni.JNIBridge;
 import com.osvr.common.jni.OSVRActivity;
 import com.osvr.common.util.OSVRFileExtractor;
@@ -37,12 +39,173 @@ import com.osvr.common.util.OSVRFileExtractor;
 public class MainActivity extends OSVRActivity {
 
     public static final String TAG = "gles2sample";
+
+    /**
+     * Launch with "--ez com.osvr.android.gles2sample.TRACE true" to record a timeline,
+     * written to files/osvr_trace.json each time the activity pauses.
+     */
+    public static final String EXTRA_TRACE = "com.osvr.android.gles2sample.TRACE";
+
+    /**
+     * Launch with "--ez com.osvr.android.gles2sample.RECORD true" to record the OSVR
+     * reports and head poses to files/osvr_recording.bin, until the activity first pauses.
+     */
+    public static final String EXTRA_RECORD = "com.osvr.android.gles2sample.RECORD";
+
+    /**
+     * Launch with "--es com.osvr.android.gles2sample.REPLAY <path>" to render from a
+     * recording instead of live OSVR data, optionally with
+     * "--ef com.osvr.android.gles2sample.REPLAY_SPEED <rate>" (default 0: one recorded
+     * frame per rendered frame).
+     */
+    public static final String EXTRA_REPLAY = "com.osvr.android.gles2sample.REPLAY";
+    public static final String EXTRA_REPLAY_SPEED = "com.osvr.android.gles2sample.REPLAY_SPEED";
+
+    /**
+     * Launch with "--ez com.osvr.android.gles2sample.LATENCY true" to add motion-to-photon
+     * latency to the frame stats, and "--ez com.osvr.android.gles2sample.LATENCY_PATTERN true"
+     * to also flash a patch in each eye while the head turns.
+     */
+    public static final String EXTRA_LATENCY = "com.osvr.android.gles2sample.LATENCY";
+    public static final String EXTRA_LATENCY_PATTERN = "com.osvr.android.gles2sample.LATENCY_PATTERN";
+
+    /**
+     * Launch with "--ei com.osvr.android.gles2sample.FRAMES_IN_FLIGHT <1-3>" to change how
+     * many frames may be queued on the GPU, and "--ez com.osvr.android.gles2sample.JIT_START true"
+     * to start each frame just in time for the next vsync.
+     */
+    public static final String EXTRA_FRAMES_IN_FLIGHT = "com.osvr.android.gles2sample.FRAMES_IN_FLIGHT";
+    public static final String EXTRA_JIT_START = "com.osvr.android.gles2sample.JIT_START";
+
+    /**
+     * Launch with "--ei com.osvr.android.gles2sample.SCENE_OBJECTS <n>" to surround the room
+     * cube with spinning cubes (n includes the room cube), and
+     * "--ei com.osvr.android.gles2sample.JOB_WORKERS <n>" to pick how many worker threads
+     * besides the GL thread update them (default: one per spare core).
+     */
+    public static final String EXTRA_SCENE_OBJECTS = "com.osvr.android.gles2sample.SCENE_OBJECTS";
+    public static final String EXTRA_JOB_WORKERS = "com.osvr.android.gles2sample.JOB_WORKERS";
+
+    /**
+     * Launch with "--ez com.osvr.android.gles2sample.ASYNC_REPROJECTION true" to render the
+     * app's frames on their own thread and rotate the last one to the newest head pose
+     * whenever a frame is missed, and "--ei com.osvr.android.gles2sample.SLOW_FRAME_MS <ms>"
+     * to make every frame that much slower to try it out.
+     */
+    public static final String EXTRA_ASYNC_REPROJECTION = "com.osvr.android.gles2sample.ASYNC_REPROJECTION";
+    public static final String EXTRA_SLOW_FRAME_MS = "com.osvr.android.gles2sample.SLOW_FRAME_MS";
+
+    /**
+     * Launch with "--ez com.osvr.android.gles2sample.DISTORTION_MESH true" to correct the lens
+     * distortion with a mesh built from the server config's display descriptor (and cached
+     * for later launches) instead of in RenderManager, and
+     * "--ei com.osvr.android.gles2sample.DISTORTION_GRID <n>" for its grid cells per eye
+     * along each axis (default 32; see distortion_mesh_tool for picking one).
+     */
+    public static final String EXTRA_DISTORTION_MESH = "com.osvr.android.gles2sample.DISTORTION_MESH";
+    public static final String EXTRA_DISTORTION_GRID = "com.osvr.android.gles2sample.DISTORTION_GRID";
+    /**
+     * Testing aid: "--es com.osvr.android.gles2sample.SCENE_TEXTURE <path>" textures the
+     * cubes with a KTX texture instead of the camera feed, e.g. "asset:textures/checker" to
+     * load the best of checker.{astc,etc2,etc1}.ktx the GPU supports from the APK.
+     */
+    public static final String EXTRA_SCENE_TEXTURE = "com.osvr.android.gles2sample.SCENE_TEXTURE";
+    /**
+     * Testing aid: "--es com.osvr.android.gles2sample.SCENE_MESH <path>" draws the scene's
+     * objects with a mesh file converted by mesh_tool instead of the built-in cube.
+     */
+    public static final String EXTRA_SCENE_MESH = "com.osvr.android.gles2sample.SCENE_MESH";
+    /**
+     * The thermal governor is on unless launched with
+     * "--ez com.osvr.android.gles2sample.THERMAL_GOVERNOR false";
+     * "--ez com.osvr.android.gles2sample.THERMAL_TRACE true" writes its readings and
+     * decisions to files/thermal_trace.csv for thermal_tool.
+     * "--ei com.osvr.android.gles2sample.EYE_BUFFER_SAMPLES <n>" asks for MSAA eye buffers
+     * (default 1).
+     */
+    public static final String EXTRA_THERMAL_GOVERNOR = "com.osvr.android.gles2sample.THERMAL_GOVERNOR";
+    public static final String EXTRA_THERMAL_TRACE = "com.osvr.android.gles2sample.THERMAL_TRACE";
+    public static final String EXTRA_EYE_BUFFER_SAMPLES = "com.osvr.android.gles2sample.EYE_BUFFER_SAMPLES";
+    /**
+     * Testing aid: "--ei com.osvr.android.gles2sample.CAPTURE_EVERY <n>" writes the eye
+     * buffers of every n-th frame to files/capture, "--ei ...CAPTURE_FRAMES <count>" stops
+     * after that many and "--ez ...CAPTURE_WINDOW true" adds the window.
+     */
+    public static final String EXTRA_CAPTURE_EVERY = "com.osvr.android.gles2sample.CAPTURE_EVERY";
+    public static final String EXTRA_CAPTURE_FRAMES = "com.osvr.android.gles2sample.CAPTURE_FRAMES";
+    public static final String EXTRA_CAPTURE_WINDOW = "com.osvr.android.gles2sample.CAPTURE_WINDOW";
+    /**
+     * Testing aid: "--ei com.osvr.android.gles2sample.GPU_MEMORY_BUDGET_MB <n>" holds the
+     * renderer's GPU memory to n MB, evicting texture mip levels to stay under it.
+     */
+    public static final String EXTRA_GPU_MEMORY_BUDGET_MB = "com.osvr.android.gles2sample.GPU_MEMORY_BUDGET_MB";
+    /**
+     * Testing aid: "--ei com.osvr.android.gles2sample.MATERIALS <n>" gives the spinning cubes
+     * n materials, "--ei ...TEXTURE_BATCHING <0|1|2>" binds them as separate textures, atlas
+     * pages (the default) or a texture array, and "--es ...MATERIAL_ATLAS <path>" takes them
+     * from an atlas file built by atlas_tool.
+     */
+    public static final String EXTRA_MATERIALS = "com.osvr.android.gles2sample.MATERIALS";
+    public static final String EXTRA_TEXTURE_BATCHING = "com.osvr.android.gles2sample.TEXTURE_BATCHING";
+    public static final String EXTRA_MATERIAL_ATLAS = "com.osvr.android.gles2sample.MATERIAL_ATLAS";
     MainActivityView mView;
+    boolean mTracing = false;
+    boolean mRecording = false;
 
     final private int REQUEST_CODE_ASK_PERMISSIONS = 111;
     @Override protected void onCreate(Bundle icicle) {
         Log.i(TAG, "MainActivity: onCreate()");
         super.onCreate(icicle);
+        MainActivityJNILib.setAssetManager(getAssets());
+        mTracing = getIntent().getBooleanExtra(EXTRA_TRACE, false);
+        if (mTracing) {
+            MainActivityJNILib.startTracing();
+        }
+        String replayPath = getIntent().getStringExtra(EXTRA_REPLAY);
+        if (replayPath != null) {
+            MainActivityJNILib.startReplay(replayPath,
+                    getIntent().getFloatExtra(EXTRA_REPLAY_SPEED, 0.0f), true);
+        } else if (getIntent().getBooleanExtra(EXTRA_RECORD, false)) {
+            mRecording = MainActivityJNILib.startRecording(
+                    new File(getFilesDir(), "osvr_recording.bin").getAbsolutePath(), true);
+        }
+        if (getIntent().getBooleanExtra(EXTRA_LATENCY, false)) {
+            MainActivityJNILib.setLatencyMeasurement(true,
+                    getIntent().getBooleanExtra(EXTRA_LATENCY_PATTERN, false));
+        }
+        MainActivityJNILib.setFramePacing(getIntent().getIntExtra(EXTRA_FRAMES_IN_FLIGHT, 2),
+                getIntent().getBooleanExtra(EXTRA_JIT_START, false),
+                getWindowManager().getDefaultDisplay().getRefreshRate());
+        MainActivityJNILib.setSceneConfig(getIntent().getIntExtra(EXTRA_SCENE_OBJECTS, 1),
+                getIntent().getIntExtra(EXTRA_JOB_WORKERS, -1));
+        MainActivityJNILib.setAsyncReprojection(
+                getIntent().getBooleanExtra(EXTRA_ASYNC_REPROJECTION, false));
+        MainActivityJNILib.setSimulatedFrameDelay(getIntent().getIntExtra(EXTRA_SLOW_FRAME_MS, 0), 1);
+        if (getIntent().getBooleanExtra(EXTRA_DISTORTION_MESH, false)) {
+            int grid = getIntent().getIntExtra(EXTRA_DISTORTION_GRID, 32);
+            MainActivityJNILib.setDistortionMesh(
+                    "asset:osvr_server_config.json",
+                    getCacheDir().getAbsolutePath(), grid, grid);
+        }
+        String sceneTexture = getIntent().getStringExtra(EXTRA_SCENE_TEXTURE);
+        if (sceneTexture != null) {
+            MainActivityJNILib.setSceneTexture(sceneTexture);
+        }
+        MainActivityJNILib.setSceneMesh(getIntent().getStringExtra(EXTRA_SCENE_MESH));
+        MainActivityJNILib.setEyeBufferSamples(getIntent().getIntExtra(EXTRA_EYE_BUFFER_SAMPLES, 1));
+        MainActivityJNILib.setThermalGovernor(getIntent().getBooleanExtra(EXTRA_THERMAL_GOVERNOR, true),
+                getIntent().getBooleanExtra(EXTRA_THERMAL_TRACE, false) ?
+                        new File(getFilesDir(), "thermal_trace.csv").getAbsolutePath() : null);
+        int captureEvery = getIntent().getIntExtra(EXTRA_CAPTURE_EVERY, 0);
+        if (captureEvery > 0) {
+            MainActivityJNILib.setFrameCapture(new File(getFilesDir(), "capture").getAbsolutePath(), captureEvery,
+                    getIntent().getIntExtra(EXTRA_CAPTURE_FRAMES, 0),
+                    getIntent().getBooleanExtra(EXTRA_CAPTURE_WINDOW, false));
+        }
+        MainActivityJNILib.setGpuMemoryBudget(getIntent().getIntExtra(EXTRA_GPU_MEMORY_BUDGET_MB, 0));
+        MainActivityJNILib.setSceneMaterials(getIntent().getIntExtra(EXTRA_MATERIALS, 0),
+                getIntent().getIntExtra(EXTRA_TEXTURE_BATCHING, 1),
+                getIntent().getStringExtra(EXTRA_MATERIAL_ATLAS));
         mView = new MainActivityView(getApplication());
         setContentView(mView);
 
@@ -85,6 +248,13 @@ public class MainActivity extends OSVRActivity {
         Log.i(TAG, "MainActivity: onPause()");
         super.onPause();
         mView.onPause();
+        if (mTracing) {
+            MainActivityJNILib.dumpTrace(new File(getFilesDir(), "osvr_trace.json").getAbsolutePath());
+        }
+        if (mRecording) {
+            MainActivityJNILib.stopRecording();
+            mRecording = false;
+        }
     }
 
     @Override protected void onResume() {
@@ -98,4 +268,10 @@ public class MainActivity extends OSVRActivity {
         super.onStop();
         mView.onStop();
     }
+
+    @Override protected void onDestroy() {
+        Log.i(TAG, "MainActivity: onDestroy()");
+        mView.onDestroy();
+        super.onDestroy();
+    }
 }
@@ -19,6 +19,10 @@
 
 package com.osvr.android.gles2sample;
 
+import android.content.res.AssetManager;
+
+import java.nio.ByteBuffer;
+
 import com.osvr.common.jni.JNIBridge;
 
 // Wrapper for native library
@@ -39,5 +43,239 @@ public class MainActivityJNILib {
     public static native void initGraphics(int width, int height);
     public static native void initOSVR();
     public static native void step();
+
+    /**
+     * The activity is pausing. Call on the GL thread, before it pauses; the GL
+     * resources and the OSVR client are kept.
+     */
+    public static native void pause();
+
+    /**
+     * The activity is resuming. The time from here to the first frame is logged
+     * (under the "[Lifecycle]" tag).
+     */
+    public static native void resume();
+
+    /**
+     * Shuts down RenderManager and the OSVR client; the next initGraphics and
+     * initOSVR start over.
+     */
     public static native void stop();
+
+    /**
+     * Copies the button/location2D reports queued since the last call into buffer,
+     * using the record layout described in InputEventBuffer.
+     * @param buffer a direct ByteBuffer in native byte order
+     * @return the number of events written
+     */
+    public static native int drainInputEvents(ByteBuffer buffer);
+
+    /**
+     * Per-stage CPU frame timings since startup (or the last resetFrameStats call).
+     * Call from the GL thread.
+     * @param statsOut receives 4 floats per stage: p50, p90, p99 and max, in milliseconds
+     * @return the number of stages written
+     */
+    public static native int getFrameStats(float[] statsOut);
+    public static native String getFrameStageName(int stage);
+    public static native void resetFrameStats();
+
+    /**
+     * Starts recording a Chrome trace-event timeline of callbacks, frame stages and GPU work.
+     */
+    public static native void startTracing();
+    public static native void stopTracing();
+
+    /**
+     * Writes the buffered timeline as JSON, viewable in chrome://tracing.
+     * @param path the output file, e.g. under Context.getFilesDir()
+     * @return true if the file was written
+     */
+    public static native boolean dumpTrace(String path);
+
+    /**
+     * Records every imaging, button and location2D report plus each frame's head pose
+     * to a file that startReplay can play back. Call while the GL thread is paused or
+     * not yet started.
+     * @param path the output file, e.g. under Context.getFilesDir()
+     * @param compressImages LZ4-compress camera frames, if the native library has LZ4
+     * @return true if the file could be created
+     */
+    public static native boolean startRecording(String path, boolean compressImages);
+    public static native void stopRecording();
+
+    /**
+     * Replays a recording in place of the live OSVR reports and head pose. Call while
+     * the GL thread is paused or not yet started.
+     * @param speed playback rate relative to the recording, or 0 to play exactly one
+     *              recorded frame per rendered frame (deterministic)
+     * @param loop start over at the end of the recording
+     * @return true if the recording could be opened
+     */
+    public static native boolean startReplay(String path, float speed, boolean loop);
+    public static native void stopReplay();
+
+    /**
+     * Measures motion-to-photon latency into the frame stats (the latencySubmit,
+     * latencyGpuDone and motionToPhoton stages).
+     * @param testPattern also draw a patch in each eye that lights up while the head
+     *                    is turning, to check the numbers with a photodiode
+     */
+    public static native void setLatencyMeasurement(boolean enabled, boolean testPattern);
+
+    /**
+     * Caps how many frames the GPU may queue behind the CPU (1-3, default 2), and
+     * optionally delays the start of each frame so the head pose is sampled as late
+     * as possible. Stall and idle times show up as the pacingStall/pacingIdle stages.
+     * @param refreshRateHz display refresh rate, for the just-in-time deadline
+     */
+    public static native void setFramePacing(int maxFramesInFlight, boolean justInTime, float refreshRateHz);
+
+    /**
+     * @return depth in use, frames in flight, last stall (us), last idle (us) and
+     *         predicted CPU work per frame (us)
+     */
+    public static native int[] getFramePacing();
+
+    /**
+     * Sizes the scene and the job system that animates, culls and builds its draw
+     * lists; takes effect when the GL surface is next created. Time spent waiting
+     * for that work shows up as the sceneUpdate stage.
+     * @param objectCount objects including the room cube (default 1, just the room cube)
+     * @param workerThreads job worker threads besides the GL thread, or -1 for one per
+     *                      spare core
+     */
+    public static native void setSceneConfig(int objectCount, int workerThreads);
+
+    /**
+     * Renders the app's frames on a thread of their own and, when one isn't done in
+     * time for the display, shows the last finished frame rotated to the newest head
+     * pose instead. Can be switched at any time; applied at the next frame.
+     */
+    public static native void setAsyncReprojection(boolean enabled);
+
+    /**
+     * @return app frames finished, display frames showing a new app frame and display
+     *         frames showing a reprojected one, since startup
+     */
+    public static native long[] getReprojectionStats();
+
+    /**
+     * Testing aid: makes every everyNFrames-th frame delayMs slower, like a scene
+     * too heavy for the display. 0 turns it off.
+     */
+    public static native void setSimulatedFrameDelay(int delayMs, int everyNFrames);
+
+    /**
+     * Corrects the lens distortion with a precomputed mesh instead of in RenderManager.
+     * The mesh is built from the config's display descriptor and cached in cacheDir under a
+     * hash of it, so later launches just map the file. Call before the view is created.
+     * @param configPath the server config, e.g. "asset:osvr_server_config.json" to map it
+     *                   from the APK (see setAssetManager) without extracting it first
+     * @param cacheDir where the mesh is cached, e.g. Context.getCacheDir()
+     * @param gridWidth mesh cells per eye across (1-255)
+     * @param gridHeight mesh cells per eye down (1-255)
+     */
+    public static native void setDistortionMesh(String configPath, String cacheDir, int gridWidth, int gridHeight);
+
+    /**
+     * Textures the cubes with a KTX texture instead of the camera feed. path names a .ktx
+     * file, or a base path from which the best variant the GPU supports is picked
+     * (path.astc.ktx, path.etc2.ktx or path.etc1.ktx; ktx_tool --write makes test ones).
+     * Paths starting with "asset:" are opened from the APK's assets. Call before the view
+     * is created.
+     * @param path the texture, or null for the camera feed
+     */
+    public static native void setSceneTexture(String path);
+
+    /**
+     * Where the native code opens "asset:" paths from (textures, meshes and the server
+     * config). Assets stored uncompressed in the APK are mapped in place; compressed ones
+     * are inflated into memory. Call before any of the setters that take a path.
+     * @param assets the app's assets, e.g. Context.getAssets()
+     */
+    public static native void setAssetManager(AssetManager assets);
+
+    /**
+     * Draws the scene's objects with a mesh file made by mesh_tool (see OSVROpenGL/host)
+     * instead of the built-in cube. The file is mapped and uploaded as it is; "asset:" paths
+     * are mapped from the APK. Call before the view is created.
+     * @param path the mesh file, or null for the cube
+     */
+    public static native void setSceneMesh(String path);
+
+    /**
+     * Turns the thermal governor on or off: it steps the render scale, eye buffer MSAA,
+     * camera upload rate and scene animation rate down through its quality tiers as the
+     * device heats up or frames run long, ahead of the system's own throttling, and back
+     * up once it has been clear for a while. Reads the sysfs thermal zones; pass the
+     * PowerManager thermal status in with reportThermalStatus where there is one. Call
+     * before the view is created.
+     * @param tracePath where to write each reading and decision as CSV (thermal_tool
+     *                  replays them against the policy), or null
+     */
+    public static native void setThermalGovernor(boolean enabled, String tracePath);
+
+    /**
+     * The system's thermal status, PowerManager.THERMAL_STATUS_* (0 none to 6 shutdown),
+     * e.g. from an OnThermalStatusChangedListener on API 29 and later.
+     */
+    public static native void reportThermalStatus(int status);
+
+    /**
+     * @return quality tier (0 is full quality), steps down, steps up, reason for the last
+     *         change, temperature (C, NaN when unknown), thermal status, frame cost (ms)
+     *         and temperature trend (C/min)
+     */
+    public static native float[] getThermalGovernorStats();
+
+    /**
+     * Draws the eye buffers with this much MSAA (1 for none) where the GPU can resolve it
+     * on-chip; the thermal governor's tiers may cap it lower. Can be changed at any time.
+     */
+    public static native void setEyeBufferSamples(int samples);
+
+    /**
+     * Writes the eye buffers of every everyNFrames-th frame to PNG files in directory
+     * (frame<N>_eye<E>.png), read back a few frames later and written on a thread of their
+     * own so the GL thread never waits for them; images that find every readback slot busy
+     * are dropped. Starts or stops at the next frame.
+     * @param directory where the files go (made if missing), or null to stop
+     * @param frameCount frames to capture, or 0 until stopped
+     * @param window whether to write what went to the window as well
+     */
+    public static native void setFrameCapture(String directory, int everyNFrames, int frameCount, boolean window);
+
+    /**
+     * @return frames captured, images written, images dropped, images that could not be
+     *         written and the GL thread's time spent capturing (us), since startup
+     */
+    public static native long[] getFrameCaptureStats();
+
+    /**
+     * Holds the GPU memory the renderer asks for to a budget: over it, the least recently drawn
+     * textures lose their top mip levels until it fits, and get them back once they are drawn
+     * again and there is room. Applies from the next frame.
+     * @param megabytes the budget, or 0 for none (the default)
+     */
+    public static native void setGpuMemoryBudget(int megabytes);
+
+    /**
+     * @return the budget in effect (0 for none; a GL_OUT_OF_MEMORY lowers it), the bytes tracked
+     *         in all and for textures, render targets and buffers, and the evictions, restores
+     *         and out of memory errors since startup
+     */
+    public static native long[] getGpuMemoryStats();
+
+    /**
+     * Gives the spinning cubes count materials, taken in turn, as small textures of their own.
+     * With batching 1 (atlas) they are packed into atlas pages and with 2 (array) into the
+     * layers of a texture array (ES 3.0; atlas elsewhere), so objects sharing a page need no
+     * bind between them and the cubes' draws are merged; 0 (none) binds a texture per
+     * material. Call before the view is created.
+     * @param count materials, or 0 for none (the default)
+     * @param atlasPath an atlas file made by atlas_tool (see OSVROpenGL/host) to take the
+     *                  materials from, packed as they are with batching 1, or null
+     */
+    public static native void setSceneMaterials(int count, int batching, String atlasPath);
 }
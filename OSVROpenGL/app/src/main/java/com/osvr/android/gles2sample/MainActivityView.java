@@ -94,18 +94,35 @@ class MainActivityView extends GLSurfaceView {// implements Camera.PreviewCallba
         init(translucent, depth, stencil);
     }
 
+    // The OSVR client, RenderManager and (where the device can keep it) the GL
+    // context live until onDestroy, so coming back from a pause or a stop only
+    // rebuilds what was actually lost.
     public void onStop() {
         JNIBridge.onStop();
+    }
+
+    public void onDestroy() {
         MainActivityJNILib.stop();
     }
 
+    @Override
     public void onPause() {
         mPaused = true;
+        // runs on the GL thread before it pauses
+        queueEvent(new Runnable() {
+            public void run() {
+                MainActivityJNILib.pause();
+            }
+        });
+        super.onPause();
         JNIBridge.onPause();
     }
 
+    @Override
     public void onResume() {
         mPaused = false;
+        MainActivityJNILib.resume();
+        super.onResume();
         JNIBridge.onResume();
     }
 
@@ -135,6 +152,11 @@ class MainActivityView extends GLSurfaceView {// implements Camera.PreviewCallba
          */
         setEGLContextFactory(new ContextFactory());
 
+        /* Keep the context (and every GL resource in it) while paused, when
+         * the device can; the native side finds out if it could not.
+         */
+        setPreserveEGLContextOnPause(true);
+
         /* We need to choose an EGLConfig that matches the format of
          * our surface exactly. This is going to be done in our
          * custom config chooser. See ConfigChooser class definition
@@ -370,8 +392,22 @@ class MainActivityView extends GLSurfaceView {// implements Camera.PreviewCallba
     private class Renderer implements GLSurfaceView.Renderer {
         private boolean mProceedWithPermissions = false;
         private boolean mFirstSurfaceChanged = false;
+        private final InputEventBuffer mInputEvents = new InputEventBuffer(64);
         public void onDrawFrame(GL10 gl) {
             MainActivityJNILib.step();
+            onInputEvents(mInputEvents, mInputEvents.drain());
+        }
+
+        private void onInputEvents(InputEventBuffer events, int count) {
+            if (DEBUG) {
+                for (int i = 0; i < count; i++) {
+                    if (events.getType(i) == InputEventBuffer.TYPE_BUTTON) {
+                        Log.d(TAG, "button " + events.getSource(i) + " state " + events.getButtonState(i));
+                    } else {
+                        Log.d(TAG, "location2D x: " + events.getX(i) + " y: " + events.getY(i));
+                    }
+                }
+            }
         }
 
         public void onSurfaceChanged(GL10 gl, int width, int height) {
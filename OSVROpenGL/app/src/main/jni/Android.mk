@@ -17,86 +17,104 @@
 #
 LOCAL_PATH := $(call my-dir)
 
+# OSVR-Android-Build installs one ABI at a time: OSVR_ANDROID_ARM64_V8A,
+# OSVR_ANDROID_ARMEABI_V7A and OSVR_ANDROID_X86_64 point at each ABI's install,
+# and an ABI without one uses OSVR_ANDROID.
+OSVR_ANDROID_ABI_VARIABLE_arm64-v8a := OSVR_ANDROID_ARM64_V8A
+OSVR_ANDROID_ABI_VARIABLE_armeabi-v7a := OSVR_ANDROID_ARMEABI_V7A
+OSVR_ANDROID_ABI_VARIABLE_x86_64 := OSVR_ANDROID_X86_64
+OSVR_ANDROID_ABI := $($(OSVR_ANDROID_ABI_VARIABLE_$(TARGET_ARCH_ABI)))
+ifeq ($(OSVR_ANDROID_ABI),)
+OSVR_ANDROID_ABI := $(OSVR_ANDROID)
+endif
+
 include $(CLEAR_VARS)
 LOCAL_MODULE := usb1.0
-LOCAL_SRC_FILES := ${OSVR_ANDROID}\lib\libusb1.0.so
+LOCAL_SRC_FILES := ${OSVR_ANDROID_ABI}\lib\libusb1.0.so
 include $(PREBUILT_SHARED_LIBRARY)
 
 include $(CLEAR_VARS)
 LOCAL_MODULE := osvrClient
-LOCAL_SRC_FILES := ${OSVR_ANDROID}\lib\libosvrClient.so
+LOCAL_SRC_FILES := ${OSVR_ANDROID_ABI}\lib\libosvrClient.so
 include $(PREBUILT_SHARED_LIBRARY)
 
 include $(CLEAR_VARS)
 LOCAL_MODULE := osvrClientKit
-LOCAL_SRC_FILES := ${OSVR_ANDROID}\lib\libosvrClientKit.so
+LOCAL_SRC_FILES := ${OSVR_ANDROID_ABI}\lib\libosvrClientKit.so
 include $(PREBUILT_SHARED_LIBRARY)
 
 include $(CLEAR_VARS)
 LOCAL_MODULE := osvrCommon
-LOCAL_SRC_FILES := ${OSVR_ANDROID}\lib\libosvrCommon.so
+LOCAL_SRC_FILES := ${OSVR_ANDROID_ABI}\lib\libosvrCommon.so
 include $(PREBUILT_SHARED_LIBRARY)
 
 include $(CLEAR_VARS)
 LOCAL_MODULE := osvrUtil
-LOCAL_SRC_FILES := ${OSVR_ANDROID}\lib\libosvrUtil.so
+LOCAL_SRC_FILES := ${OSVR_ANDROID_ABI}\lib\libosvrUtil.so
 include $(PREBUILT_SHARED_LIBRARY)
 
 include $(CLEAR_VARS)
 LOCAL_MODULE := jsoncpp
-LOCAL_SRC_FILES := ${OSVR_ANDROID}\lib\libjsoncpp.so
+LOCAL_SRC_FILES := ${OSVR_ANDROID_ABI}\lib\libjsoncpp.so
 include $(PREBUILT_SHARED_LIBRARY)
 
 include $(CLEAR_VARS)
 LOCAL_MODULE := functionality
-LOCAL_SRC_FILES := ${OSVR_ANDROID}\lib\libfunctionality.so
+LOCAL_SRC_FILES := ${OSVR_ANDROID_ABI}\lib\libfunctionality.so
 include $(PREBUILT_SHARED_LIBRARY)
 
 include $(CLEAR_VARS)
 LOCAL_MODULE := osvrJointClientKit
-LOCAL_SRC_FILES := ${OSVR_ANDROID}\lib\libosvrJointClientKit.so
+LOCAL_SRC_FILES := ${OSVR_ANDROID_ABI}\lib\libosvrJointClientKit.so
 include $(PREBUILT_SHARED_LIBRARY)
 
 include $(CLEAR_VARS)
 LOCAL_MODULE := osvrServer
-LOCAL_SRC_FILES := ${OSVR_ANDROID}\lib\libosvrServer.so
+LOCAL_SRC_FILES := ${OSVR_ANDROID_ABI}\lib\libosvrServer.so
 include $(PREBUILT_SHARED_LIBRARY)
 
 include $(CLEAR_VARS)
 LOCAL_MODULE := osvrConnection
-LOCAL_SRC_FILES := ${OSVR_ANDROID}\lib\libosvrConnection.so
+LOCAL_SRC_FILES := ${OSVR_ANDROID_ABI}\lib\libosvrConnection.so
 include $(PREBUILT_SHARED_LIBRARY)
 
 include $(CLEAR_VARS)
 LOCAL_MODULE := osvrPluginKit
-LOCAL_SRC_FILES := ${OSVR_ANDROID}\lib\libosvrPluginKit.so
+LOCAL_SRC_FILES := ${OSVR_ANDROID_ABI}\lib\libosvrPluginKit.so
 include $(PREBUILT_SHARED_LIBRARY)
 
 include $(CLEAR_VARS)
 LOCAL_MODULE := osvrPluginHost
-LOCAL_SRC_FILES := ${OSVR_ANDROID}\lib\libosvrPluginHost.so
+LOCAL_SRC_FILES := ${OSVR_ANDROID_ABI}\lib\libosvrPluginHost.so
 include $(PREBUILT_SHARED_LIBRARY)
 
 include $(CLEAR_VARS)
 LOCAL_MODULE := osvrVRPNServer
-LOCAL_SRC_FILES := ${OSVR_ANDROID}\lib\libosvrVRPNServer.so
+LOCAL_SRC_FILES := ${OSVR_ANDROID_ABI}\lib\libosvrVRPNServer.so
 include $(PREBUILT_SHARED_LIBRARY)
 
 include $(CLEAR_VARS)
 LOCAL_MODULE := com_osvr_android_jniImaging
-LOCAL_SRC_FILES := ${OSVR_ANDROID}\lib\osvr-plugins-0\libcom_osvr_android_jniImaging.so
+LOCAL_SRC_FILES := ${OSVR_ANDROID_ABI}\lib\osvr-plugins-0\libcom_osvr_android_jniImaging.so
 include $(PREBUILT_SHARED_LIBRARY)
 
 include $(CLEAR_VARS)
 LOCAL_MODULE := com_osvr_android_sensorTracker
-LOCAL_SRC_FILES := ${OSVR_ANDROID}\lib\osvr-plugins-0\libcom_osvr_android_sensorTracker.so
+LOCAL_SRC_FILES := ${OSVR_ANDROID_ABI}\lib\osvr-plugins-0\libcom_osvr_android_sensorTracker.so
 include $(PREBUILT_SHARED_LIBRARY)
 
 include $(CLEAR_VARS)
 
 LOCAL_MODULE    := native-activity
-LOCAL_SRC_FILES := main.cpp
-LOCAL_CFLAGS    := -I${OSVR_ANDROID}\include
+LOCAL_SRC_FILES := main.cpp Renderer.cpp FrameStats.cpp GpuProfiler.cpp Trace.cpp Recording.cpp LatencyMonitor.cpp EGLFence.cpp FramePacer.cpp JobSystem.cpp Scene.cpp Reprojection.cpp DistortionMesh.cpp CompressedTexture.cpp SceneMesh.cpp Lifecycle.cpp Asset.cpp Layers.cpp ExternalImage.cpp CpuDispatch.cpp CpuKernelsX86.cpp ThermalGovernor.cpp FrameCapture.cpp GpuMemory.cpp TextureAtlas.cpp Materials.cpp
+# only the NEON kernels may use NEON on armeabi-v7a (see CpuDispatch.h)
+ifeq ($(TARGET_ARCH_ABI),armeabi-v7a)
+LOCAL_ARM_NEON := false
+LOCAL_SRC_FILES += CpuKernelsNeon.cpp.neon
+else
+LOCAL_SRC_FILES += CpuKernelsNeon.cpp
+endif
+LOCAL_CFLAGS    := -I${OSVR_ANDROID_ABI}\include
 LOCAL_LDLIBS    := -llog -landroid -lEGL -lGLESv2
 LOCAL_STATIC_LIBRARIES := android_native_app_glue boost_serialization_static
 LOCAL_SHARED_LIBRARIES := osvrClient osvrClientKit functionality osvrCommon osvrUtil osvrServer osvrJointClientKit osvrConnection osvrPluginKit osvrPluginHost osvrVRPNServer usb1.0 gnustl_shared jsoncpp
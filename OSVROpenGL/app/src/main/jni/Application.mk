@@ -1,3 +1,5 @@
-APP_ABI := armeabi-v7a
-APP_PLATFORM := android-10
+# armeabi-v7a is built for CPUs without NEON; CpuDispatch.cpp picks the NEON
+# kernels at run time where there is. The 64-bit ABIs need android-21.
+APP_ABI := arm64-v8a armeabi-v7a x86_64
+APP_PLATFORM := android-21
 APP_STL := gnustl_shared
\ No newline at end of file
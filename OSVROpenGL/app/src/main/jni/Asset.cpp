@@ -0,0 +1,156 @@
+/*
+ * Copyright (C) 2015 Sensics, Inc. and contributors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include <cstring>
+#include <string>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#ifdef __ANDROID__
+#include <android/asset_manager.h>
+#endif
+
+#include "Logging.h"
+#include "Asset.h"
+
+namespace OSVROpenGL {
+
+    static const char kAssetPrefix[] = "asset:";
+    static const size_t kAssetPrefixLength = sizeof(kAssetPrefix) - 1;
+
+    static std::string gAssetDirectory;
+#ifdef __ANDROID__
+    static AAssetManager *gAssetManager = nullptr;
+#endif
+
+    bool isAssetPath(const char *path) {
+        return path && strncmp(path, kAssetPrefix, kAssetPrefixLength) == 0;
+    }
+
+    void setAssetManager(void *assetManager) {
+#ifdef __ANDROID__
+        gAssetManager = static_cast<AAssetManager *>(assetManager);
+#endif
+    }
+
+    void setAssetDirectory(const char *directory) {
+        gAssetDirectory = directory ? directory : "";
+    }
+
+    // Maps bytes of fd from offset, which need not be page aligned.
+    static bool mapRange(int fd, off_t offset, size_t bytes, MappedAsset *assetOut) {
+        off_t pageSize = static_cast<off_t>(sysconf(_SC_PAGESIZE));
+        off_t mappingOffset = offset - offset % pageSize;
+        size_t lead = static_cast<size_t>(offset - mappingOffset);
+        void *mapping = mmap(nullptr, bytes + lead, PROT_READ, MAP_PRIVATE, fd, mappingOffset);
+        if (mapping == MAP_FAILED) {
+            return false;
+        }
+        assetOut->mapping = mapping;
+        assetOut->mappingBytes = bytes + lead;
+        assetOut->data = static_cast<const uint8_t *>(mapping) + lead;
+        assetOut->bytes = bytes;
+        return true;
+    }
+
+    static bool mapFile(const char *path, MappedAsset *assetOut) {
+        int fd = open(path, O_RDONLY);
+        if (fd < 0) {
+            return false;
+        }
+        struct stat status;
+        bool ok = fstat(fd, &status) == 0 && status.st_size > 0 &&
+                  mapRange(fd, 0, static_cast<size_t>(status.st_size), assetOut);
+        close(fd);
+        return ok;
+    }
+
+#ifdef __ANDROID__
+    static bool mapApkAsset(const char *name, MappedAsset *assetOut) {
+        AAsset *asset = AAssetManager_open(gAssetManager, name, AASSET_MODE_RANDOM);
+        if (!asset) {
+            return false;
+        }
+        off_t start = 0;
+        off_t length = 0;
+        int fd = AAsset_openFileDescriptor(asset, &start, &length);
+        if (fd >= 0) {
+            bool ok = length > 0 && mapRange(fd, start, static_cast<size_t>(length), assetOut);
+            close(fd);
+            AAsset_close(asset);
+            return ok;
+        }
+
+        // compressed in the APK: the asset manager inflates it
+        const void *buffer = AAsset_getBuffer(asset);
+        off_t bytes = AAsset_getLength(asset);
+        if (!buffer || bytes <= 0) {
+            AAsset_close(asset);
+            return false;
+        }
+        LOGI("[Asset] %s is compressed in the APK; inflated %ld bytes.", name, static_cast<long>(bytes));
+        assetOut->asset = asset;
+        assetOut->data = static_cast<const uint8_t *>(buffer);
+        assetOut->bytes = static_cast<size_t>(bytes);
+        return true;
+    }
+#endif
+
+    bool mapAsset(const char *path, MappedAsset *assetOut) {
+        memset(assetOut, 0, sizeof(*assetOut));
+        if (!path) {
+            return false;
+        }
+        if (!isAssetPath(path)) {
+            return mapFile(path, assetOut);
+        }
+        const char *name = path + kAssetPrefixLength;
+#ifdef __ANDROID__
+        if (gAssetManager) {
+            return mapApkAsset(name, assetOut);
+        }
+#endif
+        if (gAssetDirectory.empty()) {
+            return false;
+        }
+        return mapFile((gAssetDirectory + "/" + name).c_str(), assetOut);
+    }
+
+    void unmapAsset(MappedAsset *asset) {
+        if (asset->mapping) {
+            munmap(asset->mapping, asset->mappingBytes);
+        }
+#ifdef __ANDROID__
+        if (asset->asset) {
+            AAsset_close(static_cast<AAsset *>(asset->asset));
+        }
+#endif
+        memset(asset, 0, sizeof(*asset));
+    }
+
+    uint64_t hashAssetContents(const void *data, size_t bytes) {
+        const unsigned char *p = static_cast<const unsigned char *>(data);
+        uint64_t hash = 14695981039346656037ull;
+        for (size_t i = 0; i < bytes; i++) {
+            hash = (hash ^ p[i]) * 1099511628211ull;
+        }
+        return hash;
+    }
+}
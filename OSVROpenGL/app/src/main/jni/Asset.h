@@ -0,0 +1,60 @@
+/*
+ * Copyright (C) 2015 Sensics, Inc. and contributors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef OSVROPENGL_ASSET_H
+#define OSVROPENGL_ASSET_H
+
+#include <cstddef>
+#include <cstdint>
+
+namespace OSVROpenGL {
+
+    // Read-only access to the app's data files without copying them out of
+    // the APK first. Paths starting with "asset:" name an asset: on Android it
+    // is opened through the AAssetManager and, if it is stored uncompressed
+    // (see noCompress in build.gradle), mapped straight from the APK through
+    // the asset's file descriptor; a compressed one is inflated into memory by
+    // the asset manager instead. Elsewhere (the host build) assets are files
+    // under the asset directory. Any other path is a file, mapped with mmap.
+
+    // A mapped file or asset. Valid until unmapAsset().
+    struct MappedAsset {
+        const uint8_t *data;
+        size_t bytes;
+        void *mapping;          // the whole pages mapped, when mapped
+        size_t mappingBytes;
+        void *asset;            // the AAsset *, when inflated
+    };
+
+    bool isAssetPath(const char *path);
+
+    // False if there is no such file or asset (not logged: callers often
+    // try several) or it is empty.
+    bool mapAsset(const char *path, MappedAsset *assetOut);
+    void unmapAsset(MappedAsset *asset);
+
+    // Where "asset:" paths are opened from on Android; an AAssetManager *.
+    void setAssetManager(void *assetManager);
+    // Where "asset:" paths are opened from elsewhere; on Android, only when
+    // there is no asset manager.
+    void setAssetDirectory(const char *directory);
+
+    // FNV-1a over the bytes, for telling file contents apart.
+    uint64_t hashAssetContents(const void *data, size_t bytes);
+}
+
+#endif // OSVROPENGL_ASSET_H
@@ -0,0 +1,695 @@
+/*
+ * Copyright (C) 2015 Sensics, Inc. and contributors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include <algorithm>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "Logging.h"
+#include "CompressedTexture.h"
+#include "Asset.h"
+#include "GLExtensions.h"
+#include "GpuMemory.h"
+
+namespace OSVROpenGL {
+
+    static const uint8_t kKtxIdentifier[12] = { 0xAB, 'K', 'T', 'X', ' ', '1', '1', 0xBB, '\r', '\n', 0x1A, '\n' };
+    static const uint32_t kKtxEndianness = 0x04030201;
+    static const uint32_t kKtxEndiannessSwapped = 0x01020304;
+    static const size_t kKtxHeaderBytes = 64;
+
+    static const CompressedFormatInfo gCompressedFormats[] = {
+            { GL_ETC1_RGB8_OES, "ETC1", 4, 4, 8, false },
+            { GL_COMPRESSED_RGB8_ETC2, "ETC2 RGB8", 4, 4, 8, false },
+            { GL_COMPRESSED_RGBA8_ETC2_EAC, "ETC2 RGBA8", 4, 4, 16, true },
+            { 0x93B0, "ASTC 4x4", 4, 4, 16, true },
+            { 0x93B1, "ASTC 5x4", 5, 4, 16, true },
+            { 0x93B2, "ASTC 5x5", 5, 5, 16, true },
+            { 0x93B3, "ASTC 6x5", 6, 5, 16, true },
+            { 0x93B4, "ASTC 6x6", 6, 6, 16, true },
+            { 0x93B5, "ASTC 8x5", 8, 5, 16, true },
+            { 0x93B6, "ASTC 8x6", 8, 6, 16, true },
+            { 0x93B7, "ASTC 8x8", 8, 8, 16, true },
+            { 0x93B8, "ASTC 10x5", 10, 5, 16, true },
+            { 0x93B9, "ASTC 10x6", 10, 6, 16, true },
+            { 0x93BA, "ASTC 10x8", 10, 8, 16, true },
+            { 0x93BB, "ASTC 10x10", 10, 10, 16, true },
+            { 0x93BC, "ASTC 12x10", 12, 10, 16, true },
+            { 0x93BD, "ASTC 12x12", 12, 12, 16, true },
+    };
+    static const size_t kCompressedFormatCount = sizeof(gCompressedFormats) / sizeof(gCompressedFormats[0]);
+
+    // set by initCompressedTextures(), in gCompressedFormats order
+    static bool gFormatSupported[kCompressedFormatCount];
+
+    struct LoadedTexture {
+        GLuint texture;
+        size_t gpuBytes;
+        size_t rgbaBytes;
+        // what GpuMemory needs to re-specify it from another first level
+        const CompressedFormatInfo *format;
+        GLenum uploadFormat;    // 0 when decoded
+        uint32_t width;
+        uint32_t height;
+        uint32_t levelCount;
+        uint32_t droppedLevels;
+    };
+    // GpuMemory re-specifies textures on the thread that draws with them
+    static std::mutex gLoadedTexturesMutex;
+    static std::vector<LoadedTexture> gLoadedTextures;
+
+    const CompressedFormatInfo *findCompressedFormat(GLenum glInternalFormat) {
+        for (size_t i = 0; i < kCompressedFormatCount; i++) {
+            if (gCompressedFormats[i].glInternalFormat == glInternalFormat) {
+                return &gCompressedFormats[i];
+            }
+        }
+        return nullptr;
+    }
+
+    size_t compressedImageBytes(const CompressedFormatInfo &format, uint32_t width, uint32_t height) {
+        size_t blocksAcross = (width + format.blockWidth - 1) / format.blockWidth;
+        size_t blocksDown = (height + format.blockHeight - 1) / format.blockHeight;
+        return blocksAcross * blocksDown * format.blockBytes;
+    }
+
+    static uint32_t readUint32(const uint8_t *p, bool swapped) {
+        uint32_t value;
+        memcpy(&value, p, sizeof(value));
+        return swapped ? __builtin_bswap32(value) : value;
+    }
+
+    bool parseKtx(const void *data, size_t bytes, KtxImage *imageOut) {
+        memset(imageOut, 0, sizeof(*imageOut));
+        const uint8_t *file = static_cast<const uint8_t *>(data);
+        if (bytes < kKtxHeaderBytes || memcmp(file, kKtxIdentifier, sizeof(kKtxIdentifier)) != 0) {
+            LOGE("[Texture] Not a KTX 1.1 file.");
+            return false;
+        }
+        uint32_t endianness;
+        memcpy(&endianness, file + 12, sizeof(endianness));
+        if (endianness != kKtxEndianness && endianness != kKtxEndiannessSwapped) {
+            LOGE("[Texture] Bad KTX endianness 0x%08x.", endianness);
+            return false;
+        }
+        bool swapped = endianness == kKtxEndiannessSwapped;
+        uint32_t header[12];
+        for (int i = 0; i < 12; i++) {
+            header[i] = readUint32(file + 16 + 4 * i, swapped);
+        }
+        uint32_t glType = header[0];
+        uint32_t glFormat = header[2];
+        uint32_t glInternalFormat = header[3];
+        uint32_t width = header[5];
+        uint32_t height = header[6];
+        uint32_t depth = header[7];
+        uint32_t arrayElements = header[8];
+        uint32_t faces = header[9];
+        uint32_t levelCount = header[10] ? header[10] : 1;
+        uint32_t keyValueBytes = header[11];
+
+        const CompressedFormatInfo *format = findCompressedFormat(glInternalFormat);
+        if (glType != 0 || glFormat != 0 || !format) {
+            LOGE("[Texture] KTX internal format 0x%04x is not a supported compressed format.", glInternalFormat);
+            return false;
+        }
+        if (width == 0 || height == 0 || depth != 0 || arrayElements != 0 || faces != 1) {
+            LOGE("[Texture] Only 2D KTX textures are supported (%ux%ux%u, %u elements, %u faces).",
+                 width, height, depth, arrayElements, faces);
+            return false;
+        }
+        uint32_t fullChain = 1;
+        for (uint32_t size = width > height ? width : height; size > 1; size >>= 1) {
+            fullChain++;
+        }
+        if (levelCount != 1 && levelCount != fullChain) {
+            LOGE("[Texture] %ux%u KTX has %u mip levels; needs 1 or %u.", width, height, levelCount, fullChain);
+            return false;
+        }
+        if (levelCount > kKtxMaxLevels) {
+            LOGE("[Texture] KTX has more than %u mip levels.", kKtxMaxLevels);
+            return false;
+        }
+
+        size_t offset = kKtxHeaderBytes + keyValueBytes;
+        for (uint32_t level = 0; level < levelCount; level++) {
+            uint32_t levelWidth = width >> level ? width >> level : 1;
+            uint32_t levelHeight = height >> level ? height >> level : 1;
+            if (offset + 4 > bytes || offset < kKtxHeaderBytes) {
+                LOGE("[Texture] KTX ends before mip level %u.", level);
+                return false;
+            }
+            uint32_t imageSize = readUint32(file + offset, swapped);
+            offset += 4;
+            if (imageSize != compressedImageBytes(*format, levelWidth, levelHeight)) {
+                LOGE("[Texture] KTX mip level %u (%ux%u) holds %u bytes; %s needs %zu.", level, levelWidth,
+                     levelHeight, imageSize, format->name, compressedImageBytes(*format, levelWidth, levelHeight));
+                return false;
+            }
+            if (imageSize > bytes - offset) {
+                LOGE("[Texture] KTX ends inside mip level %u.", level);
+                return false;
+            }
+            KtxLevel &levelOut = imageOut->levels[level];
+            levelOut.data = file + offset;
+            levelOut.bytes = imageSize;
+            levelOut.width = levelWidth;
+            levelOut.height = levelHeight;
+            offset += (imageSize + 3) & ~3u;
+        }
+        imageOut->format = format;
+        imageOut->width = width;
+        imageOut->height = height;
+        imageOut->levelCount = levelCount;
+        return true;
+    }
+
+    void initCompressedTextures() {
+        memset(gFormatSupported, 0, sizeof(gFormatSupported));
+        GLint formatCount = 0;
+        glGetIntegerv(GL_NUM_COMPRESSED_TEXTURE_FORMATS, &formatCount);
+        std::vector<GLint> formats(formatCount > 0 ? formatCount : 0);
+        if (formatCount > 0) {
+            glGetIntegerv(GL_COMPRESSED_TEXTURE_FORMATS, formats.data());
+        }
+        bool etc1 = hasGLExtension("GL_OES_compressed_ETC1_RGB8_texture");
+        bool astc = hasGLExtension("GL_KHR_texture_compression_astc_ldr");
+        for (size_t i = 0; i < kCompressedFormatCount; i++) {
+            GLenum glInternalFormat = gCompressedFormats[i].glInternalFormat;
+            bool listed = false;
+            for (size_t j = 0; j < formats.size(); j++) {
+                listed = listed || static_cast<GLenum>(formats[j]) == glInternalFormat;
+            }
+            bool isAstc = glInternalFormat >= GL_COMPRESSED_RGBA_ASTC_4x4_KHR &&
+                          glInternalFormat <= GL_COMPRESSED_RGBA_ASTC_12x12_KHR;
+            gFormatSupported[i] = listed || (glInternalFormat == GL_ETC1_RGB8_OES && etc1) || (isAstc && astc);
+        }
+        LOGI("[Texture] Compressed formats: ETC1 %s, ETC2 %s, ASTC %s.",
+             isCompressedFormatSupported(GL_ETC1_RGB8_OES) ? "yes" : "no",
+             isCompressedFormatSupported(GL_COMPRESSED_RGB8_ETC2) ? "yes" : "no",
+             isCompressedFormatSupported(GL_COMPRESSED_RGBA_ASTC_4x4_KHR) ? "yes" : "no");
+    }
+
+    bool isCompressedFormatSupported(GLenum glInternalFormat) {
+        const CompressedFormatInfo *format = findCompressedFormat(glInternalFormat);
+        return format && gFormatSupported[format - gCompressedFormats];
+    }
+
+    bool canDecodeCompressedFormat(GLenum glInternalFormat) {
+        return glInternalFormat == GL_ETC1_RGB8_OES || glInternalFormat == GL_COMPRESSED_RGB8_ETC2 ||
+               glInternalFormat == GL_COMPRESSED_RGBA8_ETC2_EAC;
+    }
+
+    // ETC1/ETC2 decoding, per the GLES 3.0 spec's appendix C.
+
+    static const int gEtcModifiers[8][2] = {
+            { 2, 8 }, { 5, 17 }, { 9, 29 }, { 13, 42 }, { 18, 60 }, { 24, 80 }, { 33, 106 }, { 47, 183 } };
+    static const int gEtcDistances[8] = { 3, 6, 11, 16, 23, 32, 41, 64 };
+    static const int gEacModifiers[16][8] = {
+            { -3, -6, -9, -15, 2, 5, 8, 14 }, { -3, -7, -10, -13, 2, 6, 9, 12 },
+            { -2, -5, -8, -13, 1, 4, 7, 12 }, { -2, -4, -6, -13, 1, 3, 5, 12 },
+            { -3, -6, -8, -12, 2, 5, 7, 11 }, { -3, -7, -9, -11, 2, 6, 8, 10 },
+            { -4, -7, -8, -11, 3, 6, 7, 10 }, { -3, -5, -8, -11, 2, 4, 7, 10 },
+            { -2, -6, -8, -10, 1, 5, 7, 9 }, { -2, -5, -8, -10, 1, 4, 7, 9 },
+            { -2, -4, -8, -10, 1, 3, 7, 9 }, { -2, -5, -7, -10, 1, 4, 6, 9 },
+            { -3, -4, -7, -10, 2, 3, 6, 9 }, { -1, -2, -3, -10, 0, 1, 2, 9 },
+            { -4, -6, -8, -9, 3, 5, 7, 8 }, { -3, -5, -7, -9, 2, 4, 6, 8 } };
+
+    static inline int clampByte(int value) {
+        return value < 0 ? 0 : (value > 255 ? 255 : value);
+    }
+
+    static inline int extend4(uint32_t value) { return static_cast<int>((value << 4) | value); }
+    static inline int extend5(uint32_t value) { return static_cast<int>((value << 3) | (value >> 2)); }
+    static inline int extend6(uint32_t value) { return static_cast<int>((value << 2) | (value >> 4)); }
+    static inline int extend7(uint32_t value) { return static_cast<int>((value << 1) | (value >> 6)); }
+
+    static inline uint32_t readBigEndian32(const uint8_t *p) {
+        return (static_cast<uint32_t>(p[0]) << 24) | (static_cast<uint32_t>(p[1]) << 16) |
+               (static_cast<uint32_t>(p[2]) << 8) | p[3];
+    }
+
+    // A texel's 2 bit index; texels are numbered down the columns.
+    static inline uint32_t etcTexelIndex(uint32_t low, int x, int y) {
+        int i = x * 4 + y;
+        return (((low >> (i + 16)) & 1) << 1) | ((low >> i) & 1);
+    }
+
+    // The T and H modes: each texel picks one of four paint colors.
+    static void decodeEtcPaintColors(uint32_t low, const int paint[4][3], uint8_t *texels) {
+        for (int y = 0; y < 4; y++) {
+            for (int x = 0; x < 4; x++) {
+                const int *color = paint[etcTexelIndex(low, x, y)];
+                uint8_t *texel = texels + (y * 4 + x) * 4;
+                texel[0] = static_cast<uint8_t>(clampByte(color[0]));
+                texel[1] = static_cast<uint8_t>(clampByte(color[1]));
+                texel[2] = static_cast<uint8_t>(clampByte(color[2]));
+            }
+        }
+    }
+
+    static void decodeEtcTMode(uint32_t high, uint32_t low, uint8_t *texels) {
+        int c1[3] = { extend4((((high >> 27) & 3) << 2) | ((high >> 24) & 3)),
+                      extend4((high >> 20) & 15), extend4((high >> 16) & 15) };
+        int c2[3] = { extend4((high >> 12) & 15), extend4((high >> 8) & 15), extend4((high >> 4) & 15) };
+        int d = gEtcDistances[(((high >> 2) & 3) << 1) | (high & 1)];
+        const int paint[4][3] = {
+                { c1[0], c1[1], c1[2] },
+                { c2[0] + d, c2[1] + d, c2[2] + d },
+                { c2[0], c2[1], c2[2] },
+                { c2[0] - d, c2[1] - d, c2[2] - d } };
+        decodeEtcPaintColors(low, paint, texels);
+    }
+
+    static void decodeEtcHMode(uint32_t high, uint32_t low, uint8_t *texels) {
+        uint32_t r1 = (high >> 27) & 15;
+        uint32_t g1 = (((high >> 24) & 7) << 1) | ((high >> 20) & 1);
+        uint32_t b1 = (((high >> 19) & 1) << 3) | ((high >> 15) & 7);
+        uint32_t r2 = (high >> 11) & 15;
+        uint32_t g2 = (high >> 7) & 15;
+        uint32_t b2 = (high >> 3) & 15;
+        uint32_t ordering = ((r1 << 8) | (g1 << 4) | b1) >= ((r2 << 8) | (g2 << 4) | b2) ? 1 : 0;
+        int d = gEtcDistances[(((high >> 2) & 1) << 2) | ((high & 1) << 1) | ordering];
+        int c1[3] = { extend4(r1), extend4(g1), extend4(b1) };
+        int c2[3] = { extend4(r2), extend4(g2), extend4(b2) };
+        const int paint[4][3] = {
+                { c1[0] + d, c1[1] + d, c1[2] + d },
+                { c1[0] - d, c1[1] - d, c1[2] - d },
+                { c2[0] + d, c2[1] + d, c2[2] + d },
+                { c2[0] - d, c2[1] - d, c2[2] - d } };
+        decodeEtcPaintColors(low, paint, texels);
+    }
+
+    static void decodeEtcPlanarMode(uint32_t high, uint32_t low, uint8_t *texels) {
+        int origin[3] = { extend6((high >> 25) & 63),
+                          extend7((((high >> 24) & 1) << 6) | ((high >> 17) & 63)),
+                          extend6((((high >> 16) & 1) << 5) | (((high >> 11) & 3) << 3) | ((high >> 7) & 7)) };
+        int horizontal[3] = { extend6((((high >> 2) & 31) << 1) | (high & 1)),
+                              extend7((low >> 25) & 127), extend6((low >> 19) & 63) };
+        int vertical[3] = { extend6((low >> 13) & 63), extend7((low >> 6) & 127), extend6(low & 63) };
+        for (int y = 0; y < 4; y++) {
+            for (int x = 0; x < 4; x++) {
+                uint8_t *texel = texels + (y * 4 + x) * 4;
+                for (int c = 0; c < 3; c++) {
+                    int value = x * (horizontal[c] - origin[c]) + y * (vertical[c] - origin[c]) + 4 * origin[c] + 2;
+                    texel[c] = static_cast<uint8_t>(clampByte(value >> 2));
+                }
+            }
+        }
+    }
+
+    // An 8 byte ETC1/ETC2 color block into 4x4 RGBA texels (alpha untouched).
+    static void decodeEtcColorBlock(const uint8_t *block, bool etc2, uint8_t *texels) {
+        uint32_t high = readBigEndian32(block);
+        uint32_t low = readBigEndian32(block + 4);
+        bool differential = (high & 2) != 0;
+        bool flipped = (high & 1) != 0;
+        int base[2][3];
+        if (!differential) {
+            base[0][0] = extend4((high >> 28) & 15);
+            base[1][0] = extend4((high >> 24) & 15);
+            base[0][1] = extend4((high >> 20) & 15);
+            base[1][1] = extend4((high >> 16) & 15);
+            base[0][2] = extend4((high >> 12) & 15);
+            base[1][2] = extend4((high >> 8) & 15);
+        } else {
+            int first[3] = { static_cast<int>((high >> 27) & 31), static_cast<int>((high >> 19) & 31),
+                             static_cast<int>((high >> 11) & 31) };
+            int second[3];
+            for (int c = 0; c < 3; c++) {
+                int delta = static_cast<int>((high >> (24 - 8 * c)) & 7);
+                second[c] = first[c] + (delta >= 4 ? delta - 8 : delta);
+            }
+            // ETC2 reuses the encodings whose second color overflows
+            if (etc2 && (second[0] < 0 || second[0] > 31)) {
+                decodeEtcTMode(high, low, texels);
+                return;
+            }
+            if (etc2 && (second[1] < 0 || second[1] > 31)) {
+                decodeEtcHMode(high, low, texels);
+                return;
+            }
+            if (etc2 && (second[2] < 0 || second[2] > 31)) {
+                decodeEtcPlanarMode(high, low, texels);
+                return;
+            }
+            for (int c = 0; c < 3; c++) {
+                base[0][c] = extend5(static_cast<uint32_t>(first[c]));
+                base[1][c] = extend5(static_cast<uint32_t>(second[c]) & 31);
+            }
+        }
+        const int *modifiers[2] = { gEtcModifiers[(high >> 5) & 7], gEtcModifiers[(high >> 2) & 7] };
+        for (int y = 0; y < 4; y++) {
+            for (int x = 0; x < 4; x++) {
+                int subblock = flipped ? (y >= 2) : (x >= 2);
+                uint32_t index = etcTexelIndex(low, x, y);
+                int modifier = modifiers[subblock][index & 1] * ((index & 2) ? -1 : 1);
+                uint8_t *texel = texels + (y * 4 + x) * 4;
+                for (int c = 0; c < 3; c++) {
+                    texel[c] = static_cast<uint8_t>(clampByte(base[subblock][c] + modifier));
+                }
+            }
+        }
+    }
+
+    // An 8 byte EAC block into the 4x4 texels' alpha.
+    static void decodeEacAlphaBlock(const uint8_t *block, uint8_t *texels) {
+        int base = block[0];
+        int multiplier = block[1] >> 4;
+        const int *modifiers = gEacModifiers[block[1] & 15];
+        uint64_t indices = 0;
+        for (int i = 2; i < 8; i++) {
+            indices = (indices << 8) | block[i];
+        }
+        for (int y = 0; y < 4; y++) {
+            for (int x = 0; x < 4; x++) {
+                int i = x * 4 + y;
+                int index = static_cast<int>((indices >> (45 - 3 * i)) & 7);
+                texels[(y * 4 + x) * 4 + 3] = static_cast<uint8_t>(clampByte(base + modifiers[index] * multiplier));
+            }
+        }
+    }
+
+    bool decodeCompressedImage(const CompressedFormatInfo &format, const uint8_t *data,
+                               uint32_t width, uint32_t height, uint8_t *rgbaOut) {
+        if (!canDecodeCompressedFormat(format.glInternalFormat)) {
+            return false;
+        }
+        bool etc2 = format.glInternalFormat != GL_ETC1_RGB8_OES;
+        bool alpha = format.glInternalFormat == GL_COMPRESSED_RGBA8_ETC2_EAC;
+        uint8_t texels[16 * 4];
+        for (uint32_t blockY = 0; blockY < height; blockY += 4) {
+            for (uint32_t blockX = 0; blockX < width; blockX += 4, data += format.blockBytes) {
+                memset(texels, 0xFF, sizeof(texels));
+                if (alpha) {
+                    decodeEacAlphaBlock(data, texels);
+                    decodeEtcColorBlock(data + 8, etc2, texels);
+                } else {
+                    decodeEtcColorBlock(data, etc2, texels);
+                }
+                // edge blocks hang over the image
+                uint32_t columns = width - blockX < 4 ? width - blockX : 4;
+                uint32_t rows = height - blockY < 4 ? height - blockY : 4;
+                for (uint32_t y = 0; y < rows; y++) {
+                    memcpy(rgbaOut + ((blockY + y) * width + blockX) * 4, texels + y * 16, columns * 4);
+                }
+            }
+        }
+        return true;
+    }
+
+    static size_t rgbaChainBytes(const KtxImage &image) {
+        size_t bytes = 0;
+        for (uint32_t level = 0; level < image.levelCount; level++) {
+            bytes += static_cast<size_t>(image.levels[level].width) * image.levels[level].height * 4;
+        }
+        return bytes;
+    }
+
+    static GLuint createSampledTexture(uint32_t levelCount) {
+        GLuint texture;
+        glGenTextures(1, &texture);
+        glBindTexture(GL_TEXTURE_2D, texture);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, levelCount > 1 ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        return texture;
+    }
+
+    // What the context takes the format's data as, or 0 if it doesn't.
+    static GLenum compressedUploadFormat(GLenum glInternalFormat) {
+        if (isCompressedFormatSupported(glInternalFormat)) {
+            return glInternalFormat;
+        }
+        // ETC2 decoders read ETC1 data as it is
+        if (glInternalFormat == GL_ETC1_RGB8_OES && isCompressedFormatSupported(GL_COMPRESSED_RGB8_ETC2)) {
+            return GL_COMPRESSED_RGB8_ETC2;
+        }
+        return 0;
+    }
+
+    // The levels as they are, or 0 if the driver won't take them.
+    static GLuint uploadCompressed(const KtxImage &image) {
+        GLenum uploadFormat = compressedUploadFormat(image.format->glInternalFormat);
+        if (!uploadFormat) {
+            return 0;
+        }
+        while (glGetError() != GL_NO_ERROR) {
+        }
+        GLuint texture = createSampledTexture(image.levelCount);
+        for (uint32_t level = 0; level < image.levelCount; level++) {
+            const KtxLevel &ktxLevel = image.levels[level];
+            glCompressedTexImage2D(GL_TEXTURE_2D, static_cast<GLint>(level), uploadFormat,
+                                   static_cast<GLsizei>(ktxLevel.width), static_cast<GLsizei>(ktxLevel.height), 0,
+                                   static_cast<GLsizei>(ktxLevel.bytes), ktxLevel.data);
+        }
+        GLenum error = glGetError();
+        if (error != GL_NO_ERROR) {
+            LOGE("[Texture] glCompressedTexImage2D failed for %s (error 0x%x).", image.format->name, error);
+            glDeleteTextures(1, &texture);
+            return 0;
+        }
+        return texture;
+    }
+
+    static GLuint uploadDecoded(const KtxImage &image) {
+        GLuint texture = createSampledTexture(image.levelCount);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+        std::vector<uint8_t> rgba(static_cast<size_t>(image.width) * image.height * 4);
+        for (uint32_t level = 0; level < image.levelCount; level++) {
+            const KtxLevel &ktxLevel = image.levels[level];
+            decodeCompressedImage(*image.format, ktxLevel.data, ktxLevel.width, ktxLevel.height, rgba.data());
+            glTexImage2D(GL_TEXTURE_2D, static_cast<GLint>(level), GL_RGBA, static_cast<GLsizei>(ktxLevel.width),
+                         static_cast<GLsizei>(ktxLevel.height), 0, GL_RGBA, GL_UNSIGNED_BYTE, rgba.data());
+        }
+        return texture;
+    }
+
+    static size_t levelBytes(const LoadedTexture &texture, uint32_t level) {
+        uint32_t width = std::max(1u, texture.width >> level);
+        uint32_t height = std::max(1u, texture.height >> level);
+        return texture.uploadFormat ? compressedImageBytes(*texture.format, width, height)
+                                    : static_cast<size_t>(width) * height * 4;
+    }
+
+    // GpuMemory's loader: the file's levels from firstLevel on, as they are
+    // uploaded (so decoded to RGBA if the context can't sample the format).
+    static bool stageTextureLevels(const std::string &path, uint32_t firstLevel, std::vector<uint8_t> *staged) {
+        MappedAsset file;
+        if (!mapAsset(path.c_str(), &file)) {
+            return false;
+        }
+        KtxImage image;
+        bool ok = parseKtx(file.data, file.bytes, &image) && firstLevel < image.levelCount;
+        if (ok) {
+            bool decode = !compressedUploadFormat(image.format->glInternalFormat);
+            size_t bytes = 0;
+            for (uint32_t level = firstLevel; level < image.levelCount; level++) {
+                const KtxLevel &ktxLevel = image.levels[level];
+                bytes += decode ? static_cast<size_t>(ktxLevel.width) * ktxLevel.height * 4 : ktxLevel.bytes;
+            }
+            staged->resize(bytes);
+            uint8_t *out = staged->data();
+            for (uint32_t level = firstLevel; level < image.levelCount && ok; level++) {
+                const KtxLevel &ktxLevel = image.levels[level];
+                if (decode) {
+                    ok = decodeCompressedImage(*image.format, ktxLevel.data, ktxLevel.width, ktxLevel.height, out);
+                    out += static_cast<size_t>(ktxLevel.width) * ktxLevel.height * 4;
+                } else {
+                    memcpy(out, ktxLevel.data, ktxLevel.bytes);
+                    out += ktxLevel.bytes;
+                }
+            }
+        }
+        unmapAsset(&file);
+        return ok;
+    }
+
+    // GpuMemory's upload: staged becomes the texture's chain from level 0.
+    // The levels past the shorter chain's 1x1 one (after dropping levels) are
+    // left as they were; sampling ignores them.
+    static uint64_t uploadTextureLevels(GLuint texture, uint32_t firstLevel, const std::vector<uint8_t> &staged) {
+        std::lock_guard<std::mutex> lock(gLoadedTexturesMutex);
+        LoadedTexture *loaded = nullptr;
+        for (size_t i = 0; i < gLoadedTextures.size() && !loaded; i++) {
+            if (gLoadedTextures[i].texture == texture) {
+                loaded = &gLoadedTextures[i];
+            }
+        }
+        if (!loaded || firstLevel >= loaded->levelCount) {
+            return 0;
+        }
+        size_t bytes = 0;
+        for (uint32_t level = firstLevel; level < loaded->levelCount; level++) {
+            bytes += levelBytes(*loaded, level);
+        }
+        if (bytes != staged.size()) {
+            LOGE("[Texture] Staged levels of texture %u are %zu bytes, not %zu.", texture, staged.size(), bytes);
+            return 0;
+        }
+
+        while (glGetError() != GL_NO_ERROR) {
+        }
+        glBindTexture(GL_TEXTURE_2D, texture);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+        const uint8_t *data = staged.data();
+        for (uint32_t level = firstLevel; level < loaded->levelCount; level++) {
+            GLsizei width = static_cast<GLsizei>(std::max(1u, loaded->width >> level));
+            GLsizei height = static_cast<GLsizei>(std::max(1u, loaded->height >> level));
+            GLint target = static_cast<GLint>(level - firstLevel);
+            size_t size = levelBytes(*loaded, level);
+            if (loaded->uploadFormat) {
+                glCompressedTexImage2D(GL_TEXTURE_2D, target, loaded->uploadFormat, width, height, 0,
+                                       static_cast<GLsizei>(size), data);
+            } else {
+                glTexImage2D(GL_TEXTURE_2D, target, GL_RGBA, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, data);
+            }
+            data += size;
+        }
+        glBindTexture(GL_TEXTURE_2D, 0);
+        GLenum error = glGetError();
+        if (error != GL_NO_ERROR) {
+            LOGE("[Texture] Re-specifying texture %u from level %u failed (error 0x%x).", texture, firstLevel, error);
+            if (error == GL_OUT_OF_MEMORY) {
+                noteGpuOutOfMemory();
+            }
+            return 0;
+        }
+        loaded->gpuBytes = bytes;
+        loaded->droppedLevels = firstLevel;
+        return bytes;
+    }
+
+    GLuint loadCompressedTexture(const char *path, CompressedTextureInfo *infoOut) {
+        memset(infoOut, 0, sizeof(*infoOut));
+        // best first
+        std::vector<std::string> candidates;
+        std::string base(path);
+        if (base.size() > 4 && base.compare(base.size() - 4, 4, ".ktx") == 0) {
+            candidates.push_back(base);
+        } else {
+            candidates.push_back(base + ".astc.ktx");
+            candidates.push_back(base + ".etc2.ktx");
+            candidates.push_back(base + ".etc1.ktx");
+        }
+
+        GLuint texture = 0;
+        int decodable = -1;
+        size_t loadedCandidate = 0;
+        const CompressedFormatInfo *format = nullptr;
+        for (size_t i = 0; i < candidates.size() && !texture; i++) {
+            MappedAsset file;
+            if (!mapAsset(candidates[i].c_str(), &file)) {
+                continue;
+            }
+            KtxImage image;
+            if (parseKtx(file.data, file.bytes, &image)) {
+                texture = uploadCompressed(image);
+                if (texture) {
+                    infoOut->gpuBytes = 0;
+                    for (uint32_t level = 0; level < image.levelCount; level++) {
+                        infoOut->gpuBytes += image.levels[level].bytes;
+                    }
+                } else if (decodable < 0 && canDecodeCompressedFormat(image.format->glInternalFormat)) {
+                    decodable = static_cast<int>(i);
+                }
+                if (texture || decodable == static_cast<int>(i)) {
+                    loadedCandidate = i;
+                    format = image.format;
+                    infoOut->format = image.format->name;
+                    infoOut->width = image.width;
+                    infoOut->height = image.height;
+                    infoOut->levelCount = image.levelCount;
+                    infoOut->rgbaBytes = rgbaChainBytes(image);
+                }
+            } else {
+                LOGE("[Texture] Skipping %s.", candidates[i].c_str());
+            }
+            unmapAsset(&file);
+        }
+
+        if (!texture && decodable >= 0) {
+            MappedAsset file;
+            KtxImage image;
+            if (mapAsset(candidates[decodable].c_str(), &file)) {
+                if (parseKtx(file.data, file.bytes, &image)) {
+                    texture = uploadDecoded(image);
+                    loadedCandidate = static_cast<size_t>(decodable);
+                    format = image.format;
+                    infoOut->decoded = true;
+                    infoOut->gpuBytes = infoOut->rgbaBytes;
+                }
+                unmapAsset(&file);
+            }
+        }
+        if (!texture) {
+            LOGE("[Texture] Could not load a texture from %s.", path);
+            memset(infoOut, 0, sizeof(*infoOut));
+            return 0;
+        }
+
+        LoadedTexture loaded = { texture, infoOut->gpuBytes, infoOut->rgbaBytes, format,
+                                 infoOut->decoded ? 0 : compressedUploadFormat(format->glInternalFormat),
+                                 infoOut->width, infoOut->height, infoOut->levelCount, 0 };
+        {
+            std::lock_guard<std::mutex> lock(gLoadedTexturesMutex);
+            gLoadedTextures.push_back(loaded);
+        }
+        trackGpuObject(GPU_OBJECT_TEXTURE, texture, GPU_MEMORY_TEXTURES, infoOut->gpuBytes);
+        makeGpuTextureEvictable(texture, candidates[loadedCandidate].c_str(), infoOut->levelCount,
+                                stageTextureLevels, uploadTextureLevels);
+        LOGI("[Texture] Loaded %s: %s%s, %ux%u, %u levels, %zu KB (%zu KB as RGBA).", path, infoOut->format,
+             infoOut->decoded ? " decoded to RGBA" : "", infoOut->width, infoOut->height, infoOut->levelCount,
+             infoOut->gpuBytes / 1024, infoOut->rgbaBytes / 1024);
+        return texture;
+    }
+
+    void deleteCompressedTexture(GLuint texture) {
+        {
+            std::lock_guard<std::mutex> lock(gLoadedTexturesMutex);
+            for (size_t i = 0; i < gLoadedTextures.size(); i++) {
+                if (gLoadedTextures[i].texture == texture) {
+                    gLoadedTextures.erase(gLoadedTextures.begin() + i);
+                    break;
+                }
+            }
+        }
+        forgetGpuObject(GPU_OBJECT_TEXTURE, texture);
+        glDeleteTextures(1, &texture);
+    }
+
+    void getTextureMemoryStats(TextureMemoryStats *statsOut) {
+        std::lock_guard<std::mutex> lock(gLoadedTexturesMutex);
+        statsOut->textureCount = static_cast<uint32_t>(gLoadedTextures.size());
+        statsOut->gpuBytes = 0;
+        statsOut->rgbaBytes = 0;
+        statsOut->droppedLevels = 0;
+        for (size_t i = 0; i < gLoadedTextures.size(); i++) {
+            statsOut->gpuBytes += gLoadedTextures[i].gpuBytes;
+            statsOut->rgbaBytes += gLoadedTextures[i].rgbaBytes;
+            statsOut->droppedLevels += gLoadedTextures[i].droppedLevels;
+        }
+    }
+
+    void resetTextureMemoryStats() {
+        std::lock_guard<std::mutex> lock(gLoadedTexturesMutex);
+        gLoadedTextures.clear();
+    }
+}
@@ -0,0 +1,143 @@
+/*
+ * Copyright (C) 2015 Sensics, Inc. and contributors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef OSVROPENGL_COMPRESSEDTEXTURE_H
+#define OSVROPENGL_COMPRESSEDTEXTURE_H
+
+#include <cstddef>
+#include <cstdint>
+
+#include <GLES2/gl2.h>
+#include <GLES2/gl2ext.h>
+
+// ETC2 is core in GLES 3 and so missing from the GLES 2 headers; the others
+// are missing from some NDK platforms' gl2ext.h.
+#ifndef GL_ETC1_RGB8_OES
+#define GL_ETC1_RGB8_OES 0x8D64
+#endif
+#ifndef GL_COMPRESSED_RGB8_ETC2
+#define GL_COMPRESSED_RGB8_ETC2 0x9274
+#endif
+#ifndef GL_COMPRESSED_RGBA8_ETC2_EAC
+#define GL_COMPRESSED_RGBA8_ETC2_EAC 0x9278
+#endif
+#ifndef GL_COMPRESSED_RGBA_ASTC_4x4_KHR
+#define GL_COMPRESSED_RGBA_ASTC_4x4_KHR 0x93B0
+#endif
+#ifndef GL_COMPRESSED_RGBA_ASTC_12x12_KHR
+#define GL_COMPRESSED_RGBA_ASTC_12x12_KHR 0x93BD
+#endif
+
+namespace OSVROpenGL {
+
+    // Block-compressed textures from KTX 1.1 containers, with the whole mip
+    // chain in the file:
+    //
+    //   12 byte identifier, 13 uint32_t header fields (see parseKtx())
+    //   bytesOfKeyValueData bytes of key/value pairs (skipped)
+    //   per mip level: uint32_t imageSize, imageSize bytes, padding to 4 bytes
+    //
+    // The file is mapped and its levels uploaded straight from the mapping.
+    // Given a base path, loadCompressedTexture() picks the variant the GPU can
+    // sample from (ASTC, then ETC2, then ETC1), and if there is none, decodes
+    // an ETC1/ETC2 variant to RGBA on the CPU instead.
+
+    static const uint32_t kKtxMaxLevels = 16;
+
+    struct CompressedFormatInfo {
+        GLenum glInternalFormat;
+        const char *name;
+        uint32_t blockWidth;
+        uint32_t blockHeight;
+        uint32_t blockBytes;
+        bool hasAlpha;
+    };
+
+    struct KtxLevel {
+        const uint8_t *data;
+        uint32_t bytes;
+        uint32_t width;
+        uint32_t height;
+    };
+
+    struct KtxImage {
+        const CompressedFormatInfo *format;
+        uint32_t width;
+        uint32_t height;
+        uint32_t levelCount;
+        KtxLevel levels[kKtxMaxLevels];
+    };
+
+    // The format's block layout, or null if it's not one supported here.
+    const CompressedFormatInfo *findCompressedFormat(GLenum glInternalFormat);
+
+    // Bytes the format takes for a width x height image.
+    size_t compressedImageBytes(const CompressedFormatInfo &format, uint32_t width, uint32_t height);
+
+    // Checks the header and every level of a KTX file held in memory and
+    // points imageOut's levels into it. A file must have either one level or
+    // the full chain down to 1x1 (GLES 2 samples nothing else with mipmaps),
+    // each exactly the size its dimensions call for. False (and logged) on
+    // anything else.
+    bool parseKtx(const void *data, size_t bytes, KtxImage *imageOut);
+
+    // Which formats the current context samples from: GL_EXTENSIONS, and
+    // GL_COMPRESSED_TEXTURE_FORMATS for the ones core in the context's version.
+    // GL thread only; call again after the context changes.
+    void initCompressedTextures();
+    bool isCompressedFormatSupported(GLenum glInternalFormat);
+
+    // ETC1 and ETC2 (RGB8 and RGBA8 EAC) can be decoded on the CPU; ASTC can't.
+    bool canDecodeCompressedFormat(GLenum glInternalFormat);
+    // Decodes one level into width * height * 4 bytes of RGBA.
+    bool decodeCompressedImage(const CompressedFormatInfo &format, const uint8_t *data,
+                               uint32_t width, uint32_t height, uint8_t *rgbaOut);
+
+    struct CompressedTextureInfo {
+        const char *format;     // the file's format's name
+        bool decoded;           // uploaded as RGBA decoded on the CPU
+        uint32_t width;
+        uint32_t height;
+        uint32_t levelCount;
+        size_t gpuBytes;        // as uploaded
+        size_t rgbaBytes;       // the same levels as RGBA
+    };
+
+    // Loads path if it names a .ktx file, or else the best of path.astc.ktx,
+    // path.etc2.ktx and path.etc1.ktx. Paths starting with "asset:" are
+    // opened from the APK (see Asset.h). Returns the texture,
+    // or 0 (logged) if no variant could be loaded. GL thread only.
+    GLuint loadCompressedTexture(const char *path, CompressedTextureInfo *infoOut);
+    void deleteCompressedTexture(GLuint texture);
+
+    // Texture memory of everything loadCompressedTexture() has loaded and not
+    // deleted, against what it would take as RGBA. Textures with a mip chain
+    // are made evictable (see GpuMemory.h): over the budget they lose their
+    // top levels, which gpuBytes leaves out, until there is room again.
+    struct TextureMemoryStats {
+        uint32_t textureCount;
+        uint64_t gpuBytes;
+        uint64_t rgbaBytes;     // the full chains
+        uint32_t droppedLevels; // now, over every texture
+    };
+
+    void getTextureMemoryStats(TextureMemoryStats *statsOut);
+    // Forgets every texture; for when the context they were in is gone.
+    void resetTextureMemoryStats();
+}
+
+#endif // OSVROPENGL_COMPRESSEDTEXTURE_H
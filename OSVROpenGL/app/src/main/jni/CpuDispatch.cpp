@@ -0,0 +1,251 @@
+/*
+ * Copyright (C) 2015 Sensics, Inc. and contributors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include <atomic>
+#include <cmath>
+#include <cstring>
+
+#if defined(__arm__) && defined(__linux__)
+#include <sys/auxv.h>
+#endif
+
+#include "CpuDispatch.h"
+#include "Logging.h"
+
+#if defined(__arm__) && !defined(HWCAP_NEON)
+#define HWCAP_NEON (1 << 12)
+#endif
+
+namespace OSVROpenGL {
+
+    static std::atomic<const CpuKernels *> gKernels(nullptr);
+    static std::atomic<int> gLevel(CPU_KERNELS_SCALAR);
+
+    static void sinCos(float angle, float *sinOut, float *cosOut) {
+        bool negative = std::signbit(angle);
+        float x = std::fabs(angle);
+        int32_t octant = static_cast<int32_t>(x * kSinCosFourOverPi);
+        octant = (octant + 1) & ~1;
+        float y = static_cast<float>(octant);
+        x = ((x - y * kSinCosPiOver4Part1) - y * kSinCosPiOver4Part2) - y * kSinCosPiOver4Part3;
+
+        float z = x * x;
+        float c = ((kCosCoefficients[0] * z + kCosCoefficients[1]) * z + kCosCoefficients[2]) * z * z -
+                  0.5f * z + 1.0f;
+        float s = ((kSinCoefficients[0] * z + kSinCoefficients[1]) * z + kSinCoefficients[2]) * z * x + x;
+
+        bool swap = (octant & 2) != 0;
+        float sine = swap ? c : s;
+        float cosine = swap ? s : c;
+        if (((octant & 4) != 0) != negative) {
+            sine = -sine;
+        }
+        if (((octant - 2) & 4) == 0) {
+            cosine = -cosine;
+        }
+        *sinOut = sine;
+        *cosOut = cosine;
+    }
+
+    void animateSpinningObjectsScalar(const SpinningObject *objects, uint32_t count, float timeSeconds,
+                                      float *modelsOut, BoundingSphere *boundsOut) {
+        for (uint32_t i = 0; i < count; i++) {
+            const SpinningObject &object = objects[i];
+            float s, c;
+            sinCos(object.angularSpeed * timeSeconds, &s, &c);
+            float t = 1.0f - c;
+            float x = object.axis[0];
+            float y = object.axis[1];
+            float z = object.axis[2];
+            float tx = t * x;
+            float ty = t * y;
+            float tz = t * z;
+            float scale = object.scale;
+
+            float *m = modelsOut + i * 16;
+            m[0] = (tx * x + c) * scale;
+            m[1] = (tx * y + s * z) * scale;
+            m[2] = (tx * z - s * y) * scale;
+            m[3] = 0.0f;
+            m[4] = (tx * y - s * z) * scale;
+            m[5] = (ty * y + c) * scale;
+            m[6] = (ty * z + s * x) * scale;
+            m[7] = 0.0f;
+            m[8] = (tx * z + s * y) * scale;
+            m[9] = (ty * z - s * x) * scale;
+            m[10] = (tz * z + c) * scale;
+            m[11] = 0.0f;
+            m[12] = object.position[0];
+            m[13] = object.position[1];
+            m[14] = object.position[2];
+            m[15] = 1.0f;
+
+            BoundingSphere &bounds = boundsOut[i];
+            bounds.center[0] = object.position[0];
+            bounds.center[1] = object.position[1];
+            bounds.center[2] = object.position[2];
+            bounds.radius = scale * kCubeBoundingRadius;
+        }
+    }
+
+    void cullSpheresScalar(const BoundingSphere *spheres, uint32_t count, const float (*planes)[6][4],
+                           uint32_t viewCount, uint8_t *visibilityOut, uint32_t *viewCountsInOut) {
+        for (uint32_t i = 0; i < count; i++) {
+            const BoundingSphere &sphere = spheres[i];
+            uint8_t visibility = 0;
+            for (uint32_t view = 0; view < viewCount; view++) {
+                bool inside = true;
+                for (int plane = 0; plane < 6 && inside; plane++) {
+                    const float *p = planes[view][plane];
+                    inside = p[0] * sphere.center[0] + p[1] * sphere.center[1] +
+                             p[2] * sphere.center[2] + p[3] >= -sphere.radius;
+                }
+                if (inside) {
+                    visibility |= static_cast<uint8_t>(1u << view);
+                    viewCountsInOut[view]++;
+                }
+            }
+            visibilityOut[i] = visibility;
+        }
+    }
+
+    void expandToRGBAScalar(const uint8_t *pixels, uint32_t pixelCount, uint32_t channels, uint8_t *rgbaOut) {
+        switch (channels) {
+        case 1:
+            for (uint32_t i = 0; i < pixelCount; i++) {
+                uint8_t grey = pixels[i];
+                rgbaOut[i * 4 + 0] = grey;
+                rgbaOut[i * 4 + 1] = grey;
+                rgbaOut[i * 4 + 2] = grey;
+                rgbaOut[i * 4 + 3] = 255;
+            }
+            break;
+        case 3:
+            for (uint32_t i = 0; i < pixelCount; i++) {
+                rgbaOut[i * 4 + 0] = pixels[i * 3 + 0];
+                rgbaOut[i * 4 + 1] = pixels[i * 3 + 1];
+                rgbaOut[i * 4 + 2] = pixels[i * 3 + 2];
+                rgbaOut[i * 4 + 3] = 255;
+            }
+            break;
+        case 4:
+            memcpy(rgbaOut, pixels, static_cast<size_t>(pixelCount) * 4);
+            break;
+        }
+    }
+
+    static const CpuKernels kScalarKernels = {
+        animateSpinningObjectsScalar,
+        cullSpheresScalar,
+        expandToRGBAScalar
+    };
+
+    static bool cpuCanRun(CpuKernelLevel level) {
+        switch (level) {
+        case CPU_KERNELS_SCALAR:
+            return true;
+        case CPU_KERNELS_NEON:
+#if defined(__aarch64__)
+            return true;
+#elif defined(__arm__) && defined(__linux__)
+            return (getauxval(AT_HWCAP) & HWCAP_NEON) != 0;
+#else
+            return false;
+#endif
+        case CPU_KERNELS_SSE41:
+        case CPU_KERNELS_AVX2:
+#if defined(__x86_64__) || defined(__i386__)
+            __builtin_cpu_init();
+            return level == CPU_KERNELS_SSE41 ? __builtin_cpu_supports("sse4.1") != 0
+                                              : __builtin_cpu_supports("avx2") != 0;
+#else
+            return false;
+#endif
+        default:
+            return false;
+        }
+    }
+
+    static const CpuKernels *levelKernels(CpuKernelLevel level) {
+        switch (level) {
+        case CPU_KERNELS_SCALAR:
+            return &kScalarKernels;
+        case CPU_KERNELS_NEON:
+            return neonCpuKernels();
+        case CPU_KERNELS_SSE41:
+            return sse41CpuKernels();
+        case CPU_KERNELS_AVX2:
+            return avx2CpuKernels();
+        default:
+            return nullptr;
+        }
+    }
+
+    bool cpuKernelLevelSupported(CpuKernelLevel level) {
+        return levelKernels(level) && cpuCanRun(level);
+    }
+
+    const CpuKernels &cpuKernels() {
+        const CpuKernels *kernels = gKernels.load(std::memory_order_acquire);
+        if (kernels) {
+            return *kernels;
+        }
+        // the first caller picks; any racing one picks the same
+        int level = CPU_KERNEL_LEVEL_COUNT - 1;
+        while (!cpuKernelLevelSupported(static_cast<CpuKernelLevel>(level))) {
+            level--;
+        }
+        kernels = levelKernels(static_cast<CpuKernelLevel>(level));
+        const CpuKernels *expected = nullptr;
+        if (gKernels.compare_exchange_strong(expected, kernels, std::memory_order_acq_rel)) {
+            gLevel.store(level, std::memory_order_relaxed);
+            LOGI("[CpuDispatch] Using the %s kernels", cpuKernelLevelName(static_cast<CpuKernelLevel>(level)));
+            return *kernels;
+        }
+        return *expected;
+    }
+
+    CpuKernelLevel cpuKernelLevel() {
+        cpuKernels();
+        return static_cast<CpuKernelLevel>(gLevel.load(std::memory_order_relaxed));
+    }
+
+    const char *cpuKernelLevelName(CpuKernelLevel level) {
+        switch (level) {
+        case CPU_KERNELS_SCALAR:
+            return "scalar";
+        case CPU_KERNELS_NEON:
+            return "neon";
+        case CPU_KERNELS_SSE41:
+            return "sse4.1";
+        case CPU_KERNELS_AVX2:
+            return "avx2";
+        default:
+            return "unknown";
+        }
+    }
+
+    bool setCpuKernelLevel(CpuKernelLevel level) {
+        if (!cpuKernelLevelSupported(level)) {
+            LOGE("[CpuDispatch] The %s kernels aren't supported here", cpuKernelLevelName(level));
+            return false;
+        }
+        gLevel.store(level, std::memory_order_relaxed);
+        gKernels.store(levelKernels(level), std::memory_order_release);
+        return true;
+    }
+}
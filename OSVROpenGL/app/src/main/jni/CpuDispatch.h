@@ -0,0 +1,108 @@
+/*
+ * Copyright (C) 2015 Sensics, Inc. and contributors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef OSVROPENGL_CPUDISPATCH_H
+#define OSVROPENGL_CPUDISPATCH_H
+
+#include <cstdint>
+
+namespace OSVROpenGL {
+
+    // The native kernels with SIMD variants: the scene's animation math and
+    // culling, and camera pixel conversion. One library is built per ABI for
+    // that ABI's baseline (armeabi-v7a without NEON); the variants the CPU can
+    // run are found at startup and the best one goes in a table of function
+    // pointers that callers go through.
+    //
+    // Every variant gives the scalar one's results: exactly for the pixels,
+    // and up to floating point rounding (some compilers fuse a multiply-add
+    // the SIMD code doesn't) for the math.
+
+    enum CpuKernelLevel {
+        CPU_KERNELS_SCALAR,
+        CPU_KERNELS_NEON,       // armeabi-v7a with NEON, arm64-v8a
+        CPU_KERNELS_SSE41,      // x86_64 (every Android x86_64 CPU has it)
+        CPU_KERNELS_AVX2,
+        CPU_KERNEL_LEVEL_COUNT
+    };
+
+    // A cube spinning about an axis through its center, of half-size scale.
+    struct SpinningObject {
+        float position[3];
+        float scale;
+        float axis[3];          // unit length
+        float angularSpeed;     // rad/s
+    };
+
+    struct BoundingSphere {
+        float center[3];
+        float radius;
+    };
+
+    struct CpuKernels {
+        // Each object's model matrix at timeSeconds (translate * rotate *
+        // scale, column-major, 16 floats apart) and its bounding sphere.
+        void (*animateSpinningObjects)(const SpinningObject *objects, uint32_t count, float timeSeconds,
+                                       float *modelsOut, BoundingSphere *boundsOut);
+        // Sets bit v of each sphere's visibility if it is on the inner side of
+        // view v's six normalized planes (a, b, c, d with ax + by + cz + d the
+        // signed distance), and adds the spheres each view got to its count.
+        void (*cullSpheres)(const BoundingSphere *spheres, uint32_t count, const float (*planes)[6][4],
+                            uint32_t viewCount, uint8_t *visibilityOut, uint32_t *viewCountsInOut);
+        // 1 (grey), 3 (RGB) or 4 channel 8-bit pixels to RGBA, opaque.
+        void (*expandToRGBA)(const uint8_t *pixels, uint32_t pixelCount, uint32_t channels, uint8_t *rgbaOut);
+    };
+
+    // The kernels of the level in use: the best the CPU supports, unless
+    // setCpuKernelLevel() picked another.
+    const CpuKernels &cpuKernels();
+    CpuKernelLevel cpuKernelLevel();
+    const char *cpuKernelLevelName(CpuKernelLevel level);
+
+    // Whether this build has the level and the CPU can run it.
+    bool cpuKernelLevelSupported(CpuKernelLevel level);
+    // Switches levels, for benchmarks and checking the variants against each
+    // other; false if the level isn't supported. Not while any kernel runs.
+    bool setCpuKernelLevel(CpuKernelLevel level);
+
+    // For the per-architecture kernel files: the scalar kernels (their tails
+    // are left to these), and each file's table, null when it isn't built for
+    // this architecture.
+    //
+    // sin and cos as every variant evaluates them (Cephes' sinf/cosf): the
+    // angle is reduced to [-pi/4, pi/4] about the nearest even multiple of
+    // pi/4, then minimax polynomials. Good to a couple of ulp for the angles
+    // the scene sees, and cheap to do four or eight at a time.
+    static const float kSinCosFourOverPi = 1.27323954473516f;
+    static const float kSinCosPiOver4Part1 = 0.78515625f;
+    static const float kSinCosPiOver4Part2 = 2.4187564849853515625e-4f;
+    static const float kSinCosPiOver4Part3 = 3.77489497744594108e-8f;
+    static const float kSinCoefficients[3] = {-1.9515295891e-4f, 8.3321608736e-3f, -1.6666654611e-1f};
+    static const float kCosCoefficients[3] = {2.443315711809948e-5f, -1.388731625493765e-3f, 4.166664568298827e-2f};
+    static const float kCubeBoundingRadius = 1.7320508f;   // a unit cube's corners are at +-1
+
+    void animateSpinningObjectsScalar(const SpinningObject *objects, uint32_t count, float timeSeconds,
+                                      float *modelsOut, BoundingSphere *boundsOut);
+    void cullSpheresScalar(const BoundingSphere *spheres, uint32_t count, const float (*planes)[6][4],
+                           uint32_t viewCount, uint8_t *visibilityOut, uint32_t *viewCountsInOut);
+    void expandToRGBAScalar(const uint8_t *pixels, uint32_t pixelCount, uint32_t channels, uint8_t *rgbaOut);
+    const CpuKernels *neonCpuKernels();
+    const CpuKernels *sse41CpuKernels();
+    const CpuKernels *avx2CpuKernels();
+}
+
+#endif // OSVROPENGL_CPUDISPATCH_H
@@ -0,0 +1,224 @@
+/*
+ * Copyright (C) 2015 Sensics, Inc. and contributors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+// The NEON kernels. arm64-v8a always has NEON; the armeabi-v7a build
+// compiles just this file for it (Android.mk's .neon suffix) and uses it
+// where CpuDispatch.cpp found the CPU has it.
+
+#include "CpuDispatch.h"
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+
+#include <arm_neon.h>
+
+namespace OSVROpenGL {
+
+    static inline void transpose4(float32x4_t &r0, float32x4_t &r1, float32x4_t &r2, float32x4_t &r3) {
+        float32x4x2_t t01 = vtrnq_f32(r0, r1);
+        float32x4x2_t t23 = vtrnq_f32(r2, r3);
+        r0 = vcombine_f32(vget_low_f32(t01.val[0]), vget_low_f32(t23.val[0]));
+        r1 = vcombine_f32(vget_low_f32(t01.val[1]), vget_low_f32(t23.val[1]));
+        r2 = vcombine_f32(vget_high_f32(t01.val[0]), vget_high_f32(t23.val[0]));
+        r3 = vcombine_f32(vget_high_f32(t01.val[1]), vget_high_f32(t23.val[1]));
+    }
+
+    // A lane mask's lanes as bits 0-3.
+    static inline uint32_t laneBits(uint32x4_t mask) {
+        static const uint32_t kLaneBits[4] = {1, 2, 4, 8};
+        uint32x4_t bits = vandq_u32(mask, vld1q_u32(kLaneBits));
+        uint32x2_t sum = vadd_u32(vget_low_u32(bits), vget_high_u32(bits));
+        return vget_lane_u32(vpadd_u32(sum, sum), 0);
+    }
+
+    static inline void sinCos4(float32x4_t angle, float32x4_t *sinOut, float32x4_t *cosOut) {
+        const uint32x4_t signMask = vdupq_n_u32(0x80000000u);
+        uint32x4_t sinSign = vandq_u32(vreinterpretq_u32_f32(angle), signMask);
+        float32x4_t x = vabsq_f32(angle);
+        int32x4_t octant = vcvtq_s32_f32(vmulq_f32(x, vdupq_n_f32(kSinCosFourOverPi)));
+        octant = vandq_s32(vaddq_s32(octant, vdupq_n_s32(1)), vdupq_n_s32(~1));
+        float32x4_t y = vcvtq_f32_s32(octant);
+        x = vsubq_f32(x, vmulq_f32(y, vdupq_n_f32(kSinCosPiOver4Part1)));
+        x = vsubq_f32(x, vmulq_f32(y, vdupq_n_f32(kSinCosPiOver4Part2)));
+        x = vsubq_f32(x, vmulq_f32(y, vdupq_n_f32(kSinCosPiOver4Part3)));
+
+        float32x4_t z = vmulq_f32(x, x);
+        float32x4_t c = vaddq_f32(vmulq_f32(vdupq_n_f32(kCosCoefficients[0]), z), vdupq_n_f32(kCosCoefficients[1]));
+        c = vaddq_f32(vmulq_f32(c, z), vdupq_n_f32(kCosCoefficients[2]));
+        c = vmulq_f32(vmulq_f32(c, z), z);
+        c = vaddq_f32(vsubq_f32(c, vmulq_f32(vdupq_n_f32(0.5f), z)), vdupq_n_f32(1.0f));
+        float32x4_t s = vaddq_f32(vmulq_f32(vdupq_n_f32(kSinCoefficients[0]), z), vdupq_n_f32(kSinCoefficients[1]));
+        s = vaddq_f32(vmulq_f32(s, z), vdupq_n_f32(kSinCoefficients[2]));
+        s = vaddq_f32(vmulq_f32(vmulq_f32(s, z), x), x);
+
+        uint32x4_t swap = vtstq_s32(octant, vdupq_n_s32(2));
+        uint32x4_t sinFlip = veorq_u32(sinSign, vshlq_n_u32(vreinterpretq_u32_s32(
+                vandq_s32(octant, vdupq_n_s32(4))), 29));
+        uint32x4_t cosFlip = vshlq_n_u32(vreinterpretq_u32_s32(
+                vbicq_s32(vdupq_n_s32(4), vsubq_s32(octant, vdupq_n_s32(2)))), 29);
+        *sinOut = vreinterpretq_f32_u32(veorq_u32(vreinterpretq_u32_f32(vbslq_f32(swap, c, s)), sinFlip));
+        *cosOut = vreinterpretq_f32_u32(veorq_u32(vreinterpretq_u32_f32(vbslq_f32(swap, s, c)), cosFlip));
+    }
+
+    static void animateSpinningObjectsNeon(const SpinningObject *objects, uint32_t count, float timeSeconds,
+                                           float *modelsOut, BoundingSphere *boundsOut) {
+        uint32_t i = 0;
+        for (; i + 4 <= count; i += 4) {
+            const float *in = objects[i].position;
+            float32x4_t px = vld1q_f32(in), py = vld1q_f32(in + 8);
+            float32x4_t pz = vld1q_f32(in + 16), scale = vld1q_f32(in + 24);
+            float32x4_t x = vld1q_f32(in + 4), y = vld1q_f32(in + 12);
+            float32x4_t z = vld1q_f32(in + 20), speed = vld1q_f32(in + 28);
+            transpose4(px, py, pz, scale);
+            transpose4(x, y, z, speed);
+
+            float32x4_t s, c;
+            sinCos4(vmulq_f32(speed, vdupq_n_f32(timeSeconds)), &s, &c);
+            float32x4_t t = vsubq_f32(vdupq_n_f32(1.0f), c);
+            float32x4_t tx = vmulq_f32(t, x);
+            float32x4_t ty = vmulq_f32(t, y);
+            float32x4_t tz = vmulq_f32(t, z);
+            float32x4_t sx = vmulq_f32(s, x);
+            float32x4_t sy = vmulq_f32(s, y);
+            float32x4_t sz = vmulq_f32(s, z);
+
+            float32x4_t m0 = vmulq_f32(vaddq_f32(vmulq_f32(tx, x), c), scale);
+            float32x4_t m1 = vmulq_f32(vaddq_f32(vmulq_f32(tx, y), sz), scale);
+            float32x4_t m2 = vmulq_f32(vsubq_f32(vmulq_f32(tx, z), sy), scale);
+            float32x4_t m3 = vdupq_n_f32(0.0f);
+            float32x4_t m4 = vmulq_f32(vsubq_f32(vmulq_f32(tx, y), sz), scale);
+            float32x4_t m5 = vmulq_f32(vaddq_f32(vmulq_f32(ty, y), c), scale);
+            float32x4_t m6 = vmulq_f32(vaddq_f32(vmulq_f32(ty, z), sx), scale);
+            float32x4_t m7 = vdupq_n_f32(0.0f);
+            float32x4_t m8 = vmulq_f32(vaddq_f32(vmulq_f32(tx, z), sy), scale);
+            float32x4_t m9 = vmulq_f32(vsubq_f32(vmulq_f32(ty, z), sx), scale);
+            float32x4_t m10 = vmulq_f32(vaddq_f32(vmulq_f32(tz, z), c), scale);
+            float32x4_t m11 = vdupq_n_f32(0.0f);
+            float32x4_t m12 = px, m13 = py, m14 = pz, m15 = vdupq_n_f32(1.0f);
+            transpose4(m0, m1, m2, m3);
+            transpose4(m4, m5, m6, m7);
+            transpose4(m8, m9, m10, m11);
+            transpose4(m12, m13, m14, m15);
+            float *out = modelsOut + i * 16;
+            vst1q_f32(out, m0);
+            vst1q_f32(out + 4, m4);
+            vst1q_f32(out + 8, m8);
+            vst1q_f32(out + 12, m12);
+            vst1q_f32(out + 16, m1);
+            vst1q_f32(out + 20, m5);
+            vst1q_f32(out + 24, m9);
+            vst1q_f32(out + 28, m13);
+            vst1q_f32(out + 32, m2);
+            vst1q_f32(out + 36, m6);
+            vst1q_f32(out + 40, m10);
+            vst1q_f32(out + 44, m14);
+            vst1q_f32(out + 48, m3);
+            vst1q_f32(out + 52, m7);
+            vst1q_f32(out + 56, m11);
+            vst1q_f32(out + 60, m15);
+
+            // the spheres are px, py, pz, radius records: a four-way interleaved store
+            float32x4x4_t bounds;
+            bounds.val[0] = px;
+            bounds.val[1] = py;
+            bounds.val[2] = pz;
+            bounds.val[3] = vmulq_f32(scale, vdupq_n_f32(kCubeBoundingRadius));
+            vst4q_f32(boundsOut[i].center, bounds);
+        }
+        animateSpinningObjectsScalar(objects + i, count - i, timeSeconds, modelsOut + i * 16, boundsOut + i);
+    }
+
+    static void cullSpheresNeon(const BoundingSphere *spheres, uint32_t count, const float (*planes)[6][4],
+                                uint32_t viewCount, uint8_t *visibilityOut, uint32_t *viewCountsInOut) {
+        uint32_t i = 0;
+        for (; i + 4 <= count; i += 4) {
+            float32x4x4_t sphere = vld4q_f32(spheres[i].center);
+            float32x4_t minDistance = vnegq_f32(sphere.val[3]);
+
+            uint32_t visibility[4] = {0, 0, 0, 0};
+            for (uint32_t view = 0; view < viewCount; view++) {
+                uint32x4_t inside = vdupq_n_u32(0xffffffffu);
+                for (int plane = 0; plane < 6; plane++) {
+                    const float *p = planes[view][plane];
+                    float32x4_t distance = vaddq_f32(vmulq_n_f32(sphere.val[0], p[0]),
+                                                     vmulq_n_f32(sphere.val[1], p[1]));
+                    distance = vaddq_f32(distance, vmulq_n_f32(sphere.val[2], p[2]));
+                    distance = vaddq_f32(distance, vdupq_n_f32(p[3]));
+                    inside = vandq_u32(inside, vcgeq_f32(distance, minDistance));
+                    if (laneBits(inside) == 0) {
+                        break;
+                    }
+                }
+                uint32_t bits = laneBits(inside);
+                for (int k = 0; k < 4; k++) {
+                    uint32_t bit = (bits >> k) & 1u;
+                    visibility[k] |= bit << view;
+                    viewCountsInOut[view] += bit;
+                }
+            }
+            for (int k = 0; k < 4; k++) {
+                visibilityOut[i + k] = static_cast<uint8_t>(visibility[k]);
+            }
+        }
+        cullSpheresScalar(spheres + i, count - i, planes, viewCount, visibilityOut + i, viewCountsInOut);
+    }
+
+    static void expandToRGBANeon(const uint8_t *pixels, uint32_t pixelCount, uint32_t channels,
+                                 uint8_t *rgbaOut) {
+        uint32_t i = 0;
+        uint8x16x4_t rgba;
+        rgba.val[3] = vdupq_n_u8(255);
+        if (channels == 1) {
+            for (; i + 16 <= pixelCount; i += 16) {
+                uint8x16_t grey = vld1q_u8(pixels + i);
+                rgba.val[0] = grey;
+                rgba.val[1] = grey;
+                rgba.val[2] = grey;
+                vst4q_u8(rgbaOut + i * 4, rgba);
+            }
+        } else if (channels == 3) {
+            for (; i + 16 <= pixelCount; i += 16) {
+                uint8x16x3_t rgb = vld3q_u8(pixels + i * 3);
+                rgba.val[0] = rgb.val[0];
+                rgba.val[1] = rgb.val[1];
+                rgba.val[2] = rgb.val[2];
+                vst4q_u8(rgbaOut + i * 4, rgba);
+            }
+        }
+        expandToRGBAScalar(pixels + i * channels, pixelCount - i, channels, rgbaOut + i * 4);
+    }
+
+    static const CpuKernels kNeonKernels = {
+        animateSpinningObjectsNeon,
+        cullSpheresNeon,
+        expandToRGBANeon
+    };
+
+    const CpuKernels *neonCpuKernels() {
+        return &kNeonKernels;
+    }
+}
+
+#else
+
+namespace OSVROpenGL {
+
+    const CpuKernels *neonCpuKernels() {
+        return nullptr;
+    }
+}
+
+#endif
@@ -0,0 +1,430 @@
+/*
+ * Copyright (C) 2015 Sensics, Inc. and contributors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+// The SSE4.1 and AVX2 kernels. They are compiled for their instruction sets
+// function by function, so the rest of the library keeps the ABI's baseline
+// and these only run where CpuDispatch.cpp found the CPU has them.
+
+#include "CpuDispatch.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+
+#include <cstring>
+
+#include <immintrin.h>
+
+#define OSVR_SSE41 __attribute__((target("sse4.1")))
+#define OSVR_AVX2 __attribute__((target("avx2")))
+
+namespace OSVROpenGL {
+
+    // SSE4.1: four objects, spheres or pixels at a time
+
+    OSVR_SSE41 static inline void sinCos4(__m128 angle, __m128 *sinOut, __m128 *cosOut) {
+        const __m128 signMask = _mm_set1_ps(-0.0f);
+        __m128 sinSign = _mm_and_ps(angle, signMask);
+        __m128 x = _mm_andnot_ps(signMask, angle);
+        __m128i octant = _mm_cvttps_epi32(_mm_mul_ps(x, _mm_set1_ps(kSinCosFourOverPi)));
+        octant = _mm_and_si128(_mm_add_epi32(octant, _mm_set1_epi32(1)), _mm_set1_epi32(~1));
+        __m128 y = _mm_cvtepi32_ps(octant);
+        x = _mm_sub_ps(x, _mm_mul_ps(y, _mm_set1_ps(kSinCosPiOver4Part1)));
+        x = _mm_sub_ps(x, _mm_mul_ps(y, _mm_set1_ps(kSinCosPiOver4Part2)));
+        x = _mm_sub_ps(x, _mm_mul_ps(y, _mm_set1_ps(kSinCosPiOver4Part3)));
+
+        __m128 z = _mm_mul_ps(x, x);
+        __m128 c = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(kCosCoefficients[0]), z), _mm_set1_ps(kCosCoefficients[1]));
+        c = _mm_add_ps(_mm_mul_ps(c, z), _mm_set1_ps(kCosCoefficients[2]));
+        c = _mm_mul_ps(_mm_mul_ps(c, z), z);
+        c = _mm_add_ps(_mm_sub_ps(c, _mm_mul_ps(_mm_set1_ps(0.5f), z)), _mm_set1_ps(1.0f));
+        __m128 s = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(kSinCoefficients[0]), z), _mm_set1_ps(kSinCoefficients[1]));
+        s = _mm_add_ps(_mm_mul_ps(s, z), _mm_set1_ps(kSinCoefficients[2]));
+        s = _mm_add_ps(_mm_mul_ps(_mm_mul_ps(s, z), x), x);
+
+        __m128 swap = _mm_castsi128_ps(_mm_cmpeq_epi32(_mm_and_si128(octant, _mm_set1_epi32(2)),
+                                                       _mm_set1_epi32(2)));
+        __m128 sinFlip = _mm_xor_ps(sinSign, _mm_castsi128_ps(
+                _mm_slli_epi32(_mm_and_si128(octant, _mm_set1_epi32(4)), 29)));
+        __m128 cosFlip = _mm_castsi128_ps(_mm_slli_epi32(
+                _mm_andnot_si128(_mm_sub_epi32(octant, _mm_set1_epi32(2)), _mm_set1_epi32(4)), 29));
+        *sinOut = _mm_xor_ps(_mm_blendv_ps(s, c, swap), sinFlip);
+        *cosOut = _mm_xor_ps(_mm_blendv_ps(c, s, swap), cosFlip);
+    }
+
+    OSVR_SSE41 static void animateSpinningObjectsSSE41(const SpinningObject *objects, uint32_t count,
+                                                       float timeSeconds, float *modelsOut,
+                                                       BoundingSphere *boundsOut) {
+        uint32_t i = 0;
+        for (; i + 4 <= count; i += 4) {
+            const float *in = objects[i].position;
+            __m128 px = _mm_loadu_ps(in), py = _mm_loadu_ps(in + 8);
+            __m128 pz = _mm_loadu_ps(in + 16), scale = _mm_loadu_ps(in + 24);
+            __m128 x = _mm_loadu_ps(in + 4), y = _mm_loadu_ps(in + 12);
+            __m128 z = _mm_loadu_ps(in + 20), speed = _mm_loadu_ps(in + 28);
+            _MM_TRANSPOSE4_PS(px, py, pz, scale);
+            _MM_TRANSPOSE4_PS(x, y, z, speed);
+
+            __m128 s, c;
+            sinCos4(_mm_mul_ps(speed, _mm_set1_ps(timeSeconds)), &s, &c);
+            __m128 t = _mm_sub_ps(_mm_set1_ps(1.0f), c);
+            __m128 tx = _mm_mul_ps(t, x);
+            __m128 ty = _mm_mul_ps(t, y);
+            __m128 tz = _mm_mul_ps(t, z);
+            __m128 sx = _mm_mul_ps(s, x);
+            __m128 sy = _mm_mul_ps(s, y);
+            __m128 sz = _mm_mul_ps(s, z);
+
+            __m128 m0 = _mm_mul_ps(_mm_add_ps(_mm_mul_ps(tx, x), c), scale);
+            __m128 m1 = _mm_mul_ps(_mm_add_ps(_mm_mul_ps(tx, y), sz), scale);
+            __m128 m2 = _mm_mul_ps(_mm_sub_ps(_mm_mul_ps(tx, z), sy), scale);
+            __m128 m3 = _mm_setzero_ps();
+            __m128 m4 = _mm_mul_ps(_mm_sub_ps(_mm_mul_ps(tx, y), sz), scale);
+            __m128 m5 = _mm_mul_ps(_mm_add_ps(_mm_mul_ps(ty, y), c), scale);
+            __m128 m6 = _mm_mul_ps(_mm_add_ps(_mm_mul_ps(ty, z), sx), scale);
+            __m128 m7 = _mm_setzero_ps();
+            __m128 m8 = _mm_mul_ps(_mm_add_ps(_mm_mul_ps(tx, z), sy), scale);
+            __m128 m9 = _mm_mul_ps(_mm_sub_ps(_mm_mul_ps(ty, z), sx), scale);
+            __m128 m10 = _mm_mul_ps(_mm_add_ps(_mm_mul_ps(tz, z), c), scale);
+            __m128 m11 = _mm_setzero_ps();
+            __m128 m12 = px, m13 = py, m14 = pz, m15 = _mm_set1_ps(1.0f);
+            _MM_TRANSPOSE4_PS(m0, m1, m2, m3);
+            _MM_TRANSPOSE4_PS(m4, m5, m6, m7);
+            _MM_TRANSPOSE4_PS(m8, m9, m10, m11);
+            _MM_TRANSPOSE4_PS(m12, m13, m14, m15);
+            float *out = modelsOut + i * 16;
+            _mm_storeu_ps(out, m0);
+            _mm_storeu_ps(out + 4, m4);
+            _mm_storeu_ps(out + 8, m8);
+            _mm_storeu_ps(out + 12, m12);
+            _mm_storeu_ps(out + 16, m1);
+            _mm_storeu_ps(out + 20, m5);
+            _mm_storeu_ps(out + 24, m9);
+            _mm_storeu_ps(out + 28, m13);
+            _mm_storeu_ps(out + 32, m2);
+            _mm_storeu_ps(out + 36, m6);
+            _mm_storeu_ps(out + 40, m10);
+            _mm_storeu_ps(out + 44, m14);
+            _mm_storeu_ps(out + 48, m3);
+            _mm_storeu_ps(out + 52, m7);
+            _mm_storeu_ps(out + 56, m11);
+            _mm_storeu_ps(out + 60, m15);
+
+            __m128 radius = _mm_mul_ps(scale, _mm_set1_ps(kCubeBoundingRadius));
+            _MM_TRANSPOSE4_PS(px, py, pz, radius);
+            float *bounds = boundsOut[i].center;
+            _mm_storeu_ps(bounds, px);
+            _mm_storeu_ps(bounds + 4, py);
+            _mm_storeu_ps(bounds + 8, pz);
+            _mm_storeu_ps(bounds + 12, radius);
+        }
+        animateSpinningObjectsScalar(objects + i, count - i, timeSeconds, modelsOut + i * 16, boundsOut + i);
+    }
+
+    OSVR_SSE41 static void cullSpheresSSE41(const BoundingSphere *spheres, uint32_t count,
+                                            const float (*planes)[6][4], uint32_t viewCount,
+                                            uint8_t *visibilityOut, uint32_t *viewCountsInOut) {
+        uint32_t i = 0;
+        for (; i + 4 <= count; i += 4) {
+            const float *in = spheres[i].center;
+            __m128 cx = _mm_loadu_ps(in), cy = _mm_loadu_ps(in + 4);
+            __m128 cz = _mm_loadu_ps(in + 8), radius = _mm_loadu_ps(in + 12);
+            _MM_TRANSPOSE4_PS(cx, cy, cz, radius);
+            __m128 minDistance = _mm_xor_ps(radius, _mm_set1_ps(-0.0f));
+
+            uint32_t visibility[4] = {0, 0, 0, 0};
+            for (uint32_t view = 0; view < viewCount; view++) {
+                __m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+                for (int plane = 0; plane < 6; plane++) {
+                    const float *p = planes[view][plane];
+                    __m128 distance = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(p[0]), cx),
+                                                 _mm_mul_ps(_mm_set1_ps(p[1]), cy));
+                    distance = _mm_add_ps(distance, _mm_mul_ps(_mm_set1_ps(p[2]), cz));
+                    distance = _mm_add_ps(distance, _mm_set1_ps(p[3]));
+                    inside = _mm_and_ps(inside, _mm_cmpge_ps(distance, minDistance));
+                    if (_mm_movemask_ps(inside) == 0) {
+                        break;
+                    }
+                }
+                uint32_t bits = static_cast<uint32_t>(_mm_movemask_ps(inside));
+                for (int k = 0; k < 4; k++) {
+                    uint32_t bit = (bits >> k) & 1u;
+                    visibility[k] |= bit << view;
+                    viewCountsInOut[view] += bit;
+                }
+            }
+            for (int k = 0; k < 4; k++) {
+                visibilityOut[i + k] = static_cast<uint8_t>(visibility[k]);
+            }
+        }
+        cullSpheresScalar(spheres + i, count - i, planes, viewCount, visibilityOut + i, viewCountsInOut);
+    }
+
+    OSVR_SSE41 static void expandToRGBASSE41(const uint8_t *pixels, uint32_t pixelCount, uint32_t channels,
+                                             uint8_t *rgbaOut) {
+        const __m128i alpha = _mm_set1_epi32(static_cast<int>(0xff000000u));
+        uint32_t i = 0;
+        if (channels == 1) {
+            const __m128i grey0 = _mm_setr_epi8(0, 0, 0, -1, 1, 1, 1, -1, 2, 2, 2, -1, 3, 3, 3, -1);
+            const __m128i grey1 = _mm_add_epi8(grey0, _mm_setr_epi8(4, 4, 4, 0, 4, 4, 4, 0, 4, 4, 4, 0, 4, 4, 4, 0));
+            const __m128i grey2 = _mm_add_epi8(grey1, _mm_setr_epi8(4, 4, 4, 0, 4, 4, 4, 0, 4, 4, 4, 0, 4, 4, 4, 0));
+            const __m128i grey3 = _mm_add_epi8(grey2, _mm_setr_epi8(4, 4, 4, 0, 4, 4, 4, 0, 4, 4, 4, 0, 4, 4, 4, 0));
+            for (; i + 16 <= pixelCount; i += 16) {
+                __m128i grey = _mm_loadu_si128(reinterpret_cast<const __m128i *>(pixels + i));
+                __m128i *out = reinterpret_cast<__m128i *>(rgbaOut + i * 4);
+                _mm_storeu_si128(out, _mm_or_si128(_mm_shuffle_epi8(grey, grey0), alpha));
+                _mm_storeu_si128(out + 1, _mm_or_si128(_mm_shuffle_epi8(grey, grey1), alpha));
+                _mm_storeu_si128(out + 2, _mm_or_si128(_mm_shuffle_epi8(grey, grey2), alpha));
+                _mm_storeu_si128(out + 3, _mm_or_si128(_mm_shuffle_epi8(grey, grey3), alpha));
+            }
+        } else if (channels == 3) {
+            const __m128i rgb = _mm_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+            for (; i + 16 <= pixelCount; i += 16) {
+                const __m128i *in = reinterpret_cast<const __m128i *>(pixels + i * 3);
+                __m128i in0 = _mm_loadu_si128(in);
+                __m128i in1 = _mm_loadu_si128(in + 1);
+                __m128i in2 = _mm_loadu_si128(in + 2);
+                __m128i *out = reinterpret_cast<__m128i *>(rgbaOut + i * 4);
+                _mm_storeu_si128(out, _mm_or_si128(_mm_shuffle_epi8(in0, rgb), alpha));
+                _mm_storeu_si128(out + 1, _mm_or_si128(_mm_shuffle_epi8(_mm_alignr_epi8(in1, in0, 12), rgb), alpha));
+                _mm_storeu_si128(out + 2, _mm_or_si128(_mm_shuffle_epi8(_mm_alignr_epi8(in2, in1, 8), rgb), alpha));
+                _mm_storeu_si128(out + 3, _mm_or_si128(_mm_shuffle_epi8(_mm_srli_si128(in2, 4), rgb), alpha));
+            }
+        }
+        expandToRGBAScalar(pixels + i * channels, pixelCount - i, channels, rgbaOut + i * 4);
+    }
+
+    // AVX2: eight at a time, the low 128-bit lane taking the first four and
+    // the high lane the other four, so the SSE4.1 code's in-lane shuffles carry over
+
+    OSVR_AVX2 static inline __m256 combine(__m128 low, __m128 high) {
+        return _mm256_insertf128_ps(_mm256_castps128_ps256(low), high, 1);
+    }
+
+    OSVR_AVX2 static inline void transpose4InLanes(__m256 &r0, __m256 &r1, __m256 &r2, __m256 &r3) {
+        __m256 t0 = _mm256_unpacklo_ps(r0, r1);
+        __m256 t1 = _mm256_unpackhi_ps(r0, r1);
+        __m256 t2 = _mm256_unpacklo_ps(r2, r3);
+        __m256 t3 = _mm256_unpackhi_ps(r2, r3);
+        r0 = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(1, 0, 1, 0));
+        r1 = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(3, 2, 3, 2));
+        r2 = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(1, 0, 1, 0));
+        r3 = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(3, 2, 3, 2));
+    }
+
+    // Loads 4 floats from each of eight records stride floats apart, as
+    // r0..r3 = the records' first..fourth floats.
+    OSVR_AVX2 static inline void loadTransposed8(const float *in, uint32_t stride,
+                                                 __m256 *r0, __m256 *r1, __m256 *r2, __m256 *r3) {
+        *r0 = combine(_mm_loadu_ps(in), _mm_loadu_ps(in + 4 * stride));
+        *r1 = combine(_mm_loadu_ps(in + stride), _mm_loadu_ps(in + 5 * stride));
+        *r2 = combine(_mm_loadu_ps(in + 2 * stride), _mm_loadu_ps(in + 6 * stride));
+        *r3 = combine(_mm_loadu_ps(in + 3 * stride), _mm_loadu_ps(in + 7 * stride));
+        transpose4InLanes(*r0, *r1, *r2, *r3);
+    }
+
+    // The inverse: r0..r3 hold the records' first..fourth floats.
+    OSVR_AVX2 static inline void storeTransposed8(float *out, uint32_t stride,
+                                                  __m256 r0, __m256 r1, __m256 r2, __m256 r3) {
+        transpose4InLanes(r0, r1, r2, r3);
+        _mm_storeu_ps(out, _mm256_castps256_ps128(r0));
+        _mm_storeu_ps(out + stride, _mm256_castps256_ps128(r1));
+        _mm_storeu_ps(out + 2 * stride, _mm256_castps256_ps128(r2));
+        _mm_storeu_ps(out + 3 * stride, _mm256_castps256_ps128(r3));
+        _mm_storeu_ps(out + 4 * stride, _mm256_extractf128_ps(r0, 1));
+        _mm_storeu_ps(out + 5 * stride, _mm256_extractf128_ps(r1, 1));
+        _mm_storeu_ps(out + 6 * stride, _mm256_extractf128_ps(r2, 1));
+        _mm_storeu_ps(out + 7 * stride, _mm256_extractf128_ps(r3, 1));
+    }
+
+    OSVR_AVX2 static inline void sinCos8(__m256 angle, __m256 *sinOut, __m256 *cosOut) {
+        const __m256 signMask = _mm256_set1_ps(-0.0f);
+        __m256 sinSign = _mm256_and_ps(angle, signMask);
+        __m256 x = _mm256_andnot_ps(signMask, angle);
+        __m256i octant = _mm256_cvttps_epi32(_mm256_mul_ps(x, _mm256_set1_ps(kSinCosFourOverPi)));
+        octant = _mm256_and_si256(_mm256_add_epi32(octant, _mm256_set1_epi32(1)), _mm256_set1_epi32(~1));
+        __m256 y = _mm256_cvtepi32_ps(octant);
+        x = _mm256_sub_ps(x, _mm256_mul_ps(y, _mm256_set1_ps(kSinCosPiOver4Part1)));
+        x = _mm256_sub_ps(x, _mm256_mul_ps(y, _mm256_set1_ps(kSinCosPiOver4Part2)));
+        x = _mm256_sub_ps(x, _mm256_mul_ps(y, _mm256_set1_ps(kSinCosPiOver4Part3)));
+
+        __m256 z = _mm256_mul_ps(x, x);
+        __m256 c = _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(kCosCoefficients[0]), z),
+                                 _mm256_set1_ps(kCosCoefficients[1]));
+        c = _mm256_add_ps(_mm256_mul_ps(c, z), _mm256_set1_ps(kCosCoefficients[2]));
+        c = _mm256_mul_ps(_mm256_mul_ps(c, z), z);
+        c = _mm256_add_ps(_mm256_sub_ps(c, _mm256_mul_ps(_mm256_set1_ps(0.5f), z)), _mm256_set1_ps(1.0f));
+        __m256 s = _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(kSinCoefficients[0]), z),
+                                 _mm256_set1_ps(kSinCoefficients[1]));
+        s = _mm256_add_ps(_mm256_mul_ps(s, z), _mm256_set1_ps(kSinCoefficients[2]));
+        s = _mm256_add_ps(_mm256_mul_ps(_mm256_mul_ps(s, z), x), x);
+
+        __m256 swap = _mm256_castsi256_ps(_mm256_cmpeq_epi32(_mm256_and_si256(octant, _mm256_set1_epi32(2)),
+                                                             _mm256_set1_epi32(2)));
+        __m256 sinFlip = _mm256_xor_ps(sinSign, _mm256_castsi256_ps(
+                _mm256_slli_epi32(_mm256_and_si256(octant, _mm256_set1_epi32(4)), 29)));
+        __m256 cosFlip = _mm256_castsi256_ps(_mm256_slli_epi32(
+                _mm256_andnot_si256(_mm256_sub_epi32(octant, _mm256_set1_epi32(2)), _mm256_set1_epi32(4)), 29));
+        *sinOut = _mm256_xor_ps(_mm256_blendv_ps(s, c, swap), sinFlip);
+        *cosOut = _mm256_xor_ps(_mm256_blendv_ps(c, s, swap), cosFlip);
+    }
+
+    OSVR_AVX2 static void animateSpinningObjectsAVX2(const SpinningObject *objects, uint32_t count,
+                                                     float timeSeconds, float *modelsOut,
+                                                     BoundingSphere *boundsOut) {
+        uint32_t i = 0;
+        for (; i + 8 <= count; i += 8) {
+            __m256 px, py, pz, scale, x, y, z, speed;
+            loadTransposed8(objects[i].position, 8, &px, &py, &pz, &scale);
+            loadTransposed8(objects[i].axis, 8, &x, &y, &z, &speed);
+
+            __m256 s, c;
+            sinCos8(_mm256_mul_ps(speed, _mm256_set1_ps(timeSeconds)), &s, &c);
+            __m256 t = _mm256_sub_ps(_mm256_set1_ps(1.0f), c);
+            __m256 tx = _mm256_mul_ps(t, x);
+            __m256 ty = _mm256_mul_ps(t, y);
+            __m256 tz = _mm256_mul_ps(t, z);
+            __m256 sx = _mm256_mul_ps(s, x);
+            __m256 sy = _mm256_mul_ps(s, y);
+            __m256 sz = _mm256_mul_ps(s, z);
+            __m256 zero = _mm256_setzero_ps();
+
+            float *out = modelsOut + i * 16;
+            storeTransposed8(out, 16,
+                             _mm256_mul_ps(_mm256_add_ps(_mm256_mul_ps(tx, x), c), scale),
+                             _mm256_mul_ps(_mm256_add_ps(_mm256_mul_ps(tx, y), sz), scale),
+                             _mm256_mul_ps(_mm256_sub_ps(_mm256_mul_ps(tx, z), sy), scale),
+                             zero);
+            storeTransposed8(out + 4, 16,
+                             _mm256_mul_ps(_mm256_sub_ps(_mm256_mul_ps(tx, y), sz), scale),
+                             _mm256_mul_ps(_mm256_add_ps(_mm256_mul_ps(ty, y), c), scale),
+                             _mm256_mul_ps(_mm256_add_ps(_mm256_mul_ps(ty, z), sx), scale),
+                             zero);
+            storeTransposed8(out + 8, 16,
+                             _mm256_mul_ps(_mm256_add_ps(_mm256_mul_ps(tx, z), sy), scale),
+                             _mm256_mul_ps(_mm256_sub_ps(_mm256_mul_ps(ty, z), sx), scale),
+                             _mm256_mul_ps(_mm256_add_ps(_mm256_mul_ps(tz, z), c), scale),
+                             zero);
+            storeTransposed8(out + 12, 16, px, py, pz, _mm256_set1_ps(1.0f));
+            storeTransposed8(boundsOut[i].center, 4, px, py, pz,
+                             _mm256_mul_ps(scale, _mm256_set1_ps(kCubeBoundingRadius)));
+        }
+        animateSpinningObjectsSSE41(objects + i, count - i, timeSeconds, modelsOut + i * 16, boundsOut + i);
+    }
+
+    OSVR_AVX2 static void cullSpheresAVX2(const BoundingSphere *spheres, uint32_t count,
+                                          const float (*planes)[6][4], uint32_t viewCount,
+                                          uint8_t *visibilityOut, uint32_t *viewCountsInOut) {
+        uint32_t i = 0;
+        for (; i + 8 <= count; i += 8) {
+            __m256 cx, cy, cz, radius;
+            loadTransposed8(spheres[i].center, 4, &cx, &cy, &cz, &radius);
+            __m256 minDistance = _mm256_xor_ps(radius, _mm256_set1_ps(-0.0f));
+
+            uint32_t visibility[8] = {0, 0, 0, 0, 0, 0, 0, 0};
+            for (uint32_t view = 0; view < viewCount; view++) {
+                __m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+                for (int plane = 0; plane < 6; plane++) {
+                    const float *p = planes[view][plane];
+                    __m256 distance = _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(p[0]), cx),
+                                                    _mm256_mul_ps(_mm256_set1_ps(p[1]), cy));
+                    distance = _mm256_add_ps(distance, _mm256_mul_ps(_mm256_set1_ps(p[2]), cz));
+                    distance = _mm256_add_ps(distance, _mm256_set1_ps(p[3]));
+                    inside = _mm256_and_ps(inside, _mm256_cmp_ps(distance, minDistance, _CMP_GE_OQ));
+                    if (_mm256_movemask_ps(inside) == 0) {
+                        break;
+                    }
+                }
+                uint32_t bits = static_cast<uint32_t>(_mm256_movemask_ps(inside));
+                for (int k = 0; k < 8; k++) {
+                    uint32_t bit = (bits >> k) & 1u;
+                    visibility[k] |= bit << view;
+                    viewCountsInOut[view] += bit;
+                }
+            }
+            for (int k = 0; k < 8; k++) {
+                visibilityOut[i + k] = static_cast<uint8_t>(visibility[k]);
+            }
+        }
+        cullSpheresSSE41(spheres + i, count - i, planes, viewCount, visibilityOut + i, viewCountsInOut);
+    }
+
+    OSVR_AVX2 static void expandToRGBAAVX2(const uint8_t *pixels, uint32_t pixelCount, uint32_t channels,
+                                           uint8_t *rgbaOut) {
+        const __m256i alpha = _mm256_set1_epi32(static_cast<int>(0xff000000u));
+        uint32_t i = 0;
+        if (channels == 1) {
+            const __m256i grey01 = _mm256_setr_epi8(0, 0, 0, -1, 1, 1, 1, -1, 2, 2, 2, -1, 3, 3, 3, -1,
+                                                    4, 4, 4, -1, 5, 5, 5, -1, 6, 6, 6, -1, 7, 7, 7, -1);
+            const __m256i grey23 = _mm256_add_epi8(grey01, _mm256_setr_epi8(
+                    8, 8, 8, 0, 8, 8, 8, 0, 8, 8, 8, 0, 8, 8, 8, 0,
+                    8, 8, 8, 0, 8, 8, 8, 0, 8, 8, 8, 0, 8, 8, 8, 0));
+            for (; i + 16 <= pixelCount; i += 16) {
+                __m256i grey = _mm256_broadcastsi128_si256(
+                        _mm_loadu_si128(reinterpret_cast<const __m128i *>(pixels + i)));
+                __m256i *out = reinterpret_cast<__m256i *>(rgbaOut + i * 4);
+                _mm256_storeu_si256(out, _mm256_or_si256(_mm256_shuffle_epi8(grey, grey01), alpha));
+                _mm256_storeu_si256(out + 1, _mm256_or_si256(_mm256_shuffle_epi8(grey, grey23), alpha));
+            }
+        } else if (channels == 3) {
+            // 32 bytes in: pixels 0-3 to the low lane, 4-7 (from byte 12) to the high one
+            const __m256i lanes = _mm256_setr_epi32(0, 1, 2, 3, 3, 4, 5, 6);
+            const __m256i rgb = _mm256_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1,
+                                                 0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+            for (; i + 11 <= pixelCount; i += 8) {
+                __m256i in = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(pixels + i * 3));
+                in = _mm256_permutevar8x32_epi32(in, lanes);
+                _mm256_storeu_si256(reinterpret_cast<__m256i *>(rgbaOut + i * 4),
+                                    _mm256_or_si256(_mm256_shuffle_epi8(in, rgb), alpha));
+            }
+        }
+        expandToRGBASSE41(pixels + i * channels, pixelCount - i, channels, rgbaOut + i * 4);
+    }
+
+    static const CpuKernels kSSE41Kernels = {
+        animateSpinningObjectsSSE41,
+        cullSpheresSSE41,
+        expandToRGBASSE41
+    };
+
+    static const CpuKernels kAVX2Kernels = {
+        animateSpinningObjectsAVX2,
+        cullSpheresAVX2,
+        expandToRGBAAVX2
+    };
+
+    const CpuKernels *sse41CpuKernels() {
+        return &kSSE41Kernels;
+    }
+
+    const CpuKernels *avx2CpuKernels() {
+        return &kAVX2Kernels;
+    }
+}
+
+#else
+
+namespace OSVROpenGL {
+
+    const CpuKernels *sse41CpuKernels() {
+        return nullptr;
+    }
+
+    const CpuKernels *avx2CpuKernels() {
+        return nullptr;
+    }
+}
+
+#endif
@@ -0,0 +1,862 @@
+/*
+ * Copyright (C) 2015 Sensics, Inc. and contributors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+#include <GLES2/gl2.h>
+#include <GLES2/gl2ext.h>
+
+#include "Logging.h"
+#include "DistortionMesh.h"
+#include "FrameStats.h"
+#include "GLExtensions.h"
+#include "GpuMemory.h"
+#include "Layers.h"
+#include "Lifecycle.h"
+
+namespace OSVROpenGL {
+
+    static const char kCacheMagic[8] = { 'O', 'S', 'V', 'R', 'D', 'M', 'C', '1' };
+    static const char kConfigCacheMagic[8] = { 'O', 'S', 'V', 'R', 'D', 'C', 'C', '1' };
+    static const int kChannelCount = 3;
+
+    static std::string gDisplayConfigPath;
+    static std::string gCacheDirectory;
+    static uint32_t gGridWidth = 32;
+    static uint32_t gGridHeight = 32;
+
+    static GLuint gMeshProgram = 0;
+    static GLint gMeshEyeScaleUniform = -1;
+    // for GL_TEXTURE_2D layers, and GL_TEXTURE_EXTERNAL_OES ones where they can be sampled
+    static GLuint gLayerPrograms[2] = { 0, 0 };
+    static GLint gLayerHomographyUniforms[2] = { -1, -1 };
+    static GLuint gVertexBuffer = 0;
+    static GLuint gIndexBuffer = 0;
+    static uint32_t gMeshEyeCount = 0;
+    static uint32_t gMeshVertexCount = 0;
+    static uint32_t gMeshIndexCount = 0;
+    // kept for working out which part of the window a layer covers
+    static std::vector<DistortionVertex> gMeshVertices;
+
+    static const char gMeshVertexShader[] =
+            "attribute vec2 position;\n"
+            "attribute vec2 uvRed;\n"
+            "attribute vec2 uvGreen;\n"
+            "attribute vec2 uvBlue;\n"
+            "varying vec2 vRed;\n"
+            "varying vec2 vGreen;\n"
+            "varying vec2 vBlue;\n"
+            "void main() {\n"
+            "  gl_Position = vec4(position, 0.0, 1.0);\n"
+            "  vRed = uvRed;\n"
+            "  vGreen = uvGreen;\n"
+            "  vBlue = uvBlue;\n"
+            "}\n";
+
+    static const char gMeshFragmentShader[] =
+            "#ifdef GL_FRAGMENT_PRECISION_HIGH\n"
+            "precision highp float;\n"
+            "#else\n"
+            "precision mediump float;\n"
+            "#endif\n"
+            "uniform sampler2D source;\n"
+            "uniform float eyeScale;\n"
+            "varying vec2 vRed;\n"
+            "varying vec2 vGreen;\n"
+            "varying vec2 vBlue;\n"
+            "float inside(vec2 uv) {\n"
+            "  vec2 s = step(vec2(0.0), uv) * step(uv, vec2(1.0));\n"
+            "  return s.x * s.y;\n"
+            "}\n"
+            "void main() {\n"
+            "  gl_FragColor = vec4(texture2D(source, vRed * eyeScale).r * inside(vRed),\n"
+            "                      texture2D(source, vGreen * eyeScale).g * inside(vGreen),\n"
+            "                      texture2D(source, vBlue * eyeScale).b * inside(vBlue), 1.0);\n"
+            "}\n";
+
+    // A layer through the mesh: the eye texture coordinates are taken on to
+    // the layer's by a homography, before the divide as it is linear.
+    static const char gLayerVertexShader[] =
+            "uniform mat3 layerFromEye;\n"
+            "attribute vec2 position;\n"
+            "attribute vec2 uvRed;\n"
+            "attribute vec2 uvGreen;\n"
+            "attribute vec2 uvBlue;\n"
+            "varying vec3 vRed;\n"
+            "varying vec3 vGreen;\n"
+            "varying vec3 vBlue;\n"
+            "void main() {\n"
+            "  gl_Position = vec4(position, 0.0, 1.0);\n"
+            "  vRed = layerFromEye * vec3(uvRed, 1.0);\n"
+            "  vGreen = layerFromEye * vec3(uvGreen, 1.0);\n"
+            "  vBlue = layerFromEye * vec3(uvBlue, 1.0);\n"
+            "}\n";
+
+    // Premultiplied, for glBlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA); green
+    // decides the coverage for all three channels. After a kLayerSampler prefix.
+    static const char gLayerFragmentShader[] =
+            "#ifdef GL_FRAGMENT_PRECISION_HIGH\n"
+            "precision highp float;\n"
+            "#else\n"
+            "precision mediump float;\n"
+            "#endif\n"
+            "uniform LAYER_SAMPLER source;\n"
+            "varying vec3 vRed;\n"
+            "varying vec3 vGreen;\n"
+            "varying vec3 vBlue;\n"
+            "void main() {\n"
+            "  vec2 green = vGreen.xy / vGreen.z;\n"
+            "  vec2 s = step(vec2(0.0), green) * step(green, vec2(1.0));\n"
+            "  vec4 texel = texture2D(source, green);\n"
+            "  float alpha = texel.a * s.x * s.y * step(0.0, vGreen.z);\n"
+            "  gl_FragColor = vec4(texture2D(source, vRed.xy / vRed.z).r, texel.g,\n"
+            "                      texture2D(source, vBlue.xy / vBlue.z).b, 1.0) * alpha;\n"
+            "}\n";
+
+    // Just enough JSON to walk to the display descriptor's members; every
+    // function takes a pointer at a value and returns null on anything
+    // malformed.
+
+    static const char *skipSpace(const char *p) {
+        for (;;) {
+            while (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n') {
+                p++;
+            }
+            if (p[0] == '/' && p[1] == '*') {
+                const char *end = strstr(p + 2, "*/");
+                if (!end) {
+                    return nullptr;
+                }
+                p = end + 2;
+            } else if (p[0] == '/' && p[1] == '/') {
+                while (*p && *p != '\n') {
+                    p++;
+                }
+            } else {
+                return p;
+            }
+        }
+    }
+
+    static const char *skipString(const char *p) {
+        for (p++; *p && *p != '"'; p++) {
+            if (*p == '\\' && p[1]) {
+                p++;
+            }
+        }
+        return *p == '"' ? p + 1 : nullptr;
+    }
+
+    static const char *skipValue(const char *p) {
+        p = skipSpace(p);
+        if (!p || !*p) {
+            return nullptr;
+        }
+        if (*p == '"') {
+            return skipString(p);
+        }
+        if (*p == '{' || *p == '[') {
+            char close = *p == '{' ? '}' : ']';
+            p = skipSpace(p + 1);
+            while (p && *p != close) {
+                if (close == '}') {
+                    p = p && *p == '"' ? skipString(p) : nullptr;
+                    p = p ? skipSpace(p) : nullptr;
+                    p = p && *p == ':' ? p + 1 : nullptr;
+                }
+                p = p ? skipValue(p) : nullptr;
+                p = p ? skipSpace(p) : nullptr;
+                if (p && *p == ',') {
+                    p = skipSpace(p + 1);
+                } else if (p && *p != close) {
+                    return nullptr;
+                }
+            }
+            return p ? p + 1 : nullptr;
+        }
+        // number or literal
+        const char *start = p;
+        while (*p && !strchr(",]} \t\r\n/", *p)) {
+            p++;
+        }
+        return p != start ? p : nullptr;
+    }
+
+    // The value of the object's member, or null if it's not an object or has no such member.
+    static const char *findMember(const char *object, const char *name) {
+        const char *p = object ? skipSpace(object) : nullptr;
+        if (!p || *p != '{') {
+            return nullptr;
+        }
+        size_t nameLength = strlen(name);
+        p = skipSpace(p + 1);
+        while (p && *p == '"') {
+            const char *key = p + 1;
+            p = skipString(p);
+            if (!p) {
+                return nullptr;
+            }
+            bool match = static_cast<size_t>(p - 1 - key) == nameLength && !strncmp(key, name, nameLength);
+            p = skipSpace(p);
+            if (!p || *p != ':') {
+                return nullptr;
+            }
+            p = skipSpace(p + 1);
+            if (match) {
+                return p;
+            }
+            p = skipValue(p);
+            p = p ? skipSpace(p) : nullptr;
+            if (p && *p == ',') {
+                p = skipSpace(p + 1);
+            }
+        }
+        return nullptr;
+    }
+
+    static const char *arrayElement(const char *array, uint32_t index) {
+        const char *p = array ? skipSpace(array) : nullptr;
+        if (!p || *p != '[') {
+            return nullptr;
+        }
+        p = skipSpace(p + 1);
+        for (uint32_t i = 0; p && *p != ']'; i++) {
+            if (i == index) {
+                return p;
+            }
+            p = skipValue(p);
+            p = p ? skipSpace(p) : nullptr;
+            if (p && *p == ',') {
+                p = skipSpace(p + 1);
+            }
+        }
+        return nullptr;
+    }
+
+    static uint32_t arrayLength(const char *array) {
+        uint32_t length = 0;
+        while (arrayElement(array, length)) {
+            length++;
+        }
+        return length;
+    }
+
+    static bool readNumber(const char *value, float *numberOut) {
+        const char *p = value ? skipSpace(value) : nullptr;
+        if (!p) {
+            return false;
+        }
+        char *end = nullptr;
+        double number = strtod(p, &end);
+        if (end == p) {
+            return false;
+        }
+        *numberOut = static_cast<float>(number);
+        return true;
+    }
+
+    static float readNumberOr(const char *value, float fallback) {
+        float number;
+        return readNumber(value, &number) ? number : fallback;
+    }
+
+    static bool isString(const char *value, const char *text) {
+        const char *p = value ? skipSpace(value) : nullptr;
+        size_t length = strlen(text);
+        return p && *p == '"' && !strncmp(p + 1, text, length) && p[1 + length] == '"';
+    }
+
+    bool parseDisplayDistortion(const char *json, DistortionParams *paramsOut) {
+        memset(paramsOut, 0, sizeof(*paramsOut));
+        const char *display = findMember(json, "display");
+        if (display && *skipSpace(display) == '"') {
+            LOGE("[DistortionMesh] The display descriptor is a file reference; only inline ones are supported.");
+            return false;
+        }
+        const char *hmd = findMember(display, "hmd");
+        const char *distortion = findMember(hmd, "distortion");
+        if (!distortion) {
+            LOGE("[DistortionMesh] The config has no display/hmd/distortion section.");
+            return false;
+        }
+
+        paramsOut->distanceScale[0] = readNumberOr(findMember(distortion, "distance_scale_x"), 1.0f);
+        paramsOut->distanceScale[1] = readNumberOr(findMember(distortion, "distance_scale_y"), 1.0f);
+        static const char *const coefficientNames[kChannelCount] = {
+                "polynomial_coeffs_red", "polynomial_coeffs_green", "polynomial_coeffs_blue" };
+        for (int channel = 0; channel < kChannelCount; channel++) {
+            const char *coefficients = findMember(distortion, coefficientNames[channel]);
+            uint32_t count = arrayLength(coefficients);
+            if (count == 0 || count > kDistortionMaxCoefficients) {
+                LOGE("[DistortionMesh] %s needs 1 to %u coefficients.", coefficientNames[channel],
+                     kDistortionMaxCoefficients);
+                return false;
+            }
+            for (uint32_t i = 0; i < count; i++) {
+                if (!readNumber(arrayElement(coefficients, i), &paramsOut->coefficients[channel][i])) {
+                    LOGE("[DistortionMesh] %s[%u] is not a number.", coefficientNames[channel], i);
+                    return false;
+                }
+            }
+            paramsOut->coefficientCount[channel] = count;
+        }
+
+        const char *resolution = arrayElement(findMember(hmd, "resolutions"), 0);
+        const char *displayMode = findMember(resolution, "display_mode");
+        if (displayMode && !isString(displayMode, "horz_side_by_side")) {
+            LOGE("[DistortionMesh] Only horz_side_by_side displays are supported.");
+            return false;
+        }
+        paramsOut->displayWidth = static_cast<uint32_t>(readNumberOr(findMember(resolution, "width"), 1920.0f));
+        paramsOut->displayHeight = static_cast<uint32_t>(readNumberOr(findMember(resolution, "height"), 1080.0f));
+
+        const char *eyes = findMember(hmd, "eyes");
+        uint32_t eyeCount = eyes ? arrayLength(eyes) : 2;
+        paramsOut->eyeCount = eyeCount < 1 ? 1 : (eyeCount > kDistortionMaxEyes ? kDistortionMaxEyes : eyeCount);
+        for (uint32_t eye = 0; eye < paramsOut->eyeCount; eye++) {
+            const char *eyeDescriptor = arrayElement(eyes, eye);
+            paramsOut->centerOfProjection[eye][0] = readNumberOr(findMember(eyeDescriptor, "center_proj_x"), 0.5f);
+            paramsOut->centerOfProjection[eye][1] = readNumberOr(findMember(eyeDescriptor, "center_proj_y"), 0.5f);
+        }
+        return true;
+    }
+
+    static std::string displayConfigCachePath(const char *cacheDirectory, uint64_t contentHash) {
+        char name[64];
+        snprintf(name, sizeof(name), "/display_%016llx.bin", static_cast<unsigned long long>(contentHash));
+        return cacheDirectory + std::string(name);
+    }
+
+    static bool readDisplayConfigCache(const std::string &path, uint64_t contentHash, DistortionParams *paramsOut) {
+        MappedAsset file;
+        if (!mapAsset(path.c_str(), &file)) {
+            return false;
+        }
+        const DisplayConfigCacheHeader *header = reinterpret_cast<const DisplayConfigCacheHeader *>(file.data);
+        bool valid = file.bytes == sizeof(*header) + sizeof(DistortionParams) &&
+                     memcmp(header->magic, kConfigCacheMagic, sizeof(kConfigCacheMagic)) == 0 &&
+                     header->version == kDisplayConfigCacheVersion &&
+                     header->paramsBytes == sizeof(DistortionParams) && header->contentHash == contentHash;
+        if (valid) {
+            memcpy(paramsOut, header + 1, sizeof(*paramsOut));
+            valid = paramsOut->eyeCount >= 1 && paramsOut->eyeCount <= kDistortionMaxEyes;
+            for (int channel = 0; channel < kChannelCount; channel++) {
+                valid = valid && paramsOut->coefficientCount[channel] >= 1 &&
+                        paramsOut->coefficientCount[channel] <= kDistortionMaxCoefficients;
+            }
+        }
+        unmapAsset(&file);
+        return valid;
+    }
+
+    static bool writeDisplayConfigCache(const std::string &path, uint64_t contentHash,
+                                        const DistortionParams &params) {
+        DisplayConfigCacheHeader header;
+        memset(&header, 0, sizeof(header));
+        memcpy(header.magic, kConfigCacheMagic, sizeof(header.magic));
+        header.version = kDisplayConfigCacheVersion;
+        header.paramsBytes = sizeof(DistortionParams);
+        header.contentHash = contentHash;
+
+        std::string temporaryPath = path + ".tmp";
+        FILE *file = fopen(temporaryPath.c_str(), "wb");
+        if (!file) {
+            return false;
+        }
+        bool written = fwrite(&header, sizeof(header), 1, file) == 1 &&
+                       fwrite(&params, sizeof(params), 1, file) == 1;
+        written = fclose(file) == 0 && written;
+        if (!written || rename(temporaryPath.c_str(), path.c_str()) != 0) {
+            remove(temporaryPath.c_str());
+            return false;
+        }
+        return true;
+    }
+
+    bool loadDisplayDistortion(const char *path, const char *cacheDirectory, DistortionParams *paramsOut,
+                               bool *cacheHitOut) {
+        if (cacheHitOut) {
+            *cacheHitOut = false;
+        }
+        MappedAsset config;
+        if (!mapAsset(path, &config)) {
+            LOGE("[DistortionMesh] Could not open %s.", path);
+            return false;
+        }
+        uint64_t contentHash = hashAssetContents(config.data, config.bytes);
+        std::string cachePath;
+        if (cacheDirectory && *cacheDirectory) {
+            cachePath = displayConfigCachePath(cacheDirectory, contentHash);
+            if (readDisplayConfigCache(cachePath, contentHash, paramsOut)) {
+                unmapAsset(&config);
+                if (cacheHitOut) {
+                    *cacheHitOut = true;
+                }
+                return true;
+            }
+        }
+
+        // the parser wants the text terminated
+        std::string json(reinterpret_cast<const char *>(config.data), config.bytes);
+        unmapAsset(&config);
+        if (!parseDisplayDistortion(json.c_str(), paramsOut)) {
+            return false;
+        }
+        if (!cachePath.empty() && !writeDisplayConfigCache(cachePath, contentHash, *paramsOut)) {
+            LOGE("[DistortionMesh] Could not write %s.", cachePath.c_str());
+        }
+        return true;
+    }
+
+    void evaluateDistortion(const DistortionParams &params, uint32_t eye, int channel,
+                            const float *screenUV, float *textureUVOut) {
+        const float *center = params.centerOfProjection[eye];
+        double x = (screenUV[0] - center[0]) / params.distanceScale[0];
+        double y = (screenUV[1] - center[1]) / params.distanceScale[1];
+        double r = sqrt(x * x + y * y);
+        if (r == 0.0) {
+            textureUVOut[0] = center[0];
+            textureUVOut[1] = center[1];
+            return;
+        }
+        double rNew = 0.0;
+        double rPower = 1.0;
+        for (uint32_t i = 0; i < params.coefficientCount[channel]; i++) {
+            rNew += params.coefficients[channel][i] * rPower;
+            rPower *= r;
+        }
+        double scale = rNew / r;
+        textureUVOut[0] = static_cast<float>(center[0] + x * scale * params.distanceScale[0]);
+        textureUVOut[1] = static_cast<float>(center[1] + y * scale * params.distanceScale[1]);
+    }
+
+    // FNV-1a
+    static void hashBytes(uint64_t *hash, const void *data, size_t bytes) {
+        const unsigned char *p = static_cast<const unsigned char *>(data);
+        for (size_t i = 0; i < bytes; i++) {
+            *hash = (*hash ^ p[i]) * 1099511628211ull;
+        }
+    }
+
+    uint64_t distortionMeshKey(const DistortionParams &params, uint32_t gridWidth, uint32_t gridHeight) {
+        uint64_t hash = 14695981039346656037ull;
+        hashBytes(&hash, &kDistortionMeshCacheVersion, sizeof(kDistortionMeshCacheVersion));
+        hashBytes(&hash, &gridWidth, sizeof(gridWidth));
+        hashBytes(&hash, &gridHeight, sizeof(gridHeight));
+        hashBytes(&hash, &params.eyeCount, sizeof(params.eyeCount));
+        hashBytes(&hash, params.distanceScale, sizeof(params.distanceScale));
+        for (int channel = 0; channel < kChannelCount; channel++) {
+            hashBytes(&hash, &params.coefficientCount[channel], sizeof(params.coefficientCount[channel]));
+            hashBytes(&hash, params.coefficients[channel], sizeof(float) * params.coefficientCount[channel]);
+        }
+        hashBytes(&hash, params.centerOfProjection, sizeof(params.centerOfProjection[0]) * params.eyeCount);
+        hashBytes(&hash, &params.displayWidth, sizeof(params.displayWidth));
+        hashBytes(&hash, &params.displayHeight, sizeof(params.displayHeight));
+        return hash;
+    }
+
+    void buildDistortionMesh(const DistortionParams &params, uint32_t gridWidth, uint32_t gridHeight,
+                             std::vector<DistortionVertex> *verticesOut, std::vector<uint16_t> *indicesOut) {
+        uint32_t eyeVertexCount = (gridWidth + 1) * (gridHeight + 1);
+        verticesOut->resize(params.eyeCount * eyeVertexCount);
+        DistortionVertex *vertex = verticesOut->data();
+        float eyeWidth = 2.0f / params.eyeCount;
+        for (uint32_t eye = 0; eye < params.eyeCount; eye++) {
+            for (uint32_t row = 0; row <= gridHeight; row++) {
+                for (uint32_t column = 0; column <= gridWidth; column++, vertex++) {
+                    float screenUV[2] = { static_cast<float>(column) / gridWidth,
+                                          static_cast<float>(row) / gridHeight };
+                    vertex->position[0] = -1.0f + eyeWidth * (eye + screenUV[0]);
+                    vertex->position[1] = -1.0f + 2.0f * screenUV[1];
+                    for (int channel = 0; channel < kChannelCount; channel++) {
+                        evaluateDistortion(params, eye, channel, screenUV, vertex->uv[channel]);
+                    }
+                }
+            }
+        }
+
+        indicesOut->clear();
+        indicesOut->reserve(gridWidth * gridHeight * 6);
+        for (uint32_t row = 0; row < gridHeight; row++) {
+            for (uint32_t column = 0; column < gridWidth; column++) {
+                uint16_t v00 = static_cast<uint16_t>(row * (gridWidth + 1) + column);
+                uint16_t v10 = static_cast<uint16_t>(v00 + 1);
+                uint16_t v01 = static_cast<uint16_t>(v00 + gridWidth + 1);
+                uint16_t v11 = static_cast<uint16_t>(v01 + 1);
+                const uint16_t cell[6] = { v00, v10, v11, v00, v11, v01 };
+                indicesOut->insert(indicesOut->end(), cell, cell + 6);
+            }
+        }
+    }
+
+    void interpolateDistortionMesh(const DistortionVertex *eyeVertices, uint32_t gridWidth, uint32_t gridHeight,
+                                   int channel, const float *screenUV, float *textureUVOut) {
+        float x = screenUV[0] * gridWidth;
+        float y = screenUV[1] * gridHeight;
+        uint32_t column = x <= 0.0f ? 0 : (x >= gridWidth ? gridWidth - 1 : static_cast<uint32_t>(x));
+        uint32_t row = y <= 0.0f ? 0 : (y >= gridHeight ? gridHeight - 1 : static_cast<uint32_t>(y));
+        float fx = x - column;
+        float fy = y - row;
+        const float *uv00 = eyeVertices[row * (gridWidth + 1) + column].uv[channel];
+        const float *uv10 = eyeVertices[row * (gridWidth + 1) + column + 1].uv[channel];
+        const float *uv01 = eyeVertices[(row + 1) * (gridWidth + 1) + column].uv[channel];
+        const float *uv11 = eyeVertices[(row + 1) * (gridWidth + 1) + column + 1].uv[channel];
+        for (int i = 0; i < 2; i++) {
+            if (fx >= fy) {
+                // (v00, v10, v11)
+                textureUVOut[i] = uv00[i] + fx * (uv10[i] - uv00[i]) + fy * (uv11[i] - uv10[i]);
+            } else {
+                // (v00, v11, v01)
+                textureUVOut[i] = uv00[i] + fy * (uv01[i] - uv00[i]) + fx * (uv11[i] - uv01[i]);
+            }
+        }
+    }
+
+    bool writeDistortionMeshCache(const char *path, uint64_t key, uint32_t eyeCount,
+                                  uint32_t gridWidth, uint32_t gridHeight,
+                                  const std::vector<DistortionVertex> &vertices,
+                                  const std::vector<uint16_t> &indices) {
+        DistortionMeshCacheHeader header;
+        memset(&header, 0, sizeof(header));
+        memcpy(header.magic, kCacheMagic, sizeof(header.magic));
+        header.version = kDistortionMeshCacheVersion;
+        header.eyeCount = eyeCount;
+        header.key = key;
+        header.gridWidth = gridWidth;
+        header.gridHeight = gridHeight;
+        header.vertexCount = static_cast<uint32_t>(vertices.size() / eyeCount);
+        header.indexCount = static_cast<uint32_t>(indices.size());
+
+        // written aside and renamed, so a reader never maps half a file
+        std::string temporaryPath = std::string(path) + ".tmp";
+        FILE *file = fopen(temporaryPath.c_str(), "wb");
+        if (!file) {
+            LOGE("[DistortionMesh] Could not create %s.", temporaryPath.c_str());
+            return false;
+        }
+        bool written = fwrite(&header, sizeof(header), 1, file) == 1 &&
+                       fwrite(vertices.data(), sizeof(vertices[0]), vertices.size(), file) == vertices.size() &&
+                       fwrite(indices.data(), sizeof(indices[0]), indices.size(), file) == indices.size();
+        written = fclose(file) == 0 && written;
+        if (!written || rename(temporaryPath.c_str(), path) != 0) {
+            LOGE("[DistortionMesh] Could not write %s.", path);
+            remove(temporaryPath.c_str());
+            return false;
+        }
+        return true;
+    }
+
+    bool mapDistortionMeshCache(const char *path, uint64_t key, MappedDistortionMesh *meshOut) {
+        memset(meshOut, 0, sizeof(*meshOut));
+        MappedAsset file;
+        if (!mapAsset(path, &file)) {
+            return false;
+        }
+        if (file.bytes < sizeof(DistortionMeshCacheHeader)) {
+            unmapAsset(&file);
+            return false;
+        }
+        size_t bytes = file.bytes;
+
+        const DistortionMeshCacheHeader *header = reinterpret_cast<const DistortionMeshCacheHeader *>(file.data);
+        size_t expectedBytes = sizeof(*header) +
+                               static_cast<size_t>(header->eyeCount) * header->vertexCount * sizeof(DistortionVertex) +
+                               static_cast<size_t>(header->indexCount) * sizeof(uint16_t);
+        if (memcmp(header->magic, kCacheMagic, sizeof(kCacheMagic)) != 0 ||
+            header->version != kDistortionMeshCacheVersion || header->key != key ||
+            header->eyeCount == 0 || header->eyeCount > kDistortionMaxEyes || expectedBytes != bytes) {
+            unmapAsset(&file);
+            return false;
+        }
+        meshOut->file = file;
+        meshOut->header = header;
+        meshOut->vertices = reinterpret_cast<const DistortionVertex *>(header + 1);
+        meshOut->indices = reinterpret_cast<const uint16_t *>(
+                meshOut->vertices + static_cast<size_t>(header->eyeCount) * header->vertexCount);
+        return true;
+    }
+
+    void unmapDistortionMeshCache(MappedDistortionMesh *mesh) {
+        unmapAsset(&mesh->file);
+        memset(mesh, 0, sizeof(*mesh));
+    }
+
+    void setDistortionMeshConfig(const char *displayConfigPath, const char *cacheDirectory,
+                                 uint32_t gridWidth, uint32_t gridHeight) {
+        gDisplayConfigPath = displayConfigPath ? displayConfigPath : "";
+        gCacheDirectory = cacheDirectory ? cacheDirectory : "";
+        gGridWidth = gridWidth < 1 ? 1 : (gridWidth > kDistortionMaxGridSize ? kDistortionMaxGridSize : gridWidth);
+        gGridHeight = gridHeight < 1 ? 1 : (gridHeight > kDistortionMaxGridSize ? kDistortionMaxGridSize : gridHeight);
+        markGpuResourceStale("distortionMesh");
+    }
+
+    static GLuint compileShader(GLenum type, const char *prefix, const char *source) {
+        GLuint shader = glCreateShader(type);
+        if (!shader) {
+            return 0;
+        }
+        const char *sources[2] = { prefix, source };
+        glShaderSource(shader, 2, sources, nullptr);
+        glCompileShader(shader);
+        GLint compiled = 0;
+        glGetShaderiv(shader, GL_COMPILE_STATUS, &compiled);
+        if (!compiled) {
+            char log[512] = {0};
+            glGetShaderInfoLog(shader, sizeof(log), nullptr, log);
+            LOGE("[DistortionMesh] Could not compile shader %d:\n%s", type, log);
+            glDeleteShader(shader);
+            return 0;
+        }
+        return shader;
+    }
+
+    static GLuint createMeshProgram(const char *vertexSource, const char *fragmentPrefix,
+                                    const char *fragmentSource) {
+        GLuint vertexShader = compileShader(GL_VERTEX_SHADER, "", vertexSource);
+        GLuint fragmentShader = compileShader(GL_FRAGMENT_SHADER, fragmentPrefix, fragmentSource);
+        if (!vertexShader || !fragmentShader) {
+            glDeleteShader(vertexShader);
+            glDeleteShader(fragmentShader);
+            return 0;
+        }
+        GLuint program = glCreateProgram();
+        glAttachShader(program, vertexShader);
+        glAttachShader(program, fragmentShader);
+        glBindAttribLocation(program, 0, "position");
+        glBindAttribLocation(program, 1, "uvRed");
+        glBindAttribLocation(program, 2, "uvGreen");
+        glBindAttribLocation(program, 3, "uvBlue");
+        glLinkProgram(program);
+        glDeleteShader(vertexShader);
+        glDeleteShader(fragmentShader);
+        GLint linked = GL_FALSE;
+        glGetProgramiv(program, GL_LINK_STATUS, &linked);
+        if (linked != GL_TRUE) {
+            char log[512] = {0};
+            glGetProgramInfoLog(program, sizeof(log), nullptr, log);
+            LOGE("[DistortionMesh] Could not link program:\n%s", log);
+            glDeleteProgram(program);
+            return 0;
+        }
+        glUseProgram(program);
+        glUniform1i(glGetUniformLocation(program, "source"), 0);
+        return program;
+    }
+
+    static void uploadMesh(const DistortionVertex *vertices, size_t vertexCount,
+                           const uint16_t *indices, size_t indexCount) {
+        glGenBuffers(1, &gVertexBuffer);
+        glBindBuffer(GL_ARRAY_BUFFER, gVertexBuffer);
+        glBufferData(GL_ARRAY_BUFFER, vertexCount * sizeof(vertices[0]), vertices, GL_STATIC_DRAW);
+        glGenBuffers(1, &gIndexBuffer);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, gIndexBuffer);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indexCount * sizeof(indices[0]), indices, GL_STATIC_DRAW);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        trackGpuObject(GPU_OBJECT_BUFFER, gVertexBuffer, GPU_MEMORY_BUFFERS, vertexCount * sizeof(vertices[0]));
+        trackGpuObject(GPU_OBJECT_BUFFER, gIndexBuffer, GPU_MEMORY_BUFFERS, indexCount * sizeof(indices[0]));
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+    }
+
+    bool setupDistortionMesh() {
+        // names from an earlier context are gone with it
+        gMeshProgram = gLayerPrograms[0] = gLayerPrograms[1] = 0;
+        gVertexBuffer = gIndexBuffer = 0;
+        gMeshVertices.clear();
+        if (gDisplayConfigPath.empty()) {
+            return false;
+        }
+
+        uint64_t startNs = frameStatsNowNs();
+        DistortionParams params;
+        bool configCached = false;
+        if (!loadDisplayDistortion(gDisplayConfigPath.c_str(), gCacheDirectory.c_str(), &params, &configCached)) {
+            return false;
+        }
+        uint64_t key = distortionMeshKey(params, gGridWidth, gGridHeight);
+        std::string cachePath;
+        if (!gCacheDirectory.empty()) {
+            char name[64];
+            snprintf(name, sizeof(name), "/distortion_%016llx.bin", static_cast<unsigned long long>(key));
+            cachePath = gCacheDirectory + name;
+        }
+
+        MappedDistortionMesh mapped;
+        if (!cachePath.empty() && mapDistortionMeshCache(cachePath.c_str(), key, &mapped)) {
+            gMeshEyeCount = mapped.header->eyeCount;
+            gMeshVertexCount = mapped.header->vertexCount;
+            gMeshIndexCount = mapped.header->indexCount;
+            uploadMesh(mapped.vertices, static_cast<size_t>(gMeshEyeCount) * gMeshVertexCount,
+                       mapped.indices, gMeshIndexCount);
+            gMeshVertices.assign(mapped.vertices,
+                                 mapped.vertices + static_cast<size_t>(gMeshEyeCount) * gMeshVertexCount);
+            unmapDistortionMeshCache(&mapped);
+            LOGI("[DistortionMesh] Mapped %ux%u mesh from %s.", gGridWidth, gGridHeight, cachePath.c_str());
+        } else {
+            std::vector<DistortionVertex> vertices;
+            std::vector<uint16_t> indices;
+            buildDistortionMesh(params, gGridWidth, gGridHeight, &vertices, &indices);
+            gMeshEyeCount = params.eyeCount;
+            gMeshVertexCount = static_cast<uint32_t>(vertices.size() / params.eyeCount);
+            gMeshIndexCount = static_cast<uint32_t>(indices.size());
+            uploadMesh(vertices.data(), vertices.size(), indices.data(), indices.size());
+            gMeshVertices.swap(vertices);
+            if (!cachePath.empty() && writeDistortionMeshCache(cachePath.c_str(), key, params.eyeCount,
+                                                               gGridWidth, gGridHeight, gMeshVertices, indices)) {
+                LOGI("[DistortionMesh] Built %ux%u mesh; cached as %s.", gGridWidth, gGridHeight, cachePath.c_str());
+            } else {
+                LOGI("[DistortionMesh] Built %ux%u mesh.", gGridWidth, gGridHeight);
+            }
+        }
+
+        gMeshProgram = createMeshProgram(gMeshVertexShader, "", gMeshFragmentShader);
+        if (gMeshProgram) {
+            gMeshEyeScaleUniform = glGetUniformLocation(gMeshProgram, "eyeScale");
+        }
+        gLayerPrograms[0] = createMeshProgram(gLayerVertexShader, kLayerSampler2D, gLayerFragmentShader);
+        if (hasGLExtension("GL_OES_EGL_image_external")) {
+            gLayerPrograms[1] = createMeshProgram(gLayerVertexShader, kLayerSamplerExternal, gLayerFragmentShader);
+        }
+        for (int external = 0; external < 2; external++) {
+            if (gLayerPrograms[external]) {
+                gLayerHomographyUniforms[external] = glGetUniformLocation(gLayerPrograms[external], "layerFromEye");
+            }
+        }
+        LOGI("[DistortionMesh] Ready in %.3f ms (display config %s).", (frameStatsNowNs() - startNs) / 1.0e6,
+             configCached ? "from the cache" : "parsed");
+        return gMeshProgram != 0;
+    }
+
+    void releaseDistortionMesh() {
+        glDeleteProgram(gMeshProgram);
+        glDeleteProgram(gLayerPrograms[0]);
+        glDeleteProgram(gLayerPrograms[1]);
+        glDeleteBuffers(1, &gVertexBuffer);
+        glDeleteBuffers(1, &gIndexBuffer);
+        forgetGpuObject(GPU_OBJECT_BUFFER, gVertexBuffer);
+        forgetGpuObject(GPU_OBJECT_BUFFER, gIndexBuffer);
+        gMeshProgram = gLayerPrograms[0] = gLayerPrograms[1] = 0;
+        gVertexBuffer = gIndexBuffer = 0;
+        gMeshVertices.clear();
+    }
+
+    bool isDistortionMeshReady() {
+        return gMeshProgram != 0;
+    }
+
+    static void drawEyeMesh(uint32_t eye, GLenum target, GLuint texture) {
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(target, texture);
+        glBindBuffer(GL_ARRAY_BUFFER, gVertexBuffer);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, gIndexBuffer);
+        size_t eyeOffset = static_cast<size_t>(eye) * gMeshVertexCount * sizeof(DistortionVertex);
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, sizeof(DistortionVertex),
+                              reinterpret_cast<const void *>(eyeOffset + offsetof(DistortionVertex, position)));
+        for (int channel = 0; channel < kChannelCount; channel++) {
+            GLuint attribute = static_cast<GLuint>(1 + channel);
+            glEnableVertexAttribArray(attribute);
+            glVertexAttribPointer(attribute, 2, GL_FLOAT, GL_FALSE, sizeof(DistortionVertex),
+                                  reinterpret_cast<const void *>(eyeOffset + offsetof(DistortionVertex, uv) +
+                                                                 channel * sizeof(float) * 2));
+        }
+        glDrawElements(GL_TRIANGLES, static_cast<GLsizei>(gMeshIndexCount), GL_UNSIGNED_SHORT, nullptr);
+        for (GLuint attribute = 0; attribute <= kChannelCount; attribute++) {
+            glDisableVertexAttribArray(attribute);
+        }
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+    }
+
+    void drawDistortionMesh(uint32_t eye, GLuint texture, float eyeScale) {
+        if (!gMeshProgram || eye >= gMeshEyeCount) {
+            return;
+        }
+        glUseProgram(gMeshProgram);
+        glUniform1f(gMeshEyeScaleUniform, eyeScale);
+        drawEyeMesh(eye, GL_TEXTURE_2D, texture);
+    }
+
+    bool getDistortionMeshFootprint(uint32_t eye, const float *uvMin, const float *uvMax,
+                                    int windowWidth, int windowHeight, int *rectOut) {
+        if (gMeshVertices.empty() || eye >= gMeshEyeCount) {
+            return false;
+        }
+        const DistortionVertex *vertices = gMeshVertices.data() + static_cast<size_t>(eye) * gMeshVertexCount;
+        uint32_t rowVertices = gGridWidth + 1;
+        float positionMin[2] = { 1.0f, 1.0f };
+        float positionMax[2] = { -1.0f, -1.0f };
+        for (uint32_t row = 0; row < gGridHeight; row++) {
+            for (uint32_t column = 0; column < gGridWidth; column++) {
+                const DistortionVertex *corners[4] = {
+                        &vertices[row * rowVertices + column], &vertices[row * rowVertices + column + 1],
+                        &vertices[(row + 1) * rowVertices + column], &vertices[(row + 1) * rowVertices + column + 1] };
+                // a cell is in if any channel's coordinates reach into the box
+                float cellMin[2] = { corners[0]->uv[0][0], corners[0]->uv[0][1] };
+                float cellMax[2] = { cellMin[0], cellMin[1] };
+                for (int corner = 0; corner < 4; corner++) {
+                    for (int channel = 0; channel < kChannelCount; channel++) {
+                        for (int axis = 0; axis < 2; axis++) {
+                            float value = corners[corner]->uv[channel][axis];
+                            cellMin[axis] = value < cellMin[axis] ? value : cellMin[axis];
+                            cellMax[axis] = value > cellMax[axis] ? value : cellMax[axis];
+                        }
+                    }
+                }
+                if (cellMax[0] < uvMin[0] || cellMin[0] > uvMax[0] ||
+                    cellMax[1] < uvMin[1] || cellMin[1] > uvMax[1]) {
+                    continue;
+                }
+                for (int corner = 0; corner < 4; corner++) {
+                    for (int axis = 0; axis < 2; axis++) {
+                        float value = corners[corner]->position[axis];
+                        positionMin[axis] = value < positionMin[axis] ? value : positionMin[axis];
+                        positionMax[axis] = value > positionMax[axis] ? value : positionMax[axis];
+                    }
+                }
+            }
+        }
+        if (positionMin[0] >= positionMax[0] || positionMin[1] >= positionMax[1]) {
+            return false;
+        }
+        int left = static_cast<int>(floorf((positionMin[0] * 0.5f + 0.5f) * windowWidth));
+        int bottom = static_cast<int>(floorf((positionMin[1] * 0.5f + 0.5f) * windowHeight));
+        int right = static_cast<int>(ceilf((positionMax[0] * 0.5f + 0.5f) * windowWidth));
+        int top = static_cast<int>(ceilf((positionMax[1] * 0.5f + 0.5f) * windowHeight));
+        rectOut[0] = left < 0 ? 0 : left;
+        rectOut[1] = bottom < 0 ? 0 : bottom;
+        rectOut[2] = (right > windowWidth ? windowWidth : right) - rectOut[0];
+        rectOut[3] = (top > windowHeight ? windowHeight : top) - rectOut[1];
+        return rectOut[2] > 0 && rectOut[3] > 0;
+    }
+
+    void drawDistortionMeshLayer(uint32_t eye, GLenum target, GLuint texture, const float *layerFromEye) {
+        int external = target == GL_TEXTURE_EXTERNAL_OES ? 1 : 0;
+        if (!gLayerPrograms[external] || eye >= gMeshEyeCount) {
+            return;
+        }
+        glUseProgram(gLayerPrograms[external]);
+        glUniformMatrix3fv(gLayerHomographyUniforms[external], 1, GL_FALSE, layerFromEye);
+        glEnable(GL_BLEND);
+        glBlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+        drawEyeMesh(eye, target, texture);
+        glDisable(GL_BLEND);
+    }
+}
@@ -0,0 +1,171 @@
+/*
+ * Copyright (C) 2015 Sensics, Inc. and contributors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef OSVROPENGL_DISTORTIONMESH_H
+#define OSVROPENGL_DISTORTIONMESH_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <GLES2/gl2.h>
+
+#include "Asset.h"
+
+namespace OSVROpenGL {
+
+    // Lens distortion as a precomputed mesh. The display descriptor's
+    // distortion (the "display" section of osvr_server_config.json) is fixed
+    // per device profile, so instead of evaluating the polynomials per pixel
+    // every frame, a grid over each eye's part of the screen is warped once
+    // with per-channel texture coordinates (the channels differ to undo the
+    // lens' chromatic aberration) and the eye buffers are drawn through it.
+    //
+    // The mesh is cached in a binary file named after a hash of the parsed
+    // descriptor and the grid size, and later launches mmap it instead of
+    // building it again. The file, in native byte order:
+    //
+    //   DistortionMeshCacheHeader (40 bytes)
+    //   DistortionVertex[eyeCount * (gridWidth + 1) * (gridHeight + 1)], eye by eye, row by row
+    //   uint16_t[gridWidth * gridHeight * 6] indices, the same for every eye
+    //
+    // The parsed descriptor is cached too, next to the mesh, in a file named
+    // after a hash of the config file's bytes (DisplayConfigCacheHeader and
+    // then the DistortionParams), so a launch with an unchanged config only
+    // hashes it instead of parsing it.
+    //
+    // The model is RenderManager's rgb_symmetric_polynomials: for a screen
+    // point p in an eye's [0,1] viewport space, with d = (p - cop) / scale,
+    // r = |d| and the channel's coefficients c, the texture coordinate is
+    // cop + scale * d * (sum c[i] r^i) / r.
+
+    static const uint32_t kDistortionMaxEyes = 2;
+    static const uint32_t kDistortionMaxCoefficients = 8;
+    static const uint32_t kDistortionMeshCacheVersion = 1;
+    static const uint32_t kDisplayConfigCacheVersion = 1;
+    // The largest grid whose per-eye vertices a uint16_t index can reach.
+    static const uint32_t kDistortionMaxGridSize = 255;
+
+    struct DistortionParams {
+        uint32_t eyeCount;
+        float distanceScale[2];
+        uint32_t coefficientCount[3];                       // red, green, blue
+        float coefficients[3][kDistortionMaxCoefficients];
+        float centerOfProjection[kDistortionMaxEyes][2];
+        uint32_t displayWidth;                              // all eyes, in pixels
+        uint32_t displayHeight;
+    };
+
+    struct DistortionVertex {
+        float position[2];      // clip space, with the eye's part of the screen baked in
+        float uv[3][2];         // red, green and blue texture coordinates
+    };
+
+    struct DistortionMeshCacheHeader {
+        char magic[8];          // "OSVRDMC1"
+        uint32_t version;
+        uint32_t eyeCount;
+        uint64_t key;           // distortionMeshKey()
+        uint32_t gridWidth;
+        uint32_t gridHeight;
+        uint32_t vertexCount;   // per eye
+        uint32_t indexCount;
+    };
+
+    struct DisplayConfigCacheHeader {
+        char magic[8];          // "OSVRDCC1"
+        uint32_t version;
+        uint32_t paramsBytes;   // sizeof(DistortionParams)
+        uint64_t contentHash;   // hashAssetContents() of the config file
+    };
+
+    // Reads the distortion out of a server config's inline display descriptor.
+    // Comments are allowed, as the sample config has them. False (and logged)
+    // when something is missing, e.g. a descriptor that is a file reference.
+    bool parseDisplayDistortion(const char *json, DistortionParams *paramsOut);
+    // The same from a file or "asset:" path (see Asset.h). With a cache
+    // directory, uses the parsed descriptor cached there for these exact
+    // config bytes, or parses and caches it. cacheHitOut may be null.
+    bool loadDisplayDistortion(const char *path, const char *cacheDirectory, DistortionParams *paramsOut,
+                               bool *cacheHitOut);
+
+    // Where the channel's texture coordinate for a point in the eye's [0,1]
+    // viewport space comes from, straight from the polynomial.
+    void evaluateDistortion(const DistortionParams &params, uint32_t eye, int channel,
+                            const float *screenUV, float *textureUVOut);
+
+    // Identifies a mesh: every parameter that goes into it, the grid and the format version.
+    uint64_t distortionMeshKey(const DistortionParams &params, uint32_t gridWidth, uint32_t gridHeight);
+
+    // Grid cells are split into two triangles along the diagonal from their
+    // lower left corner.
+    void buildDistortionMesh(const DistortionParams &params, uint32_t gridWidth, uint32_t gridHeight,
+                             std::vector<DistortionVertex> *verticesOut, std::vector<uint16_t> *indicesOut);
+
+    // The channel's texture coordinate as the GPU interpolates it across the
+    // mesh of the given eye (whose vertices start at eyeVertices).
+    void interpolateDistortionMesh(const DistortionVertex *eyeVertices, uint32_t gridWidth, uint32_t gridHeight,
+                                   int channel, const float *screenUV, float *textureUVOut);
+
+    bool writeDistortionMeshCache(const char *path, uint64_t key, uint32_t eyeCount,
+                                  uint32_t gridWidth, uint32_t gridHeight,
+                                  const std::vector<DistortionVertex> &vertices,
+                                  const std::vector<uint16_t> &indices);
+
+    // A cache file mapped read-only. Valid until unmapDistortionMeshCache().
+    struct MappedDistortionMesh {
+        MappedAsset file;
+        const DistortionMeshCacheHeader *header;
+        const DistortionVertex *vertices;
+        const uint16_t *indices;
+    };
+
+    // Maps the file if it is there and holds the mesh for key; false otherwise.
+    bool mapDistortionMeshCache(const char *path, uint64_t key, MappedDistortionMesh *meshOut);
+    void unmapDistortionMeshCache(MappedDistortionMesh *mesh);
+
+    // Where setupDistortionMesh() gets its descriptor and keeps its cache, and
+    // the grid (default 32x32). No config (the default) means RenderManager
+    // does the distortion. Call while the GL thread is paused or not yet
+    // started; applied at the next surface change.
+    void setDistortionMeshConfig(const char *displayConfigPath, const char *cacheDirectory,
+                                 uint32_t gridWidth, uint32_t gridHeight);
+
+    // Loads or builds the configured mesh into GL buffers. GL thread only.
+    bool setupDistortionMesh();
+    // Deletes the mesh and its program; RenderManager does the distortion again. GL thread only.
+    void releaseDistortionMesh();
+    // True once setupDistortionMesh() has a mesh to present with.
+    bool isDistortionMeshReady();
+    // Draws an eye buffer through its mesh into the current framebuffer,
+    // whose viewport must cover the whole display. The eye was drawn into the
+    // eyeScale by eyeScale corner of the buffer, at the origin (1 for all of it).
+    void drawDistortionMesh(uint32_t eye, GLuint texture, float eyeScale);
+    // Draws a layer (see Layers.h) through the eye's mesh, blended over what
+    // is there. layerFromEye is a column-major 3x3 taking the eye's texture
+    // coordinates to the layer's, homogeneous; the layer covers what lands
+    // in [0,1] with a positive third coordinate. target is GL_TEXTURE_2D or,
+    // where GL_OES_EGL_image_external is, GL_TEXTURE_EXTERNAL_OES.
+    void drawDistortionMeshLayer(uint32_t eye, GLenum target, GLuint texture, const float *layerFromEye);
+    // The part of a windowWidth x windowHeight window (x, y, width, height)
+    // where the eye's mesh draws texture coordinates from the box [uvMin,
+    // uvMax], to the grid cell; false if it draws none of them. GL thread only.
+    bool getDistortionMeshFootprint(uint32_t eye, const float *uvMin, const float *uvMax,
+                                    int windowWidth, int windowHeight, int *rectOut);
+}
+
+#endif // OSVROPENGL_DISTORTIONMESH_H
@@ -0,0 +1,93 @@
+/*
+ * Copyright (C) 2015 Sensics, Inc. and contributors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include <EGL/egl.h>
+
+#include "Logging.h"
+#include "GLExtensions.h"
+#include "EGLFence.h"
+
+// Not every NDK platform's eglext.h has KHR_fence_sync, so the entry points and
+// enums are declared here.
+#ifndef EGL_SYNC_FENCE_KHR
+#define EGL_SYNC_FENCE_KHR 0x30F9
+#endif
+#ifndef EGL_SYNC_FLUSH_COMMANDS_BIT_KHR
+#define EGL_SYNC_FLUSH_COMMANDS_BIT_KHR 0x0001
+#endif
+#ifndef EGL_CONDITION_SATISFIED_KHR
+#define EGL_CONDITION_SATISFIED_KHR 0x30F6
+#endif
+
+namespace OSVROpenGL {
+
+    typedef EGLFence (EGLAPIENTRY *CreateSyncFn)(EGLDisplay display, EGLenum type, const EGLint *attribs);
+    typedef EGLBoolean (EGLAPIENTRY *DestroySyncFn)(EGLDisplay display, EGLFence sync);
+    typedef EGLint (EGLAPIENTRY *ClientWaitSyncFn)(EGLDisplay display, EGLFence sync, EGLint flags, uint64_t timeout);
+
+    static EGLDisplay gFenceDisplay = EGL_NO_DISPLAY;
+    static CreateSyncFn gCreateSync = nullptr;
+    static DestroySyncFn gDestroySync = nullptr;
+    static ClientWaitSyncFn gClientWaitSync = nullptr;
+
+    bool initEGLFences() {
+        gCreateSync = nullptr;
+        gFenceDisplay = eglGetCurrentDisplay();
+        if (gFenceDisplay == EGL_NO_DISPLAY || !hasEGLExtension(gFenceDisplay, "EGL_KHR_fence_sync")) {
+            LOGI("[EGLFence] EGL_KHR_fence_sync not supported.");
+            return false;
+        }
+        CreateSyncFn createSync = (CreateSyncFn) eglGetProcAddress("eglCreateSyncKHR");
+        gDestroySync = (DestroySyncFn) eglGetProcAddress("eglDestroySyncKHR");
+        gClientWaitSync = (ClientWaitSyncFn) eglGetProcAddress("eglClientWaitSyncKHR");
+        if (!createSync || !gDestroySync || !gClientWaitSync) {
+            LOGE("[EGLFence] Missing EGL_KHR_fence_sync entry points.");
+            return false;
+        }
+        gCreateSync = createSync;
+        return true;
+    }
+
+    bool haveEGLFences() {
+        return gCreateSync != nullptr;
+    }
+
+    EGLFence createEGLFence() {
+        if (!gCreateSync) {
+            return nullptr;
+        }
+        return gCreateSync(gFenceDisplay, EGL_SYNC_FENCE_KHR, nullptr);
+    }
+
+    void destroyEGLFence(EGLFence fence) {
+        if (fence && gCreateSync) {
+            gDestroySync(gFenceDisplay, fence);
+        }
+    }
+
+    bool isEGLFenceSignaled(EGLFence fence) {
+        return waitEGLFence(fence, 0);
+    }
+
+    bool waitEGLFence(EGLFence fence, uint64_t timeoutNs) {
+        if (!fence || !gCreateSync) {
+            return true;
+        }
+        return gClientWaitSync(gFenceDisplay, fence, EGL_SYNC_FLUSH_COMMANDS_BIT_KHR, timeoutNs) ==
+               EGL_CONDITION_SATISFIED_KHR;
+    }
+}
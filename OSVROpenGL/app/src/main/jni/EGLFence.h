@@ -0,0 +1,46 @@
+/*
+ * Copyright (C) 2015 Sensics, Inc. and contributors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef OSVROPENGL_EGLFENCE_H
+#define OSVROPENGL_EGLFENCE_H
+
+#include <cstdint>
+
+namespace OSVROpenGL {
+
+    // Thin wrapper over EGL_KHR_fence_sync, shared by everything that needs to
+    // know when the GPU got past a point in the command stream. Fences belong
+    // to the display that was current when initEGLFences() ran.
+    typedef void *EGLFence;
+
+    // Looks up the extension on the current display. Call on the GL thread with
+    // a current context, and again after the context has been recreated (any
+    // fences from before are forgotten, not destroyed).
+    bool initEGLFences();
+    bool haveEGLFences();
+
+    // Null when fences aren't supported.
+    EGLFence createEGLFence();
+    void destroyEGLFence(EGLFence fence);
+
+    // Non-blocking check. Also flushes, so the fence is sure to signal eventually.
+    bool isEGLFenceSignaled(EGLFence fence);
+    // Blocks until the fence signals or timeoutNs passes; true if it signalled.
+    bool waitEGLFence(EGLFence fence, uint64_t timeoutNs);
+}
+
+#endif // OSVROPENGL_EGLFENCE_H
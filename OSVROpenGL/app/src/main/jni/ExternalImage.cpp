@@ -0,0 +1,468 @@
+/*
+ * Copyright (C) 2015 Sensics, Inc. and contributors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include <atomic>
+#include <cstring>
+#include <mutex>
+
+#include <EGL/egl.h>
+#include <GLES2/gl2.h>
+#include <GLES2/gl2ext.h>
+
+#include "Logging.h"
+#include "ExternalImage.h"
+#include "FrameStats.h"
+#include "GLExtensions.h"
+#include "GpuMemory.h"
+
+// Not every NDK platform's headers have these, so they are declared here.
+#ifndef EGL_IMAGE_PRESERVED_KHR
+#define EGL_IMAGE_PRESERVED_KHR 0x30D2
+#endif
+#ifndef EGL_NATIVE_BUFFER_ANDROID
+#define EGL_NATIVE_BUFFER_ANDROID 0x3140
+#endif
+#ifndef EGL_LINUX_DMA_BUF_EXT
+#define EGL_LINUX_DMA_BUF_EXT 0x3270
+#define EGL_LINUX_DRM_FOURCC_EXT 0x3271
+#define EGL_DMA_BUF_PLANE0_FD_EXT 0x3272
+#define EGL_DMA_BUF_PLANE0_OFFSET_EXT 0x3273
+#define EGL_DMA_BUF_PLANE0_PITCH_EXT 0x3274
+#endif
+#ifndef GL_TEXTURE_EXTERNAL_OES
+#define GL_TEXTURE_EXTERNAL_OES 0x8D65
+#endif
+
+namespace OSVROpenGL {
+
+    typedef void *(EGLAPIENTRY *CreateImageFn)(EGLDisplay display, EGLContext context, EGLenum target,
+                                                EGLClientBuffer buffer, const EGLint *attribs);
+    typedef EGLBoolean (EGLAPIENTRY *DestroyImageFn)(EGLDisplay display, void *image);
+    typedef void (GL_APIENTRYP ImageTargetTextureFn)(GLenum target, void *image);
+    typedef EGLClientBuffer (EGLAPIENTRY *GetNativeClientBufferFn)(const void *buffer);
+
+    // How long latching waits for the producer's own fence before using the frame anyway.
+    static const uint64_t kReadyFenceTimeoutNs = 100000000;
+    static const uint64_t kFenceWaitForever = ~0ull;
+
+    enum ExternalSlotState {
+        SLOT_UNUSED,
+        SLOT_FREE,          // the producer's to acquire, once its release fence signals
+        SLOT_PRODUCING,     // acquired
+        SLOT_QUEUED,        // the newest frame, not yet latched
+        SLOT_LATCHED        // bound to the stream's texture
+    };
+
+    struct ExternalSlot {
+        ExternalBuffer buffer;
+        ExternalSlotState state;
+        void *image;            // our EGLImage of it, made at its first latch
+        bool importFailed;
+        EGLFence releaseFence;  // after the last draw that sampled it
+        EGLFence readyFence;    // the producer's
+        uint64_t producedNs;
+    };
+
+    struct ExternalStream {
+        ExternalSlot slots[kMaxExternalBuffers];
+        GLuint importTexture;   // GL_TEXTURE_EXTERNAL_OES
+        GLuint uploadTexture;   // GL_TEXTURE_2D
+        uint32_t uploadWidth;
+        uint32_t uploadHeight;
+        bool hasFrame;
+        ExternalImageFrame frame;
+    };
+
+    // Slots are shared with producers under the mutex. The latched slot is
+    // only ever touched by the GL thread, so it is imported without it.
+    static std::mutex gStreamMutex;
+    static ExternalStream gStreams[kMaxExternalImageStreams];
+
+    static EGLDisplay gImageDisplay = EGL_NO_DISPLAY;
+    static CreateImageFn gCreateImage = nullptr;
+    static DestroyImageFn gDestroyImage = nullptr;
+    static ImageTargetTextureFn gImageTargetTexture = nullptr;
+    static GetNativeClientBufferFn gGetNativeClientBuffer = nullptr;
+    static bool gCanImport = false;
+    static bool gCanImportDmaBufs = false;
+
+    static std::atomic<uint64_t> gLatched(0);
+    static std::atomic<uint64_t> gImported(0);
+    static std::atomic<uint64_t> gUploaded(0);
+    static std::atomic<uint64_t> gReplaced(0);
+    static std::atomic<uint64_t> gBytesNotCopied(0);
+    static std::atomic<uint64_t> gProducerWaits(0);
+    static std::atomic<uint64_t> gLatencyNs(0);
+    static std::atomic<uint64_t> gMaxLatencyNs(0);
+    static std::atomic<uint64_t> gLatchNs(0);
+
+    static void destroySlotImage(ExternalSlot *slot) {
+        // a producer's own EGLImage stays theirs
+        if (slot->image && slot->buffer.type != EXTERNAL_BUFFER_EGL_IMAGE && gDestroyImage) {
+            gDestroyImage(gImageDisplay, slot->image);
+        }
+        slot->image = nullptr;
+        slot->importFailed = false;
+    }
+
+    int registerExternalBuffer(uint32_t stream, const ExternalBuffer &buffer) {
+        if (stream >= kMaxExternalImageStreams) {
+            return -1;
+        }
+        std::lock_guard<std::mutex> lock(gStreamMutex);
+        for (uint32_t i = 0; i < kMaxExternalBuffers; i++) {
+            ExternalSlot &slot = gStreams[stream].slots[i];
+            if (slot.state == SLOT_UNUSED) {
+                memset(&slot, 0, sizeof(slot));
+                slot.buffer = buffer;
+                slot.state = SLOT_FREE;
+                return static_cast<int>(i);
+            }
+        }
+        LOGE("[ExternalImage] Stream %u already has %u buffers.", stream, kMaxExternalBuffers);
+        return -1;
+    }
+
+    void unregisterExternalBuffer(uint32_t stream, int slotIndex) {
+        if (stream >= kMaxExternalImageStreams || slotIndex < 0 || slotIndex >= static_cast<int>(kMaxExternalBuffers)) {
+            return;
+        }
+        std::lock_guard<std::mutex> lock(gStreamMutex);
+        ExternalSlot &slot = gStreams[stream].slots[slotIndex];
+        if (slot.state == SLOT_LATCHED) {
+            LOGE("[ExternalImage] Buffer %d of stream %u is still the renderer's.", slotIndex, stream);
+            return;
+        }
+        // the producer frees the buffer next, so the GPU has to be done with it
+        waitEGLFence(slot.releaseFence, kFenceWaitForever);
+        destroySlotImage(&slot);
+        destroyEGLFence(slot.releaseFence);
+        destroyEGLFence(slot.readyFence);
+        memset(&slot, 0, sizeof(slot));
+    }
+
+    int acquireExternalBuffer(uint32_t stream, uint64_t timeoutNs) {
+        if (stream >= kMaxExternalImageStreams) {
+            return -1;
+        }
+        int chosen = -1;
+        EGLFence fence = nullptr;
+        {
+            std::lock_guard<std::mutex> lock(gStreamMutex);
+            ExternalSlot *slots = gStreams[stream].slots;
+            // one the GPU is already done with, or else the first free one to wait for
+            for (uint32_t i = 0; i < kMaxExternalBuffers && chosen < 0; i++) {
+                if (slots[i].state == SLOT_FREE &&
+                    (!slots[i].releaseFence || isEGLFenceSignaled(slots[i].releaseFence))) {
+                    chosen = static_cast<int>(i);
+                }
+            }
+            for (uint32_t i = 0; i < kMaxExternalBuffers && chosen < 0; i++) {
+                if (slots[i].state == SLOT_FREE) {
+                    chosen = static_cast<int>(i);
+                }
+            }
+            if (chosen < 0) {
+                gProducerWaits.fetch_add(1, std::memory_order_relaxed);
+                return -1;
+            }
+            slots[chosen].state = SLOT_PRODUCING;
+            fence = slots[chosen].releaseFence;
+            slots[chosen].releaseFence = nullptr;
+        }
+        if (fence && !waitEGLFence(fence, timeoutNs)) {
+            std::lock_guard<std::mutex> lock(gStreamMutex);
+            gStreams[stream].slots[chosen].state = SLOT_FREE;
+            gStreams[stream].slots[chosen].releaseFence = fence;
+            gProducerWaits.fetch_add(1, std::memory_order_relaxed);
+            return -1;
+        }
+        destroyEGLFence(fence);
+        return chosen;
+    }
+
+    void queueExternalBuffer(uint32_t stream, int slotIndex, uint64_t producedNs, EGLFence readyFence) {
+        if (stream >= kMaxExternalImageStreams || slotIndex < 0 || slotIndex >= static_cast<int>(kMaxExternalBuffers)) {
+            destroyEGLFence(readyFence);
+            return;
+        }
+        std::lock_guard<std::mutex> lock(gStreamMutex);
+        ExternalSlot *slots = gStreams[stream].slots;
+        if (slots[slotIndex].state != SLOT_PRODUCING) {
+            LOGE("[ExternalImage] Buffer %d of stream %u was queued without being acquired.", slotIndex, stream);
+            destroyEGLFence(readyFence);
+            return;
+        }
+        // the GPU never saw a frame that is replaced before it is latched
+        for (uint32_t i = 0; i < kMaxExternalBuffers; i++) {
+            if (slots[i].state == SLOT_QUEUED) {
+                destroyEGLFence(slots[i].readyFence);
+                slots[i].readyFence = nullptr;
+                slots[i].state = SLOT_FREE;
+                gReplaced.fetch_add(1, std::memory_order_relaxed);
+            }
+        }
+        slots[slotIndex].state = SLOT_QUEUED;
+        slots[slotIndex].producedNs = producedNs;
+        slots[slotIndex].readyFence = readyFence;
+    }
+
+    static GLuint createStreamTexture(GLenum target) {
+        GLuint texture = 0;
+        glGenTextures(1, &texture);
+        glBindTexture(target, texture);
+        glTexParameteri(target, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(target, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(target, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(target, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glBindTexture(target, 0);
+        return texture;
+    }
+
+    bool initExternalImages() {
+        gImageDisplay = eglGetCurrentDisplay();
+        gCreateImage = (CreateImageFn) eglGetProcAddress("eglCreateImageKHR");
+        gDestroyImage = (DestroyImageFn) eglGetProcAddress("eglDestroyImageKHR");
+        gImageTargetTexture = (ImageTargetTextureFn) eglGetProcAddress("glEGLImageTargetTexture2DOES");
+        gCanImport = gImageDisplay != EGL_NO_DISPLAY && gCreateImage && gDestroyImage && gImageTargetTexture &&
+                     hasEGLExtension(gImageDisplay, "EGL_KHR_image_base") &&
+                     hasGLExtension("GL_OES_EGL_image_external");
+        gGetNativeClientBuffer = nullptr;
+        if (gCanImport && hasEGLExtension(gImageDisplay, "EGL_ANDROID_image_native_buffer")) {
+            // Android 8 and later; looked up as the app targets older platforms
+            gGetNativeClientBuffer = (GetNativeClientBufferFn) eglGetProcAddress("eglGetNativeClientBufferANDROID");
+        }
+        gCanImportDmaBufs = gCanImport && hasEGLExtension(gImageDisplay, "EGL_EXT_image_dma_buf_import");
+
+        std::lock_guard<std::mutex> lock(gStreamMutex);
+        for (uint32_t i = 0; i < kMaxExternalImageStreams; i++) {
+            ExternalStream &stream = gStreams[i];
+            stream.importTexture = gCanImport ? createStreamTexture(GL_TEXTURE_EXTERNAL_OES) : 0;
+            stream.uploadTexture = createStreamTexture(GL_TEXTURE_2D);
+            stream.uploadWidth = stream.uploadHeight = 0;
+            stream.hasFrame = false;
+        }
+        LOGI("[ExternalImage] Import %s (hardware buffers %s, dma-bufs %s); other frames are uploaded.",
+             gCanImport ? "supported" : "not supported", gGetNativeClientBuffer ? "yes" : "no",
+             gCanImportDmaBufs ? "yes" : "no");
+        return true;
+    }
+
+    void releaseExternalImages() {
+        // nothing may still be reading a buffer that is handed back without a fence
+        glFinish();
+        std::lock_guard<std::mutex> lock(gStreamMutex);
+        for (uint32_t i = 0; i < kMaxExternalImageStreams; i++) {
+            ExternalStream &stream = gStreams[i];
+            for (uint32_t j = 0; j < kMaxExternalBuffers; j++) {
+                ExternalSlot &slot = stream.slots[j];
+                destroySlotImage(&slot);
+                destroyEGLFence(slot.releaseFence);
+                slot.releaseFence = nullptr;
+                if (slot.state == SLOT_LATCHED) {
+                    slot.state = SLOT_FREE;
+                }
+            }
+            glDeleteTextures(1, &stream.importTexture);
+            glDeleteTextures(1, &stream.uploadTexture);
+            forgetGpuObject(GPU_OBJECT_TEXTURE, stream.uploadTexture);
+            stream.importTexture = stream.uploadTexture = 0;
+            stream.hasFrame = false;
+        }
+    }
+
+    bool canImportExternalImages() {
+        return gCanImport;
+    }
+
+    static void *createImage(const ExternalBuffer &buffer) {
+        static const EGLint preserved[] = { EGL_IMAGE_PRESERVED_KHR, EGL_TRUE, EGL_NONE };
+        switch (buffer.type) {
+            case EXTERNAL_BUFFER_HARDWARE_BUFFER: {
+                if (!gGetNativeClientBuffer) {
+                    return nullptr;
+                }
+                EGLClientBuffer clientBuffer = gGetNativeClientBuffer(buffer.handle);
+                return clientBuffer ? gCreateImage(gImageDisplay, EGL_NO_CONTEXT, EGL_NATIVE_BUFFER_ANDROID,
+                                                   clientBuffer, preserved) : nullptr;
+            }
+            case EXTERNAL_BUFFER_DMA_BUF: {
+                if (!gCanImportDmaBufs) {
+                    return nullptr;
+                }
+                const EGLint attribs[] = {
+                        EGL_WIDTH, static_cast<EGLint>(buffer.width),
+                        EGL_HEIGHT, static_cast<EGLint>(buffer.height),
+                        EGL_LINUX_DRM_FOURCC_EXT, static_cast<EGLint>(buffer.fourcc),
+                        EGL_DMA_BUF_PLANE0_FD_EXT, buffer.fd,
+                        EGL_DMA_BUF_PLANE0_OFFSET_EXT, 0,
+                        EGL_DMA_BUF_PLANE0_PITCH_EXT, static_cast<EGLint>(buffer.stride),
+                        EGL_NONE
+                };
+                return gCreateImage(gImageDisplay, EGL_NO_CONTEXT, EGL_LINUX_DMA_BUF_EXT, nullptr, attribs);
+            }
+            case EXTERNAL_BUFFER_EGL_IMAGE:
+                return buffer.handle;
+            default:
+                return nullptr;
+        }
+    }
+
+    // Into the stream's GL_TEXTURE_2D; row by row when the rows are padded,
+    // as ES 2 has no GL_UNPACK_ROW_LENGTH.
+    static void uploadFrame(ExternalStream *stream, const ExternalBuffer &buffer) {
+        glBindTexture(GL_TEXTURE_2D, stream->uploadTexture);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+        if (buffer.width != stream->uploadWidth || buffer.height != stream->uploadHeight) {
+            glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, buffer.width, buffer.height, 0, GL_RGBA, GL_UNSIGNED_BYTE,
+                         nullptr);
+            stream->uploadWidth = buffer.width;
+            stream->uploadHeight = buffer.height;
+            // the imported buffers are the producer's, and not counted
+            trackGpuObject(GPU_OBJECT_TEXTURE, stream->uploadTexture, GPU_MEMORY_TEXTURES,
+                           static_cast<uint64_t>(buffer.width) * buffer.height * 4);
+        }
+        uint32_t rowBytes = buffer.width * 4;
+        if (!buffer.stride || buffer.stride == rowBytes) {
+            glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, buffer.width, buffer.height, GL_RGBA, GL_UNSIGNED_BYTE,
+                            buffer.pixels);
+        } else {
+            const uint8_t *row = static_cast<const uint8_t *>(buffer.pixels);
+            for (uint32_t y = 0; y < buffer.height; y++, row += buffer.stride) {
+                glTexSubImage2D(GL_TEXTURE_2D, 0, 0, y, buffer.width, 1, GL_RGBA, GL_UNSIGNED_BYTE, row);
+            }
+        }
+    }
+
+    bool latchExternalImage(uint32_t streamIndex, ExternalImageFrame *frameOut) {
+        if (streamIndex >= kMaxExternalImageStreams) {
+            return false;
+        }
+        ExternalStream &stream = gStreams[streamIndex];
+        ExternalSlot *slot = nullptr;
+        EGLFence readyFence = nullptr;
+        {
+            std::lock_guard<std::mutex> lock(gStreamMutex);
+            for (uint32_t i = 0; i < kMaxExternalBuffers && !slot; i++) {
+                if (stream.slots[i].state == SLOT_QUEUED) {
+                    slot = &stream.slots[i];
+                }
+            }
+            if (!slot) {
+                *frameOut = stream.frame;
+                return stream.hasFrame;
+            }
+            // The previous frame goes back with a fence after every draw that
+            // sampled it; without fences, only once the GPU is idle.
+            for (uint32_t i = 0; i < kMaxExternalBuffers; i++) {
+                if (stream.slots[i].state == SLOT_LATCHED) {
+                    if (!haveEGLFences()) {
+                        glFinish();
+                    }
+                    stream.slots[i].releaseFence = createEGLFence();
+                    stream.slots[i].state = SLOT_FREE;
+                }
+            }
+            slot->state = SLOT_LATCHED;
+            readyFence = slot->readyFence;
+            slot->readyFence = nullptr;
+        }
+
+        if (readyFence) {
+            waitEGLFence(readyFence, kReadyFenceTimeoutNs);
+            destroyEGLFence(readyFence);
+        }
+        uint64_t startNs = frameStatsNowNs();
+        const ExternalBuffer &buffer = slot->buffer;
+        bool imported = false;
+        if (buffer.type != EXTERNAL_BUFFER_CPU && gCanImport) {
+            if (!slot->image && !slot->importFailed) {
+                slot->image = createImage(buffer);
+                if (!slot->image) {
+                    slot->importFailed = true;
+                    LOGE("[ExternalImage] Could not import a %ux%u buffer of type %d (error 0x%x)%s.",
+                         buffer.width, buffer.height, buffer.type, eglGetError(),
+                         buffer.pixels ? "; uploading it instead" : "");
+                }
+            }
+            if (slot->image) {
+                glBindTexture(GL_TEXTURE_EXTERNAL_OES, stream.importTexture);
+                gImageTargetTexture(GL_TEXTURE_EXTERNAL_OES, slot->image);
+                imported = true;
+            }
+        }
+        if (imported) {
+            stream.frame.texture = stream.importTexture;
+            stream.frame.target = GL_TEXTURE_EXTERNAL_OES;
+        } else {
+            if (buffer.pixels) {
+                uploadFrame(&stream, buffer);
+                stream.frame.texture = stream.uploadTexture;
+                stream.frame.target = GL_TEXTURE_2D;
+            }
+            // the upload made its copy (or there was nothing to use), so it goes straight back
+            std::lock_guard<std::mutex> lock(gStreamMutex);
+            slot->state = SLOT_FREE;
+        }
+        if (imported || buffer.pixels) {
+            stream.frame.width = buffer.width;
+            stream.frame.height = buffer.height;
+            stream.frame.frameNumber++;
+            stream.hasFrame = true;
+
+            uint64_t nowNs = frameStatsNowNs();
+            uint64_t latencyNs = nowNs > slot->producedNs ? nowNs - slot->producedNs : 0;
+            gLatched.fetch_add(1, std::memory_order_relaxed);
+            (imported ? gImported : gUploaded).fetch_add(1, std::memory_order_relaxed);
+            if (imported) {
+                gBytesNotCopied.fetch_add(static_cast<uint64_t>(buffer.width) * buffer.height * 4,
+                                          std::memory_order_relaxed);
+            }
+            gLatencyNs.fetch_add(latencyNs, std::memory_order_relaxed);
+            if (latencyNs > gMaxLatencyNs.load(std::memory_order_relaxed)) {
+                gMaxLatencyNs.store(latencyNs, std::memory_order_relaxed);
+            }
+            gLatchNs.fetch_add(nowNs - startNs, std::memory_order_relaxed);
+        }
+        *frameOut = stream.frame;
+        return stream.hasFrame;
+    }
+
+    void getExternalImageStats(ExternalImageStats *statsOut) {
+        statsOut->latched = gLatched.load(std::memory_order_relaxed);
+        statsOut->imported = gImported.load(std::memory_order_relaxed);
+        statsOut->uploaded = gUploaded.load(std::memory_order_relaxed);
+        statsOut->replaced = gReplaced.load(std::memory_order_relaxed);
+        statsOut->bytesNotCopied = gBytesNotCopied.load(std::memory_order_relaxed);
+        statsOut->producerWaits = gProducerWaits.load(std::memory_order_relaxed);
+        statsOut->latencyNs = gLatencyNs.load(std::memory_order_relaxed);
+        statsOut->maxLatencyNs = gMaxLatencyNs.load(std::memory_order_relaxed);
+        statsOut->latchNs = gLatchNs.load(std::memory_order_relaxed);
+    }
+
+    void resetExternalImageStats() {
+        gLatched.store(0, std::memory_order_relaxed);
+        gImported.store(0, std::memory_order_relaxed);
+        gUploaded.store(0, std::memory_order_relaxed);
+        gReplaced.store(0, std::memory_order_relaxed);
+        gBytesNotCopied.store(0, std::memory_order_relaxed);
+        gProducerWaits.store(0, std::memory_order_relaxed);
+        gLatencyNs.store(0, std::memory_order_relaxed);
+        gMaxLatencyNs.store(0, std::memory_order_relaxed);
+        gLatchNs.store(0, std::memory_order_relaxed);
+    }
+}
@@ -0,0 +1,121 @@
+/*
+ * Copyright (C) 2015 Sensics, Inc. and contributors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef OSVROPENGL_EXTERNALIMAGE_H
+#define OSVROPENGL_EXTERNALIMAGE_H
+
+#include <cstdint>
+
+#include <GLES2/gl2.h>
+
+#include "EGLFence.h"
+
+namespace OSVROpenGL {
+
+    // Image streams (camera frames, video) whose buffers the producer owns.
+    // Buffers the GPU can sample directly (an AHardwareBuffer, a Linux dma-buf
+    // or an EGLImage the producer made) are wrapped in an EGLImage once and
+    // bound to a GL_TEXTURE_EXTERNAL_OES texture when a frame of theirs is
+    // latched: no copy is made. Buffers in CPU memory, and ones the context
+    // can't import, are uploaded to a GL_TEXTURE_2D texture instead, so the
+    // consumer sees the same thing either way: a texture and its target.
+    //
+    // A producer registers a small ring of buffers, then for each frame
+    // acquires one, writes it and queues it. Only the newest queued frame is
+    // latched; one replaced before it was latched goes straight back. A
+    // latched buffer is handed back when the next one is latched, with a fence
+    // after everything that sampled it, and acquiring it waits for that fence:
+    // the producer never writes a buffer the GPU may still be reading. The
+    // producer can also queue a fence of its own for the GPU writes that made
+    // the frame, which latching waits for.
+    //
+    // Producer functions are for any thread; the rest are for the GL thread
+    // whose context samples the stream.
+
+    static const uint32_t kMaxExternalImageStreams = 2;
+    static const uint32_t kMaxExternalBuffers = 4;     // per stream
+
+    enum ExternalBufferType {
+        EXTERNAL_BUFFER_CPU,                // RGBA8 rows in memory
+        EXTERNAL_BUFFER_HARDWARE_BUFFER,    // an AHardwareBuffer (Android 8 and later)
+        EXTERNAL_BUFFER_DMA_BUF,            // a single plane Linux dma-buf
+        EXTERNAL_BUFFER_EGL_IMAGE           // an EGLImageKHR on the renderer's display
+    };
+
+    struct ExternalBuffer {
+        ExternalBufferType type;
+        void *handle;           // the AHardwareBuffer or EGLImageKHR
+        int fd;                 // the dma-buf
+        uint32_t fourcc;        // the dma-buf's DRM format, e.g. 'AB24' for RGBA8
+        uint32_t width;
+        uint32_t height;
+        uint32_t stride;        // bytes per row, for dma-bufs and CPU buffers
+        const void *pixels;     // CPU buffers, or a CPU view of another kind to upload if it can't be imported
+    };
+
+    // Adds a buffer to the stream's ring; its slot, or -1 if the ring is full.
+    // The buffer must stay valid until it is unregistered.
+    int registerExternalBuffer(uint32_t stream, const ExternalBuffer &buffer);
+    // Removes a buffer the renderer isn't sampling (any but the latched one,
+    // which releaseExternalImages() hands back); the renderer's EGLImage of it
+    // is destroyed with it.
+    void unregisterExternalBuffer(uint32_t stream, int slot);
+
+    // A buffer the GPU is done with, waiting up to timeoutNs for one; -1 if
+    // there is none yet.
+    int acquireExternalBuffer(uint32_t stream, uint64_t timeoutNs);
+    // Hands the written buffer over as the newest frame, made at producedNs
+    // (frameStatsNowNs() time). readyFence, if not null, is the producer's
+    // and the stream destroys it.
+    void queueExternalBuffer(uint32_t stream, int slot, uint64_t producedNs, EGLFence readyFence);
+
+    // Looks up the import entry points and creates the streams' textures;
+    // call with each new context current, after initEGLFences().
+    bool initExternalImages();
+    // Destroys the textures and EGLImages and hands every buffer back.
+    void releaseExternalImages();
+    bool canImportExternalImages();
+
+    struct ExternalImageFrame {
+        GLuint texture;
+        GLenum target;          // GL_TEXTURE_EXTERNAL_OES when imported, GL_TEXTURE_2D when uploaded
+        uint32_t width;
+        uint32_t height;
+        uint64_t frameNumber;   // counts the frames latched, so a new one can be told apart
+    };
+
+    // Latches the newest queued frame, if there is a new one. Either way,
+    // gives the latched frame; false if the stream has had none.
+    bool latchExternalImage(uint32_t stream, ExternalImageFrame *frameOut);
+
+    struct ExternalImageStats {
+        uint64_t latched;           // frames latched
+        uint64_t imported;          // of those, sampled in place
+        uint64_t uploaded;          // of those, copied into a texture
+        uint64_t replaced;          // queued frames replaced before they were latched
+        uint64_t bytesNotCopied;    // what the imported frames would have uploaded
+        uint64_t producerWaits;     // acquires that found every buffer still in use
+        uint64_t latencyNs;         // produced to latched, summed
+        uint64_t maxLatencyNs;
+        uint64_t latchNs;           // time in latching (import or upload), summed
+    };
+
+    void getExternalImageStats(ExternalImageStats *statsOut);
+    void resetExternalImageStats();
+}
+
+#endif // OSVROPENGL_EXTERNALIMAGE_H
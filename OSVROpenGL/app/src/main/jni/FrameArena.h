@@ -0,0 +1,76 @@
+/*
+ * Copyright (C) 2015 Sensics, Inc. and contributors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef OSVROPENGL_FRAMEARENA_H
+#define OSVROPENGL_FRAMEARENA_H
+
+#include <cstddef>
+#include <cstdint>
+
+#include "Logging.h"
+
+namespace OSVROpenGL {
+
+    // Linear (bump) allocator for scratch data that lives for one frame. The
+    // storage is part of the object, so a static arena never touches the heap;
+    // reset() at the top of the frame hands all of it out again. Nothing is
+    // constructed or destroyed, so only trivially copyable types belong here.
+    // Running out is a sizing bug: allocation returns null and logs once.
+    template<size_t Capacity>
+    class FrameArena {
+        alignas(16) unsigned char mStorage[Capacity];
+        size_t mUsed;
+        size_t mHighWater;
+        bool mReportedFull;
+
+    public:
+        FrameArena() : mUsed(0), mHighWater(0), mReportedFull(false) {
+        }
+
+        void reset() {
+            mUsed = 0;
+        }
+
+        void *allocate(size_t bytes, size_t alignment) {
+            size_t offset = (mUsed + alignment - 1) & ~(alignment - 1);
+            if (offset + bytes > Capacity) {
+                if (!mReportedFull) {
+                    LOGE("[FrameArena] Out of frame scratch memory (%u of %u bytes used).",
+                         static_cast<unsigned>(mUsed), static_cast<unsigned>(Capacity));
+                    mReportedFull = true;
+                }
+                return nullptr;
+            }
+            mUsed = offset + bytes;
+            if (mUsed > mHighWater) {
+                mHighWater = mUsed;
+            }
+            return mStorage + offset;
+        }
+
+        template<typename T>
+        T *allocateArray(size_t count) {
+            return static_cast<T *>(allocate(sizeof(T) * count, alignof(T)));
+        }
+
+        size_t used() const { return mUsed; }
+        size_t highWater() const { return mHighWater; }
+        static size_t capacity() { return Capacity; }
+    };
+}
+
+#endif // OSVROPENGL_FRAMEARENA_H
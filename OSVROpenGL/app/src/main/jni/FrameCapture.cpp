@@ -0,0 +1,845 @@
+/*
+ * Copyright (C) 2015 Sensics, Inc. and contributors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include <atomic>
+#include <cerrno>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <EGL/egl.h>
+#include <GLES2/gl2.h>
+
+#include "Logging.h"
+#include "EGLFence.h"
+#include "FrameCapture.h"
+#include "FrameStats.h"
+#include "GLExtensions.h"
+#include "GpuMemory.h"
+#include "Trace.h"
+
+// ES 3 names, which the ES 2 headers don't have.
+#ifndef GL_PIXEL_PACK_BUFFER
+#define GL_PIXEL_PACK_BUFFER 0x88EB
+#endif
+#ifndef GL_STREAM_READ
+#define GL_STREAM_READ 0x88E1
+#endif
+#ifndef GL_MAP_READ_BIT
+#define GL_MAP_READ_BIT 0x0001
+#endif
+
+namespace OSVROpenGL {
+
+    typedef void *(GL_APIENTRY *MapBufferRangeFn)(GLenum target, GLintptr offset, GLsizeiptr length,
+                                                   GLbitfield access);
+    typedef GLboolean (GL_APIENTRY *UnmapBufferFn)(GLenum target);
+
+    static MapBufferRangeFn gMapBufferRange = nullptr;
+    static UnmapBufferFn gUnmapBuffer = nullptr;
+    static bool gPackBuffers = false;
+
+    // How long stopFrameCapture() waits for an image's copy before giving up on it.
+    static const uint64_t kStopFenceTimeoutNs = 1000000000ull;
+
+    // A slot goes FREE -> COPIED on the GL thread, COPIED -> WRITING when the
+    // GL thread hands it to the writer, WRITING -> WRITTEN on the writer, and
+    // WRITTEN -> FREE on the GL thread again once it is unmapped.
+    enum CaptureSlotState {
+        SLOT_FREE = 0,
+        SLOT_COPIED,
+        SLOT_WRITING,
+        SLOT_WRITTEN
+    };
+
+    struct CaptureSlot {
+        std::atomic<int> state;
+        GLuint packBuffer;
+        GLsizeiptr packBufferBytes;
+        GLuint stagingTexture;
+        GLuint stagingFrameBuffer;
+        int stagingWidth;
+        int stagingHeight;
+        EGLFence fence;
+        uint64_t copiedFrame;           // gFrameNumber when copied
+        bool mapped;
+        // for the writer, from WRITING on
+        uint32_t captureFrame;
+        char source[16];
+        int width;
+        int height;
+        const uint8_t *pixels;          // bottom row first: the mapping, or readback
+        std::vector<uint8_t> readback;  // staging textures are read back into this
+    };
+
+    static CaptureSlot gSlots[kFrameCaptureSlots];
+
+    // setFrameCapture(), applied by the next frameCaptureBeginFrame()
+    static std::mutex gRequestMutex;
+    static std::atomic<bool> gRequestPending(false);
+    static bool gRequestStart = false;
+    static FrameCaptureConfig gRequestConfig;
+    static std::string gRequestDirectory;
+
+    // GL thread
+    static bool gRunning = false;
+    static FrameCaptureConfig gConfig;
+    static uint64_t gFrameNumber = 0;       // frames since the capture started
+    static uint32_t gFramesCaptured = 0;
+    static bool gCapturingFrame = false;
+    static uint32_t gCaptureFrame = 0;      // the frame number in this frame's file names
+    static uint64_t gFrameCaptureNs = 0;    // this frame's work so far
+    static GLuint gLastFrameBuffer = 0;
+
+    // The writer thread and its queue of slots to write
+    static std::thread gWriterThread;
+    static bool gWriterRunning = false;     // GL thread
+    static std::mutex gWriterMutex;
+    static std::condition_variable gWriterCondition;
+    static int gWriterQueue[kFrameCaptureSlots];
+    static int gWriterQueueHead = 0;
+    static int gWriterQueueCount = 0;
+    static bool gWriterStopping = false;
+    static std::string gWriterDirectory;    // set before the writer starts
+    static int gWriterFormat = FRAME_CAPTURE_PNG;
+
+    static std::mutex gStatsMutex;
+    static FrameCaptureStats gStats;
+
+    void defaultFrameCaptureConfig(FrameCaptureConfig *configOut) {
+        configOut->directory = nullptr;
+        configOut->everyNFrames = 1;
+        configOut->frameCount = 0;
+        configOut->latencyFrames = 3;
+        configOut->eyes = true;
+        configOut->window = false;
+        configOut->format = FRAME_CAPTURE_PNG;
+    }
+
+    // ---- Encoding, on the writer thread (and loading, on any) ----
+
+    struct Crc32Table {
+        uint32_t entries[256];
+
+        Crc32Table() {
+            for (uint32_t n = 0; n < 256; n++) {
+                uint32_t c = n;
+                for (int k = 0; k < 8; k++) {
+                    c = c & 1 ? 0xedb88320u ^ (c >> 1) : c >> 1;
+                }
+                entries[n] = c;
+            }
+        }
+    };
+
+    static uint32_t crc32(uint32_t crc, const uint8_t *data, size_t bytes) {
+        static const Crc32Table table;
+        crc = ~crc;
+        for (size_t i = 0; i < bytes; i++) {
+            crc = table.entries[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+        }
+        return ~crc;
+    }
+
+    static void appendBigEndian32(std::vector<uint8_t> *out, uint32_t value) {
+        out->push_back(static_cast<uint8_t>(value >> 24));
+        out->push_back(static_cast<uint8_t>(value >> 16));
+        out->push_back(static_cast<uint8_t>(value >> 8));
+        out->push_back(static_cast<uint8_t>(value));
+    }
+
+    static uint32_t readBigEndian32(const uint8_t *data) {
+        return (static_cast<uint32_t>(data[0]) << 24) | (static_cast<uint32_t>(data[1]) << 16) |
+               (static_cast<uint32_t>(data[2]) << 8) | data[3];
+    }
+
+    static void appendPngChunk(std::vector<uint8_t> *out, const char *type, const uint8_t *data, size_t bytes) {
+        appendBigEndian32(out, static_cast<uint32_t>(bytes));
+        size_t typeOffset = out->size();
+        out->insert(out->end(), type, type + 4);
+        out->insert(out->end(), data, data + bytes);
+        appendBigEndian32(out, crc32(0, &(*out)[typeOffset], bytes + 4));
+    }
+
+    static const uint8_t kPngSignature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' };
+    static const size_t kMaxStoredBlockBytes = 65535;
+
+    // An 8-bit RGBA PNG of bottom-up pixels, in stored deflate blocks.
+    // scanlines and zlib are the writer's scratch; out gets the file.
+    static void encodePng(const uint8_t *pixels, int width, int height, std::vector<uint8_t> *scanlines,
+                          std::vector<uint8_t> *zlib, std::vector<uint8_t> *out) {
+        size_t rowBytes = static_cast<size_t>(width) * 4;
+        scanlines->resize((rowBytes + 1) * height);
+        uint32_t adlerA = 1, adlerB = 0;
+        for (int row = 0; row < height; row++) {
+            uint8_t *line = &(*scanlines)[(rowBytes + 1) * row];
+            line[0] = 0;    // no filter
+            memcpy(line + 1, pixels + rowBytes * (height - 1 - row), rowBytes);
+        }
+        for (size_t i = 0; i < scanlines->size(); i++) {
+            adlerA = (adlerA + (*scanlines)[i]) % 65521;
+            adlerB = (adlerB + adlerA) % 65521;
+        }
+
+        zlib->clear();
+        zlib->push_back(0x78);     // deflate, 32K window
+        zlib->push_back(0x01);     // no preset dictionary, fastest; (0x7801 % 31 == 0)
+        size_t remaining = scanlines->size();
+        const uint8_t *data = scanlines->data();
+        do {
+            uint16_t blockBytes = static_cast<uint16_t>(remaining < kMaxStoredBlockBytes ? remaining :
+                                                        kMaxStoredBlockBytes);
+            remaining -= blockBytes;
+            zlib->push_back(remaining ? 0 : 1);    // stored, final bit on the last one
+            zlib->push_back(static_cast<uint8_t>(blockBytes));
+            zlib->push_back(static_cast<uint8_t>(blockBytes >> 8));
+            zlib->push_back(static_cast<uint8_t>(~blockBytes));
+            zlib->push_back(static_cast<uint8_t>(~blockBytes >> 8));
+            zlib->insert(zlib->end(), data, data + blockBytes);
+            data += blockBytes;
+        } while (remaining);
+        appendBigEndian32(zlib, (adlerB << 16) | adlerA);
+
+        uint8_t header[13];
+        header[0] = static_cast<uint8_t>(width >> 24);
+        header[1] = static_cast<uint8_t>(width >> 16);
+        header[2] = static_cast<uint8_t>(width >> 8);
+        header[3] = static_cast<uint8_t>(width);
+        header[4] = static_cast<uint8_t>(height >> 24);
+        header[5] = static_cast<uint8_t>(height >> 16);
+        header[6] = static_cast<uint8_t>(height >> 8);
+        header[7] = static_cast<uint8_t>(height);
+        header[8] = 8;      // bits per channel
+        header[9] = 6;      // RGBA
+        header[10] = 0;     // deflate
+        header[11] = 0;     // adaptive filtering
+        header[12] = 0;     // not interlaced
+
+        out->clear();
+        out->insert(out->end(), kPngSignature, kPngSignature + sizeof(kPngSignature));
+        appendPngChunk(out, "IHDR", header, sizeof(header));
+        appendPngChunk(out, "IDAT", zlib->data(), zlib->size());
+        appendPngChunk(out, "IEND", nullptr, 0);
+    }
+
+    static bool writeAll(int fd, const uint8_t *data, size_t bytes) {
+        while (bytes) {
+            ssize_t written = write(fd, data, bytes);
+            if (written < 0 && errno == EINTR) {
+                continue;
+            }
+            if (written <= 0) {
+                return false;
+            }
+            data += written;
+            bytes -= static_cast<size_t>(written);
+        }
+        return true;
+    }
+
+    // With open() and a path on the stack rather than stdio, so that once the
+    // encode buffers have grown to the image size, writing allocates nothing.
+    static bool writeSlot(const CaptureSlot &slot, std::vector<uint8_t> *scanlines, std::vector<uint8_t> *zlib,
+                          std::vector<uint8_t> *encoded, uint64_t *bytesOut) {
+        bool png = gWriterFormat == FRAME_CAPTURE_PNG;
+        char path[512];
+        snprintf(path, sizeof(path), "%s/frame%06u_%s.%s", gWriterDirectory.c_str(), slot.captureFrame,
+                 slot.source, png ? "png" : "pam");
+        int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        if (fd < 0) {
+            LOGE("[FrameCapture] Could not create %s.", path);
+            return false;
+        }
+        bool ok;
+        size_t rowBytes = static_cast<size_t>(slot.width) * 4;
+        if (png) {
+            encodePng(slot.pixels, slot.width, slot.height, scanlines, zlib, encoded);
+            ok = writeAll(fd, encoded->data(), encoded->size());
+            *bytesOut = encoded->size();
+        } else {
+            char header[128];
+            int headerBytes = snprintf(header, sizeof(header),
+                                       "P7\nWIDTH %d\nHEIGHT %d\nDEPTH 4\nMAXVAL 255\nTUPLTYPE RGB_ALPHA\nENDHDR\n",
+                                       slot.width, slot.height);
+            ok = headerBytes > 0 && writeAll(fd, reinterpret_cast<const uint8_t *>(header),
+                                             static_cast<size_t>(headerBytes));
+            for (int row = slot.height - 1; ok && row >= 0; row--) {
+                ok = writeAll(fd, slot.pixels + rowBytes * row, rowBytes);
+            }
+            *bytesOut = static_cast<uint64_t>(headerBytes) + rowBytes * slot.height;
+        }
+        if (close(fd) != 0 || !ok) {
+            LOGE("[FrameCapture] Could not write %s.", path);
+            unlink(path);
+            return false;
+        }
+        return true;
+    }
+
+    static void writerMain() {
+        traceSetThreadName("FrameCaptureWriter");
+        std::vector<uint8_t> scanlines, zlib, encoded;
+        std::unique_lock<std::mutex> lock(gWriterMutex);
+        for (;;) {
+            gWriterCondition.wait(lock, [] { return gWriterQueueCount > 0 || gWriterStopping; });
+            if (!gWriterQueueCount) {
+                return;
+            }
+            CaptureSlot &slot = gSlots[gWriterQueue[gWriterQueueHead]];
+            gWriterQueueHead = (gWriterQueueHead + 1) % kFrameCaptureSlots;
+            gWriterQueueCount--;
+            lock.unlock();
+
+            uint64_t startNs = frameStatsNowNs();
+            uint64_t bytes = 0;
+            bool written;
+            {
+                OSVR_TRACE_SCOPE("writeCapturedImage");
+                written = writeSlot(slot, &scanlines, &zlib, &encoded, &bytes);
+            }
+            uint64_t endNs = frameStatsNowNs();
+            {
+                std::lock_guard<std::mutex> statsLock(gStatsMutex);
+                if (written) {
+                    gStats.written++;
+                    gStats.bytesWritten += bytes;
+                } else {
+                    gStats.failed++;
+                }
+                gStats.writerNs += endNs - startNs;
+            }
+            slot.state.store(SLOT_WRITTEN, std::memory_order_release);
+            lock.lock();
+        }
+    }
+
+    static void startWriter() {
+        gWriterQueueHead = 0;
+        gWriterQueueCount = 0;
+        gWriterStopping = false;
+        gWriterThread = std::thread(writerMain);
+        gWriterRunning = true;
+    }
+
+    // Returns once everything queued has been written.
+    static void stopWriter() {
+        if (!gWriterRunning) {
+            return;
+        }
+        {
+            std::lock_guard<std::mutex> lock(gWriterMutex);
+            gWriterStopping = true;
+        }
+        gWriterCondition.notify_one();
+        gWriterThread.join();
+        gWriterRunning = false;
+    }
+
+    static void queueForWriter(int slotIndex) {
+        {
+            std::lock_guard<std::mutex> lock(gWriterMutex);
+            gWriterQueue[(gWriterQueueHead + gWriterQueueCount) % kFrameCaptureSlots] = slotIndex;
+            gWriterQueueCount++;
+        }
+        gWriterCondition.notify_one();
+    }
+
+    // ---- The GL thread's side ----
+
+    bool initFrameCapture() {
+        // a capture going on keeps going with new slots; the old ones went with their context
+        stopWriter();
+        for (int i = 0; i < kFrameCaptureSlots; i++) {
+            CaptureSlot &slot = gSlots[i];
+            slot.state.store(SLOT_FREE, std::memory_order_relaxed);
+            slot.packBuffer = slot.stagingTexture = slot.stagingFrameBuffer = 0;
+            slot.packBufferBytes = 0;
+            slot.stagingWidth = slot.stagingHeight = 0;
+            slot.fence = nullptr;
+            slot.mapped = false;
+        }
+        gMapBufferRange = nullptr;
+        gUnmapBuffer = nullptr;
+        if (isOpenGLES3()) {
+            gMapBufferRange = (MapBufferRangeFn) eglGetProcAddress("glMapBufferRange");
+            gUnmapBuffer = (UnmapBufferFn) eglGetProcAddress("glUnmapBuffer");
+        }
+        gPackBuffers = gMapBufferRange && gUnmapBuffer;
+        {
+            std::lock_guard<std::mutex> lock(gStatsMutex);
+            gStats.packBuffers = gPackBuffers;
+        }
+        if (gRunning) {
+            startWriter();
+        }
+        LOGI("[FrameCapture] Reading back through %s.", gPackBuffers ? "pixel pack buffers" : "staging textures");
+        return true;
+    }
+
+    // WRITTEN slots back to FREE.
+    static void recycleWrittenSlots() {
+        for (int i = 0; i < kFrameCaptureSlots; i++) {
+            CaptureSlot &slot = gSlots[i];
+            if (slot.state.load(std::memory_order_acquire) != SLOT_WRITTEN) {
+                continue;
+            }
+            if (slot.mapped) {
+                glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.packBuffer);
+                gUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+                glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+                slot.mapped = false;
+            }
+            slot.pixels = nullptr;
+            slot.state.store(SLOT_FREE, std::memory_order_relaxed);
+        }
+    }
+
+    // Maps or reads back a COPIED slot whose copy is done, and hands it to the writer.
+    static void collectSlot(int slotIndex) {
+        CaptureSlot &slot = gSlots[slotIndex];
+        OSVR_TRACE_SCOPE("collectCapturedImage");
+        destroyEGLFence(slot.fence);
+        slot.fence = nullptr;
+        GLsizeiptr bytes = static_cast<GLsizeiptr>(slot.width) * slot.height * 4;
+        if (gPackBuffers) {
+            glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.packBuffer);
+            slot.pixels = static_cast<const uint8_t *>(gMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, bytes,
+                                                                       GL_MAP_READ_BIT));
+            glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+            slot.mapped = slot.pixels != nullptr;
+        } else {
+            // by now the copy is done, so this is only the transfer
+            if (slot.readback.size() < static_cast<size_t>(bytes)) {
+                slot.readback.resize(bytes);
+            }
+            glBindFramebuffer(GL_FRAMEBUFFER, slot.stagingFrameBuffer);
+            glReadPixels(0, 0, slot.width, slot.height, GL_RGBA, GL_UNSIGNED_BYTE, slot.readback.data());
+            glBindFramebuffer(GL_FRAMEBUFFER, gLastFrameBuffer);
+            slot.pixels = slot.readback.data();
+        }
+        if (!slot.pixels) {
+            LOGE("[FrameCapture] Could not map frame %u's %s.", slot.captureFrame, slot.source);
+            slot.state.store(SLOT_FREE, std::memory_order_relaxed);
+            std::lock_guard<std::mutex> lock(gStatsMutex);
+            gStats.failed++;
+            return;
+        }
+        {
+            std::lock_guard<std::mutex> lock(gStatsMutex);
+            gStats.latencyFrames += gFrameNumber - slot.copiedFrame;
+        }
+        slot.state.store(SLOT_WRITING, std::memory_order_relaxed);
+        queueForWriter(slotIndex);
+    }
+
+    // Collects the COPIED slots that are old enough and done; with wait, all
+    // of them, waiting for the GPU as long as it takes.
+    static void collectCopiedSlots(bool wait) {
+        for (int i = 0; i < kFrameCaptureSlots; i++) {
+            CaptureSlot &slot = gSlots[i];
+            if (slot.state.load(std::memory_order_relaxed) != SLOT_COPIED) {
+                continue;
+            }
+            if (!wait) {
+                // without fences, going by age alone may wait on the GPU in the map
+                if (gFrameNumber - slot.copiedFrame < gConfig.latencyFrames ||
+                    (slot.fence && !isEGLFenceSignaled(slot.fence))) {
+                    continue;
+                }
+            } else if (slot.fence) {
+                waitEGLFence(slot.fence, kStopFenceTimeoutNs);
+            }
+            collectSlot(i);
+        }
+    }
+
+    void stopFrameCapture() {
+        if (!gRunning) {
+            return;
+        }
+        collectCopiedSlots(true);
+        stopWriter();
+        recycleWrittenSlots();
+        gRunning = false;
+        gCapturingFrame = false;
+        FrameCaptureStats stats;
+        getFrameCaptureStats(&stats);
+        LOGI("[FrameCapture] Stopped after %u frames: %llu images written, %llu dropped, %llu failed.",
+             gFramesCaptured, static_cast<unsigned long long>(stats.written),
+             static_cast<unsigned long long>(stats.dropped), static_cast<unsigned long long>(stats.failed));
+    }
+
+    void releaseFrameCapture() {
+        bool running = gRunning;
+        stopFrameCapture();
+        for (int i = 0; i < kFrameCaptureSlots; i++) {
+            CaptureSlot &slot = gSlots[i];
+            glDeleteBuffers(1, &slot.packBuffer);
+            glDeleteFramebuffers(1, &slot.stagingFrameBuffer);
+            glDeleteTextures(1, &slot.stagingTexture);
+            forgetGpuObject(GPU_OBJECT_BUFFER, slot.packBuffer);
+            forgetGpuObject(GPU_OBJECT_TEXTURE, slot.stagingTexture);
+            slot.packBuffer = slot.stagingTexture = slot.stagingFrameBuffer = 0;
+            slot.packBufferBytes = 0;
+            slot.stagingWidth = slot.stagingHeight = 0;
+        }
+        // picked up again by the next context
+        gRunning = running;
+    }
+
+    static void startFrameCapture(const FrameCaptureConfig &config, const std::string &directory) {
+        if (mkdir(directory.c_str(), 0755) != 0 && errno != EEXIST) {
+            LOGE("[FrameCapture] Could not create %s.", directory.c_str());
+            return;
+        }
+        gConfig = config;
+        gConfig.directory = nullptr;
+        if (!gConfig.everyNFrames) {
+            gConfig.everyNFrames = 1;
+        }
+        gWriterDirectory = directory;
+        gWriterFormat = config.format;
+        gFrameNumber = 0;
+        gFramesCaptured = 0;
+        gRunning = true;
+        startWriter();
+        LOGI("[FrameCapture] Capturing %s%s every %u frames to %s as %s, %u frames behind.",
+             config.eyes ? "the eye buffers" : "", config.eyes && config.window ? " and the window" :
+             config.window ? "the window" : "", gConfig.everyNFrames, directory.c_str(),
+             config.format == FRAME_CAPTURE_PNG ? "PNG" : "PAM", config.latencyFrames);
+    }
+
+    void setFrameCapture(const FrameCaptureConfig *config) {
+        std::lock_guard<std::mutex> lock(gRequestMutex);
+        gRequestStart = config && config->directory && *config->directory;
+        if (gRequestStart) {
+            gRequestConfig = *config;
+            gRequestDirectory = config->directory;
+        }
+        gRequestPending.store(true, std::memory_order_release);
+    }
+
+    bool isFrameCaptureRunning() {
+        return gRunning;
+    }
+
+    void frameCaptureBeginFrame() {
+        if (gRequestPending.load(std::memory_order_acquire)) {
+            std::lock_guard<std::mutex> lock(gRequestMutex);
+            gRequestPending.store(false, std::memory_order_relaxed);
+            stopFrameCapture();
+            if (gRequestStart) {
+                startFrameCapture(gRequestConfig, gRequestDirectory);
+            }
+        }
+        gCapturingFrame = false;
+        if (!gRunning) {
+            return;
+        }
+        gFrameCaptureNs = 0;
+        gCapturingFrame = gFrameNumber % gConfig.everyNFrames == 0 &&
+                          (!gConfig.frameCount || gFramesCaptured < gConfig.frameCount);
+        if (gCapturingFrame) {
+            gCaptureFrame = static_cast<uint32_t>(gFrameNumber);
+            gFramesCaptured++;
+            std::lock_guard<std::mutex> lock(gStatsMutex);
+            gStats.frames++;
+        }
+    }
+
+    bool isCapturingFrame() {
+        return gCapturingFrame;
+    }
+
+    static int freeSlot() {
+        for (int i = 0; i < kFrameCaptureSlots; i++) {
+            if (gSlots[i].state.load(std::memory_order_relaxed) == SLOT_FREE) {
+                return i;
+            }
+        }
+        return -1;
+    }
+
+    // Makes the slot's staging texture at least width by height, and its
+    // framebuffer; leaves GL_TEXTURE_2D unbound.
+    static void sizeStagingTexture(CaptureSlot *slot, int width, int height) {
+        if (slot->stagingTexture && slot->stagingWidth >= width && slot->stagingHeight >= height) {
+            return;
+        }
+        if (!slot->stagingTexture) {
+            glGenTextures(1, &slot->stagingTexture);
+            glGenFramebuffers(1, &slot->stagingFrameBuffer);
+        }
+        slot->stagingWidth = width;
+        slot->stagingHeight = height;
+        glBindTexture(GL_TEXTURE_2D, slot->stagingTexture);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+        glBindTexture(GL_TEXTURE_2D, 0);
+        trackGpuObject(GPU_OBJECT_TEXTURE, slot->stagingTexture, GPU_MEMORY_RENDER_TARGETS,
+                       static_cast<uint64_t>(width) * height * 4);
+        glBindFramebuffer(GL_FRAMEBUFFER, slot->stagingFrameBuffer);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, slot->stagingTexture, 0);
+    }
+
+    void captureFramebuffer(FrameCaptureSource source, uint32_t index, GLuint framebuffer,
+                            int x, int y, int width, int height) {
+        if (!gCapturingFrame || width <= 0 || height <= 0 ||
+            !(source == FRAME_CAPTURE_WINDOW ? gConfig.window : gConfig.eyes)) {
+            return;
+        }
+        uint64_t startNs = frameStatsNowNs();
+        int slotIndex = freeSlot();
+        if (slotIndex < 0) {
+            std::lock_guard<std::mutex> lock(gStatsMutex);
+            gStats.dropped++;
+            return;
+        }
+        CaptureSlot &slot = gSlots[slotIndex];
+        OSVR_TRACE_SCOPE("captureFramebuffer");
+        if (gPackBuffers) {
+            GLsizeiptr bytes = static_cast<GLsizeiptr>(width) * height * 4;
+            if (!slot.packBuffer) {
+                glGenBuffers(1, &slot.packBuffer);
+            }
+            glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.packBuffer);
+            if (slot.packBufferBytes < bytes) {
+                glBufferData(GL_PIXEL_PACK_BUFFER, bytes, nullptr, GL_STREAM_READ);
+                slot.packBufferBytes = bytes;
+                trackGpuObject(GPU_OBJECT_BUFFER, slot.packBuffer, GPU_MEMORY_BUFFERS, static_cast<uint64_t>(bytes));
+            }
+            glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+            // into the bound pack buffer: returns without waiting for the GPU
+            glReadPixels(x, y, width, height, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+            glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+        } else {
+            sizeStagingTexture(&slot, width, height);
+            glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+            glBindTexture(GL_TEXTURE_2D, slot.stagingTexture);
+            glCopyTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, x, y, width, height);
+            glBindTexture(GL_TEXTURE_2D, 0);
+        }
+        gLastFrameBuffer = framebuffer;
+        slot.fence = nullptr;
+        slot.copiedFrame = gFrameNumber;
+        slot.captureFrame = gCaptureFrame;
+        if (source == FRAME_CAPTURE_WINDOW) {
+            snprintf(slot.source, sizeof(slot.source), "window");
+        } else {
+            snprintf(slot.source, sizeof(slot.source), "eye%u", index);
+        }
+        slot.width = width;
+        slot.height = height;
+        slot.state.store(SLOT_COPIED, std::memory_order_relaxed);
+        gFrameCaptureNs += frameStatsNowNs() - startNs;
+        std::lock_guard<std::mutex> lock(gStatsMutex);
+        gStats.copied++;
+    }
+
+    void frameCaptureEndFrame() {
+        if (!gRunning) {
+            return;
+        }
+        uint64_t startNs = frameStatsNowNs();
+        recycleWrittenSlots();
+        for (int i = 0; i < kFrameCaptureSlots; i++) {
+            CaptureSlot &slot = gSlots[i];
+            if (slot.state.load(std::memory_order_relaxed) == SLOT_COPIED && slot.copiedFrame == gFrameNumber) {
+                slot.fence = createEGLFence();
+            }
+        }
+        collectCopiedSlots(false);
+        gFrameNumber++;
+
+        uint64_t frameNs = gFrameCaptureNs + (frameStatsNowNs() - startNs);
+        recordFrameStage(FRAME_STAGE_CAPTURE, frameNs);
+        std::lock_guard<std::mutex> lock(gStatsMutex);
+        gStats.renderThreadNs += frameNs;
+        if (frameNs > gStats.maxRenderThreadNs) {
+            gStats.maxRenderThreadNs = frameNs;
+        }
+    }
+
+    void getFrameCaptureStats(FrameCaptureStats *statsOut) {
+        std::lock_guard<std::mutex> lock(gStatsMutex);
+        *statsOut = gStats;
+    }
+
+    void resetFrameCaptureStats() {
+        std::lock_guard<std::mutex> lock(gStatsMutex);
+        bool packBuffers = gStats.packBuffers;
+        gStats = FrameCaptureStats();
+        gStats.packBuffers = packBuffers;
+    }
+
+    // ---- Loading ----
+
+    static bool readFile(const char *path, std::vector<uint8_t> *bytesOut) {
+        FILE *file = fopen(path, "rb");
+        if (!file) {
+            return false;
+        }
+        bool ok = fseek(file, 0, SEEK_END) == 0;
+        long size = ok ? ftell(file) : -1;
+        ok = size >= 0 && fseek(file, 0, SEEK_SET) == 0;
+        if (ok) {
+            bytesOut->resize(static_cast<size_t>(size));
+            ok = fread(bytesOut->data(), 1, bytesOut->size(), file) == bytesOut->size();
+        }
+        fclose(file);
+        return ok;
+    }
+
+    static bool loadPam(const std::vector<uint8_t> &file, std::vector<uint8_t> *rgbaOut, uint32_t *widthOut,
+                        uint32_t *heightOut) {
+        size_t offset = 3;      // past "P7\n"
+        long width = 0, height = 0, depth = 0, maxval = 0;
+        std::string tupleType;
+        for (;;) {
+            size_t end = offset;
+            while (end < file.size() && file[end] != '\n') {
+                end++;
+            }
+            if (end == file.size()) {
+                return false;
+            }
+            std::string line(reinterpret_cast<const char *>(&file[offset]), end - offset);
+            offset = end + 1;
+            char key[16], value[32];
+            if (line == "ENDHDR") {
+                break;
+            } else if (line.empty() || line[0] == '#' || sscanf(line.c_str(), "%15s %31s", key, value) != 2) {
+                continue;
+            } else if (!strcmp(key, "WIDTH")) {
+                width = atol(value);
+            } else if (!strcmp(key, "HEIGHT")) {
+                height = atol(value);
+            } else if (!strcmp(key, "DEPTH")) {
+                depth = atol(value);
+            } else if (!strcmp(key, "MAXVAL")) {
+                maxval = atol(value);
+            } else if (!strcmp(key, "TUPLTYPE")) {
+                tupleType = value;
+            }
+        }
+        size_t bytes = static_cast<size_t>(width) * height * 4;
+        if (width <= 0 || height <= 0 || depth != 4 || maxval != 255 || tupleType != "RGB_ALPHA" ||
+            file.size() - offset < bytes) {
+            return false;
+        }
+        rgbaOut->assign(file.begin() + offset, file.begin() + offset + bytes);
+        *widthOut = static_cast<uint32_t>(width);
+        *heightOut = static_cast<uint32_t>(height);
+        return true;
+    }
+
+    static bool loadStoredPng(const std::vector<uint8_t> &file, std::vector<uint8_t> *rgbaOut,
+                              uint32_t *widthOut, uint32_t *heightOut) {
+        uint32_t width = 0, height = 0;
+        std::vector<uint8_t> zlib;
+        size_t offset = sizeof(kPngSignature);
+        bool ended = false;
+        while (!ended && file.size() - offset >= 12) {
+            uint32_t length = readBigEndian32(&file[offset]);
+            const char *type = reinterpret_cast<const char *>(&file[offset + 4]);
+            const uint8_t *data = &file[offset + 8];
+            if (length > file.size() - offset - 12 ||
+                crc32(0, &file[offset + 4], length + 4) != readBigEndian32(data + length)) {
+                return false;
+            }
+            if (!strncmp(type, "IHDR", 4)) {
+                // 8-bit RGBA, deflate, standard filtering, not interlaced
+                if (length != 13 || data[8] != 8 || data[9] != 6 || data[10] || data[11] || data[12]) {
+                    return false;
+                }
+                width = readBigEndian32(data);
+                height = readBigEndian32(data + 4);
+            } else if (!strncmp(type, "IDAT", 4)) {
+                zlib.insert(zlib.end(), data, data + length);
+            } else if (!strncmp(type, "IEND", 4)) {
+                ended = true;
+            }
+            offset += length + 12;
+        }
+        if (!ended || !width || !height || zlib.size() < 6 || (zlib[0] & 0x0f) != 8) {
+            return false;
+        }
+
+        size_t rowBytes = static_cast<size_t>(width) * 4;
+        std::vector<uint8_t> scanlines;
+        size_t position = 2;
+        bool last = false;
+        while (!last) {
+            // only stored blocks: their 3 header bits are padded to a byte
+            if (zlib.size() - position < 5 || (zlib[position] & 0x06) != 0) {
+                return false;
+            }
+            last = zlib[position] & 1;
+            uint16_t blockBytes = static_cast<uint16_t>(zlib[position + 1] | (zlib[position + 2] << 8));
+            uint16_t complement = static_cast<uint16_t>(zlib[position + 3] | (zlib[position + 4] << 8));
+            position += 5;
+            if (static_cast<uint16_t>(~complement) != blockBytes || zlib.size() - position < blockBytes) {
+                return false;
+            }
+            scanlines.insert(scanlines.end(), zlib.begin() + position, zlib.begin() + position + blockBytes);
+            position += blockBytes;
+        }
+        if (scanlines.size() != (rowBytes + 1) * height) {
+            return false;
+        }
+        rgbaOut->resize(rowBytes * height);
+        for (uint32_t row = 0; row < height; row++) {
+            const uint8_t *line = &scanlines[(rowBytes + 1) * row];
+            if (line[0] != 0) {
+                return false;
+            }
+            memcpy(&(*rgbaOut)[rowBytes * row], line + 1, rowBytes);
+        }
+        *widthOut = width;
+        *heightOut = height;
+        return true;
+    }
+
+    bool loadCapturedImage(const char *path, std::vector<uint8_t> *rgbaOut, uint32_t *widthOut,
+                           uint32_t *heightOut) {
+        std::vector<uint8_t> file;
+        if (!readFile(path, &file)) {
+            LOGE("[FrameCapture] Could not read %s.", path);
+            return false;
+        }
+        bool loaded = false;
+        if (file.size() >= 3 && !memcmp(file.data(), "P7\n", 3)) {
+            loaded = loadPam(file, rgbaOut, widthOut, heightOut);
+        } else if (file.size() >= sizeof(kPngSignature) &&
+                   !memcmp(file.data(), kPngSignature, sizeof(kPngSignature))) {
+            loaded = loadStoredPng(file, rgbaOut, widthOut, heightOut);
+        }
+        if (!loaded) {
+            LOGE("[FrameCapture] %s is not an image a capture writes.", path);
+        }
+        return loaded;
+    }
+}
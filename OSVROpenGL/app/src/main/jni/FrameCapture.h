@@ -0,0 +1,124 @@
+/*
+ * Copyright (C) 2015 Sensics, Inc. and contributors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef OSVROPENGL_FRAMECAPTURE_H
+#define OSVROPENGL_FRAMECAPTURE_H
+
+#include <cstdint>
+#include <vector>
+
+#include <GLES2/gl2.h>
+
+namespace OSVROpenGL {
+
+    // Captures the eye buffers, and optionally the window, to image files for
+    // debugging and golden-image tests, without the render thread waiting for
+    // the GPU the way a glReadPixels of the frame would.
+    //
+    // A captured frame's images are copied out on the GPU where the frame
+    // leaves them: into a pixel pack buffer on ES 3, where glReadPixels only
+    // queues the copy, or into a staging texture on ES 2. The copies are
+    // fenced, and latencyFrames or more frames later, once their fence has
+    // signalled, pack buffers are mapped and handed to a writer thread as they
+    // are (staging textures are read back, which by then is only the
+    // transfer). The writer encodes and writes them and the next frame
+    // unmaps them. An image with no free slot is dropped and counted, never
+    // waited for.
+    //
+    // Files go to the directory as frame<N>_<source>.png or .pam, N counting
+    // frames from the start of the capture and source being eye0, eye1... or
+    // window. The PNGs are written uncompressed (stored deflate blocks), which
+    // keeps the writer cheap; the PAMs (netpbm's RGB_ALPHA) are the raw pixels
+    // behind a text header. Both have their rows top down.
+    //
+    // Everything but setFrameCapture() and the stats is for the GL thread.
+    static const int kFrameCaptureSlots = 12;
+
+    enum FrameCaptureFormat {
+        FRAME_CAPTURE_PNG = 0,
+        FRAME_CAPTURE_PAM
+    };
+
+    enum FrameCaptureSource {
+        FRAME_CAPTURE_EYE = 0,
+        FRAME_CAPTURE_WINDOW
+    };
+
+    struct FrameCaptureConfig {
+        const char *directory;
+        uint32_t everyNFrames;      // 1 captures every frame
+        uint32_t frameCount;        // frames to capture, 0 for no limit
+        uint32_t latencyFrames;     // frames a copy is left to the GPU before it is collected
+        bool eyes;
+        bool window;
+        int format;                 // a FrameCaptureFormat
+    };
+
+    // Every frame's eye buffers as PNG, collected 3 frames later, with no limit.
+    void defaultFrameCaptureConfig(FrameCaptureConfig *configOut);
+
+    // Starts a capture with config (copied), or stops it with null, from the
+    // next frame on. Any thread.
+    void setFrameCapture(const FrameCaptureConfig *config);
+    bool isFrameCaptureRunning();
+    // Collects every image still in flight, waiting for the GPU, and waits
+    // for the writer to write them out. Needs the context current.
+    void stopFrameCapture();
+
+    // Looks up the pack buffer entry points on ES 3; the slots are made as
+    // they are first used. Call with a current context; anything from an
+    // earlier context is forgotten.
+    bool initFrameCapture();
+    void releaseFrameCapture();
+
+    // The renderer's side. frameCaptureBeginFrame() starts or stops a capture
+    // asked for with setFrameCapture() and decides whether this frame is
+    // captured; captureFramebuffer() then copies a source's rectangle out of
+    // framebuffer if it is (and does nothing otherwise); and
+    // frameCaptureEndFrame() fences the frame's copies and collects the ones
+    // that are done. Leaves GL_FRAMEBUFFER bound to framebuffer.
+    void frameCaptureBeginFrame();
+    bool isCapturingFrame();
+    void captureFramebuffer(FrameCaptureSource source, uint32_t index, GLuint framebuffer,
+                            int x, int y, int width, int height);
+    void frameCaptureEndFrame();
+
+    struct FrameCaptureStats {
+        bool packBuffers;           // ES 3 pixel pack buffers, else staging textures
+        uint64_t frames;            // frames captured
+        uint64_t copied;            // images copied out on the GPU
+        uint64_t written;           // images written to files
+        uint64_t dropped;           // images not copied for want of a free slot
+        uint64_t failed;            // images that could not be written
+        uint64_t bytesWritten;
+        uint64_t latencyFrames;     // frames from copying to collecting, summed over the images
+        uint64_t renderThreadNs;    // copying and collecting, on the GL thread, summed over the frames
+        uint64_t maxRenderThreadNs; // in any one frame
+        uint64_t writerNs;          // encoding and writing, summed
+    };
+
+    void getFrameCaptureStats(FrameCaptureStats *statsOut);
+    void resetFrameCaptureStats();
+
+    // Loads an image written by a capture, for comparing against a golden
+    // one: any PAM with 8-bit RGB_ALPHA tuples, and PNGs as written here (8-bit
+    // RGBA, stored blocks, no filtering). rgbaOut gets the rows top down.
+    bool loadCapturedImage(const char *path, std::vector<uint8_t> *rgbaOut, uint32_t *widthOut,
+                           uint32_t *heightOut);
+}
+
+#endif // OSVROPENGL_FRAMECAPTURE_H
@@ -0,0 +1,179 @@
+/*
+ * Copyright (C) 2015 Sensics, Inc. and contributors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include <atomic>
+#include <cmath>
+#include <ctime>
+
+#include <GLES2/gl2.h>
+
+#include "Logging.h"
+#include "EGLFence.h"
+#include "FramePacer.h"
+#include "FrameStats.h"
+#include "Trace.h"
+
+namespace OSVROpenGL {
+
+    // Longest the pacer waits on one fence before giving up on it.
+    static const uint64_t kFenceTimeoutNs = 100000000ull;
+    // Slack left between the predicted end of the CPU work and the deadline.
+    static const uint64_t kJustInTimeMarginNs = 2000000ull;
+
+    static std::atomic<int> gRequestedDepth(2);
+    static std::atomic<bool> gJustInTime(false);
+    static std::atomic<uint64_t> gDisplayPeriodNs(16666667ull);
+
+    // Fences of the frames in flight, oldest first from gFenceHead.
+    static EGLFence gFences[kFramePacerMaxDepth];
+    static int gFenceHead = 0;
+    static int gFenceCount = 0;
+
+    static FramePacerStats gStats;
+    static uint64_t gFrameStartNs = 0;
+    static bool gReportedTimeout = false;
+
+    // Running estimate of the frame's CPU work, mean plus deviation as for TCP's RTO.
+    static double gWorkMeanNs = 0.0;
+    static double gWorkDeviationNs = 0.0;
+    static bool gHaveWorkEstimate = false;
+
+    static void popOldestFence() {
+        destroyEGLFence(gFences[gFenceHead]);
+        gFences[gFenceHead] = nullptr;
+        gFenceHead = (gFenceHead + 1) % kFramePacerMaxDepth;
+        gFenceCount--;
+    }
+
+    static void sleepUntil(uint64_t targetNs) {
+        timespec ts;
+        ts.tv_sec = static_cast<time_t>(targetNs / 1000000000ull);
+        ts.tv_nsec = static_cast<long>(targetNs % 1000000000ull);
+        while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, nullptr) != 0) {
+            // interrupted; go back to sleep for the rest
+        }
+    }
+
+    void setFramePacing(int maxFramesInFlight, bool justInTime) {
+        if (maxFramesInFlight < 1) {
+            maxFramesInFlight = 1;
+        } else if (maxFramesInFlight > kFramePacerMaxDepth) {
+            maxFramesInFlight = kFramePacerMaxDepth;
+        }
+        gRequestedDepth.store(maxFramesInFlight);
+        gJustInTime.store(justInTime);
+    }
+
+    void setFramePacerDisplayPeriod(uint64_t periodNs) {
+        if (periodNs) {
+            gDisplayPeriodNs.store(periodNs);
+        }
+    }
+
+    void resetFramePacer() {
+        // Any fences belonged to a context that is gone by now.
+        for (int i = 0; i < kFramePacerMaxDepth; i++) {
+            gFences[i] = nullptr;
+        }
+        gFenceHead = 0;
+        gFenceCount = 0;
+        gStats = FramePacerStats();
+        gHaveWorkEstimate = false;
+        gReportedTimeout = false;
+        if (!haveEGLFences()) {
+            LOGI("[FramePacer] No fences; only a depth of 1 (glFinish) can be enforced.");
+        }
+    }
+
+    void framePacerBeginFrame() {
+        int depth = gRequestedDepth.load(std::memory_order_relaxed);
+        uint64_t entryNs = frameStatsNowNs();
+
+        while (gFenceCount > 0 && isEGLFenceSignaled(gFences[gFenceHead])) {
+            popOldestFence();
+        }
+        while (gFenceCount >= depth) {
+            if (!waitEGLFence(gFences[gFenceHead], kFenceTimeoutNs) && !gReportedTimeout) {
+                LOGE("[FramePacer] Frame fence timed out, dropping it.");
+                gReportedTimeout = true;
+            }
+            popOldestFence();
+        }
+        uint64_t startNs = frameStatsNowNs();
+        uint64_t stallNs = startNs - entryNs;
+
+        uint64_t idleNs = 0;
+        bool justInTime = gJustInTime.load(std::memory_order_relaxed);
+        if (justInTime && gHaveWorkEstimate) {
+            uint64_t periodNs = gDisplayPeriodNs.load(std::memory_order_relaxed);
+            uint64_t predictedNs = static_cast<uint64_t>(gWorkMeanNs + 2.0 * gWorkDeviationNs) +
+                                   kJustInTimeMarginNs;
+            if (predictedNs < periodNs && entryNs + periodNs - predictedNs > startNs) {
+                sleepUntil(entryNs + periodNs - predictedNs);
+                uint64_t wokeNs = frameStatsNowNs();
+                idleNs = wokeNs - startNs;
+                startNs = wokeNs;
+            }
+            gStats.predictedWorkNs = predictedNs;
+        }
+
+        recordFrameStage(FRAME_STAGE_PACING_STALL, stallNs);
+        if (justInTime) {
+            recordFrameStage(FRAME_STAGE_PACING_IDLE, idleNs);
+        }
+        gStats.maxFramesInFlight = depth;
+        gStats.lastStallNs = stallNs;
+        gStats.lastIdleNs = idleNs;
+        gStats.displayPeriodNs = gDisplayPeriodNs.load(std::memory_order_relaxed);
+        gFrameStartNs = startNs;
+    }
+
+    void framePacerEndFrame() {
+        uint64_t workNs = frameStatsNowNs() - gFrameStartNs;
+        gStats.lastWorkNs = workNs;
+        if (gHaveWorkEstimate) {
+            double error = workNs - gWorkMeanNs;
+            gWorkMeanNs += error / 8.0;
+            gWorkDeviationNs += (fabs(error) - gWorkDeviationNs) / 4.0;
+        } else {
+            gWorkMeanNs = workNs;
+            gWorkDeviationNs = workNs / 2.0;
+            gHaveWorkEstimate = true;
+        }
+
+        if (haveEGLFences()) {
+            EGLFence fence = createEGLFence();
+            if (fence) {
+                if (gFenceCount == kFramePacerMaxDepth) {
+                    // only if the depth was lowered mid-frame; keep the newest
+                    popOldestFence();
+                }
+                gFences[(gFenceHead + gFenceCount) % kFramePacerMaxDepth] = fence;
+                gFenceCount++;
+            }
+        } else if (gStats.maxFramesInFlight == 1) {
+            glFinish();
+        }
+
+        gStats.framesInFlight = gFenceCount;
+        OSVR_TRACE_COUNTER("framesInFlight", static_cast<double>(gFenceCount));
+    }
+
+    void getFramePacerStats(FramePacerStats *statsOut) {
+        *statsOut = gStats;
+    }
+}
@@ -0,0 +1,67 @@
+/*
+ * Copyright (C) 2015 Sensics, Inc. and contributors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef OSVROPENGL_FRAMEPACER_H
+#define OSVROPENGL_FRAMEPACER_H
+
+#include <cstdint>
+
+namespace OSVROpenGL {
+
+    // Caps how many frames the GPU may be behind the CPU. Each frame ends with
+    // an EGL fence; before a frame starts, the pacer waits for the oldest fence
+    // once the cap is reached (the stall). With a depth of 2 or 3 the CPU
+    // builds frame N+1 while the GPU is still on frame N; a depth of 1 trades
+    // that overlap for the shortest queue. Without EGL_KHR_fence_sync a depth
+    // of 1 falls back to glFinish() and deeper queues are left to the driver.
+    //
+    // Optionally the start of the frame is also delayed "just in time" (the
+    // idle), so the head pose is sampled as late as the predicted CPU work
+    // allows: the deadline is taken to be one display period after the frame
+    // was requested, which is when GLSurfaceView asks right after a swap.
+    //
+    // Stall and idle times go into the FRAME_STAGE_PACING_* frame stats.
+    // Configuration may change from any thread; everything else is GL thread only.
+    static const int kFramePacerMaxDepth = 3;
+
+    struct FramePacerStats {
+        int maxFramesInFlight;      // the depth in use
+        int framesInFlight;         // frames not known to be finished, counting the one just submitted
+        uint64_t lastStallNs;
+        uint64_t lastIdleNs;
+        uint64_t lastWorkNs;        // CPU time from frame start to submit
+        uint64_t predictedWorkNs;   // the same, as predicted for the idle
+        uint64_t displayPeriodNs;
+    };
+
+    // depth is clamped to 1..kFramePacerMaxDepth; the default is 2, no just-in-time start.
+    void setFramePacing(int maxFramesInFlight, bool justInTime);
+    void setFramePacerDisplayPeriod(uint64_t periodNs);
+
+    // Forgets frames in flight; call when a new context has been made current,
+    // after initEGLFences().
+    void resetFramePacer();
+
+    // Call before anything in the frame samples the pose.
+    void framePacerBeginFrame();
+    // Call once all of the frame's GL work has been issued.
+    void framePacerEndFrame();
+
+    void getFramePacerStats(FramePacerStats *statsOut);
+}
+
+#endif // OSVROPENGL_FRAMEPACER_H
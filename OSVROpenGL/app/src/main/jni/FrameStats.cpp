@@ -0,0 +1,154 @@
+/*
+ * Copyright (C) 2015 Sensics, Inc. and contributors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include <cstring>
+
+#include "Logging.h"
+#include "FrameStats.h"
+#include "Trace.h"
+
+namespace OSVROpenGL {
+
+    // how often endFrameStats() logs a summary (~10 seconds at 60Hz)
+    static const uint32_t kSummaryIntervalFrames = 600;
+
+    static FrameTimeHistogram gFrameStageHistograms[FRAME_STAGE_COUNT];
+    static uint32_t gFramesSinceSummary = 0;
+
+    void FrameTimeHistogram::reset() {
+        memset(mCounts, 0, sizeof(mCounts));
+        mTotalCount = 0;
+        mMaxNs = 0;
+    }
+
+    uint64_t FrameTimeHistogram::bucketUpperBound(int index) {
+        if (index < kSubBucketCount) {
+            return static_cast<uint64_t>(index);
+        }
+        int shift = (index >> kSubBucketBits) - 1;
+        uint64_t subBucket = static_cast<uint64_t>(index & (kSubBucketCount - 1));
+        uint64_t lower = (kSubBucketCount + subBucket) << shift;
+        return lower + (1ull << shift) - 1;
+    }
+
+    uint64_t FrameTimeHistogram::percentileNs(double percentile) const {
+        if (mTotalCount == 0) {
+            return 0;
+        }
+        uint64_t target = static_cast<uint64_t>(percentile / 100.0 * mTotalCount + 0.5);
+        if (target < 1) {
+            target = 1;
+        }
+        uint64_t seen = 0;
+        for (int i = 0; i < kBucketCount; i++) {
+            seen += mCounts[i];
+            if (seen >= target) {
+                uint64_t value = bucketUpperBound(i);
+                return value < mMaxNs ? value : mMaxNs;
+            }
+        }
+        return mMaxNs;
+    }
+
+    const char *frameStageName(int stage) {
+        switch (stage) {
+            case FRAME_STAGE_FRAME: return "frame";
+            case FRAME_STAGE_CLIENT_UPDATE: return "clientUpdate";
+            case FRAME_STAGE_TEXTURE_UPLOAD: return "textureUpload";
+            case FRAME_STAGE_RENDER_INFO: return "renderInfo";
+            case FRAME_STAGE_SCENE_UPDATE: return "sceneUpdate";
+            case FRAME_STAGE_EYE_LEFT: return "eyeLeft";
+            case FRAME_STAGE_EYE_RIGHT: return "eyeRight";
+            case FRAME_STAGE_PRESENT: return "present";
+            case FRAME_STAGE_APP_FRAME: return "appFrame";
+            case FRAME_STAGE_REPROJECTION: return "reprojection";
+            case FRAME_STAGE_CAPTURE: return "capture";
+            case FRAME_STAGE_GPU_TEXTURE_UPLOAD: return "gpuTextureUpload";
+            case FRAME_STAGE_GPU_EYE_LEFT: return "gpuEyeLeft";
+            case FRAME_STAGE_GPU_EYE_RIGHT: return "gpuEyeRight";
+            case FRAME_STAGE_GPU_PRESENT: return "gpuPresent";
+            case FRAME_STAGE_LATENCY_SUBMIT: return "latencySubmit";
+            case FRAME_STAGE_LATENCY_GPU_DONE: return "latencyGpuDone";
+            case FRAME_STAGE_MOTION_TO_PHOTON: return "motionToPhoton";
+            case FRAME_STAGE_PACING_STALL: return "pacingStall";
+            case FRAME_STAGE_PACING_IDLE: return "pacingIdle";
+            default: return "unknown";
+        }
+    }
+
+#if OSVROPENGL_FRAME_STATS
+    void recordFrameStage(FrameStage stage, uint64_t durationNs) {
+        gFrameStageHistograms[stage].record(durationNs);
+    }
+
+    void recordFrameStageSpan(FrameStage stage, uint64_t startNs, uint64_t endNs) {
+        gFrameStageHistograms[stage].record(endNs - startNs);
+#if OSVROPENGL_TRACING
+        if (isTracingEnabled()) {
+            traceComplete(frameStageName(stage), startNs, endNs - startNs);
+        }
+#endif
+    }
+
+    void endFrameStats() {
+        if (++gFramesSinceSummary >= kSummaryIntervalFrames) {
+            gFramesSinceSummary = 0;
+            logFrameStatsSummary();
+        }
+    }
+#else
+    void recordFrameStage(FrameStage stage, uint64_t durationNs) {
+    }
+
+    void recordFrameStageSpan(FrameStage stage, uint64_t startNs, uint64_t endNs) {
+    }
+
+    void endFrameStats() {
+    }
+#endif
+
+    void getFrameStageSummary(FrameStage stage, FrameStageSummary *summaryOut) {
+        const FrameTimeHistogram &histogram = gFrameStageHistograms[stage];
+        summaryOut->count = histogram.count();
+        summaryOut->p50Ns = histogram.percentileNs(50.0);
+        summaryOut->p90Ns = histogram.percentileNs(90.0);
+        summaryOut->p99Ns = histogram.percentileNs(99.0);
+        summaryOut->maxNs = histogram.maxNs();
+    }
+
+    void logFrameStatsSummary() {
+        LOGI("[FrameStats] stage: count p50/p90/p99/max (ms)");
+        for (int stage = 0; stage < FRAME_STAGE_COUNT; stage++) {
+            FrameStageSummary summary;
+            getFrameStageSummary(static_cast<FrameStage>(stage), &summary);
+            if (summary.count == 0) {
+                continue;
+            }
+            LOGI("[FrameStats] %s: %llu %.3f/%.3f/%.3f/%.3f", frameStageName(stage),
+                 static_cast<unsigned long long>(summary.count),
+                 summary.p50Ns / 1.0e6, summary.p90Ns / 1.0e6,
+                 summary.p99Ns / 1.0e6, summary.maxNs / 1.0e6);
+        }
+    }
+
+    void resetFrameStats() {
+        for (int stage = 0; stage < FRAME_STAGE_COUNT; stage++) {
+            gFrameStageHistograms[stage].reset();
+        }
+        gFramesSinceSummary = 0;
+    }
+}
@@ -0,0 +1,196 @@
+/*
+ * Copyright (C) 2015 Sensics, Inc. and contributors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef OSVROPENGL_FRAMESTATS_H
+#define OSVROPENGL_FRAMESTATS_H
+
+#include <cstddef>
+#include <cstdint>
+#include <time.h>
+
+// Build with -DOSVROPENGL_FRAME_STATS=0 to compile the frame timers out entirely.
+#ifndef OSVROPENGL_FRAME_STATS
+#define OSVROPENGL_FRAME_STATS 1
+#endif
+
+namespace OSVROpenGL {
+
+    // Timed stages of renderFrame. Keep frameStageName() in sync.
+    enum FrameStage {
+        FRAME_STAGE_FRAME = 0,          // all of renderFrame
+        FRAME_STAGE_CLIENT_UPDATE,      // osvrClientUpdate (includes the report callbacks)
+        FRAME_STAGE_TEXTURE_UPLOAD,     // camera frame upload
+        FRAME_STAGE_RENDER_INFO,        // render params + render info collection
+        FRAME_STAGE_SCENE_UPDATE,       // waiting for the scene's animation, culling and draw lists
+        FRAME_STAGE_EYE_LEFT,           // first eye pass
+        FRAME_STAGE_EYE_RIGHT,          // second (and any further) eye pass
+        FRAME_STAGE_PRESENT,            // presenting the eyes (RenderManager or the distortion mesh)
+        FRAME_STAGE_APP_FRAME,          // a whole frame on the async reprojection app thread
+        FRAME_STAGE_REPROJECTION,       // rotating the last app frame to the new pose
+        FRAME_STAGE_CAPTURE,            // copying out and collecting captured images (see FrameCapture.h)
+
+        // GPU time for the matching CPU stages, from GpuProfiler
+        FRAME_STAGE_GPU_TEXTURE_UPLOAD,
+        FRAME_STAGE_GPU_EYE_LEFT,
+        FRAME_STAGE_GPU_EYE_RIGHT,
+        FRAME_STAGE_GPU_PRESENT,
+
+        // Latency from the head pose's timestamp, from LatencyMonitor
+        FRAME_STAGE_LATENCY_SUBMIT,     // to the present being submitted
+        FRAME_STAGE_LATENCY_GPU_DONE,   // to the GPU finishing the frame
+        FRAME_STAGE_MOTION_TO_PHOTON,   // to the frame being presented (and rendered)
+
+        // Frame pacing, from FramePacer
+        FRAME_STAGE_PACING_STALL,       // waiting for the GPU to drain frames in flight
+        FRAME_STAGE_PACING_IDLE,        // just-in-time start delay
+        FRAME_STAGE_COUNT
+    };
+
+    static const int FRAME_STAGE_GPU_FIRST = FRAME_STAGE_GPU_TEXTURE_UPLOAD;
+    static const int FRAME_STAGE_GPU_COUNT = FRAME_STAGE_GPU_PRESENT + 1 - FRAME_STAGE_GPU_FIRST;
+
+    inline FrameStage eyeFrameStage(size_t eye) {
+        return eye == 0 ? FRAME_STAGE_EYE_LEFT : FRAME_STAGE_EYE_RIGHT;
+    }
+
+    inline FrameStage gpuEyeFrameStage(size_t eye) {
+        return eye == 0 ? FRAME_STAGE_GPU_EYE_LEFT : FRAME_STAGE_GPU_EYE_RIGHT;
+    }
+
+    inline uint64_t frameStatsNowNs() {
+        timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return static_cast<uint64_t>(ts.tv_sec) * 1000000000ull + static_cast<uint64_t>(ts.tv_nsec);
+    }
+
+    // Fixed-bucket log-linear histogram in the style of HdrHistogram: every power
+    // of two range is split into 2^kSubBucketBits linear buckets, so values are
+    // kept to ~3% relative precision from 1ns up to ~68s. Recording is a couple
+    // of integer ops and an increment; nothing allocates.
+    class FrameTimeHistogram {
+    public:
+        static const int kSubBucketBits = 5;
+        static const int kSubBucketCount = 1 << kSubBucketBits;
+        static const int kMaxMagnitude = 36;
+        static const int kBucketCount = (kMaxMagnitude - kSubBucketBits + 2) << kSubBucketBits;
+
+        FrameTimeHistogram() { reset(); }
+
+        void reset();
+
+        void record(uint64_t valueNs) {
+            mCounts[bucketIndex(valueNs)]++;
+            mTotalCount++;
+            if (valueNs > mMaxNs) {
+                mMaxNs = valueNs;
+            }
+        }
+
+        uint64_t count() const { return mTotalCount; }
+        uint64_t maxNs() const { return mMaxNs; }
+
+        // Value at the given percentile (0-100), reported as the upper edge of
+        // its bucket but never more than the recorded maximum.
+        uint64_t percentileNs(double percentile) const;
+
+        static int bucketIndex(uint64_t value) {
+            if (value < static_cast<uint64_t>(kSubBucketCount)) {
+                return static_cast<int>(value);
+            }
+            int magnitude = 63 - __builtin_clzll(value);
+            if (magnitude > kMaxMagnitude) {
+                return kBucketCount - 1;
+            }
+            int shift = magnitude - kSubBucketBits;
+            return ((shift + 1) << kSubBucketBits) +
+                   static_cast<int>((value >> shift) - kSubBucketCount);
+        }
+
+        static uint64_t bucketUpperBound(int index);
+
+    private:
+        uint32_t mCounts[kBucketCount];
+        uint64_t mTotalCount;
+        uint64_t mMaxNs;
+    };
+
+    struct FrameStageSummary {
+        uint64_t count;
+        uint64_t p50Ns;
+        uint64_t p90Ns;
+        uint64_t p99Ns;
+        uint64_t maxNs;
+    };
+
+    const char *frameStageName(int stage);
+
+    // Adds one sample to a stage histogram. Each stage must only ever be
+    // recorded from one thread (with async reprojection on, the app thread
+    // records the upload, scene and eye stages and the GL thread the rest).
+    void recordFrameStage(FrameStage stage, uint64_t durationNs);
+    // Same, and also emits the span to the trace timeline when tracing.
+    void recordFrameStageSpan(FrameStage stage, uint64_t startNs, uint64_t endNs);
+
+    // Marks the end of a frame; logs a summary every few hundred frames.
+    void endFrameStats();
+
+    void getFrameStageSummary(FrameStage stage, FrameStageSummary *summaryOut);
+    void logFrameStatsSummary();
+    void resetFrameStats();
+
+    class ScopedFrameStageTimer {
+        FrameStage mStage;
+        uint64_t mStartNs;
+        bool mRunning;
+
+    public:
+        explicit ScopedFrameStageTimer(FrameStage stage)
+            : mStage(stage), mStartNs(frameStatsNowNs()), mRunning(true) {
+        }
+
+        ~ScopedFrameStageTimer() {
+            stop();
+        }
+
+        void stop() {
+            if (mRunning) {
+                recordFrameStageSpan(mStage, mStartNs, frameStatsNowNs());
+                mRunning = false;
+            }
+        }
+    };
+}
+
+#define OSVR_FRAME_STATS_CONCAT_IMPL(a, b) a##b
+#define OSVR_FRAME_STATS_CONCAT(a, b) OSVR_FRAME_STATS_CONCAT_IMPL(a, b)
+
+#if OSVROPENGL_FRAME_STATS
+// Times the rest of the enclosing scope.
+#define OSVR_FRAME_STAGE_TIMER(stage) \
+    ::OSVROpenGL::ScopedFrameStageTimer OSVR_FRAME_STATS_CONCAT(frameStageTimer, __LINE__)(stage)
+// Times an explicit region within a scope; stage must be a FrameStage enumerator.
+#define OSVR_FRAME_STAGE_BEGIN(stage) ::OSVROpenGL::ScopedFrameStageTimer frameStageTimer_##stage(stage)
+#define OSVR_FRAME_STAGE_END(stage) frameStageTimer_##stage.stop()
+#define OSVR_FRAME_STATS_END_FRAME() ::OSVROpenGL::endFrameStats()
+#else
+#define OSVR_FRAME_STAGE_TIMER(stage) ((void)0)
+#define OSVR_FRAME_STAGE_BEGIN(stage) ((void)0)
+#define OSVR_FRAME_STAGE_END(stage) ((void)0)
+#define OSVR_FRAME_STATS_END_FRAME() ((void)0)
+#endif
+
+#endif // OSVROPENGL_FRAMESTATS_H
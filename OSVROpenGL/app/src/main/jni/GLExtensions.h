@@ -0,0 +1,62 @@
+/*
+ * Copyright (C) 2015 Sensics, Inc. and contributors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef OSVROPENGL_GLEXTENSIONS_H
+#define OSVROPENGL_GLEXTENSIONS_H
+
+#include <cstdlib>
+#include <cstring>
+
+#include <EGL/egl.h>
+#include <GLES2/gl2.h>
+
+namespace OSVROpenGL {
+
+    // True if name appears as a whole token in the space separated list.
+    inline bool hasExtensionToken(const char *extensions, const char *name) {
+        if (!extensions || !name || !*name) {
+            return false;
+        }
+        size_t length = strlen(name);
+        for (const char *p = strstr(extensions, name); p; p = strstr(p + length, name)) {
+            bool startsToken = p == extensions || p[-1] == ' ';
+            bool endsToken = p[length] == ' ' || p[length] == '\0';
+            if (startsToken && endsToken) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // True if name appears in GL_EXTENSIONS. Needs a current context.
+    inline bool hasGLExtension(const char *name) {
+        return hasExtensionToken(reinterpret_cast<const char *>(glGetString(GL_EXTENSIONS)), name);
+    }
+
+    inline bool hasEGLExtension(EGLDisplay display, const char *name) {
+        return hasExtensionToken(eglQueryString(display, EGL_EXTENSIONS), name);
+    }
+
+    // The context is ES 3.0 or later, whatever version was asked for. Needs a
+    // current context.
+    inline bool isOpenGLES3() {
+        const char *version = reinterpret_cast<const char *>(glGetString(GL_VERSION));
+        return version && !strncmp(version, "OpenGL ES ", 10) && atoi(version + 10) >= 3;
+    }
+}
+
+#endif // OSVROPENGL_GLEXTENSIONS_H
@@ -0,0 +1,555 @@
+/*
+ * Copyright (C) 2015 Sensics, Inc. and contributors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include <algorithm>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+#include "Logging.h"
+#include "FrameStats.h"
+#include "GpuMemory.h"
+#include "Trace.h"
+
+namespace OSVROpenGL {
+
+    struct GpuObject {
+        bool live;
+        GpuObjectType type;
+        GLuint name;
+        GpuMemoryCategory category;
+        uint64_t bytes;
+        uint32_t serial;            // tells a name's reuse from the object a load was for
+        // evictable textures only
+        bool evictable;
+        std::string source;
+        uint32_t levelCount;
+        uint32_t droppedLevels;
+        GpuTextureStageFunction stage;
+        GpuTextureUploadFunction upload;
+        uint64_t lastUsedFrame;
+        bool loading;
+    };
+
+    enum GpuTextureLoadState {
+        LOAD_FREE,
+        LOAD_QUEUED,    // for the loader
+        LOAD_STAGING,   // the loader has it
+        LOAD_STAGED     // for the drawing thread to upload
+    };
+
+    struct GpuTextureLoad {
+        GpuTextureLoadState state;
+        GLuint texture;
+        uint32_t serial;
+        uint32_t firstLevel;
+        int64_t expectedDelta;      // bytes, guessed when it was queued
+        bool staged;
+        std::string source;         // loader thread
+        std::vector<uint8_t> levels;
+    };
+
+    static const int kMaxGpuTextureLoads = 4;
+    // A texture drawn within this many frames counts as wanted back.
+    static const uint64_t kRestoreRecentFrames = 2;
+
+    static std::mutex gMutex;
+    static GpuObject gObjects[kMaxTrackedGpuObjects];
+    static uint32_t gNextSerial = 1;
+    static uint64_t gCategoryBytes[kGpuMemoryCategories] = {};
+    static uint32_t gCategoryObjects[kGpuMemoryCategories] = {};
+    static uint64_t gBudgetBytes = 0;
+    static uint64_t gOutOfMemoryBudgetBytes = 0;
+    static uint64_t gFrame = 0;
+    static bool gOverBudget = false;
+    static bool gUntrackedLogged = false;
+    static GpuTextureLoad gLoads[kMaxGpuTextureLoads];
+    static GpuMemoryStats gStats = {};
+
+    static std::thread gLoaderThread;
+    static bool gLoaderRunning = false;     // under gMutex
+    static bool gLoaderStopping = false;
+    static std::condition_variable gLoaderCondition;
+
+    const char *gpuMemoryCategoryName(GpuMemoryCategory category) {
+        switch (category) {
+            case GPU_MEMORY_TEXTURES: return "textures";
+            case GPU_MEMORY_RENDER_TARGETS: return "render targets";
+            case GPU_MEMORY_BUFFERS: return "buffers";
+            default: return "?";
+        }
+    }
+
+    static uint64_t usedBytes() {
+        uint64_t bytes = 0;
+        for (int i = 0; i < kGpuMemoryCategories; i++) {
+            bytes += gCategoryBytes[i];
+        }
+        return bytes;
+    }
+
+    static uint64_t effectiveBudget() {
+        if (gBudgetBytes && gOutOfMemoryBudgetBytes) {
+            return std::min(gBudgetBytes, gOutOfMemoryBudgetBytes);
+        }
+        return gBudgetBytes ? gBudgetBytes : gOutOfMemoryBudgetBytes;
+    }
+
+    static GpuObject *findObject(GpuObjectType type, GLuint name) {
+        for (int i = 0; i < kMaxTrackedGpuObjects; i++) {
+            if (gObjects[i].live && gObjects[i].type == type && gObjects[i].name == name) {
+                return &gObjects[i];
+            }
+        }
+        return nullptr;
+    }
+
+    static GpuObject *findTexture(GLuint texture, uint32_t serial) {
+        GpuObject *object = findObject(GPU_OBJECT_TEXTURE, texture);
+        return object && object->serial == serial ? object : nullptr;
+    }
+
+    static void loaderMain() {
+        traceSetThreadName("GpuMemoryLoader");
+        std::unique_lock<std::mutex> lock(gMutex);
+        for (;;) {
+            GpuTextureLoad *load = nullptr;
+            gLoaderCondition.wait(lock, [&load] {
+                for (int i = 0; i < kMaxGpuTextureLoads && !load; i++) {
+                    if (gLoads[i].state == LOAD_QUEUED) {
+                        load = &gLoads[i];
+                    }
+                }
+                return load || gLoaderStopping;
+            });
+            if (gLoaderStopping) {
+                return;
+            }
+            GpuObject *object = findTexture(load->texture, load->serial);
+            if (!object) {
+                load->state = LOAD_STAGED;
+                load->staged = false;
+                continue;
+            }
+            load->state = LOAD_STAGING;
+            load->source = object->source;
+            GpuTextureStageFunction stage = object->stage;
+
+            lock.unlock();
+            uint64_t startNs = frameStatsNowNs();
+            bool staged;
+            {
+                OSVR_TRACE_SCOPE("stageGpuTexture");
+                staged = stage(load->source, load->firstLevel, &load->levels);
+            }
+            uint64_t stageNs = frameStatsNowNs() - startNs;
+            lock.lock();
+
+            load->staged = staged;
+            load->state = LOAD_STAGED;
+            gStats.stageNs += stageNs;
+        }
+    }
+
+    // With gMutex held; the caller joins the thread after letting go of it.
+    static bool stopLoaderLocked() {
+        if (!gLoaderRunning) {
+            return false;
+        }
+        gLoaderStopping = true;
+        gLoaderRunning = false;
+        gLoaderCondition.notify_all();
+        return true;
+    }
+
+    static void forgetEverything() {
+        bool join;
+        {
+            std::lock_guard<std::mutex> lock(gMutex);
+            join = stopLoaderLocked();
+        }
+        if (join) {
+            gLoaderThread.join();
+        }
+        std::lock_guard<std::mutex> lock(gMutex);
+        gLoaderStopping = false;
+        for (int i = 0; i < kMaxTrackedGpuObjects; i++) {
+            gObjects[i].live = false;
+            gObjects[i].evictable = false;
+        }
+        for (int i = 0; i < kMaxGpuTextureLoads; i++) {
+            gLoads[i].state = LOAD_FREE;
+        }
+        for (int i = 0; i < kGpuMemoryCategories; i++) {
+            gCategoryBytes[i] = 0;
+            gCategoryObjects[i] = 0;
+        }
+        gOutOfMemoryBudgetBytes = 0;
+        gOverBudget = false;
+    }
+
+    void initGpuMemory() {
+        forgetEverything();
+    }
+
+    void releaseGpuMemory() {
+        forgetEverything();
+    }
+
+    void trackGpuObject(GpuObjectType type, GLuint name, GpuMemoryCategory category, uint64_t bytes) {
+        if (!name) {
+            return;
+        }
+        std::lock_guard<std::mutex> lock(gMutex);
+        GpuObject *object = findObject(type, name);
+        if (!object) {
+            for (int i = 0; i < kMaxTrackedGpuObjects && !object; i++) {
+                if (!gObjects[i].live) {
+                    object = &gObjects[i];
+                }
+            }
+            if (!object) {
+                gStats.untrackedObjects++;
+                if (!gUntrackedLogged) {
+                    LOGE("[GpuMemory] More than %d objects; not tracking the rest.", kMaxTrackedGpuObjects);
+                    gUntrackedLogged = true;
+                }
+                return;
+            }
+            object->live = true;
+            object->type = type;
+            object->name = name;
+            object->category = category;
+            object->bytes = 0;
+            object->serial = gNextSerial++;
+            object->evictable = false;
+            object->loading = false;
+            object->lastUsedFrame = gFrame;
+            gCategoryObjects[category]++;
+        } else if (object->category != category) {
+            gCategoryBytes[object->category] -= object->bytes;
+            gCategoryObjects[object->category]--;
+            object->bytes = 0;
+            object->category = category;
+            gCategoryObjects[category]++;
+        }
+        gCategoryBytes[category] += bytes - object->bytes;
+        object->bytes = bytes;
+        gStats.peakUsedBytes = std::max(gStats.peakUsedBytes, usedBytes());
+    }
+
+    void forgetGpuObject(GpuObjectType type, GLuint name) {
+        std::lock_guard<std::mutex> lock(gMutex);
+        GpuObject *object = findObject(type, name);
+        if (!object) {
+            return;
+        }
+        // a load in flight for it finds it gone and is dropped
+        gCategoryBytes[object->category] -= object->bytes;
+        gCategoryObjects[object->category]--;
+        object->live = false;
+        object->evictable = false;
+    }
+
+    void makeGpuTextureEvictable(GLuint texture, const char *source, uint32_t levelCount,
+                                 GpuTextureStageFunction stage, GpuTextureUploadFunction upload) {
+        std::lock_guard<std::mutex> lock(gMutex);
+        GpuObject *object = findObject(GPU_OBJECT_TEXTURE, texture);
+        if (!object || levelCount < 2) {
+            return;
+        }
+        object->evictable = true;
+        object->source = source;
+        object->levelCount = levelCount;
+        object->droppedLevels = 0;
+        object->stage = stage;
+        object->upload = upload;
+        if (!gLoaderRunning) {
+            gLoaderStopping = false;
+            gLoaderThread = std::thread(loaderMain);
+            gLoaderRunning = true;
+        }
+    }
+
+    void useGpuTexture(GLuint texture) {
+        std::lock_guard<std::mutex> lock(gMutex);
+        GpuObject *object = findObject(GPU_OBJECT_TEXTURE, texture);
+        if (object) {
+            object->lastUsedFrame = gFrame;
+        }
+    }
+
+    void setGpuMemoryBudget(uint64_t bytes) {
+        std::lock_guard<std::mutex> lock(gMutex);
+        gBudgetBytes = bytes;
+        gOutOfMemoryBudgetBytes = 0;
+    }
+
+    void noteGpuOutOfMemory() {
+        std::lock_guard<std::mutex> lock(gMutex);
+        gStats.outOfMemoryErrors++;
+        if (!usedBytes()) {
+            return;
+        }
+        uint64_t budget = usedBytes() / 10 * 9;
+        uint64_t current = effectiveBudget();
+        if (!current || budget < current) {
+            gOutOfMemoryBudgetBytes = budget;
+            LOGE("[GpuMemory] Out of GPU memory with %llu KB tracked; budget lowered to %llu KB.",
+                 static_cast<unsigned long long>(usedBytes() / 1024),
+                 static_cast<unsigned long long>(budget / 1024));
+        }
+    }
+
+    static GpuTextureLoad *freeLoad() {
+        for (int i = 0; i < kMaxGpuTextureLoads; i++) {
+            if (gLoads[i].state == LOAD_FREE) {
+                return &gLoads[i];
+            }
+        }
+        return nullptr;
+    }
+
+    static void queueLoad(GpuTextureLoad *load, GpuObject *object, uint32_t firstLevel, int64_t expectedDelta) {
+        load->state = LOAD_QUEUED;
+        load->texture = object->name;
+        load->serial = object->serial;
+        load->firstLevel = firstLevel;
+        load->expectedDelta = expectedDelta;
+        load->staged = false;
+        object->loading = true;
+    }
+
+    // Uploads the oldest staged load, if there is one. With the lock held; lets
+    // go of it for the upload.
+    static void uploadStagedLoad(std::unique_lock<std::mutex> &lock) {
+        GpuTextureLoad *load = nullptr;
+        for (int i = 0; i < kMaxGpuTextureLoads && !load; i++) {
+            if (gLoads[i].state == LOAD_STAGED) {
+                load = &gLoads[i];
+            }
+        }
+        if (!load) {
+            return;
+        }
+        GpuObject *object = findTexture(load->texture, load->serial);
+        if (!object) {
+            load->state = LOAD_FREE;
+            return;
+        }
+        if (!load->staged) {
+            // left as it is from now on, rather than tried again every frame
+            LOGE("[GpuMemory] Could not read levels %u on of texture %u from %s; no longer evicting it.",
+                 load->firstLevel, load->texture, object->source.c_str());
+            gStats.failedLoads++;
+            object->loading = false;
+            object->evictable = false;
+            load->state = LOAD_FREE;
+            return;
+        }
+
+        GpuTextureUploadFunction upload = object->upload;
+        lock.unlock();
+        uint64_t startNs = frameStatsNowNs();
+        uint64_t bytes;
+        {
+            OSVR_TRACE_SCOPE("uploadGpuTexture");
+            bytes = upload(load->texture, load->firstLevel, load->levels);
+        }
+        uint64_t uploadNs = frameStatsNowNs() - startNs;
+        lock.lock();
+
+        gStats.maxUploadNs = std::max(gStats.maxUploadNs, uploadNs);
+        load->state = LOAD_FREE;
+        object = findTexture(load->texture, load->serial);
+        if (!object) {
+            return;
+        }
+        object->loading = false;
+        if (!bytes) {
+            LOGE("[GpuMemory] Could not upload levels %u on of texture %u; no longer evicting it.",
+                 load->firstLevel, load->texture);
+            gStats.failedLoads++;
+            object->evictable = false;
+            return;
+        }
+        uint32_t previousLevels = object->droppedLevels;
+        uint64_t previousBytes = object->bytes;
+        object->droppedLevels = load->firstLevel;
+        gCategoryBytes[object->category] += bytes - previousBytes;
+        object->bytes = bytes;
+        if (load->firstLevel > previousLevels) {
+            gStats.evictions++;
+            gStats.categoryEvictions[object->category]++;
+            gStats.evictedBytes += previousBytes > bytes ? previousBytes - bytes : 0;
+        } else {
+            gStats.restores++;
+            gStats.restoredBytes += bytes > previousBytes ? bytes - previousBytes : 0;
+            gStats.peakUsedBytes = std::max(gStats.peakUsedBytes, usedBytes());
+        }
+        LOGI("[GpuMemory] Texture %u (%s) now starts at level %u of %u (was %u): %llu KB, was %llu KB.",
+             object->name, object->source.c_str(), load->firstLevel, object->levelCount, previousLevels,
+             static_cast<unsigned long long>(bytes / 1024), static_cast<unsigned long long>(previousBytes / 1024));
+    }
+
+    // Each level dropped leaves about a quarter; for a guess that is good
+    // enough, as the next frame looks again.
+    static uint64_t bytesAfterDropping(uint64_t bytes, uint32_t levels) {
+        return levels >= 32 ? 0 : bytes >> (2 * levels);
+    }
+
+    // The least recently drawn until the guessed total fits.
+    static bool queueEvictions(uint64_t budget, int64_t *projected) {
+        bool queued = false;
+        while (*projected > static_cast<int64_t>(budget)) {
+            GpuObject *victim = nullptr;
+            for (int i = 0; i < kMaxTrackedGpuObjects; i++) {
+                GpuObject &object = gObjects[i];
+                if (!object.live || !object.evictable || object.loading ||
+                    object.droppedLevels + 1 >= object.levelCount) {
+                    continue;
+                }
+                if (!victim || object.lastUsedFrame < victim->lastUsedFrame ||
+                    (object.lastUsedFrame == victim->lastUsedFrame && object.bytes > victim->bytes)) {
+                    victim = &object;
+                }
+            }
+            GpuTextureLoad *load = freeLoad();
+            if (!victim || !load) {
+                break;
+            }
+            uint32_t maxLevels = victim->levelCount - 1 - victim->droppedLevels;
+            uint32_t levels = 1;
+            int64_t saved = static_cast<int64_t>(victim->bytes - bytesAfterDropping(victim->bytes, levels));
+            while (levels < maxLevels && *projected - saved > static_cast<int64_t>(budget)) {
+                levels++;
+                saved = static_cast<int64_t>(victim->bytes - bytesAfterDropping(victim->bytes, levels));
+            }
+            queueLoad(load, victim, victim->droppedLevels + levels, -saved);
+            *projected -= saved;
+            queued = true;
+        }
+        return queued;
+    }
+
+    // The most recently drawn texture that has lost levels gets back as many
+    // as fit under limit.
+    static bool queueRestore(uint64_t limit, int64_t projected) {
+        GpuObject *wanted = nullptr;
+        for (int i = 0; i < kMaxTrackedGpuObjects; i++) {
+            GpuObject &object = gObjects[i];
+            if (!object.live || !object.evictable || object.loading || !object.droppedLevels ||
+                object.lastUsedFrame + kRestoreRecentFrames < gFrame) {
+                continue;
+            }
+            if (!wanted || object.lastUsedFrame > wanted->lastUsedFrame) {
+                wanted = &object;
+            }
+        }
+        GpuTextureLoad *load = wanted ? freeLoad() : nullptr;
+        if (!load) {
+            return false;
+        }
+        // the other way round from bytesAfterDropping(), a level at a time
+        uint64_t bytes = wanted->bytes;
+        uint32_t levels = 0;
+        while (levels < wanted->droppedLevels) {
+            int64_t added = static_cast<int64_t>(bytes * 4 - wanted->bytes);
+            if (limit && projected + added > static_cast<int64_t>(limit)) {
+                break;
+            }
+            bytes *= 4;
+            levels++;
+        }
+        if (!levels) {
+            return false;
+        }
+        queueLoad(load, wanted, wanted->droppedLevels - levels, static_cast<int64_t>(bytes - wanted->bytes));
+        return true;
+    }
+
+    void updateGpuMemory() {
+        OSVR_TRACE_SCOPE("updateGpuMemory");
+        std::unique_lock<std::mutex> lock(gMutex);
+        gFrame++;
+        uploadStagedLoad(lock);
+
+        uint64_t budget = effectiveBudget();
+        uint64_t used = usedBytes();
+        if (budget && used > budget) {
+            if (!gOverBudget) {
+                LOGE("[GpuMemory] Over budget: %llu KB tracked, %llu KB allowed.",
+                     static_cast<unsigned long long>(used / 1024), static_cast<unsigned long long>(budget / 1024));
+            }
+            gOverBudget = true;
+            gStats.overBudgetFrames++;
+        } else {
+            gOverBudget = false;
+        }
+
+        // what the loads in flight are expected to leave
+        int64_t projected = static_cast<int64_t>(used);
+        bool loading = false;
+        for (int i = 0; i < kMaxGpuTextureLoads; i++) {
+            if (gLoads[i].state != LOAD_FREE) {
+                projected += gLoads[i].expectedDelta;
+                loading = true;
+            }
+        }
+        bool queued = false;
+        if (budget && projected > static_cast<int64_t>(budget)) {
+            queued = queueEvictions(budget, &projected);
+        } else if (!loading) {
+            queued = queueRestore(budget / 10 * 9, projected);
+        }
+        if (queued) {
+            gLoaderCondition.notify_one();
+        }
+        OSVR_TRACE_COUNTER("gpuMemoryKB", static_cast<double>(used / 1024));
+    }
+
+    void getGpuMemoryStats(GpuMemoryStats *statsOut) {
+        std::lock_guard<std::mutex> lock(gMutex);
+        *statsOut = gStats;
+        statsOut->budgetBytes = effectiveBudget();
+        statsOut->usedBytes = usedBytes();
+        for (int i = 0; i < kGpuMemoryCategories; i++) {
+            statsOut->categoryBytes[i] = gCategoryBytes[i];
+            statsOut->categoryObjects[i] = gCategoryObjects[i];
+        }
+        statsOut->evictableTextures = 0;
+        statsOut->droppedLevels = 0;
+        for (int i = 0; i < kMaxTrackedGpuObjects; i++) {
+            if (gObjects[i].live && gObjects[i].evictable) {
+                statsOut->evictableTextures++;
+                statsOut->droppedLevels += gObjects[i].droppedLevels;
+            }
+        }
+        statsOut->pendingLoads = 0;
+        for (int i = 0; i < kMaxGpuTextureLoads; i++) {
+            if (gLoads[i].state != LOAD_FREE) {
+                statsOut->pendingLoads++;
+            }
+        }
+    }
+
+    void resetGpuMemoryStats() {
+        std::lock_guard<std::mutex> lock(gMutex);
+        gStats = GpuMemoryStats();
+        gStats.peakUsedBytes = usedBytes();
+    }
+}
@@ -0,0 +1,138 @@
+/*
+ * Copyright (C) 2015 Sensics, Inc. and contributors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef OSVROPENGL_GPUMEMORY_H
+#define OSVROPENGL_GPUMEMORY_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <GLES2/gl2.h>
+
+namespace OSVROpenGL {
+
+    // Keeps count of the GPU memory the renderer has asked for, and keeps it
+    // under a budget.
+    //
+    // Whatever allocates a texture, renderbuffer or buffer object's storage
+    // reports its size here (trackGpuObject()) and forgets it when it deletes
+    // it; the sizes are what was asked for, the driver's own padding and
+    // metadata aren't known. Nothing here calls GL itself.
+    //
+    // Textures that were loaded with a full mip chain from a file can also be
+    // made evictable. When the tracked total goes over the budget, the least
+    // recently drawn of those lose their top levels (each one dropped saves
+    // about three quarters of what the texture takes) until the total fits
+    // again. A texture that has lost levels gets them back once it is drawn
+    // again and restoring them would leave the total under 90% of the budget,
+    // so eviction and restoring don't chase each other. Either way the levels
+    // are read (and decoded, if they have to be) on a loader thread of the
+    // manager's own; the rendering thread only uploads them, one texture per
+    // frame at most.
+    //
+    // A GL_OUT_OF_MEMORY from the driver (noteGpuOutOfMemory()) lowers the
+    // budget to 90% of what is tracked at the time, so the next frames evict
+    // instead of failing again; setting the budget clears that.
+
+    enum GpuMemoryCategory {
+        GPU_MEMORY_TEXTURES,        // sampled: loaded, camera and layer textures
+        GPU_MEMORY_RENDER_TARGETS,  // eye buffers and their depth buffers, readback copies
+        GPU_MEMORY_BUFFERS,         // vertex, index and pixel buffer objects
+        kGpuMemoryCategories
+    };
+
+    enum GpuObjectType {
+        GPU_OBJECT_TEXTURE,
+        GPU_OBJECT_RENDERBUFFER,
+        GPU_OBJECT_BUFFER
+    };
+
+    // Beyond this many live objects the rest go untracked (logged once).
+    static const int kMaxTrackedGpuObjects = 128;
+
+    const char *gpuMemoryCategoryName(GpuMemoryCategory category);
+
+    // Forgets every object and stops the loader; for a new context (call
+    // before anything is built in it) and for shutdown.
+    void initGpuMemory();
+    void releaseGpuMemory();
+
+    // Records an object's storage, or its new size if it is tracked already
+    // (re-specifying a texture). Any thread.
+    void trackGpuObject(GpuObjectType type, GLuint name, GpuMemoryCategory category, uint64_t bytes);
+    // Call when the object is deleted. Any thread.
+    void forgetGpuObject(GpuObjectType type, GLuint name);
+
+    // Reads a texture's levels from firstLevel down (the level that becomes its
+    // new level 0) out of source and, if they can't be uploaded as they are,
+    // decodes them, into staged. On the loader thread; false if it can't.
+    typedef bool (*GpuTextureStageFunction)(const std::string &source, uint32_t firstLevel,
+                                            std::vector<uint8_t> *staged);
+    // Re-specifies the texture from what the stage function gave. Returns the
+    // bytes it now takes, or 0 if it could not (it is left as it was). On the
+    // thread that draws with it.
+    typedef uint64_t (*GpuTextureUploadFunction)(GLuint texture, uint32_t firstLevel,
+                                                 const std::vector<uint8_t> &staged);
+
+    // Lets the manager evict the tracked texture's top levels (all but its
+    // last, 1x1 one) and bring them back, re-reading them from source. A
+    // texture whose levels can't be staged or uploaded is left as it is from
+    // then on.
+    void makeGpuTextureEvictable(GLuint texture, const char *source, uint32_t levelCount,
+                                 GpuTextureStageFunction stage, GpuTextureUploadFunction upload);
+    // The texture is being drawn with this frame. Thread that draws.
+    void useGpuTexture(GLuint texture);
+
+    // 0 for none. Any thread; applies from the next updateGpuMemory().
+    void setGpuMemoryBudget(uint64_t bytes);
+    // Call when glGetError() gives GL_OUT_OF_MEMORY. Any thread.
+    void noteGpuOutOfMemory();
+
+    // Once a frame, before drawing, on the thread that draws with the
+    // evictable textures: uploads a staged load, then queues evictions for
+    // what is over the budget or restores of what has room again.
+    void updateGpuMemory();
+
+    struct GpuMemoryStats {
+        uint64_t budgetBytes;       // in effect; 0 for none
+        uint64_t usedBytes;
+        uint64_t peakUsedBytes;
+        uint64_t categoryBytes[kGpuMemoryCategories];
+        uint32_t categoryObjects[kGpuMemoryCategories];
+        uint32_t categoryEvictions[kGpuMemoryCategories];
+        uint32_t evictableTextures;
+        uint32_t droppedLevels;     // now, over every evictable texture
+        uint32_t evictions;         // uploads that dropped levels
+        uint32_t restores;          // uploads that brought levels back
+        uint64_t evictedBytes;
+        uint64_t restoredBytes;
+        uint32_t failedLoads;       // could not be staged or uploaded
+        uint32_t pendingLoads;
+        uint32_t overBudgetFrames;
+        uint32_t outOfMemoryErrors;
+        uint32_t untrackedObjects;  // past kMaxTrackedGpuObjects
+        uint64_t maxUploadNs;       // one frame's upload, on the drawing thread
+        uint64_t stageNs;           // on the loader thread
+    };
+
+    // The usage figures are as of now; the counts are since the last reset.
+    void getGpuMemoryStats(GpuMemoryStats *statsOut);
+    void resetGpuMemoryStats();
+}
+
+#endif // OSVROPENGL_GPUMEMORY_H
@@ -0,0 +1,206 @@
+/*
+ * Copyright (C) 2015 Sensics, Inc. and contributors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include <cstdint>
+#include <cstring>
+
+#include <EGL/egl.h>
+#include <GLES2/gl2.h>
+
+#include "Logging.h"
+#include "GLExtensions.h"
+#include "GpuProfiler.h"
+#include "Trace.h"
+
+// Not every NDK platform's gl2ext.h has EXT_disjoint_timer_query, so the
+// entry points and enums are declared here.
+#ifndef GL_QUERY_RESULT_EXT
+#define GL_QUERY_RESULT_EXT 0x8866
+#endif
+#ifndef GL_QUERY_RESULT_AVAILABLE_EXT
+#define GL_QUERY_RESULT_AVAILABLE_EXT 0x8867
+#endif
+#ifndef GL_TIME_ELAPSED_EXT
+#define GL_TIME_ELAPSED_EXT 0x88BF
+#endif
+#ifndef GL_GPU_DISJOINT_EXT
+#define GL_GPU_DISJOINT_EXT 0x8FBB
+#endif
+
+namespace OSVROpenGL {
+
+#if OSVROPENGL_GPU_PROFILER
+    typedef void (GL_APIENTRY *GenQueriesFn)(GLsizei n, GLuint *ids);
+    typedef void (GL_APIENTRY *DeleteQueriesFn)(GLsizei n, const GLuint *ids);
+    typedef void (GL_APIENTRY *BeginQueryFn)(GLenum target, GLuint id);
+    typedef void (GL_APIENTRY *EndQueryFn)(GLenum target);
+    typedef void (GL_APIENTRY *GetQueryObjectuivFn)(GLuint id, GLenum pname, GLuint *params);
+    typedef void (GL_APIENTRY *GetQueryObjectui64vFn)(GLuint id, GLenum pname, uint64_t *params);
+
+    static GenQueriesFn gGenQueries = nullptr;
+    static DeleteQueriesFn gDeleteQueries = nullptr;
+    static BeginQueryFn gBeginQuery = nullptr;
+    static EndQueryFn gEndQuery = nullptr;
+    static GetQueryObjectuivFn gGetQueryObjectuiv = nullptr;
+    static GetQueryObjectui64vFn gGetQueryObjectui64v = nullptr;
+
+    struct GpuProfilerFrame {
+        GLuint queries[FRAME_STAGE_GPU_COUNT];
+        bool issued[FRAME_STAGE_GPU_COUNT];
+        uint64_t submitNs[FRAME_STAGE_GPU_COUNT];   // CPU time the query began, for the trace
+        bool disjoint;      // a disjoint event was seen since its queries were issued
+    };
+
+    static bool gGpuProfilerEnabled = false;
+    static GpuProfilerFrame gGpuFrames[kGpuProfilerLatencyFrames];
+    static int gGpuFrameIndex = 0;
+    static int gGpuActiveStage = -1;
+
+    bool initGpuProfiler() {
+        // Any previous queries belonged to a context that is gone by now.
+        gGpuProfilerEnabled = false;
+        gGpuActiveStage = -1;
+        memset(gGpuFrames, 0, sizeof(gGpuFrames));
+
+        if (!hasGLExtension("GL_EXT_disjoint_timer_query")) {
+            LOGI("[GpuProfiler] GL_EXT_disjoint_timer_query not supported, GPU timing disabled.");
+            return false;
+        }
+        gGenQueries = (GenQueriesFn) eglGetProcAddress("glGenQueriesEXT");
+        gDeleteQueries = (DeleteQueriesFn) eglGetProcAddress("glDeleteQueriesEXT");
+        gBeginQuery = (BeginQueryFn) eglGetProcAddress("glBeginQueryEXT");
+        gEndQuery = (EndQueryFn) eglGetProcAddress("glEndQueryEXT");
+        gGetQueryObjectuiv = (GetQueryObjectuivFn) eglGetProcAddress("glGetQueryObjectuivEXT");
+        gGetQueryObjectui64v = (GetQueryObjectui64vFn) eglGetProcAddress("glGetQueryObjectui64vEXT");
+        if (!gGenQueries || !gDeleteQueries || !gBeginQuery || !gEndQuery ||
+            !gGetQueryObjectuiv || !gGetQueryObjectui64v) {
+            LOGE("[GpuProfiler] Missing EXT_disjoint_timer_query entry points, GPU timing disabled.");
+            return false;
+        }
+
+        for (int i = 0; i < kGpuProfilerLatencyFrames; i++) {
+            gGenQueries(FRAME_STAGE_GPU_COUNT, gGpuFrames[i].queries);
+        }
+
+        // reading GL_GPU_DISJOINT_EXT clears it, so start from a clean state
+        GLint disjoint = 0;
+        glGetIntegerv(GL_GPU_DISJOINT_EXT, &disjoint);
+
+        gGpuFrameIndex = 0;
+        gGpuProfilerEnabled = true;
+        LOGI("[GpuProfiler] GPU timing enabled, %d frames of latency.", kGpuProfilerLatencyFrames);
+        return true;
+    }
+
+    void shutdownGpuProfiler() {
+        if (!gGpuProfilerEnabled) {
+            return;
+        }
+        for (int i = 0; i < kGpuProfilerLatencyFrames; i++) {
+            gDeleteQueries(FRAME_STAGE_GPU_COUNT, gGpuFrames[i].queries);
+        }
+        memset(gGpuFrames, 0, sizeof(gGpuFrames));
+        gGpuProfilerEnabled = false;
+    }
+
+    bool isGpuProfilerEnabled() {
+        return gGpuProfilerEnabled;
+    }
+
+    void gpuProfilerBeginFrame() {
+        if (!gGpuProfilerEnabled) {
+            return;
+        }
+        gGpuFrameIndex = (gGpuFrameIndex + 1) % kGpuProfilerLatencyFrames;
+        GpuProfilerFrame &frame = gGpuFrames[gGpuFrameIndex];
+
+        // Results from a frame that overlapped a disjoint event (frequency change,
+        // power state, ...) are meaningless. Reading the flag clears it, so it
+        // goes on every frame still in flight, not just the one read back now.
+        GLint disjointEvent = 0;
+        glGetIntegerv(GL_GPU_DISJOINT_EXT, &disjointEvent);
+        if (disjointEvent) {
+            for (int i = 0; i < kGpuProfilerLatencyFrames; i++) {
+                gGpuFrames[i].disjoint = true;
+            }
+        }
+        bool disjoint = frame.disjoint;
+        frame.disjoint = false;
+
+        for (int i = 0; i < FRAME_STAGE_GPU_COUNT; i++) {
+            if (!frame.issued[i]) {
+                continue;
+            }
+            frame.issued[i] = false;
+
+            GLuint available = 0;
+            gGetQueryObjectuiv(frame.queries[i], GL_QUERY_RESULT_AVAILABLE_EXT, &available);
+            if (!available || disjoint) {
+                continue;
+            }
+            uint64_t elapsedNs = 0;
+            gGetQueryObjectui64v(frame.queries[i], GL_QUERY_RESULT_EXT, &elapsedNs);
+            FrameStage stage = static_cast<FrameStage>(FRAME_STAGE_GPU_FIRST + i);
+            recordFrameStage(stage, elapsedNs);
+#if OSVROPENGL_TRACING
+            if (isTracingEnabled()) {
+                traceCompleteOnTrack(kTraceGpuTrack, frameStageName(stage), frame.submitNs[i], elapsedNs);
+            }
+#endif
+        }
+    }
+
+    void gpuProfilerEndFrame() {
+        gpuProfilerEndStage();
+    }
+
+    void gpuProfilerBeginStage(FrameStage stage) {
+        if (!gGpuProfilerEnabled || gGpuActiveStage >= 0) {
+            return;
+        }
+        int slot = stage - FRAME_STAGE_GPU_FIRST;
+        if (slot < 0 || slot >= FRAME_STAGE_GPU_COUNT) {
+            return;
+        }
+        GpuProfilerFrame &frame = gGpuFrames[gGpuFrameIndex];
+        if (frame.issued[slot]) {
+            // already timed this stage this frame
+            return;
+        }
+        gBeginQuery(GL_TIME_ELAPSED_EXT, frame.queries[slot]);
+        frame.submitNs[slot] = frameStatsNowNs();
+        gGpuActiveStage = slot;
+    }
+
+    void gpuProfilerEndStage() {
+        if (!gGpuProfilerEnabled || gGpuActiveStage < 0) {
+            return;
+        }
+        gEndQuery(GL_TIME_ELAPSED_EXT);
+        gGpuFrames[gGpuFrameIndex].issued[gGpuActiveStage] = true;
+        gGpuActiveStage = -1;
+    }
+#else
+    bool initGpuProfiler() { return false; }
+    void shutdownGpuProfiler() {}
+    bool isGpuProfilerEnabled() { return false; }
+    void gpuProfilerBeginFrame() {}
+    void gpuProfilerEndFrame() {}
+    void gpuProfilerBeginStage(FrameStage stage) {}
+    void gpuProfilerEndStage() {}
+#endif
+}
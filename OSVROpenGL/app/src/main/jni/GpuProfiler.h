@@ -0,0 +1,73 @@
+/*
+ * Copyright (C) 2015 Sensics, Inc. and contributors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef OSVROPENGL_GPUPROFILER_H
+#define OSVROPENGL_GPUPROFILER_H
+
+#include "FrameStats.h"
+
+// GPU timers are only useful with the frame stats they report into.
+#ifndef OSVROPENGL_GPU_PROFILER
+#define OSVROPENGL_GPU_PROFILER OSVROPENGL_FRAME_STATS
+#endif
+
+namespace OSVROpenGL {
+
+    // GPU pass timing with EXT_disjoint_timer_query. Each frame gets its own set of
+    // GL_TIME_ELAPSED_EXT queries from a small ring; results are read back
+    // kGpuProfilerLatencyFrames later, when they are normally long since available,
+    // so the CPU never waits on the GPU. Results that still aren't ready, or that
+    // were taken while the GPU reported a disjoint event, are dropped. Samples are
+    // recorded into the FRAME_STAGE_GPU_* frame stats.
+    //
+    // Without the extension (or with OSVROPENGL_GPU_PROFILER=0) everything is a no-op.
+    // All calls must be made on the GL thread.
+    static const int kGpuProfilerLatencyFrames = 4;
+
+    // Looks up the extension and creates the query ring. Call with a current context.
+    bool initGpuProfiler();
+    void shutdownGpuProfiler();
+    bool isGpuProfilerEnabled();
+
+    // Collects the oldest frame's results and claims its queries for this frame.
+    void gpuProfilerBeginFrame();
+    void gpuProfilerEndFrame();
+
+    // Timer queries can't nest, so only one stage can be open at a time.
+    void gpuProfilerBeginStage(FrameStage stage);
+    void gpuProfilerEndStage();
+
+    class ScopedGpuStageTimer {
+    public:
+        explicit ScopedGpuStageTimer(FrameStage stage) {
+            gpuProfilerBeginStage(stage);
+        }
+
+        ~ScopedGpuStageTimer() {
+            gpuProfilerEndStage();
+        }
+    };
+}
+
+#if OSVROPENGL_GPU_PROFILER
+#define OSVR_GPU_STAGE_TIMER(stage) \
+    ::OSVROpenGL::ScopedGpuStageTimer OSVR_FRAME_STATS_CONCAT(gpuStageTimer, __LINE__)(stage)
+#else
+#define OSVR_GPU_STAGE_TIMER(stage) ((void)0)
+#endif
+
+#endif // OSVROPENGL_GPUPROFILER_H
@@ -0,0 +1,140 @@
+/*
+ * Copyright (C) 2015 Sensics, Inc. and contributors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef OSVROPENGL_INPUTEVENTQUEUE_H
+#define OSVROPENGL_INPUTEVENTQUEUE_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+namespace OSVROpenGL {
+
+    // Event types, mirrored in InputEventBuffer.java
+    enum InputEventType {
+        INPUT_EVENT_BUTTON = 1,
+        INPUT_EVENT_LOCATION2D = 2
+    };
+
+    // Which interface the report came from, mirrored in InputEventBuffer.java.
+    // Passed as the callback userdata so a single callback serves every button.
+    enum InputEventSource {
+        INPUT_SOURCE_CENTER = 0,
+        INPUT_SOURCE_DOWN = 1,
+        INPUT_SOURCE_RIGHT = 2,
+        INPUT_SOURCE_LEFT = 3,
+        INPUT_SOURCE_UP = 4,
+        INPUT_SOURCE_VOLUME_UP = 5,
+        INPUT_SOURCE_VOLUME_DOWN = 6,
+        INPUT_SOURCE_BACK = 7,
+        INPUT_SOURCE_MOUSE = 8
+    };
+
+    // Fixed 40 byte record, written in native byte order. This is the wire format
+    // of the ByteBuffer handed to Java, so any change here must be made in
+    // InputEventBuffer.java as well.
+    struct PackedInputEvent {
+        uint16_t type;          // offset 0, InputEventType
+        uint16_t source;        // offset 2, InputEventSource
+        uint32_t sensor;        // offset 4
+        int64_t seconds;        // offset 8, OSVR_TimeValue::seconds
+        int32_t microseconds;   // offset 16, OSVR_TimeValue::microseconds
+        int32_t buttonState;    // offset 20, OSVR_ButtonState (buttons only)
+        double x;               // offset 24, location (location2D only)
+        double y;               // offset 32, location (location2D only)
+    };
+
+    static_assert(sizeof(PackedInputEvent) == 40, "PackedInputEvent layout changed");
+    static_assert(offsetof(PackedInputEvent, seconds) == 8, "PackedInputEvent layout changed");
+    static_assert(offsetof(PackedInputEvent, microseconds) == 16, "PackedInputEvent layout changed");
+    static_assert(offsetof(PackedInputEvent, buttonState) == 20, "PackedInputEvent layout changed");
+    static_assert(offsetof(PackedInputEvent, x) == 24, "PackedInputEvent layout changed");
+    static_assert(offsetof(PackedInputEvent, y) == 32, "PackedInputEvent layout changed");
+
+    // Fixed-size single producer/single consumer ring of input events.
+    // The OSVR callbacks push (from inside osvrClientUpdate) and the frame loop
+    // drains everything at once into caller-provided memory. Nothing allocates
+    // after construction; when the ring is full, new events are dropped and counted.
+    template<size_t Capacity>
+    class InputEventRing {
+        static_assert(Capacity > 0 && (Capacity & (Capacity - 1)) == 0,
+                      "InputEventRing capacity must be a power of two");
+
+        PackedInputEvent mEvents[Capacity];
+        std::atomic<uint32_t> mHead;    // next slot to write, owned by the producer
+        std::atomic<uint32_t> mTail;    // next slot to read, owned by the consumer
+        std::atomic<uint32_t> mDropped;
+
+    public:
+        InputEventRing() : mHead(0), mTail(0), mDropped(0) {
+        }
+
+        static size_t capacity() { return Capacity; }
+
+        size_t size() const {
+            return mHead.load(std::memory_order_acquire) - mTail.load(std::memory_order_acquire);
+        }
+
+        uint32_t droppedCount() const {
+            return mDropped.load(std::memory_order_relaxed);
+        }
+
+        bool push(const PackedInputEvent &event) {
+            uint32_t head = mHead.load(std::memory_order_relaxed);
+            uint32_t tail = mTail.load(std::memory_order_acquire);
+            if (head - tail >= Capacity) {
+                mDropped.fetch_add(1, std::memory_order_relaxed);
+                return false;
+            }
+            mEvents[head & (Capacity - 1)] = event;
+            mHead.store(head + 1, std::memory_order_release);
+            return true;
+        }
+
+        // Copies as many queued events as fit into dst (oldest first) and
+        // removes them from the ring. Returns the number of events written.
+        size_t drainTo(void *dst, size_t dstBytes) {
+            uint32_t tail = mTail.load(std::memory_order_relaxed);
+            uint32_t head = mHead.load(std::memory_order_acquire);
+            size_t count = head - tail;
+            size_t maxCount = dstBytes / sizeof(PackedInputEvent);
+            if (count > maxCount) {
+                count = maxCount;
+            }
+
+            unsigned char *out = static_cast<unsigned char *>(dst);
+            size_t first = tail & (Capacity - 1);
+            size_t firstRun = Capacity - first;
+            if (firstRun > count) {
+                firstRun = count;
+            }
+            memcpy(out, &mEvents[first], firstRun * sizeof(PackedInputEvent));
+            memcpy(out + firstRun * sizeof(PackedInputEvent), &mEvents[0],
+                   (count - firstRun) * sizeof(PackedInputEvent));
+
+            mTail.store(tail + static_cast<uint32_t>(count), std::memory_order_release);
+            return count;
+        }
+
+        void clear() {
+            mTail.store(mHead.load(std::memory_order_acquire), std::memory_order_release);
+        }
+    };
+}
+
+#endif // OSVROPENGL_INPUTEVENTQUEUE_H
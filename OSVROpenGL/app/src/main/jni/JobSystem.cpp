@@ -0,0 +1,377 @@
+/*
+ * Copyright (C) 2015 Sensics, Inc. and contributors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+#include "Logging.h"
+#include "JobSystem.h"
+#include "Trace.h"
+
+namespace OSVROpenGL {
+
+    // Jobs each worker can have outstanding before its ring comes back around.
+    static const uint32_t kJobPoolSize = 1024;
+    // Deque capacity; a job that doesn't fit runs inline instead.
+    static const int64_t kJobDequeCapacity = 1024;
+    // Empty polls of the other deques before an idle worker goes to sleep.
+    static const int kIdleSpins = 64;
+    // Default cap on the worker threads: the rest of a phone's cores are better
+    // left to the compositor, the sensors and the OSVR server.
+    static const int kDefaultMaxWorkerThreads = 7;
+
+    // Chase-Lev work-stealing deque ("Correct and Efficient Work-Stealing for
+    // Weak Memory Models", Le et al. 2013). The owner pushes and pops at the
+    // bottom, thieves take from the top. Where the paper puts seq_cst fences
+    // between the top and bottom accesses, the accesses themselves are seq_cst
+    // here, and the slots are published with release/acquire: the same
+    // ordering, but in a form thread sanitizer can follow.
+    class JobDeque {
+        std::atomic<int64_t> mTop;
+        char mPadding[64 - sizeof(std::atomic<int64_t>)];
+        std::atomic<int64_t> mBottom;
+        std::atomic<Job *> mSlots[kJobDequeCapacity];
+
+    public:
+        void reset() {
+            mTop.store(0, std::memory_order_relaxed);
+            mBottom.store(0, std::memory_order_relaxed);
+        }
+
+        // Owner only.
+        bool push(Job *job) {
+            int64_t bottom = mBottom.load(std::memory_order_relaxed);
+            int64_t top = mTop.load(std::memory_order_acquire);
+            if (bottom - top >= kJobDequeCapacity) {
+                return false;
+            }
+            mSlots[bottom & (kJobDequeCapacity - 1)].store(job, std::memory_order_release);
+            mBottom.store(bottom + 1, std::memory_order_release);
+            return true;
+        }
+
+        // Owner only.
+        Job *pop() {
+            int64_t bottom = mBottom.load(std::memory_order_relaxed) - 1;
+            mBottom.store(bottom, std::memory_order_seq_cst);
+            int64_t top = mTop.load(std::memory_order_seq_cst);
+            if (top > bottom) {
+                mBottom.store(bottom + 1, std::memory_order_relaxed);
+                return nullptr;
+            }
+            Job *job = mSlots[bottom & (kJobDequeCapacity - 1)].load(std::memory_order_acquire);
+            if (top == bottom) {
+                // last one: race the thieves for it
+                if (!mTop.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst,
+                                                  std::memory_order_relaxed)) {
+                    job = nullptr;
+                }
+                mBottom.store(bottom + 1, std::memory_order_relaxed);
+            }
+            return job;
+        }
+
+        // Any thread.
+        Job *steal() {
+            int64_t top = mTop.load(std::memory_order_seq_cst);
+            int64_t bottom = mBottom.load(std::memory_order_seq_cst);
+            if (top >= bottom) {
+                return nullptr;
+            }
+            Job *job = mSlots[top & (kJobDequeCapacity - 1)].load(std::memory_order_acquire);
+            if (!mTop.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst,
+                                              std::memory_order_relaxed)) {
+                return nullptr;
+            }
+            return job;
+        }
+    };
+
+    struct alignas(64) JobWorker {
+        JobDeque deque;
+        Job pool[kJobPoolSize];
+        uint32_t nextPoolIndex;
+        uint32_t nextVictim;
+        bool reportedWrap;
+        std::atomic<uint64_t> jobsRun;
+        std::atomic<uint64_t> jobsStolen;
+        std::thread thread;
+    };
+
+    static JobWorker gWorkers[kMaxJobWorkers];
+    static int gWorkerCount = 0;
+    static std::atomic<bool> gRunning(false);
+    static thread_local int gWorkerIndex = -1;
+
+    // Jobs sitting in any deque, so idle workers know when to wake up.
+    static std::atomic<int> gQueuedJobs(0);
+    static std::atomic<int> gSleepingWorkers(0);
+    static std::mutex gWakeMutex;
+    static std::condition_variable gWakeCondition;
+
+    // worker 0 is the starting thread, which names itself
+    static const char *const kWorkerThreadNames[kMaxJobWorkers] = {
+            nullptr, "JobWorker1", "JobWorker2", "JobWorker3",
+            "JobWorker4", "JobWorker5", "JobWorker6", "JobWorker7",
+            "JobWorker8", "JobWorker9", "JobWorker10", "JobWorker11",
+            "JobWorker12", "JobWorker13", "JobWorker14", "JobWorker15"
+    };
+
+    static Job *takeJob(int workerIndex) {
+        JobWorker &self = gWorkers[workerIndex];
+        Job *job = self.deque.pop();
+        if (job) {
+            gQueuedJobs.fetch_sub(1);
+            return job;
+        }
+        for (int i = 1; i < gWorkerCount; i++) {
+            int victim = static_cast<int>((self.nextVictim + i) % gWorkerCount);
+            if (victim == workerIndex) {
+                continue;
+            }
+            job = gWorkers[victim].deque.steal();
+            if (job) {
+                self.nextVictim = static_cast<uint32_t>(victim);
+                self.jobsStolen.fetch_add(1, std::memory_order_relaxed);
+                gQueuedJobs.fetch_sub(1);
+                return job;
+            }
+        }
+        return nullptr;
+    }
+
+    static void finishJob(Job *job) {
+        // the job may be recycled as soon as its count reaches zero
+        Job *parent = job->parent;
+        if (job->unfinished.fetch_sub(1, std::memory_order_acq_rel) == 1 && parent) {
+            finishJob(parent);
+        }
+    }
+
+    static void executeJob(int workerIndex, Job *job) {
+        job->function(job, job->data);
+        gWorkers[workerIndex].jobsRun.fetch_add(1, std::memory_order_relaxed);
+        finishJob(job);
+    }
+
+    static void workerMain(int workerIndex) {
+        gWorkerIndex = workerIndex;
+        traceSetThreadName(kWorkerThreadNames[workerIndex]);
+        int idleSpins = 0;
+        while (gRunning.load(std::memory_order_acquire)) {
+            Job *job = takeJob(workerIndex);
+            if (job) {
+                executeJob(workerIndex, job);
+                idleSpins = 0;
+                continue;
+            }
+            if (++idleSpins < kIdleSpins) {
+                std::this_thread::yield();
+                continue;
+            }
+            idleSpins = 0;
+            std::unique_lock<std::mutex> lock(gWakeMutex);
+            gSleepingWorkers.fetch_add(1);
+            gWakeCondition.wait(lock, [] {
+                return gQueuedJobs.load() > 0 || !gRunning.load();
+            });
+            gSleepingWorkers.fetch_sub(1);
+        }
+        gWorkerIndex = -1;
+    }
+
+    bool startJobSystem(int workerThreads) {
+        if (gRunning.load()) {
+            LOGE("[JobSystem] Already running");
+            return false;
+        }
+        if (workerThreads < 0) {
+            int cores = static_cast<int>(std::thread::hardware_concurrency());
+            workerThreads = cores > 1 ? cores - 1 : 0;
+            if (workerThreads > kDefaultMaxWorkerThreads) {
+                workerThreads = kDefaultMaxWorkerThreads;
+            }
+        }
+        if (workerThreads > kMaxJobWorkers - 1) {
+            workerThreads = kMaxJobWorkers - 1;
+        }
+
+        gWorkerCount = workerThreads + 1;
+        gQueuedJobs.store(0);
+        for (int i = 0; i < gWorkerCount; i++) {
+            JobWorker &worker = gWorkers[i];
+            worker.deque.reset();
+            worker.nextPoolIndex = 0;
+            worker.nextVictim = static_cast<uint32_t>(i);
+            worker.reportedWrap = false;
+            worker.jobsRun.store(0);
+            worker.jobsStolen.store(0);
+        }
+        gWorkerIndex = 0;
+        gRunning.store(true, std::memory_order_release);
+        for (int i = 1; i < gWorkerCount; i++) {
+            gWorkers[i].thread = std::thread(workerMain, i);
+        }
+        LOGI("[JobSystem] Started with %d worker threads", workerThreads);
+        return true;
+    }
+
+    void stopJobSystem() {
+        if (!gRunning.load()) {
+            return;
+        }
+        {
+            std::lock_guard<std::mutex> lock(gWakeMutex);
+            gRunning.store(false, std::memory_order_release);
+        }
+        gWakeCondition.notify_all();
+        for (int i = 1; i < gWorkerCount; i++) {
+            if (gWorkers[i].thread.joinable()) {
+                gWorkers[i].thread.join();
+            }
+        }
+        gWorkerCount = 0;
+        gWorkerIndex = -1;
+    }
+
+    bool isJobSystemRunning() {
+        return gRunning.load(std::memory_order_acquire);
+    }
+
+    int jobWorkerCount() {
+        return isJobSystemRunning() ? gWorkerCount : 1;
+    }
+
+    int currentJobWorker() {
+        return isJobSystemRunning() ? gWorkerIndex : -1;
+    }
+
+    static Job *allocateJob(JobFunction function, Job *parent, const void *data, size_t dataBytes) {
+        int workerIndex = currentJobWorker();
+        if (workerIndex < 0) {
+            LOGE("[JobSystem] Jobs can only be created on a worker thread");
+            return nullptr;
+        }
+        if (dataBytes > kJobDataBytes) {
+            LOGE("[JobSystem] %u bytes of job data is too much", static_cast<unsigned>(dataBytes));
+            return nullptr;
+        }
+        JobWorker &worker = gWorkers[workerIndex];
+        Job *job = &worker.pool[worker.nextPoolIndex++ & (kJobPoolSize - 1)];
+        if (job->unfinished.load(std::memory_order_relaxed) != 0 && !worker.reportedWrap) {
+            LOGE("[JobSystem] Worker %d's job pool wrapped around onto an unfinished job", workerIndex);
+            worker.reportedWrap = true;
+        }
+        job->function = function;
+        job->parent = parent;
+        job->unfinished.store(1, std::memory_order_relaxed);
+        if (dataBytes) {
+            memcpy(job->data, data, dataBytes);
+        }
+        if (parent) {
+            parent->unfinished.fetch_add(1, std::memory_order_relaxed);
+        }
+        return job;
+    }
+
+    Job *createJob(JobFunction function, const void *data, size_t dataBytes) {
+        return allocateJob(function, nullptr, data, dataBytes);
+    }
+
+    Job *createChildJob(Job *parent, JobFunction function, const void *data, size_t dataBytes) {
+        return allocateJob(function, parent, data, dataBytes);
+    }
+
+    void runJob(Job *job) {
+        if (!job) {
+            return;
+        }
+        int workerIndex = gWorkerIndex;
+        if (!gWorkers[workerIndex].deque.push(job)) {
+            executeJob(workerIndex, job);
+            return;
+        }
+        gQueuedJobs.fetch_add(1);
+        if (gSleepingWorkers.load() > 0) {
+            std::lock_guard<std::mutex> lock(gWakeMutex);
+            gWakeCondition.notify_one();
+        }
+    }
+
+    void waitForJob(Job *job) {
+        if (!job) {
+            return;
+        }
+        int workerIndex = gWorkerIndex;
+        while (job->unfinished.load(std::memory_order_acquire) != 0) {
+            Job *other = takeJob(workerIndex);
+            if (other) {
+                executeJob(workerIndex, other);
+            } else {
+                std::this_thread::yield();
+            }
+        }
+    }
+
+    struct ParallelForRange {
+        ParallelForFunction function;
+        void *userdata;
+        uint32_t begin;
+        uint32_t end;
+        uint32_t grainSize;
+    };
+
+    // Hands the upper half of the range to the other workers until what's left
+    // fits in one grain, then runs that.
+    static void parallelForJob(Job *job, const void *data) {
+        ParallelForRange range = jobData<ParallelForRange>(data);
+        while (range.end - range.begin > range.grainSize) {
+            uint32_t middle = range.begin + (range.end - range.begin) / 2;
+            ParallelForRange upper = range;
+            upper.begin = middle;
+            runJob(createChildJob(job, parallelForJob, upper));
+            range.end = middle;
+        }
+        range.function(range.begin, range.end, range.userdata);
+    }
+
+    Job *parallelFor(uint32_t count, uint32_t grainSize, ParallelForFunction function, void *userdata) {
+        if (grainSize < 1) {
+            grainSize = 1;
+        }
+        if (count <= grainSize || currentJobWorker() < 0) {
+            if (count) {
+                function(0, count, userdata);
+            }
+            return nullptr;
+        }
+        ParallelForRange range = {function, userdata, 0, count, grainSize};
+        Job *root = createJob(parallelForJob, range);
+        runJob(root);
+        return root;
+    }
+
+    void getJobSystemStats(JobSystemStats *statsOut) {
+        statsOut->jobsRun = 0;
+        statsOut->jobsStolen = 0;
+        for (int i = 0; i < gWorkerCount; i++) {
+            statsOut->jobsRun += gWorkers[i].jobsRun.load(std::memory_order_relaxed);
+            statsOut->jobsStolen += gWorkers[i].jobsStolen.load(std::memory_order_relaxed);
+        }
+    }
+}
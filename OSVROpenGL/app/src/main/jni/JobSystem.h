@@ -0,0 +1,109 @@
+/*
+ * Copyright (C) 2015 Sensics, Inc. and contributors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef OSVROPENGL_JOBSYSTEM_H
+#define OSVROPENGL_JOBSYSTEM_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+namespace OSVROpenGL {
+
+    // A small work-stealing job system for the per-frame CPU work.
+    //
+    // The thread that calls startJobSystem() becomes worker 0 and is joined by a
+    // fixed set of worker threads. Each worker owns a lock-free Chase-Lev deque:
+    // it pushes and pops its own jobs at the bottom, idle workers steal from the
+    // top of the others'. Jobs come from a per-worker ring, so nothing allocates
+    // once the workers are running; the ring is large enough for every job of a
+    // frame, and every job must be waited for (directly or through its parent)
+    // before the ring comes back around to it.
+    //
+    // A job counts itself and its unfinished children; it is finished once its
+    // function has returned and all of its children have finished. Waiting
+    // never blocks: the waiting thread runs other jobs in the meantime.
+    //
+    // Only worker threads (including the starting thread) may create, run or
+    // wait for jobs; parallelFor() called from any other thread (or with the
+    // system stopped) just runs the whole range inline.
+    static const int kMaxJobWorkers = 16;       // including the starting thread
+    static const size_t kJobDataBytes = 40;
+
+    struct Job;
+    typedef void (*JobFunction)(Job *job, const void *data);
+
+    struct alignas(64) Job {
+        JobFunction function;
+        Job *parent;
+        std::atomic<int32_t> unfinished;
+        unsigned char data[kJobDataBytes];
+    };
+
+    static_assert(sizeof(Job) == 64, "Job should be one cache line");
+
+    // workerThreads extra threads besides the caller (clamped to
+    // kMaxJobWorkers - 1); negative picks one per remaining core.
+    bool startJobSystem(int workerThreads);
+    void stopJobSystem();
+    bool isJobSystemRunning();
+    // Workers including the starting thread; 1 when the system isn't running.
+    int jobWorkerCount();
+    // The calling thread's worker index (0 for the starting thread), or -1.
+    int currentJobWorker();
+
+    // data is copied into the job (up to kJobDataBytes).
+    Job *createJob(JobFunction function, const void *data, size_t dataBytes);
+    Job *createChildJob(Job *parent, JobFunction function, const void *data, size_t dataBytes);
+    void runJob(Job *job);
+    void waitForJob(Job *job);
+
+    template<typename T>
+    Job *createJob(JobFunction function, const T &data) {
+        static_assert(sizeof(T) <= kJobDataBytes, "job data too large");
+        return createJob(function, &data, sizeof(T));
+    }
+
+    template<typename T>
+    Job *createChildJob(Job *parent, JobFunction function, const T &data) {
+        static_assert(sizeof(T) <= kJobDataBytes, "job data too large");
+        return createChildJob(parent, function, &data, sizeof(T));
+    }
+
+    template<typename T>
+    const T &jobData(const void *data) {
+        return *static_cast<const T *>(data);
+    }
+
+    // Calls function(begin, end, userdata) over [0, count) in ranges of at most
+    // grainSize, split recursively across the workers. Runs inline when the
+    // whole range fits in one grain. Returns the root job, already running;
+    // wait for it before using the results.
+    typedef void (*ParallelForFunction)(uint32_t begin, uint32_t end, void *userdata);
+    Job *parallelFor(uint32_t count, uint32_t grainSize, ParallelForFunction function, void *userdata);
+
+    struct JobSystemStats {
+        uint64_t jobsRun;
+        uint64_t jobsStolen;
+    };
+
+    // Totals since the system started.
+    void getJobSystemStats(JobSystemStats *statsOut);
+}
+
+#endif // OSVROPENGL_JOBSYSTEM_H
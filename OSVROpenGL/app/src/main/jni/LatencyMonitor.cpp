@@ -0,0 +1,246 @@
+/*
+ * Copyright (C) 2015 Sensics, Inc. and contributors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include <atomic>
+#include <cmath>
+#include <cstring>
+
+#include <osvr/Util/TimeValueC.h>
+
+#include "Logging.h"
+#include "EGLFence.h"
+#include "LatencyMonitor.h"
+#include "FrameStats.h"
+#include "Trace.h"
+
+namespace OSVROpenGL {
+
+    // Head rotation faster than this lights the test pattern (rad/s).
+    static const double kFlashAngularSpeed = 0.35;
+
+    struct LatencyFrame {
+        bool active;
+        uint64_t poseAgeNs;     // age of the pose when it was consumed
+        uint64_t consumedNs;
+        uint64_t submittedNs;
+        uint64_t gpuDoneNs;
+        uint64_t presentedNs;
+        EGLFence fence;
+        int framesPending;
+    };
+
+    static std::atomic<bool> gLatencyRequested(false);
+    static std::atomic<bool> gLatencyTestPattern(false);
+    static bool gLatencyActive = false;
+
+    static LatencyFrame gLatencyFrames[kLatencyPendingFrames];
+    static int gLatencyFrameIndex = 0;
+
+    static OSVR_PoseState gLastPose;
+    static OSVR_TimeValue gLastPoseTime;
+    static bool gHasLastPose = false;
+    // also read by the app thread when async reprojection is on
+    static std::atomic<bool> gFlashActive(false);
+
+    static void releaseFence(LatencyFrame &frame) {
+        if (frame.fence) {
+            destroyEGLFence(frame.fence);
+            frame.fence = nullptr;
+        }
+    }
+
+    static void pollFence(LatencyFrame &frame, uint64_t nowNs) {
+        if (frame.fence && isEGLFenceSignaled(frame.fence)) {
+            frame.gpuDoneNs = nowNs;
+            releaseFence(frame);
+        }
+    }
+
+    static void finishFrame(LatencyFrame &frame) {
+        releaseFence(frame);
+        frame.active = false;
+        if (!frame.submittedNs) {
+            return;
+        }
+        recordFrameStage(FRAME_STAGE_LATENCY_SUBMIT, frame.poseAgeNs + (frame.submittedNs - frame.consumedNs));
+        if (frame.gpuDoneNs) {
+            recordFrameStage(FRAME_STAGE_LATENCY_GPU_DONE, frame.poseAgeNs + (frame.gpuDoneNs - frame.consumedNs));
+        }
+        if (frame.presentedNs) {
+            uint64_t photonNs = frame.gpuDoneNs > frame.presentedNs ? frame.gpuDoneNs : frame.presentedNs;
+            uint64_t motionToPhotonNs = frame.poseAgeNs + (photonNs - frame.consumedNs);
+            recordFrameStage(FRAME_STAGE_MOTION_TO_PHOTON, motionToPhotonNs);
+            OSVR_TRACE_COUNTER("motionToPhotonMs", motionToPhotonNs / 1.0e6);
+        }
+    }
+
+    static bool isFrameComplete(const LatencyFrame &frame) {
+        return !frame.fence && frame.presentedNs;
+    }
+
+    static void resetFrames() {
+        for (int i = 0; i < kLatencyPendingFrames; i++) {
+            releaseFence(gLatencyFrames[i]);
+        }
+        memset(gLatencyFrames, 0, sizeof(gLatencyFrames));
+        gHasLastPose = false;
+        gFlashActive = false;
+    }
+
+    static uint64_t timeValueToNs(const OSVR_TimeValue &time) {
+        return static_cast<uint64_t>(time.seconds) * 1000000000ull +
+               static_cast<uint64_t>(time.microseconds) * 1000ull;
+    }
+
+    static double rotationBetween(const OSVR_Quaternion &a, const OSVR_Quaternion &b) {
+        double dot = fabs(a.data[0] * b.data[0] + a.data[1] * b.data[1] +
+                          a.data[2] * b.data[2] + a.data[3] * b.data[3]);
+        return 2.0 * acos(dot < 1.0 ? dot : 1.0);
+    }
+
+    void setLatencyMeasurementEnabled(bool enabled) {
+        gLatencyRequested.store(enabled);
+    }
+
+    bool isLatencyMeasurementEnabled() {
+        return gLatencyRequested.load(std::memory_order_relaxed);
+    }
+
+    void setLatencyTestPatternEnabled(bool enabled) {
+        gLatencyTestPattern.store(enabled);
+    }
+
+    bool isLatencyTestPatternEnabled() {
+        return gLatencyTestPattern.load(std::memory_order_relaxed);
+    }
+
+    void latencyBeginFrame() {
+        bool requested = isLatencyMeasurementEnabled();
+        if (requested != gLatencyActive) {
+            resetFrames();
+            gLatencyActive = requested;
+            LOGI("[Latency] Latency measurement %s%s.", requested ? "enabled" : "disabled",
+                 requested && !haveEGLFences() ? ", no GPU completion times without fences" : "");
+        }
+        if (!gLatencyActive) {
+            return;
+        }
+
+        uint64_t nowNs = frameStatsNowNs();
+        LatencyFrame &previous = gLatencyFrames[gLatencyFrameIndex];
+        if (previous.active && !previous.presentedNs) {
+            // nobody reported the swap, so it happened between the two frames
+            previous.presentedNs = nowNs;
+        }
+        for (int i = 0; i < kLatencyPendingFrames; i++) {
+            LatencyFrame &frame = gLatencyFrames[i];
+            if (!frame.active) {
+                continue;
+            }
+            pollFence(frame, nowNs);
+            frame.framesPending++;
+            if (isFrameComplete(frame) || frame.framesPending >= kLatencyPendingFrames) {
+                finishFrame(frame);
+            }
+        }
+
+        gLatencyFrameIndex = (gLatencyFrameIndex + 1) % kLatencyPendingFrames;
+        LatencyFrame &frame = gLatencyFrames[gLatencyFrameIndex];
+        if (frame.active) {
+            finishFrame(frame);
+        }
+        memset(&frame, 0, sizeof(frame));
+        frame.active = true;
+    }
+
+    void latencyPoseConsumed(const OSVR_TimeValue *timestamp, const OSVR_PoseState *pose) {
+        if (!gLatencyActive) {
+            return;
+        }
+        LatencyFrame &frame = gLatencyFrames[gLatencyFrameIndex];
+        frame.consumedNs = frameStatsNowNs();
+        frame.poseAgeNs = 0;
+        if (timestamp) {
+            OSVR_TimeValue now;
+            osvrTimeValueGetNow(&now);
+            uint64_t nowNs = timeValueToNs(now);
+            uint64_t poseNs = timeValueToNs(*timestamp);
+            frame.poseAgeNs = nowNs > poseNs ? nowNs - poseNs : 0;
+        }
+
+        if (!pose) {
+            gHasLastPose = false;
+            gFlashActive = false;
+            return;
+        }
+        OSVR_TimeValue poseTime = {0};
+        if (timestamp) {
+            poseTime = *timestamp;
+        } else {
+            poseTime.seconds = static_cast<OSVR_TimeValue_Seconds>(frame.consumedNs / 1000000000ull);
+            poseTime.microseconds = static_cast<OSVR_TimeValue_Microseconds>((frame.consumedNs % 1000000000ull) / 1000ull);
+        }
+        if (gHasLastPose) {
+            uint64_t lastNs = timeValueToNs(gLastPoseTime);
+            uint64_t poseNs = timeValueToNs(poseTime);
+            // the same report twice says nothing about the speed, keep the last answer
+            if (poseNs > lastNs) {
+                double speed = rotationBetween(gLastPose.rotation, pose->rotation) / ((poseNs - lastNs) / 1.0e9);
+                gFlashActive = speed > kFlashAngularSpeed;
+            }
+        }
+        gLastPose = *pose;
+        gLastPoseTime = poseTime;
+        gHasLastPose = true;
+    }
+
+    void latencySubmitted() {
+        if (!gLatencyActive) {
+            return;
+        }
+        LatencyFrame &frame = gLatencyFrames[gLatencyFrameIndex];
+        if (!frame.consumedNs) {
+            return;
+        }
+        frame.submittedNs = frameStatsNowNs();
+        frame.fence = createEGLFence();
+    }
+
+    void latencyFramePresented() {
+        if (!gLatencyActive) {
+            return;
+        }
+        uint64_t nowNs = frameStatsNowNs();
+        LatencyFrame &frame = gLatencyFrames[gLatencyFrameIndex];
+        if (frame.active && frame.submittedNs && !frame.presentedNs) {
+            frame.presentedNs = nowNs;
+            pollFence(frame, nowNs);
+        }
+    }
+
+    void resetLatencyMonitor() {
+        // Any pending fences belonged to a context that is gone by now.
+        memset(gLatencyFrames, 0, sizeof(gLatencyFrames));
+        gHasLastPose = false;
+        gFlashActive = false;
+        gLatencyActive = false;
+    }
+
+    bool latencyFlashActive() {
+        return gFlashActive.load(std::memory_order_relaxed);
+    }
+}
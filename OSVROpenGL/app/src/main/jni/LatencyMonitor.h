@@ -0,0 +1,64 @@
+/*
+ * Copyright (C) 2015 Sensics, Inc. and contributors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef OSVROPENGL_LATENCYMONITOR_H
+#define OSVROPENGL_LATENCYMONITOR_H
+
+#include <osvr/ClientKit/InterfaceStateC.h>
+
+namespace OSVROpenGL {
+
+    // Motion-to-photon latency. Each frame is tagged with the timestamp of the
+    // head pose it rendered with; the age of that pose is then taken when the
+    // present is submitted, when the GPU has finished the frame (an EGL fence,
+    // polled without blocking, so it's an upper bound by up to a frame) and
+    // when the frame is presented. The results go into the
+    // FRAME_STAGE_LATENCY_* / FRAME_STAGE_MOTION_TO_PHOTON frame stats.
+    //
+    // A frame counts as presented either when latencyFramePresented() is called
+    // right after eglSwapBuffers returns (the host harness does), or otherwise
+    // when the next frame starts: on Android GLSurfaceView swaps between the two.
+    // Since the frame can't be on screen before the GPU is done with it,
+    // motion-to-photon is the later of the two.
+    //
+    // Off by default; all calls must be made on the GL thread, except enabling.
+    static const int kLatencyPendingFrames = 4;
+
+    void setLatencyMeasurementEnabled(bool enabled);
+    bool isLatencyMeasurementEnabled();
+
+    // Draws a patch in the corner of each eye that turns white while the head
+    // is turning and black otherwise, for measuring with a photodiode.
+    void setLatencyTestPatternEnabled(bool enabled);
+    bool isLatencyTestPatternEnabled();
+
+    // Finishes frames whose fences have signalled and starts a new one.
+    void latencyBeginFrame();
+    // The pose the frame renders with; timestamp is null when it's unknown
+    // (e.g. replayed), in which case latency is counted from this call.
+    void latencyPoseConsumed(const OSVR_TimeValue *timestamp, const OSVR_PoseState *pose);
+    // Call after the present has been submitted; inserts the fence.
+    void latencySubmitted();
+    void latencyFramePresented();
+    // Forgets pending frames; call when a new context has been made current.
+    void resetLatencyMonitor();
+
+    // Whether the test pattern patch is lit this frame. Any thread.
+    bool latencyFlashActive();
+}
+
+#endif // OSVROPENGL_LATENCYMONITOR_H
@@ -0,0 +1,386 @@
+/*
+ * Copyright (C) 2015 Sensics, Inc. and contributors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include <atomic>
+#include <cstring>
+
+#include <GLES2/gl2.h>
+#include <GLES2/gl2ext.h>
+
+#include "Logging.h"
+#include "Layers.h"
+#include "DistortionMesh.h"
+#include "GLExtensions.h"
+
+namespace OSVROpenGL {
+
+    static QuadLayer gLayers[kMaxQuadLayers];
+    static std::atomic<uint64_t> gComposited(0);
+    static std::atomic<uint64_t> gContentChanges(0);
+    static std::atomic<uint64_t> gShadedPixels(0);
+
+    // The eye buffer path's programs, for GL_TEXTURE_2D layers and for
+    // GL_TEXTURE_EXTERNAL_OES ones where they can be sampled
+    static GLuint gLayerPrograms[2] = { 0, 0 };
+    static GLint gHomographyUniforms[2] = { -1, -1 };
+
+    static const char gLayerVertexShader[] =
+            "uniform mat3 layerFromEye;\n"
+            "attribute vec2 position;\n"
+            "varying vec3 layerPoint;\n"
+            "void main() {\n"
+            "  gl_Position = vec4(position, 0.0, 1.0);\n"
+            "  layerPoint = layerFromEye * vec3(position * 0.5 + 0.5, 1.0);\n"
+            "}\n";
+
+    // premultiplied, for glBlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA); after a kLayerSampler prefix
+    static const char gLayerFragmentShader[] =
+            "#ifdef GL_FRAGMENT_PRECISION_HIGH\n"
+            "precision highp float;\n"
+            "#else\n"
+            "precision mediump float;\n"
+            "#endif\n"
+            "uniform LAYER_SAMPLER source;\n"
+            "varying vec3 layerPoint;\n"
+            "void main() {\n"
+            "  vec2 uv = layerPoint.xy / layerPoint.z;\n"
+            "  vec2 s = step(vec2(0.0), uv) * step(uv, vec2(1.0));\n"
+            "  vec4 texel = texture2D(source, uv);\n"
+            "  gl_FragColor = vec4(texel.rgb, 1.0) * (texel.a * s.x * s.y * step(0.0, layerPoint.z));\n"
+            "}\n";
+
+    static const GLfloat gFullScreenQuad[] = { -1.0f, -1.0f, 1.0f, -1.0f, -1.0f, 1.0f, 1.0f, 1.0f };
+
+    void setQuadLayer(uint32_t index, const QuadLayer &layer) {
+        if (index < kMaxQuadLayers) {
+            gLayers[index] = layer;
+        }
+    }
+
+    void clearQuadLayer(uint32_t index) {
+        if (index < kMaxQuadLayers) {
+            memset(&gLayers[index], 0, sizeof(gLayers[index]));
+        }
+    }
+
+    bool hasQuadLayers() {
+        for (uint32_t i = 0; i < kMaxQuadLayers; i++) {
+            if (gLayers[i].texture) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void quadLayerContentChanged(uint32_t index) {
+        if (index < kMaxQuadLayers) {
+            gContentChanges.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    // Column-major 4x4 product.
+    static void multiply(const double *a, const double *b, double *out) {
+        for (int col = 0; col < 4; col++) {
+            for (int row = 0; row < 4; row++) {
+                double sum = 0.0;
+                for (int i = 0; i < 4; i++) {
+                    sum += a[i * 4 + row] * b[col * 4 + i];
+                }
+                out[col * 4 + row] = sum;
+            }
+        }
+    }
+
+    // The room from the head: the eyes' mean position, with the first eye's
+    // orientation (the eyes share theirs).
+    static void roomFromHead(const SceneView *views, uint32_t eyeCount, double *out) {
+        double position[3] = { 0.0, 0.0, 0.0 };
+        for (uint32_t eye = 0; eye < eyeCount; eye++) {
+            // -R^T t
+            const float *view = views[eye].view;
+            for (int axis = 0; axis < 3; axis++) {
+                position[axis] -= (static_cast<double>(view[axis * 4 + 0]) * view[12] +
+                                   static_cast<double>(view[axis * 4 + 1]) * view[13] +
+                                   static_cast<double>(view[axis * 4 + 2]) * view[14]) / eyeCount;
+            }
+        }
+        const float *view = views[0].view;
+        for (int col = 0; col < 3; col++) {
+            for (int row = 0; row < 3; row++) {
+                out[col * 4 + row] = view[row * 4 + col];
+            }
+            out[col * 4 + 3] = 0.0;
+        }
+        out[12] = position[0];
+        out[13] = position[1];
+        out[14] = position[2];
+        out[15] = 1.0;
+    }
+
+    static bool invert3x3(const double m[3][3], double out[3][3]) {
+        double c00 = m[1][1] * m[2][2] - m[1][2] * m[2][1];
+        double c01 = m[1][2] * m[2][0] - m[1][0] * m[2][2];
+        double c02 = m[1][0] * m[2][1] - m[1][1] * m[2][0];
+        double determinant = m[0][0] * c00 + m[0][1] * c01 + m[0][2] * c02;
+        if (determinant == 0.0) {
+            return false;
+        }
+        double d = 1.0 / determinant;
+        out[0][0] = c00 * d;
+        out[0][1] = (m[0][2] * m[2][1] - m[0][1] * m[2][2]) * d;
+        out[0][2] = (m[0][1] * m[1][2] - m[0][2] * m[1][1]) * d;
+        out[1][0] = c01 * d;
+        out[1][1] = (m[0][0] * m[2][2] - m[0][2] * m[2][0]) * d;
+        out[1][2] = (m[0][2] * m[1][0] - m[0][0] * m[1][2]) * d;
+        out[2][0] = c02 * d;
+        out[2][1] = (m[0][1] * m[2][0] - m[0][0] * m[2][1]) * d;
+        out[2][2] = (m[0][0] * m[1][1] - m[0][1] * m[1][0]) * d;
+        return true;
+    }
+
+    bool computeQuadLayerHomography(const QuadLayer &layer, const SceneView *views, uint32_t eyeCount,
+                                    uint32_t eye, float *homographyOut, float *uvMinOut, float *uvMaxOut) {
+        double projection[16];
+        double eyeFromSpace[16];
+        for (int i = 0; i < 16; i++) {
+            projection[i] = views[eye].projection[i];
+            eyeFromSpace[i] = views[eye].view[i];
+        }
+        if (layer.space == QUAD_LAYER_HEAD) {
+            double view[16];
+            double head[16];
+            memcpy(view, eyeFromSpace, sizeof(view));
+            roomFromHead(views, eyeCount, head);
+            multiply(view, head, eyeFromSpace);
+        }
+        double clipFromSpace[16];
+        multiply(projection, eyeFromSpace, clipFromSpace);
+
+        // A: the quad's (x, y, 1), x and y in [-1, 1], to clip space (x, y, w)
+        static const int clipRows[3] = { 0, 1, 3 };
+        double a[3][3];
+        for (int i = 0; i < 3; i++) {
+            const double *c = clipFromSpace + clipRows[i];
+            a[i][0] = c[0] * layer.size[0] * 0.5;
+            a[i][1] = c[4] * layer.size[1] * 0.5;
+            a[i][2] = c[0] * layer.center[0] + c[4] * layer.center[1] + c[8] * layer.center[2] + c[12];
+        }
+
+        // where the corners land bounds the rest, if they are all in front
+        uvMinOut[0] = uvMinOut[1] = 1.0f;
+        uvMaxOut[0] = uvMaxOut[1] = 0.0f;
+        bool allInFront = true;
+        for (int corner = 0; corner < 4; corner++) {
+            double x = corner & 1 ? 1.0 : -1.0;
+            double y = corner & 2 ? 1.0 : -1.0;
+            double w = a[2][0] * x + a[2][1] * y + a[2][2];
+            if (w <= 0.0) {
+                allInFront = false;
+                break;
+            }
+            for (int axis = 0; axis < 2; axis++) {
+                float uv = static_cast<float>((a[axis][0] * x + a[axis][1] * y + a[axis][2]) / w * 0.5 + 0.5);
+                uvMinOut[axis] = uv < uvMinOut[axis] ? uv : uvMinOut[axis];
+                uvMaxOut[axis] = uv > uvMaxOut[axis] ? uv : uvMaxOut[axis];
+            }
+        }
+        if (!allInFront) {
+            uvMinOut[0] = uvMinOut[1] = 0.0f;
+            uvMaxOut[0] = uvMaxOut[1] = 1.0f;
+        }
+        if (uvMaxOut[0] < 0.0f || uvMinOut[0] > 1.0f || uvMaxOut[1] < 0.0f || uvMinOut[1] > 1.0f) {
+            return false;
+        }
+
+        double aInverse[3][3];
+        if (!invert3x3(a, aInverse)) {
+            // seen edge on
+            return false;
+        }
+        // H = S * A^-1 * T: T takes texture coordinates to NDC, S the quad to the layer's
+        static const double t[3][3] = { { 2.0, 0.0, -1.0 }, { 0.0, 2.0, -1.0 }, { 0.0, 0.0, 1.0 } };
+        double flip = layer.topRowFirst ? -0.5 : 0.5;
+        const double s[3][3] = { { 0.5, 0.0, 0.5 }, { 0.0, flip, 0.5 }, { 0.0, 0.0, 1.0 } };
+        double inverseT[3][3];
+        for (int row = 0; row < 3; row++) {
+            for (int col = 0; col < 3; col++) {
+                inverseT[row][col] = aInverse[row][0] * t[0][col] + aInverse[row][1] * t[1][col] +
+                                     aInverse[row][2] * t[2][col];
+            }
+        }
+        for (int row = 0; row < 3; row++) {
+            for (int col = 0; col < 3; col++) {
+                double value = s[row][0] * inverseT[0][col] + s[row][1] * inverseT[1][col] +
+                               s[row][2] * inverseT[2][col];
+                homographyOut[col * 3 + row] = static_cast<float>(value);
+            }
+        }
+        return true;
+    }
+
+    static GLuint compileShader(GLenum type, const char *prefix, const char *source) {
+        GLuint shader = glCreateShader(type);
+        if (!shader) {
+            return 0;
+        }
+        const char *sources[2] = { prefix, source };
+        glShaderSource(shader, 2, sources, nullptr);
+        glCompileShader(shader);
+        GLint compiled = 0;
+        glGetShaderiv(shader, GL_COMPILE_STATUS, &compiled);
+        if (!compiled) {
+            char log[512] = {0};
+            glGetShaderInfoLog(shader, sizeof(log), nullptr, log);
+            LOGE("[Layers] Could not compile shader %d:\n%s", type, log);
+            glDeleteShader(shader);
+            return 0;
+        }
+        return shader;
+    }
+
+    static GLuint createLayerProgram(const char *samplerPrefix) {
+        GLuint vertexShader = compileShader(GL_VERTEX_SHADER, "", gLayerVertexShader);
+        GLuint fragmentShader = compileShader(GL_FRAGMENT_SHADER, samplerPrefix, gLayerFragmentShader);
+        if (!vertexShader || !fragmentShader) {
+            glDeleteShader(vertexShader);
+            glDeleteShader(fragmentShader);
+            return 0;
+        }
+        GLuint program = glCreateProgram();
+        glAttachShader(program, vertexShader);
+        glAttachShader(program, fragmentShader);
+        glBindAttribLocation(program, 0, "position");
+        glLinkProgram(program);
+        glDeleteShader(vertexShader);
+        glDeleteShader(fragmentShader);
+        GLint linked = GL_FALSE;
+        glGetProgramiv(program, GL_LINK_STATUS, &linked);
+        if (linked != GL_TRUE) {
+            char log[512] = {0};
+            glGetProgramInfoLog(program, sizeof(log), nullptr, log);
+            LOGE("[Layers] Could not link program:\n%s", log);
+            glDeleteProgram(program);
+            return 0;
+        }
+        glUseProgram(program);
+        glUniform1i(glGetUniformLocation(program, "source"), 0);
+        return program;
+    }
+
+    bool initQuadLayers() {
+        gLayerPrograms[0] = createLayerProgram(kLayerSampler2D);
+        gLayerPrograms[1] = 0;
+        if (hasGLExtension("GL_OES_EGL_image_external")) {
+            gLayerPrograms[1] = createLayerProgram(kLayerSamplerExternal);
+        }
+        for (int external = 0; external < 2; external++) {
+            if (gLayerPrograms[external]) {
+                gHomographyUniforms[external] = glGetUniformLocation(gLayerPrograms[external], "layerFromEye");
+            }
+        }
+        return gLayerPrograms[0] != 0;
+    }
+
+    void releaseQuadLayers() {
+        glDeleteProgram(gLayerPrograms[0]);
+        glDeleteProgram(gLayerPrograms[1]);
+        gLayerPrograms[0] = gLayerPrograms[1] = 0;
+    }
+
+    static void countComposited(const int *rect) {
+        gComposited.fetch_add(1, std::memory_order_relaxed);
+        gShadedPixels.fetch_add(static_cast<uint64_t>(rect[2]) * static_cast<uint64_t>(rect[3]),
+                                std::memory_order_relaxed);
+    }
+
+    void compositeQuadLayers(uint32_t eye, const SceneView *views, uint32_t eyeCount,
+                             int windowWidth, int windowHeight) {
+        bool scissored = false;
+        for (uint32_t i = 0; i < kMaxQuadLayers; i++) {
+            const QuadLayer &layer = gLayers[i];
+            float homography[9];
+            float uvMin[2];
+            float uvMax[2];
+            int rect[4];
+            if (!layer.texture ||
+                !computeQuadLayerHomography(layer, views, eyeCount, eye, homography, uvMin, uvMax) ||
+                !getDistortionMeshFootprint(eye, uvMin, uvMax, windowWidth, windowHeight, rect)) {
+                continue;
+            }
+            glEnable(GL_SCISSOR_TEST);
+            glScissor(rect[0], rect[1], rect[2], rect[3]);
+            scissored = true;
+            drawDistortionMeshLayer(eye, layer.target, layer.texture, homography);
+            countComposited(rect);
+        }
+        if (scissored) {
+            glDisable(GL_SCISSOR_TEST);
+        }
+    }
+
+    void drawQuadLayersIntoEye(uint32_t eye, const SceneView *views, uint32_t eyeCount, const int *viewport) {
+        bool drawn = false;
+        for (uint32_t i = 0; i < kMaxQuadLayers; i++) {
+            const QuadLayer &layer = gLayers[i];
+            int external = layer.target == GL_TEXTURE_EXTERNAL_OES ? 1 : 0;
+            float homography[9];
+            float uvMin[2];
+            float uvMax[2];
+            if (!layer.texture || !gLayerPrograms[external] ||
+                !computeQuadLayerHomography(layer, views, eyeCount, eye, homography, uvMin, uvMax)) {
+                continue;
+            }
+            int left = static_cast<int>(viewport[0] + (uvMin[0] > 0.0f ? uvMin[0] : 0.0f) * viewport[2]);
+            int bottom = static_cast<int>(viewport[1] + (uvMin[1] > 0.0f ? uvMin[1] : 0.0f) * viewport[3]);
+            int right = static_cast<int>(viewport[0] + (uvMax[0] < 1.0f ? uvMax[0] : 1.0f) * viewport[2] + 1.0f);
+            int top = static_cast<int>(viewport[1] + (uvMax[1] < 1.0f ? uvMax[1] : 1.0f) * viewport[3] + 1.0f);
+            const int rect[4] = { left, bottom, right - left, top - bottom };
+            if (!drawn) {
+                glActiveTexture(GL_TEXTURE0);
+                glEnableVertexAttribArray(0);
+                glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 0, gFullScreenQuad);
+                glEnable(GL_BLEND);
+                glBlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+                glEnable(GL_SCISSOR_TEST);
+                drawn = true;
+            }
+            glScissor(rect[0], rect[1], rect[2], rect[3]);
+            glUseProgram(gLayerPrograms[external]);
+            glUniformMatrix3fv(gHomographyUniforms[external], 1, GL_FALSE, homography);
+            glBindTexture(layer.target, layer.texture);
+            glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+            countComposited(rect);
+        }
+        if (drawn) {
+            glDisable(GL_SCISSOR_TEST);
+            glDisable(GL_BLEND);
+            glDisableVertexAttribArray(0);
+        }
+    }
+
+    void getQuadLayerStats(QuadLayerStats *statsOut) {
+        statsOut->composited = gComposited.load(std::memory_order_relaxed);
+        statsOut->contentChanges = gContentChanges.load(std::memory_order_relaxed);
+        statsOut->shadedPixels = gShadedPixels.load(std::memory_order_relaxed);
+    }
+
+    void resetQuadLayerStats() {
+        gComposited.store(0, std::memory_order_relaxed);
+        gContentChanges.store(0, std::memory_order_relaxed);
+        gShadedPixels.store(0, std::memory_order_relaxed);
+    }
+}
@@ -0,0 +1,106 @@
+/*
+ * Copyright (C) 2015 Sensics, Inc. and contributors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef OSVROPENGL_LAYERS_H
+#define OSVROPENGL_LAYERS_H
+
+#include <cstdint>
+
+#include <GLES2/gl2.h>
+
+#include "Scene.h"
+
+namespace OSVROpenGL {
+
+    // Quad layers: images (the camera feed, a video) that are composited in
+    // the present step instead of being drawn into the eye buffers with the
+    // scene. When the distortion mesh presents, a layer is sampled once,
+    // through the mesh, at display resolution, so its texels are not
+    // resampled into an eye buffer first; only the part of the window the
+    // layer can land on is shaded. It is composited every display frame with
+    // that frame's pose, reprojected or not, whether or not the app drew a new
+    // frame or the layer got new contents. When RenderManager presents (it
+    // only takes eye buffers), layers are drawn into the eye buffers just
+    // before they are handed over.
+    //
+    // Everything but quadLayerContentChanged() and the stats is GL thread only.
+
+    static const uint32_t kMaxQuadLayers = 4;
+
+    // Layer fragment shaders sample a LAYER_SAMPLER, which one of these
+    // prefixes defines for the layer's texture target.
+    static const char kLayerSampler2D[] = "#define LAYER_SAMPLER sampler2D\n";
+    static const char kLayerSamplerExternal[] =
+            "#extension GL_OES_EGL_image_external : require\n"
+            "#define LAYER_SAMPLER samplerExternalOES\n";
+
+    enum QuadLayerSpace {
+        QUAD_LAYER_HEAD,        // stays in front of the viewer
+        QUAD_LAYER_ROOM         // stays put in the room
+    };
+
+    // A rectangle facing +z (the viewer, for one in front of them), over the
+    // eye buffers in index order.
+    struct QuadLayer {
+        GLuint texture;         // 0: no layer
+        GLenum target;          // GL_TEXTURE_2D, or GL_TEXTURE_EXTERNAL_OES for an imported image (see ExternalImage.h)
+        QuadLayerSpace space;
+        float center[3];        // meters in its space; -z is ahead
+        float size[2];          // width and height in meters
+        bool topRowFirst;       // texture rows go top down, as images usually do
+    };
+
+    void setQuadLayer(uint32_t index, const QuadLayer &layer);
+    void clearQuadLayer(uint32_t index);
+    bool hasQuadLayers();
+    // Counts a new image in the layer's texture; any thread. The compositor
+    // needs no telling: it samples the texture as it is every frame.
+    void quadLayerContentChanged(uint32_t index);
+
+    // Takes the eye's texture coordinates (its [0,1] viewport) to the layer's
+    // as a column-major 3x3 homography; the third coordinate is negative
+    // where the eye looks away from the layer's plane. The head, for head
+    // space layers, is where the views put the middle of the eyes, facing as
+    // they do. Also gives the box in the eye's texture coordinates the layer
+    // lands in; false if it is nowhere in front of the eye.
+    bool computeQuadLayerHomography(const QuadLayer &layer, const SceneView *views, uint32_t eyeCount,
+                                    uint32_t eye, float *homographyOut, float *uvMinOut, float *uvMaxOut);
+
+    // Compiles the eye buffer path's program; call with each new context current.
+    bool initQuadLayers();
+    void releaseQuadLayers();
+
+    // Composites the layers over the eye's part of the current framebuffer
+    // (windowWidth x windowHeight, viewport over all of it) through the
+    // distortion mesh.
+    void compositeQuadLayers(uint32_t eye, const SceneView *views, uint32_t eyeCount,
+                             int windowWidth, int windowHeight);
+    // Draws the layers over an eye buffer's viewport (x, y, width, height),
+    // which must be the bound framebuffer's.
+    void drawQuadLayersIntoEye(uint32_t eye, const SceneView *views, uint32_t eyeCount, const int *viewport);
+
+    struct QuadLayerStats {
+        uint64_t composited;        // layer draws, one per layer per eye
+        uint64_t contentChanges;
+        uint64_t shadedPixels;      // pixels in the scissor of those draws
+    };
+
+    void getQuadLayerStats(QuadLayerStats *statsOut);
+    void resetQuadLayerStats();
+}
+
+#endif // OSVROPENGL_LAYERS_H
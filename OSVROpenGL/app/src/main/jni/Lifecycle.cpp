@@ -0,0 +1,198 @@
+/*
+ * Copyright (C) 2015 Sensics, Inc. and contributors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include <atomic>
+#include <cstring>
+#include <mutex>
+
+#include <EGL/egl.h>
+#include <GLES2/gl2.h>
+
+#include "Logging.h"
+#include "FrameStats.h"
+#include "Lifecycle.h"
+
+namespace OSVROpenGL {
+
+    struct GpuResource {
+        const char *name;
+        GpuResourceCreateFunction create;
+        GpuResourceReleaseFunction release;
+        bool live;                  // built in gResourceContext; GL thread only
+        std::atomic<bool> stale;
+    };
+
+    // Entries are filled in before the count that publishes them is raised, so
+    // markGpuResourceStale() can look names up from any thread.
+    static GpuResource gGpuResources[kMaxGpuResources];
+    static std::atomic<int> gGpuResourceCount(0);
+
+    // The context the live resources were built in, and a buffer made in it
+    // last: a new context can come back with the same handle, but not with
+    // the buffer.
+    static EGLContext gResourceContext = EGL_NO_CONTEXT;
+    static GLuint gSentinelBuffer = 0;
+
+    static std::mutex gStatsMutex;
+    static LifecycleStats gStats = {LIFECYCLE_STOPPED, 0, 0, 0, 0, 0, 0, 0.0, -1.0};
+    // When the last resume happened, until a frame has been presented after it.
+    static std::atomic<uint64_t> gResumeNs(0);
+
+    static GpuResource *findGpuResource(const char *name) {
+        int count = gGpuResourceCount.load(std::memory_order_acquire);
+        for (int i = 0; i < count; i++) {
+            if (strcmp(gGpuResources[i].name, name) == 0) {
+                return &gGpuResources[i];
+            }
+        }
+        return nullptr;
+    }
+
+    void registerGpuResource(const char *name, GpuResourceCreateFunction create,
+                             GpuResourceReleaseFunction release) {
+        GpuResource *resource = findGpuResource(name);
+        if (resource) {
+            resource->create = create;
+            resource->release = release;
+            return;
+        }
+        int count = gGpuResourceCount.load(std::memory_order_relaxed);
+        if (count == kMaxGpuResources) {
+            LOGE("[Lifecycle] Too many GPU resources; %s is not managed.", name);
+            return;
+        }
+        resource = &gGpuResources[count];
+        resource->name = name;
+        resource->create = create;
+        resource->release = release;
+        resource->live = false;
+        resource->stale.store(false, std::memory_order_relaxed);
+        gGpuResourceCount.store(count + 1, std::memory_order_release);
+    }
+
+    void markGpuResourceStale(const char *name) {
+        GpuResource *resource = findGpuResource(name);
+        if (resource) {
+            resource->stale.store(true);
+        }
+    }
+
+    bool lifecycleSurfaceChanged(bool *newContextOut) {
+        uint64_t startNs = frameStatsNowNs();
+        EGLContext context = eglGetCurrentContext();
+        bool kept = context != EGL_NO_CONTEXT && context == gResourceContext &&
+                    gSentinelBuffer != 0 && glIsBuffer(gSentinelBuffer) == GL_TRUE;
+
+        int count = gGpuResourceCount.load(std::memory_order_acquire);
+        uint32_t rebuilt = 0;
+        bool ok = true;
+        for (int i = 0; i < count; i++) {
+            GpuResource &resource = gGpuResources[i];
+            bool stale = resource.stale.exchange(false);
+            if (kept && resource.live && !stale) {
+                continue;
+            }
+            if (kept && resource.live && resource.release) {
+                resource.release();
+            }
+            resource.live = resource.create();
+            rebuilt++;
+            if (!resource.live) {
+                LOGE("[Lifecycle] Could not build %s.", resource.name);
+                ok = false;
+            }
+        }
+        if (!kept) {
+            glGenBuffers(1, &gSentinelBuffer);
+            glBindBuffer(GL_ARRAY_BUFFER, gSentinelBuffer);
+            glBindBuffer(GL_ARRAY_BUFFER, 0);
+            gResourceContext = context;
+        }
+
+        double rebuildMs = (frameStatsNowNs() - startNs) / 1.0e6;
+        {
+            std::lock_guard<std::mutex> lock(gStatsMutex);
+            if (kept) {
+                gStats.surfaceOnlyChanges++;
+            } else {
+                gStats.newContexts++;
+            }
+            gStats.lastRebuiltResources = rebuilt;
+            gStats.lastRebuildMs = rebuildMs;
+        }
+        LOGI("[Lifecycle] %s; rebuilt %u of %d GPU resources in %.3f ms.",
+             kept ? "Surface changed, context kept" : "New context", rebuilt, count, rebuildMs);
+        if (newContextOut) {
+            *newContextOut = !kept;
+        }
+        return ok;
+    }
+
+    void lifecyclePause() {
+        std::lock_guard<std::mutex> lock(gStatsMutex);
+        gStats.state = LIFECYCLE_PAUSED;
+        gStats.pauses++;
+    }
+
+    void lifecycleResume() {
+        gResumeNs.store(frameStatsNowNs());
+        std::lock_guard<std::mutex> lock(gStatsMutex);
+        gStats.state = LIFECYCLE_RUNNING;
+        gStats.resumes++;
+    }
+
+    void lifecycleFramePresented() {
+        uint64_t resumeNs = gResumeNs.load(std::memory_order_relaxed);
+        if (resumeNs == 0 || !gResumeNs.compare_exchange_strong(resumeNs, 0)) {
+            return;
+        }
+        double resumeToFrameMs = (frameStatsNowNs() - resumeNs) / 1.0e6;
+        {
+            std::lock_guard<std::mutex> lock(gStatsMutex);
+            gStats.resumedFrames++;
+            gStats.lastResumeToFrameMs = resumeToFrameMs;
+        }
+        LOGI("[Lifecycle] First frame %.3f ms after resume.", resumeToFrameMs);
+    }
+
+    void lifecycleStop() {
+        bool current = gResourceContext != EGL_NO_CONTEXT && eglGetCurrentContext() == gResourceContext;
+        int count = gGpuResourceCount.load(std::memory_order_acquire);
+        for (int i = count - 1; i >= 0; i--) {
+            GpuResource &resource = gGpuResources[i];
+            if (current && resource.live && resource.release) {
+                resource.release();
+            }
+            resource.live = false;
+            resource.stale.store(false);
+        }
+        if (current && gSentinelBuffer) {
+            glDeleteBuffers(1, &gSentinelBuffer);
+        }
+        gSentinelBuffer = 0;
+        gResourceContext = EGL_NO_CONTEXT;
+        gResumeNs.store(0);
+
+        std::lock_guard<std::mutex> lock(gStatsMutex);
+        gStats.state = LIFECYCLE_STOPPED;
+    }
+
+    void getLifecycleStats(LifecycleStats *statsOut) {
+        std::lock_guard<std::mutex> lock(gStatsMutex);
+        *statsOut = gStats;
+    }
+}
@@ -0,0 +1,95 @@
+/*
+ * Copyright (C) 2015 Sensics, Inc. and contributors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef OSVROPENGL_LIFECYCLE_H
+#define OSVROPENGL_LIFECYCLE_H
+
+#include <cstdint>
+
+namespace OSVROpenGL {
+
+    // Keeps what can be kept across the activity's lifecycle instead of
+    // starting over at every surface change. The GL context is preserved over a
+    // pause when the platform allows it (GLSurfaceView's
+    // setPreserveEGLContextOnPause), and the OSVR client is kept until stop().
+    //
+    // Every GPU resource is registered once, with how to build it in the
+    // current context and how to delete it. When the surface changes,
+    // lifecycleSurfaceChanged() works out whether the context the resources
+    // were built in is still the current one; if it is, only resources marked
+    // stale (their configuration changed) or that failed to build are rebuilt,
+    // otherwise all of them are. Resources are built in registration order and
+    // released in reverse.
+    //
+    // The time from resume to the first frame presented after it is logged and
+    // kept in the stats.
+
+    // Builds the resource in the current context. Must not touch the names it
+    // had before: after a context loss they are gone, or belong to something
+    // else. Returns false if it could not be built (it is retried at the next
+    // surface change).
+    typedef bool (*GpuResourceCreateFunction)();
+    // Deletes the resource; only ever called with the context it was built in
+    // current. May be null.
+    typedef void (*GpuResourceReleaseFunction)();
+
+    static const int kMaxGpuResources = 16;
+
+    // GL thread only. Registering a name again replaces its functions.
+    void registerGpuResource(const char *name, GpuResourceCreateFunction create,
+                             GpuResourceReleaseFunction release);
+    // The next lifecycleSurfaceChanged() rebuilds it. Any thread; does nothing
+    // for a name not registered yet, as that is built anyway.
+    void markGpuResourceStale(const char *name);
+
+    enum LifecycleState {
+        LIFECYCLE_STOPPED,      // before the first resume, and after stop()
+        LIFECYCLE_RUNNING,
+        LIFECYCLE_PAUSED
+    };
+
+    // Call from setupGraphics(), with the new surface's context current.
+    // newContextOut is set when the resources had to be built from scratch
+    // (first surface, or the context was lost). Returns false if any resource
+    // could not be built. GL thread only.
+    bool lifecycleSurfaceChanged(bool *newContextOut);
+    // The activity is pausing; the context and the client are kept.
+    void lifecyclePause();
+    // The activity is resuming; starts the resume-to-first-frame clock. Any thread.
+    void lifecycleResume();
+    // Call after each presented frame; ends the resume-to-first-frame clock. GL thread only.
+    void lifecycleFramePresented();
+    // Releases every resource, if the context they were built in is current
+    // (otherwise they are left to go with it), and forgets the context.
+    void lifecycleStop();
+
+    struct LifecycleStats {
+        LifecycleState state;
+        uint32_t pauses;
+        uint32_t resumes;
+        uint32_t resumedFrames;         // resumes that have been followed by a frame
+        uint32_t newContexts;           // surface changes that had to build everything
+        uint32_t surfaceOnlyChanges;    // surface changes that kept the context
+        uint32_t lastRebuiltResources;  // at the last surface change
+        double lastRebuildMs;
+        double lastResumeToFrameMs;     // negative until a frame follows a resume
+    };
+
+    void getLifecycleStats(LifecycleStats *statsOut);
+}
+
+#endif // OSVROPENGL_LIFECYCLE_H
@@ -0,0 +1,747 @@
+/*
+ * Copyright (C) 2015 Sensics, Inc. and contributors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <string>
+
+#include <EGL/egl.h>
+#include <GLES2/gl2.h>
+
+#include "Logging.h"
+#include "Materials.h"
+#include "FrameStats.h"
+#include "GLExtensions.h"
+#include "GpuMemory.h"
+#include "Lifecycle.h"
+#include "SceneMesh.h"
+#include "TextureAtlas.h"
+
+// ES 3.0 texture arrays, missing from the GLES 2 headers
+#ifndef GL_TEXTURE_2D_ARRAY
+#define GL_TEXTURE_2D_ARRAY 0x8C1A
+#endif
+#ifndef GL_MAX_ARRAY_TEXTURE_LAYERS
+#define GL_MAX_ARRAY_TEXTURE_LAYERS 0x88FF
+#endif
+#ifndef GL_RGBA8
+#define GL_RGBA8 0x8058
+#endif
+
+namespace OSVROpenGL {
+
+    typedef void (GL_APIENTRY *TexImage3DFn)(GLenum target, GLint level, GLint internalformat, GLsizei width,
+                                             GLsizei height, GLsizei depth, GLint border, GLenum format,
+                                             GLenum type, const void *pixels);
+
+    // Atlas pages packed at load: the smallest power of two (so ES 2.0
+    // mipmaps them) from kMaterialAtlasMinPageSize that takes every material
+    // in one page, or as many of the largest as it takes.
+    static const uint32_t kMaterialAtlasMinPageSize = 256;
+    static const uint32_t kMaterialAtlasPageSize = 1024;
+    static const uint32_t kMaterialAtlasPadding = 4;
+
+    // Attribute locations, bound before linking.
+    static const GLuint kPositionAttribute = 0;
+    static const GLuint kColorAttribute = 1;
+    static const GLuint kTexCoordinateAttribute = 2;
+    static const GLuint kInstanceAttribute = 3;
+
+    // A vertex of the merged draws' buffer: the cube's, and which copy it is in.
+    struct BatchVertex {
+        GLfloat position[3];
+        GLfloat color[4];
+        GLfloat texCoordinate[2];
+        GLfloat instance;
+    };
+
+    struct MaterialProgram {
+        GLuint program;
+        GLint view;
+        GLint projection;
+        GLint positionScale;
+        GLint positionOffset;
+        GLint model;            // models[] when merged
+        GLint uvTransform;      // uvTransforms[] when merged
+        GLint layer;            // layers[] when merged
+    };
+
+    static const char *const kTextureBatchingNames[kTextureBatchingModes] = { "none", "atlas", "array" };
+
+    // The ES 2.0 and ES 3.0 spellings of the one source below; the array
+    // sampler is ES 3.0 only.
+    static const char gVertexPrefix[] =
+            "#define ATTRIBUTE attribute\n"
+                    "#define VARYING varying\n";
+    static const char gVertexPrefixArray[] =
+            "#version 300 es\n"
+                    "#define ATTRIBUTE in\n"
+                    "#define VARYING out\n";
+    static const char gFragmentPrefix[] =
+            "precision mediump float;\n"
+                    "#define VARYING varying\n"
+                    "#define FRAG_COLOR gl_FragColor\n"
+                    "#define SAMPLER sampler2D\n"
+                    "#define SAMPLE(sampler, uv) texture2D(sampler, (uv).xy)\n";
+    static const char gFragmentPrefixArray[] =
+            "#version 300 es\n"
+                    "precision mediump float;\n"
+                    "precision mediump sampler2DArray;\n"
+                    "#define VARYING in\n"
+                    "out vec4 fragColor;\n"
+                    "#define FRAG_COLOR fragColor\n"
+                    "#define SAMPLER sampler2DArray\n"
+                    "#define SAMPLE(sampler, uv) texture(sampler, uv)\n";
+
+    // The scene program's, with the texture transform (and layer) per object,
+    // or per copy of the cube when BATCH_SIZE copies are merged.
+    static const char gVertexShader[] =
+            "uniform mat4 view;\n"
+                    "uniform mat4 projection;\n"
+                    "uniform vec3 positionScale;\n"
+                    "uniform vec3 positionOffset;\n"
+                    "#ifdef BATCH_SIZE\n"
+                    "uniform mat4 models[BATCH_SIZE];\n"
+                    "uniform vec4 uvTransforms[BATCH_SIZE];\n"
+                    "uniform float layers[BATCH_SIZE];\n"
+                    "ATTRIBUTE float vInstance;\n"
+                    "#else\n"
+                    "uniform mat4 model;\n"
+                    "uniform vec4 uvTransform;\n"
+                    "uniform float layer;\n"
+                    "#endif\n"
+                    "ATTRIBUTE vec4 vPosition;\n"
+                    "ATTRIBUTE vec4 vColor;\n"
+                    "ATTRIBUTE vec2 vTexCoordinate;\n"
+                    "VARYING vec3 texCoordinate;\n"
+                    "VARYING vec4 fragmentColor;\n"
+                    "void main() {\n"
+                    "#ifdef BATCH_SIZE\n"
+                    "  int instance = int(vInstance);\n"
+                    "  mat4 model = models[instance];\n"
+                    "  vec4 uvTransform = uvTransforms[instance];\n"
+                    "  float layer = layers[instance];\n"
+                    "#endif\n"
+                    "  vec4 position = vec4(vPosition.xyz * positionScale + positionOffset, vPosition.w);\n"
+                    "  gl_Position = projection * view * model * position;\n"
+                    "  fragmentColor = vColor;\n"
+                    "  texCoordinate = vec3(vTexCoordinate * uvTransform.xy + uvTransform.zw, layer);\n"
+                    "}\n";
+
+    static const char gFragmentShader[] =
+            "uniform SAMPLER uTexture;\n"
+                    "VARYING vec3 texCoordinate;\n"
+                    "VARYING vec4 fragmentColor;\n"
+                    "void main() {\n"
+                    "  FRAG_COLOR = fragmentColor * SAMPLE(uTexture, texCoordinate);\n"
+                    "}\n";
+
+    static uint32_t gRequestedCount = 0;
+    static TextureBatching gRequestedBatching = TEXTURE_BATCHING_ATLAS;
+    static std::string gAtlasPath;
+
+    static TextureBatching gBatching = TEXTURE_BATCHING_NONE;
+    static uint32_t gMaterialCount = 0;
+    static std::vector<GLuint> gTextures;               // per material, atlas page or texture array
+    static std::vector<uint32_t> gMaterialTextures;     // into gTextures, per material
+    static std::vector<GLfloat> gMaterialTransforms;    // 4 per material, see textureAtlasUVTransform()
+    static std::vector<GLfloat> gMaterialLayers;
+    static MaterialProgram gProgram;
+    static MaterialProgram gBatchProgram;               // none without an atlas or array
+    static GLuint gBatchBuffer = 0;
+
+    static const GLfloat *gCubePositions = nullptr;
+    static const GLfloat *gCubeColors = nullptr;
+    static const GLfloat *gCubeTexCoordinates = nullptr;
+    static uint32_t gCubeVertexCount = 0;
+
+    // The merged draw being gathered
+    static GLfloat gBatchModels[kMaterialBatchSize * 16];
+    static GLfloat gBatchTransforms[kMaterialBatchSize * 4];
+    static GLfloat gBatchLayers[kMaterialBatchSize];
+
+    static MaterialStats gStats;        // what setupMaterials() made
+    static std::atomic<uint64_t> gObjects(0);
+    static std::atomic<uint64_t> gDraws(0);
+    static std::atomic<uint64_t> gTextureBinds(0);
+    static std::atomic<uint64_t> gMergedDraws(0);
+
+    const char *textureBatchingName(TextureBatching batching) {
+        return batching >= 0 && batching < kTextureBatchingModes ? kTextureBatchingNames[batching] : "unknown";
+    }
+
+    // xorshift32, so every device makes the same materials
+    static uint32_t hashMaterial(uint32_t material) {
+        uint32_t x = material * 0x9e3779b9u + 0x7f4a7c15u;
+        for (int round = 0; round < 3; round++) {
+            x ^= x << 13;
+            x ^= x >> 17;
+            x ^= x << 5;
+        }
+        return x;
+    }
+
+    void makeMaterialImage(uint32_t material, std::vector<uint8_t> *rgbaOut, uint32_t *widthOut,
+                           uint32_t *heightOut) {
+        uint32_t hash = hashMaterial(material);
+        uint32_t width = 16u << (hash & 3);
+        uint32_t height = 16u << ((hash >> 2) & 3);
+        uint8_t color[3] = { static_cast<uint8_t>(64 + ((hash >> 8) & 0xBF)),
+                             static_cast<uint8_t>(64 + ((hash >> 16) & 0xBF)),
+                             static_cast<uint8_t>(64 + ((hash >> 24) & 0xBF)) };
+        uint32_t cell = std::max(width, height) / 8;
+        rgbaOut->resize(static_cast<size_t>(width) * height * 4);
+        for (uint32_t y = 0; y < height; y++) {
+            for (uint32_t x = 0; x < width; x++) {
+                uint8_t *texel = &(*rgbaOut)[(static_cast<size_t>(y) * width + x) * 4];
+                bool border = x == 0 || y == 0 || x == width - 1 || y == height - 1;
+                bool light = ((x / cell) + (y / cell)) & 1;
+                for (int channel = 0; channel < 3; channel++) {
+                    texel[channel] = border ? color[channel] / 4 : light ? color[channel] : color[channel] * 3 / 4;
+                }
+                texel[3] = 255;
+            }
+        }
+        *widthOut = width;
+        *heightOut = height;
+    }
+
+    void setSceneMaterials(uint32_t count, TextureBatching batching, const char *atlasPath) {
+        gRequestedCount = count;
+        gRequestedBatching = batching;
+        gAtlasPath = atlasPath ? atlasPath : "";
+        setSceneMaterialCount(count);
+        markGpuResourceStale("materials");
+    }
+
+    static uint64_t mipChainBytes(uint32_t width, uint32_t height) {
+        uint64_t bytes = 0;
+        while (true) {
+            bytes += static_cast<uint64_t>(width) * height * 4;
+            if (width == 1 && height == 1) {
+                return bytes;
+            }
+            width = std::max(width / 2, 1u);
+            height = std::max(height / 2, 1u);
+        }
+    }
+
+    static void setMipmapFiltering(GLenum target) {
+        glGenerateMipmap(target);
+        glTexParameteri(target, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+        glTexParameteri(target, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(target, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(target, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    }
+
+    static GLuint uploadTexture2D(const uint8_t *rgba, uint32_t width, uint32_t height) {
+        GLuint texture = 0;
+        glGenTextures(1, &texture);
+        glBindTexture(GL_TEXTURE_2D, texture);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, static_cast<GLsizei>(width), static_cast<GLsizei>(height), 0,
+                     GL_RGBA, GL_UNSIGNED_BYTE, rgba);
+        setMipmapFiltering(GL_TEXTURE_2D);
+        trackGpuObject(GPU_OBJECT_TEXTURE, texture, GPU_MEMORY_TEXTURES, mipChainBytes(width, height));
+        gTextures.push_back(texture);
+        return texture;
+    }
+
+    static void setIdentityTransforms(uint32_t count) {
+        gMaterialTransforms.assign(count * 4, 0.0f);
+        gMaterialLayers.assign(count, 0.0f);
+        for (uint32_t i = 0; i < count; i++) {
+            gMaterialTransforms[i * 4] = gMaterialTransforms[i * 4 + 1] = 1.0f;
+        }
+        gMaterialTextures.assign(count, 0);
+    }
+
+    // A texture per material.
+    static bool uploadSeparate(const std::vector<TextureAtlasImage> &images) {
+        uint32_t count = static_cast<uint32_t>(images.size());
+        setIdentityTransforms(count);
+        for (uint32_t i = 0; i < count; i++) {
+            uploadTexture2D(images[i].rgba, images[i].width, images[i].height);
+            gMaterialTextures[i] = i;
+        }
+        gStats.occupancy = 1.0f;
+        return true;
+    }
+
+    static void setAtlasTransforms(const TextureAtlasRect *rects, uint32_t count, uint32_t pageSize) {
+        setIdentityTransforms(count);
+        for (uint32_t i = 0; i < count; i++) {
+            textureAtlasUVTransform(rects[i], pageSize, pageSize, &gMaterialTransforms[i * 4]);
+            gMaterialTextures[i] = rects[i].page;
+        }
+    }
+
+    // Packed into atlas pages here and now.
+    static bool packAndUploadAtlas(const std::vector<TextureAtlasImage> &images, uint32_t maxPageSize) {
+        uint32_t count = static_cast<uint32_t>(images.size());
+        std::vector<TextureAtlasRect> rects;
+        uint32_t pageCount = 0;
+        uint32_t pageSize = kMaterialAtlasMinPageSize;
+        for (const TextureAtlasImage &image : images) {
+            while (pageSize < std::max(image.width, image.height) + 2 * kMaterialAtlasPadding) {
+                pageSize *= 2;
+            }
+        }
+        pageSize = std::min(pageSize, maxPageSize);
+        while (true) {
+            bool packed = packTextureAtlas(images.data(), count, pageSize, kMaterialAtlasPadding, &rects,
+                                           &pageCount);
+            if (packed && pageCount == 1) {
+                break;
+            }
+            if (pageSize * 2 > maxPageSize) {
+                if (!packed) {
+                    return false;
+                }
+                break;
+            }
+            pageSize *= 2;
+        }
+        std::vector<uint8_t> pixels;
+        fillTextureAtlasPages(images.data(), count, rects.data(), pageSize, pageCount, kMaterialAtlasPadding, &pixels);
+        size_t pageBytes = static_cast<size_t>(pageSize) * pageSize * 4;
+        for (uint32_t page = 0; page < pageCount; page++) {
+            uploadTexture2D(pixels.data() + page * pageBytes, pageSize, pageSize);
+        }
+        setAtlasTransforms(rects.data(), count, pageSize);
+        gStats.occupancy = textureAtlasOccupancy(rects.data(), count, pageSize, pageCount);
+        return true;
+    }
+
+    // Packed offline; the pages go up as they are in the file.
+    static bool uploadAtlasFile(const MappedTextureAtlas &atlas, GLint maxTextureSize) {
+        const TextureAtlasFileHeader &header = *atlas.header;
+        if (header.pageSize > static_cast<uint32_t>(maxTextureSize) ||
+            (!isOpenGLES3() && (header.pageSize & (header.pageSize - 1)))) {
+            LOGE("[Materials] %s has %u texel pages, which this context can't mipmap.", gAtlasPath.c_str(),
+                 header.pageSize);
+            return false;
+        }
+        size_t pageBytes = static_cast<size_t>(header.pageSize) * header.pageSize * 4;
+        for (uint32_t page = 0; page < header.pageCount; page++) {
+            uploadTexture2D(atlas.pixels + page * pageBytes, header.pageSize, header.pageSize);
+        }
+        setAtlasTransforms(atlas.entries, header.entryCount, header.pageSize);
+        gStats.occupancy = textureAtlasOccupancy(atlas.entries, header.entryCount, header.pageSize, header.pageCount);
+        gStats.prepacked = true;
+        return true;
+    }
+
+    // A layer per material, as big as the biggest; the smaller ones sit in
+    // their layer's corner with their edges stretched over the rest.
+    static bool uploadArrays(const std::vector<TextureAtlasImage> &images) {
+        TexImage3DFn texImage3D = (TexImage3DFn) eglGetProcAddress("glTexImage3D");
+        if (!texImage3D) {
+            LOGE("[Materials] No glTexImage3D.");
+            return false;
+        }
+        uint32_t count = static_cast<uint32_t>(images.size());
+        uint32_t layerWidth = 1;
+        uint32_t layerHeight = 1;
+        uint64_t imageTexels = 0;
+        for (const TextureAtlasImage &image : images) {
+            layerWidth = std::max(layerWidth, image.width);
+            layerHeight = std::max(layerHeight, image.height);
+            imageTexels += static_cast<uint64_t>(image.width) * image.height;
+        }
+        GLint maxLayers = 0;
+        glGetIntegerv(GL_MAX_ARRAY_TEXTURE_LAYERS, &maxLayers);
+        uint32_t layersPerArray = static_cast<uint32_t>(std::max(maxLayers, 1));
+
+        setIdentityTransforms(count);
+        size_t layerBytes = static_cast<size_t>(layerWidth) * layerHeight * 4;
+        std::vector<uint8_t> layers;
+        for (uint32_t first = 0; first < count; first += layersPerArray) {
+            uint32_t layerCount = std::min(layersPerArray, count - first);
+            layers.resize(layerBytes * layerCount);
+            for (uint32_t layer = 0; layer < layerCount; layer++) {
+                const TextureAtlasImage &image = images[first + layer];
+                copyTextureAtlasImage(image, layers.data() + layer * layerBytes, layerWidth, 0, 0, 0, 0,
+                                      layerWidth, layerHeight);
+                GLfloat *transform = &gMaterialTransforms[(first + layer) * 4];
+                transform[0] = static_cast<GLfloat>(image.width) / layerWidth;
+                transform[1] = static_cast<GLfloat>(image.height) / layerHeight;
+                gMaterialLayers[first + layer] = static_cast<GLfloat>(layer);
+                gMaterialTextures[first + layer] = static_cast<uint32_t>(gTextures.size());
+            }
+            GLuint texture = 0;
+            glGenTextures(1, &texture);
+            glBindTexture(GL_TEXTURE_2D_ARRAY, texture);
+            texImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_RGBA8, static_cast<GLsizei>(layerWidth),
+                       static_cast<GLsizei>(layerHeight), static_cast<GLsizei>(layerCount), 0, GL_RGBA,
+                       GL_UNSIGNED_BYTE, layers.data());
+            setMipmapFiltering(GL_TEXTURE_2D_ARRAY);
+            trackGpuObject(GPU_OBJECT_TEXTURE, texture, GPU_MEMORY_TEXTURES,
+                           mipChainBytes(layerWidth, layerHeight) * layerCount);
+            gTextures.push_back(texture);
+        }
+        glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+        gStats.occupancy = static_cast<float>(static_cast<double>(imageTexels) /
+                                              (static_cast<double>(layerWidth) * layerHeight * count));
+        return true;
+    }
+
+    static GLuint compileShader(GLenum type, const char *prefix, const char *defines, const char *source) {
+        GLuint shader = glCreateShader(type);
+        if (!shader) {
+            return 0;
+        }
+        const char *sources[3] = { prefix, defines, source };
+        glShaderSource(shader, 3, sources, nullptr);
+        glCompileShader(shader);
+        GLint compiled = 0;
+        glGetShaderiv(shader, GL_COMPILE_STATUS, &compiled);
+        if (!compiled) {
+            char log[512] = {0};
+            glGetShaderInfoLog(shader, sizeof(log), nullptr, log);
+            LOGE("[Materials] Could not compile shader %d:\n%s", type, log);
+            glDeleteShader(shader);
+            return 0;
+        }
+        return shader;
+    }
+
+    static bool createMaterialProgram(bool arrays, bool merged, MaterialProgram *programOut) {
+        memset(programOut, 0, sizeof(*programOut));
+        std::string defines;
+        if (merged) {
+            defines = "#define BATCH_SIZE " + std::to_string(kMaterialBatchSize) + "\n";
+        }
+        GLuint vertexShader = compileShader(GL_VERTEX_SHADER, arrays ? gVertexPrefixArray : gVertexPrefix,
+                                            defines.c_str(), gVertexShader);
+        GLuint fragmentShader = compileShader(GL_FRAGMENT_SHADER, arrays ? gFragmentPrefixArray : gFragmentPrefix,
+                                              "", gFragmentShader);
+        if (!vertexShader || !fragmentShader) {
+            glDeleteShader(vertexShader);
+            glDeleteShader(fragmentShader);
+            return false;
+        }
+        GLuint program = glCreateProgram();
+        glAttachShader(program, vertexShader);
+        glAttachShader(program, fragmentShader);
+        glBindAttribLocation(program, kPositionAttribute, "vPosition");
+        glBindAttribLocation(program, kColorAttribute, "vColor");
+        glBindAttribLocation(program, kTexCoordinateAttribute, "vTexCoordinate");
+        if (merged) {
+            glBindAttribLocation(program, kInstanceAttribute, "vInstance");
+        }
+        glLinkProgram(program);
+        glDeleteShader(vertexShader);
+        glDeleteShader(fragmentShader);
+        GLint linked = GL_FALSE;
+        glGetProgramiv(program, GL_LINK_STATUS, &linked);
+        if (linked != GL_TRUE) {
+            char log[512] = {0};
+            glGetProgramInfoLog(program, sizeof(log), nullptr, log);
+            LOGE("[Materials] Could not link program:\n%s", log);
+            glDeleteProgram(program);
+            return false;
+        }
+        programOut->program = program;
+        programOut->view = glGetUniformLocation(program, "view");
+        programOut->projection = glGetUniformLocation(program, "projection");
+        programOut->positionScale = glGetUniformLocation(program, "positionScale");
+        programOut->positionOffset = glGetUniformLocation(program, "positionOffset");
+        programOut->model = glGetUniformLocation(program, merged ? "models" : "model");
+        programOut->uvTransform = glGetUniformLocation(program, merged ? "uvTransforms" : "uvTransform");
+        programOut->layer = glGetUniformLocation(program, merged ? "layers" : "layer");
+        glUseProgram(program);
+        glUniform1i(glGetUniformLocation(program, "uTexture"), 0);
+        if (!merged) {
+            // all that a texture per material needs
+            glUniform4f(programOut->uvTransform, 1.0f, 1.0f, 0.0f, 0.0f);
+            glUniform1f(programOut->layer, 0.0f);
+        }
+        return true;
+    }
+
+    // kMaterialBatchSize copies of the cube, told apart by their instance.
+    static void createBatchBuffer() {
+        std::vector<BatchVertex> vertices(kMaterialBatchSize * gCubeVertexCount);
+        for (uint32_t instance = 0; instance < kMaterialBatchSize; instance++) {
+            for (uint32_t i = 0; i < gCubeVertexCount; i++) {
+                BatchVertex &vertex = vertices[instance * gCubeVertexCount + i];
+                memcpy(vertex.position, gCubePositions + i * 3, sizeof(vertex.position));
+                memcpy(vertex.color, gCubeColors + i * 4, sizeof(vertex.color));
+                memcpy(vertex.texCoordinate, gCubeTexCoordinates + i * 2, sizeof(vertex.texCoordinate));
+                vertex.instance = static_cast<GLfloat>(instance);
+            }
+        }
+        glGenBuffers(1, &gBatchBuffer);
+        glBindBuffer(GL_ARRAY_BUFFER, gBatchBuffer);
+        glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(BatchVertex), vertices.data(), GL_STATIC_DRAW);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        trackGpuObject(GPU_OBJECT_BUFFER, gBatchBuffer, GPU_MEMORY_BUFFERS, vertices.size() * sizeof(BatchVertex));
+    }
+
+    bool setupMaterials(const GLfloat *cubePositions, const GLfloat *cubeColors,
+                        const GLfloat *cubeTexCoordinates, uint32_t cubeVertexCount) {
+        // names from an earlier context are gone with it
+        gTextures.clear();
+        gMaterialTextures.clear();
+        gMaterialTransforms.clear();
+        gMaterialLayers.clear();
+        memset(&gProgram, 0, sizeof(gProgram));
+        memset(&gBatchProgram, 0, sizeof(gBatchProgram));
+        gBatchBuffer = 0;
+        gMaterialCount = 0;
+        memset(&gStats, 0, sizeof(gStats));
+        gCubePositions = cubePositions;
+        gCubeColors = cubeColors;
+        gCubeTexCoordinates = cubeTexCoordinates;
+        gCubeVertexCount = cubeVertexCount;
+        if (gRequestedCount == 0) {
+            return true;
+        }
+
+        uint64_t startNs = frameStatsNowNs();
+        TextureBatching batching = gRequestedBatching;
+        if (batching == TEXTURE_BATCHING_ARRAY && !isOpenGLES3()) {
+            LOGI("[Materials] Texture arrays need ES 3.0; packing an atlas instead.");
+            batching = TEXTURE_BATCHING_ATLAS;
+        }
+        GLint maxTextureSize = 0;
+        glGetIntegerv(GL_MAX_TEXTURE_SIZE, &maxTextureSize);
+
+        MappedTextureAtlas atlas;
+        bool haveAtlas = !gAtlasPath.empty() && mapTextureAtlasFile(gAtlasPath.c_str(), &atlas);
+        bool ok;
+        if (haveAtlas && batching == TEXTURE_BATCHING_ATLAS) {
+            ok = uploadAtlasFile(atlas, maxTextureSize);
+        } else {
+            // the images, out of the atlas file or made up
+            uint32_t count = haveAtlas ? atlas.header->entryCount : gRequestedCount;
+            std::vector<std::vector<uint8_t> > pixels(count);
+            std::vector<TextureAtlasImage> images(count);
+            for (uint32_t i = 0; i < count; i++) {
+                if (haveAtlas) {
+                    const TextureAtlasRect &rect = atlas.entries[i];
+                    size_t pageTexels = static_cast<size_t>(atlas.header->pageSize) * atlas.header->pageSize;
+                    const uint8_t *page = atlas.pixels + rect.page * pageTexels * 4;
+                    pixels[i].resize(static_cast<size_t>(rect.width) * rect.height * 4);
+                    for (uint32_t row = 0; row < rect.height; row++) {
+                        memcpy(&pixels[i][static_cast<size_t>(row) * rect.width * 4],
+                               page + ((rect.y + row) * static_cast<size_t>(atlas.header->pageSize) + rect.x) * 4,
+                               static_cast<size_t>(rect.width) * 4);
+                    }
+                    images[i].width = rect.width;
+                    images[i].height = rect.height;
+                } else {
+                    makeMaterialImage(i, &pixels[i], &images[i].width, &images[i].height);
+                }
+                images[i].rgba = pixels[i].data();
+            }
+            if (batching == TEXTURE_BATCHING_NONE) {
+                ok = uploadSeparate(images);
+            } else if (batching == TEXTURE_BATCHING_ATLAS) {
+                ok = packAndUploadAtlas(images, std::min(kMaterialAtlasPageSize,
+                                                         static_cast<uint32_t>(maxTextureSize)));
+            } else {
+                ok = uploadArrays(images);
+            }
+        }
+        if (haveAtlas) {
+            unmapTextureAtlasFile(&atlas);
+        }
+        glBindTexture(GL_TEXTURE_2D, 0);
+
+        bool arrays = batching == TEXTURE_BATCHING_ARRAY;
+        ok = ok && createMaterialProgram(arrays, false, &gProgram);
+        if (ok && batching != TEXTURE_BATCHING_NONE) {
+            // without it every object is drawn on its own, which still saves the binds
+            if (createMaterialProgram(arrays, true, &gBatchProgram)) {
+                createBatchBuffer();
+            } else {
+                LOGI("[Materials] Drawing objects one by one: the merged draw's program didn't link.");
+            }
+        }
+        if (!ok) {
+            LOGE("[Materials] Could not set up %u materials.", gRequestedCount);
+            releaseMaterials();
+            return false;
+        }
+
+        gBatching = batching;
+        gMaterialCount = static_cast<uint32_t>(gMaterialTextures.size());
+        gStats.batching = batching;
+        gStats.materials = gMaterialCount;
+        gStats.textures = static_cast<uint32_t>(gTextures.size());
+        gStats.loadMs = (frameStatsNowNs() - startNs) / 1.0e6;
+        LOGI("[Materials] %u materials in %u %s (%s, %.0f%% occupied) in %.3f ms.", gMaterialCount,
+             gStats.textures, batching == TEXTURE_BATCHING_NONE ? "textures" :
+             batching == TEXTURE_BATCHING_ATLAS ? "atlas pages" : "texture arrays",
+             gStats.prepacked ? "packed offline" : textureBatchingName(batching), gStats.occupancy * 100.0f,
+             gStats.loadMs);
+        return true;
+    }
+
+    void releaseMaterials() {
+        for (GLuint texture : gTextures) {
+            glDeleteTextures(1, &texture);
+            forgetGpuObject(GPU_OBJECT_TEXTURE, texture);
+        }
+        gTextures.clear();
+        glDeleteProgram(gProgram.program);
+        glDeleteProgram(gBatchProgram.program);
+        memset(&gProgram, 0, sizeof(gProgram));
+        memset(&gBatchProgram, 0, sizeof(gBatchProgram));
+        glDeleteBuffers(1, &gBatchBuffer);
+        forgetGpuObject(GPU_OBJECT_BUFFER, gBatchBuffer);
+        gBatchBuffer = 0;
+        gMaterialCount = 0;
+    }
+
+    bool areMaterialsReady() {
+        return gMaterialCount != 0 && gProgram.program != 0;
+    }
+
+    static void drawBatch(uint32_t count) {
+        glUniformMatrix4fv(gBatchProgram.model, static_cast<GLsizei>(count), GL_FALSE, gBatchModels);
+        glUniform4fv(gBatchProgram.uvTransform, static_cast<GLsizei>(count), gBatchTransforms);
+        if (gBatching == TEXTURE_BATCHING_ARRAY) {
+            glUniform1fv(gBatchProgram.layer, static_cast<GLsizei>(count), gBatchLayers);
+        }
+        glDrawArrays(GL_TRIANGLES, 0, static_cast<GLsizei>(count * gCubeVertexCount));
+    }
+
+    void drawMaterialObjects(const SceneDrawCommand *drawList, uint32_t drawCount, const SceneView &view,
+                             bool sceneMesh) {
+        if (!areMaterialsReady()) {
+            return;
+        }
+        bool merged = !sceneMesh && gBatchBuffer != 0;
+        const MaterialProgram &program = merged ? gBatchProgram : gProgram;
+        glUseProgram(program.program);
+        glUniformMatrix4fv(program.projection, 1, GL_FALSE, view.projection);
+        glUniformMatrix4fv(program.view, 1, GL_FALSE, view.view);
+        float positionScale[3];
+        float positionOffset[3];
+        getSceneMeshPositionTransform(positionScale, positionOffset);
+        glUniform3fv(program.positionScale, 1, positionScale);
+        glUniform3fv(program.positionOffset, 1, positionOffset);
+
+        if (sceneMesh) {
+            bindSceneMesh(kPositionAttribute, kColorAttribute, kTexCoordinateAttribute);
+        } else if (merged) {
+            glBindBuffer(GL_ARRAY_BUFFER, gBatchBuffer);
+            glEnableVertexAttribArray(kPositionAttribute);
+            glVertexAttribPointer(kPositionAttribute, 3, GL_FLOAT, GL_FALSE, sizeof(BatchVertex),
+                                  reinterpret_cast<const void *>(offsetof(BatchVertex, position)));
+            glEnableVertexAttribArray(kColorAttribute);
+            glVertexAttribPointer(kColorAttribute, 4, GL_FLOAT, GL_FALSE, sizeof(BatchVertex),
+                                  reinterpret_cast<const void *>(offsetof(BatchVertex, color)));
+            glEnableVertexAttribArray(kTexCoordinateAttribute);
+            glVertexAttribPointer(kTexCoordinateAttribute, 2, GL_FLOAT, GL_FALSE, sizeof(BatchVertex),
+                                  reinterpret_cast<const void *>(offsetof(BatchVertex, texCoordinate)));
+            glEnableVertexAttribArray(kInstanceAttribute);
+            glVertexAttribPointer(kInstanceAttribute, 1, GL_FLOAT, GL_FALSE, sizeof(BatchVertex),
+                                  reinterpret_cast<const void *>(offsetof(BatchVertex, instance)));
+        } else {
+            glEnableVertexAttribArray(kPositionAttribute);
+            glVertexAttribPointer(kPositionAttribute, 3, GL_FLOAT, GL_FALSE, 0, gCubePositions);
+            glEnableVertexAttribArray(kColorAttribute);
+            glVertexAttribPointer(kColorAttribute, 4, GL_FLOAT, GL_FALSE, 0, gCubeColors);
+            glEnableVertexAttribArray(kTexCoordinateAttribute);
+            glVertexAttribPointer(kTexCoordinateAttribute, 2, GL_FLOAT, GL_FALSE, 0, gCubeTexCoordinates);
+        }
+
+        GLenum target = gBatching == TEXTURE_BATCHING_ARRAY ? GL_TEXTURE_2D_ARRAY : GL_TEXTURE_2D;
+        bool transformed = gBatching != TEXTURE_BATCHING_NONE;
+        uint32_t bound = UINT32_MAX;
+        uint32_t pending = 0;
+        uint64_t objects = 0;
+        uint64_t draws = 0;
+        uint64_t binds = 0;
+        for (uint32_t i = 0; i < drawCount; i++) {
+            const SceneDrawCommand &command = drawList[i];
+            if (command.material == kSceneNoMaterial) {
+                continue;
+            }
+            uint32_t material = command.material % gMaterialCount;
+            uint32_t texture = gMaterialTextures[material];
+            if (texture != bound) {
+                // what is gathered was for the texture bound until now
+                if (pending) {
+                    drawBatch(pending);
+                    draws++;
+                    pending = 0;
+                }
+                glBindTexture(target, gTextures[texture]);
+                bound = texture;
+                binds++;
+            }
+            objects++;
+            if (merged) {
+                memcpy(&gBatchModels[pending * 16], command.model, sizeof(command.model));
+                memcpy(&gBatchTransforms[pending * 4], &gMaterialTransforms[material * 4], 4 * sizeof(GLfloat));
+                gBatchLayers[pending] = gMaterialLayers[material];
+                if (++pending == kMaterialBatchSize) {
+                    drawBatch(pending);
+                    draws++;
+                    pending = 0;
+                }
+                continue;
+            }
+            glUniformMatrix4fv(program.model, 1, GL_FALSE, command.model);
+            if (transformed) {
+                glUniform4fv(program.uvTransform, 1, &gMaterialTransforms[material * 4]);
+                if (gBatching == TEXTURE_BATCHING_ARRAY) {
+                    glUniform1f(program.layer, gMaterialLayers[material]);
+                }
+            }
+            if (sceneMesh) {
+                drawSceneMesh();
+            } else {
+                glDrawArrays(GL_TRIANGLES, 0, static_cast<GLsizei>(gCubeVertexCount));
+            }
+            draws++;
+        }
+        if (pending) {
+            drawBatch(pending);
+            draws++;
+        }
+        if (merged) {
+            glDisableVertexAttribArray(kInstanceAttribute);
+            glBindBuffer(GL_ARRAY_BUFFER, 0);
+        }
+
+        gObjects.fetch_add(objects, std::memory_order_relaxed);
+        gDraws.fetch_add(draws, std::memory_order_relaxed);
+        gTextureBinds.fetch_add(binds, std::memory_order_relaxed);
+        gMergedDraws.fetch_add(objects - draws, std::memory_order_relaxed);
+    }
+
+    void getMaterialStats(MaterialStats *statsOut) {
+        *statsOut = gStats;
+        statsOut->objects = gObjects.load(std::memory_order_relaxed);
+        statsOut->draws = gDraws.load(std::memory_order_relaxed);
+        statsOut->textureBinds = gTextureBinds.load(std::memory_order_relaxed);
+        statsOut->mergedDraws = gMergedDraws.load(std::memory_order_relaxed);
+    }
+
+    void resetMaterialStats() {
+        gObjects.store(0, std::memory_order_relaxed);
+        gDraws.store(0, std::memory_order_relaxed);
+        gTextureBinds.store(0, std::memory_order_relaxed);
+        gMergedDraws.store(0, std::memory_order_relaxed);
+    }
+}
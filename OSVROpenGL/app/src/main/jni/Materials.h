@@ -0,0 +1,117 @@
+/*
+ * Copyright (C) 2015 Sensics, Inc. and contributors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef OSVROPENGL_MATERIALS_H
+#define OSVROPENGL_MATERIALS_H
+
+#include <cstdint>
+#include <vector>
+
+#include <GLES2/gl2.h>
+
+#include "Scene.h"
+
+namespace OSVROpenGL {
+
+    // Scene materials: the spinning cubes (not the room cube) take turns at a
+    // set of small textures, as the objects of most scenes each have their
+    // own. How the textures are given to GL decides what drawing them costs:
+    //
+    //   TEXTURE_BATCHING_NONE   a texture per material, bound whenever the
+    //                           next object's material is another, and a
+    //                           draw per object
+    //   TEXTURE_BATCHING_ATLAS  the materials packed into atlas pages (see
+    //                           TextureAtlas.h), at load by the skyline packer
+    //                           or offline by atlas_tool; the vertex shader
+    //                           takes each object's texture coordinates into
+    //                           its material's rectangle
+    //   TEXTURE_BATCHING_ARRAY  a layer of a 2D texture array per material, on
+    //                           ES 3.0; ATLAS elsewhere
+    //
+    // With an atlas or an array, objects whose materials share the bound page
+    // need no bind between them, and the built-in cube's draws are merged:
+    // up to kMaterialBatchSize objects in one glDrawArrays from a buffer
+    // holding that many copies of the cube, each copy taking its model matrix
+    // and texture transform from uniform arrays by its index (ES 2.0 has no
+    // instancing). A mesh (see SceneMesh.h) is drawn once per object as
+    // before, but without the binds.
+    //
+    // GL thread only (the app thread's, with async reprojection), but for the
+    // setter and the stats.
+
+    enum TextureBatching {
+        TEXTURE_BATCHING_NONE,
+        TEXTURE_BATCHING_ATLAS,
+        TEXTURE_BATCHING_ARRAY
+    };
+
+    static const int kTextureBatchingModes = 3;
+
+    // Objects per merged draw: a model matrix, a texture transform and an
+    // array layer each take 6 of the 128 vertex uniform vectors ES 2.0
+    // promises, with the view, projection and mesh transform in the rest.
+    static const uint32_t kMaterialBatchSize = 16;
+
+    const char *textureBatchingName(TextureBatching batching);
+
+    // The made-up material textures: a checkerboard in a color of its own
+    // inside a darker border, so a texel from the wrong material shows, and
+    // 16 to 128 texels on a side (powers of two, so ES 2.0 mipmaps them).
+    void makeMaterialImage(uint32_t material, std::vector<uint8_t> *rgbaOut, uint32_t *widthOut,
+                           uint32_t *heightOut);
+
+    // count materials for the spinning cubes (0, the default, for none),
+    // given to GL as batching says. With an atlasPath, an atlas file (see
+    // TextureAtlas.h) has the materials instead of makeMaterialImage(), and
+    // with TEXTURE_BATCHING_ATLAS its pages are uploaded as they are. Call
+    // while the GL thread is paused or not yet started; applied at the next
+    // surface change.
+    void setSceneMaterials(uint32_t count, TextureBatching batching, const char *atlasPath);
+
+    // Builds the material textures and programs for the current context.
+    // cubePositions, cubeColors and cubeTexCoordinates (3, 4 and 2 floats per
+    // vertex) are the built-in cube's triangles, for the merged draws.
+    bool setupMaterials(const GLfloat *cubePositions, const GLfloat *cubeColors,
+                        const GLfloat *cubeTexCoordinates, uint32_t cubeVertexCount);
+    void releaseMaterials();
+    bool areMaterialsReady();
+
+    // Draws the draw list's objects that have a material into the bound
+    // framebuffer, with the built-in cube or, if sceneMesh, the scene mesh.
+    // Leaves the material program in use and the mesh's buffers bound.
+    void drawMaterialObjects(const SceneDrawCommand *drawList, uint32_t drawCount, const SceneView &view,
+                             bool sceneMesh);
+
+    struct MaterialStats {
+        TextureBatching batching;   // in effect
+        uint32_t materials;
+        uint32_t textures;          // material textures, atlas pages or texture arrays
+        bool prepacked;             // the atlas came from a file
+        float occupancy;            // of the atlas pages or array layers, by the materials' texels
+        double loadMs;              // making, packing and uploading them
+        uint64_t objects;           // drawn with a material
+        uint64_t draws;
+        uint64_t textureBinds;
+        uint64_t mergedDraws;       // draws saved by merging objects into one
+    };
+
+    void getMaterialStats(MaterialStats *statsOut);
+    // Zeroes the per-frame counts.
+    void resetMaterialStats();
+}
+
+#endif // OSVROPENGL_MATERIALS_H
@@ -0,0 +1,439 @@
+/*
+ * Copyright (C) 2015 Sensics, Inc. and contributors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#if OSVROPENGL_HAVE_LZ4
+#include <lz4.h>
+#endif
+
+#include "Logging.h"
+#include "FrameStats.h"
+#include "Recording.h"
+
+namespace OSVROpenGL {
+
+    static const char kRecordingMagic[8] = { 'O', 'S', 'V', 'R', 'R', 'E', 'C', '1' };
+
+    struct RecordingFileHeader {
+        char magic[8];
+        uint32_t version;
+        uint32_t chunkBytes;
+    };
+
+    static_assert(sizeof(RecordingFileHeader) == 16, "RecordingFileHeader layout changed");
+
+    // Recorder state
+    static FILE *gRecordFile = nullptr;
+    static bool gRecordCompressed = false;
+    static char *gRecordChunkBuffer = nullptr;   // compression output, one chunk
+    static uint64_t gRecordFrames = 0;
+
+    // Replayer state
+    static FILE *gReplayFile = nullptr;
+    static double gReplaySpeed = 0.0;
+    static bool gReplayLoop = false;
+    static char *gReplayChunkBuffer = nullptr;   // compressed input, one chunk
+    static OSVR_ImageBufferElement *gReplayImage = nullptr;
+    static size_t gReplayImageCapacity = 0;
+    static RecordHeader gReplayPending;          // header read ahead, not yet played
+    static bool gReplayHasPending = false;
+    static int64_t gReplayBaseUs = 0;            // recording time replay started from
+    static uint64_t gReplayBaseNs = 0;           // wall time replay started at
+    static bool gReplayHasBase = false;
+    static uint64_t gReplayFrames = 0;
+    static OSVR_TimeValue gReplayFrameTime = {0};
+
+    static int64_t toMicroseconds(int64_t seconds, int32_t microseconds) {
+        return seconds * 1000000 + microseconds;
+    }
+
+    static bool writeRecord(uint16_t type, uint16_t flags, const OSVR_TimeValue *timestamp,
+                            const void *payload, uint32_t payloadBytes,
+                            const void *extra = nullptr, uint32_t extraBytes = 0) {
+        RecordHeader header;
+        header.type = type;
+        header.flags = flags;
+        header.payloadBytes = payloadBytes + extraBytes;
+        header.seconds = timestamp ? timestamp->seconds : 0;
+        header.microseconds = timestamp ? timestamp->microseconds : 0;
+        header.reserved = 0;
+        bool ok = fwrite(&header, sizeof(header), 1, gRecordFile) == 1 &&
+                  fwrite(payload, payloadBytes, 1, gRecordFile) == 1;
+        if (ok && extraBytes) {
+            ok = fwrite(extra, extraBytes, 1, gRecordFile) == 1;
+        }
+        if (!ok) {
+            LOGE("[Recording] Write failed, recording stopped.");
+            stopRecording();
+        }
+        return ok;
+    }
+
+    bool startRecording(const char *path, bool compressImages) {
+        stopRecording();
+        gRecordFile = fopen(path, "wb");
+        if (!gRecordFile) {
+            LOGE("[Recording] Could not open %s for writing.", path);
+            return false;
+        }
+        // Camera frames are large; write them out in big blocks.
+        setvbuf(gRecordFile, nullptr, _IOFBF, 1 << 20);
+
+        gRecordCompressed = OSVROPENGL_HAVE_LZ4 && compressImages;
+#if OSVROPENGL_HAVE_LZ4
+        if (gRecordCompressed) {
+            gRecordChunkBuffer = static_cast<char *>(malloc(LZ4_compressBound(kRecordingChunkBytes)));
+        }
+#else
+        if (compressImages) {
+            LOGI("[Recording] Built without LZ4, camera frames are stored uncompressed.");
+        }
+#endif
+        RecordingFileHeader header;
+        memcpy(header.magic, kRecordingMagic, sizeof(header.magic));
+        header.version = kRecordingVersion;
+        header.chunkBytes = kRecordingChunkBytes;
+        if (fwrite(&header, sizeof(header), 1, gRecordFile) != 1) {
+            LOGE("[Recording] Could not write to %s.", path);
+            stopRecording();
+            return false;
+        }
+        gRecordFrames = 0;
+        LOGI("[Recording] Recording to %s", path);
+        return true;
+    }
+
+    void stopRecording() {
+        if (!gRecordFile) {
+            return;
+        }
+        fclose(gRecordFile);
+        gRecordFile = nullptr;
+        free(gRecordChunkBuffer);
+        gRecordChunkBuffer = nullptr;
+        LOGI("[Recording] Stopped after %llu frames.", static_cast<unsigned long long>(gRecordFrames));
+    }
+
+    bool isRecording() {
+        return gRecordFile != nullptr;
+    }
+
+    void recordImage(const OSVR_TimeValue *timestamp, const OSVR_ImagingReport *report) {
+        if (!gRecordFile) {
+            return;
+        }
+        const OSVR_ImagingMetadata &metadata = report->state.metadata;
+        size_t totalBytes = static_cast<size_t>(metadata.width) * metadata.height *
+                            metadata.channels * metadata.depth;
+
+        RecordedImage image;
+        image.sensor = report->sensor;
+        image.width = metadata.width;
+        image.height = metadata.height;
+        image.channels = metadata.channels;
+        image.depth = metadata.depth;
+        image.valueType = static_cast<uint16_t>(metadata.type);
+        image.chunkCount = static_cast<uint32_t>((totalBytes + kRecordingChunkBytes - 1) / kRecordingChunkBytes);
+        image.reserved = 0;
+        if (!writeRecord(RECORD_IMAGE, 0, timestamp, &image, sizeof(image))) {
+            return;
+        }
+
+        const char *data = reinterpret_cast<const char *>(report->state.data);
+        for (size_t offset = 0; offset < totalBytes; offset += kRecordingChunkBytes) {
+            RecordedImageChunk chunk;
+            chunk.rawBytes = static_cast<uint32_t>(totalBytes - offset < kRecordingChunkBytes ?
+                                                   totalBytes - offset : kRecordingChunkBytes);
+            chunk.storedBytes = chunk.rawBytes;
+            const char *stored = data + offset;
+            uint16_t flags = 0;
+#if OSVROPENGL_HAVE_LZ4
+            if (gRecordCompressed) {
+                int compressed = LZ4_compress_default(stored, gRecordChunkBuffer, chunk.rawBytes,
+                                                      LZ4_compressBound(kRecordingChunkBytes));
+                // Keep incompressible chunks raw.
+                if (compressed > 0 && static_cast<uint32_t>(compressed) < chunk.rawBytes) {
+                    chunk.storedBytes = static_cast<uint32_t>(compressed);
+                    stored = gRecordChunkBuffer;
+                    flags = RECORD_FLAG_LZ4;
+                }
+            }
+#endif
+            if (!writeRecord(RECORD_IMAGE_CHUNK, flags, timestamp, &chunk, sizeof(chunk),
+                             stored, chunk.storedBytes)) {
+                return;
+            }
+        }
+    }
+
+    void recordInputEvent(const PackedInputEvent &event) {
+        if (!gRecordFile) {
+            return;
+        }
+        OSVR_TimeValue timestamp;
+        timestamp.seconds = event.seconds;
+        timestamp.microseconds = event.microseconds;
+        writeRecord(RECORD_INPUT, 0, &timestamp, &event, sizeof(event));
+    }
+
+    void recordFrame(const OSVR_TimeValue *timestamp, const OSVR_PoseState *headPose) {
+        if (!gRecordFile) {
+            return;
+        }
+        RecordedPose pose;
+        memset(&pose, 0, sizeof(pose));
+        if (headPose) {
+            memcpy(pose.translation, headPose->translation.data, sizeof(pose.translation));
+            memcpy(pose.rotation, headPose->rotation.data, sizeof(pose.rotation));
+        } else {
+            pose.rotation[0] = 1.0;
+        }
+        if (writeRecord(RECORD_FRAME, headPose ? RECORD_FLAG_HAS_POSE : 0, timestamp, &pose, sizeof(pose))) {
+            gRecordFrames++;
+        }
+    }
+
+    static bool rewindReplay() {
+        gReplayHasPending = false;
+        gReplayHasBase = false;
+        return fseek(gReplayFile, sizeof(RecordingFileHeader), SEEK_SET) == 0;
+    }
+
+    bool startReplay(const char *path, double speed, bool loop) {
+        stopReplay();
+        gReplayFile = fopen(path, "rb");
+        if (!gReplayFile) {
+            LOGE("[Recording] Could not open %s for replay.", path);
+            return false;
+        }
+        setvbuf(gReplayFile, nullptr, _IOFBF, 1 << 20);
+
+        RecordingFileHeader header;
+        if (fread(&header, sizeof(header), 1, gReplayFile) != 1 ||
+            memcmp(header.magic, kRecordingMagic, sizeof(header.magic)) != 0 ||
+            header.version != kRecordingVersion || header.chunkBytes > kRecordingChunkBytes) {
+            LOGE("[Recording] %s is not a recording this build can replay.", path);
+            stopReplay();
+            return false;
+        }
+        gReplayChunkBuffer = static_cast<char *>(malloc(kRecordingChunkBytes));
+        gReplaySpeed = speed;
+        gReplayLoop = loop;
+        gReplayFrames = 0;
+        memset(&gReplayFrameTime, 0, sizeof(gReplayFrameTime));
+        rewindReplay();
+        LOGI("[Recording] Replaying %s (%s)", path, speed > 0.0 ? "timed" : "one frame per update");
+        return true;
+    }
+
+    void stopReplay() {
+        if (!gReplayFile) {
+            return;
+        }
+        fclose(gReplayFile);
+        gReplayFile = nullptr;
+        free(gReplayChunkBuffer);
+        gReplayChunkBuffer = nullptr;
+        free(gReplayImage);
+        gReplayImage = nullptr;
+        gReplayImageCapacity = 0;
+        LOGI("[Recording] Replay stopped after %llu frames.", static_cast<unsigned long long>(gReplayFrames));
+    }
+
+    bool isReplaying() {
+        return gReplayFile != nullptr;
+    }
+
+    static bool readPayload(void *out, size_t bytes) {
+        return bytes == 0 || fread(out, bytes, 1, gReplayFile) == 1;
+    }
+
+    static bool readImage(const RecordHeader &header, const ReplaySinks &sinks) {
+        RecordedImage image;
+        if (header.payloadBytes != sizeof(image) || !readPayload(&image, sizeof(image))) {
+            return false;
+        }
+        size_t totalBytes = static_cast<size_t>(image.width) * image.height * image.channels * image.depth;
+        if (totalBytes > gReplayImageCapacity) {
+            free(gReplayImage);
+            gReplayImage = static_cast<OSVR_ImageBufferElement *>(malloc(totalBytes));
+            gReplayImageCapacity = gReplayImage ? totalBytes : 0;
+            if (!gReplayImage) {
+                return false;
+            }
+        }
+
+        size_t offset = 0;
+        for (uint32_t i = 0; i < image.chunkCount; i++) {
+            RecordHeader chunkHeader;
+            RecordedImageChunk chunk;
+            if (!readPayload(&chunkHeader, sizeof(chunkHeader)) || chunkHeader.type != RECORD_IMAGE_CHUNK ||
+                !readPayload(&chunk, sizeof(chunk)) ||
+                chunk.rawBytes > totalBytes - offset || chunk.storedBytes > kRecordingChunkBytes ||
+                chunkHeader.payloadBytes != sizeof(chunk) + chunk.storedBytes) {
+                return false;
+            }
+            char *dst = reinterpret_cast<char *>(gReplayImage) + offset;
+            if (chunkHeader.flags & RECORD_FLAG_LZ4) {
+#if OSVROPENGL_HAVE_LZ4
+                if (!readPayload(gReplayChunkBuffer, chunk.storedBytes) ||
+                    LZ4_decompress_safe(gReplayChunkBuffer, dst, chunk.storedBytes, chunk.rawBytes) !=
+                    static_cast<int>(chunk.rawBytes)) {
+                    return false;
+                }
+#else
+                LOGE("[Recording] Recording has LZ4 compressed frames, but this build has no LZ4.");
+                return false;
+#endif
+            } else if (chunk.storedBytes != chunk.rawBytes || !readPayload(dst, chunk.rawBytes)) {
+                return false;
+            }
+            offset += chunk.rawBytes;
+        }
+        if (offset != totalBytes) {
+            return false;
+        }
+
+        if (sinks.imaging) {
+            OSVR_TimeValue timestamp;
+            timestamp.seconds = header.seconds;
+            timestamp.microseconds = header.microseconds;
+            OSVR_ImagingReport report;
+            memset(&report, 0, sizeof(report));
+            report.sensor = image.sensor;
+            report.state.metadata.width = image.width;
+            report.state.metadata.height = image.height;
+            report.state.metadata.channels = image.channels;
+            report.state.metadata.depth = image.depth;
+            report.state.metadata.type = static_cast<OSVR_ImagingValueType>(image.valueType);
+            report.state.data = gReplayImage;
+            sinks.imaging(sinks.imagingUserdata, &timestamp, &report);
+        }
+        return true;
+    }
+
+    static bool readInput(const RecordHeader &header, const ReplaySinks &sinks) {
+        PackedInputEvent event;
+        if (header.payloadBytes != sizeof(event) || !readPayload(&event, sizeof(event))) {
+            return false;
+        }
+        OSVR_TimeValue timestamp;
+        timestamp.seconds = event.seconds;
+        timestamp.microseconds = event.microseconds;
+        void *userdata = sinks.inputUserdata ?
+                         sinks.inputUserdata(static_cast<InputEventSource>(event.source)) : nullptr;
+        if (event.type == INPUT_EVENT_BUTTON && sinks.button) {
+            OSVR_ButtonReport report;
+            report.sensor = static_cast<int32_t>(event.sensor);
+            report.state = static_cast<OSVR_ButtonState>(event.buttonState);
+            sinks.button(userdata, &timestamp, &report);
+        } else if (event.type == INPUT_EVENT_LOCATION2D && sinks.location2D) {
+            OSVR_Location2DReport report;
+            report.sensor = event.sensor;
+            report.location.data[0] = event.x;
+            report.location.data[1] = event.y;
+            sinks.location2D(userdata, &timestamp, &report);
+        }
+        return true;
+    }
+
+    static bool readFrame(const RecordHeader &header, OSVR_PoseState *headPoseOut, bool *hasHeadPoseOut) {
+        RecordedPose pose;
+        if (header.payloadBytes != sizeof(pose) || !readPayload(&pose, sizeof(pose))) {
+            return false;
+        }
+        *hasHeadPoseOut = (header.flags & RECORD_FLAG_HAS_POSE) != 0;
+        if (*hasHeadPoseOut) {
+            memcpy(headPoseOut->translation.data, pose.translation, sizeof(pose.translation));
+            memcpy(headPoseOut->rotation.data, pose.rotation, sizeof(pose.rotation));
+        }
+        gReplayFrameTime.seconds = header.seconds;
+        gReplayFrameTime.microseconds = header.microseconds;
+        gReplayFrames++;
+        return true;
+    }
+
+    void getReplayFrameTime(OSVR_TimeValue *timeOut) {
+        *timeOut = gReplayFrameTime;
+    }
+
+    bool replayUpdate(const ReplaySinks &sinks, OSVR_PoseState *headPoseOut, bool *hasHeadPoseOut) {
+        if (!gReplayFile) {
+            return false;
+        }
+        bool timed = gReplaySpeed > 0.0;
+        bool rewound = false;
+        while (true) {
+            if (!gReplayHasPending) {
+                if (fread(&gReplayPending, sizeof(gReplayPending), 1, gReplayFile) != 1) {
+                    // End of the recording. Loop at most once per update so an
+                    // empty recording can't spin.
+                    if (!gReplayLoop || rewound || !rewindReplay()) {
+                        return false;
+                    }
+                    rewound = true;
+                    continue;
+                }
+                gReplayHasPending = true;
+            }
+            const RecordHeader &header = gReplayPending;
+
+            int64_t recordUs = toMicroseconds(header.seconds, header.microseconds);
+            if (timed) {
+                uint64_t nowNs = frameStatsNowNs();
+                if (!gReplayHasBase) {
+                    gReplayBaseUs = recordUs;
+                    gReplayBaseNs = nowNs;
+                    gReplayHasBase = true;
+                }
+                double elapsedUs = (nowNs - gReplayBaseNs) / 1000.0 * gReplaySpeed;
+                if (recordUs - gReplayBaseUs > elapsedUs) {
+                    return true;
+                }
+            }
+            gReplayHasPending = false;
+
+            bool ok;
+            switch (header.type) {
+                case RECORD_FRAME:
+                    ok = readFrame(header, headPoseOut, hasHeadPoseOut);
+                    if (ok && !timed) {
+                        return true;
+                    }
+                    break;
+                case RECORD_INPUT:
+                    ok = readInput(header, sinks);
+                    break;
+                case RECORD_IMAGE:
+                    ok = readImage(header, sinks);
+                    break;
+                default:
+                    // Unknown (newer) record types are skipped.
+                    ok = fseek(gReplayFile, header.payloadBytes, SEEK_CUR) == 0;
+                    break;
+            }
+            if (!ok) {
+                LOGE("[Recording] Recording is truncated or corrupt, replay stopped.");
+                stopReplay();
+                return false;
+            }
+        }
+    }
+}
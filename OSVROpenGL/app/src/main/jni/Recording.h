@@ -0,0 +1,146 @@
+/*
+ * Copyright (C) 2015 Sensics, Inc. and contributors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef OSVROPENGL_RECORDING_H
+#define OSVROPENGL_RECORDING_H
+
+#include <cstddef>
+#include <cstdint>
+
+#include <osvr/ClientKit/InterfaceCallbackC.h>
+#include <osvr/ClientKit/ImagingC.h>
+
+#include "InputEventQueue.h"
+
+// Build with -DOSVROPENGL_HAVE_LZ4=1 (and link liblz4) to compress recorded
+// camera frames. Recordings with compressed frames can only be replayed by
+// builds that have LZ4 as well.
+#ifndef OSVROPENGL_HAVE_LZ4
+#define OSVROPENGL_HAVE_LZ4 0
+#endif
+
+namespace OSVROpenGL {
+
+    // Record/replay of everything the renderer gets from OSVR: imaging,
+    // button and location2D reports as they reach the callbacks, plus the head
+    // pose each frame rendered with. Replaying feeds the same reports back
+    // through the same callbacks and overrides RenderManager's head pose, so a
+    // benchmark run can be repeated exactly, on device or on the host build.
+    //
+    // The file is a 16 byte header followed by records, all in native byte
+    // order:
+    //
+    //   file header:    char magic[8] "OSVRREC1", uint32 version, uint32 chunk bytes
+    //   record header:  RecordHeader (24 bytes), then payloadBytes of payload
+    //     RECORD_FRAME        RecordedPose; flags RECORD_FLAG_HAS_POSE when the pose is valid
+    //     RECORD_INPUT        PackedInputEvent (button or location2D)
+    //     RECORD_IMAGE        RecordedImage, followed by chunkCount RECORD_IMAGE_CHUNK records
+    //     RECORD_IMAGE_CHUNK  RecordedImageChunk, then the (possibly compressed) bytes
+    //
+    // A frame's reports come before its RECORD_FRAME. All calls below must be
+    // made on the render thread, or while it is not running a frame.
+
+    static const uint32_t kRecordingVersion = 1;
+    static const uint32_t kRecordingChunkBytes = 64 * 1024;
+
+    enum RecordType {
+        RECORD_FRAME = 1,
+        RECORD_INPUT = 2,
+        RECORD_IMAGE = 3,
+        RECORD_IMAGE_CHUNK = 4
+    };
+
+    enum RecordFlags {
+        RECORD_FLAG_HAS_POSE = 1 << 0,      // RECORD_FRAME
+        RECORD_FLAG_LZ4 = 1 << 1            // RECORD_IMAGE_CHUNK
+    };
+
+    struct RecordHeader {
+        uint16_t type;          // RecordType
+        uint16_t flags;         // RecordFlags
+        uint32_t payloadBytes;
+        int64_t seconds;        // report or pose timestamp
+        int32_t microseconds;
+        uint32_t reserved;
+    };
+
+    struct RecordedPose {
+        double translation[3];
+        double rotation[4];     // w, x, y, z
+    };
+
+    struct RecordedImage {
+        uint32_t sensor;
+        uint32_t width;
+        uint32_t height;
+        uint8_t channels;
+        uint8_t depth;
+        uint16_t valueType;     // OSVR_ImagingValueType
+        uint32_t chunkCount;
+        uint32_t reserved;
+    };
+
+    struct RecordedImageChunk {
+        uint32_t rawBytes;      // size once decompressed
+        uint32_t storedBytes;   // size in the file
+    };
+
+    static_assert(sizeof(RecordHeader) == 24, "RecordHeader layout changed");
+    static_assert(sizeof(RecordedPose) == 56, "RecordedPose layout changed");
+    static_assert(sizeof(RecordedImage) == 24, "RecordedImage layout changed");
+    static_assert(sizeof(RecordedImageChunk) == 8, "RecordedImageChunk layout changed");
+
+    // Recording. compressImages is ignored without OSVROPENGL_HAVE_LZ4.
+    bool startRecording(const char *path, bool compressImages);
+    void stopRecording();
+    bool isRecording();
+
+    void recordImage(const OSVR_TimeValue *timestamp, const OSVR_ImagingReport *report);
+    void recordInputEvent(const PackedInputEvent &event);
+    // Ends the frame; headPose may be null when there is no head tracker.
+    void recordFrame(const OSVR_TimeValue *timestamp, const OSVR_PoseState *headPose);
+
+    // Where replayed reports are delivered.
+    struct ReplaySinks {
+        OSVR_ImagingCallback imaging;
+        void *imagingUserdata;
+        OSVR_ButtonCallback button;
+        OSVR_Location2DCallback location2D;
+        // userdata for the button/location2D callbacks of a given source
+        void *(*inputUserdata)(InputEventSource source);
+    };
+
+    // Replay. With speed <= 0, every replayUpdate() plays back exactly one
+    // recorded frame regardless of wall time, which makes runs deterministic;
+    // otherwise reports are released as the wall clock (scaled by speed)
+    // reaches their timestamps.
+    bool startReplay(const char *path, double speed, bool loop);
+    void stopReplay();
+    bool isReplaying();
+
+    // Stands in for osvrClientUpdate: delivers due reports through sinks, and
+    // sets *hasHeadPoseOut / *headPoseOut from the latest frame played. Image
+    // data handed to sinks.imaging is owned by the replayer and stays valid
+    // until the next replayUpdate(); it must not be passed to osvrClientFreeImage.
+    // Returns false once the recording has ended (and loop is off).
+    bool replayUpdate(const ReplaySinks &sinks, OSVR_PoseState *headPoseOut, bool *hasHeadPoseOut);
+
+    // The recorded time of the latest frame replayUpdate() played.
+    void getReplayFrameTime(OSVR_TimeValue *timeOut);
+}
+
+#endif // OSVROPENGL_RECORDING_H
@@ -0,0 +1,2482 @@
+/*
+ * Copyright (C) 2015 Sensics, Inc. and contributors
+ *
+ * Based on Android NDK samples, which are:
+ * Copyright (C) 2010 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <sstream>
+
+#include <dlfcn.h>
+
+//#include <boost/filesystem.hpp>
+
+//#define GL_GLEXT_PROTOTYPES 1
+#include <EGL/egl.h>
+#include <GLES2/gl2.h>
+#include <GLES2/gl2ext.h>
+
+#include <osvr/ClientKit/ContextC.h>
+#include <osvr/ClientKit/InterfaceC.h>
+#include <osvr/ClientKit/InterfaceStateC.h>
+#include <osvr/ClientKit/DisplayC.h>
+#include <osvr/ClientKit/InterfaceCallbackC.h>
+#include <osvr/ClientKit/ImagingC.h>
+#include <osvr/ClientKit/ServerAutoStartC.h>
+#include <osvr/Util/TimeValueC.h>
+#include <osvr/RenderKit/RenderManagerC.h>
+#include <osvr/RenderKit/RenderManagerOpenGLC.h>
+#include <osvr/RenderKit/RenderKitGraphicsTransforms.h>
+
+#include "Logging.h"
+#include "Renderer.h"
+#include "InputEventQueue.h"
+#include "FrameArena.h"
+#include "FrameStats.h"
+#include "FramePacer.h"
+#include "DistortionMesh.h"
+#include "CompressedTexture.h"
+#include "CpuDispatch.h"
+#include "SceneMesh.h"
+#include "EGLFence.h"
+#include "ExternalImage.h"
+#include "GLExtensions.h"
+#include "GpuMemory.h"
+#include "GpuProfiler.h"
+#include "Layers.h"
+#include "LatencyMonitor.h"
+#include "Lifecycle.h"
+#include "Materials.h"
+#include "Recording.h"
+#include "Reprojection.h"
+#include "Scene.h"
+#include "ThermalGovernor.h"
+#include "FrameCapture.h"
+#include "Trace.h"
+
+
+namespace OSVROpenGL {
+//    static PFNGLBINDVERTEXARRAYOESPROC bindVertexArrayOES;
+//
+//    void initializeGLES2Ext()
+//    {
+//        void *lh = dlopen("libGLESv2.so", RTLD_LAZY);
+//        bindVertexArrayOES = (PFNGLBINDVERTEXARRAYOESPROC)dlsym(lh, "glBindVertexArrayOES");
+//    }
+
+    inline osvr::renderkit::OSVR_ProjectionMatrix ConvertProjectionMatrix(::OSVR_ProjectionMatrix matrix)
+    {
+        osvr::renderkit::OSVR_ProjectionMatrix ret = { 0 };
+        ret.bottom = matrix.bottom;
+        ret.top = matrix.top;
+        ret.left = matrix.left;
+        ret.right = matrix.right;
+        ret.nearClip = matrix.nearClip;
+        ret.farClip = matrix.farClip;
+        return ret;
+    }
+
+    static void checkReturnCode(OSVR_ReturnCode returnCode, const char *msg) {
+        if (returnCode != OSVR_RETURN_SUCCESS) {
+            LOGI("[OSVR] OSVR method returned a failure: %s", msg);
+            throw std::runtime_error(msg);
+        }
+    }
+
+    // RAII wrapper around the RenderManager collection APIs for OpenGL
+    class RenderInfoCollectionOpenGL {
+        private:
+            OSVR_RenderManager mRenderManager = nullptr;
+            OSVR_RenderInfoCollection mRenderInfoCollection = nullptr;
+            OSVR_RenderParams mRenderParams = {0};
+            OSVR_RenderInfoCount mNumRenderInfo = 0;
+
+        public:
+        RenderInfoCollectionOpenGL(OSVR_RenderManager renderManager, OSVR_RenderParams renderParams)
+            : mRenderManager(renderManager), mRenderParams(renderParams) {
+            OSVR_ReturnCode rc;
+            rc = osvrRenderManagerGetRenderInfoCollection(mRenderManager, mRenderParams, &mRenderInfoCollection);
+            checkReturnCode(rc, "osvrRenderManagerGetRenderInfoCollection call failed.");
+            // a collection never changes size, so ask once rather than per lookup
+            rc = osvrRenderManagerGetNumRenderInfoInCollection(mRenderInfoCollection, &mNumRenderInfo);
+            checkReturnCode(rc, "osvrRenderManagerGetNumRenderInfoInCollection call failed.");
+        }
+
+        OSVR_RenderInfoCount getNumRenderInfo() const {
+            return mNumRenderInfo;
+        }
+
+        OSVR_RenderInfoOpenGL getRenderInfo(OSVR_RenderInfoCount index) {
+            if(index < 0 || index >= mNumRenderInfo) {
+                const static char* err = "getRenderInfo called with invalid index";
+                LOGE(err);
+                throw std::runtime_error(err);
+            }
+            OSVR_RenderInfoOpenGL ret;
+            OSVR_ReturnCode rc;
+            rc = osvrRenderManagerGetRenderInfoFromCollectionOpenGL(mRenderInfoCollection, index, &ret);
+            checkReturnCode(rc, "osvrRenderManagerGetRenderInfoFromCollectionOpenGL call failed.");
+            return ret;
+        }
+
+        ~RenderInfoCollectionOpenGL() {
+            if(mRenderInfoCollection) {
+                osvrRenderManagerReleaseRenderInfoCollection(mRenderInfoCollection);
+            }
+        }
+    };
+
+    typedef struct OSVR_RenderTargetInfo {
+        GLuint colorBufferName;
+        GLuint depthBufferName;
+        GLuint frameBufferName;
+        GLuint renderBufferName; // @todo - do we need this?
+        OSVR_RenderBufferOpenGL presentBuffer; // what gets handed to present each frame
+        GLsizei width;
+        GLsizei height;
+    } OSVR_RenderTargetInfo;
+
+    static const char gVertexShader[] =
+            "uniform mat4 model;\n"
+                    "uniform mat4 view;\n"
+                    "uniform mat4 projection;\n"
+                    "uniform vec3 positionScale;\n"
+                    "uniform vec3 positionOffset;\n"
+                    "attribute vec4 vPosition;\n"
+                    "attribute vec4 vColor;\n"
+                    "attribute vec2 vTexCoordinate;\n"
+                    "varying vec2 texCoordinate;\n"
+                    "varying vec4 fragmentColor;\n"
+                    "void main() {\n"
+                    "  vec4 position = vec4(vPosition.xyz * positionScale + positionOffset, vPosition.w);\n"
+                    "  gl_Position = projection * view * model * position;\n"
+                    "  fragmentColor = vColor;\n"
+                    "  texCoordinate = vTexCoordinate;\n"
+                    "}\n";
+
+    static const char gFragmentShader[] =
+            "precision mediump float;\n"
+                    "uniform sampler2D uTexture;\n"
+                    "varying vec2 texCoordinate;\n"
+                    "varying vec4 fragmentColor;\n"
+                    "void main()\n"
+                    "{\n"
+                    "    gl_FragColor = fragmentColor * texture2D(uTexture, texCoordinate);\n"
+                    //"    gl_FragColor = texture2D(uTexture, texCoordinate);\n"
+                    "}\n";
+
+    // GLES globals
+    static int gWidth = 0;
+    static int gHeight = 0;
+    static GLuint gProgram;
+    static GLuint gvPositionHandle;
+    static GLuint gvColorHandle;
+    static GLuint gvTexCoordinateHandle;
+    static GLuint guTextureUniformId;
+    static GLuint gvProjectionUniformId;
+    static GLuint gvViewUniformId;
+    static GLuint gvModelUniformId;
+    static GLuint gTextureID;
+    static std::string gSceneTexturePath;
+    static GLuint gSceneTexture = 0;    // drawn instead of gTextureID when there is one
+    static GLuint gWhiteTexture = 0;    // on the cubes while the camera feed is a layer
+    // setCameraLayerEnabled; the camera feed goes on a head-locked quad layer
+    // (see Layers.h) instead of the cubes.
+    static const uint32_t kCameraLayer = 0;
+    static const float kCameraLayerDistance = 1.5f;  // meters
+    static const float kCameraLayerWidth = 1.6f;
+    static std::atomic<bool> gCameraLayerEnabled(false);
+    static std::atomic<bool> gCameraLayerShown(false);
+    static std::atomic<uint32_t> gCameraTextureWidth(0);
+    static std::atomic<uint32_t> gCameraTextureHeight(0);
+    // the newest frame from kCameraImageStream on the layer; once there is one,
+    // the OSVR imaging reports are no longer uploaded
+    static std::atomic<uint64_t> gCameraImageFrameNumber(0);
+    static GLint gMaxVertexAttribs = 0;
+    static bool gGraphicsInitializedOnce = false; // if setupGraphics has been called at least once
+
+    // OSVR globals
+    static bool gOSVRInitialized = false;
+    static bool gRenderManagerInitialized = false;
+    //static OSVR_DisplayConfig gOSVRDisplayConfig;
+    static OSVR_ClientContext gClientContext = NULL;
+    static OSVR_ClientInterface gCamera = NULL;
+    static OSVR_ClientInterface gHead = NULL;
+
+    static OSVR_ClientInterface gLeftButton = NULL;
+    static OSVR_ClientInterface gRightButton = NULL;
+    static OSVR_ClientInterface gUpButton = NULL;
+    static OSVR_ClientInterface gDownButton = NULL;
+    static OSVR_ClientInterface gCenterButton = NULL;
+    static OSVR_ClientInterface gBackButton = NULL;
+    static OSVR_ClientInterface gVolumeUpButton = NULL;
+    static OSVR_ClientInterface gVolumeDownButton = NULL;
+
+    static OSVR_ClientInterface gMouseLocation2D = NULL;
+
+    static int gReportNumber = 0;
+    // Camera frames arrive on the thread updating the client and are uploaded
+    // there, or on the app thread when async reprojection is on and the feed
+    // is on the cubes.
+    static std::mutex gCameraFrameMutex;
+    static OSVR_ImageBufferElement *gLastFrame = nullptr;
+    static GLuint gLastFrameWidth = 0;
+    static GLuint gLastFrameHeight = 0;
+    static GLuint gLastFrameChannels = 0;
+    // Grey and RGB frames expanded to RGBA for uploading; only ever grows.
+    static std::vector<GLubyte> gCameraRGBA;
+    // Frames the app thread has uploaded, waiting for the client thread to
+    // free them: the client context is only ever touched from one thread.
+    static const int kMaxUploadedCameraFrames = 4;
+    static OSVR_ImageBufferElement *gUploadedCameraFrames[kMaxUploadedCameraFrames];
+    static int gUploadedCameraFrameCount = 0;
+    // Replayed frames only last until the next replayUpdate(), which the
+    // client thread may make while the app thread is still uploading one, so
+    // the app thread gets copies: one can be waiting, one uploading and the
+    // rest waiting to be freed. Each copy only ever grows.
+    static const int kReplayedCameraFrameCopies = kMaxUploadedCameraFrames + 2;
+    static std::vector<GLubyte> gReplayedCameraFrameCopies[kReplayedCameraFrameCopies];
+    static bool gReplayedCameraFrameCopyUsed[kReplayedCameraFrameCopies];
+    static GLubyte *gTextureBuffer = nullptr;
+    OSVR_GraphicsLibraryOpenGL gGraphicsLibrary = {0};
+    OSVR_RenderManager gRenderManager = nullptr;
+    OSVR_RenderManagerOpenGL gRenderManagerOGL = nullptr;
+    OSVR_RenderParams gRenderParams = {0};
+    // Params every frame starts from; only the replayed head pose changes per frame.
+    static OSVR_RenderParams gFrameRenderParams = {0};
+
+    // Async reprojection (see Reprojection.h) needs more eye buffers than the
+    // synchronous path: sets 0 and 1 are the app thread's double buffer, and
+    // set 2 is where the GL thread rotates an old frame to the new pose. Set 0
+    // is also the synchronous path's, and the only one made while async
+    // reprojection is off. RenderManager only takes buffers once, so switching
+    // it makes a new RenderManager with the other sets registered.
+    static const size_t kReprojectionRenderTargetSets = 3;
+    static const int kAppFrameSets = 2;
+    static const size_t kReprojectionTargetSet = 2;
+
+    std::vector<OSVR_RenderTargetInfo> gRenderTargets;   // set by set, eye by eye
+    static size_t gRenderTargetSets = 0;
+    static size_t gEyeCount = 0;
+    GLuint gFrameBuffer;
+
+    static const OSVR_RenderTargetInfo &renderTarget(size_t set, size_t eye) {
+        return gRenderTargets[set * gEyeCount + eye];
+    }
+
+    // A finished app frame in one of the app's render target sets, with what
+    // it was drawn with.
+    struct AppFrame {
+        EGLFence fence;                 // signals when the GPU is done with it
+        float renderScale;              // of the eye buffers drawn into
+        OSVR_RenderInfoCount eyeCount;
+        OSVR_RenderInfoOpenGL renderInfos[kSceneMaxViews];
+        SceneView views[kSceneMaxViews];
+    };
+
+    // Shared between the GL thread (the display side) and the app thread, under gAppMutex.
+    static std::mutex gAppMutex;
+    static std::condition_variable gAppCondition;
+    static bool gAppThreadStopping = false;
+    static AppFrame gAppFrames[kAppFrameSets];
+    static int gNewestAppFrame = -1;        // set of the newest finished frame
+    static int gDisplayedAppFrame = -1;     // set the display side is showing
+    static EGLFence gReleaseFences[kAppFrameSets]; // the display side's last use of a set
+    static OSVR_RenderInfoOpenGL gLatestRenderInfos[kSceneMaxViews];
+    static OSVR_RenderInfoCount gLatestEyeCount = 0;
+
+    // GL thread only
+    static std::thread gAppThread;
+    static bool gAppThreadRunning = false;
+    static bool gAsyncReprojectionUnavailable = false;
+    static std::atomic<bool> gAppThreadFailed(false);
+    static bool gReprojectionPassReady = false;
+    static SharedGLContext gAppContext;
+
+    // App thread only; framebuffer objects aren't shared between contexts.
+    static GLuint gAppFrameBuffers[kAppFrameSets][kSceneMaxViews];
+
+    // How long the app thread waits for the display side to let go of a set
+    // before drawing over it anyway.
+    static const uint64_t kReleaseFenceTimeoutNs = 100000000ull;
+
+    // setSimulatedFrameDelay
+    static std::atomic<uint32_t> gSimulatedDelayMs(0);
+    static std::atomic<uint32_t> gSimulatedDelayEveryNFrames(1);
+    static uint32_t gSimulatedDelayFrame = 0;
+
+    // Scratch memory for the current frame, reset at the start of renderFrame.
+    static FrameArena<16 * 1024> gFrameArena;
+
+    // Button and location2D reports waiting to be handed to Java, drained once per frame.
+    static InputEventRing<256> gInputEvents;
+
+    // Head pose of the frame being replayed, when replaying a recording.
+    static OSVR_PoseState gReplayHeadPose;
+    static bool gHasReplayHeadPose = false;
+
+    // What the thermal governor's quality tier (see ThermalGovernor.h) turns
+    // down, for the next frame. The scene is drawn into the renderScale by
+    // renderScale corner of each eye buffer, at its origin, and only that
+    // part is presented.
+    static std::atomic<float> gRenderScale(1.0f);
+    static std::atomic<uint32_t> gCameraUploadInterval(1);
+    static uint32_t gFramesSinceCameraUpload = 0;   // on the thread drawing the scene
+    static std::atomic<uint64_t> gLastAppFrameNs(0);
+
+    // EXT_multisampled_render_to_texture: the eye buffers are drawn with MSAA
+    // that is resolved into their textures as the GPU writes its tiles out,
+    // so there are no multisampled buffers to resolve by hand.
+    typedef void (GL_APIENTRY *FramebufferTexture2DMultisampleFn)(GLenum target, GLenum attachment,
+                                                                  GLenum textarget, GLuint texture,
+                                                                  GLint level, GLsizei samples);
+    typedef void (GL_APIENTRY *RenderbufferStorageMultisampleFn)(GLenum target, GLsizei samples,
+                                                                 GLenum internalformat, GLsizei width,
+                                                                 GLsizei height);
+    static FramebufferTexture2DMultisampleFn gFramebufferTexture2DMultisample = nullptr;
+    static RenderbufferStorageMultisampleFn gRenderbufferStorageMultisample = nullptr;
+    static GLint gMaxEyeBufferSamples = 1;
+    static std::atomic<int> gRequestedEyeBufferSamples(1);
+    static std::atomic<int> gEyeBufferSampleCap(1);
+    static int gEyeBufferSamples = 1;   // what the eye buffers have; GL thread, or the app thread it started
+
+    static void printGLString(const char *name, GLenum s) {
+        const char *v = (const char *) glGetString(s);
+        LOGI("GL %s = %s\n", name, v);
+    }
+
+    // gluErrorString without glu
+    static const char *glErrorString(GLenum error) {
+        switch(error) {
+            case GL_NO_ERROR: return "GL_NO_ERROR";
+            case GL_INVALID_ENUM: return "GL_INVALID_ENUM";
+            case GL_INVALID_VALUE: return "GL_INVALID_VALUE";
+            case GL_INVALID_OPERATION: return "GL_INVALID_OPERATION";
+            case GL_INVALID_FRAMEBUFFER_OPERATION: return "GL_INVALID_FRAMEBUFFER_OPERATION";
+            case GL_OUT_OF_MEMORY: return "GL_OUT_OF_MEMORY";
+            default: return "(unknown error)";
+        }
+    }
+
+    static void checkGlError(const char *op) {
+        for (GLenum error = glGetError(); error; error = glGetError()) {
+            LOGI("after %s() glError (%s)\n", op, glErrorString(error));
+            if (error == GL_OUT_OF_MEMORY) {
+                noteGpuOutOfMemory();
+            }
+        }
+    }
+
+
+    class PassThroughOpenGLContextImpl {
+        OSVR_OpenGLToolkitFunctions toolkit;
+        int mWidth;
+        int mHeight;
+
+        static void createImpl(void* data) {
+        }
+        static void destroyImpl(void* data) {
+            delete ((PassThroughOpenGLContextImpl*)data);
+        }
+        static OSVR_CBool addOpenGLContextImpl(void* data, const OSVR_OpenGLContextParams* p) {
+            return ((PassThroughOpenGLContextImpl*)data)->addOpenGLContext(p);
+        }
+        static OSVR_CBool removeOpenGLContextsImpl(void* data) {
+            return ((PassThroughOpenGLContextImpl*)data)->removeOpenGLContexts();
+        }
+        static OSVR_CBool makeCurrentImpl(void* data, size_t display) {
+            return ((PassThroughOpenGLContextImpl*)data)->makeCurrent(display);
+        }
+        static OSVR_CBool swapBuffersImpl(void* data, size_t display) {
+            return ((PassThroughOpenGLContextImpl*)data)->swapBuffers(display);
+        }
+        static OSVR_CBool setVerticalSyncImpl(void* data, OSVR_CBool verticalSync) {
+            return ((PassThroughOpenGLContextImpl*)data)->setVerticalSync(verticalSync);
+        }
+        static OSVR_CBool handleEventsImpl(void* data) {
+            return ((PassThroughOpenGLContextImpl*)data)->handleEvents();
+        }
+        static OSVR_CBool getDisplayFrameBufferImpl(void* data, size_t display, GLuint* displayFrameBufferOut) {
+            return ((PassThroughOpenGLContextImpl*)data)->getDisplayFrameBuffer(display, displayFrameBufferOut);
+        }
+        static OSVR_CBool getDisplaySizeOverrideImpl(void* data, size_t display, int* width, int* height) {
+            return ((PassThroughOpenGLContextImpl*)data)->getDisplaySizeOverride(display, width, height);
+        }
+
+
+    public:
+        PassThroughOpenGLContextImpl() {
+            memset(&toolkit, 0, sizeof(toolkit));
+            toolkit.size = sizeof(toolkit);
+            toolkit.data = this;
+
+            toolkit.create = createImpl;
+            toolkit.destroy = destroyImpl;
+            toolkit.addOpenGLContext = addOpenGLContextImpl;
+            toolkit.removeOpenGLContexts = removeOpenGLContextsImpl;
+            toolkit.makeCurrent = makeCurrentImpl;
+            toolkit.swapBuffers = swapBuffersImpl;
+            toolkit.setVerticalSync = setVerticalSyncImpl;
+            toolkit.handleEvents = handleEventsImpl;
+            toolkit.getDisplaySizeOverride = getDisplaySizeOverrideImpl;
+            toolkit.getDisplayFrameBuffer = getDisplayFrameBufferImpl;
+        }
+
+        ~PassThroughOpenGLContextImpl() {
+        }
+
+        const OSVR_OpenGLToolkitFunctions* getToolkit() const { return &toolkit; }
+
+        bool addOpenGLContext(const OSVR_OpenGLContextParams* p) {
+            return true;
+        }
+
+        bool removeOpenGLContexts() {
+            return true;
+        }
+
+        bool makeCurrent(size_t display) {
+            return true;
+        }
+
+        bool swapBuffers(size_t display) {
+            return true;
+        }
+
+        bool setVerticalSync(bool verticalSync) {
+            return true;
+        }
+
+        bool handleEvents() {
+            return true;
+        }
+        bool getDisplayFrameBuffer(size_t display, GLuint* displayFrameBufferOut) {
+            *displayFrameBufferOut = gFrameBuffer;
+            return true;
+        }
+
+        bool getDisplaySizeOverride(size_t display, int* width, int* height) {
+            *width = gWidth;
+            *height = gHeight;
+            return false;
+        }
+    };
+
+    static GLuint loadShader(GLenum shaderType, const char *pSource) {
+        GLuint shader = glCreateShader(shaderType);
+        if (shader) {
+            glShaderSource(shader, 1, &pSource, NULL);
+            glCompileShader(shader);
+            GLint compiled = 0;
+            glGetShaderiv(shader, GL_COMPILE_STATUS, &compiled);
+            if (!compiled) {
+                GLint infoLen = 0;
+                glGetShaderiv(shader, GL_INFO_LOG_LENGTH, &infoLen);
+                if (infoLen) {
+                    char *buf = (char *) malloc(infoLen);
+                    if (buf) {
+                        glGetShaderInfoLog(shader, infoLen, NULL, buf);
+                        LOGE("Could not compile shader %d:\n%s\n",
+                             shaderType, buf);
+                        free(buf);
+                    }
+                    glDeleteShader(shader);
+                    shader = 0;
+                }
+            }
+        }
+        return shader;
+    }
+
+    static GLuint createProgram(const char *pVertexSource, const char *pFragmentSource) {
+        GLuint vertexShader = loadShader(GL_VERTEX_SHADER, pVertexSource);
+        if (!vertexShader) {
+            return 0;
+        }
+
+        GLuint pixelShader = loadShader(GL_FRAGMENT_SHADER, pFragmentSource);
+        if (!pixelShader) {
+            return 0;
+        }
+
+        GLuint program = glCreateProgram();
+        if (program) {
+            glAttachShader(program, vertexShader);
+            checkGlError("glAttachShader");
+
+            glAttachShader(program, pixelShader);
+            checkGlError("glAttachShader");
+
+            glBindAttribLocation(program, 0, "vPosition");
+            glBindAttribLocation(program, 1, "vColor");
+            glBindAttribLocation(program, 2, "vTexCoordinate");
+
+            glLinkProgram(program);
+            GLint linkStatus = GL_FALSE;
+            glGetProgramiv(program, GL_LINK_STATUS, &linkStatus);
+            if (linkStatus != GL_TRUE) {
+                GLint bufLength = 0;
+                glGetProgramiv(program, GL_INFO_LOG_LENGTH, &bufLength);
+                if (bufLength) {
+                    char *buf = (char *) malloc(bufLength);
+                    if (buf) {
+                        glGetProgramInfoLog(program, bufLength, NULL, buf);
+                        LOGE("Could not link program:\n%s\n", buf);
+                        free(buf);
+                    }
+                }
+                glDeleteProgram(program);
+                program = 0;
+            }
+        }
+        return program;
+    }
+
+    static GLuint createTexture(GLuint width, GLuint height) {
+        GLuint ret;
+        glGenTextures(1, &ret);
+        checkGlError("glGenTextures");
+
+        glBindTexture(GL_TEXTURE_2D, ret);
+        checkGlError("glBindTexture");
+
+        glPixelStorei(GL_PACK_ALIGNMENT, 1);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+//    // DEBUG CODE - should be passing null here, but then texture is always black.
+        GLubyte *dummyBuffer = new GLubyte[width * height * 4];
+        for (GLuint i = 0; i < width * height * 4; i++) {
+            dummyBuffer[i] = (i % 4 ? 100 : 255);
+        }
+
+        // This dummy texture successfully makes it into the texture and renders, but subsequent
+        // calls to glTexSubImage2D don't appear to do anything.
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE,
+                     dummyBuffer);
+        checkGlError("glTexImage2D");
+        delete[] dummyBuffer;
+        trackGpuObject(GPU_OBJECT_TEXTURE, ret, GPU_MEMORY_TEXTURES, static_cast<uint64_t>(width) * height * 4);
+
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        checkGlError("glTexParameteri");
+
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        checkGlError("glTexParameteri");
+        return ret;
+    }
+
+    static void updateTexture(GLuint width, GLuint height, GLuint channels, const GLubyte *data) {
+        if (gCameraImageFrameNumber.load(std::memory_order_relaxed)) {
+            return;
+        }
+        if (channels == 1 || channels == 3) {
+            size_t size = static_cast<size_t>(width) * height * 4;
+            if (gCameraRGBA.size() < size) {
+                gCameraRGBA.resize(size);
+            }
+            cpuKernels().expandToRGBA(data, width * height, channels, gCameraRGBA.data());
+            data = gCameraRGBA.data();
+        }
+
+        glBindTexture(GL_TEXTURE_2D, gTextureID);
+        checkGlError("glBindTexture");
+
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+        glPixelStorei(GL_PACK_ALIGNMENT, 1);
+
+        // @todo use glTexSubImage2D to be faster here, but add check to make sure height/width are the same.
+        //glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, data);
+        //checkGlError("glTexSubImage2D");
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, data);
+        checkGlError("glTexImage2D");
+        trackGpuObject(GPU_OBJECT_TEXTURE, gTextureID, GPU_MEMORY_TEXTURES, static_cast<uint64_t>(width) * height * 4);
+        gCameraTextureWidth.store(width, std::memory_order_relaxed);
+        gCameraTextureHeight.store(height, std::memory_order_relaxed);
+        if (gCameraLayerShown.load(std::memory_order_relaxed)) {
+            quadLayerContentChanged(kCameraLayer);
+        }
+    }
+
+    // With gCameraFrameMutex held. Null when every copy is still in use.
+    static OSVR_ImageBufferElement *copyReplayedCameraFrame(const OSVR_ImageBufferElement *frame, size_t bytes) {
+        for (int i = 0; i < kReplayedCameraFrameCopies; i++) {
+            if (!gReplayedCameraFrameCopyUsed[i]) {
+                std::vector<GLubyte> &copy = gReplayedCameraFrameCopies[i];
+                if (copy.size() < bytes) {
+                    copy.resize(bytes);
+                }
+                memcpy(copy.data(), frame, bytes);
+                gReplayedCameraFrameCopyUsed[i] = true;
+                return copy.data();
+            }
+        }
+        return nullptr;
+    }
+
+    // With gCameraFrameMutex held.
+    static void freeCameraFrameLocked(OSVR_ImageBufferElement *frame) {
+        for (int i = 0; i < kReplayedCameraFrameCopies; i++) {
+            if (gReplayedCameraFrameCopyUsed[i] && frame == gReplayedCameraFrameCopies[i].data()) {
+                gReplayedCameraFrameCopyUsed[i] = false;
+                return;
+            }
+        }
+        // other replayed frames belong to the replayer
+        if (!isReplaying()) {
+            osvrClientFreeImage(gClientContext, frame);
+        }
+    }
+
+    // On the client thread.
+    static void freeCameraFrame(OSVR_ImageBufferElement *frame) {
+        std::lock_guard<std::mutex> lock(gCameraFrameMutex);
+        freeCameraFrameLocked(frame);
+    }
+
+    static void imagingCallback(void *userdata, const OSVR_TimeValue *timestamp,
+                                const OSVR_ImagingReport *report) {
+        OSVR_TRACE_SCOPE("imagingCallback");
+
+        OSVR_ClientContext *ctx = (OSVR_ClientContext *) userdata;
+
+        gReportNumber++;
+        GLuint width = report->state.metadata.width;
+        GLuint height = report->state.metadata.height;
+        GLuint size = width * height * 4;
+
+        recordImage(timestamp, report);
+        std::lock_guard<std::mutex> lock(gCameraFrameMutex);
+        OSVR_ImageBufferElement *frame = report->state.data;
+        if (isReplaying() && gAppThreadRunning) {
+            size_t bytes = static_cast<size_t>(width) * height * report->state.metadata.channels *
+                           report->state.metadata.depth;
+            frame = copyReplayedCameraFrame(frame, bytes);
+            if (!frame) {
+                return;
+            }
+        }
+        gLastFrameWidth = width;
+        gLastFrameHeight = height;
+        gLastFrameChannels = report->state.metadata.channels;
+        // only the newest frame gets uploaded; one that was never picked up is done with
+        if (gLastFrame) {
+            freeCameraFrameLocked(gLastFrame);
+        }
+        gLastFrame = frame;
+    }
+
+    // Takes the newest camera frame for uploading, if there is one and the
+    // quality tier has one uploaded this frame.
+    static bool takeCameraFrame(OSVR_ImageBufferElement **frameOut, GLuint *widthOut, GLuint *heightOut,
+                                GLuint *channelsOut) {
+        if (++gFramesSinceCameraUpload < gCameraUploadInterval.load(std::memory_order_relaxed)) {
+            return false;
+        }
+        std::lock_guard<std::mutex> lock(gCameraFrameMutex);
+        if (!gLastFrame) {
+            return false;
+        }
+        gFramesSinceCameraUpload = 0;
+        *frameOut = gLastFrame;
+        *widthOut = gLastFrameWidth;
+        *heightOut = gLastFrameHeight;
+        *channelsOut = gLastFrameChannels;
+        gLastFrame = nullptr;
+        return true;
+    }
+
+    // Done with a frame on the app thread; freeUploadedCameraFrames() frees it.
+    static void releaseUploadedCameraFrame(OSVR_ImageBufferElement *frame) {
+        std::lock_guard<std::mutex> lock(gCameraFrameMutex);
+        if (gUploadedCameraFrameCount < kMaxUploadedCameraFrames) {
+            gUploadedCameraFrames[gUploadedCameraFrameCount++] = frame;
+        } else {
+            LOGE("[Reprojection] Camera frames are not being freed; leaking one.");
+        }
+    }
+
+    // On the client thread.
+    static void freeUploadedCameraFrames() {
+        std::lock_guard<std::mutex> lock(gCameraFrameMutex);
+        for (int i = 0; i < gUploadedCameraFrameCount; i++) {
+            freeCameraFrameLocked(gUploadedCameraFrames[i]);
+        }
+        gUploadedCameraFrameCount = 0;
+    }
+
+    static void buttonCallback(void *userdata, const OSVR_TimeValue *timestamp, const OSVR_ButtonReport *report) {
+        OSVR_TRACE_SCOPE("buttonCallback");
+        PackedInputEvent event = {0};
+        event.type = INPUT_EVENT_BUTTON;
+        event.source = static_cast<uint16_t>(reinterpret_cast<intptr_t>(userdata));
+        event.sensor = static_cast<uint32_t>(report->sensor);
+        event.seconds = timestamp->seconds;
+        event.microseconds = timestamp->microseconds;
+        event.buttonState = report->state;
+        recordInputEvent(event);
+        gInputEvents.push(event);
+    }
+
+    static void location2DCallback(void *userdata, const OSVR_TimeValue *timestamp, const OSVR_Location2DReport *report) {
+        OSVR_TRACE_SCOPE("location2DCallback");
+        PackedInputEvent event = {0};
+        event.type = INPUT_EVENT_LOCATION2D;
+        event.source = static_cast<uint16_t>(reinterpret_cast<intptr_t>(userdata));
+        event.sensor = static_cast<uint32_t>(report->sensor);
+        event.seconds = timestamp->seconds;
+        event.microseconds = timestamp->microseconds;
+        event.x = report->location.data[0];
+        event.y = report->location.data[1];
+        recordInputEvent(event);
+        gInputEvents.push(event);
+    }
+
+    // Userdata for the button/location2D callbacks, identifying the source interface.
+    static void *inputSourceUserdata(InputEventSource source) {
+        return reinterpret_cast<void *>(static_cast<intptr_t>(source));
+    }
+
+    // Replayed reports go through the same callbacks as live ones.
+    static const ReplaySinks gReplaySinks = {
+            imagingCallback, &gClientContext, buttonCallback, location2DCallback, inputSourceUserdata
+    };
+
+    // Stands in for osvrClientUpdate while replaying.
+    static void updateClient() {
+        if (isReplaying()) {
+            replayUpdate(gReplaySinks, &gReplayHeadPose, &gHasReplayHeadPose);
+            return;
+        }
+        gHasReplayHeadPose = false;
+        osvrClientUpdate(gClientContext);
+    }
+
+    // Ends the frame in the recording, with the head pose it renders with.
+    static void recordFramePose() {
+        if (!isRecording()) {
+            return;
+        }
+        OSVR_TimeValue timestamp = {0};
+        OSVR_PoseState pose;
+        const OSVR_PoseState *headPose = nullptr;
+        if (gHasReplayHeadPose) {
+            headPose = &gReplayHeadPose;
+        } else if (gHead && osvrGetPoseState(gHead, &timestamp, &pose) == OSVR_RETURN_SUCCESS) {
+            headPose = &pose;
+        }
+        // Timed replay paces frames by their time, so every frame gets one:
+        // while replaying the played frame's, in step with the replayed
+        // reports, and otherwise the clock's when there is no pose.
+        if (isReplaying()) {
+            getReplayFrameTime(&timestamp);
+        } else if (!headPose) {
+            osvrTimeValueGetNow(&timestamp);
+        }
+        recordFrame(&timestamp, headPose);
+    }
+
+    // Tags the frame with the head pose it renders with, for the latency stats.
+    static void consumeLatencyPose() {
+        if (!isLatencyMeasurementEnabled()) {
+            return;
+        }
+        OSVR_TimeValue timestamp;
+        OSVR_PoseState pose;
+        if (gHasReplayHeadPose) {
+            // a replayed pose is as old as the recording, so only count from here
+            latencyPoseConsumed(nullptr, &gReplayHeadPose);
+        } else if (gHead && osvrGetPoseState(gHead, &timestamp, &pose) == OSVR_RETURN_SUCCESS) {
+            latencyPoseConsumed(&timestamp, &pose);
+        } else {
+            latencyPoseConsumed(nullptr, nullptr);
+        }
+    }
+
+    // Lights a corner of the eye's viewport while the head is turning, so a
+    // photodiode on the display can time motion to photons.
+    static void drawLatencyTestPattern(const OSVR_ViewportDescription &viewport) {
+        const GLsizei patchSize = 64;
+        GLfloat level = latencyFlashActive() ? 1.0f : 0.0f;
+        glEnable(GL_SCISSOR_TEST);
+        glScissor(static_cast<GLint>(viewport.left),
+                  static_cast<GLint>(viewport.lower + viewport.height) - patchSize,
+                  patchSize, patchSize);
+        glClearColor(level, level, level, 1.0f);
+        glClear(GL_COLOR_BUFFER_BIT);
+        glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+        glDisable(GL_SCISSOR_TEST);
+    }
+
+    // Copies pending input events into the (direct) buffer provided by Java.
+    // Returns the number of events written; anything that didn't fit stays queued.
+    int drainInputEvents(void *buffer, size_t bufferBytes) {
+        if (!buffer) {
+            return 0;
+        }
+        return static_cast<int>(gInputEvents.drainTo(buffer, bufferBytes));
+    }
+
+    // Looks up EXT_multisampled_render_to_texture; the eye buffers start out
+    // without MSAA. Call with the context current.
+    static void initEyeBufferSamples() {
+        gEyeBufferSamples = 1;
+        gMaxEyeBufferSamples = 1;
+        if (!hasGLExtension("GL_EXT_multisampled_render_to_texture")) {
+            return;
+        }
+        gFramebufferTexture2DMultisample = (FramebufferTexture2DMultisampleFn)
+                eglGetProcAddress("glFramebufferTexture2DMultisampleEXT");
+        gRenderbufferStorageMultisample = (RenderbufferStorageMultisampleFn)
+                eglGetProcAddress("glRenderbufferStorageMultisampleEXT");
+        if (gFramebufferTexture2DMultisample && gRenderbufferStorageMultisample) {
+            glGetIntegerv(GL_MAX_SAMPLES_EXT, &gMaxEyeBufferSamples);
+        }
+    }
+
+    // Attaches an eye buffer's texture and depth buffer to frameBuffer, which
+    // may belong to another context than the target's own.
+    static void attachEyeBuffer(GLuint frameBuffer, const OSVR_RenderTargetInfo &target, int samples) {
+        glBindFramebuffer(GL_FRAMEBUFFER, frameBuffer);
+        if (samples > 1) {
+            gFramebufferTexture2DMultisample(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D,
+                                             target.colorBufferName, 0, samples);
+        } else {
+            glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, target.colorBufferName, 0);
+        }
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, target.renderBufferName);
+    }
+
+    static size_t wantedRenderTargetSets() {
+        return isAsyncReprojectionEnabled() && !gAsyncReprojectionUnavailable ? kReprojectionRenderTargetSets : 1;
+    }
+
+    static bool setupRenderTextures(OSVR_RenderManager renderManager) {
+        initEyeBufferSamples();
+        try {
+            OSVR_ReturnCode rc;
+            rc = osvrRenderManagerGetDefaultRenderParams(&gRenderParams);
+            checkReturnCode(rc, "osvrRenderManagerGetDefaultRenderParams call failed.");
+
+            gRenderParams.farClipDistanceMeters = 1000000.0f;
+            gRenderParams.nearClipDistanceMeters = 0.0000001f;
+            RenderInfoCollectionOpenGL renderInfo(renderManager, gRenderParams);
+
+            OSVR_RenderManagerRegisterBufferState state;
+            rc = osvrRenderManagerStartRegisterRenderBuffers(&state);
+            checkReturnCode(rc, "osvrRenderManagerStartRegisterRenderBuffers call failed.");
+
+            // set 0 (the synchronous path's) first
+            size_t sets = wantedRenderTargetSets();
+            gEyeCount = renderInfo.getNumRenderInfo();
+            for (size_t set = 0; set < sets; set++) {
+                for (OSVR_RenderInfoCount i = 0; i < renderInfo.getNumRenderInfo(); i++) {
+                    OSVR_RenderInfoOpenGL currentRenderInfo = renderInfo.getRenderInfo(i);
+
+                    // Determine the appropriate size for the frame buffer to be used for
+                    // all eyes when placed horizontally size by side.
+                    int width = static_cast<int>(currentRenderInfo.viewport.width);
+                    int height = static_cast<int>(currentRenderInfo.viewport.height);
+
+                    GLuint frameBufferName = 0;
+                    glGenFramebuffers(1, &frameBufferName);
+                    glBindFramebuffer(GL_FRAMEBUFFER, frameBufferName);
+
+                    GLuint renderBufferName = 0;
+                    glGenRenderbuffers(1, &renderBufferName);
+
+                    GLuint colorBufferName = 0;
+                    rc = osvrRenderManagerCreateColorBufferOpenGL(width, height, GL_RGBA,
+                                                                  &colorBufferName);
+                    checkReturnCode(rc, "osvrRenderManagerCreateColorBufferOpenGL call failed.");
+
+                    // bind it to our framebuffer
+                    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D,
+                                           colorBufferName, 0);
+
+                    // The depth buffer
+                    GLuint depthBuffer;
+                    rc = osvrRenderManagerCreateDepthBufferOpenGL(width, height, &depthBuffer);
+                    checkReturnCode(rc, "osvrRenderManagerCreateDepthBufferOpenGL call failed.");
+
+                    glGenRenderbuffers(1, &depthBuffer);
+                    glBindRenderbuffer(GL_RENDERBUFFER, depthBuffer);
+                    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT16, width, height);
+
+                    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER,
+                                              depthBuffer);
+
+                    glBindRenderbuffer(GL_RENDERBUFFER, renderBufferName);
+                    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT16, width, height);
+                    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, colorBufferName, 0);
+                    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, renderBufferName);
+
+
+                    // unbind the framebuffer
+                    glBindTexture(GL_TEXTURE_2D, 0);
+                    glBindRenderbuffer(GL_RENDERBUFFER, 0);
+                    glBindFramebuffer(GL_FRAMEBUFFER, gFrameBuffer);
+
+                    OSVR_RenderBufferOpenGL buffer = {0};
+                    buffer.colorBufferName = colorBufferName;
+                    buffer.depthStencilBufferName = depthBuffer;
+                    rc = osvrRenderManagerRegisterRenderBufferOpenGL(state, buffer);
+                    checkReturnCode(rc, "osvrRenderManagerRegisterRenderBufferOpenGL call failed.");
+
+                    uint64_t pixels = static_cast<uint64_t>(width) * height;
+                    trackGpuObject(GPU_OBJECT_TEXTURE, colorBufferName, GPU_MEMORY_RENDER_TARGETS, pixels * 4);
+                    trackGpuObject(GPU_OBJECT_RENDERBUFFER, depthBuffer, GPU_MEMORY_RENDER_TARGETS, pixels * 2);
+                    trackGpuObject(GPU_OBJECT_RENDERBUFFER, renderBufferName, GPU_MEMORY_RENDER_TARGETS, pixels * 2);
+
+                    OSVR_RenderTargetInfo renderTarget = {0};
+                    renderTarget.frameBufferName = frameBufferName;
+                    renderTarget.renderBufferName = renderBufferName;
+                    renderTarget.colorBufferName = colorBufferName;
+                    renderTarget.depthBufferName = depthBuffer;
+                    renderTarget.presentBuffer = buffer;
+                    renderTarget.width = width;
+                    renderTarget.height = height;
+                    gRenderTargets.push_back(renderTarget);
+                }
+            }
+
+            rc = osvrRenderManagerFinishRegisterRenderBuffers(renderManager, state, true);
+            checkReturnCode(rc, "osvrRenderManagerFinishRegisterRenderBuffers call failed.");
+            gRenderTargetSets = sets;
+        } catch(...) {
+            LOGE("Error durring render target creation.");
+            return false;
+        }
+        return true;
+    }
+
+    bool setupOSVR() {
+        if(gOSVRInitialized) {
+            return true;
+        }
+        OSVR_ReturnCode rc = 0;
+        try {
+            // On Android, the current working directory is added to the default plugin search path.
+            // it also helps the server find its configuration and display files.
+//            boost::filesystem::current_path("/data/data/com.osvr.android.gles2sample/files");
+//            auto workingDirectory = boost::filesystem::current_path();
+//            LOGI("[OSVR] Current working directory: %s", workingDirectory.string().c_str());
+
+            // auto-start the server
+            osvrClientAttemptServerAutoStart();
+
+            if (!gClientContext) {
+                LOGI("[OSVR] Creating ClientContext...");
+                gClientContext = osvrClientInit("com.osvr.android.examples.OSVROpenGL", 0);
+                if (!gClientContext) {
+                    LOGI("[OSVR] could not create client context");
+                    return false;
+                }
+
+                // temporary workaround to DisplayConfig issue,
+                // display sometimes fails waiting for the tree from the server.
+                LOGI("[OSVR] Calling update a few times...");
+                for (int i = 0; i < 10000; i++) {
+                    rc = osvrClientUpdate(gClientContext);
+                    if (rc != OSVR_RETURN_SUCCESS) {
+                        LOGI("[OSVR] Error while updating client context.");
+                        return false;
+                    }
+                }
+
+
+                rc = osvrClientCheckStatus(gClientContext);
+                if (rc != OSVR_RETURN_SUCCESS) {
+                    LOGE("[OSVR] Client context reported bad status.");
+                    return false;
+                } else {
+                    LOGI("[OSVR] Client context reported good status.");
+                }
+
+
+                if (OSVR_RETURN_SUCCESS !=
+                    osvrClientGetInterface(gClientContext, "/camera", &gCamera)) {
+                    LOGE("Error, could not get the camera interface at /camera.");
+                    return false;
+                }
+
+                // Register the imaging callback.
+                if (OSVR_RETURN_SUCCESS !=
+                    osvrRegisterImagingCallback(gCamera, &imagingCallback, &gClientContext)) {
+                    LOGE("Error, could not register image callback.");
+                    return false;
+                }
+
+                // Head pose, only needed for recording and latency measurement;
+                // not every setup has a head tracker.
+                if (OSVR_RETURN_SUCCESS !=
+                    osvrClientGetInterface(gClientContext, "/me/head", &gHead)) {
+                    LOGI("[OSVR] No head interface at /me/head, recordings will have no head pose.");
+                    gHead = NULL;
+                }
+
+                // Center button
+                if (OSVR_RETURN_SUCCESS !=
+                    osvrClientGetInterface(gClientContext, "/controller/left/0", &gCenterButton)) {
+                    LOGE("Error, could not get the button interface at /controller/left/0.");
+                    return false;
+                }
+
+                if (OSVR_RETURN_SUCCESS !=
+                    osvrRegisterButtonCallback(gCenterButton, &buttonCallback,
+                                               inputSourceUserdata(INPUT_SOURCE_CENTER))) {
+                    LOGE("Error, could not register button callback.");
+                    return false;
+                }
+
+                // Down button
+                if (OSVR_RETURN_SUCCESS !=
+                    osvrClientGetInterface(gClientContext, "/controller/left/1", &gDownButton)) {
+                    LOGE("Error, could not get the button interface at /controller/left/1.");
+                    return false;
+                }
+
+                if (OSVR_RETURN_SUCCESS !=
+                    osvrRegisterButtonCallback(gDownButton, &buttonCallback,
+                                               inputSourceUserdata(INPUT_SOURCE_DOWN))) {
+                    LOGE("Error, could not register button callback.");
+                    return false;
+                }
+
+                // Right button
+                if (OSVR_RETURN_SUCCESS !=
+                    osvrClientGetInterface(gClientContext, "/controller/left/2", &gRightButton)) {
+                    LOGE("Error, could not get the button interface at /controller/left/2.");
+                    return false;
+                }
+
+                if (OSVR_RETURN_SUCCESS !=
+                    osvrRegisterButtonCallback(gRightButton, &buttonCallback,
+                                               inputSourceUserdata(INPUT_SOURCE_RIGHT))) {
+                    LOGE("Error, could not register button callback.");
+                    return false;
+                }
+
+                // Left button
+                if (OSVR_RETURN_SUCCESS !=
+                    osvrClientGetInterface(gClientContext, "/controller/left/3", &gLeftButton)) {
+                    LOGE("Error, could not get the button interface at /controller/left/3.");
+                    return false;
+                }
+
+                if (OSVR_RETURN_SUCCESS !=
+                    osvrRegisterButtonCallback(gLeftButton, &buttonCallback,
+                                               inputSourceUserdata(INPUT_SOURCE_LEFT))) {
+                    LOGE("Error, could not register button callback.");
+                    return false;
+                }
+
+                // Up button
+                if (OSVR_RETURN_SUCCESS !=
+                    osvrClientGetInterface(gClientContext, "/controller/left/4", &gUpButton)) {
+                    LOGE("Error, could not get the button interface at /controller/left/4.");
+                    return false;
+                }
+
+                if (OSVR_RETURN_SUCCESS !=
+                    osvrRegisterButtonCallback(gUpButton, &buttonCallback,
+                                               inputSourceUserdata(INPUT_SOURCE_UP))) {
+                    LOGE("Error, could not register button callback.");
+                    return false;
+                }
+
+                // Volume up button
+                if (OSVR_RETURN_SUCCESS !=
+                    osvrClientGetInterface(gClientContext, "/controller/left/volumeUp", &gVolumeUpButton)) {
+                    LOGE("Error, could not get the button interface at /controller/left/volumeUp.");
+                    return false;
+                }
+
+                if (OSVR_RETURN_SUCCESS !=
+                    osvrRegisterButtonCallback(gVolumeUpButton, &buttonCallback,
+                                               inputSourceUserdata(INPUT_SOURCE_VOLUME_UP))) {
+                    LOGE("Error, could not register button callback.");
+                    return false;
+                }
+
+                // Volume Down button
+                if (OSVR_RETURN_SUCCESS !=
+                    osvrClientGetInterface(gClientContext, "/controller/left/volumeDown", &gVolumeDownButton)) {
+                    LOGE("Error, could not get the button interface at /controller/left/volumeDown.");
+                    return false;
+                }
+
+                if (OSVR_RETURN_SUCCESS !=
+                    osvrRegisterButtonCallback(gVolumeDownButton, &buttonCallback,
+                                               inputSourceUserdata(INPUT_SOURCE_VOLUME_DOWN))) {
+                    LOGE("Error, could not register button callback.");
+                    return false;
+                }
+
+                // Back button
+                if (OSVR_RETURN_SUCCESS !=
+                    osvrClientGetInterface(gClientContext, "/controller/left/back", &gBackButton)) {
+                    LOGE("Error, could not get the button interface at /controller/left/back.");
+                    return false;
+                }
+
+                if (OSVR_RETURN_SUCCESS !=
+                    osvrRegisterButtonCallback(gBackButton, &buttonCallback,
+                                               inputSourceUserdata(INPUT_SOURCE_BACK))) {
+                    LOGE("Error, could not register button callback.");
+                    return false;
+                }
+
+                // Mouse
+                if (OSVR_RETURN_SUCCESS !=
+                    osvrClientGetInterface(gClientContext, "/mouse", &gMouseLocation2D)) {
+                    LOGE("Error, could not get the analog interface at /mouse/x.");
+                    return false;
+                }
+
+                if (OSVR_RETURN_SUCCESS !=
+                    osvrRegisterLocation2DCallback(gMouseLocation2D, &location2DCallback,
+                                                   inputSourceUserdata(INPUT_SOURCE_MOUSE))) {
+                    LOGE("Error, could not register analog callback.");
+                    return false;
+                }
+            }
+
+            gOSVRInitialized = true;
+            return true;
+        } catch (const std::runtime_error &ex) {
+            LOGE("[OSVR] OSVR initialization failed: %s", ex.what());
+            return false;
+        }
+    }
+
+    // Idempotent call to setup render manager
+    static bool setupRenderManager() {
+        if(!gOSVRInitialized || !gGraphicsInitializedOnce) {
+            return false;
+        }
+        if(gRenderManagerInitialized) {
+            return true;
+        }
+        try {
+            OSVR_ReturnCode rc;
+            PassThroughOpenGLContextImpl* glContextImpl = new PassThroughOpenGLContextImpl();
+            gGraphicsLibrary.toolkit = glContextImpl->getToolkit();
+
+            if(OSVR_RETURN_SUCCESS != osvrCreateRenderManagerOpenGL(
+                    gClientContext, "OpenGL", gGraphicsLibrary, &gRenderManager, &gRenderManagerOGL)) {
+                std::cerr << "Could not create the RenderManager" << std::endl;
+                return false;
+            }
+
+            if(!setupRenderTextures(gRenderManager)) {
+                return false;
+            }
+
+            // Open the display and make sure this worked
+            OSVR_OpenResultsOpenGL openResults;
+            if (OSVR_RETURN_SUCCESS != osvrRenderManagerOpenDisplayOpenGL(
+                    gRenderManagerOGL, &openResults) ||
+                (openResults.status == OSVR_OPEN_STATUS_FAILURE)) {
+                std::cerr << "Could not open display" << std::endl;
+                osvrDestroyRenderManager(gRenderManager);
+                gRenderManager = gRenderManagerOGL = nullptr;
+                return false;
+            }
+
+            rc = osvrRenderManagerGetDefaultRenderParams(&gFrameRenderParams);
+            checkReturnCode(rc, "osvrRenderManagerGetDefaultRenderParams call failed.");
+
+            gRenderManagerInitialized = true;
+            return true;
+        } catch (const std::runtime_error &ex) {
+            LOGI("[OSVR] RenderManager initialization failed: %s", ex.what());
+            return false;
+        }
+    }
+    static const GLfloat gTriangleColors[] = {
+            // white
+            1.0f, 1.0f, 1.0f, 1.0f,
+            1.0f, 1.0f, 1.0f, 1.0f,
+            1.0f, 1.0f, 1.0f, 1.0f,
+            1.0f, 1.0f, 1.0f, 1.0f,
+            1.0f, 1.0f, 1.0f, 1.0f,
+            1.0f, 1.0f, 1.0f, 1.0f,
+
+            // green
+            0.0f, 0.75f, 0.0f, 1.0f,
+            0.0f, 0.75f, 0.0f, 1.0f,
+            0.0f, 1.0f, 0.0f, 1.0f,
+            0.0f, 0.75f, 0.0f, 1.0f,
+            0.0f, 1.0f, 0.0f, 1.0f,
+            0.0f, 1.0f, 0.0f, 1.0f,
+
+            // blue
+            0.0f, 0.0f, 0.75f, 1.0f,
+            0.0f, 0.0f, 0.75f, 1.0f,
+            0.0f, 0.0f, 1.0f, 1.0f,
+            0.0f, 0.0f, 0.75f, 1.0f,
+            0.0f, 0.0f, 1.0f, 1.0f,
+            0.0f, 0.0f, 1.0f, 1.0f,
+
+            // green/purple
+            0.0f, 0.75f, 0.75f, 1.0f,
+            0.0f, 0.75f, 0.75f, 1.0f,
+            0.0f, 1.0f, 1.0f, 1.0f,
+            0.0f, 0.75f, 0.75f, 1.0f,
+            0.0f, 1.0f, 1.0f, 1.0f,
+            0.0f, 1.0f, 1.0f, 1.0f,
+
+            // red/green
+            0.75f, 0.75f, 0.0f, 1.0f,
+            0.75f, 0.75f, 0.0f, 1.0f,
+            1.0f, 1.0f, 0.0f, 1.0f,
+            0.75f, 0.75f, 0.0f, 1.0f,
+            1.0f, 1.0f, 0.0f, 1.0f,
+            1.0f, 1.0f, 0.0f, 1.0f,
+
+            // red/blue
+            0.75f, 0.0f, 0.75f, 1.0f,
+            0.75f, 0.0f, 0.75f, 1.0f,
+            1.0f, 0.0f, 1.0f, 1.0f,
+            0.75f, 0.0f, 0.75f, 1.0f,
+            1.0f, 0.0f, 1.0f, 1.0f,
+            1.0f, 0.0f, 1.0f, 1.0f
+    };
+
+    static const GLfloat gTriangleTexCoordinates[] = {
+            // A cube face (letters are unique vertices)
+            // A--B
+            // |  |
+            // D--C
+
+            // As two triangles (clockwise)
+            // A B D
+            // B C D
+
+            // white
+            1.0f, 0.0f, // A
+            1.0f, 1.0f, // B
+            0.0f, 0.0f, // D
+            1.0f, 1.0f, // B
+            0.0f, 1.0f, // C
+            0.0f, 0.0f, // D
+
+            // green
+            1.0f, 0.0f, // A
+            1.0f, 1.0f, // B
+            0.0f, 0.0f, // D
+            1.0f, 1.0f, // B
+            0.0f, 1.0f, // C
+            0.0f, 0.0f, // D
+
+            // blue
+            1.0f, 1.0f, // A
+            0.0f, 1.0f, // B
+            1.0f, 0.0f, // D
+            0.0f, 1.0f, // B
+            0.0f, 0.0f, // C
+            1.0f, 0.0f, // D
+
+            // blue-green
+            1.0f, 0.0f, // A
+            1.0f, 1.0f, // B
+            0.0f, 0.0f, // D
+            1.0f, 1.0f, // B
+            0.0f, 1.0f, // C
+            0.0f, 0.0f, // D
+
+            // yellow
+            0.0f, 0.0f, // A
+            1.0f, 0.0f, // B
+            0.0f, 1.0f, // D
+            1.0f, 0.0f, // B
+            1.0f, 1.0f, // C
+            0.0f, 1.0f, // D
+
+            // purple/magenta
+            1.0f, 1.0f, // A
+            0.0f, 1.0f, // B
+            1.0f, 0.0f, // D
+            0.0f, 1.0f, // B
+            0.0f, 0.0f, // C
+            1.0f, 0.0f, // D
+    };
+
+    static const GLfloat gTriangleVertices[] = {
+            // A cube face (letters are unique vertices)
+            // A--B
+            // |  |
+            // D--C
+
+            // As two triangles (clockwise)
+            // A B D
+            // B C D
+
+            //glNormal3f(0.0, 0.0, -1.0);
+            1.0f, 1.0f, -1.0f, // A
+            1.0f, -1.0f, -1.0f, // B
+            -1.0f, 1.0f, -1.0f, // D
+            1.0f, -1.0f, -1.0f, // B
+            -1.0f, -1.0f, -1.0f, // C
+            -1.0f, 1.0f, -1.0f, // D
+
+            //glNormal3f(0.0, 0.0, 1.0);
+            -1.0f, 1.0f, 1.0f, // A
+            -1.0f, -1.0f, 1.0f, // B
+            1.0f, 1.0f, 1.0f, // D
+            -1.0f, -1.0f, 1.0f, // B
+            1.0f, -1.0f, 1.0f, // C
+            1.0f, 1.0f, 1.0f, // D
+
+//        glNormal3f(0.0, -1.0, 0.0);
+            1.0f, -1.0f, 1.0f, // A
+            -1.0f, -1.0f, 1.0f, // B
+            1.0f, -1.0f, -1.0f, // D
+            -1.0f, -1.0f, 1.0f, // B
+            -1.0f, -1.0f, -1.0f, // C
+            1.0f, -1.0f, -1.0f, // D
+
+//        glNormal3f(0.0, 1.0, 0.0);
+            1.0f, 1.0f, 1.0f, // A
+            1.0f, 1.0f, -1.0f, // B
+            -1.0f, 1.0f, 1.0f, // D
+            1.0f, 1.0f, -1.0f, // B
+            -1.0f, 1.0f, -1.0f, // C
+            -1.0f, 1.0f, 1.0f, // D
+
+//        glNormal3f(-1.0, 0.0, 0.0);
+            -1.0f, 1.0f, 1.0f, // A
+            -1.0f, 1.0f, -1.0f, // B
+            -1.0f, -1.0f, 1.0f, // D
+            -1.0f, 1.0f, -1.0f, // B
+            -1.0f, -1.0f, -1.0f, // C
+            -1.0f, -1.0f, 1.0f, // D
+
+//        glNormal3f(1.0, 0.0, 0.0);
+            1.0f, -1.0f, 1.0f, // A
+            1.0f, -1.0f, -1.0f, // B
+            1.0f, 1.0f, 1.0f, // D
+            1.0f, -1.0f, -1.0f, // B
+            1.0f, 1.0f, -1.0f, // C
+            1.0f, 1.0f, 1.0f // D
+    };
+
+    static void stopAppThread();
+
+    // The GPU resources, as registered with the lifecycle manager (see
+    // Lifecycle.h): built when a surface comes with a new context, and again
+    // only when lost or stale after that.
+
+    // First in, so it is gone before anything else is made in a new context:
+    // destroying a RenderManager from a lost context deletes its old names,
+    // which may have come back. renderFrame() makes the new one.
+    static bool createRenderManagerResource() {
+        if (gRenderManager) {
+            osvrDestroyRenderManager(gRenderManager);
+            gRenderManager = gRenderManagerOGL = nullptr;
+        }
+        gRenderTargets.clear();
+        gRenderTargetSets = 0;
+        gRenderManagerInitialized = false;
+        return true;
+    }
+
+    static void releaseRenderManagerResource() {
+        if (gRenderManager) {
+            osvrDestroyRenderManager(gRenderManager);
+            gRenderManager = gRenderManagerOGL = nullptr;
+        }
+        for (size_t i = 0; i < gRenderTargets.size(); i++) {
+            const OSVR_RenderTargetInfo &target = gRenderTargets[i];
+            glDeleteFramebuffers(1, &target.frameBufferName);
+            glDeleteRenderbuffers(1, &target.renderBufferName);
+            glDeleteRenderbuffers(1, &target.depthBufferName);
+            glDeleteTextures(1, &target.colorBufferName);
+            forgetGpuObject(GPU_OBJECT_RENDERBUFFER, target.renderBufferName);
+            forgetGpuObject(GPU_OBJECT_RENDERBUFFER, target.depthBufferName);
+            forgetGpuObject(GPU_OBJECT_TEXTURE, target.colorBufferName);
+        }
+        gRenderTargets.clear();
+        gRenderTargetSets = 0;
+        gRenderManagerInitialized = false;
+    }
+
+    // A mesh's positions are quantized; without one, the cube's are used as they are.
+    static void applySceneMeshPositionTransform() {
+        float positionScale[3];
+        float positionOffset[3];
+        getSceneMeshPositionTransform(positionScale, positionOffset);
+        glUseProgram(gProgram);
+        glUniform3fv(glGetUniformLocation(gProgram, "positionScale"), 1, positionScale);
+        glUniform3fv(glGetUniformLocation(gProgram, "positionOffset"), 1, positionOffset);
+    }
+
+    static bool createSceneProgram() {
+        gProgram = createProgram(gVertexShader, gFragmentShader);
+        if (!gProgram) {
+            LOGE("Could not create program.");
+            return false;
+        }
+        gvPositionHandle = glGetAttribLocation(gProgram, "vPosition");
+        checkGlError("glGetAttribLocation");
+        LOGI("glGetAttribLocation(\"vPosition\") = %d\n", gvPositionHandle);
+
+        gvColorHandle = glGetAttribLocation(gProgram, "vColor");
+        checkGlError("glGetAttribLocation");
+        LOGI("glGetAttribLocation(\"vColor\") = %d\n", gvColorHandle);
+
+        gvTexCoordinateHandle = glGetAttribLocation(gProgram, "vTexCoordinate");
+        checkGlError("glGetAttribLocation");
+        LOGI("glGetAttribLocation(\"vTexCoordinate\") = %d\n", gvTexCoordinateHandle);
+
+        gvProjectionUniformId = glGetUniformLocation(gProgram, "projection");
+        gvViewUniformId = glGetUniformLocation(gProgram, "view");
+        gvModelUniformId = glGetUniformLocation(gProgram, "model");
+        guTextureUniformId = glGetUniformLocation(gProgram, "uTexture");
+        applySceneMeshPositionTransform();
+        return true;
+    }
+
+    static void releaseSceneProgram() {
+        glDeleteProgram(gProgram);
+        gProgram = 0;
+    }
+
+    static bool createCameraTexture() {
+        // Its size doesn't matter: each camera frame re-specifies it.
+        LOGI("Creating texture... here we go!");
+        gTextureID = createTexture(gWidth, gHeight);
+        gCameraTextureWidth.store(0, std::memory_order_relaxed);
+        gCameraTextureHeight.store(0, std::memory_order_relaxed);
+        static const GLubyte white[4] = { 255, 255, 255, 255 };
+        glGenTextures(1, &gWhiteTexture);
+        glBindTexture(GL_TEXTURE_2D, gWhiteTexture);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, white);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        trackGpuObject(GPU_OBJECT_TEXTURE, gWhiteTexture, GPU_MEMORY_TEXTURES, sizeof(white));
+        // the camera layer is set up again for the new texture
+        clearQuadLayer(kCameraLayer);
+        gCameraLayerShown.store(false, std::memory_order_relaxed);
+        return gTextureID != 0;
+    }
+
+    static void releaseCameraTexture() {
+        clearQuadLayer(kCameraLayer);
+        gCameraLayerShown.store(false, std::memory_order_relaxed);
+        glDeleteTextures(1, &gTextureID);
+        glDeleteTextures(1, &gWhiteTexture);
+        forgetGpuObject(GPU_OBJECT_TEXTURE, gTextureID);
+        forgetGpuObject(GPU_OBJECT_TEXTURE, gWhiteTexture);
+        gTextureID = gWhiteTexture = 0;
+    }
+
+    static bool createSceneTexture() {
+        initCompressedTextures();
+        resetTextureMemoryStats();
+        gSceneTexture = 0;
+        if (!gSceneTexturePath.empty()) {
+            CompressedTextureInfo sceneTextureInfo;
+            gSceneTexture = loadCompressedTexture(gSceneTexturePath.c_str(), &sceneTextureInfo);
+        }
+        return true;
+    }
+
+    static void releaseSceneTexture() {
+        if (gSceneTexture) {
+            deleteCompressedTexture(gSceneTexture);
+            gSceneTexture = 0;
+        }
+    }
+
+    static bool createSceneMesh() {
+        setupSceneMesh();
+        applySceneMeshPositionTransform();
+        return true;
+    }
+
+    static void releaseSceneMeshResource() {
+        releaseSceneMesh();
+        applySceneMeshPositionTransform();
+    }
+
+    static bool createMaterials() {
+        return setupMaterials(gTriangleVertices, gTriangleColors, gTriangleTexCoordinates, 36);
+    }
+
+    static bool createGpuProfiler() {
+        initGpuProfiler();
+        return true;
+    }
+
+    static bool createReprojectionPass() {
+        gReprojectionPassReady = initReprojectionPass();
+        gAsyncReprojectionUnavailable = false;
+        return gReprojectionPassReady;
+    }
+
+    static void releaseReprojectionPassResource() {
+        releaseReprojectionPass();
+        gReprojectionPassReady = false;
+    }
+
+    static bool createQuadLayers() {
+        return initQuadLayers();
+    }
+
+    static bool createExternalImages() {
+        gCameraImageFrameNumber.store(0, std::memory_order_relaxed);
+        return initExternalImages();
+    }
+
+    static bool createFrameCapture() {
+        return initFrameCapture();
+    }
+
+    // First, so that it forgets the objects of a lost context before the
+    // others track their new ones.
+    static bool createGpuMemory() {
+        initGpuMemory();
+        return true;
+    }
+
+    static bool createDistortionMesh() {
+        setupDistortionMesh();
+        return true;
+    }
+
+    static void registerGpuResources() {
+        registerGpuResource("gpuMemory", createGpuMemory, releaseGpuMemory);
+        registerGpuResource("renderManager", createRenderManagerResource, releaseRenderManagerResource);
+        registerGpuResource("sceneProgram", createSceneProgram, releaseSceneProgram);
+        registerGpuResource("cameraTexture", createCameraTexture, releaseCameraTexture);
+        registerGpuResource("sceneTexture", createSceneTexture, releaseSceneTexture);
+        registerGpuResource("sceneMesh", createSceneMesh, releaseSceneMeshResource);
+        registerGpuResource("materials", createMaterials, releaseMaterials);
+        registerGpuResource("gpuProfiler", createGpuProfiler, shutdownGpuProfiler);
+        registerGpuResource("reprojectionPass", createReprojectionPass, releaseReprojectionPassResource);
+        registerGpuResource("distortionMesh", createDistortionMesh, releaseDistortionMesh);
+        registerGpuResource("quadLayers", createQuadLayers, releaseQuadLayers);
+        registerGpuResource("externalImages", createExternalImages, releaseExternalImages);
+        registerGpuResource("frameCapture", createFrameCapture, releaseFrameCapture);
+    }
+
+    bool setupGraphics(int width, int height) {
+        printGLString("Version", GL_VERSION);
+        printGLString("Vendor", GL_VENDOR);
+        printGLString("Renderer", GL_RENDERER);
+        printGLString("Extensions", GL_EXTENSIONS);
+
+        //initializeGLES2Ext();
+        GLint frameBuffer;
+        glGetIntegerv(GL_FRAMEBUFFER_BINDING, &frameBuffer);
+        gFrameBuffer = (GLuint)frameBuffer;
+        LOGI("Window GL_FRAMEBUFFER_BINDING: %d", gFrameBuffer);
+
+        LOGI("setupGraphics(%d, %d)", width, height);
+        traceSetThreadName("GLThread");
+        gWidth = width;
+        gHeight = height;
+
+        // its context shares with one that may be gone
+        stopAppThread();
+
+        //bool osvrSetupSuccess = setupOSVR();
+
+        glViewport(0, 0, width, height);
+        checkGlError("glViewport");
+
+        glDisable(GL_CULL_FACE);
+
+        glGetIntegerv(GL_MAX_VERTEX_ATTRIBS, &gMaxVertexAttribs);
+
+        if (!gGraphicsInitializedOnce) {
+            registerGpuResources();
+        }
+        // the rest can do without whatever failed to build, but not without the program
+        bool newContext = false;
+        if (!lifecycleSurfaceChanged(&newContext) && !gProgram) {
+            return false;
+        }
+        if (newContext) {
+            initEGLFences();
+            resetLatencyMonitor();
+            resetFramePacer();
+        }
+        if (!setupScene()) {
+            LOGE("Could not set up the scene.");
+            return false;
+        }
+
+        //return osvrSetupSuccess;
+        gGraphicsInitializedOnce = true;
+        return true;
+    }
+
+    void setSceneTexturePath(const char *path) {
+        gSceneTexturePath = path ? path : "";
+        markGpuResourceStale("sceneTexture");
+    }
+
+    void setCameraLayerEnabled(bool enabled) {
+        gCameraLayerEnabled.store(enabled, std::memory_order_relaxed);
+    }
+
+    // Moves the camera feed between the cubes and its quad layer to match
+    // setCameraLayerEnabled(). The layer samples it with bilinear filtering,
+    // the cubes as they always have.
+    static void updateCameraLayer() {
+        bool wanted = gCameraLayerEnabled.load(std::memory_order_relaxed) && gTextureID != 0;
+        bool shown = gCameraLayerShown.load(std::memory_order_relaxed);
+        if (wanted != shown) {
+            // which thread uploads the camera frames changes with it, so the
+            // app thread stops first; updateAsyncReprojection() starts it again
+            stopAppThread();
+            glBindTexture(GL_TEXTURE_2D, gTextureID);
+            GLint filter = wanted ? GL_LINEAR : GL_NEAREST;
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, filter);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, filter);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+            if (!wanted) {
+                clearQuadLayer(kCameraLayer);
+            }
+            gCameraLayerShown.store(wanted, std::memory_order_relaxed);
+            LOGI("[Layers] Camera feed %s.", wanted ? "on a quad layer" : "back on the cubes");
+        }
+        if (!wanted) {
+            return;
+        }
+        uint32_t width = gCameraTextureWidth.load(std::memory_order_relaxed);
+        uint32_t height = gCameraTextureHeight.load(std::memory_order_relaxed);
+        QuadLayer layer;
+        layer.texture = gTextureID;
+        layer.target = GL_TEXTURE_2D;
+        // frames handed over as buffers take the place of the OSVR ones; the
+        // layer is the only thing that samples them, so they are latched here
+        ExternalImageFrame imported;
+        if (latchExternalImage(kCameraImageStream, &imported)) {
+            if (imported.frameNumber != gCameraImageFrameNumber.load(std::memory_order_relaxed)) {
+                gCameraImageFrameNumber.store(imported.frameNumber, std::memory_order_relaxed);
+                quadLayerContentChanged(kCameraLayer);
+            }
+            layer.texture = imported.texture;
+            layer.target = imported.target;
+            width = imported.width;
+            height = imported.height;
+        }
+        layer.space = QUAD_LAYER_HEAD;
+        layer.center[0] = 0.0f;
+        layer.center[1] = 0.0f;
+        layer.center[2] = -kCameraLayerDistance;
+        layer.size[0] = kCameraLayerWidth;
+        layer.size[1] = width && height ? kCameraLayerWidth * height / width : kCameraLayerWidth * 0.75f;
+        layer.topRowFirst = true;
+        setQuadLayer(kCameraLayer, layer);
+    }
+
+    void setSimulatedFrameDelay(uint32_t delayMs, uint32_t everyNFrames) {
+        gSimulatedDelayEveryNFrames.store(everyNFrames > 0 ? everyNFrames : 1, std::memory_order_relaxed);
+        gSimulatedDelayMs.store(delayMs, std::memory_order_relaxed);
+    }
+
+    static void simulateSlowFrame() {
+        uint32_t delayMs = gSimulatedDelayMs.load(std::memory_order_relaxed);
+        if (!delayMs) {
+            return;
+        }
+        if (++gSimulatedDelayFrame >= gSimulatedDelayEveryNFrames.load(std::memory_order_relaxed)) {
+            gSimulatedDelayFrame = 0;
+            OSVR_TRACE_SCOPE("simulatedFrameDelay");
+            std::this_thread::sleep_for(std::chrono::milliseconds(delayMs));
+        }
+    }
+
+    // The eye's view and projection, in the floats ES2 wants.
+    static void computeSceneView(const OSVR_RenderInfoOpenGL &renderInfo, SceneView *viewOut) {
+        // RenderManager's utilities only support doubles
+        double viewMatd[OSVR_MATRIX_SIZE];
+        OSVR_PoseState_to_OpenGL(viewMatd, renderInfo.pose);
+        double projMatd[OSVR_MATRIX_SIZE];
+        OSVR_Projection_to_OpenGL(projMatd, renderInfo.projection);
+        for (int j = 0; j < OSVR_MATRIX_SIZE; j++) {
+            viewOut->view[j] = static_cast<GLfloat>(viewMatd[j]);
+            viewOut->projection[j] = static_cast<GLfloat>(projMatd[j]);
+        }
+    }
+
+    // Every eye's render info for the params, pulled out of the collection up
+    // front along with its scene view, into the frame arena.
+    static OSVR_RenderInfoCount collectRenderInfos(const OSVR_RenderParams &renderParams,
+                                                   OSVR_RenderInfoOpenGL **renderInfosOut,
+                                                   SceneView **sceneViewsOut) {
+        OSVR_RenderInfoCount numRenderInfo;
+        OSVR_RenderInfoOpenGL *renderInfos;
+        {
+            RenderInfoCollectionOpenGL renderInfoCollection(gRenderManager, renderParams);
+            numRenderInfo = renderInfoCollection.getNumRenderInfo();
+            if (numRenderInfo > gEyeCount) {
+                LOGE("RenderManager reported %u eyes but only %u render targets exist.",
+                     static_cast<unsigned>(numRenderInfo), static_cast<unsigned>(gEyeCount));
+                numRenderInfo = gEyeCount;
+            }
+            renderInfos = gFrameArena.allocateArray<OSVR_RenderInfoOpenGL>(numRenderInfo);
+            if (!renderInfos) {
+                numRenderInfo = 0;
+            }
+            for (OSVR_RenderInfoCount i = 0; i < numRenderInfo; i++) {
+                renderInfos[i] = renderInfoCollection.getRenderInfo(i);
+            }
+        }
+
+        // the scene is culled against these and the eye passes draw with them
+        SceneView *sceneViews = gFrameArena.allocateArray<SceneView>(numRenderInfo);
+        if (!sceneViews) {
+            numRenderInfo = 0;
+        }
+        for (OSVR_RenderInfoCount i = 0; i < numRenderInfo; i++) {
+            computeSceneView(renderInfos[i], &sceneViews[i]);
+        }
+        *renderInfosOut = renderInfos;
+        *sceneViewsOut = sceneViews;
+        return numRenderInfo;
+    }
+
+    // The part of an eye's viewport drawn into at the render scale.
+    static OSVR_ViewportDescription scaledViewport(const OSVR_ViewportDescription &viewport, float renderScale) {
+        OSVR_ViewportDescription scaled = viewport;
+        scaled.width = std::floor(viewport.width * renderScale);
+        scaled.height = std::floor(viewport.height * renderScale);
+        return scaled;
+    }
+
+    // Draws the scene's draw list for an eye into frameBuffer.
+    static void drawEye(const OSVR_RenderInfoOpenGL &currentRenderInfo, const SceneView &sceneView,
+                        uint32_t eye, GLuint frameBuffer, float renderScale) {
+        // Set color and depth buffers for the frame buffer
+        glBindFramebuffer(GL_FRAMEBUFFER, frameBuffer);
+
+        // @todo: convert to OpenGL?
+        OSVR_ViewportDescription viewport = scaledViewport(currentRenderInfo.viewport, renderScale);
+        glViewport(static_cast<GLint>(viewport.left),
+                   static_cast<GLint>(viewport.lower),
+                   static_cast<GLsizei>(viewport.width),
+                   static_cast<GLsizei>(viewport.height));
+
+//        glViewport(static_cast<GLint>(eye == 0 ? 0 : currentRenderInfo.viewport.width),
+//                   static_cast<GLint>(currentRenderInfo.viewport.lower),
+//                   static_cast<GLsizei>(currentRenderInfo.viewport.width),
+//                   static_cast<GLsizei>(currentRenderInfo.viewport.height));
+
+        /// Call out to render our scene.
+        glUseProgram(gProgram);
+        checkGlError("glUseProgram");
+
+        glUniformMatrix4fv(gvProjectionUniformId, 1, GL_FALSE, sceneView.projection);
+        glUniformMatrix4fv(gvViewUniformId, 1, GL_FALSE, sceneView.view);
+        checkGlError("one of the glUniformMatrix4fv calls?");
+
+        // a loaded mesh is depth tested; the cube is drawn from the inside, where it can't overlap itself
+        bool sceneMesh = isSceneMeshReady();
+        if (sceneMesh) {
+            bindSceneMesh(gvPositionHandle, gvColorHandle, gvTexCoordinateHandle);
+            glEnable(GL_DEPTH_TEST);
+        } else {
+            glEnableVertexAttribArray(gvPositionHandle);
+            checkGlError("glEnableVertexAttribArray");
+            glVertexAttribPointer(gvPositionHandle, 3, GL_FLOAT, GL_FALSE, 0, gTriangleVertices);
+            checkGlError("glVertexAttribPointer");
+
+            glEnableVertexAttribArray(gvColorHandle);
+            checkGlError("glEnableVertexAttribArray");
+            glVertexAttribPointer(gvColorHandle, 4, GL_FLOAT, GL_FALSE, 0, gTriangleColors);
+            checkGlError("glVertexAttribPointer");
+
+            glEnableVertexAttribArray(gvTexCoordinateHandle);
+            checkGlError("glEnableVertexAttribArray");
+            glVertexAttribPointer(gvTexCoordinateHandle, 2, GL_FLOAT, GL_FALSE, 0, gTriangleTexCoordinates);
+            checkGlError("glVertexAttribPointer");
+        }
+
+        glActiveTexture(GL_TEXTURE0);
+        GLuint texture = gSceneTexture;
+        if (!texture) {
+            texture = gCameraLayerShown.load(std::memory_order_relaxed) ? gWhiteTexture : gTextureID;
+        }
+        glBindTexture(GL_TEXTURE_2D, texture);
+        glUniform1i(guTextureUniformId, 0);
+        useGpuTexture(texture);
+
+        // every object is the same cube (or mesh), so a draw is just its model matrix
+        uint32_t drawCount;
+        const SceneDrawCommand *drawList = getSceneDrawList(eye, &drawCount);
+        bool materials = areMaterialsReady();
+        for (uint32_t i = 0; i < drawCount; i++) {
+            if (materials && drawList[i].material != kSceneNoMaterial) {
+                continue;
+            }
+            glUniformMatrix4fv(gvModelUniformId, 1, GL_FALSE, drawList[i].model);
+            if (sceneMesh) {
+                drawSceneMesh();
+            } else {
+                glDrawArrays(GL_TRIANGLES, 0, 36);
+            }
+        }
+        checkGlError("glDrawArrays");
+        if (materials) {
+            drawMaterialObjects(drawList, drawCount, sceneView, sceneMesh);
+            checkGlError("drawMaterialObjects");
+        }
+        if (sceneMesh) {
+            glDisable(GL_DEPTH_TEST);
+            unbindSceneMesh();
+        }
+
+        if (isLatencyTestPatternEnabled()) {
+            drawLatencyTestPattern(viewport);
+        }
+    }
+
+    // A render target set's eyes as they are presented, if this frame is captured.
+    static void captureEyes(size_t set, const OSVR_RenderInfoOpenGL *renderInfos, OSVR_RenderInfoCount eyeCount,
+                            float renderScale) {
+        if (!isCapturingFrame()) {
+            return;
+        }
+        for (OSVR_RenderInfoCount eye = 0; eye < eyeCount; eye++) {
+            OSVR_ViewportDescription viewport = scaledViewport(renderInfos[eye].viewport, renderScale);
+            captureFramebuffer(FRAME_CAPTURE_EYE, static_cast<uint32_t>(eye), renderTarget(set, eye).frameBufferName,
+                               static_cast<int>(viewport.left), static_cast<int>(viewport.lower),
+                               static_cast<int>(viewport.width), static_cast<int>(viewport.height));
+        }
+        glBindFramebuffer(GL_FRAMEBUFFER, gFrameBuffer);
+    }
+
+    // The newest camera frame into the camera texture, on the GL thread.
+    static void uploadCameraFrame() {
+        OSVR_ImageBufferElement *cameraFrame;
+        GLuint cameraWidth, cameraHeight, cameraChannels;
+        if (takeCameraFrame(&cameraFrame, &cameraWidth, &cameraHeight, &cameraChannels)) {
+            OSVR_FRAME_STAGE_TIMER(FRAME_STAGE_TEXTURE_UPLOAD);
+            OSVR_GPU_STAGE_TIMER(FRAME_STAGE_GPU_TEXTURE_UPLOAD);
+            updateTexture(cameraWidth, cameraHeight, cameraChannels, cameraFrame);
+            freeCameraFrame(cameraFrame);
+        }
+    }
+
+    // Shows a render target set's eyes, each as rendered with its render info
+    // and view at renderScale, with the quad layers over them. RenderManager
+    // presents them (with its distortion and time warp) unless there is a
+    // distortion mesh, which draws them straight into the window and the
+    // layers through it with the newest views, latestViews.
+    static void presentEyes(size_t set, const OSVR_RenderInfoOpenGL *renderInfos, const SceneView *views,
+                            OSVR_RenderInfoCount eyeCount, const OSVR_RenderParams &renderParams,
+                            const SceneView *latestViews, float renderScale) {
+        OSVR_FRAME_STAGE_TIMER(FRAME_STAGE_PRESENT);
+        OSVR_GPU_STAGE_TIMER(FRAME_STAGE_GPU_PRESENT);
+        bool layers = hasQuadLayers();
+        if (isDistortionMeshReady()) {
+            captureEyes(set, renderInfos, eyeCount, renderScale);
+            glBindFramebuffer(GL_FRAMEBUFFER, gFrameBuffer);
+            glViewport(0, 0, gWidth, gHeight);
+            for (OSVR_RenderInfoCount eye = 0; eye < eyeCount; eye++) {
+                drawDistortionMesh(static_cast<uint32_t>(eye), renderTarget(set, eye).colorBufferName, renderScale);
+                if (layers) {
+                    compositeQuadLayers(static_cast<uint32_t>(eye), latestViews, static_cast<uint32_t>(eyeCount),
+                                        gWidth, gHeight);
+                }
+            }
+            checkGlError("drawDistortionMesh");
+            return;
+        }
+
+        // RenderManager takes the eye buffers only, so the layers go into them
+        if (layers) {
+            for (OSVR_RenderInfoCount eye = 0; eye < eyeCount; eye++) {
+                OSVR_ViewportDescription viewport = scaledViewport(renderInfos[eye].viewport, renderScale);
+                const int eyeViewport[4] = { static_cast<int>(viewport.left), static_cast<int>(viewport.lower),
+                                             static_cast<int>(viewport.width), static_cast<int>(viewport.height) };
+                glBindFramebuffer(GL_FRAMEBUFFER, renderTarget(set, eye).frameBufferName);
+                glViewport(eyeViewport[0], eyeViewport[1], eyeViewport[2], eyeViewport[3]);
+                drawQuadLayersIntoEye(static_cast<uint32_t>(eye), views, static_cast<uint32_t>(eyeCount),
+                                      eyeViewport);
+            }
+            glBindFramebuffer(GL_FRAMEBUFFER, gFrameBuffer);
+            checkGlError("drawQuadLayersIntoEye");
+        }
+        captureEyes(set, renderInfos, eyeCount, renderScale);
+
+        OSVR_ReturnCode rc;
+        OSVR_RenderManagerPresentState presentState;
+        rc = osvrRenderManagerStartPresentRenderBuffers(&presentState);
+        checkReturnCode(rc, "osvrRenderManagerStartPresentRenderBuffers call failed.");
+        const OSVR_ViewportDescription normalizedViewport = {0.0, 0.0, renderScale, renderScale};
+        for (OSVR_RenderInfoCount eye = 0; eye < eyeCount; eye++) {
+            rc = osvrRenderManagerPresentRenderBufferOpenGL(
+                    presentState, renderTarget(set, eye).presentBuffer, renderInfos[eye], normalizedViewport);
+            checkReturnCode(rc, "osvrRenderManagerPresentRenderBufferOpenGL call failed.");
+        }
+        rc = osvrRenderManagerFinishPresentRenderBuffers(
+                gRenderManager, presentState, renderParams, false);
+        checkReturnCode(rc, "osvrRenderManagerFinishPresentRenderBuffers call failed.");
+    }
+
+    // Present and finish as they always were: everything on the GL thread.
+    static void renderAndPresentFrame() {
+        float renderScale = gRenderScale.load(std::memory_order_relaxed);
+        // animates on the job workers while the client updates
+        beginSceneFrame();
+        updateGpuMemory();
+
+        OSVR_FRAME_STAGE_BEGIN(FRAME_STAGE_CLIENT_UPDATE);
+        updateClient();
+        recordFramePose();
+        consumeLatencyPose();
+        OSVR_FRAME_STAGE_END(FRAME_STAGE_CLIENT_UPDATE);
+
+        uploadCameraFrame();
+
+        OSVR_FRAME_STAGE_BEGIN(FRAME_STAGE_RENDER_INFO);
+        OSVR_RenderParams renderParams = gFrameRenderParams;
+        if (gHasReplayHeadPose) {
+            renderParams.roomFromHeadReplace = &gReplayHeadPose;
+        }
+        OSVR_RenderInfoOpenGL *renderInfos;
+        SceneView *sceneViews;
+        OSVR_RenderInfoCount numRenderInfo = collectRenderInfos(renderParams, &renderInfos, &sceneViews);
+        OSVR_FRAME_STAGE_END(FRAME_STAGE_RENDER_INFO);
+
+        OSVR_FRAME_STAGE_BEGIN(FRAME_STAGE_SCENE_UPDATE);
+        buildSceneDrawLists(sceneViews, static_cast<uint32_t>(numRenderInfo));
+        OSVR_FRAME_STAGE_END(FRAME_STAGE_SCENE_UPDATE);
+
+        for(OSVR_RenderInfoCount renderInfoCount = 0;
+            renderInfoCount < numRenderInfo;
+            renderInfoCount++) {
+            OSVR_FRAME_STAGE_TIMER(eyeFrameStage(renderInfoCount));
+            OSVR_GPU_STAGE_TIMER(gpuEyeFrameStage(renderInfoCount));
+
+            const OSVR_RenderInfoOpenGL &currentRenderInfo = renderInfos[renderInfoCount];
+            const OSVR_RenderTargetInfo &renderTargetInfo = renderTarget(0, renderInfoCount);
+            drawEye(currentRenderInfo, sceneViews[renderInfoCount],
+                    static_cast<uint32_t>(renderInfoCount), renderTargetInfo.frameBufferName, renderScale);
+
+            // unbind the render target
+            glBindFramebuffer(GL_FRAMEBUFFER, gFrameBuffer);
+        }
+        simulateSlowFrame();
+
+        presentEyes(0, renderInfos, sceneViews, numRenderInfo, renderParams, sceneViews, renderScale);
+        latencySubmitted();
+    }
+
+    // The app's render target set it may draw into next, or -1 while its
+    // newest frame still waits to be shown. Under gAppMutex.
+    static int freeAppFrameSet() {
+        if (gNewestAppFrame != gDisplayedAppFrame) {
+            return -1;
+        }
+        return gDisplayedAppFrame == 0 ? 1 : 0;
+    }
+
+    // One app frame into the given set, on the app thread: the same work as
+    // renderAndPresentFrame() up to the present, minus the GPU timers (their
+    // queries belong to the GL thread's context).
+    static void drawAppFrame(int set, const OSVR_RenderInfoOpenGL *renderInfos,
+                             OSVR_RenderInfoCount eyeCount, AppFrame *frameOut) {
+        OSVR_FRAME_STAGE_TIMER(FRAME_STAGE_APP_FRAME);
+        uint64_t startNs = frameStatsNowNs();
+        frameOut->renderScale = gRenderScale.load(std::memory_order_relaxed);
+        beginSceneFrame();
+        updateGpuMemory();
+
+        // the cubes are the only thing that samples the camera texture here;
+        // on its layer, the GL thread uploads it (see updateCameraLayer())
+        OSVR_ImageBufferElement *cameraFrame;
+        GLuint cameraWidth, cameraHeight, cameraChannels;
+        if (!gCameraLayerShown.load(std::memory_order_relaxed) &&
+            takeCameraFrame(&cameraFrame, &cameraWidth, &cameraHeight, &cameraChannels)) {
+            OSVR_FRAME_STAGE_TIMER(FRAME_STAGE_TEXTURE_UPLOAD);
+            updateTexture(cameraWidth, cameraHeight, cameraChannels, cameraFrame);
+            releaseUploadedCameraFrame(cameraFrame);
+        }
+
+        frameOut->eyeCount = eyeCount;
+        for (OSVR_RenderInfoCount eye = 0; eye < eyeCount; eye++) {
+            frameOut->renderInfos[eye] = renderInfos[eye];
+            computeSceneView(renderInfos[eye], &frameOut->views[eye]);
+        }
+
+        OSVR_FRAME_STAGE_BEGIN(FRAME_STAGE_SCENE_UPDATE);
+        buildSceneDrawLists(frameOut->views, static_cast<uint32_t>(eyeCount));
+        OSVR_FRAME_STAGE_END(FRAME_STAGE_SCENE_UPDATE);
+
+        for (OSVR_RenderInfoCount eye = 0; eye < eyeCount; eye++) {
+            OSVR_FRAME_STAGE_TIMER(eyeFrameStage(eye));
+            drawEye(renderInfos[eye], frameOut->views[eye], static_cast<uint32_t>(eye),
+                    gAppFrameBuffers[set][eye], frameOut->renderScale);
+        }
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        simulateSlowFrame();
+
+        // the display side checks the fence from its own context, so it has to be flushed
+        frameOut->fence = createEGLFence();
+        if (frameOut->fence) {
+            glFlush();
+        } else {
+            glFinish();
+        }
+        gLastAppFrameNs.store(frameStatsNowNs() - startNs, std::memory_order_relaxed);
+    }
+
+    static void appThreadMain() {
+        traceSetThreadName("AppRenderThread");
+        if (!makeSharedGLContextCurrent(&gAppContext)) {
+            // the GL thread notices, joins this thread and goes back to rendering itself
+            gAppThreadFailed.store(true);
+            return;
+        }
+        glDisable(GL_CULL_FACE);
+        for (int set = 0; set < kAppFrameSets; set++) {
+            for (size_t eye = 0; eye < gEyeCount; eye++) {
+                glGenFramebuffers(1, &gAppFrameBuffers[set][eye]);
+                attachEyeBuffer(gAppFrameBuffers[set][eye], renderTarget(static_cast<size_t>(set), eye),
+                                gEyeBufferSamples);
+            }
+        }
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        checkGlError("app thread framebuffers");
+        // this thread does the scene's frames now, so it becomes job worker 0
+        if (!setupScene()) {
+            LOGE("[Reprojection] Could not set up the scene on the app thread.");
+        }
+
+        OSVR_RenderInfoOpenGL renderInfos[kSceneMaxViews];
+        AppFrame frame;
+        for (;;) {
+            int set;
+            OSVR_RenderInfoCount eyeCount;
+            EGLFence releaseFence;
+            {
+                std::unique_lock<std::mutex> lock(gAppMutex);
+                gAppCondition.wait(lock, [] {
+                    return gAppThreadStopping || (gLatestEyeCount > 0 && freeAppFrameSet() >= 0);
+                });
+                if (gAppThreadStopping) {
+                    break;
+                }
+                set = freeAppFrameSet();
+                eyeCount = gLatestEyeCount;
+                memcpy(renderInfos, gLatestRenderInfos, sizeof(renderInfos[0]) * eyeCount);
+                releaseFence = gReleaseFences[set];
+                gReleaseFences[set] = nullptr;
+            }
+            if (releaseFence) {
+                if (!waitEGLFence(releaseFence, kReleaseFenceTimeoutNs)) {
+                    LOGI("[Reprojection] Timed out waiting for the display to release a frame.");
+                }
+                destroyEGLFence(releaseFence);
+            }
+
+            drawAppFrame(set, renderInfos, eyeCount, &frame);
+            {
+                std::lock_guard<std::mutex> lock(gAppMutex);
+                gAppFrames[set] = frame;
+                gNewestAppFrame = set;
+            }
+            countAppFrame();
+        }
+
+        shutdownScene();
+        for (int set = 0; set < kAppFrameSets; set++) {
+            glDeleteFramebuffers(static_cast<GLsizei>(gEyeCount), gAppFrameBuffers[set]);
+        }
+        glFinish();
+        makeSharedGLContextCurrent(nullptr);
+    }
+
+    static void startAppThread() {
+        if (gEyeCount > kSceneMaxViews || !gReprojectionPassReady) {
+            LOGE("[Reprojection] Async reprojection is not available; rendering synchronously.");
+            gAsyncReprojectionUnavailable = true;
+            return;
+        }
+        if (!createSharedGLContext(&gAppContext)) {
+            LOGE("[Reprojection] No shared context; rendering synchronously.");
+            gAsyncReprojectionUnavailable = true;
+            return;
+        }
+        {
+            // a replayed frame still waiting is the replayer's, and not copied for the app thread
+            std::lock_guard<std::mutex> lock(gCameraFrameMutex);
+            if (gLastFrame && isReplaying()) {
+                freeCameraFrameLocked(gLastFrame);
+                gLastFrame = nullptr;
+            }
+        }
+        {
+            std::lock_guard<std::mutex> lock(gAppMutex);
+            gAppThreadStopping = false;
+            gAppThreadFailed.store(false);
+            gNewestAppFrame = -1;
+            gDisplayedAppFrame = -1;
+            gLatestEyeCount = 0;
+            memset(gAppFrames, 0, sizeof(gAppFrames));
+            memset(gReleaseFences, 0, sizeof(gReleaseFences));
+        }
+        // everything the app thread draws with has to be complete before another context uses it
+        glFinish();
+        gAppThread = std::thread(appThreadMain);
+        gAppThreadRunning = true;
+        LOGI("[Reprojection] Async reprojection on.");
+    }
+
+    static void stopAppThread() {
+        if (!gAppThreadRunning) {
+            return;
+        }
+        {
+            std::lock_guard<std::mutex> lock(gAppMutex);
+            gAppThreadStopping = true;
+        }
+        gAppCondition.notify_all();
+        gAppThread.join();
+        gAppThreadRunning = false;
+
+        for (int set = 0; set < kAppFrameSets; set++) {
+            destroyEGLFence(gAppFrames[set].fence);
+            destroyEGLFence(gReleaseFences[set]);
+        }
+        memset(gAppFrames, 0, sizeof(gAppFrames));
+        memset(gReleaseFences, 0, sizeof(gReleaseFences));
+        destroySharedGLContext(&gAppContext);
+        freeUploadedCameraFrames();
+        // the GL thread is back to doing the scene's frames
+        if (!setupScene()) {
+            LOGE("Could not set up the scene.");
+        }
+        LOGI("[Reprojection] Async reprojection off.");
+    }
+
+    void stopAsyncReprojection() {
+        stopAppThread();
+    }
+
+    // Marks the GL thread done with a set the app may draw into next.
+    static EGLFence createReleaseFence() {
+        EGLFence fence = createEGLFence();
+        if (fence) {
+            // the app thread waits on it from its own context
+            glFlush();
+        } else {
+            glFinish();
+        }
+        return fence;
+    }
+
+    // The display side of async reprojection, on the GL thread: the newest
+    // pose, and the newest app frame if it's done or else the last one
+    // rotated to that pose.
+    static void displayFrame() {
+        freeUploadedCameraFrames();
+
+        OSVR_FRAME_STAGE_BEGIN(FRAME_STAGE_CLIENT_UPDATE);
+        updateClient();
+        recordFramePose();
+        consumeLatencyPose();
+        OSVR_FRAME_STAGE_END(FRAME_STAGE_CLIENT_UPDATE);
+
+        // on its layer the camera feed is sampled here, so it is uploaded
+        // here too, at the display rate
+        if (gCameraLayerShown.load(std::memory_order_relaxed)) {
+            uploadCameraFrame();
+        }
+
+        OSVR_FRAME_STAGE_BEGIN(FRAME_STAGE_RENDER_INFO);
+        OSVR_RenderParams renderParams = gFrameRenderParams;
+        if (gHasReplayHeadPose) {
+            renderParams.roomFromHeadReplace = &gReplayHeadPose;
+        }
+        OSVR_RenderInfoOpenGL *renderInfos;
+        SceneView *sceneViews;
+        OSVR_RenderInfoCount numRenderInfo = collectRenderInfos(renderParams, &renderInfos, &sceneViews);
+        OSVR_FRAME_STAGE_END(FRAME_STAGE_RENDER_INFO);
+
+        // hand the new pose to the app thread and pick up its newest frame if it's done
+        int shown;
+        bool fresh = false;
+        {
+            std::lock_guard<std::mutex> lock(gAppMutex);
+            gLatestEyeCount = numRenderInfo;
+            memcpy(gLatestRenderInfos, renderInfos, sizeof(renderInfos[0]) * numRenderInfo);
+            int newest = gNewestAppFrame;
+            if (newest >= 0 && newest != gDisplayedAppFrame && isEGLFenceSignaled(gAppFrames[newest].fence)) {
+                destroyEGLFence(gAppFrames[newest].fence);
+                gAppFrames[newest].fence = nullptr;
+                if (gDisplayedAppFrame >= 0) {
+                    gReleaseFences[gDisplayedAppFrame] = createReleaseFence();
+                }
+                gDisplayedAppFrame = newest;
+                fresh = true;
+            }
+            shown = gDisplayedAppFrame;
+        }
+        gAppCondition.notify_one();
+        if (shown < 0) {
+            // nothing to show before the app's first frame
+            return;
+        }
+        // the app thread leaves the set it's shown from alone
+        const AppFrame &frame = gAppFrames[shown];
+        OSVR_RenderInfoCount eyeCount = frame.eyeCount < numRenderInfo ? frame.eyeCount : numRenderInfo;
+
+        // Without the distortion mesh, presentEyes draws the layers into the
+        // set it presents. The app's own sets are what later frames are
+        // reprojected from, so a fresh frame with layers is copied to the
+        // reprojection set as it is and presented from there.
+        bool copyFresh = fresh && hasQuadLayers() && !isDistortionMeshReady();
+        if (fresh && !copyFresh) {
+            // as rendered; RenderManager's own time warp takes it from there
+            presentEyes(static_cast<size_t>(shown), frame.renderInfos, frame.views, eyeCount, renderParams,
+                        sceneViews, frame.renderScale);
+        } else {
+            OSVR_FRAME_STAGE_BEGIN(FRAME_STAGE_REPROJECTION);
+            const OSVR_RenderInfoOpenGL *targetRenderInfos = copyFresh ? frame.renderInfos : renderInfos;
+            const SceneView *targetViews = copyFresh ? frame.views : sceneViews;
+            for (OSVR_RenderInfoCount eye = 0; eye < eyeCount; eye++) {
+                const OSVR_RenderInfoOpenGL &currentRenderInfo = targetRenderInfos[eye];
+                const OSVR_RenderTargetInfo &target = renderTarget(kReprojectionTargetSet, eye);
+                glBindFramebuffer(GL_FRAMEBUFFER, target.frameBufferName);
+                glViewport(static_cast<GLint>(currentRenderInfo.viewport.left),
+                           static_cast<GLint>(currentRenderInfo.viewport.lower),
+                           static_cast<GLsizei>(currentRenderInfo.viewport.width),
+                           static_cast<GLsizei>(currentRenderInfo.viewport.height));
+                GLfloat homography[9];
+                computeReprojectionHomography(frame.views[eye].projection, frame.views[eye].view,
+                                              targetViews[eye].view, homography);
+                drawReprojection(renderTarget(shown, eye).colorBufferName, homography, frame.renderScale);
+                glBindFramebuffer(GL_FRAMEBUFFER, gFrameBuffer);
+            }
+            checkGlError("reprojection");
+            OSVR_FRAME_STAGE_END(FRAME_STAGE_REPROJECTION);
+            presentEyes(kReprojectionTargetSet, targetRenderInfos, targetViews, eyeCount, renderParams, sceneViews,
+                        1.0f);
+        }
+        latencySubmitted();
+        countDisplayFrame(fresh);
+    }
+
+    static void updateEyeBufferSamples();
+
+    // Starts or stops the app thread to match the async reprojection switch,
+    // with the eye buffers each needs.
+    static void updateAsyncReprojection() {
+        if (gAppThreadRunning && gAppThreadFailed.load()) {
+            stopAppThread();
+            gAsyncReprojectionUnavailable = true;
+        }
+        bool wanted = isAsyncReprojectionEnabled() && !gAsyncReprojectionUnavailable;
+        if (!wanted && gAppThreadRunning) {
+            stopAppThread();
+        }
+        if (gRenderTargetSets != wantedRenderTargetSets()) {
+            stopAppThread();
+            releaseRenderManagerResource();
+            if (!setupRenderManager()) {
+                LOGE("[Reprojection] Could not set up the RenderManager for %u sets of eye buffers.",
+                     static_cast<unsigned>(wantedRenderTargetSets()));
+                return;
+            }
+            LOGI("[Reprojection] Eye buffer sets: %u.", static_cast<unsigned>(gRenderTargetSets));
+            // the new eye buffers start out single-sampled
+            updateEyeBufferSamples();
+        }
+        if (wanted && !gAppThreadRunning) {
+            startAppThread();
+        }
+    }
+
+    void setEyeBufferSamples(int samples) {
+        gRequestedEyeBufferSamples.store(samples > 1 ? samples : 1, std::memory_order_relaxed);
+    }
+
+    // Gives the eye buffers the MSAA asked for, as far as the quality tier and
+    // the context allow. GL thread only.
+    static void updateEyeBufferSamples() {
+        int samples = std::min(gRequestedEyeBufferSamples.load(std::memory_order_relaxed),
+                               gEyeBufferSampleCap.load(std::memory_order_relaxed));
+        samples = std::max(1, std::min(samples, static_cast<int>(gMaxEyeBufferSamples)));
+        if (samples == gEyeBufferSamples) {
+            return;
+        }
+        // its framebuffers get the new count when updateAsyncReprojection() starts it again
+        stopAppThread();
+        size_t sets = std::min(static_cast<size_t>(kAppFrameSets), gRenderTargetSets);
+        for (size_t set = 0; set < sets; set++) {
+            for (size_t eye = 0; eye < gEyeCount; eye++) {
+                const OSVR_RenderTargetInfo &target = renderTarget(set, eye);
+                glBindRenderbuffer(GL_RENDERBUFFER, target.renderBufferName);
+                if (samples > 1) {
+                    gRenderbufferStorageMultisample(GL_RENDERBUFFER, samples, GL_DEPTH_COMPONENT16,
+                                                    target.width, target.height);
+                } else {
+                    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT16, target.width, target.height);
+                }
+                trackGpuObject(GPU_OBJECT_RENDERBUFFER, target.renderBufferName, GPU_MEMORY_RENDER_TARGETS,
+                               static_cast<uint64_t>(target.width) * target.height * 2 * samples);
+                attachEyeBuffer(target.frameBufferName, target, samples);
+            }
+        }
+        glBindRenderbuffer(GL_RENDERBUFFER, 0);
+        glBindFramebuffer(GL_FRAMEBUFFER, gFrameBuffer);
+        checkGlError("updateEyeBufferSamples");
+        LOGI("[OSVR] Eye buffers drawn with %dx MSAA (was %dx).", samples, gEyeBufferSamples);
+        gEyeBufferSamples = samples;
+    }
+
+    // What the quality tier turns down, from the next frame on.
+    static void applyQualityTier(const QualityTier &tier) {
+        gRenderScale.store(tier.renderScale, std::memory_order_relaxed);
+        gEyeBufferSampleCap.store(tier.maxEyeBufferSamples, std::memory_order_relaxed);
+        gCameraUploadInterval.store(tier.cameraUploadInterval, std::memory_order_relaxed);
+        setSceneAnimationInterval(tier.sceneAnimationInterval);
+    }
+
+/**
+ * Just the current frame in the display.
+ */
+    void renderFrame() {
+        if(!gOSVRInitialized) {
+            // @todo implement some logging/error handling?
+            return;
+        }
+
+        // this call is idempotent, so we can make it every frame.
+        // have to ensure render manager is setup from the rendering thread with
+        // a current GLES context, so this is a lazy setup call
+        if(!setupRenderManager()) {
+            // @todo implement some logging/error handling?
+            return;
+        }
+        updateEyeBufferSamples();
+        updateCameraLayer();
+        updateAsyncReprojection();
+
+        // may wait for the GPU, and then for the just-in-time start
+        framePacerBeginFrame();
+
+        OSVR_FRAME_STAGE_BEGIN(FRAME_STAGE_FRAME);
+        gFrameArena.reset();
+        gpuProfilerBeginFrame();
+        latencyBeginFrame();
+        frameCaptureBeginFrame();
+        glUseProgram(gProgram);
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+        glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+        checkGlError("glClearColor");
+        glViewport(0, 0, gWidth, gHeight);
+        glClear(GL_DEPTH_BUFFER_BIT | GL_COLOR_BUFFER_BIT);
+        checkGlError("glClear");
+
+        for(GLint i = 0; i < gMaxVertexAttribs; i++) {
+            glDisableVertexAttribArray(static_cast<GLuint>(i));
+        }
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+        //bindVertexArrayOES(0);
+
+        if (gRenderManager && gClientContext) {
+            if (gAppThreadRunning) {
+                displayFrame();
+            } else {
+                renderAndPresentFrame();
+            }
+            lifecycleFramePresented();
+            captureFramebuffer(FRAME_CAPTURE_WINDOW, 0, gFrameBuffer, 0, 0, gWidth, gHeight);
+        }
+        frameCaptureEndFrame();
+
+        gpuProfilerEndFrame();
+        framePacerEndFrame();
+
+        // the frame's CPU work plus its wait for the GPU; with async
+        // reprojection the app thread's frames are the ones that can run late
+        FramePacerStats pacing;
+        getFramePacerStats(&pacing);
+        uint64_t frameCostNs = pacing.lastWorkNs + pacing.lastStallNs;
+        if (gAppThreadRunning) {
+            frameCostNs = std::max(frameCostNs, gLastAppFrameNs.load(std::memory_order_relaxed));
+        }
+        applyQualityTier(thermalGovernorFrame(frameCostNs, pacing.displayPeriodNs));
+        OSVR_TRACE_COUNTER("inputEventsQueued", static_cast<double>(gInputEvents.size()));
+        OSVR_FRAME_STAGE_END(FRAME_STAGE_FRAME);
+        OSVR_FRAME_STATS_END_FRAME();
+    }
+
+
+    void pause() {
+        LOGI("[Lifecycle] Pausing.");
+        // its shared context would keep running against a surface that may go away
+        stopAppThread();
+        lifecyclePause();
+    }
+
+    void resume() {
+        LOGI("[Lifecycle] Resuming.");
+        lifecycleResume();
+    }
+
+    void stop() {
+        LOGI("[OSVR] Shutting down...");
+
+        // already stopped if the activity paused first
+        stopAppThread();
+        lifecycleStop();
+        // left over if the context was not current: it goes with the context
+        if (gRenderManager) {
+            osvrDestroyRenderManager(gRenderManager);
+            gRenderManager = gRenderManagerOGL = nullptr;
+        }
+        gRenderTargets.clear();
+        gRenderTargetSets = 0;
+        gRenderManagerInitialized = false;
+
+        // is this needed? Maybe not. the display config manages the lifetime.
+        if (gClientContext != nullptr) {
+            osvrClientShutdown(gClientContext);
+            gClientContext = nullptr;
+            gHead = NULL;
+        }
+        gOSVRInitialized = false;
+        gInputEvents.clear();
+        stopRecording();
+
+        osvrClientReleaseAutoStartedServer();
+    }
+}
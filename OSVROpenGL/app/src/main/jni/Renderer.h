@@ -0,0 +1,86 @@
+/*
+ * Copyright (C) 2015 Sensics, Inc. and contributors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef OSVROPENGL_RENDERER_H
+#define OSVROPENGL_RENDERER_H
+
+#include <cstddef>
+#include <cstdint>
+
+// The platform independent rendering core. main.cpp exposes it to Java through
+// JNI; the host build (see OSVROpenGL/host) drives it directly.
+namespace OSVROpenGL {
+
+    // Called for each new surface. Builds the GL resources if the context is
+    // new, and otherwise only rebuilds those that are stale (see Lifecycle.h).
+    // GL thread only.
+    bool setupGraphics(int width, int height);
+
+    // Starts the OSVR client context and registers the report callbacks. Idempotent.
+    bool setupOSVR();
+
+    // Renders and presents one frame. GL thread only.
+    void renderFrame();
+
+    // The activity is pausing: stops async reprojection's app thread and keeps
+    // the GL resources and the OSVR client for resume(). GL thread only.
+    void pause();
+    // The activity is resuming; the time to the first frame after it is
+    // logged and kept in the lifecycle stats. Any thread.
+    void resume();
+
+    // Releases the GL resources (if their context is current), RenderManager
+    // and the OSVR client. The next setupGraphics() and setupOSVR() start over.
+    void stop();
+
+    // Stops async reprojection's app thread (see Reprojection.h) if it is
+    // running; renderFrame() starts it again while the switch is on. GL thread only.
+    void stopAsyncReprojection();
+
+    // Testing aid: makes every everyNFrames-th frame's rendering take delayMs
+    // longer, like a scene too heavy for the display. 0 turns it off.
+    void setSimulatedFrameDelay(uint32_t delayMs, uint32_t everyNFrames);
+
+    // A KTX texture (see CompressedTexture.h) for the cubes instead of the
+    // camera feed; null or empty (the default) for the camera feed. Call while
+    // the GL thread is paused or not yet started; applied at the next surface
+    // change.
+    void setSceneTexturePath(const char *path);
+
+    // Shows the camera feed on a head-locked quad layer (see Layers.h),
+    // composited in the present step, instead of on the cubes, which go
+    // white. Off by default. Any thread; applied at the next frame.
+    void setCameraLayerEnabled(bool enabled);
+
+    // MSAA for the eye buffers, where the context has
+    // EXT_multisampled_render_to_texture; 1 (the default) for none. The
+    // thermal governor's quality tiers (see ThermalGovernor.h) may lower it.
+    // Any thread; applied at the next frame.
+    void setEyeBufferSamples(int samples);
+
+    // The external image stream (see ExternalImage.h) camera frames can come
+    // in on as producer-owned buffers, imported instead of copied where the
+    // context can. Once it has had a frame, the camera layer shows its frames
+    // instead of the OSVR imaging interface's, so the layer must be on.
+    static const uint32_t kCameraImageStream = 0;
+
+    // Copies pending input events into buffer, see InputEventQueue.h.
+    // Returns the number of events written.
+    int drainInputEvents(void *buffer, size_t bufferBytes);
+}
+
+#endif // OSVROPENGL_RENDERER_H
@@ -0,0 +1,290 @@
+/*
+ * Copyright (C) 2015 Sensics, Inc. and contributors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include <atomic>
+
+#include <EGL/egl.h>
+#include <GLES2/gl2.h>
+
+#include "Logging.h"
+#include "GLExtensions.h"
+#include "Reprojection.h"
+#include "Trace.h"
+
+namespace OSVROpenGL {
+
+    static std::atomic<bool> gAsyncReprojectionEnabled(false);
+    static std::atomic<uint64_t> gAppFrames(0);
+    static std::atomic<uint64_t> gFreshFrames(0);
+    static std::atomic<uint64_t> gReprojectedFrames(0);
+
+    // The pass' program; shared by every context that shares with the one it
+    // was made in.
+    static GLuint gReprojectionProgram = 0;
+    static GLint gHomographyUniform = -1;
+    static GLint gSourceScaleUniform = -1;
+
+    static const char gReprojectionVertexShader[] =
+            "uniform mat3 homography;\n"
+            "attribute vec2 position;\n"
+            "varying vec3 sourcePoint;\n"
+            "void main() {\n"
+            "  gl_Position = vec4(position, 0.0, 1.0);\n"
+            "  // linear in screen space, so it can be interpolated before the divide\n"
+            "  sourcePoint = homography * vec3(position, 1.0);\n"
+            "}\n";
+
+    static const char gReprojectionFragmentShader[] =
+            "#ifdef GL_FRAGMENT_PRECISION_HIGH\n"
+            "precision highp float;\n"
+            "#else\n"
+            "precision mediump float;\n"
+            "#endif\n"
+            "uniform sampler2D source;\n"
+            "uniform float sourceScale;\n"
+            "varying vec3 sourcePoint;\n"
+            "void main() {\n"
+            "  vec2 uv = sourcePoint.xy / sourcePoint.z * 0.5 + 0.5;\n"
+            "  if (sourcePoint.z <= 0.0 || any(lessThan(uv, vec2(0.0))) || any(greaterThan(uv, vec2(1.0)))) {\n"
+            "    gl_FragColor = vec4(0.0, 0.0, 0.0, 1.0);\n"
+            "  } else {\n"
+            "    gl_FragColor = texture2D(source, uv * sourceScale);\n"
+            "  }\n"
+            "}\n";
+
+    static const GLfloat gFullScreenQuad[] = { -1.0f, -1.0f, 1.0f, -1.0f, -1.0f, 1.0f, 1.0f, 1.0f };
+
+    void setAsyncReprojectionEnabled(bool enabled) {
+        gAsyncReprojectionEnabled.store(enabled, std::memory_order_relaxed);
+    }
+
+    bool isAsyncReprojectionEnabled() {
+        return gAsyncReprojectionEnabled.load(std::memory_order_relaxed);
+    }
+
+    void getReprojectionStats(ReprojectionStats *statsOut) {
+        statsOut->appFrames = gAppFrames.load(std::memory_order_relaxed);
+        statsOut->freshFrames = gFreshFrames.load(std::memory_order_relaxed);
+        statsOut->reprojectedFrames = gReprojectedFrames.load(std::memory_order_relaxed);
+    }
+
+    void resetReprojectionStats() {
+        gAppFrames.store(0, std::memory_order_relaxed);
+        gFreshFrames.store(0, std::memory_order_relaxed);
+        gReprojectedFrames.store(0, std::memory_order_relaxed);
+    }
+
+    void countAppFrame() {
+        gAppFrames.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    void countDisplayFrame(bool fresh) {
+        if (fresh) {
+            gFreshFrames.fetch_add(1, std::memory_order_relaxed);
+        } else {
+            uint64_t reprojected = gReprojectedFrames.fetch_add(1, std::memory_order_relaxed) + 1;
+            OSVR_TRACE_COUNTER("reprojectedFrames", static_cast<double>(reprojected));
+            (void) reprojected;     // only traced
+        }
+    }
+
+    bool createSharedGLContext(SharedGLContext *contextOut) {
+        contextOut->display = EGL_NO_DISPLAY;
+        contextOut->context = EGL_NO_CONTEXT;
+        contextOut->surface = EGL_NO_SURFACE;
+
+        EGLDisplay display = eglGetCurrentDisplay();
+        EGLContext shareContext = eglGetCurrentContext();
+        if (display == EGL_NO_DISPLAY || shareContext == EGL_NO_CONTEXT) {
+            LOGE("[Reprojection] No current context to share with.");
+            return false;
+        }
+
+        // same config as the context being shared with, so the two are compatible
+        EGLint configId = 0;
+        eglQueryContext(display, shareContext, EGL_CONFIG_ID, &configId);
+        const EGLint configAttribs[] = { EGL_CONFIG_ID, configId, EGL_NONE };
+        EGLConfig config;
+        EGLint configCount = 0;
+        if (!eglChooseConfig(display, configAttribs, &config, 1, &configCount) || configCount < 1) {
+            LOGE("[Reprojection] Could not find EGL config %d (error 0x%x).", configId, eglGetError());
+            return false;
+        }
+
+        const EGLint contextAttribs[] = { EGL_CONTEXT_CLIENT_VERSION, 2, EGL_NONE };
+        EGLContext context = eglCreateContext(display, config, shareContext, contextAttribs);
+        if (context == EGL_NO_CONTEXT) {
+            LOGE("[Reprojection] Could not create a shared context (error 0x%x).", eglGetError());
+            return false;
+        }
+
+        EGLSurface surface = EGL_NO_SURFACE;
+        if (!hasEGLExtension(display, "EGL_KHR_surfaceless_context")) {
+            const EGLint surfaceAttribs[] = { EGL_WIDTH, 1, EGL_HEIGHT, 1, EGL_NONE };
+            surface = eglCreatePbufferSurface(display, config, surfaceAttribs);
+            if (surface == EGL_NO_SURFACE) {
+                LOGE("[Reprojection] No surfaceless contexts and no pbuffer (error 0x%x).", eglGetError());
+                eglDestroyContext(display, context);
+                return false;
+            }
+        }
+
+        contextOut->display = display;
+        contextOut->context = context;
+        contextOut->surface = surface;
+        return true;
+    }
+
+    bool makeSharedGLContextCurrent(const SharedGLContext *context) {
+        if (!context) {
+            EGLDisplay display = eglGetCurrentDisplay();
+            return display == EGL_NO_DISPLAY ||
+                   eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT) == EGL_TRUE;
+        }
+        if (!eglMakeCurrent(context->display, context->surface, context->surface, context->context)) {
+            LOGE("[Reprojection] eglMakeCurrent failed (error 0x%x).", eglGetError());
+            return false;
+        }
+        return true;
+    }
+
+    void destroySharedGLContext(SharedGLContext *context) {
+        if (context->display == EGL_NO_DISPLAY) {
+            return;
+        }
+        if (context->context != EGL_NO_CONTEXT) {
+            eglDestroyContext(context->display, context->context);
+        }
+        if (context->surface != EGL_NO_SURFACE) {
+            eglDestroySurface(context->display, context->surface);
+        }
+        context->display = EGL_NO_DISPLAY;
+        context->context = EGL_NO_CONTEXT;
+        context->surface = EGL_NO_SURFACE;
+    }
+
+    void computeReprojectionHomography(const float *projection, const float *renderedView,
+                                       const float *newView, float *homographyOut) {
+        // K maps an eye space direction to homogeneous NDC xy
+        double a = projection[0];
+        double b = projection[5];
+        double c = projection[8];
+        double d = projection[9];
+        const double k[3][3] = { { a, 0.0, c }, { 0.0, b, d }, { 0.0, 0.0, -1.0 } };
+        const double kInverse[3][3] = { { 1.0 / a, 0.0, c / a }, { 0.0, 1.0 / b, d / b }, { 0.0, 0.0, -1.0 } };
+
+        // Rold * Rnew^T: the new eye's directions in the rendered eye's space
+        double rotation[3][3];
+        for (int row = 0; row < 3; row++) {
+            for (int col = 0; col < 3; col++) {
+                double sum = 0.0;
+                for (int i = 0; i < 3; i++) {
+                    sum += static_cast<double>(renderedView[i * 4 + row]) * newView[i * 4 + col];
+                }
+                rotation[row][col] = sum;
+            }
+        }
+
+        double kRotation[3][3];
+        for (int row = 0; row < 3; row++) {
+            for (int col = 0; col < 3; col++) {
+                kRotation[row][col] = k[row][0] * rotation[0][col] + k[row][1] * rotation[1][col] +
+                                      k[row][2] * rotation[2][col];
+            }
+        }
+        for (int row = 0; row < 3; row++) {
+            for (int col = 0; col < 3; col++) {
+                double value = kRotation[row][0] * kInverse[0][col] + kRotation[row][1] * kInverse[1][col] +
+                               kRotation[row][2] * kInverse[2][col];
+                homographyOut[col * 3 + row] = static_cast<float>(value);
+            }
+        }
+    }
+
+    static GLuint compileShader(GLenum type, const char *source) {
+        GLuint shader = glCreateShader(type);
+        if (!shader) {
+            return 0;
+        }
+        glShaderSource(shader, 1, &source, nullptr);
+        glCompileShader(shader);
+        GLint compiled = 0;
+        glGetShaderiv(shader, GL_COMPILE_STATUS, &compiled);
+        if (!compiled) {
+            char log[512] = {0};
+            glGetShaderInfoLog(shader, sizeof(log), nullptr, log);
+            LOGE("[Reprojection] Could not compile shader %d:\n%s", type, log);
+            glDeleteShader(shader);
+            return 0;
+        }
+        return shader;
+    }
+
+    bool initReprojectionPass() {
+        gReprojectionProgram = 0;
+        GLuint vertexShader = compileShader(GL_VERTEX_SHADER, gReprojectionVertexShader);
+        GLuint fragmentShader = compileShader(GL_FRAGMENT_SHADER, gReprojectionFragmentShader);
+        if (!vertexShader || !fragmentShader) {
+            glDeleteShader(vertexShader);
+            glDeleteShader(fragmentShader);
+            return false;
+        }
+        GLuint program = glCreateProgram();
+        glAttachShader(program, vertexShader);
+        glAttachShader(program, fragmentShader);
+        glBindAttribLocation(program, 0, "position");
+        glLinkProgram(program);
+        // flagged for deletion; they go when the program does
+        glDeleteShader(vertexShader);
+        glDeleteShader(fragmentShader);
+        GLint linked = GL_FALSE;
+        glGetProgramiv(program, GL_LINK_STATUS, &linked);
+        if (linked != GL_TRUE) {
+            char log[512] = {0};
+            glGetProgramInfoLog(program, sizeof(log), nullptr, log);
+            LOGE("[Reprojection] Could not link program:\n%s", log);
+            glDeleteProgram(program);
+            return false;
+        }
+        gHomographyUniform = glGetUniformLocation(program, "homography");
+        gSourceScaleUniform = glGetUniformLocation(program, "sourceScale");
+        glUseProgram(program);
+        glUniform1i(glGetUniformLocation(program, "source"), 0);
+        gReprojectionProgram = program;
+        return true;
+    }
+
+    void releaseReprojectionPass() {
+        glDeleteProgram(gReprojectionProgram);
+        gReprojectionProgram = 0;
+    }
+
+    void drawReprojection(GLuint sourceTexture, const float *homography, float sourceScale) {
+        if (!gReprojectionProgram) {
+            return;
+        }
+        glUseProgram(gReprojectionProgram);
+        glUniformMatrix3fv(gHomographyUniform, 1, GL_FALSE, homography);
+        glUniform1f(gSourceScaleUniform, sourceScale);
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_2D, sourceTexture);
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 0, gFullScreenQuad);
+        glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+        glDisableVertexAttribArray(0);
+    }
+}
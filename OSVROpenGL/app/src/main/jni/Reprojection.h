@@ -0,0 +1,90 @@
+/*
+ * Copyright (C) 2015 Sensics, Inc. and contributors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef OSVROPENGL_REPROJECTION_H
+#define OSVROPENGL_REPROJECTION_H
+
+#include <cstdint>
+
+#include <EGL/egl.h>
+#include <GLES2/gl2.h>
+
+namespace OSVROpenGL {
+
+    // Asynchronous reprojection. When it is on, the app's frames (camera
+    // upload, scene update and eye passes) are drawn on a thread of their own
+    // into double-buffered eye targets, and renderFrame() becomes the display
+    // side: every display frame it takes the newest head pose and presents the
+    // newest finished app frame, or, when the app missed the frame, re-renders
+    // the last finished one rotated to the new pose. The rotation is a single
+    // full-screen pass per eye through a homography, so it costs the same
+    // whatever the scene does.
+    //
+    // On Android only the GLSurfaceView's thread can present to the window,
+    // which is why it is the app's frames that move to a new thread rather
+    // than the reprojection. The switch is checked at the start of each
+    // renderFrame(), so it can be flipped at any time from any thread.
+    void setAsyncReprojectionEnabled(bool enabled);
+    bool isAsyncReprojectionEnabled();
+
+    struct ReprojectionStats {
+        uint64_t appFrames;         // frames the app thread finished
+        uint64_t freshFrames;       // display frames that showed a new app frame
+        uint64_t reprojectedFrames; // display frames that reused an old one
+    };
+
+    void getReprojectionStats(ReprojectionStats *statsOut);
+    void resetReprojectionStats();
+    // Counted by the renderer; any thread.
+    void countAppFrame();
+    void countDisplayFrame(bool fresh);
+
+    // A context sharing objects with the one current on the calling thread,
+    // for drawing on another thread. Bound without a surface when
+    // EGL_KHR_surfaceless_context is there, to a 1x1 pbuffer otherwise.
+    struct SharedGLContext {
+        EGLDisplay display;
+        EGLContext context;
+        EGLSurface surface;
+    };
+
+    bool createSharedGLContext(SharedGLContext *contextOut);
+    // Binds the context to (or with null, releases it from) the calling thread.
+    bool makeSharedGLContextCurrent(const SharedGLContext *context);
+    // The context must not be current anywhere.
+    void destroySharedGLContext(SharedGLContext *context);
+
+    // The rotation-only reprojection from the pose an eye was rendered with to
+    // a newer one, as a homography between their normalized device
+    // coordinates: H = K * Rold * Rnew^T * K^-1, where K is the xy/w part of
+    // the (off-axis, perspective) projection and the R are the rotations in
+    // the view matrices. All matrices are column-major; homographyOut is a
+    // column-major 3x3 for glUniformMatrix3fv. Translation is ignored, which
+    // is right for everything far enough away and the usual trade.
+    void computeReprojectionHomography(const float *projection, const float *renderedView,
+                                       const float *newView, float *homographyOut);
+
+    // Compiles the pass' program; call with each new context current.
+    bool initReprojectionPass();
+    void releaseReprojectionPass();
+    // Draws sourceTexture warped by the homography over the current viewport.
+    // What the old frame never saw is black. The frame was drawn into the
+    // sourceScale by sourceScale corner of the texture, at the origin.
+    void drawReprojection(GLuint sourceTexture, const float *homography, float sourceScale);
+}
+
+#endif // OSVROPENGL_REPROJECTION_H
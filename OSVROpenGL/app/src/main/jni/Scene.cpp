@@ -0,0 +1,311 @@
+/*
+ * Copyright (C) 2015 Sensics, Inc. and contributors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include <atomic>
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+#include "CpuDispatch.h"
+#include "Logging.h"
+#include "JobSystem.h"
+#include "Scene.h"
+#include "Trace.h"
+
+namespace OSVROpenGL {
+
+    // Objects per unit of parallel work. Every pass writes its results per
+    // chunk, so the output doesn't depend on how the chunks were shared out.
+    static const uint32_t kSceneChunkSize = 256;
+    // The scene advances a fixed step per frame, so runs are reproducible.
+    static const float kSceneTimeStepSeconds = 1.0f / 60.0f;
+    // Spinning cubes are spread through a shell around the viewer, inside the room cube.
+    static const float kSceneInnerRadius = 0.4f;
+    static const float kSceneOuterRadius = 0.9f;
+    static const float kSceneMinScale = 0.01f;
+    static const float kSceneMaxScale = 0.04f;
+    static const float kSceneMaxAngularSpeed = 3.0f;   // rad/s
+
+    typedef SpinningObject SceneObject;
+    typedef BoundingSphere SceneBounds;
+
+    static std::atomic<uint32_t> gRequestedObjectCount(1);
+    static std::atomic<uint32_t> gRequestedMaterialCount(0);
+    static uint32_t gMaterialCount = 0;
+    static std::atomic<uint32_t> gAnimationInterval(1);
+    static std::atomic<int> gRequestedWorkerThreads(-1);
+    static int gStartedWorkerThreads = 0;
+
+    static std::vector<SceneObject> gObjects;
+    static std::vector<float> gModels;                  // 16 per object
+    static std::vector<uint32_t> gMaterials;
+    static std::vector<SceneBounds> gBounds;
+    static std::vector<uint8_t> gVisibility;            // bit per view, per object
+    static std::vector<uint32_t> gChunkOffsets;         // per view, per chunk
+    static std::vector<SceneDrawCommand> gDrawLists[kSceneMaxViews];
+    static uint32_t gDrawListSizes[kSceneMaxViews];
+    static uint32_t gChunkCount = 0;
+
+    static float gFrustumPlanes[kSceneMaxViews][6][4];
+    static uint32_t gViewCount = 0;
+    static uint32_t gSceneFrame = 0;
+    static float gSceneTimeSeconds = 0.0f;
+    static Job *gAnimationJob = nullptr;
+
+    // xorshift32, so the scene is the same on every device.
+    static uint32_t nextRandom(uint32_t *state) {
+        uint32_t x = *state;
+        x ^= x << 13;
+        x ^= x >> 17;
+        x ^= x << 5;
+        *state = x;
+        return x;
+    }
+
+    static float randomRange(uint32_t *state, float low, float high) {
+        return low + (high - low) * static_cast<float>(nextRandom(state) >> 8) / 16777216.0f;
+    }
+
+    static void createScene(uint32_t objectCount, uint32_t materialCount) {
+        gObjects.resize(objectCount);
+        gModels.resize(objectCount * 16);
+        gMaterials.resize(objectCount);
+        gMaterialCount = materialCount;
+        gBounds.resize(objectCount);
+        gVisibility.resize(objectCount);
+        gChunkCount = (objectCount + kSceneChunkSize - 1) / kSceneChunkSize;
+        gChunkOffsets.resize(gChunkCount * kSceneMaxViews);
+        for (uint32_t view = 0; view < kSceneMaxViews; view++) {
+            gDrawLists[view].resize(objectCount);
+            gDrawListSizes[view] = 0;
+        }
+        gViewCount = 0;
+        gSceneFrame = 0;
+
+        // The room cube: the unit cube around the viewer, standing still.
+        SceneObject room = {{0.0f, 0.0f, 0.0f}, 1.0f, {0.0f, 1.0f, 0.0f}, 0.0f};
+        gObjects[0] = room;
+        gMaterials[0] = kSceneNoMaterial;
+
+        uint32_t random = 0x9e3779b9u;
+        for (uint32_t i = 1; i < objectCount; i++) {
+            SceneObject &object = gObjects[i];
+            // uniform direction, then a distance within the shell
+            float z = randomRange(&random, -1.0f, 1.0f);
+            float azimuth = randomRange(&random, 0.0f, 6.2831853f);
+            float ring = std::sqrt(1.0f - z * z);
+            float distance = randomRange(&random, kSceneInnerRadius, kSceneOuterRadius);
+            object.position[0] = ring * std::cos(azimuth) * distance;
+            object.position[1] = ring * std::sin(azimuth) * distance;
+            object.position[2] = z * distance;
+            object.scale = randomRange(&random, kSceneMinScale, kSceneMaxScale);
+
+            float axisZ = randomRange(&random, -1.0f, 1.0f);
+            float axisAzimuth = randomRange(&random, 0.0f, 6.2831853f);
+            float axisRing = std::sqrt(1.0f - axisZ * axisZ);
+            object.axis[0] = axisRing * std::cos(axisAzimuth);
+            object.axis[1] = axisRing * std::sin(axisAzimuth);
+            object.axis[2] = axisZ;
+            object.angularSpeed = randomRange(&random, -kSceneMaxAngularSpeed, kSceneMaxAngularSpeed);
+            gMaterials[i] = materialCount ? (i - 1) % materialCount : kSceneNoMaterial;
+        }
+        LOGI("[Scene] Created %u objects in %u chunks, %u materials", objectCount, gChunkCount, materialCount);
+    }
+
+    static void chunkObjects(uint32_t chunk, uint32_t *beginOut, uint32_t *endOut) {
+        uint32_t objectCount = static_cast<uint32_t>(gObjects.size());
+        *beginOut = chunk * kSceneChunkSize;
+        *endOut = *beginOut + kSceneChunkSize < objectCount ? *beginOut + kSceneChunkSize : objectCount;
+    }
+
+    // Model matrix (translate * rotate * scale) and bounding sphere of each object.
+    static void animateChunks(uint32_t beginChunk, uint32_t endChunk, void *userdata) {
+        OSVR_TRACE_SCOPE("sceneAnimate");
+        uint32_t begin, end, unused;
+        chunkObjects(beginChunk, &begin, &unused);
+        chunkObjects(endChunk - 1, &unused, &end);
+        cpuKernels().animateSpinningObjects(&gObjects[begin], end - begin, gSceneTimeSeconds,
+                                            &gModels[begin * 16], &gBounds[begin]);
+    }
+
+    // Clip planes of projection * view (Gribb & Hartmann), normalized so the
+    // plane equation gives the signed distance.
+    static void computeFrustumPlanes(const SceneView &view, float planesOut[6][4]) {
+        float clip[16];
+        for (int column = 0; column < 4; column++) {
+            for (int row = 0; row < 4; row++) {
+                float sum = 0.0f;
+                for (int k = 0; k < 4; k++) {
+                    sum += view.projection[k * 4 + row] * view.view[column * 4 + k];
+                }
+                clip[column * 4 + row] = sum;
+            }
+        }
+        for (int plane = 0; plane < 6; plane++) {
+            int row = plane / 2;
+            float sign = (plane & 1) ? -1.0f : 1.0f;
+            for (int column = 0; column < 4; column++) {
+                planesOut[plane][column] = clip[column * 4 + 3] + sign * clip[column * 4 + row];
+            }
+            float length = std::sqrt(planesOut[plane][0] * planesOut[plane][0] +
+                                     planesOut[plane][1] * planesOut[plane][1] +
+                                     planesOut[plane][2] * planesOut[plane][2]);
+            if (length > 0.0f) {
+                for (int column = 0; column < 4; column++) {
+                    planesOut[plane][column] /= length;
+                }
+            }
+        }
+    }
+
+    // Which views each object is in, and how many objects each view gets per chunk.
+    static void cullChunks(uint32_t beginChunk, uint32_t endChunk, void *userdata) {
+        OSVR_TRACE_SCOPE("sceneCull");
+        const CpuKernels &kernels = cpuKernels();
+        for (uint32_t chunk = beginChunk; chunk < endChunk; chunk++) {
+            uint32_t begin, end;
+            chunkObjects(chunk, &begin, &end);
+            uint32_t counts[kSceneMaxViews] = {0};
+            kernels.cullSpheres(&gBounds[begin], end - begin, gFrustumPlanes, gViewCount,
+                                &gVisibility[begin], counts);
+            for (uint32_t view = 0; view < gViewCount; view++) {
+                gChunkOffsets[view * gChunkCount + chunk] = counts[view];
+            }
+        }
+    }
+
+    // Copies each visible object's model matrix and material into the view's
+    // draw list, at the chunk's offset.
+    static void writeDrawListChunks(uint32_t beginChunk, uint32_t endChunk, void *userdata) {
+        OSVR_TRACE_SCOPE("sceneDrawLists");
+        for (uint32_t chunk = beginChunk; chunk < endChunk; chunk++) {
+            uint32_t begin, end;
+            chunkObjects(chunk, &begin, &end);
+            for (uint32_t view = 0; view < gViewCount; view++) {
+                SceneDrawCommand *out = &gDrawLists[view][gChunkOffsets[view * gChunkCount + chunk]];
+                uint8_t bit = static_cast<uint8_t>(1u << view);
+                for (uint32_t i = begin; i < end; i++) {
+                    if (gVisibility[i] & bit) {
+                        memcpy(out->model, &gModels[i * 16], sizeof(out->model));
+                        out->material = gMaterials[i];
+                        out++;
+                    }
+                }
+            }
+        }
+    }
+
+    static void waitForSceneWork() {
+        // a render thread that has gone away can't help, and its work is moot
+        if (gAnimationJob && currentJobWorker() == 0) {
+            waitForJob(gAnimationJob);
+        }
+        gAnimationJob = nullptr;
+    }
+
+    void setSceneObjectCount(uint32_t objectCount) {
+        gRequestedObjectCount.store(objectCount > 0 ? objectCount : 1);
+    }
+
+    void setSceneMaterialCount(uint32_t materialCount) {
+        gRequestedMaterialCount.store(materialCount);
+    }
+
+    void setSceneWorkerThreads(int workerThreads) {
+        gRequestedWorkerThreads.store(workerThreads);
+    }
+
+    void setSceneAnimationInterval(uint32_t frames) {
+        gAnimationInterval.store(frames > 0 ? frames : 1, std::memory_order_relaxed);
+    }
+
+    bool setupScene() {
+        int workerThreads = gRequestedWorkerThreads.load();
+        if (!isJobSystemRunning() || currentJobWorker() != 0 || workerThreads != gStartedWorkerThreads) {
+            waitForSceneWork();
+            stopJobSystem();
+            if (!startJobSystem(workerThreads)) {
+                return false;
+            }
+            gStartedWorkerThreads = workerThreads;
+        }
+        uint32_t objectCount = gRequestedObjectCount.load();
+        uint32_t materialCount = gRequestedMaterialCount.load();
+        if (objectCount != gObjects.size() || materialCount != gMaterialCount) {
+            waitForSceneWork();
+            createScene(objectCount, materialCount);
+        }
+        return true;
+    }
+
+    void shutdownScene() {
+        waitForSceneWork();
+        stopJobSystem();
+        gObjects.clear();
+        gChunkCount = 0;
+        gViewCount = 0;
+    }
+
+    uint32_t sceneObjectCount() {
+        return static_cast<uint32_t>(gObjects.size());
+    }
+
+    void beginSceneFrame() {
+        waitForSceneWork();
+        gViewCount = 0;
+        uint32_t frame = gSceneFrame++;
+        gSceneTimeSeconds = static_cast<float>(frame) * kSceneTimeStepSeconds;
+        uint32_t interval = gAnimationInterval.load(std::memory_order_relaxed);
+        if (interval > 1 && frame % interval != 0) {
+            return;
+        }
+        gAnimationJob = parallelFor(gChunkCount, 1, animateChunks, nullptr);
+    }
+
+    void buildSceneDrawLists(const SceneView *views, uint32_t viewCount) {
+        waitForSceneWork();
+        gViewCount = viewCount < kSceneMaxViews ? viewCount : kSceneMaxViews;
+        for (uint32_t view = 0; view < gViewCount; view++) {
+            computeFrustumPlanes(views[view], gFrustumPlanes[view]);
+        }
+
+        waitForJob(parallelFor(gChunkCount, 1, cullChunks, nullptr));
+
+        // per-chunk counts to offsets
+        for (uint32_t view = 0; view < gViewCount; view++) {
+            uint32_t offset = 0;
+            uint32_t *chunkOffsets = &gChunkOffsets[view * gChunkCount];
+            for (uint32_t chunk = 0; chunk < gChunkCount; chunk++) {
+                uint32_t count = chunkOffsets[chunk];
+                chunkOffsets[chunk] = offset;
+                offset += count;
+            }
+            gDrawListSizes[view] = offset;
+        }
+
+        waitForJob(parallelFor(gChunkCount, 1, writeDrawListChunks, nullptr));
+    }
+
+    const SceneDrawCommand *getSceneDrawList(uint32_t view, uint32_t *countOut) {
+        if (view >= gViewCount) {
+            *countOut = 0;
+            return nullptr;
+        }
+        *countOut = gDrawListSizes[view];
+        return gDrawLists[view].data();
+    }
+}
@@ -0,0 +1,85 @@
+/*
+ * Copyright (C) 2015 Sensics, Inc. and contributors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef OSVROPENGL_SCENE_H
+#define OSVROPENGL_SCENE_H
+
+#include <cstddef>
+#include <cstdint>
+
+namespace OSVROpenGL {
+
+    // The scene: the textured room cube plus any number of small spinning
+    // cubes around it. The per-frame CPU work (animation, model matrices,
+    // frustum culling against every eye and building the per-eye draw lists)
+    // runs on the job system; the render thread kicks it off, helps out while
+    // it waits, and then only walks the finished draw lists.
+    //
+    // Everything but the configuration setters must be called on the render
+    // thread. Nothing allocates per frame.
+
+    // Eyes the scene is culled for; any further eye gets an empty draw list.
+    static const uint32_t kSceneMaxViews = 4;
+
+    // Column-major matrices, as glUniformMatrix4fv takes them.
+    struct SceneView {
+        float view[16];
+        float projection[16];
+    };
+
+    // The material of an object without one: the room cube, and every object
+    // when there are no materials.
+    static const uint32_t kSceneNoMaterial = 0xFFFFFFFFu;
+
+    struct SceneDrawCommand {
+        float model[16];
+        uint32_t material;      // see Materials.h
+    };
+
+    // Objects including the room cube; 1 (just the room cube) by default.
+    // Applied by the next setupScene().
+    void setSceneObjectCount(uint32_t objectCount);
+    // Job worker threads besides the render thread; negative (the default)
+    // picks one per spare core. Applied by the next setupScene().
+    void setSceneWorkerThreads(int workerThreads);
+    // The spinning cubes take turns at materials 0 to materialCount - 1 (see
+    // Materials.h); 0 (the default) for none. Applied by the next setupScene().
+    void setSceneMaterialCount(uint32_t materialCount);
+    // The objects are animated every this many frames, and hold still in
+    // between; 1 (every frame) by default. Any thread; applied at the next frame.
+    void setSceneAnimationInterval(uint32_t frames);
+
+    // Builds the scene and starts the job system with the render thread as
+    // worker 0, or rebuilds whatever the configuration changed. Cheap when
+    // nothing did, so it can be called whenever the surface is (re)created.
+    bool setupScene();
+    // Waits for any outstanding work, stops the job system and drops the scene.
+    // Render thread only; idle workers just sleep, so the app leaves them be.
+    void shutdownScene();
+    uint32_t sceneObjectCount();
+
+    // Starts animating the scene for a new frame. Needs no head pose, so it
+    // runs while the render thread updates the client and uploads textures.
+    void beginSceneFrame();
+    // Culls the animated scene against each view and builds their draw lists,
+    // in object order. Returns once they are complete.
+    void buildSceneDrawLists(const SceneView *views, uint32_t viewCount);
+    // The draw list built for a view; valid until the next beginSceneFrame().
+    const SceneDrawCommand *getSceneDrawList(uint32_t view, uint32_t *countOut);
+}
+
+#endif // OSVROPENGL_SCENE_H
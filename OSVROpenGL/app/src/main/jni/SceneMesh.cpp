@@ -0,0 +1,369 @@
+/*
+ * Copyright (C) 2015 Sensics, Inc. and contributors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+#include "Logging.h"
+#include "SceneMesh.h"
+#include "FrameStats.h"
+#include "GLExtensions.h"
+#include "GpuMemory.h"
+#include "Lifecycle.h"
+
+#ifndef GL_HALF_FLOAT
+#define GL_HALF_FLOAT 0x140B
+#endif
+#ifndef GL_HALF_FLOAT_OES
+#define GL_HALF_FLOAT_OES 0x8D61
+#endif
+
+namespace OSVROpenGL {
+
+    static const char kSceneMeshMagic[8] = { 'O', 'S', 'V', 'R', 'M', 'S', 'H', '1' };
+
+    // Without half float attributes the texture coordinates are widened on
+    // upload, into this layout.
+    struct WideSceneMeshVertex {
+        int16_t position[4];
+        int8_t normal[4];
+        uint8_t color[4];
+        float uv[2];
+    };
+
+    static std::string gSceneMeshPath;
+
+    static GLuint gVertexBuffer = 0;
+    static GLuint gIndexBuffer = 0;
+    static GLenum gIndexType = GL_UNSIGNED_SHORT;
+    static GLenum gUVType = GL_FLOAT;
+    static GLsizei gVertexStride = 0;
+    static size_t gUVOffset = 0;
+    static SceneMeshInfo gInfo;
+    static float gPositionScale[3];
+    static float gPositionOffset[3];
+
+    static size_t alignToPage(size_t bytes) {
+        return (bytes + kSceneMeshFileAlignment - 1) / kSceneMeshFileAlignment * kSceneMeshFileAlignment;
+    }
+
+    uint16_t floatToHalf(float value) {
+        uint32_t bits;
+        memcpy(&bits, &value, sizeof(bits));
+        uint32_t sign = (bits >> 16) & 0x8000;
+        int32_t exponent = static_cast<int32_t>((bits >> 23) & 0xFF) - 127 + 15;
+        uint32_t mantissa = bits & 0x7FFFFF;
+        if (exponent >= 31) {
+            // overflow to infinity; NaN stays NaN
+            bool nan = ((bits >> 23) & 0xFF) == 0xFF && mantissa;
+            return static_cast<uint16_t>(sign | 0x7C00 | (nan ? 0x200 : 0));
+        }
+        if (exponent <= 0) {
+            if (exponent < -10) {
+                return static_cast<uint16_t>(sign);
+            }
+            // subnormal: shift the implicit one in and round to nearest even
+            mantissa |= 0x800000;
+            uint32_t shift = static_cast<uint32_t>(14 - exponent);
+            uint32_t half = mantissa >> shift;
+            uint32_t remainder = mantissa & ((1u << shift) - 1);
+            uint32_t halfway = 1u << (shift - 1);
+            if (remainder > halfway || (remainder == halfway && (half & 1))) {
+                half++;
+            }
+            return static_cast<uint16_t>(sign | half);
+        }
+        uint32_t half = (static_cast<uint32_t>(exponent) << 10) | (mantissa >> 13);
+        uint32_t remainder = mantissa & 0x1FFF;
+        if (remainder > 0x1000 || (remainder == 0x1000 && (half & 1))) {
+            half++;     // may carry into the exponent, up to infinity, as it should
+        }
+        return static_cast<uint16_t>(sign | half);
+    }
+
+    float halfToFloat(uint16_t value) {
+        uint32_t sign = static_cast<uint32_t>(value & 0x8000) << 16;
+        uint32_t exponent = (value >> 10) & 0x1F;
+        uint32_t mantissa = value & 0x3FF;
+        uint32_t bits;
+        if (exponent == 0) {
+            if (mantissa == 0) {
+                bits = sign;
+            } else {
+                // subnormal: normalize it
+                exponent = 127 - 15 + 1;
+                while (!(mantissa & 0x400)) {
+                    mantissa <<= 1;
+                    exponent--;
+                }
+                bits = sign | (exponent << 23) | ((mantissa & 0x3FF) << 13);
+            }
+        } else if (exponent == 31) {
+            bits = sign | 0x7F800000 | (mantissa << 13);
+        } else {
+            bits = sign | ((exponent - 15 + 127) << 23) | (mantissa << 13);
+        }
+        float result;
+        memcpy(&result, &bits, sizeof(result));
+        return result;
+    }
+
+    void transformSceneMeshUVs(SceneMeshVertex *vertices, size_t count, const float *transform) {
+        for (size_t i = 0; i < count; i++) {
+            for (int axis = 0; axis < 2; axis++) {
+                float uv = halfToFloat(vertices[i].uv[axis]);
+                vertices[i].uv[axis] = floatToHalf(uv * transform[axis] + transform[2 + axis]);
+            }
+        }
+    }
+
+    template <typename Index>
+    static bool indicesInRange(const void *indices, uint32_t indexCount, uint32_t vertexCount) {
+        const Index *index = static_cast<const Index *>(indices);
+        Index maxIndex = 0;
+        for (uint32_t i = 0; i < indexCount; i++) {
+            maxIndex = index[i] > maxIndex ? index[i] : maxIndex;
+        }
+        return maxIndex < vertexCount;
+    }
+
+    bool mapSceneMeshFile(const char *path, MappedSceneMesh *meshOut) {
+        memset(meshOut, 0, sizeof(*meshOut));
+        MappedAsset file;
+        if (!mapAsset(path, &file)) {
+            LOGE("[SceneMesh] Could not map %s.", path);
+            return false;
+        }
+        if (file.bytes < sizeof(SceneMeshFileHeader)) {
+            LOGE("[SceneMesh] %s is too short for a mesh.", path);
+            unmapAsset(&file);
+            return false;
+        }
+        const uint8_t *data = file.data;
+        size_t bytes = file.bytes;
+
+        const SceneMeshFileHeader *header = reinterpret_cast<const SceneMeshFileHeader *>(data);
+        const char *problem = nullptr;
+        if (memcmp(header->magic, kSceneMeshMagic, sizeof(kSceneMeshMagic)) != 0 ||
+            header->version != kSceneMeshFileVersion) {
+            problem = "not a version 1 mesh file";
+        } else if (header->vertexCount == 0 || header->indexCount == 0 || header->indexCount % 3 != 0) {
+            problem = "no triangles";
+        } else if (header->indexSize != 2 && header->indexSize != 4) {
+            problem = "bad index size";
+        } else if (header->vertexOffset % kSceneMeshFileAlignment || header->indexOffset % kSceneMeshFileAlignment ||
+                   header->vertexOffset < sizeof(*header) ||
+                   header->indexOffset < header->vertexOffset +
+                                         static_cast<size_t>(header->vertexCount) * sizeof(SceneMeshVertex) ||
+                   bytes < header->indexOffset + static_cast<size_t>(header->indexCount) * header->indexSize) {
+            problem = "sections out of place";
+        } else {
+            const void *indices = data + header->indexOffset;
+            bool inRange = header->indexSize == 2
+                           ? indicesInRange<uint16_t>(indices, header->indexCount, header->vertexCount)
+                           : indicesInRange<uint32_t>(indices, header->indexCount, header->vertexCount);
+            if (!inRange) {
+                problem = "an index past the last vertex";
+            }
+        }
+        if (problem) {
+            LOGE("[SceneMesh] %s: %s.", path, problem);
+            unmapAsset(&file);
+            return false;
+        }
+        meshOut->file = file;
+        meshOut->header = header;
+        meshOut->vertices = reinterpret_cast<const SceneMeshVertex *>(data + header->vertexOffset);
+        meshOut->indices = data + header->indexOffset;
+        return true;
+    }
+
+    void unmapSceneMeshFile(MappedSceneMesh *mesh) {
+        unmapAsset(&mesh->file);
+        memset(mesh, 0, sizeof(*mesh));
+    }
+
+    bool writeSceneMeshFile(const char *path, const float *positionScale, const float *positionOffset,
+                            const std::vector<SceneMeshVertex> &vertices, const std::vector<uint32_t> &indices) {
+        SceneMeshFileHeader header;
+        memset(&header, 0, sizeof(header));
+        memcpy(header.magic, kSceneMeshMagic, sizeof(kSceneMeshMagic));
+        header.version = kSceneMeshFileVersion;
+        header.vertexCount = static_cast<uint32_t>(vertices.size());
+        header.indexCount = static_cast<uint32_t>(indices.size());
+        header.indexSize = vertices.size() <= 0x10000 ? 2 : 4;
+        header.vertexOffset = kSceneMeshFileAlignment;
+        header.indexOffset = static_cast<uint32_t>(
+                alignToPage(header.vertexOffset + vertices.size() * sizeof(SceneMeshVertex)));
+        memcpy(header.positionScale, positionScale, sizeof(header.positionScale));
+        memcpy(header.positionOffset, positionOffset, sizeof(header.positionOffset));
+
+        std::vector<uint8_t> file(header.indexOffset + indices.size() * header.indexSize, 0);
+        memcpy(file.data(), &header, sizeof(header));
+        memcpy(file.data() + header.vertexOffset, vertices.data(), vertices.size() * sizeof(SceneMeshVertex));
+        uint8_t *indexData = file.data() + header.indexOffset;
+        for (size_t i = 0; i < indices.size(); i++) {
+            if (header.indexSize == 2) {
+                uint16_t index = static_cast<uint16_t>(indices[i]);
+                memcpy(indexData + i * 2, &index, 2);
+            } else {
+                memcpy(indexData + i * 4, &indices[i], 4);
+            }
+        }
+
+        // written aside and renamed, so a reader never maps half a file
+        std::string temporaryPath = std::string(path) + ".tmp";
+        FILE *output = fopen(temporaryPath.c_str(), "wb");
+        if (!output) {
+            LOGE("[SceneMesh] Could not create %s.", temporaryPath.c_str());
+            return false;
+        }
+        bool written = fwrite(file.data(), 1, file.size(), output) == file.size();
+        written = fclose(output) == 0 && written;
+        if (!written || rename(temporaryPath.c_str(), path) != 0) {
+            LOGE("[SceneMesh] Could not write %s.", path);
+            remove(temporaryPath.c_str());
+            return false;
+        }
+        return true;
+    }
+
+    void setSceneMeshPath(const char *path) {
+        gSceneMeshPath = path ? path : "";
+        markGpuResourceStale("sceneMesh");
+    }
+
+    bool setupSceneMesh() {
+        // names from an earlier context are gone with it
+        gVertexBuffer = gIndexBuffer = 0;
+        memset(&gInfo, 0, sizeof(gInfo));
+        for (int axis = 0; axis < 3; axis++) {
+            gPositionScale[axis] = 1.0f;
+            gPositionOffset[axis] = 0.0f;
+        }
+        if (gSceneMeshPath.empty()) {
+            return false;
+        }
+
+        uint64_t startNs = frameStatsNowNs();
+        MappedSceneMesh mapped;
+        if (!mapSceneMeshFile(gSceneMeshPath.c_str(), &mapped)) {
+            return false;
+        }
+        const SceneMeshFileHeader &header = *mapped.header;
+        // ES 3.0 has half float attributes and 32-bit indices in core; ES 2.0
+        // has them as extensions
+        bool es3 = isOpenGLES3();
+        if (header.indexSize == 4 && !es3 && !hasGLExtension("GL_OES_element_index_uint")) {
+            LOGE("[SceneMesh] %s needs 32-bit indices, which this context lacks.", gSceneMeshPath.c_str());
+            unmapSceneMeshFile(&mapped);
+            return false;
+        }
+
+        glGenBuffers(1, &gVertexBuffer);
+        glBindBuffer(GL_ARRAY_BUFFER, gVertexBuffer);
+        if (es3 || hasGLExtension("GL_OES_vertex_half_float")) {
+            gUVType = es3 ? GL_HALF_FLOAT : GL_HALF_FLOAT_OES;
+            gVertexStride = sizeof(SceneMeshVertex);
+            gUVOffset = offsetof(SceneMeshVertex, uv);
+            glBufferData(GL_ARRAY_BUFFER, header.vertexCount * sizeof(SceneMeshVertex), mapped.vertices,
+                         GL_STATIC_DRAW);
+        } else {
+            std::vector<WideSceneMeshVertex> wide(header.vertexCount);
+            for (uint32_t i = 0; i < header.vertexCount; i++) {
+                memcpy(&wide[i], &mapped.vertices[i], offsetof(SceneMeshVertex, uv));
+                wide[i].uv[0] = halfToFloat(mapped.vertices[i].uv[0]);
+                wide[i].uv[1] = halfToFloat(mapped.vertices[i].uv[1]);
+            }
+            gUVType = GL_FLOAT;
+            gVertexStride = sizeof(WideSceneMeshVertex);
+            gUVOffset = offsetof(WideSceneMeshVertex, uv);
+            glBufferData(GL_ARRAY_BUFFER, wide.size() * sizeof(wide[0]), wide.data(), GL_STATIC_DRAW);
+            LOGI("[SceneMesh] No half float attributes; widened the texture coordinates.");
+        }
+        glGenBuffers(1, &gIndexBuffer);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, gIndexBuffer);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, static_cast<size_t>(header.indexCount) * header.indexSize,
+                     mapped.indices, GL_STATIC_DRAW);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+        trackGpuObject(GPU_OBJECT_BUFFER, gVertexBuffer, GPU_MEMORY_BUFFERS,
+                       static_cast<uint64_t>(header.vertexCount) * gVertexStride);
+        trackGpuObject(GPU_OBJECT_BUFFER, gIndexBuffer, GPU_MEMORY_BUFFERS,
+                       static_cast<uint64_t>(header.indexCount) * header.indexSize);
+
+        gIndexType = header.indexSize == 2 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+        memcpy(gPositionScale, header.positionScale, sizeof(gPositionScale));
+        memcpy(gPositionOffset, header.positionOffset, sizeof(gPositionOffset));
+        gInfo.vertexCount = header.vertexCount;
+        gInfo.triangleCount = header.indexCount / 3;
+        gInfo.fileBytes = mapped.file.bytes;
+        unmapSceneMeshFile(&mapped);
+        gInfo.loadMs = (frameStatsNowNs() - startNs) / 1.0e6;
+        LOGI("[SceneMesh] Loaded %s: %u vertices, %u triangles, %zu KB in %.3f ms.", gSceneMeshPath.c_str(),
+             gInfo.vertexCount, gInfo.triangleCount, gInfo.fileBytes / 1024, gInfo.loadMs);
+        return true;
+    }
+
+    void releaseSceneMesh() {
+        glDeleteBuffers(1, &gVertexBuffer);
+        glDeleteBuffers(1, &gIndexBuffer);
+        forgetGpuObject(GPU_OBJECT_BUFFER, gVertexBuffer);
+        forgetGpuObject(GPU_OBJECT_BUFFER, gIndexBuffer);
+        gVertexBuffer = gIndexBuffer = 0;
+        memset(&gInfo, 0, sizeof(gInfo));
+    }
+
+    bool isSceneMeshReady() {
+        return gIndexBuffer != 0;
+    }
+
+    void getSceneMeshInfo(SceneMeshInfo *infoOut) {
+        *infoOut = gInfo;
+    }
+
+    void getSceneMeshPositionTransform(float *scaleOut, float *offsetOut) {
+        memcpy(scaleOut, gPositionScale, sizeof(gPositionScale));
+        memcpy(offsetOut, gPositionOffset, sizeof(gPositionOffset));
+    }
+
+    void bindSceneMesh(GLuint positionAttribute, GLuint colorAttribute, GLuint texCoordinateAttribute) {
+        glBindBuffer(GL_ARRAY_BUFFER, gVertexBuffer);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, gIndexBuffer);
+        glEnableVertexAttribArray(positionAttribute);
+        glVertexAttribPointer(positionAttribute, 3, GL_SHORT, GL_TRUE, gVertexStride,
+                              reinterpret_cast<const void *>(offsetof(SceneMeshVertex, position)));
+        glEnableVertexAttribArray(colorAttribute);
+        glVertexAttribPointer(colorAttribute, 4, GL_UNSIGNED_BYTE, GL_TRUE, gVertexStride,
+                              reinterpret_cast<const void *>(offsetof(SceneMeshVertex, color)));
+        glEnableVertexAttribArray(texCoordinateAttribute);
+        glVertexAttribPointer(texCoordinateAttribute, 2, gUVType, GL_FALSE, gVertexStride,
+                              reinterpret_cast<const void *>(gUVOffset));
+    }
+
+    void drawSceneMesh() {
+        glDrawElements(GL_TRIANGLES, static_cast<GLsizei>(gInfo.triangleCount * 3), gIndexType, nullptr);
+    }
+
+    void unbindSceneMesh() {
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+    }
+}
@@ -0,0 +1,129 @@
+/*
+ * Copyright (C) 2015 Sensics, Inc. and contributors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef OSVROPENGL_SCENEMESH_H
+#define OSVROPENGL_SCENEMESH_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <GLES2/gl2.h>
+
+#include "Asset.h"
+
+namespace OSVROpenGL {
+
+    // Scene geometry from a file instead of the built-in cube. The format is
+    // made to be mapped and handed to GL as it is: mesh_tool (see
+    // OSVROpenGL/host) converts OBJ files to it, and has by then indexed the
+    // triangles, ordered them for the post-transform vertex cache (Forsyth's
+    // algorithm) and then, in cache-neutral clusters, for overdraw, and
+    // ordered the vertices by first use for fetch locality. The file, in
+    // native byte order:
+    //
+    //   SceneMeshFileHeader, padded to kSceneMeshFileAlignment
+    //   SceneMeshVertex[vertexCount], padded to kSceneMeshFileAlignment
+    //   uint16_t or uint32_t[indexCount], a triangle list
+    //
+    // Attributes are quantized: positions to snorm16 within the mesh's
+    // bounding box (positionScale and positionOffset map them back, in the
+    // vertex shader), normals to snorm8, colors to unorm8 and texture
+    // coordinates to half floats.
+
+    static const uint32_t kSceneMeshFileVersion = 1;
+    // Sections start on page boundaries, so each maps straight into a buffer upload.
+    static const uint32_t kSceneMeshFileAlignment = 4096;
+
+    struct SceneMeshVertex {
+        int16_t position[4];    // snorm16 within the bounding box; [3] is padding
+        int8_t normal[4];       // snorm8; [3] is padding
+        uint8_t color[4];       // unorm8 RGBA
+        uint16_t uv[2];         // half floats
+    };
+
+    struct SceneMeshFileHeader {
+        char magic[8];          // "OSVRMSH1"
+        uint32_t version;
+        uint32_t vertexCount;
+        uint32_t indexCount;
+        uint32_t indexSize;     // 2 or 4 bytes
+        uint32_t vertexOffset;  // from the start of the file
+        uint32_t indexOffset;
+        float positionScale[3]; // object space position = snorm * scale + offset
+        float positionOffset[3];
+    };
+
+    // A mesh file mapped read-only and checked: header, section bounds and
+    // that every index names a vertex. Valid until unmapSceneMeshFile().
+    struct MappedSceneMesh {
+        MappedAsset file;
+        const SceneMeshFileHeader *header;
+        const SceneMeshVertex *vertices;
+        const void *indices;
+    };
+
+    // False (and logged) if the file can't be mapped or isn't a valid mesh.
+    // Paths starting with "asset:" are opened from the APK (see Asset.h).
+    bool mapSceneMeshFile(const char *path, MappedSceneMesh *meshOut);
+    void unmapSceneMeshFile(MappedSceneMesh *mesh);
+
+    // Writes a mesh in the file format; indices take 16 bits when they can.
+    bool writeSceneMeshFile(const char *path, const float *positionScale, const float *positionOffset,
+                            const std::vector<SceneMeshVertex> &vertices, const std::vector<uint32_t> &indices);
+
+    uint16_t floatToHalf(float value);
+    float halfToFloat(uint16_t value);
+
+    // Maps the vertices' texture coordinates to uv * (transform[0],
+    // transform[1]) + (transform[2], transform[3]), e.g. into a material's
+    // rectangle of a texture atlas (see TextureAtlas.h), so a model drawn with
+    // that one material needs no per-draw transform.
+    void transformSceneMeshUVs(SceneMeshVertex *vertices, size_t count, const float *transform);
+
+    struct SceneMeshInfo {
+        uint32_t vertexCount;
+        uint32_t triangleCount;
+        size_t fileBytes;
+        double loadMs;          // mapping, checking and uploading
+    };
+
+    // The mesh file the scene is drawn with; null or empty (the default) for
+    // the built-in cube. Call while the GL thread is paused or not yet
+    // started; applied at the next surface change.
+    void setSceneMeshPath(const char *path);
+
+    // Loads the configured mesh into GL buffers. GL thread only.
+    bool setupSceneMesh();
+    // Deletes the mesh's buffers; the scene goes back to the cube. GL thread only.
+    void releaseSceneMesh();
+    // True once setupSceneMesh() has a mesh to draw instead of the cube.
+    bool isSceneMeshReady();
+    void getSceneMeshInfo(SceneMeshInfo *infoOut);
+    // What the vertex shader maps the quantized positions back with; the
+    // identity when there is no mesh.
+    void getSceneMeshPositionTransform(float *scaleOut, float *offsetOut);
+
+    // Binds the mesh's buffers and points the given attributes into them;
+    // then drawSceneMesh() once per object, and unbindSceneMesh() to go back
+    // to client-side arrays.
+    void bindSceneMesh(GLuint positionAttribute, GLuint colorAttribute, GLuint texCoordinateAttribute);
+    void drawSceneMesh();
+    void unbindSceneMesh();
+}
+
+#endif // OSVROPENGL_SCENEMESH_H
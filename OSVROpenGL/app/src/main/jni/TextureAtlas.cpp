@@ -0,0 +1,313 @@
+/*
+ * Copyright (C) 2015 Sensics, Inc. and contributors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <string>
+
+#include "Logging.h"
+#include "TextureAtlas.h"
+
+namespace OSVROpenGL {
+
+    static const char kTextureAtlasMagic[8] = { 'O', 'S', 'V', 'R', 'A', 'T', 'L', '1' };
+
+    static uint32_t alignUp(uint32_t value, uint32_t alignment) {
+        return (value + alignment - 1) / alignment * alignment;
+    }
+
+    void SkylinePacker::reset(uint32_t width, uint32_t height) {
+        mWidth = width;
+        mHeight = height;
+        mUsedArea = 0;
+        mSkyline.clear();
+        Segment floor = { 0, 0, width };
+        mSkyline.push_back(floor);
+    }
+
+    // Whether a rectangle with its left edge at the segment's fits, and how
+    // low: it rests on the highest segment under it.
+    bool SkylinePacker::fits(size_t segment, uint32_t width, uint32_t height, uint32_t *yOut) const {
+        if (mSkyline[segment].x + width > mWidth) {
+            return false;
+        }
+        uint32_t y = 0;
+        uint32_t remaining = width;
+        for (size_t i = segment; remaining > 0; i++) {
+            y = std::max(y, mSkyline[i].y);
+            if (y + height > mHeight) {
+                return false;
+            }
+            remaining -= std::min(remaining, mSkyline[i].width);
+        }
+        *yOut = y;
+        return true;
+    }
+
+    bool SkylinePacker::insert(uint32_t width, uint32_t height, uint32_t *xOut, uint32_t *yOut) {
+        if (width == 0 || height == 0) {
+            return false;
+        }
+        size_t best = mSkyline.size();
+        uint32_t bestY = 0;
+        for (size_t i = 0; i < mSkyline.size(); i++) {
+            uint32_t y;
+            if (fits(i, width, height, &y) && (best == mSkyline.size() || y < bestY)) {
+                best = i;
+                bestY = y;
+            }
+        }
+        if (best == mSkyline.size()) {
+            return false;
+        }
+
+        Segment placed = { mSkyline[best].x, bestY + height, width };
+        mSkyline.insert(mSkyline.begin() + best, placed);
+        // the segments it now covers shrink or go
+        uint32_t end = placed.x + placed.width;
+        for (size_t i = best + 1; i < mSkyline.size();) {
+            Segment &segment = mSkyline[i];
+            if (segment.x >= end) {
+                break;
+            }
+            uint32_t covered = end - segment.x;
+            if (segment.width <= covered) {
+                mSkyline.erase(mSkyline.begin() + i);
+                continue;
+            }
+            segment.x += covered;
+            segment.width -= covered;
+            break;
+        }
+        // neighbours at the same height are one segment
+        for (size_t i = 0; i + 1 < mSkyline.size();) {
+            if (mSkyline[i].y == mSkyline[i + 1].y) {
+                mSkyline[i].width += mSkyline[i + 1].width;
+                mSkyline.erase(mSkyline.begin() + i + 1);
+            } else {
+                i++;
+            }
+        }
+
+        mUsedArea += static_cast<uint64_t>(width) * height;
+        *xOut = placed.x;
+        *yOut = bestY;
+        return true;
+    }
+
+    bool packTextureAtlas(const TextureAtlasImage *images, uint32_t count, uint32_t pageSize, uint32_t padding,
+                          std::vector<TextureAtlasRect> *rectsOut, uint32_t *pageCountOut) {
+        rectsOut->assign(count, TextureAtlasRect());
+        *pageCountOut = 0;
+
+        std::vector<uint32_t> order(count);
+        for (uint32_t i = 0; i < count; i++) {
+            order[i] = i;
+        }
+        std::stable_sort(order.begin(), order.end(), [images](uint32_t a, uint32_t b) {
+            if (images[a].height != images[b].height) {
+                return images[a].height > images[b].height;
+            }
+            return images[a].width > images[b].width;
+        });
+
+        std::vector<SkylinePacker> pages;
+        for (uint32_t index : order) {
+            const TextureAtlasImage &image = images[index];
+            uint32_t paddedWidth = alignUp(image.width + 2 * padding, kTextureAtlasAlignment);
+            uint32_t paddedHeight = alignUp(image.height + 2 * padding, kTextureAtlasAlignment);
+            if (image.width == 0 || image.height == 0 || paddedWidth > pageSize || paddedHeight > pageSize) {
+                LOGE("[TextureAtlas] Image %u (%ux%u) doesn't fit a %u texel page.", index, image.width,
+                     image.height, pageSize);
+                rectsOut->clear();
+                return false;
+            }
+            // first fit over the pages so far, then a new one
+            uint32_t x = 0;
+            uint32_t y = 0;
+            size_t page = 0;
+            while (page < pages.size() && !pages[page].insert(paddedWidth, paddedHeight, &x, &y)) {
+                page++;
+            }
+            if (page == pages.size()) {
+                pages.push_back(SkylinePacker());
+                pages.back().reset(pageSize, pageSize);
+                pages.back().insert(paddedWidth, paddedHeight, &x, &y);
+            }
+            TextureAtlasRect &rect = (*rectsOut)[index];
+            rect.page = static_cast<uint32_t>(page);
+            rect.x = x + padding;
+            rect.y = y + padding;
+            rect.width = image.width;
+            rect.height = image.height;
+        }
+        *pageCountOut = static_cast<uint32_t>(pages.size());
+        return true;
+    }
+
+    void copyTextureAtlasImage(const TextureAtlasImage &image, uint8_t *destination, uint32_t destinationWidth,
+                               uint32_t x, uint32_t y, uint32_t x0, uint32_t y0, uint32_t x1, uint32_t y1) {
+        for (uint32_t row = y0; row < y1; row++) {
+            int64_t sourceRow = static_cast<int64_t>(row) - y;
+            sourceRow = std::min<int64_t>(std::max<int64_t>(sourceRow, 0), image.height - 1);
+            const uint8_t *source = image.rgba + static_cast<size_t>(sourceRow) * image.width * 4;
+            uint8_t *out = destination + (static_cast<size_t>(row) * destinationWidth + x0) * 4;
+            // left padding, the row itself, right padding
+            for (uint32_t column = x0; column < x && column < x1; column++, out += 4) {
+                memcpy(out, source, 4);
+            }
+            if (x < x1) {
+                uint32_t copied = std::min(image.width, x1 - x);
+                memcpy(out, source, static_cast<size_t>(copied) * 4);
+                out += static_cast<size_t>(copied) * 4;
+            }
+            const uint8_t *last = source + (image.width - 1) * 4;
+            for (uint32_t column = std::max(x0, x + image.width); column < x1; column++, out += 4) {
+                memcpy(out, last, 4);
+            }
+        }
+    }
+
+    void fillTextureAtlasPages(const TextureAtlasImage *images, uint32_t count, const TextureAtlasRect *rects,
+                               uint32_t pageSize, uint32_t pageCount, uint32_t padding,
+                               std::vector<uint8_t> *pixelsOut) {
+        size_t pageBytes = static_cast<size_t>(pageSize) * pageSize * 4;
+        pixelsOut->assign(pageBytes * pageCount, 0);
+        for (uint32_t i = 0; i < count; i++) {
+            const TextureAtlasRect &rect = rects[i];
+            uint8_t *page = pixelsOut->data() + pageBytes * rect.page;
+            uint32_t x0 = rect.x >= padding ? rect.x - padding : 0;
+            uint32_t y0 = rect.y >= padding ? rect.y - padding : 0;
+            uint32_t x1 = std::min(rect.x + rect.width + padding, pageSize);
+            uint32_t y1 = std::min(rect.y + rect.height + padding, pageSize);
+            copyTextureAtlasImage(images[i], page, pageSize, rect.x, rect.y, x0, y0, x1, y1);
+        }
+    }
+
+    void textureAtlasUVTransform(const TextureAtlasRect &rect, uint32_t pageWidth, uint32_t pageHeight,
+                                 float *transformOut) {
+        transformOut[0] = static_cast<float>(rect.width) / pageWidth;
+        transformOut[1] = static_cast<float>(rect.height) / pageHeight;
+        transformOut[2] = static_cast<float>(rect.x) / pageWidth;
+        transformOut[3] = static_cast<float>(rect.y) / pageHeight;
+    }
+
+    float textureAtlasOccupancy(const TextureAtlasRect *rects, uint32_t count, uint32_t pageSize,
+                                uint32_t pageCount) {
+        if (pageCount == 0) {
+            return 0.0f;
+        }
+        uint64_t used = 0;
+        for (uint32_t i = 0; i < count; i++) {
+            used += static_cast<uint64_t>(rects[i].width) * rects[i].height;
+        }
+        return static_cast<float>(static_cast<double>(used) / (static_cast<double>(pageSize) * pageSize * pageCount));
+    }
+
+    bool mapTextureAtlasFile(const char *path, MappedTextureAtlas *atlasOut) {
+        memset(atlasOut, 0, sizeof(*atlasOut));
+        MappedAsset file;
+        if (!mapAsset(path, &file)) {
+            LOGE("[TextureAtlas] Could not map %s.", path);
+            return false;
+        }
+        if (file.bytes < sizeof(TextureAtlasFileHeader)) {
+            LOGE("[TextureAtlas] %s is too short for an atlas.", path);
+            unmapAsset(&file);
+            return false;
+        }
+        const TextureAtlasFileHeader *header = reinterpret_cast<const TextureAtlasFileHeader *>(file.data);
+        const char *problem = nullptr;
+        if (memcmp(header->magic, kTextureAtlasMagic, sizeof(kTextureAtlasMagic)) != 0 ||
+            header->version != kTextureAtlasFileVersion) {
+            problem = "not a version 1 atlas file";
+        } else if (header->pageSize == 0 || header->pageSize > kTextureAtlasMaxPageSize || header->pageCount == 0 ||
+                   header->entryCount == 0) {
+            problem = "no pages or no images";
+        } else if (header->entryOffset < sizeof(*header) || header->entryOffset % sizeof(uint32_t) ||
+                   header->pixelOffset % kTextureAtlasFileAlignment ||
+                   header->pixelOffset < header->entryOffset +
+                                        static_cast<size_t>(header->entryCount) * sizeof(TextureAtlasRect) ||
+                   file.bytes < header->pixelOffset +
+                                static_cast<size_t>(header->pageSize) * header->pageSize * 4 * header->pageCount) {
+            problem = "sections out of place";
+        } else {
+            const TextureAtlasRect *entries =
+                    reinterpret_cast<const TextureAtlasRect *>(file.data + header->entryOffset);
+            for (uint32_t i = 0; i < header->entryCount && !problem; i++) {
+                const TextureAtlasRect &rect = entries[i];
+                if (rect.page >= header->pageCount || rect.width == 0 || rect.height == 0 ||
+                    rect.x > header->pageSize || rect.width > header->pageSize - rect.x ||
+                    rect.y > header->pageSize || rect.height > header->pageSize - rect.y) {
+                    problem = "an image outside its page";
+                }
+            }
+        }
+        if (problem) {
+            LOGE("[TextureAtlas] %s: %s.", path, problem);
+            unmapAsset(&file);
+            return false;
+        }
+        atlasOut->file = file;
+        atlasOut->header = header;
+        atlasOut->entries = reinterpret_cast<const TextureAtlasRect *>(file.data + header->entryOffset);
+        atlasOut->pixels = file.data + header->pixelOffset;
+        return true;
+    }
+
+    void unmapTextureAtlasFile(MappedTextureAtlas *atlas) {
+        unmapAsset(&atlas->file);
+        memset(atlas, 0, sizeof(*atlas));
+    }
+
+    bool writeTextureAtlasFile(const char *path, uint32_t pageSize, uint32_t pageCount, uint32_t padding,
+                               const std::vector<TextureAtlasRect> &rects, const std::vector<uint8_t> &pixels) {
+        TextureAtlasFileHeader header;
+        memset(&header, 0, sizeof(header));
+        memcpy(header.magic, kTextureAtlasMagic, sizeof(kTextureAtlasMagic));
+        header.version = kTextureAtlasFileVersion;
+        header.pageSize = pageSize;
+        header.pageCount = pageCount;
+        header.entryCount = static_cast<uint32_t>(rects.size());
+        header.padding = padding;
+        header.entryOffset = sizeof(header);
+        header.pixelOffset = alignUp(static_cast<uint32_t>(header.entryOffset + rects.size() * sizeof(TextureAtlasRect)),
+                                     kTextureAtlasFileAlignment);
+
+        std::vector<uint8_t> file(header.pixelOffset + pixels.size(), 0);
+        memcpy(file.data(), &header, sizeof(header));
+        memcpy(file.data() + header.entryOffset, rects.data(), rects.size() * sizeof(TextureAtlasRect));
+        memcpy(file.data() + header.pixelOffset, pixels.data(), pixels.size());
+
+        // written aside and renamed, so a reader never maps half a file
+        std::string temporaryPath = std::string(path) + ".tmp";
+        FILE *output = fopen(temporaryPath.c_str(), "wb");
+        if (!output) {
+            LOGE("[TextureAtlas] Could not create %s.", temporaryPath.c_str());
+            return false;
+        }
+        bool written = fwrite(file.data(), 1, file.size(), output) == file.size();
+        written = fclose(output) == 0 && written;
+        if (!written || rename(temporaryPath.c_str(), path) != 0) {
+            LOGE("[TextureAtlas] Could not write %s.", path);
+            remove(temporaryPath.c_str());
+            return false;
+        }
+        return true;
+    }
+}
@@ -0,0 +1,153 @@
+/*
+ * Copyright (C) 2015 Sensics, Inc. and contributors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef OSVROPENGL_TEXTUREATLAS_H
+#define OSVROPENGL_TEXTUREATLAS_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "Asset.h"
+
+namespace OSVROpenGL {
+
+    // Texture atlases: small images packed into a few big pages, so that
+    // whatever is drawn with any of them can be drawn with one texture bound.
+    // Each image keeps its own [0,1] texture coordinates; a scale and offset
+    // (see textureAtlasUVTransform()) takes them to its rectangle in the page.
+    //
+    // Images are packed with a skyline: the top edge of what has been placed
+    // so far, as a run of horizontal segments. Each image goes where its
+    // bottom would be lowest, leftmost on a tie, which wastes little for the
+    // similar-sized images of a material set and keeps the packer O(segments)
+    // per image. Every image gets kTextureAtlasAlignment-aligned padding,
+    // filled with copies of its edge texels, so bilinear filtering and the
+    // first mip levels never see a neighbour's texels; past those, the smaller
+    // levels blur into the padding, as any atlas's do.
+    //
+    // Atlas files hold a packing done offline (atlas_tool --build, in
+    // OSVROpenGL/host) with its pages' pixels, in native byte order:
+    //
+    //   TextureAtlasFileHeader
+    //   TextureAtlasRect[entryCount]
+    //   pageCount pages of pageSize x pageSize RGBA8, at a kTextureAtlasFileAlignment
+    //   offset so they upload straight from the mapping; rows bottom up, as GL takes them
+
+    static const uint32_t kTextureAtlasFileVersion = 1;
+    static const uint32_t kTextureAtlasFileAlignment = 4096;
+    // Packed rectangles (padding included) start and end on multiples of this,
+    // so each image covers whole texels of mip levels 1 and 2 too.
+    static const uint32_t kTextureAtlasAlignment = 4;
+    static const uint32_t kTextureAtlasMaxPageSize = 16384;
+
+    // Where an image is, without its padding, in texels.
+    struct TextureAtlasRect {
+        uint32_t page;
+        uint32_t x;
+        uint32_t y;
+        uint32_t width;
+        uint32_t height;
+    };
+
+    struct TextureAtlasImage {
+        const uint8_t *rgba;    // width * height texels, rows bottom up
+        uint32_t width;
+        uint32_t height;
+    };
+
+    // Bottom-left skyline packing of rectangles into one width x height page.
+    class SkylinePacker {
+        struct Segment {
+            uint32_t x;
+            uint32_t y;         // the top of what is under [x, x + width)
+            uint32_t width;
+        };
+
+        std::vector<Segment> mSkyline;  // left to right, covering the page's width
+        uint32_t mWidth = 0;
+        uint32_t mHeight = 0;
+        uint64_t mUsedArea = 0;
+
+        bool fits(size_t segment, uint32_t width, uint32_t height, uint32_t *yOut) const;
+
+    public:
+        void reset(uint32_t width, uint32_t height);
+        // Places a width x height rectangle and gives its lower left corner;
+        // false (and nothing changes) if there is no room for it.
+        bool insert(uint32_t width, uint32_t height, uint32_t *xOut, uint32_t *yOut);
+        uint64_t usedArea() const { return mUsedArea; }
+        size_t segmentCount() const { return mSkyline.size(); }
+    };
+
+    // Packs the images, tallest first, into as few pageSize x pageSize pages
+    // as it takes, each with padding texels around it. False (and logged) if
+    // one can't fit in a page at all.
+    bool packTextureAtlas(const TextureAtlasImage *images, uint32_t count, uint32_t pageSize, uint32_t padding,
+                          std::vector<TextureAtlasRect> *rectsOut, uint32_t *pageCountOut);
+
+    // Copies image into a destinationWidth-wide RGBA buffer with its lower
+    // left texel at (x, y), and fills the rest of the box from (x0, y0) to
+    // (x1, y1) (exclusive, and around the image) with its nearest edge texels.
+    void copyTextureAtlasImage(const TextureAtlasImage &image, uint8_t *destination, uint32_t destinationWidth,
+                               uint32_t x, uint32_t y, uint32_t x0, uint32_t y0, uint32_t x1, uint32_t y1);
+
+    // Draws packed images into pageCount pages of RGBA, padding and all;
+    // the texels no image covers are left transparent black.
+    void fillTextureAtlasPages(const TextureAtlasImage *images, uint32_t count, const TextureAtlasRect *rects,
+                               uint32_t pageSize, uint32_t pageCount, uint32_t padding,
+                               std::vector<uint8_t> *pixelsOut);
+
+    // uv * (transform[0], transform[1]) + (transform[2], transform[3]) takes
+    // an image's texture coordinates to its rectangle in a page of the size.
+    void textureAtlasUVTransform(const TextureAtlasRect &rect, uint32_t pageWidth, uint32_t pageHeight,
+                                 float *transformOut);
+
+    // The image texels over all the pages' texels.
+    float textureAtlasOccupancy(const TextureAtlasRect *rects, uint32_t count, uint32_t pageSize,
+                                uint32_t pageCount);
+
+    struct TextureAtlasFileHeader {
+        char magic[8];          // "OSVRATL1"
+        uint32_t version;
+        uint32_t pageSize;
+        uint32_t pageCount;
+        uint32_t entryCount;
+        uint32_t padding;       // texels around each image
+        uint32_t entryOffset;   // from the start of the file
+        uint32_t pixelOffset;
+    };
+
+    // An atlas file mapped read-only and checked: header, section bounds and
+    // that every rectangle is inside its page. Valid until unmapTextureAtlasFile().
+    struct MappedTextureAtlas {
+        MappedAsset file;
+        const TextureAtlasFileHeader *header;
+        const TextureAtlasRect *entries;
+        const uint8_t *pixels;
+    };
+
+    // False (and logged) if the file can't be mapped or isn't a valid atlas.
+    // Paths starting with "asset:" are opened from the APK (see Asset.h).
+    bool mapTextureAtlasFile(const char *path, MappedTextureAtlas *atlasOut);
+    void unmapTextureAtlasFile(MappedTextureAtlas *atlas);
+
+    bool writeTextureAtlasFile(const char *path, uint32_t pageSize, uint32_t pageCount, uint32_t padding,
+                               const std::vector<TextureAtlasRect> &rects, const std::vector<uint8_t> &pixels);
+}
+
+#endif // OSVROPENGL_TEXTUREATLAS_H
@@ -0,0 +1,572 @@
+/*
+ * Copyright (C) 2015 Sensics, Inc. and contributors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "FrameStats.h"
+#include "Logging.h"
+#include "ThermalGovernor.h"
+#include "Trace.h"
+
+namespace OSVROpenGL {
+
+    // MSAA goes first and the render scale a little at a time, since they are
+    // the cheapest to give up; the camera and the animation rate go last.
+    static const QualityTier gQualityTiers[kQualityTierCount] = {
+            { 1.0f,  4, 1, 1 },
+            { 0.9f,  2, 1, 1 },
+            { 0.8f,  1, 2, 1 },
+            { 0.7f,  1, 2, 2 },
+            { 0.6f,  1, 3, 2 },
+    };
+
+    // How far the thermal statuses push the tier up.
+    static const int kStatusFloors[] = { 0, 1, 2, 3, 4, 4, 4 };
+
+    // The smoothing of the frame cost, per reading.
+    static const float kFrameCostSmoothing = 0.5f;
+    // Temperature readings needed before the trend is trusted.
+    static const int kMinTrendReadings = 16;
+    // A step down this soon after a step up takes it back, and doubles the
+    // step up hold, up to this many times the configured one. A step up that
+    // lasts puts it back.
+    static const uint64_t kRelapseWindowNs = 600000000000ull;
+    static const uint64_t kMaxStepUpBackoff = 16;
+
+    static const uint64_t kThermalZonePeriodNs = 1000000000ull;
+    static const char kThermalZoneDir[] = "/sys/class/thermal";
+
+    const QualityTier &qualityTier(int tier) {
+        tier = tier < 0 ? 0 : (tier >= kQualityTierCount ? kQualityTierCount - 1 : tier);
+        return gQualityTiers[tier];
+    }
+
+    void defaultThermalPolicyConfig(ThermalPolicyConfig *configOut) {
+        configOut->displayPeriodNs = 16666667ull;
+        configOut->throttleTemperatureC = 80.0f;
+        configOut->tierTemperatureStepC = 4.0f;
+        configOut->forecastSeconds = 60.0f;
+        configOut->stepUpMarginC = 5.0f;
+        configOut->frameBudgetHigh = 0.9f;
+        configOut->frameBudgetLow = 0.7f;
+        configOut->stepDownHoldNs = 3000000000ull;
+        configOut->trendStepDownHoldNs = 20000000000ull;
+        configOut->stepUpHoldNs = 30000000000ull;
+    }
+
+    const char *tierChangeReasonName(int reason) {
+        switch (reason) {
+            case TIER_CHANGE_NONE: return "none";
+            case TIER_CHANGE_STATUS: return "thermal status";
+            case TIER_CHANGE_TREND: return "temperature trend";
+            case TIER_CHANGE_FRAME_TIME: return "frame time";
+            case TIER_CHANGE_RECOVERED: return "recovered";
+            default: return "unknown";
+        }
+    }
+
+    void initThermalPolicy(ThermalPolicyState *state, const ThermalPolicyConfig &config) {
+        *state = ThermalPolicyState();
+        state->config = config;
+        state->stepUpHoldNs = config.stepUpHoldNs;
+    }
+
+    // Least squares slope of the temperatures in the trend window, in C per second.
+    static float trendSlope(const ThermalPolicyState &state) {
+        if (state.trendCount < kMinTrendReadings) {
+            return 0.0f;
+        }
+        double meanTime = 0.0, meanTemperature = 0.0;
+        for (int i = 0; i < state.trendCount; i++) {
+            meanTime += state.trendTimes[i];
+            meanTemperature += state.trendTemperatures[i];
+        }
+        meanTime /= state.trendCount;
+        meanTemperature /= state.trendCount;
+        double covariance = 0.0, variance = 0.0;
+        for (int i = 0; i < state.trendCount; i++) {
+            double dt = state.trendTimes[i] - meanTime;
+            covariance += dt * (state.trendTemperatures[i] - meanTemperature);
+            variance += dt * dt;
+        }
+        return variance > 0.0 ? static_cast<float>(covariance / variance) : 0.0f;
+    }
+
+    // The lowest tier the status and temperature allow.
+    static int tierFloor(const ThermalPolicyConfig &config, const ThermalReading &reading) {
+        int floor = 0;
+        if (reading.status > THERMAL_STATUS_NONE) {
+            floor = reading.status < static_cast<int>(sizeof(kStatusFloors) / sizeof(kStatusFloors[0])) ?
+                    kStatusFloors[reading.status] : kQualityTierCount - 1;
+        }
+        if (!std::isnan(reading.temperatureC) && reading.temperatureC >= config.throttleTemperatureC) {
+            float past = (reading.temperatureC - config.throttleTemperatureC) / config.tierTemperatureStepC;
+            floor = std::max(floor, 1 + static_cast<int>(past));
+        }
+        return std::min(floor, kQualityTierCount - 1);
+    }
+
+    int updateThermalPolicy(ThermalPolicyState *state, const ThermalReading &reading, float frameCostMs) {
+        const ThermalPolicyConfig &config = state->config;
+        uint64_t now = reading.timeNs;
+        if (!state->haveReading) {
+            state->haveReading = true;
+            state->firstReadingNs = now;
+            state->lastChangeNs = now;
+        }
+
+        if (frameCostMs > 0.0f) {
+            state->frameCostMs = state->frameCostMs > 0.0f ?
+                    state->frameCostMs + kFrameCostSmoothing * (frameCostMs - state->frameCostMs) : frameCostMs;
+        }
+        bool haveTemperature = !std::isnan(reading.temperatureC);
+        if (haveTemperature) {
+            state->trendTimes[state->trendNext] = static_cast<float>((now - state->firstReadingNs) * 1.0e-9);
+            state->trendTemperatures[state->trendNext] = reading.temperatureC;
+            state->trendNext = (state->trendNext + 1) % kThermalTrendReadings;
+            state->trendCount = std::min(state->trendCount + 1, kThermalTrendReadings);
+            state->slopeCPerSecond = trendSlope(*state);
+        }
+
+        uint64_t sinceChangeNs = now - state->lastChangeNs;
+        if (state->lastStepUpNs && now - state->lastStepUpNs >= kRelapseWindowNs) {
+            state->stepUpHoldNs = config.stepUpHoldNs;
+            state->lastStepUpNs = 0;
+        }
+
+        int floor = tierFloor(config, reading);
+        float budgetMs = static_cast<float>(config.displayPeriodNs * 1.0e-6);
+        float forecastC = haveTemperature ?
+                reading.temperatureC + std::max(state->slopeCPerSecond, 0.0f) * config.forecastSeconds : 0.0f;
+        bool trendHot = haveTemperature && state->slopeCPerSecond > 0.0f &&
+                        forecastC >= config.throttleTemperatureC;
+        bool framesHeavy = state->frameCostMs > config.frameBudgetHigh * budgetMs;
+
+        int reason = TIER_CHANGE_NONE;
+        if (state->tier < floor) {
+            state->tier = floor;
+            reason = TIER_CHANGE_STATUS;
+        } else if (framesHeavy && state->tier < kQualityTierCount - 1 && sinceChangeNs >= config.stepDownHoldNs) {
+            state->tier++;
+            reason = TIER_CHANGE_FRAME_TIME;
+        } else if (trendHot && state->tier < kQualityTierCount - 1 && sinceChangeNs >= config.trendStepDownHoldNs) {
+            state->tier++;
+            reason = TIER_CHANGE_TREND;
+        } else {
+            bool clear = state->tier > floor && !trendHot && !framesHeavy &&
+                         state->frameCostMs <= config.frameBudgetLow * budgetMs &&
+                         (!haveTemperature || forecastC <= config.throttleTemperatureC - config.stepUpMarginC);
+            if (!clear) {
+                state->clearSinceNs = 0;
+            } else if (!state->clearSinceNs) {
+                // 0 means not clear, so a clock that starts at 0 starts at 1
+                state->clearSinceNs = now ? now : 1;
+            } else if (now - state->clearSinceNs >= state->stepUpHoldNs &&
+                       sinceChangeNs >= state->stepUpHoldNs) {
+                state->tier--;
+                reason = TIER_CHANGE_RECOVERED;
+            }
+        }
+
+        if (reason != TIER_CHANGE_NONE) {
+            if (reason == TIER_CHANGE_RECOVERED) {
+                // 0 means none, as for clearSinceNs
+                state->lastStepUpNs = now ? now : 1;
+            } else if (state->lastStepUpNs) {
+                // went back down soon after stepping up: wait longer before the next try
+                state->stepUpHoldNs = std::min(2 * state->stepUpHoldNs, kMaxStepUpBackoff * config.stepUpHoldNs);
+                state->lastStepUpNs = 0;
+            }
+            state->lastChangeNs = now;
+            state->clearSinceNs = 0;
+        }
+        return reason;
+    }
+
+    // The zones' temp files, listed by the sensor thread on its first reading.
+    static std::vector<std::string> gThermalZones;
+    static bool gThermalZonesListed = false;
+    static uint64_t gLastThermalZoneReadNs = 0;    // the last reading handed out, GL thread only
+
+    static void listThermalZones() {
+        gThermalZonesListed = true;
+        DIR *dir = opendir(kThermalZoneDir);
+        if (dir) {
+            while (dirent *entry = readdir(dir)) {
+                if (strncmp(entry->d_name, "thermal_zone", 12) == 0) {
+                    gThermalZones.push_back(std::string(kThermalZoneDir) + "/" + entry->d_name + "/temp");
+                }
+            }
+            closedir(dir);
+        }
+        if (gThermalZones.empty()) {
+            LOGI("[ThermalGovernor] No thermal zones; going by frame times and the reported status only.");
+        } else {
+            LOGI("[ThermalGovernor] Reading %u thermal zones.", static_cast<unsigned>(gThermalZones.size()));
+        }
+    }
+
+    // A zone's temperature in C, NaN if it can't be read (some are not
+    // readable by apps) or is implausible.
+    static float readThermalZone(const char *path) {
+        int fd = open(path, O_RDONLY);
+        if (fd < 0) {
+            return NAN;
+        }
+        char text[32];
+        ssize_t length = read(fd, text, sizeof(text) - 1);
+        close(fd);
+        if (length <= 0) {
+            return NAN;
+        }
+        text[length] = '\0';
+        char *end;
+        long value = strtol(text, &end, 10);
+        if (end == text) {
+            return NAN;
+        }
+        // most zones report millidegrees, some whole degrees
+        float celsius = std::labs(value) >= 1000 ? value / 1000.0f : static_cast<float>(value);
+        return celsius > -40.0f && celsius < 200.0f ? celsius : NAN;
+    }
+
+    // A decision, for the sensor thread to append to the trace.
+    struct ThermalTraceRecord {
+        ThermalReading reading;
+        float frameCostMs;
+        uint64_t displayPeriodNs;
+        int tier;
+        int reason;
+    };
+    static const uint32_t kThermalTraceRecords = 64;
+
+    // The sensor thread reads the zones (a dozen or more files, some behind
+    // slow PMIC reads) once a period and writes the trace, so the GL thread
+    // never blocks on either: it only picks up the hottest reading, published
+    // through atomics, and queues its decisions.
+    static std::thread gSensorThread;
+    static std::mutex gSensorMutex;
+    static std::condition_variable gSensorCondition;
+    static bool gSensorStopping = false;
+    static ThermalTraceRecord gTraceRecords[kThermalTraceRecords];    // under gSensorMutex
+    static uint32_t gTraceRecordHead = 0;
+    static uint32_t gTraceRecordCount = 0;
+    static uint32_t gTraceRecordsDropped = 0;
+
+    static std::atomic<uint64_t> gZoneReadingNs(0);         // 0 until the first reading
+    static std::atomic<uint32_t> gZoneTemperatureBits(0);   // a float, stored before the time
+    static std::atomic<uint64_t> gZoneWantedNs(0);          // when the GL thread last asked
+
+    // The trace file is only written by the sensor thread, and opened and
+    // closed while it isn't.
+    static std::mutex gTraceFileMutex;
+    static FILE *gTraceFile = nullptr;
+    static std::atomic<bool> gTracing(false);
+
+    static void readZonesNow(uint64_t nowNs) {
+        if (!gThermalZonesListed) {
+            listThermalZones();
+        }
+        float hottest = NAN;
+        for (size_t i = 0; i < gThermalZones.size(); i++) {
+            float celsius = readThermalZone(gThermalZones[i].c_str());
+            if (!std::isnan(celsius) && (std::isnan(hottest) || celsius > hottest)) {
+                hottest = celsius;
+            }
+        }
+        uint32_t bits;
+        memcpy(&bits, &hottest, sizeof(bits));
+        gZoneTemperatureBits.store(bits, std::memory_order_relaxed);
+        gZoneReadingNs.store(nowNs, std::memory_order_release);
+    }
+
+    static void writeTraceRecord(const ThermalTraceRecord &record) {
+        std::lock_guard<std::mutex> lock(gTraceFileMutex);
+        if (gTraceFile) {
+            // enough digits for thermal_tool to take the same decisions again
+            fprintf(gTraceFile, "%.9f,%.9g,%d,%.9g,%.9g,%d,%d\n", record.reading.timeNs * 1.0e-9,
+                    record.reading.temperatureC, record.reading.status, record.frameCostMs,
+                    record.displayPeriodNs * 1.0e-6, record.tier, record.reason);
+        }
+    }
+
+    static void sensorMain() {
+        traceSetThreadName("ThermalSensors");
+        uint64_t lastReadNs = 0;
+        std::unique_lock<std::mutex> lock(gSensorMutex);
+        while (!gSensorStopping) {
+            if (gTraceRecordsDropped) {
+                LOGE("[ThermalGovernor] %u trace lines dropped: the sensor thread fell behind.",
+                     gTraceRecordsDropped);
+                gTraceRecordsDropped = 0;
+            }
+            while (gTraceRecordCount) {
+                ThermalTraceRecord record = gTraceRecords[gTraceRecordHead];
+                gTraceRecordHead = (gTraceRecordHead + 1) % kThermalTraceRecords;
+                gTraceRecordCount--;
+                lock.unlock();
+                writeTraceRecord(record);
+                lock.lock();
+            }
+            uint64_t nowNs = frameStatsNowNs();
+            // only while the GL thread is taking readings, not while the app is paused
+            uint64_t wantedNs = gZoneWantedNs.load(std::memory_order_relaxed);
+            if (wantedNs && nowNs - wantedNs < 2 * kThermalZonePeriodNs &&
+                (!lastReadNs || nowNs - lastReadNs >= kThermalZonePeriodNs)) {
+                lastReadNs = nowNs;
+                lock.unlock();
+                {
+                    OSVR_TRACE_SCOPE("readThermalZones");
+                    readZonesNow(nowNs);
+                }
+                lock.lock();
+                continue;
+            }
+            uint64_t waitNs = lastReadNs ? kThermalZonePeriodNs - std::min(nowNs - lastReadNs, kThermalZonePeriodNs)
+                                         : kThermalZonePeriodNs;
+            gSensorCondition.wait_for(lock, std::chrono::nanoseconds(std::max<uint64_t>(waitNs, 1000000ull)));
+        }
+    }
+
+    // GL thread, or any thread once it is stopped.
+    static void startSensorThread() {
+        if (gSensorThread.joinable()) {
+            return;
+        }
+        gSensorStopping = false;
+        gSensorThread = std::thread(sensorMain);
+    }
+
+    static void stopSensorThread() {
+        if (!gSensorThread.joinable()) {
+            return;
+        }
+        {
+            std::lock_guard<std::mutex> lock(gSensorMutex);
+            gSensorStopping = true;
+        }
+        gSensorCondition.notify_one();
+        gSensorThread.join();
+        // what was queued still goes into the trace
+        for (; gTraceRecordCount; gTraceRecordCount--) {
+            writeTraceRecord(gTraceRecords[gTraceRecordHead]);
+            gTraceRecordHead = (gTraceRecordHead + 1) % kThermalTraceRecords;
+        }
+    }
+
+    static void queueTraceRecord(const ThermalTraceRecord &record) {
+        if (!gTracing.load(std::memory_order_relaxed)) {
+            return;
+        }
+        {
+            std::lock_guard<std::mutex> lock(gSensorMutex);
+            if (gTraceRecordCount == kThermalTraceRecords) {
+                gTraceRecordsDropped++;
+                return;
+            }
+            gTraceRecords[(gTraceRecordHead + gTraceRecordCount) % kThermalTraceRecords] = record;
+            gTraceRecordCount++;
+        }
+        gSensorCondition.notify_one();
+    }
+
+    bool readThermalZones(void *userdata, ThermalReading *readingOut) {
+        gZoneWantedNs.store(frameStatsNowNs(), std::memory_order_relaxed);
+        uint64_t readingNs = gZoneReadingNs.load(std::memory_order_acquire);
+        if (!readingNs || readingNs == gLastThermalZoneReadNs) {
+            return false;
+        }
+        gLastThermalZoneReadNs = readingNs;
+        uint32_t bits = gZoneTemperatureBits.load(std::memory_order_relaxed);
+        readingOut->timeNs = readingNs;
+        memcpy(&readingOut->temperatureC, &bits, sizeof(bits));
+        readingOut->status = THERMAL_STATUS_UNKNOWN;
+        return true;
+    }
+
+    static std::atomic<bool> gGovernorEnabled(false);
+    static std::atomic<int> gReportedStatus(THERMAL_STATUS_UNKNOWN);
+    static ThermalSourceFunction gSource = readThermalZones;
+    static void *gSourceUserdata = nullptr;
+
+    // GL thread only.
+    static ThermalPolicyState gPolicy;
+    static bool gPolicyStarted = false;
+    static bool gGovernorRunning = false;
+    static double gFrameCostSumMs = 0.0;
+    static uint32_t gFrameCostCount = 0;
+    static uint64_t gLastReadingNs = 0;
+
+    // Updated once per reading, read from any thread.
+    static std::mutex gStatsMutex;
+    static ThermalGovernorStats gStats;
+
+    void setThermalGovernorEnabled(bool enabled) {
+        gGovernorEnabled.store(enabled, std::memory_order_relaxed);
+        if (!enabled) {
+            // the GL thread only starts it again once it sees the governor on
+            stopSensorThread();
+        }
+    }
+
+    bool isThermalGovernorEnabled() {
+        return gGovernorEnabled.load(std::memory_order_relaxed);
+    }
+
+    void setThermalSource(ThermalSourceFunction source, void *userdata) {
+        gSource = source ? source : readThermalZones;
+        gSourceUserdata = source ? userdata : nullptr;
+        gPolicyStarted = false;
+    }
+
+    void reportThermalStatus(int status) {
+        gReportedStatus.store(status, std::memory_order_relaxed);
+    }
+
+    bool setThermalTraceFile(const char *path) {
+        std::lock_guard<std::mutex> lock(gTraceFileMutex);
+        gTracing.store(false, std::memory_order_relaxed);
+        if (gTraceFile) {
+            fclose(gTraceFile);
+            gTraceFile = nullptr;
+        }
+        if (!path || !*path) {
+            return true;
+        }
+        gTraceFile = fopen(path, "w");
+        if (!gTraceFile) {
+            LOGE("[ThermalGovernor] Could not create the trace %s.", path);
+            return false;
+        }
+        // a line a second; keep what there is if the app is killed
+        setvbuf(gTraceFile, nullptr, _IOLBF, 256);
+        fprintf(gTraceFile, "# time_s,temperature_c,status,frame_cost_ms,display_period_ms,tier,reason\n");
+        gTracing.store(true, std::memory_order_relaxed);
+        return true;
+    }
+
+    static void startPolicy(uint64_t displayPeriodNs) {
+        ThermalPolicyConfig config;
+        defaultThermalPolicyConfig(&config);
+        config.displayPeriodNs = displayPeriodNs;
+        initThermalPolicy(&gPolicy, config);
+        gPolicyStarted = true;
+        gFrameCostSumMs = 0.0;
+        gFrameCostCount = 0;
+        gLastReadingNs = 0;
+    }
+
+    const QualityTier &thermalGovernorFrame(uint64_t frameCostNs, uint64_t displayPeriodNs) {
+        if (!gGovernorEnabled.load(std::memory_order_relaxed)) {
+            if (gGovernorRunning) {
+                gGovernorRunning = false;
+                gPolicyStarted = false;
+                std::lock_guard<std::mutex> lock(gStatsMutex);
+                gStats.tier = 0;
+                LOGI("[ThermalGovernor] Off; back to full quality.");
+            }
+            return gQualityTiers[0];
+        }
+        if (!gGovernorRunning) {
+            gGovernorRunning = true;
+            startSensorThread();
+            LOGI("[ThermalGovernor] On.");
+        }
+        if (!gPolicyStarted) {
+            startPolicy(displayPeriodNs);
+        }
+        gPolicy.config.displayPeriodNs = displayPeriodNs;
+        gFrameCostSumMs += frameCostNs * 1.0e-6;
+        gFrameCostCount++;
+
+        ThermalReading reading;
+        if (!gSource(gSourceUserdata, &reading)) {
+            return gQualityTiers[gPolicy.tier];
+        }
+        if (reading.status == THERMAL_STATUS_UNKNOWN) {
+            reading.status = gReportedStatus.load(std::memory_order_relaxed);
+        }
+        float frameCostMs = gFrameCostCount ? static_cast<float>(gFrameCostSumMs / gFrameCostCount) : 0.0f;
+        gFrameCostSumMs = 0.0;
+        gFrameCostCount = 0;
+
+        int previousTier = gPolicy.tier;
+        int reason = updateThermalPolicy(&gPolicy, reading, frameCostMs);
+        {
+            std::lock_guard<std::mutex> lock(gStatsMutex);
+            if (gLastReadingNs && reading.timeNs > gLastReadingNs) {
+                gStats.tierTimeNs[previousTier] += reading.timeNs - gLastReadingNs;
+            }
+            gStats.tier = gPolicy.tier;
+            if (gPolicy.tier > previousTier) {
+                gStats.stepsDown++;
+            } else if (gPolicy.tier < previousTier) {
+                gStats.stepsUp++;
+            }
+            if (reason != TIER_CHANGE_NONE) {
+                gStats.lastReason = reason;
+            }
+            gStats.temperatureC = reading.temperatureC;
+            gStats.status = reading.status;
+            gStats.frameCostMs = gPolicy.frameCostMs;
+            gStats.slopeCPerMinute = gPolicy.slopeCPerSecond * 60.0f;
+        }
+        gLastReadingNs = reading.timeNs;
+
+        if (reason != TIER_CHANGE_NONE) {
+            LOGI("[ThermalGovernor] Tier %d -> %d (%s): %.1f C, %+.2f C/min, status %d, frames %.2f ms.",
+                 previousTier, gPolicy.tier, tierChangeReasonName(reason), reading.temperatureC,
+                 gPolicy.slopeCPerSecond * 60.0f, reading.status, gPolicy.frameCostMs);
+        }
+        OSVR_TRACE_COUNTER("qualityTier", static_cast<double>(gPolicy.tier));
+        if (!std::isnan(reading.temperatureC)) {
+            OSVR_TRACE_COUNTER("temperatureC", static_cast<double>(reading.temperatureC));
+        }
+        ThermalTraceRecord record = { reading, frameCostMs, displayPeriodNs, gPolicy.tier, reason };
+        queueTraceRecord(record);
+        return gQualityTiers[gPolicy.tier];
+    }
+
+    void getThermalGovernorStats(ThermalGovernorStats *statsOut) {
+        std::lock_guard<std::mutex> lock(gStatsMutex);
+        *statsOut = gStats;
+    }
+
+    void resetThermalGovernorStats() {
+        std::lock_guard<std::mutex> lock(gStatsMutex);
+        int tier = gStats.tier;
+        gStats = ThermalGovernorStats();
+        gStats.tier = tier;
+        gStats.temperatureC = NAN;
+        gStats.status = THERMAL_STATUS_UNKNOWN;
+    }
+}
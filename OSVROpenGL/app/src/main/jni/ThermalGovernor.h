@@ -0,0 +1,168 @@
+/*
+ * Copyright (C) 2015 Sensics, Inc. and contributors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef OSVROPENGL_THERMALGOVERNOR_H
+#define OSVROPENGL_THERMALGOVERNOR_H
+
+#include <cstdint>
+
+namespace OSVROpenGL {
+
+    // Steps the rendering down through quality tiers as the device heats up,
+    // ahead of the platform throttling it, and back up once it has cooled.
+    //
+    // About once a second it takes a thermal reading (the hottest sensor and,
+    // where the platform reports one, its thermal status) and the mean frame
+    // cost since the last one, and decides:
+    //  - a thermal status (or a temperature past the throttling point) puts a
+    //    floor under the tier, which is taken at once;
+    //  - frames using up most of the display period step down one tier, at
+    //    most once per stepDownHoldNs, and so does a temperature trend that
+    //    reaches the throttling point within the forecast, at most once per
+    //    trendStepDownHoldNs (the temperature is slower to answer);
+    //  - stepping back up needs all of that to have stayed clear, with the
+    //    frames well inside the period, for stepUpHoldNs; a step up that is
+    //    taken back within ten minutes doubles the hold for the next one.
+    //
+    // The policy is plain functions on a ThermalPolicyState, so it can be run
+    // over recorded traces (see thermal_tool in OSVROpenGL/host). The runtime
+    // below drives one from the renderer. On Android readings come from the
+    // sysfs thermal zones plus whatever status the app reports; on the host a
+    // stand-in source can be plugged in.
+
+    // Android's PowerManager.THERMAL_STATUS_* values.
+    enum ThermalStatus {
+        THERMAL_STATUS_UNKNOWN = -1,
+        THERMAL_STATUS_NONE = 0,
+        THERMAL_STATUS_LIGHT,
+        THERMAL_STATUS_MODERATE,
+        THERMAL_STATUS_SEVERE,
+        THERMAL_STATUS_CRITICAL,
+        THERMAL_STATUS_EMERGENCY,
+        THERMAL_STATUS_SHUTDOWN
+    };
+
+    struct ThermalReading {
+        uint64_t timeNs;
+        float temperatureC;     // hottest sensor, NaN if there is none
+        int status;             // a ThermalStatus
+    };
+
+    // What a tier turns down. Tier 0 is full quality.
+    struct QualityTier {
+        float renderScale;              // of the eye buffers' width and height drawn into
+        int maxEyeBufferSamples;        // caps the MSAA asked for with setEyeBufferSamples()
+        uint32_t cameraUploadInterval;  // a camera frame is uploaded every this many frames
+        uint32_t sceneAnimationInterval;// the scene is animated every this many frames
+    };
+    static const int kQualityTierCount = 5;
+    const QualityTier &qualityTier(int tier);
+
+    struct ThermalPolicyConfig {
+        uint64_t displayPeriodNs;
+        float throttleTemperatureC;     // where the platform starts throttling
+        float tierTemperatureStepC;     // each this much past it takes another tier
+        float forecastSeconds;          // how far ahead the temperature trend is projected
+        float stepUpMarginC;            // the forecast has to stay this far below throttling to step up
+        float frameBudgetHigh;          // frame cost, as a fraction of the period, that steps down
+        float frameBudgetLow;           // and that it has to stay under to step up
+        uint64_t stepDownHoldNs;
+        uint64_t trendStepDownHoldNs;
+        uint64_t stepUpHoldNs;
+    };
+    void defaultThermalPolicyConfig(ThermalPolicyConfig *configOut);
+
+    enum TierChangeReason {
+        TIER_CHANGE_NONE = 0,
+        TIER_CHANGE_STATUS,         // the thermal status or temperature put a floor under it
+        TIER_CHANGE_TREND,          // the temperature is headed for throttling
+        TIER_CHANGE_FRAME_TIME,     // frames are close to missing the display
+        TIER_CHANGE_RECOVERED       // stepped back up
+    };
+    const char *tierChangeReasonName(int reason);
+
+    // Temperatures of the last kThermalTrendReadings readings are fitted with
+    // a line for the trend.
+    static const int kThermalTrendReadings = 64;
+
+    struct ThermalPolicyState {
+        ThermalPolicyConfig config;
+        int tier;
+        bool haveReading;
+        uint64_t lastChangeNs;
+        uint64_t clearSinceNs;      // when stepping up last became possible, 0 while it isn't
+        uint64_t stepUpHoldNs;      // the hold in use, with the backoff
+        uint64_t lastStepUpNs;      // while it may still be taken back, else 0
+        float frameCostMs;          // smoothed
+        float slopeCPerSecond;
+        float trendTimes[kThermalTrendReadings];    // seconds since the first reading
+        float trendTemperatures[kThermalTrendReadings];
+        int trendCount;
+        int trendNext;
+        uint64_t firstReadingNs;
+    };
+    void initThermalPolicy(ThermalPolicyState *state, const ThermalPolicyConfig &config);
+    // Takes a reading and the mean frame cost (CPU work plus the wait for the
+    // GPU) since the previous one, 0 if there were no frames. Returns why the
+    // tier changed, or TIER_CHANGE_NONE.
+    int updateThermalPolicy(ThermalPolicyState *state, const ThermalReading &reading, float frameCostMs);
+
+    // Fills in a reading; returns false when there is no new one. Called on the
+    // GL thread every frame, so a source should keep to its own rate.
+    typedef bool (*ThermalSourceFunction)(void *userdata, ThermalReading *readingOut);
+
+    // The sysfs thermal zones; the default source. A thread of the governor's
+    // own reads them once a second while the GL thread keeps asking, so this
+    // only picks up its latest reading.
+    bool readThermalZones(void *userdata, ThermalReading *readingOut);
+
+    // Off by default. Any thread; applied at the next frame. Turning it off
+    // stops the sensor thread, which also writes the trace.
+    void setThermalGovernorEnabled(bool enabled);
+    bool isThermalGovernorEnabled();
+    // Call while the GL thread is paused or not yet started. Null restores
+    // the default source.
+    void setThermalSource(ThermalSourceFunction source, void *userdata);
+    // The platform's thermal status, for sources that have none (Android's
+    // PowerManager reports it to Java). Any thread.
+    void reportThermalStatus(int status);
+    // Appends every reading and the decision taken on it to a CSV file that
+    // thermal_tool can replay; null stops. Call while the GL thread is paused
+    // or not yet started.
+    bool setThermalTraceFile(const char *path);
+
+    // Once per frame on the GL thread, with the frame's cost; takes a reading
+    // if the source has one. Returns the tier to render with.
+    const QualityTier &thermalGovernorFrame(uint64_t frameCostNs, uint64_t displayPeriodNs);
+
+    struct ThermalGovernorStats {
+        int tier;
+        uint32_t stepsDown;
+        uint32_t stepsUp;
+        int lastReason;             // a TierChangeReason
+        float temperatureC;         // of the last reading
+        int status;
+        float frameCostMs;
+        float slopeCPerMinute;
+        uint64_t tierTimeNs[kQualityTierCount];
+    };
+    void getThermalGovernorStats(ThermalGovernorStats *statsOut);
+    // The tier is kept.
+    void resetThermalGovernorStats();
+}
+
+#endif // OSVROPENGL_THERMALGOVERNOR_H
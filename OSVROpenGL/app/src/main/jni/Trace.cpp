@@ -0,0 +1,304 @@
+/*
+ * Copyright (C) 2015 Sensics, Inc. and contributors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include <algorithm>
+#include <cstdio>
+
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "Logging.h"
+#include "Trace.h"
+
+namespace OSVROpenGL {
+
+    static const int kMaxTraceThreads = 16;
+
+    enum TracePhase {
+        TRACE_PHASE_COMPLETE = 'X',
+        TRACE_PHASE_INSTANT = 'i',
+        TRACE_PHASE_COUNTER = 'C'
+    };
+
+    struct TraceEvent {
+        const char *name;
+        uint64_t timestampNs;
+        union {
+            uint64_t durationNs;    // TRACE_PHASE_COMPLETE
+            double value;           // TRACE_PHASE_COUNTER
+        };
+        uint32_t track;             // 0 for the owning thread, otherwise a pseudo thread
+        char phase;
+    };
+
+    // Written only by its owning thread; read by dumpTrace. When the owner
+    // exits the buffer goes back to the pool for the next new thread, which
+    // carries on from the same writeIndex; the previous owner's events stay
+    // dumpable until then.
+    struct TraceThreadBuffer {
+        std::atomic<uint32_t> tid;
+        const char *threadName;
+        size_t mask;
+        TraceEvent *events;
+        std::atomic<uint64_t> writeIndex;
+        std::atomic<uint64_t> firstIndex;   // the owner's first event
+        std::atomic<bool> owned;
+    };
+
+    std::atomic<bool> gTracingEnabled(false);
+
+    static std::atomic<TraceThreadBuffer *> gTraceBuffers[kMaxTraceThreads];
+    static std::atomic<int> gTraceBufferCount(0);
+    static size_t gTraceEventsPerThread = 1 << 17;
+    static std::atomic<uint64_t> gTraceStartNs(0);
+
+    // Gives the thread's buffer back on thread exit.
+    struct ThreadTraceBuffer {
+        TraceThreadBuffer *buffer = nullptr;
+
+        ~ThreadTraceBuffer() {
+            if (buffer) {
+                buffer->owned.store(false, std::memory_order_release);
+            }
+        }
+    };
+
+    static thread_local ThreadTraceBuffer tTraceBuffer;
+    static thread_local const char *tTraceThreadName = nullptr;
+
+    static size_t roundUpToPowerOfTwo(size_t value) {
+        size_t ret = 1;
+        while (ret < value) {
+            ret <<= 1;
+        }
+        return ret;
+    }
+
+    static void takeBuffer(TraceThreadBuffer *buffer) {
+        buffer->threadName = tTraceThreadName;
+        buffer->tid.store(static_cast<uint32_t>(syscall(SYS_gettid)), std::memory_order_relaxed);
+        buffer->firstIndex.store(buffer->writeIndex.load(std::memory_order_relaxed), std::memory_order_release);
+        tTraceBuffer.buffer = buffer;
+    }
+
+    // On a thread's first event: a buffer an exited thread gave back, or
+    // else the one allocation the thread makes.
+    static TraceThreadBuffer *getThreadBuffer() {
+        if (tTraceBuffer.buffer) {
+            return tTraceBuffer.buffer;
+        }
+        int count = std::min(gTraceBufferCount.load(), kMaxTraceThreads);
+        for (int i = 0; i < count; i++) {
+            TraceThreadBuffer *buffer = gTraceBuffers[i].load(std::memory_order_acquire);
+            bool owned = false;
+            if (buffer && buffer->owned.compare_exchange_strong(owned, true, std::memory_order_acquire)) {
+                takeBuffer(buffer);
+                return buffer;
+            }
+        }
+        int slot = gTraceBufferCount.fetch_add(1);
+        if (slot >= kMaxTraceThreads) {
+            gTraceBufferCount.fetch_sub(1);
+            return nullptr;
+        }
+        size_t capacity = roundUpToPowerOfTwo(gTraceEventsPerThread);
+        TraceThreadBuffer *buffer = new TraceThreadBuffer();
+        buffer->mask = capacity - 1;
+        buffer->events = new TraceEvent[capacity];
+        buffer->writeIndex.store(0);
+        buffer->owned.store(true);
+        takeBuffer(buffer);
+        gTraceBuffers[slot].store(buffer, std::memory_order_release);
+        return buffer;
+    }
+
+    static TraceEvent *nextEvent(TraceThreadBuffer *buffer, uint64_t *indexOut) {
+        uint64_t index = buffer->writeIndex.load(std::memory_order_relaxed);
+        *indexOut = index;
+        // pairs with dumpTrace's acquire fence: the slot is only written to
+        // once writeIndex says the event that was in it is being overwritten
+        std::atomic_thread_fence(std::memory_order_release);
+        return &buffer->events[index & buffer->mask];
+    }
+
+    static void publishEvent(TraceThreadBuffer *buffer, uint64_t index) {
+        buffer->writeIndex.store(index + 1, std::memory_order_release);
+    }
+
+    void startTracing(size_t eventsPerThread) {
+        gTraceEventsPerThread = eventsPerThread;
+        // Other threads may be writing, so their rings aren't touched: what
+        // they hold from before is older than the start and left out of dumps.
+        gTraceStartNs.store(frameStatsNowNs(), std::memory_order_relaxed);
+        gTracingEnabled.store(true);
+        LOGI("[Trace] Tracing started.");
+    }
+
+    void stopTracing() {
+        gTracingEnabled.store(false);
+        LOGI("[Trace] Tracing stopped.");
+    }
+
+    void traceSetThreadName(const char *name) {
+        tTraceThreadName = name;
+        if (tTraceBuffer.buffer) {
+            tTraceBuffer.buffer->threadName = name;
+        }
+    }
+
+    void traceCompleteOnTrack(uint32_t track, const char *name, uint64_t startNs, uint64_t durationNs) {
+        TraceThreadBuffer *buffer = getThreadBuffer();
+        if (!buffer) {
+            return;
+        }
+        uint64_t index;
+        TraceEvent *event = nextEvent(buffer, &index);
+        event->name = name;
+        event->timestampNs = startNs;
+        event->durationNs = durationNs;
+        event->track = track;
+        event->phase = TRACE_PHASE_COMPLETE;
+        publishEvent(buffer, index);
+    }
+
+    void traceComplete(const char *name, uint64_t startNs, uint64_t durationNs) {
+        traceCompleteOnTrack(0, name, startNs, durationNs);
+    }
+
+    void traceInstant(const char *name) {
+        TraceThreadBuffer *buffer = getThreadBuffer();
+        if (!buffer) {
+            return;
+        }
+        uint64_t index;
+        TraceEvent *event = nextEvent(buffer, &index);
+        event->name = name;
+        event->timestampNs = frameStatsNowNs();
+        event->durationNs = 0;
+        event->track = 0;
+        event->phase = TRACE_PHASE_INSTANT;
+        publishEvent(buffer, index);
+    }
+
+    void traceCounter(const char *name, double value) {
+        TraceThreadBuffer *buffer = getThreadBuffer();
+        if (!buffer) {
+            return;
+        }
+        uint64_t index;
+        TraceEvent *event = nextEvent(buffer, &index);
+        event->name = name;
+        event->timestampNs = frameStatsNowNs();
+        event->value = value;
+        event->track = 0;
+        event->phase = TRACE_PHASE_COUNTER;
+        publishEvent(buffer, index);
+    }
+
+    static void writeJsonString(FILE *file, const char *value) {
+        fputc('"', file);
+        for (const char *p = value ? value : ""; *p; p++) {
+            if (*p == '"' || *p == '\\') {
+                fputc('\\', file);
+            }
+            fputc(*p, file);
+        }
+        fputc('"', file);
+    }
+
+    static void writeThreadName(FILE *file, int pid, uint32_t tid, const char *name, bool *first) {
+        fprintf(file, "%s\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":%u,\"args\":{\"name\":",
+                *first ? "" : ",", pid, tid);
+        writeJsonString(file, name);
+        fputs("}}", file);
+        *first = false;
+    }
+
+    bool dumpTrace(const char *path) {
+        FILE *file = fopen(path, "w");
+        if (!file) {
+            LOGE("[Trace] Could not open %s for writing.", path);
+            return false;
+        }
+
+        int pid = static_cast<int>(getpid());
+        bool first = true;
+        size_t written = 0;
+        fputs("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[", file);
+        writeThreadName(file, pid, kTraceGpuTrack, "GPU (aligned to submit)", &first);
+
+        uint64_t startNs = gTraceStartNs.load(std::memory_order_relaxed);
+        int count = std::min(gTraceBufferCount.load(), kMaxTraceThreads);
+        for (int i = 0; i < count; i++) {
+            TraceThreadBuffer *buffer = gTraceBuffers[i].load(std::memory_order_acquire);
+            if (!buffer) {
+                continue;
+            }
+            // a new owner taking the buffer meanwhile would get the old one's events
+            uint64_t firstIndex = buffer->firstIndex.load(std::memory_order_acquire);
+            uint32_t ownerTid = buffer->tid.load(std::memory_order_relaxed);
+            const char *threadName = buffer->threadName;
+            if (buffer->firstIndex.load(std::memory_order_acquire) != firstIndex) {
+                continue;
+            }
+            char unnamed[32];
+            snprintf(unnamed, sizeof(unnamed), "thread %u", ownerTid);
+            writeThreadName(file, pid, ownerTid, threadName ? threadName : unnamed, &first);
+
+            uint64_t end = buffer->writeIndex.load(std::memory_order_acquire);
+            uint64_t capacity = buffer->mask + 1;
+            uint64_t begin = std::max(end > capacity ? end - capacity : 0, firstIndex);
+            for (uint64_t index = begin; index < end; index++) {
+                // copied, then dropped if the owner may have written over it
+                // meanwhile: it is writing index writeIndex, into the slot of
+                // writeIndex - capacity
+                TraceEvent event = buffer->events[index & buffer->mask];
+                std::atomic_thread_fence(std::memory_order_acquire);
+                if (index + capacity <= buffer->writeIndex.load(std::memory_order_relaxed)) {
+                    continue;
+                }
+                if (event.timestampNs < startNs) {
+                    continue;
+                }
+                uint32_t tid = event.track ? event.track : ownerTid;
+                double tsUs = (event.timestampNs - startNs) / 1000.0;
+                fputs(",\n{\"name\":", file);
+                writeJsonString(file, event.name);
+                switch (event.phase) {
+                    case TRACE_PHASE_COMPLETE:
+                        fprintf(file, ",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":%d,\"tid\":%u}",
+                                tsUs, event.durationNs / 1000.0, pid, tid);
+                        break;
+                    case TRACE_PHASE_INSTANT:
+                        fprintf(file, ",\"ph\":\"i\",\"s\":\"t\",\"ts\":%.3f,\"pid\":%d,\"tid\":%u}",
+                                tsUs, pid, tid);
+                        break;
+                    default:
+                        fprintf(file, ",\"ph\":\"C\",\"ts\":%.3f,\"pid\":%d,\"tid\":%u,\"args\":{\"value\":%g}}",
+                                tsUs, pid, tid, event.value);
+                        break;
+                }
+                written++;
+            }
+        }
+        fputs("\n]}\n", file);
+        bool ok = ferror(file) == 0;
+        ok = (fclose(file) == 0) && ok;
+        LOGI("[Trace] Wrote %u events to %s", static_cast<unsigned>(written), path);
+        return ok;
+    }
+}
@@ -0,0 +1,105 @@
+/*
+ * Copyright (C) 2015 Sensics, Inc. and contributors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef OSVROPENGL_TRACE_H
+#define OSVROPENGL_TRACE_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+#include "FrameStats.h"
+
+// Build with -DOSVROPENGL_TRACING=0 to compile the trace points out entirely.
+#ifndef OSVROPENGL_TRACING
+#define OSVROPENGL_TRACING 1
+#endif
+
+namespace OSVROpenGL {
+
+    // Timeline tracing in the Chrome trace-event format (load the dump in
+    // chrome://tracing or ui.perfetto.dev).
+    //
+    // Each thread records into its own fixed-size ring, allocated the first time
+    // the thread emits an event during a capture and reused afterwards, so a
+    // capture can run indefinitely without allocating; once a ring is full the
+    // oldest events are overwritten. A thread's ring is handed to the next new
+    // thread when it exits, so threads restarted on pause or on an async
+    // switch don't use up rings. When tracing is compiled in but not started,
+    // every trace point costs one relaxed atomic load.
+    //
+    // Event names must be string literals (or otherwise outlive the capture).
+
+    // Pseudo thread the GPU timings are drawn on.
+    static const uint32_t kTraceGpuTrack = 0xffff0001u;
+
+    extern std::atomic<bool> gTracingEnabled;
+
+    inline bool isTracingEnabled() {
+        return gTracingEnabled.load(std::memory_order_relaxed);
+    }
+
+    // eventsPerThread is only used by threads that haven't traced before.
+    void startTracing(size_t eventsPerThread = 1 << 17);
+    void stopTracing();
+
+    // Writes everything currently buffered as trace-event JSON. Safe to call
+    // while tracing; events recorded during the dump may or may not be included,
+    // and ones overwritten while being read are left out.
+    bool dumpTrace(const char *path);
+
+    // Names the calling thread in the dump.
+    void traceSetThreadName(const char *name);
+
+    // A span that started at startNs (frameStatsNowNs() clock) and lasted durationNs.
+    void traceComplete(const char *name, uint64_t startNs, uint64_t durationNs);
+    // Same, drawn on a pseudo thread such as kTraceGpuTrack.
+    void traceCompleteOnTrack(uint32_t track, const char *name, uint64_t startNs, uint64_t durationNs);
+    void traceInstant(const char *name);
+    void traceCounter(const char *name, double value);
+
+    class ScopedTraceEvent {
+        const char *mName;
+        uint64_t mStartNs;
+
+    public:
+        explicit ScopedTraceEvent(const char *name)
+            : mName(name), mStartNs(isTracingEnabled() ? frameStatsNowNs() : 0) {
+        }
+
+        ~ScopedTraceEvent() {
+            if (mStartNs && isTracingEnabled()) {
+                traceComplete(mName, mStartNs, frameStatsNowNs() - mStartNs);
+            }
+        }
+    };
+}
+
+#if OSVROPENGL_TRACING
+#define OSVR_TRACE_SCOPE(name) \
+    ::OSVROpenGL::ScopedTraceEvent OSVR_FRAME_STATS_CONCAT(traceScope, __LINE__)(name)
+#define OSVR_TRACE_INSTANT(name) \
+    do { if (::OSVROpenGL::isTracingEnabled()) ::OSVROpenGL::traceInstant(name); } while (0)
+#define OSVR_TRACE_COUNTER(name, value) \
+    do { if (::OSVROpenGL::isTracingEnabled()) ::OSVROpenGL::traceCounter(name, value); } while (0)
+#else
+#define OSVR_TRACE_SCOPE(name) ((void)0)
+#define OSVR_TRACE_INSTANT(name) ((void)0)
+#define OSVR_TRACE_COUNTER(name, value) ((void)0)
+#endif
+
+#endif // OSVROPENGL_TRACE_H
@@ -20,1199 +20,422 @@
 
 //BEGIN_INCLUDE(all)
 
-#include <iostream>
-#include <sstream>
-#include <stdexcept>
-#include <chrono>
-#include <thread>
-#include <vector>
-#include <sstream>
-
-#include <dlfcn.h>
+#include <jni.h>
+#include <android/asset_manager_jni.h>
+
+#include "Renderer.h"
+#include "FrameStats.h"
+#include "Trace.h"
+#include "Recording.h"
+#include "LatencyMonitor.h"
+#include "FramePacer.h"
+#include "Scene.h"
+#include "Reprojection.h"
+#include "DistortionMesh.h"
+#include "CompressedTexture.h"
+#include "SceneMesh.h"
+#include "Asset.h"
+#include "ThermalGovernor.h"
+#include "FrameCapture.h"
+#include "GpuMemory.h"
+#include "Materials.h"
 
-//#include <boost/filesystem.hpp>
+extern "C" {
+    JNIEXPORT void JNICALL Java_com_osvr_android_gles2sample_MainActivityJNILib_initGraphics(JNIEnv * env, jobject obj,  jint width, jint height);
+    JNIEXPORT void JNICALL Java_com_osvr_android_gles2sample_MainActivityJNILib_initOSVR(JNIEnv *env, jobject obj);
+    JNIEXPORT void JNICALL Java_com_osvr_android_gles2sample_MainActivityJNILib_step(JNIEnv * env, jobject obj);
+    JNIEXPORT void JNICALL Java_com_osvr_android_gles2sample_MainActivityJNILib_pause(JNIEnv * env, jobject obj);
+    JNIEXPORT void JNICALL Java_com_osvr_android_gles2sample_MainActivityJNILib_resume(JNIEnv * env, jobject obj);
+    JNIEXPORT void JNICALL Java_com_osvr_android_gles2sample_MainActivityJNILib_stop(JNIEnv * env, jobject obj);
+    JNIEXPORT jint JNICALL Java_com_osvr_android_gles2sample_MainActivityJNILib_drainInputEvents(JNIEnv * env, jobject obj, jobject buffer);
+    JNIEXPORT jint JNICALL Java_com_osvr_android_gles2sample_MainActivityJNILib_getFrameStats(JNIEnv * env, jobject obj, jfloatArray statsOut);
+    JNIEXPORT jstring JNICALL Java_com_osvr_android_gles2sample_MainActivityJNILib_getFrameStageName(JNIEnv * env, jobject obj, jint stage);
+    JNIEXPORT void JNICALL Java_com_osvr_android_gles2sample_MainActivityJNILib_resetFrameStats(JNIEnv * env, jobject obj);
+    JNIEXPORT void JNICALL Java_com_osvr_android_gles2sample_MainActivityJNILib_startTracing(JNIEnv * env, jobject obj);
+    JNIEXPORT void JNICALL Java_com_osvr_android_gles2sample_MainActivityJNILib_stopTracing(JNIEnv * env, jobject obj);
+    JNIEXPORT jboolean JNICALL Java_com_osvr_android_gles2sample_MainActivityJNILib_dumpTrace(JNIEnv * env, jobject obj, jstring path);
+    JNIEXPORT jboolean JNICALL Java_com_osvr_android_gles2sample_MainActivityJNILib_startRecording(JNIEnv * env, jobject obj, jstring path, jboolean compressImages);
+    JNIEXPORT void JNICALL Java_com_osvr_android_gles2sample_MainActivityJNILib_stopRecording(JNIEnv * env, jobject obj);
+    JNIEXPORT jboolean JNICALL Java_com_osvr_android_gles2sample_MainActivityJNILib_startReplay(JNIEnv * env, jobject obj, jstring path, jfloat speed, jboolean loop);
+    JNIEXPORT void JNICALL Java_com_osvr_android_gles2sample_MainActivityJNILib_stopReplay(JNIEnv * env, jobject obj);
+    JNIEXPORT void JNICALL Java_com_osvr_android_gles2sample_MainActivityJNILib_setLatencyMeasurement(JNIEnv * env, jobject obj, jboolean enabled, jboolean testPattern);
+    JNIEXPORT void JNICALL Java_com_osvr_android_gles2sample_MainActivityJNILib_setFramePacing(JNIEnv * env, jobject obj, jint maxFramesInFlight, jboolean justInTime, jfloat refreshRateHz);
+    JNIEXPORT jintArray JNICALL Java_com_osvr_android_gles2sample_MainActivityJNILib_getFramePacing(JNIEnv * env, jobject obj);
+    JNIEXPORT void JNICALL Java_com_osvr_android_gles2sample_MainActivityJNILib_setSceneConfig(JNIEnv * env, jobject obj, jint objectCount, jint workerThreads);
+    JNIEXPORT void JNICALL Java_com_osvr_android_gles2sample_MainActivityJNILib_setAsyncReprojection(JNIEnv * env, jobject obj, jboolean enabled);
+    JNIEXPORT jlongArray JNICALL Java_com_osvr_android_gles2sample_MainActivityJNILib_getReprojectionStats(JNIEnv * env, jobject obj);
+    JNIEXPORT void JNICALL Java_com_osvr_android_gles2sample_MainActivityJNILib_setSimulatedFrameDelay(JNIEnv * env, jobject obj, jint delayMs, jint everyNFrames);
+    JNIEXPORT void JNICALL Java_com_osvr_android_gles2sample_MainActivityJNILib_setDistortionMesh(JNIEnv * env, jobject obj, jstring configPath, jstring cacheDir, jint gridWidth, jint gridHeight);
+    JNIEXPORT void JNICALL Java_com_osvr_android_gles2sample_MainActivityJNILib_setSceneTexture(JNIEnv * env, jobject obj, jstring path);
+    JNIEXPORT void JNICALL Java_com_osvr_android_gles2sample_MainActivityJNILib_setSceneMesh(JNIEnv * env, jobject obj, jstring path);
+    JNIEXPORT void JNICALL Java_com_osvr_android_gles2sample_MainActivityJNILib_setAssetManager(JNIEnv * env, jobject obj, jobject assetManager);
+    JNIEXPORT void JNICALL Java_com_osvr_android_gles2sample_MainActivityJNILib_setThermalGovernor(JNIEnv * env, jobject obj, jboolean enabled, jstring tracePath);
+    JNIEXPORT void JNICALL Java_com_osvr_android_gles2sample_MainActivityJNILib_reportThermalStatus(JNIEnv * env, jobject obj, jint status);
+    JNIEXPORT jfloatArray JNICALL Java_com_osvr_android_gles2sample_MainActivityJNILib_getThermalGovernorStats(JNIEnv * env, jobject obj);
+    JNIEXPORT void JNICALL Java_com_osvr_android_gles2sample_MainActivityJNILib_setEyeBufferSamples(JNIEnv * env, jobject obj, jint samples);
+    JNIEXPORT void JNICALL Java_com_osvr_android_gles2sample_MainActivityJNILib_setFrameCapture(JNIEnv * env, jobject obj, jstring directory, jint everyNFrames, jint frameCount, jboolean window);
+    JNIEXPORT jlongArray JNICALL Java_com_osvr_android_gles2sample_MainActivityJNILib_getFrameCaptureStats(JNIEnv * env, jobject obj);
+    JNIEXPORT void JNICALL Java_com_osvr_android_gles2sample_MainActivityJNILib_setGpuMemoryBudget(JNIEnv * env, jobject obj, jint megabytes);
+    JNIEXPORT jlongArray JNICALL Java_com_osvr_android_gles2sample_MainActivityJNILib_getGpuMemoryStats(JNIEnv * env, jobject obj);
+    JNIEXPORT void JNICALL Java_com_osvr_android_gles2sample_MainActivityJNILib_setSceneMaterials(JNIEnv * env, jobject obj, jint count, jint batching, jstring atlasPath);
+};
 
-//#define GL_GLEXT_PROTOTYPES 1
-#include <GLES2/gl2.h>
-#include <GLES2/gl2ext.h>
+JNIEXPORT void JNICALL Java_com_osvr_android_gles2sample_MainActivityJNILib_initGraphics(JNIEnv * env, jobject obj,  jint width, jint height)
+{
+    OSVROpenGL::setupGraphics(width, height);
+}
 
-#include <osvr/ClientKit/ContextC.h>
-#include <osvr/ClientKit/InterfaceC.h>
-#include <osvr/ClientKit/InterfaceStateC.h>
-#include <osvr/ClientKit/DisplayC.h>
-#include <osvr/ClientKit/InterfaceCallbackC.h>
-#include <osvr/ClientKit/ImagingC.h>
-#include <osvr/ClientKit/ServerAutoStartC.h>
-#include <osvr/RenderKit/RenderManagerC.h>
-#include <osvr/RenderKit/RenderManagerOpenGLC.h>
-#include <osvr/RenderKit/RenderKitGraphicsTransforms.h>
+JNIEXPORT void JNICALL Java_com_osvr_android_gles2sample_MainActivityJNILib_initOSVR(JNIEnv *env, jobject obj)
+{
+    OSVROpenGL::setupOSVR();
+}
 
-#include <jni.h>
-#include <android/log.h>
+JNIEXPORT void JNICALL Java_com_osvr_android_gles2sample_MainActivityJNILib_step(JNIEnv * env, jobject obj)
+{
+    OSVROpenGL::renderFrame();
+}
 
-#define  LOG_TAG    "libgl2jni"
-#define  LOGI(...)  __android_log_print(ANDROID_LOG_INFO,LOG_TAG,__VA_ARGS__)
-#define  LOGE(...)  __android_log_print(ANDROID_LOG_ERROR,LOG_TAG,__VA_ARGS__)
+JNIEXPORT void JNICALL Java_com_osvr_android_gles2sample_MainActivityJNILib_pause(JNIEnv * env, jobject obj)
+{
+    OSVROpenGL::pause();
+}
 
+JNIEXPORT void JNICALL Java_com_osvr_android_gles2sample_MainActivityJNILib_resume(JNIEnv * env, jobject obj)
+{
+    OSVROpenGL::resume();
+}
 
-namespace OSVROpenGL {
-//    static PFNGLBINDVERTEXARRAYOESPROC bindVertexArrayOES;
-//
-//    void initializeGLES2Ext()
-//    {
-//        void *lh = dlopen("libGLESv2.so", RTLD_LAZY);
-//        bindVertexArrayOES = (PFNGLBINDVERTEXARRAYOESPROC)dlsym(lh, "glBindVertexArrayOES");
-//    }
+JNIEXPORT void JNICALL Java_com_osvr_android_gles2sample_MainActivityJNILib_stop(JNIEnv * env, jobject obj)
+{
+    OSVROpenGL::stop();
+}
 
-    inline osvr::renderkit::OSVR_ProjectionMatrix ConvertProjectionMatrix(::OSVR_ProjectionMatrix matrix)
-    {
-        osvr::renderkit::OSVR_ProjectionMatrix ret = { 0 };
-        ret.bottom = matrix.bottom;
-        ret.top = matrix.top;
-        ret.left = matrix.left;
-        ret.right = matrix.right;
-        ret.nearClip = matrix.nearClip;
-        ret.farClip = matrix.farClip;
-        return ret;
+JNIEXPORT jint JNICALL Java_com_osvr_android_gles2sample_MainActivityJNILib_drainInputEvents(JNIEnv * env, jobject obj, jobject buffer)
+{
+    void *address = env->GetDirectBufferAddress(buffer);
+    jlong capacity = env->GetDirectBufferCapacity(buffer);
+    if (!address || capacity <= 0) {
+        return 0;
     }
+    return OSVROpenGL::drainInputEvents(address, static_cast<size_t>(capacity));
+}
 
-    static void checkReturnCode(OSVR_ReturnCode returnCode, const char *msg) {
-        if (returnCode != OSVR_RETURN_SUCCESS) {
-            LOGI("[OSVR] OSVR method returned a failure: %s", msg);
-            throw std::runtime_error(msg);
-        }
+JNIEXPORT jint JNICALL Java_com_osvr_android_gles2sample_MainActivityJNILib_getFrameStats(JNIEnv * env, jobject obj, jfloatArray statsOut)
+{
+    // 4 floats per stage: p50, p90, p99 and max, in milliseconds
+    jint stageCount = env->GetArrayLength(statsOut) / 4;
+    if (stageCount > OSVROpenGL::FRAME_STAGE_COUNT) {
+        stageCount = OSVROpenGL::FRAME_STAGE_COUNT;
     }
+    for (jint stage = 0; stage < stageCount; stage++) {
+        OSVROpenGL::FrameStageSummary summary;
+        OSVROpenGL::getFrameStageSummary(static_cast<OSVROpenGL::FrameStage>(stage), &summary);
+        jfloat values[4] = {
+                static_cast<jfloat>(summary.p50Ns / 1.0e6),
+                static_cast<jfloat>(summary.p90Ns / 1.0e6),
+                static_cast<jfloat>(summary.p99Ns / 1.0e6),
+                static_cast<jfloat>(summary.maxNs / 1.0e6)
+        };
+        env->SetFloatArrayRegion(statsOut, stage * 4, 4, values);
+    }
+    return stageCount;
+}
 
-    // RAII wrapper around the RenderManager collection APIs for OpenGL
-    class RenderInfoCollectionOpenGL {
-        private:
-            OSVR_RenderManager mRenderManager = nullptr;
-            OSVR_RenderInfoCollection mRenderInfoCollection = nullptr;
-            OSVR_RenderParams mRenderParams = {0};
-
-        public:
-        RenderInfoCollectionOpenGL(OSVR_RenderManager renderManager, OSVR_RenderParams renderParams)
-            : mRenderManager(renderManager), mRenderParams(renderParams) {
-            OSVR_ReturnCode rc;
-            rc = osvrRenderManagerGetRenderInfoCollection(mRenderManager, mRenderParams, &mRenderInfoCollection);
-            checkReturnCode(rc, "osvrRenderManagerGetRenderInfoCollection call failed.");
-        }
-
-        OSVR_RenderInfoCount getNumRenderInfo() {
-            OSVR_RenderInfoCount ret;
-            OSVR_ReturnCode rc;
-            rc = osvrRenderManagerGetNumRenderInfoInCollection(mRenderInfoCollection, &ret);
-            checkReturnCode(rc, "osvrRenderManagerGetNumRenderInfoInCollection call failed.");
-            return ret;
-        }
-
-        OSVR_RenderInfoOpenGL getRenderInfo(OSVR_RenderInfoCount index) {
-            if(index < 0 || index >= getNumRenderInfo()) {
-                const static char* err = "getRenderInfo called with invalid index";
-                LOGE(err);
-                throw std::runtime_error(err);
-            }
-            OSVR_RenderInfoOpenGL ret;
-            OSVR_ReturnCode rc;
-            rc = osvrRenderManagerGetRenderInfoFromCollectionOpenGL(mRenderInfoCollection, index, &ret);
-            checkReturnCode(rc, "osvrRenderManagerGetRenderInfoFromCollectionOpenGL call failed.");
-            return ret;
-        }
-
-        ~RenderInfoCollectionOpenGL() {
-            if(mRenderInfoCollection) {
-                osvrRenderManagerReleaseRenderInfoCollection(mRenderInfoCollection);
-            }
-        }
-    };
-
-    typedef struct OSVR_RenderTargetInfo {
-        GLuint colorBufferName;
-        GLuint depthBufferName;
-        GLuint frameBufferName;
-        GLuint renderBufferName; // @todo - do we need this?
-    } OSVR_RenderTargetInfo;
-
-    static const char gVertexShader[] =
-            "uniform mat4 model;\n"
-                    "uniform mat4 view;\n"
-                    "uniform mat4 projection;\n"
-                    "attribute vec4 vPosition;\n"
-                    "attribute vec4 vColor;\n"
-                    "attribute vec2 vTexCoordinate;\n"
-                    "varying vec2 texCoordinate;\n"
-                    "varying vec4 fragmentColor;\n"
-                    "void main() {\n"
-                    "  gl_Position = projection * view * model * vPosition;\n"
-                    "  fragmentColor = vColor;\n"
-                    "  texCoordinate = vTexCoordinate;\n"
-                    "}\n";
-
-    static const char gFragmentShader[] =
-            "precision mediump float;\n"
-                    "uniform sampler2D uTexture;\n"
-                    "varying vec2 texCoordinate;\n"
-                    "varying vec4 fragmentColor;\n"
-                    "void main()\n"
-                    "{\n"
-                    "    gl_FragColor = fragmentColor * texture2D(uTexture, texCoordinate);\n"
-                    //"    gl_FragColor = texture2D(uTexture, texCoordinate);\n"
-                    "}\n";
-
-    // GLES globals
-    static int gWidth = 0;
-    static int gHeight = 0;
-    static GLuint gProgram;
-    static GLuint gvPositionHandle;
-    static GLuint gvColorHandle;
-    static GLuint gvTexCoordinateHandle;
-    static GLuint guTextureUniformId;
-    static GLuint gvProjectionUniformId;
-    static GLuint gvViewUniformId;
-    static GLuint gvModelUniformId;
-    static GLuint gTextureID;
-    static bool gGraphicsInitializedOnce = false; // if setupGraphics has been called at least once
-
-    // OSVR globals
-    static bool gOSVRInitialized = false;
-    static bool gRenderManagerInitialized = false;
-    //static OSVR_DisplayConfig gOSVRDisplayConfig;
-    static OSVR_ClientContext gClientContext = NULL;
-    static OSVR_ClientInterface gCamera = NULL;
-    static OSVR_ClientInterface gHead = NULL;
-
-    static OSVR_ClientInterface gLeftButton = NULL;
-    static OSVR_ClientInterface gRightButton = NULL;
-    static OSVR_ClientInterface gUpButton = NULL;
-    static OSVR_ClientInterface gDownButton = NULL;
-    static OSVR_ClientInterface gCenterButton = NULL;
-    static OSVR_ClientInterface gBackButton = NULL;
-    static OSVR_ClientInterface gVolumeUpButton = NULL;
-    static OSVR_ClientInterface gVolumeDownButton = NULL;
+JNIEXPORT jstring JNICALL Java_com_osvr_android_gles2sample_MainActivityJNILib_getFrameStageName(JNIEnv * env, jobject obj, jint stage)
+{
+    return env->NewStringUTF(OSVROpenGL::frameStageName(stage));
+}
 
-    static OSVR_ClientInterface gMouseLocation2D = NULL;
+JNIEXPORT void JNICALL Java_com_osvr_android_gles2sample_MainActivityJNILib_resetFrameStats(JNIEnv * env, jobject obj)
+{
+    OSVROpenGL::resetFrameStats();
+}
 
-    static int gReportNumber = 0;
-    static OSVR_ImageBufferElement *gLastFrame = nullptr;
-    static GLuint gLastFrameWidth = 0;
-    static GLuint gLastFrameHeight = 0;
-    static GLubyte *gTextureBuffer = nullptr;
-    OSVR_GraphicsLibraryOpenGL gGraphicsLibrary = {0};
-    OSVR_RenderManager gRenderManager = nullptr;
-    OSVR_RenderManagerOpenGL gRenderManagerOGL = nullptr;
-    OSVR_RenderParams gRenderParams = {0};
+JNIEXPORT void JNICALL Java_com_osvr_android_gles2sample_MainActivityJNILib_startTracing(JNIEnv * env, jobject obj)
+{
+    OSVROpenGL::startTracing();
+}
 
-    std::vector<OSVR_RenderTargetInfo> gRenderTargets;
-    GLuint gFrameBuffer;
+JNIEXPORT void JNICALL Java_com_osvr_android_gles2sample_MainActivityJNILib_stopTracing(JNIEnv * env, jobject obj)
+{
+    OSVROpenGL::stopTracing();
+}
 
-    static void printGLString(const char *name, GLenum s) {
-        const char *v = (const char *) glGetString(s);
-        LOGI("GL %s = %s\n", name, v);
+JNIEXPORT jboolean JNICALL Java_com_osvr_android_gles2sample_MainActivityJNILib_dumpTrace(JNIEnv * env, jobject obj, jstring path)
+{
+    const char *pathChars = env->GetStringUTFChars(path, nullptr);
+    if (!pathChars) {
+        return JNI_FALSE;
     }
+    bool ret = OSVROpenGL::dumpTrace(pathChars);
+    env->ReleaseStringUTFChars(path, pathChars);
+    return ret ? JNI_TRUE : JNI_FALSE;
+}
 
-    static void checkGlError(const char *op) {
-        std::stringstream ss;
-        for (GLint error = glGetError(); error; error = glGetError()) {
-            // gluErrorString without glu
-            std::string errorString;
-            switch(error) {
-                case GL_NO_ERROR:
-                    errorString = "GL_NO_ERROR";
-                    break;
-                case GL_INVALID_ENUM:
-                    errorString = "GL_INVALID_ENUM";
-                    break;
-                case GL_INVALID_VALUE:
-                    errorString = "GL_INVALID_VALUE";
-                    break;
-                case GL_INVALID_OPERATION:
-                    errorString = "GL_INVALID_OPERATION";
-                    break;
-                case GL_INVALID_FRAMEBUFFER_OPERATION:
-                    errorString = "GL_INVALID_FRAMEBUFFER_OPERATION";
-                    break;
-                case GL_OUT_OF_MEMORY:
-                    errorString = "GL_OUT_OF_MEMORY";
-                    break;
-                default:
-                    errorString = "(unknown error)";
-                    break;
-            }
-            LOGI("after %s() glError (%s)\n", op, errorString.c_str());
-        }
+JNIEXPORT jboolean JNICALL Java_com_osvr_android_gles2sample_MainActivityJNILib_startRecording(JNIEnv * env, jobject obj, jstring path, jboolean compressImages)
+{
+    const char *pathChars = env->GetStringUTFChars(path, nullptr);
+    if (!pathChars) {
+        return JNI_FALSE;
     }
+    bool ret = OSVROpenGL::startRecording(pathChars, compressImages == JNI_TRUE);
+    env->ReleaseStringUTFChars(path, pathChars);
+    return ret ? JNI_TRUE : JNI_FALSE;
+}
 
+JNIEXPORT void JNICALL Java_com_osvr_android_gles2sample_MainActivityJNILib_stopRecording(JNIEnv * env, jobject obj)
+{
+    OSVROpenGL::stopRecording();
+}
 
-    class PassThroughOpenGLContextImpl {
-        OSVR_OpenGLToolkitFunctions toolkit;
-        int mWidth;
-        int mHeight;
-
-        static void createImpl(void* data) {
-        }
-        static void destroyImpl(void* data) {
-            delete ((PassThroughOpenGLContextImpl*)data);
-        }
-        static OSVR_CBool addOpenGLContextImpl(void* data, const OSVR_OpenGLContextParams* p) {
-            return ((PassThroughOpenGLContextImpl*)data)->addOpenGLContext(p);
-        }
-        static OSVR_CBool removeOpenGLContextsImpl(void* data) {
-            return ((PassThroughOpenGLContextImpl*)data)->removeOpenGLContexts();
-        }
-        static OSVR_CBool makeCurrentImpl(void* data, size_t display) {
-            return ((PassThroughOpenGLContextImpl*)data)->makeCurrent(display);
-        }
-        static OSVR_CBool swapBuffersImpl(void* data, size_t display) {
-            return ((PassThroughOpenGLContextImpl*)data)->swapBuffers(display);
-        }
-        static OSVR_CBool setVerticalSyncImpl(void* data, OSVR_CBool verticalSync) {
-            return ((PassThroughOpenGLContextImpl*)data)->setVerticalSync(verticalSync);
-        }
-        static OSVR_CBool handleEventsImpl(void* data) {
-            return ((PassThroughOpenGLContextImpl*)data)->handleEvents();
-        }
-        static OSVR_CBool getDisplayFrameBufferImpl(void* data, size_t display, GLuint* displayFrameBufferOut) {
-            return ((PassThroughOpenGLContextImpl*)data)->getDisplayFrameBuffer(display, displayFrameBufferOut);
-        }
-        static OSVR_CBool getDisplaySizeOverrideImpl(void* data, size_t display, int* width, int* height) {
-            return ((PassThroughOpenGLContextImpl*)data)->getDisplaySizeOverride(display, width, height);
-        }
-
-
-    public:
-        PassThroughOpenGLContextImpl() {
-            memset(&toolkit, 0, sizeof(toolkit));
-            toolkit.size = sizeof(toolkit);
-            toolkit.data = this;
-
-            toolkit.create = createImpl;
-            toolkit.destroy = destroyImpl;
-            toolkit.addOpenGLContext = addOpenGLContextImpl;
-            toolkit.removeOpenGLContexts = removeOpenGLContextsImpl;
-            toolkit.makeCurrent = makeCurrentImpl;
-            toolkit.swapBuffers = swapBuffersImpl;
-            toolkit.setVerticalSync = setVerticalSyncImpl;
-            toolkit.handleEvents = handleEventsImpl;
-            toolkit.getDisplaySizeOverride = getDisplaySizeOverrideImpl;
-            toolkit.getDisplayFrameBuffer = getDisplayFrameBufferImpl;
-        }
-
-        ~PassThroughOpenGLContextImpl() {
-        }
-
-        const OSVR_OpenGLToolkitFunctions* getToolkit() const { return &toolkit; }
-
-        bool addOpenGLContext(const OSVR_OpenGLContextParams* p) {
-            return true;
-        }
-
-        bool removeOpenGLContexts() {
-            return true;
-        }
-
-        bool makeCurrent(size_t display) {
-            return true;
-        }
-
-        bool swapBuffers(size_t display) {
-            return true;
-        }
-
-        bool setVerticalSync(bool verticalSync) {
-            return true;
-        }
-
-        bool handleEvents() {
-            return true;
-        }
-        bool getDisplayFrameBuffer(size_t display, GLuint* displayFrameBufferOut) {
-            *displayFrameBufferOut = gFrameBuffer;
-            return true;
-        }
-
-        bool getDisplaySizeOverride(size_t display, int* width, int* height) {
-            *width = gWidth;
-            *height = gHeight;
-            return false;
-        }
-    };
-
-    static GLuint loadShader(GLenum shaderType, const char *pSource) {
-        GLuint shader = glCreateShader(shaderType);
-        if (shader) {
-            glShaderSource(shader, 1, &pSource, NULL);
-            glCompileShader(shader);
-            GLint compiled = 0;
-            glGetShaderiv(shader, GL_COMPILE_STATUS, &compiled);
-            if (!compiled) {
-                GLint infoLen = 0;
-                glGetShaderiv(shader, GL_INFO_LOG_LENGTH, &infoLen);
-                if (infoLen) {
-                    char *buf = (char *) malloc(infoLen);
-                    if (buf) {
-                        glGetShaderInfoLog(shader, infoLen, NULL, buf);
-                        LOGE("Could not compile shader %d:\n%s\n",
-                             shaderType, buf);
-                        free(buf);
-                    }
-                    glDeleteShader(shader);
-                    shader = 0;
-                }
-            }
-        }
-        return shader;
+JNIEXPORT jboolean JNICALL Java_com_osvr_android_gles2sample_MainActivityJNILib_startReplay(JNIEnv * env, jobject obj, jstring path, jfloat speed, jboolean loop)
+{
+    const char *pathChars = env->GetStringUTFChars(path, nullptr);
+    if (!pathChars) {
+        return JNI_FALSE;
     }
+    bool ret = OSVROpenGL::startReplay(pathChars, speed, loop == JNI_TRUE);
+    env->ReleaseStringUTFChars(path, pathChars);
+    return ret ? JNI_TRUE : JNI_FALSE;
+}
 
-    static GLuint createProgram(const char *pVertexSource, const char *pFragmentSource) {
-        GLuint vertexShader = loadShader(GL_VERTEX_SHADER, pVertexSource);
-        if (!vertexShader) {
-            return 0;
-        }
-
-        GLuint pixelShader = loadShader(GL_FRAGMENT_SHADER, pFragmentSource);
-        if (!pixelShader) {
-            return 0;
-        }
-
-        GLuint program = glCreateProgram();
-        if (program) {
-            glAttachShader(program, vertexShader);
-            checkGlError("glAttachShader");
-
-            glAttachShader(program, pixelShader);
-            checkGlError("glAttachShader");
+JNIEXPORT void JNICALL Java_com_osvr_android_gles2sample_MainActivityJNILib_stopReplay(JNIEnv * env, jobject obj)
+{
+    OSVROpenGL::stopReplay();
+}
 
-            glBindAttribLocation(program, 0, "vPosition");
-            glBindAttribLocation(program, 1, "vColor");
-            glBindAttribLocation(program, 2, "vTexCoordinate");
+JNIEXPORT void JNICALL Java_com_osvr_android_gles2sample_MainActivityJNILib_setLatencyMeasurement(JNIEnv * env, jobject obj, jboolean enabled, jboolean testPattern)
+{
+    OSVROpenGL::setLatencyMeasurementEnabled(enabled == JNI_TRUE);
+    OSVROpenGL::setLatencyTestPatternEnabled(enabled == JNI_TRUE && testPattern == JNI_TRUE);
+}
 
-            glLinkProgram(program);
-            GLint linkStatus = GL_FALSE;
-            glGetProgramiv(program, GL_LINK_STATUS, &linkStatus);
-            if (linkStatus != GL_TRUE) {
-                GLint bufLength = 0;
-                glGetProgramiv(program, GL_INFO_LOG_LENGTH, &bufLength);
-                if (bufLength) {
-                    char *buf = (char *) malloc(bufLength);
-                    if (buf) {
-                        glGetProgramInfoLog(program, bufLength, NULL, buf);
-                        LOGE("Could not link program:\n%s\n", buf);
-                        free(buf);
-                    }
-                }
-                glDeleteProgram(program);
-                program = 0;
-            }
-        }
-        return program;
+JNIEXPORT void JNICALL Java_com_osvr_android_gles2sample_MainActivityJNILib_setFramePacing(JNIEnv * env, jobject obj, jint maxFramesInFlight, jboolean justInTime, jfloat refreshRateHz)
+{
+    if (refreshRateHz > 0.0f) {
+        OSVROpenGL::setFramePacerDisplayPeriod(static_cast<uint64_t>(1.0e9 / refreshRateHz));
     }
+    OSVROpenGL::setFramePacing(maxFramesInFlight, justInTime == JNI_TRUE);
+}
 
-    static GLuint createTexture(GLuint width, GLuint height) {
-        GLuint ret;
-        glGenTextures(1, &ret);
-        checkGlError("glGenTextures");
-
-        glBindTexture(GL_TEXTURE_2D, ret);
-        checkGlError("glBindTexture");
-
-        glPixelStorei(GL_PACK_ALIGNMENT, 1);
-        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
-
-//    // DEBUG CODE - should be passing null here, but then texture is always black.
-        GLubyte *dummyBuffer = new GLubyte[width * height * 4];
-        for (GLuint i = 0; i < width * height * 4; i++) {
-            dummyBuffer[i] = (i % 4 ? 100 : 255);
-        }
-
-        // This dummy texture successfully makes it into the texture and renders, but subsequent
-        // calls to glTexSubImage2D don't appear to do anything.
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE,
-                     dummyBuffer);
-        checkGlError("glTexImage2D");
-        delete[] dummyBuffer;
-
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-        checkGlError("glTexParameteri");
-
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-        checkGlError("glTexParameteri");
-        return ret;
+JNIEXPORT jintArray JNICALL Java_com_osvr_android_gles2sample_MainActivityJNILib_getFramePacing(JNIEnv * env, jobject obj)
+{
+    // depth, frames in flight, last stall (us), last idle (us), predicted work (us)
+    OSVROpenGL::FramePacerStats stats;
+    OSVROpenGL::getFramePacerStats(&stats);
+    jint values[5] = {
+            stats.maxFramesInFlight,
+            stats.framesInFlight,
+            static_cast<jint>(stats.lastStallNs / 1000),
+            static_cast<jint>(stats.lastIdleNs / 1000),
+            static_cast<jint>(stats.predictedWorkNs / 1000)
+    };
+    jintArray ret = env->NewIntArray(5);
+    if (ret) {
+        env->SetIntArrayRegion(ret, 0, 5, values);
     }
+    return ret;
+}
 
-    static void updateTexture(GLuint width, GLuint height, GLubyte *data) {
-
-        glBindTexture(GL_TEXTURE_2D, gTextureID);
-        checkGlError("glBindTexture");
+JNIEXPORT void JNICALL Java_com_osvr_android_gles2sample_MainActivityJNILib_setSceneConfig(JNIEnv * env, jobject obj, jint objectCount, jint workerThreads)
+{
+    OSVROpenGL::setSceneObjectCount(objectCount > 0 ? static_cast<uint32_t>(objectCount) : 1);
+    OSVROpenGL::setSceneWorkerThreads(workerThreads);
+}
 
-        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
-        glPixelStorei(GL_PACK_ALIGNMENT, 1);
+JNIEXPORT void JNICALL Java_com_osvr_android_gles2sample_MainActivityJNILib_setAsyncReprojection(JNIEnv * env, jobject obj, jboolean enabled)
+{
+    OSVROpenGL::setAsyncReprojectionEnabled(enabled == JNI_TRUE);
+}
 
-        // @todo use glTexSubImage2D to be faster here, but add check to make sure height/width are the same.
-        //glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, data);
-        //checkGlError("glTexSubImage2D");
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, data);
-        checkGlError("glTexImage2D");
+JNIEXPORT jlongArray JNICALL Java_com_osvr_android_gles2sample_MainActivityJNILib_getReprojectionStats(JNIEnv * env, jobject obj)
+{
+    // app frames, fresh display frames, reprojected display frames
+    OSVROpenGL::ReprojectionStats stats;
+    OSVROpenGL::getReprojectionStats(&stats);
+    jlong values[3] = {
+            static_cast<jlong>(stats.appFrames),
+            static_cast<jlong>(stats.freshFrames),
+            static_cast<jlong>(stats.reprojectedFrames)
+    };
+    jlongArray ret = env->NewLongArray(3);
+    if (ret) {
+        env->SetLongArrayRegion(ret, 0, 3, values);
     }
+    return ret;
+}
 
-    static void imagingCallback(void *userdata, const OSVR_TimeValue *timestamp,
-                                const OSVR_ImagingReport *report) {
-
-        OSVR_ClientContext *ctx = (OSVR_ClientContext *) userdata;
-
-        gReportNumber++;
-        GLuint width = report->state.metadata.width;
-        GLuint height = report->state.metadata.height;
-        gLastFrameWidth = width;
-        gLastFrameHeight = height;
-        GLuint size = width * height * 4;
+JNIEXPORT void JNICALL Java_com_osvr_android_gles2sample_MainActivityJNILib_setSimulatedFrameDelay(JNIEnv * env, jobject obj, jint delayMs, jint everyNFrames)
+{
+    OSVROpenGL::setSimulatedFrameDelay(delayMs > 0 ? static_cast<uint32_t>(delayMs) : 0,
+                                       everyNFrames > 0 ? static_cast<uint32_t>(everyNFrames) : 1);
+}
 
-        gLastFrame = report->state.data;
+JNIEXPORT void JNICALL Java_com_osvr_android_gles2sample_MainActivityJNILib_setDistortionMesh(JNIEnv * env, jobject obj, jstring configPath, jstring cacheDir, jint gridWidth, jint gridHeight)
+{
+    const char *configPathChars = env->GetStringUTFChars(configPath, nullptr);
+    const char *cacheDirChars = env->GetStringUTFChars(cacheDir, nullptr);
+    if (configPathChars && cacheDirChars) {
+        OSVROpenGL::setDistortionMeshConfig(configPathChars, cacheDirChars,
+                                            gridWidth > 0 ? static_cast<uint32_t>(gridWidth) : 1,
+                                            gridHeight > 0 ? static_cast<uint32_t>(gridHeight) : 1);
     }
-
-    static void buttonCallback(void *userdata, const OSVR_TimeValue *timestamp, const OSVR_ButtonReport *report) {
-        LOGI("[main.cpp] Got button report");
+    if (configPathChars) {
+        env->ReleaseStringUTFChars(configPath, configPathChars);
     }
-
-    static void location2DCallback(void *userdata, const OSVR_TimeValue *timestamp, const OSVR_Location2DReport *report) {
-        LOGI("[main.cpp] Got analog report: x: %f", report->location.data[0]);
-        LOGI(" - y: %f", report->location.data[1]);
+    if (cacheDirChars) {
+        env->ReleaseStringUTFChars(cacheDir, cacheDirChars);
     }
+}
 
-    static bool setupRenderTextures(OSVR_RenderManager renderManager) {
-        try {
-            OSVR_ReturnCode rc;
-            rc = osvrRenderManagerGetDefaultRenderParams(&gRenderParams);
-            checkReturnCode(rc, "osvrRenderManagerGetDefaultRenderParams call failed.");
-
-            gRenderParams.farClipDistanceMeters = 1000000.0f;
-            gRenderParams.nearClipDistanceMeters = 0.0000001f;
-            RenderInfoCollectionOpenGL renderInfo(renderManager, gRenderParams);
-
-            OSVR_RenderManagerRegisterBufferState state;
-            rc = osvrRenderManagerStartRegisterRenderBuffers(&state);
-            checkReturnCode(rc, "osvrRenderManagerStartRegisterRenderBuffers call failed.");
-
-            for (OSVR_RenderInfoCount i = 0; i < renderInfo.getNumRenderInfo(); i++) {
-                OSVR_RenderInfoOpenGL currentRenderInfo = renderInfo.getRenderInfo(i);
-
-                // Determine the appropriate size for the frame buffer to be used for
-                // all eyes when placed horizontally size by side.
-                int width = static_cast<int>(currentRenderInfo.viewport.width);
-                int height = static_cast<int>(currentRenderInfo.viewport.height);
-
-                GLuint frameBufferName = 0;
-                glGenFramebuffers(1, &frameBufferName);
-                glBindFramebuffer(GL_FRAMEBUFFER, frameBufferName);
-
-                GLuint renderBufferName = 0;
-                glGenRenderbuffers(1, &renderBufferName);
-
-                GLuint colorBufferName = 0;
-                rc = osvrRenderManagerCreateColorBufferOpenGL(width, height, GL_RGBA,
-                                                              &colorBufferName);
-                checkReturnCode(rc, "osvrRenderManagerCreateColorBufferOpenGL call failed.");
-
-                // bind it to our framebuffer
-                glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D,
-                                       colorBufferName, 0);
-
-                // The depth buffer
-                GLuint depthBuffer;
-                rc = osvrRenderManagerCreateDepthBufferOpenGL(width, height, &depthBuffer);
-                checkReturnCode(rc, "osvrRenderManagerCreateDepthBufferOpenGL call failed.");
-
-                glGenRenderbuffers(1, &depthBuffer);
-                glBindRenderbuffer(GL_RENDERBUFFER, depthBuffer);
-                glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT16, width, height);
-
-                glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER,
-                                          depthBuffer);
-
-                glBindRenderbuffer(GL_RENDERBUFFER, renderBufferName);
-                glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT16, width, height);
-                glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, colorBufferName, 0);
-                glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, renderBufferName);
-
-
-                // unbind the framebuffer
-                glBindTexture(GL_TEXTURE_2D, 0);
-                glBindRenderbuffer(GL_RENDERBUFFER, 0);
-                glBindFramebuffer(GL_FRAMEBUFFER, gFrameBuffer);
-
-                OSVR_RenderBufferOpenGL buffer = {0};
-                buffer.colorBufferName = colorBufferName;
-                buffer.depthStencilBufferName = depthBuffer;
-                rc = osvrRenderManagerRegisterRenderBufferOpenGL(state, buffer);
-                checkReturnCode(rc, "osvrRenderManagerRegisterRenderBufferOpenGL call failed.");
-
-                OSVR_RenderTargetInfo renderTarget = {0};
-                renderTarget.frameBufferName = frameBufferName;
-                renderTarget.renderBufferName = renderBufferName;
-                renderTarget.colorBufferName = colorBufferName;
-                renderTarget.depthBufferName = depthBuffer;
-                gRenderTargets.push_back(renderTarget);
-            }
-
-            rc = osvrRenderManagerFinishRegisterRenderBuffers(renderManager, state, true);
-            checkReturnCode(rc, "osvrRenderManagerFinishRegisterRenderBuffers call failed.");
-        } catch(...) {
-            LOGE("Error durring render target creation.");
-            return false;
-        }
-        return true;
+JNIEXPORT void JNICALL Java_com_osvr_android_gles2sample_MainActivityJNILib_setSceneTexture(JNIEnv * env, jobject obj, jstring path)
+{
+    const char *pathChars = path ? env->GetStringUTFChars(path, nullptr) : nullptr;
+    OSVROpenGL::setSceneTexturePath(pathChars);
+    if (pathChars) {
+        env->ReleaseStringUTFChars(path, pathChars);
     }
+}
 
-    static bool setupOSVR() {
-        if(gOSVRInitialized) {
-            return true;
-        }
-        OSVR_ReturnCode rc = 0;
-        try {
-            // On Android, the current working directory is added to the default plugin search path.
-            // it also helps the server find its configuration and display files.
-//            boost::filesystem::current_path("/data/data/com.osvr.android.gles2sample/files");
-//            auto workingDirectory = boost::filesystem::current_path();
-//            LOGI("[OSVR] Current working directory: %s", workingDirectory.string().c_str());
-
-            // auto-start the server
-            osvrClientAttemptServerAutoStart();
-
-            if (!gClientContext) {
-                LOGI("[OSVR] Creating ClientContext...");
-                gClientContext = osvrClientInit("com.osvr.android.examples.OSVROpenGL", 0);
-                if (!gClientContext) {
-                    LOGI("[OSVR] could not create client context");
-                    return false;
-                }
-
-                // temporary workaround to DisplayConfig issue,
-                // display sometimes fails waiting for the tree from the server.
-                LOGI("[OSVR] Calling update a few times...");
-                for (int i = 0; i < 10000; i++) {
-                    rc = osvrClientUpdate(gClientContext);
-                    if (rc != OSVR_RETURN_SUCCESS) {
-                        LOGI("[OSVR] Error while updating client context.");
-                        return false;
-                    }
-                }
-
-
-                rc = osvrClientCheckStatus(gClientContext);
-                if (rc != OSVR_RETURN_SUCCESS) {
-                    LOGE("[OSVR] Client context reported bad status.");
-                    return false;
-                } else {
-                    LOGI("[OSVR] Client context reported good status.");
-                }
-
-
-                if (OSVR_RETURN_SUCCESS !=
-                    osvrClientGetInterface(gClientContext, "/camera", &gCamera)) {
-                    LOGE("Error, could not get the camera interface at /camera.");
-                    return false;
-                }
-
-                // Register the imaging callback.
-                if (OSVR_RETURN_SUCCESS !=
-                    osvrRegisterImagingCallback(gCamera, &imagingCallback, &gClientContext)) {
-                    LOGE("Error, could not register image callback.");
-                    return false;
-                }
-
-                // Center button
-                if (OSVR_RETURN_SUCCESS !=
-                    osvrClientGetInterface(gClientContext, "/controller/left/0", &gCenterButton)) {
-                    LOGE("Error, could not get the button interface at /controller/left/0.");
-                    return false;
-                }
-
-                if (OSVR_RETURN_SUCCESS !=
-                    osvrRegisterButtonCallback(gCenterButton, &buttonCallback, &gClientContext)) {
-                    LOGE("Error, could not register button callback.");
-                    return false;
-                }
-
-                // Down button
-                if (OSVR_RETURN_SUCCESS !=
-                    osvrClientGetInterface(gClientContext, "/controller/left/1", &gDownButton)) {
-                    LOGE("Error, could not get the button interface at /controller/left/1.");
-                    return false;
-                }
-
-                if (OSVR_RETURN_SUCCESS !=
-                    osvrRegisterButtonCallback(gDownButton, &buttonCallback, &gClientContext)) {
-                    LOGE("Error, could not register button callback.");
-                    return false;
-                }
-
-                // Right button
-                if (OSVR_RETURN_SUCCESS !=
-                    osvrClientGetInterface(gClientContext, "/controller/left/2", &gRightButton)) {
-                    LOGE("Error, could not get the button interface at /controller/left/2.");
-                    return false;
-                }
-
-                if (OSVR_RETURN_SUCCESS !=
-                    osvrRegisterButtonCallback(gRightButton, &buttonCallback, &gClientContext)) {
-                    LOGE("Error, could not register button callback.");
-                    return false;
-                }
-
-                // Left button
-                if (OSVR_RETURN_SUCCESS !=
-                    osvrClientGetInterface(gClientContext, "/controller/left/3", &gLeftButton)) {
-                    LOGE("Error, could not get the button interface at /controller/left/3.");
-                    return false;
-                }
-
-                if (OSVR_RETURN_SUCCESS !=
-                    osvrRegisterButtonCallback(gLeftButton, &buttonCallback, &gClientContext)) {
-                    LOGE("Error, could not register button callback.");
-                    return false;
-                }
-
-                // Up button
-                if (OSVR_RETURN_SUCCESS !=
-                    osvrClientGetInterface(gClientContext, "/controller/left/4", &gUpButton)) {
-                    LOGE("Error, could not get the button interface at /controller/left/4.");
-                    return false;
-                }
-
-                if (OSVR_RETURN_SUCCESS !=
-                    osvrRegisterButtonCallback(gUpButton, &buttonCallback, &gClientContext)) {
-                    LOGE("Error, could not register button callback.");
-                    return false;
-                }
-
-                // Volume up button
-                if (OSVR_RETURN_SUCCESS !=
-                    osvrClientGetInterface(gClientContext, "/controller/left/volumeUp", &gVolumeUpButton)) {
-                    LOGE("Error, could not get the button interface at /controller/left/volumeUp.");
-                    return false;
-                }
-
-                if (OSVR_RETURN_SUCCESS !=
-                    osvrRegisterButtonCallback(gVolumeUpButton, &buttonCallback, &gClientContext)) {
-                    LOGE("Error, could not register button callback.");
-                    return false;
-                }
-
-                // Volume Down button
-                if (OSVR_RETURN_SUCCESS !=
-                    osvrClientGetInterface(gClientContext, "/controller/left/volumeDown", &gVolumeDownButton)) {
-                    LOGE("Error, could not get the button interface at /controller/left/volumeDown.");
-                    return false;
-                }
-
-                if (OSVR_RETURN_SUCCESS !=
-                    osvrRegisterButtonCallback(gVolumeDownButton, &buttonCallback, &gClientContext)) {
-                    LOGE("Error, could not register button callback.");
-                    return false;
-                }
-
-                // Back button
-                if (OSVR_RETURN_SUCCESS !=
-                    osvrClientGetInterface(gClientContext, "/controller/left/back", &gBackButton)) {
-                    LOGE("Error, could not get the button interface at /controller/left/back.");
-                    return false;
-                }
-
-                if (OSVR_RETURN_SUCCESS !=
-                    osvrRegisterButtonCallback(gBackButton, &buttonCallback, &gClientContext)) {
-                    LOGE("Error, could not register button callback.");
-                    return false;
-                }
-
-                // Mouse
-                if (OSVR_RETURN_SUCCESS !=
-                    osvrClientGetInterface(gClientContext, "/mouse", &gMouseLocation2D)) {
-                    LOGE("Error, could not get the analog interface at /mouse/x.");
-                    return false;
-                }
-
-                if (OSVR_RETURN_SUCCESS !=
-                    osvrRegisterLocation2DCallback(gMouseLocation2D, &location2DCallback, &gClientContext)) {
-                    LOGE("Error, could not register analog callback.");
-                    return false;
-                }
-            }
-
-            gOSVRInitialized = true;
-            return true;
-        } catch (const std::runtime_error &ex) {
-            LOGE("[OSVR] OSVR initialization failed: %s", ex.what());
-            return false;
-        }
+JNIEXPORT void JNICALL Java_com_osvr_android_gles2sample_MainActivityJNILib_setSceneMesh(JNIEnv * env, jobject obj, jstring path)
+{
+    const char *pathChars = path ? env->GetStringUTFChars(path, nullptr) : nullptr;
+    OSVROpenGL::setSceneMeshPath(pathChars);
+    if (pathChars) {
+        env->ReleaseStringUTFChars(path, pathChars);
     }
+}
 
-    // Idempotent call to setup render manager
-    static bool setupRenderManager() {
-        if(!gOSVRInitialized || !gGraphicsInitializedOnce) {
-            return false;
-        }
-        if(gRenderManagerInitialized) {
-            return true;
-        }
-        try {
-            PassThroughOpenGLContextImpl* glContextImpl = new PassThroughOpenGLContextImpl();
-            gGraphicsLibrary.toolkit = glContextImpl->getToolkit();
-
-            if(OSVR_RETURN_SUCCESS != osvrCreateRenderManagerOpenGL(
-                    gClientContext, "OpenGL", gGraphicsLibrary, &gRenderManager, &gRenderManagerOGL)) {
-                std::cerr << "Could not create the RenderManager" << std::endl;
-                return false;
-            }
-
-            if(!setupRenderTextures(gRenderManager)) {
-                return false;
-            }
-
-            // Open the display and make sure this worked
-            OSVR_OpenResultsOpenGL openResults;
-            if (OSVR_RETURN_SUCCESS != osvrRenderManagerOpenDisplayOpenGL(
-                    gRenderManagerOGL, &openResults) ||
-                (openResults.status == OSVR_OPEN_STATUS_FAILURE)) {
-                std::cerr << "Could not open display" << std::endl;
-                osvrDestroyRenderManager(gRenderManager);
-                gRenderManager = gRenderManagerOGL = nullptr;
-                return false;
-            }
-
-            gRenderManagerInitialized = true;
-            return true;
-        } catch (const std::runtime_error &ex) {
-            LOGI("[OSVR] RenderManager initialization failed: %s", ex.what());
-            return false;
-        }
+JNIEXPORT void JNICALL Java_com_osvr_android_gles2sample_MainActivityJNILib_setAssetManager(JNIEnv * env, jobject obj, jobject assetManager)
+{
+    // the native AAssetManager is only valid while its Java object is alive
+    static jobject sAssetManager = nullptr;
+    if (sAssetManager) {
+        env->DeleteGlobalRef(sAssetManager);
     }
-    static const GLfloat gTriangleColors[] = {
-            // white
-            1.0f, 1.0f, 1.0f, 1.0f,
-            1.0f, 1.0f, 1.0f, 1.0f,
-            1.0f, 1.0f, 1.0f, 1.0f,
-            1.0f, 1.0f, 1.0f, 1.0f,
-            1.0f, 1.0f, 1.0f, 1.0f,
-            1.0f, 1.0f, 1.0f, 1.0f,
-
-            // green
-            0.0f, 0.75f, 0.0f, 1.0f,
-            0.0f, 0.75f, 0.0f, 1.0f,
-            0.0f, 1.0f, 0.0f, 1.0f,
-            0.0f, 0.75f, 0.0f, 1.0f,
-            0.0f, 1.0f, 0.0f, 1.0f,
-            0.0f, 1.0f, 0.0f, 1.0f,
-
-            // blue
-            0.0f, 0.0f, 0.75f, 1.0f,
-            0.0f, 0.0f, 0.75f, 1.0f,
-            0.0f, 0.0f, 1.0f, 1.0f,
-            0.0f, 0.0f, 0.75f, 1.0f,
-            0.0f, 0.0f, 1.0f, 1.0f,
-            0.0f, 0.0f, 1.0f, 1.0f,
-
-            // green/purple
-            0.0f, 0.75f, 0.75f, 1.0f,
-            0.0f, 0.75f, 0.75f, 1.0f,
-            0.0f, 1.0f, 1.0f, 1.0f,
-            0.0f, 0.75f, 0.75f, 1.0f,
-            0.0f, 1.0f, 1.0f, 1.0f,
-            0.0f, 1.0f, 1.0f, 1.0f,
-
-            // red/green
-            0.75f, 0.75f, 0.0f, 1.0f,
-            0.75f, 0.75f, 0.0f, 1.0f,
-            1.0f, 1.0f, 0.0f, 1.0f,
-            0.75f, 0.75f, 0.0f, 1.0f,
-            1.0f, 1.0f, 0.0f, 1.0f,
-            1.0f, 1.0f, 0.0f, 1.0f,
-
-            // red/blue
-            0.75f, 0.0f, 0.75f, 1.0f,
-            0.75f, 0.0f, 0.75f, 1.0f,
-            1.0f, 0.0f, 1.0f, 1.0f,
-            0.75f, 0.0f, 0.75f, 1.0f,
-            1.0f, 0.0f, 1.0f, 1.0f,
-            1.0f, 0.0f, 1.0f, 1.0f
-    };
-
-    static const GLfloat gTriangleTexCoordinates[] = {
-            // A cube face (letters are unique vertices)
-            // A--B
-            // |  |
-            // D--C
-
-            // As two triangles (clockwise)
-            // A B D
-            // B C D
-
-            // white
-            1.0f, 0.0f, // A
-            1.0f, 1.0f, // B
-            0.0f, 0.0f, // D
-            1.0f, 1.0f, // B
-            0.0f, 1.0f, // C
-            0.0f, 0.0f, // D
-
-            // green
-            1.0f, 0.0f, // A
-            1.0f, 1.0f, // B
-            0.0f, 0.0f, // D
-            1.0f, 1.0f, // B
-            0.0f, 1.0f, // C
-            0.0f, 0.0f, // D
-
-            // blue
-            1.0f, 1.0f, // A
-            0.0f, 1.0f, // B
-            1.0f, 0.0f, // D
-            0.0f, 1.0f, // B
-            0.0f, 0.0f, // C
-            1.0f, 0.0f, // D
-
-            // blue-green
-            1.0f, 0.0f, // A
-            1.0f, 1.0f, // B
-            0.0f, 0.0f, // D
-            1.0f, 1.0f, // B
-            0.0f, 1.0f, // C
-            0.0f, 0.0f, // D
-
-            // yellow
-            0.0f, 0.0f, // A
-            1.0f, 0.0f, // B
-            0.0f, 1.0f, // D
-            1.0f, 0.0f, // B
-            1.0f, 1.0f, // C
-            0.0f, 1.0f, // D
-
-            // purple/magenta
-            1.0f, 1.0f, // A
-            0.0f, 1.0f, // B
-            1.0f, 0.0f, // D
-            0.0f, 1.0f, // B
-            0.0f, 0.0f, // C
-            1.0f, 0.0f, // D
-    };
-
-    static const GLfloat gTriangleVertices[] = {
-            // A cube face (letters are unique vertices)
-            // A--B
-            // |  |
-            // D--C
-
-            // As two triangles (clockwise)
-            // A B D
-            // B C D
-
-            //glNormal3f(0.0, 0.0, -1.0);
-            1.0f, 1.0f, -1.0f, // A
-            1.0f, -1.0f, -1.0f, // B
-            -1.0f, 1.0f, -1.0f, // D
-            1.0f, -1.0f, -1.0f, // B
-            -1.0f, -1.0f, -1.0f, // C
-            -1.0f, 1.0f, -1.0f, // D
-
-            //glNormal3f(0.0, 0.0, 1.0);
-            -1.0f, 1.0f, 1.0f, // A
-            -1.0f, -1.0f, 1.0f, // B
-            1.0f, 1.0f, 1.0f, // D
-            -1.0f, -1.0f, 1.0f, // B
-            1.0f, -1.0f, 1.0f, // C
-            1.0f, 1.0f, 1.0f, // D
-
-//        glNormal3f(0.0, -1.0, 0.0);
-            1.0f, -1.0f, 1.0f, // A
-            -1.0f, -1.0f, 1.0f, // B
-            1.0f, -1.0f, -1.0f, // D
-            -1.0f, -1.0f, 1.0f, // B
-            -1.0f, -1.0f, -1.0f, // C
-            1.0f, -1.0f, -1.0f, // D
+    sAssetManager = assetManager ? env->NewGlobalRef(assetManager) : nullptr;
+    OSVROpenGL::setAssetManager(sAssetManager ? AAssetManager_fromJava(env, sAssetManager) : nullptr);
+}
 
-//        glNormal3f(0.0, 1.0, 0.0);
-            1.0f, 1.0f, 1.0f, // A
-            1.0f, 1.0f, -1.0f, // B
-            -1.0f, 1.0f, 1.0f, // D
-            1.0f, 1.0f, -1.0f, // B
-            -1.0f, 1.0f, -1.0f, // C
-            -1.0f, 1.0f, 1.0f, // D
+JNIEXPORT void JNICALL Java_com_osvr_android_gles2sample_MainActivityJNILib_setThermalGovernor(JNIEnv * env, jobject obj, jboolean enabled, jstring tracePath)
+{
+    const char *tracePathChars = tracePath ? env->GetStringUTFChars(tracePath, nullptr) : nullptr;
+    OSVROpenGL::setThermalTraceFile(tracePathChars);
+    if (tracePathChars) {
+        env->ReleaseStringUTFChars(tracePath, tracePathChars);
+    }
+    OSVROpenGL::setThermalGovernorEnabled(enabled == JNI_TRUE);
+}
 
-//        glNormal3f(-1.0, 0.0, 0.0);
-            -1.0f, 1.0f, 1.0f, // A
-            -1.0f, 1.0f, -1.0f, // B
-            -1.0f, -1.0f, 1.0f, // D
-            -1.0f, 1.0f, -1.0f, // B
-            -1.0f, -1.0f, -1.0f, // C
-            -1.0f, -1.0f, 1.0f, // D
+JNIEXPORT void JNICALL Java_com_osvr_android_gles2sample_MainActivityJNILib_reportThermalStatus(JNIEnv * env, jobject obj, jint status)
+{
+    OSVROpenGL::reportThermalStatus(status);
+}
 
-//        glNormal3f(1.0, 0.0, 0.0);
-            1.0f, -1.0f, 1.0f, // A
-            1.0f, -1.0f, -1.0f, // B
-            1.0f, 1.0f, 1.0f, // D
-            1.0f, -1.0f, -1.0f, // B
-            1.0f, 1.0f, -1.0f, // C
-            1.0f, 1.0f, 1.0f // D
+JNIEXPORT jfloatArray JNICALL Java_com_osvr_android_gles2sample_MainActivityJNILib_getThermalGovernorStats(JNIEnv * env, jobject obj)
+{
+    // tier, steps down, steps up, last reason, temperature (C), status,
+    // frame cost (ms), temperature trend (C/min)
+    OSVROpenGL::ThermalGovernorStats stats;
+    OSVROpenGL::getThermalGovernorStats(&stats);
+    jfloat values[8] = {
+            static_cast<jfloat>(stats.tier),
+            static_cast<jfloat>(stats.stepsDown),
+            static_cast<jfloat>(stats.stepsUp),
+            static_cast<jfloat>(stats.lastReason),
+            stats.temperatureC,
+            static_cast<jfloat>(stats.status),
+            stats.frameCostMs,
+            stats.slopeCPerMinute
     };
-
-    static bool setupGraphics(int width, int height) {
-        printGLString("Version", GL_VERSION);
-        printGLString("Vendor", GL_VENDOR);
-        printGLString("Renderer", GL_RENDERER);
-        printGLString("Extensions", GL_EXTENSIONS);
-
-        //initializeGLES2Ext();
-        GLint frameBuffer;
-        glGetIntegerv(GL_FRAMEBUFFER_BINDING, &frameBuffer);
-        gFrameBuffer = (GLuint)frameBuffer;
-        LOGI("Window GL_FRAMEBUFFER_BINDING: %d", gFrameBuffer);
-
-        LOGI("setupGraphics(%d, %d)", width, height);
-        gWidth = width;
-        gHeight = height;
-
-        //bool osvrSetupSuccess = setupOSVR();
-
-        gProgram = createProgram(gVertexShader, gFragmentShader);
-        if (!gProgram) {
-            LOGE("Could not create program.");
-            return false;
-        }
-        gvPositionHandle = glGetAttribLocation(gProgram, "vPosition");
-        checkGlError("glGetAttribLocation");
-        LOGI("glGetAttribLocation(\"vPosition\") = %d\n", gvPositionHandle);
-
-        gvColorHandle = glGetAttribLocation(gProgram, "vColor");
-        checkGlError("glGetAttribLocation");
-        LOGI("glGetAttribLocation(\"vColor\") = %d\n", gvColorHandle);
-
-        gvTexCoordinateHandle = glGetAttribLocation(gProgram, "vTexCoordinate");
-        checkGlError("glGetAttribLocation");
-        LOGI("glGetAttribLocation(\"vTexCoordinate\") = %d\n", gvTexCoordinateHandle);
-
-        gvProjectionUniformId = glGetUniformLocation(gProgram, "projection");
-        gvViewUniformId = glGetUniformLocation(gProgram, "view");
-        gvModelUniformId = glGetUniformLocation(gProgram, "model");
-        guTextureUniformId = glGetUniformLocation(gProgram, "uTexture");
-
-        glViewport(0, 0, width, height);
-        checkGlError("glViewport");
-
-        glDisable(GL_CULL_FACE);
-
-        // @todo can we resize the texture after it has been created?
-        // if not, we may have to delete the dummy one and create a new one after
-        // the first imaging report.
-        LOGI("Creating texture... here we go!");
-        gTextureID = createTexture(width, height);
-
-        //return osvrSetupSuccess;
-        gGraphicsInitializedOnce = true;
-        return true;
+    jfloatArray ret = env->NewFloatArray(8);
+    if (ret) {
+        env->SetFloatArrayRegion(ret, 0, 8, values);
     }
+    return ret;
+}
 
-/**
- * Just the current frame in the display.
- */
-    static void renderFrame() {
-        if(!gOSVRInitialized) {
-            // @todo implement some logging/error handling?
-            return;
-        }
-
-        // this call is idempotent, so we can make it every frame.
-        // have to ensure render manager is setup from the rendering thread with
-        // a current GLES context, so this is a lazy setup call
-        if(!setupRenderManager()) {
-            // @todo implement some logging/error handling?
-            return;
-        }
-
-        OSVR_ReturnCode rc;
-        glUseProgram(gProgram);
-        glBindFramebuffer(GL_FRAMEBUFFER, 0);
-
-        glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
-        checkGlError("glClearColor");
-        glViewport(0, 0, gWidth, gHeight);
-        glClear(GL_DEPTH_BUFFER_BIT | GL_COLOR_BUFFER_BIT);
-        checkGlError("glClear");
-
-        GLint maxVertexAttribs;
-        glGetIntegerv(GL_MAX_VERTEX_ATTRIBS, &maxVertexAttribs);
-
-        for(GLuint i = 0; i < maxVertexAttribs; i++) {
-            glDisableVertexAttribArray(static_cast<GLuint>(i));
-        }
-        glBindBuffer(GL_ARRAY_BUFFER, 0);
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
-        //bindVertexArrayOES(0);
-
-        if (gRenderManager && gClientContext) {
-            osvrClientUpdate(gClientContext);
-            if (gLastFrame != nullptr) {
-                updateTexture(gLastFrameWidth, gLastFrameHeight, gLastFrame);
-                osvrClientFreeImage(gClientContext, gLastFrame);
-                gLastFrame = nullptr;
-            }
-
-            OSVR_RenderParams renderParams;
-            rc = osvrRenderManagerGetDefaultRenderParams(&renderParams);
-            checkReturnCode(rc, "osvrRenderManagerGetDefaultRenderParams call failed.");
-
-            RenderInfoCollectionOpenGL renderInfoCollection(gRenderManager, renderParams);
-
-            // Get the present started
-            OSVR_RenderManagerPresentState presentState;
-            rc = osvrRenderManagerStartPresentRenderBuffers(&presentState);
-            checkReturnCode(rc, "osvrRenderManagerStartPresentRenderBuffers call failed.");
-
-            for(OSVR_RenderInfoCount renderInfoCount = 0;
-                renderInfoCount < renderInfoCollection.getNumRenderInfo();
-                renderInfoCount++) {
-
-                // get the current render info
-                OSVR_RenderInfoOpenGL currentRenderInfo = renderInfoCollection.getRenderInfo(renderInfoCount);
-
-                /// get the eye pose for the current render info
-                double viewMatd[OSVR_MATRIX_SIZE];
-                OSVR_PoseState_to_OpenGL(viewMatd, currentRenderInfo.pose);
-
-                // RenderManager's utilities only support doubles, but we need floats in ES2 land
-                GLfloat viewMat[OSVR_MATRIX_SIZE];
-                for(int i = 0; i < OSVR_MATRIX_SIZE; i++) {
-                    viewMat[i] = static_cast<GLfloat>(viewMatd[i]);
-                }
-
-                // Set color and depth buffers for the frame buffer
-                OSVR_RenderTargetInfo renderTargetInfo = gRenderTargets[renderInfoCount];
-                glBindFramebuffer(GL_FRAMEBUFFER, renderTargetInfo.frameBufferName);
-
-                // @todo: convert to OpenGL?
-                glViewport(static_cast<GLint>(currentRenderInfo.viewport.left),
-                           static_cast<GLint>(currentRenderInfo.viewport.lower),
-                           static_cast<GLsizei>(currentRenderInfo.viewport.width),
-                           static_cast<GLsizei>(currentRenderInfo.viewport.height));
-
-//                glViewport(static_cast<GLint>(renderInfoCount == 0 ? 0 : currentRenderInfo.viewport.width),
-//                           static_cast<GLint>(currentRenderInfo.viewport.lower),
-//                           static_cast<GLsizei>(currentRenderInfo.viewport.width),
-//                           static_cast<GLsizei>(currentRenderInfo.viewport.height));
-
-                /// Set the OpenGL projection matrix
-                double projMatd[OSVR_MATRIX_SIZE];
-                OSVR_Projection_to_OpenGL(projMatd, currentRenderInfo.projection);
-
-                // RenderManager's utilities only support doubles, but we need floats in GLES2 land
-                GLfloat projMat[OSVR_MATRIX_SIZE];
-                for(int i = 0; i < OSVR_MATRIX_SIZE; i++) {
-                    projMat[i] = static_cast<GLfloat>(projMatd[i]);
-                }
-
-                const static GLfloat identityMat4f[16] = {
-                        1.0f, 0.0f, 0.0f, 0.0f,
-                        0.0f, 1.0f, 0.0f, 0.0f,
-                        0.0f, 0.0f, 1.0f, 0.0f,
-                        0.0f, 0.0f, 0.0f, 1.0f,
-                };
-
-                /// Call out to render our scene.
-                glUseProgram(gProgram);
-                checkGlError("glUseProgram");
-
-                glUniformMatrix4fv(gvProjectionUniformId, 1, GL_FALSE, projMat);
-                glUniformMatrix4fv(gvViewUniformId, 1, GL_FALSE, viewMat);
-                glUniformMatrix4fv(gvModelUniformId, 1, GL_FALSE, identityMat4f);
-                checkGlError("one of the glUniformMatrix4fv calls?");
-
-                glEnableVertexAttribArray(gvPositionHandle);
-                checkGlError("glEnableVertexAttribArray");
-                glVertexAttribPointer(gvPositionHandle, 3, GL_FLOAT, GL_FALSE, 0, gTriangleVertices);
-                checkGlError("glVertexAttribPointer");
-
-                glEnableVertexAttribArray(gvColorHandle);
-                checkGlError("glEnableVertexAttribArray");
-                glVertexAttribPointer(gvColorHandle, 4, GL_FLOAT, GL_FALSE, 0, gTriangleColors);
-                checkGlError("glVertexAttribPointer");
-
-                glEnableVertexAttribArray(gvTexCoordinateHandle);
-                checkGlError("glEnableVertexAttribArray");
-                glVertexAttribPointer(gvTexCoordinateHandle, 2, GL_FLOAT, GL_FALSE, 0, gTriangleTexCoordinates);
-                checkGlError("glVertexAttribPointer");
-
-                glActiveTexture(GL_TEXTURE0);
-                glBindTexture(GL_TEXTURE_2D, gTextureID);
-                glUniform1i(guTextureUniformId, 0);
-
-                glDrawArrays(GL_TRIANGLES, 0, 36);
-                checkGlError("glDrawArrays");
-
-                // unbind the render target
-                glBindFramebuffer(GL_FRAMEBUFFER, gFrameBuffer);
-
-                // present this render target (deferred until the finish call below)
-                OSVR_ViewportDescription normalizedViewport = {0};
-                normalizedViewport.left = 0.0f;
-                normalizedViewport.lower = 0.0f;
-                normalizedViewport.width = 1.0f;
-                normalizedViewport.height = 1.0f;
-                OSVR_RenderBufferOpenGL buffer = {0};
-                buffer.colorBufferName = renderTargetInfo.colorBufferName;
-                buffer.depthStencilBufferName = renderTargetInfo.depthBufferName;
-                rc = osvrRenderManagerPresentRenderBufferOpenGL(
-                        presentState, buffer, currentRenderInfo, normalizedViewport);
-                checkReturnCode(rc, "osvrRenderManagerPresentRenderBufferOpenGL call failed.");
-            }
+JNIEXPORT void JNICALL Java_com_osvr_android_gles2sample_MainActivityJNILib_setEyeBufferSamples(JNIEnv * env, jobject obj, jint samples)
+{
+    OSVROpenGL::setEyeBufferSamples(samples > 0 ? samples : 1);
+}
 
-            // actually kick off the present
-            rc = osvrRenderManagerFinishPresentRenderBuffers(
-                    gRenderManager, presentState, renderParams, false);
-            checkReturnCode(rc, "osvrRenderManagerFinishPresentRenderBuffers call failed.");
-        }
+JNIEXPORT void JNICALL Java_com_osvr_android_gles2sample_MainActivityJNILib_setFrameCapture(JNIEnv * env, jobject obj, jstring directory, jint everyNFrames, jint frameCount, jboolean window)
+{
+    if (!directory) {
+        OSVROpenGL::setFrameCapture(nullptr);
+        return;
     }
-
-
-    static void stop() {
-        LOGI("[OSVR] Shutting down...");
-
-        if (gRenderManager) {
-            osvrDestroyRenderManager(gRenderManager);
-            gRenderManager = gRenderManagerOGL = nullptr;
-        }
-
-        // is this needed? Maybe not. the display config manages the lifetime.
-        if (gClientContext != nullptr) {
-            osvrClientShutdown(gClientContext);
-            gClientContext = nullptr;
-        }
-
-        osvrClientReleaseAutoStartedServer();
+    const char *directoryChars = env->GetStringUTFChars(directory, nullptr);
+    if (directoryChars) {
+        OSVROpenGL::FrameCaptureConfig config;
+        OSVROpenGL::defaultFrameCaptureConfig(&config);
+        config.directory = directoryChars;
+        config.everyNFrames = everyNFrames > 0 ? static_cast<uint32_t>(everyNFrames) : 1;
+        config.frameCount = frameCount > 0 ? static_cast<uint32_t>(frameCount) : 0;
+        config.window = window == JNI_TRUE;
+        OSVROpenGL::setFrameCapture(&config);
+        env->ReleaseStringUTFChars(directory, directoryChars);
     }
 }
 
-extern "C" {
-    JNIEXPORT void JNICALL Java_com_osvr_android_gles2sample_MainActivityJNILib_initGraphics(JNIEnv * env, jobject obj,  jint width, jint height);
-    JNIEXPORT void JNICALL Java_com_osvr_android_gles2sample_MainActivityJNILib_initOSVR(JNIEnv *env, jobject obj);
-    JNIEXPORT void JNICALL Java_com_osvr_android_gles2sample_MainActivityJNILib_step(JNIEnv * env, jobject obj);
-    JNIEXPORT void JNICALL Java_com_osvr_android_gles2sample_MainActivityJNILib_stop(JNIEnv * env, jobject obj);
-};
-
-JNIEXPORT void JNICALL Java_com_osvr_android_gles2sample_MainActivityJNILib_initGraphics(JNIEnv * env, jobject obj,  jint width, jint height)
+JNIEXPORT jlongArray JNICALL Java_com_osvr_android_gles2sample_MainActivityJNILib_getFrameCaptureStats(JNIEnv * env, jobject obj)
 {
-    OSVROpenGL::setupGraphics(width, height);
+    // frames captured, images written, dropped, failed, render thread time (us)
+    OSVROpenGL::FrameCaptureStats stats;
+    OSVROpenGL::getFrameCaptureStats(&stats);
+    jlong values[5] = {
+            static_cast<jlong>(stats.frames),
+            static_cast<jlong>(stats.written),
+            static_cast<jlong>(stats.dropped),
+            static_cast<jlong>(stats.failed),
+            static_cast<jlong>(stats.renderThreadNs / 1000)
+    };
+    jlongArray ret = env->NewLongArray(5);
+    if (ret) {
+        env->SetLongArrayRegion(ret, 0, 5, values);
+    }
+    return ret;
 }
 
-JNIEXPORT void JNICALL Java_com_osvr_android_gles2sample_MainActivityJNILib_initOSVR(JNIEnv *env, jobject obj)
+JNIEXPORT void JNICALL Java_com_osvr_android_gles2sample_MainActivityJNILib_setGpuMemoryBudget(JNIEnv * env, jobject obj, jint megabytes)
 {
-    OSVROpenGL::setupOSVR();
+    OSVROpenGL::setGpuMemoryBudget(megabytes > 0 ? static_cast<uint64_t>(megabytes) << 20 : 0);
 }
 
-JNIEXPORT void JNICALL Java_com_osvr_android_gles2sample_MainActivityJNILib_step(JNIEnv * env, jobject obj)
+JNIEXPORT jlongArray JNICALL Java_com_osvr_android_gles2sample_MainActivityJNILib_getGpuMemoryStats(JNIEnv * env, jobject obj)
 {
-    OSVROpenGL::renderFrame();
+    // budget, used, textures, render targets, buffers (bytes), evictions, restores, out of memory errors
+    OSVROpenGL::GpuMemoryStats stats;
+    OSVROpenGL::getGpuMemoryStats(&stats);
+    jlong values[8] = {
+            static_cast<jlong>(stats.budgetBytes),
+            static_cast<jlong>(stats.usedBytes),
+            static_cast<jlong>(stats.categoryBytes[OSVROpenGL::GPU_MEMORY_TEXTURES]),
+            static_cast<jlong>(stats.categoryBytes[OSVROpenGL::GPU_MEMORY_RENDER_TARGETS]),
+            static_cast<jlong>(stats.categoryBytes[OSVROpenGL::GPU_MEMORY_BUFFERS]),
+            static_cast<jlong>(stats.evictions),
+            static_cast<jlong>(stats.restores),
+            static_cast<jlong>(stats.outOfMemoryErrors)
+    };
+    jlongArray ret = env->NewLongArray(8);
+    if (ret) {
+        env->SetLongArrayRegion(ret, 0, 8, values);
+    }
+    return ret;
 }
 
-JNIEXPORT void JNICALL Java_com_osvr_android_gles2sample_MainActivityJNILib_stop(JNIEnv * env, jobject obj)
+JNIEXPORT void JNICALL Java_com_osvr_android_gles2sample_MainActivityJNILib_setSceneMaterials(JNIEnv * env, jobject obj, jint count, jint batching, jstring atlasPath)
 {
-    OSVROpenGL::stop();
+    if (batching < 0 || batching >= OSVROpenGL::kTextureBatchingModes) {
+        batching = OSVROpenGL::TEXTURE_BATCHING_ATLAS;
+    }
+    const char *pathChars = atlasPath ? env->GetStringUTFChars(atlasPath, nullptr) : nullptr;
+    OSVROpenGL::setSceneMaterials(count > 0 ? static_cast<uint32_t>(count) : 0,
+                                  static_cast<OSVROpenGL::TextureBatching>(batching), pathChars);
+    if (pathChars) {
+        env->ReleaseStringUTFChars(atlasPath, pathChars);
+    }
 }
 
 //END_INCLUDE(all)
@@ -0,0 +1,178 @@
+/*
+ * Copyright (C) 2015 Sensics, Inc. and contributors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+// Every OpenGL ES 2.0 entry point, as X-macros:
+//   HOST_GL_FUNCTION(returnType, name, (parameters), (arguments))
+//   HOST_GL_DRAW_FUNCTION(...) for the calls that count as draws
+//   HOST_GL_TEXTURE_BIND_FUNCTION(...) for the ones that count as texture binds
+// HostCounters.cpp expands these into the --wrap interposers and
+// CMakeLists.txt reads the names from here to generate the linker flags, so
+// keep one entry per line.
+
+#ifndef HOST_GL_DRAW_FUNCTION
+#define HOST_GL_DRAW_FUNCTION HOST_GL_FUNCTION
+#endif
+#ifndef HOST_GL_TEXTURE_BIND_FUNCTION
+#define HOST_GL_TEXTURE_BIND_FUNCTION HOST_GL_FUNCTION
+#endif
+
+HOST_GL_FUNCTION(void, glActiveTexture, (GLenum texture), (texture))
+HOST_GL_FUNCTION(void, glAttachShader, (GLuint program, GLuint shader), (program, shader))
+HOST_GL_FUNCTION(void, glBindAttribLocation, (GLuint program, GLuint index, const GLchar *name), (program, index, name))
+HOST_GL_FUNCTION(void, glBindBuffer, (GLenum target, GLuint buffer), (target, buffer))
+HOST_GL_FUNCTION(void, glBindFramebuffer, (GLenum target, GLuint framebuffer), (target, framebuffer))
+HOST_GL_FUNCTION(void, glBindRenderbuffer, (GLenum target, GLuint renderbuffer), (target, renderbuffer))
+HOST_GL_TEXTURE_BIND_FUNCTION(void, glBindTexture, (GLenum target, GLuint texture), (target, texture))
+HOST_GL_FUNCTION(void, glBlendColor, (GLfloat red, GLfloat green, GLfloat blue, GLfloat alpha), (red, green, blue, alpha))
+HOST_GL_FUNCTION(void, glBlendEquation, (GLenum mode), (mode))
+HOST_GL_FUNCTION(void, glBlendEquationSeparate, (GLenum modeRGB, GLenum modeAlpha), (modeRGB, modeAlpha))
+HOST_GL_FUNCTION(void, glBlendFunc, (GLenum sfactor, GLenum dfactor), (sfactor, dfactor))
+HOST_GL_FUNCTION(void, glBlendFuncSeparate, (GLenum sfactorRGB, GLenum dfactorRGB, GLenum sfactorAlpha, GLenum dfactorAlpha), (sfactorRGB, dfactorRGB, sfactorAlpha, dfactorAlpha))
+HOST_GL_FUNCTION(void, glBufferData, (GLenum target, GLsizeiptr size, const void *data, GLenum usage), (target, size, data, usage))
+HOST_GL_FUNCTION(void, glBufferSubData, (GLenum target, GLintptr offset, GLsizeiptr size, const void *data), (target, offset, size, data))
+HOST_GL_FUNCTION(GLenum, glCheckFramebufferStatus, (GLenum target), (target))
+HOST_GL_FUNCTION(void, glClear, (GLbitfield mask), (mask))
+HOST_GL_FUNCTION(void, glClearColor, (GLfloat red, GLfloat green, GLfloat blue, GLfloat alpha), (red, green, blue, alpha))
+HOST_GL_FUNCTION(void, glClearDepthf, (GLfloat d), (d))
+HOST_GL_FUNCTION(void, glClearStencil, (GLint s), (s))
+HOST_GL_FUNCTION(void, glColorMask, (GLboolean red, GLboolean green, GLboolean blue, GLboolean alpha), (red, green, blue, alpha))
+HOST_GL_FUNCTION(void, glCompileShader, (GLuint shader), (shader))
+HOST_GL_FUNCTION(void, glCompressedTexImage2D, (GLenum target, GLint level, GLenum internalformat, GLsizei width, GLsizei height, GLint border, GLsizei imageSize, const void *data), (target, level, internalformat, width, height, border, imageSize, data))
+HOST_GL_FUNCTION(void, glCompressedTexSubImage2D, (GLenum target, GLint level, GLint xoffset, GLint yoffset, GLsizei width, GLsizei height, GLenum format, GLsizei imageSize, const void *data), (target, level, xoffset, yoffset, width, height, format, imageSize, data))
+HOST_GL_FUNCTION(void, glCopyTexImage2D, (GLenum target, GLint level, GLenum internalformat, GLint x, GLint y, GLsizei width, GLsizei height, GLint border), (target, level, internalformat, x, y, width, height, border))
+HOST_GL_FUNCTION(void, glCopyTexSubImage2D, (GLenum target, GLint level, GLint xoffset, GLint yoffset, GLint x, GLint y, GLsizei width, GLsizei height), (target, level, xoffset, yoffset, x, y, width, height))
+HOST_GL_FUNCTION(GLuint, glCreateProgram, (void), ())
+HOST_GL_FUNCTION(GLuint, glCreateShader, (GLenum type), (type))
+HOST_GL_FUNCTION(void, glCullFace, (GLenum mode), (mode))
+HOST_GL_FUNCTION(void, glDeleteBuffers, (GLsizei n, const GLuint *buffers), (n, buffers))
+HOST_GL_FUNCTION(void, glDeleteFramebuffers, (GLsizei n, const GLuint *framebuffers), (n, framebuffers))
+HOST_GL_FUNCTION(void, glDeleteProgram, (GLuint program), (program))
+HOST_GL_FUNCTION(void, glDeleteRenderbuffers, (GLsizei n, const GLuint *renderbuffers), (n, renderbuffers))
+HOST_GL_FUNCTION(void, glDeleteShader, (GLuint shader), (shader))
+HOST_GL_FUNCTION(void, glDeleteTextures, (GLsizei n, const GLuint *textures), (n, textures))
+HOST_GL_FUNCTION(void, glDepthFunc, (GLenum func), (func))
+HOST_GL_FUNCTION(void, glDepthMask, (GLboolean flag), (flag))
+HOST_GL_FUNCTION(void, glDepthRangef, (GLfloat n, GLfloat f), (n, f))
+HOST_GL_FUNCTION(void, glDetachShader, (GLuint program, GLuint shader), (program, shader))
+HOST_GL_FUNCTION(void, glDisable, (GLenum cap), (cap))
+HOST_GL_FUNCTION(void, glDisableVertexAttribArray, (GLuint index), (index))
+HOST_GL_DRAW_FUNCTION(void, glDrawArrays, (GLenum mode, GLint first, GLsizei count), (mode, first, count))
+HOST_GL_DRAW_FUNCTION(void, glDrawElements, (GLenum mode, GLsizei count, GLenum type, const void *indices), (mode, count, type, indices))
+HOST_GL_FUNCTION(void, glEnable, (GLenum cap), (cap))
+HOST_GL_FUNCTION(void, glEnableVertexAttribArray, (GLuint index), (index))
+HOST_GL_FUNCTION(void, glFinish, (void), ())
+HOST_GL_FUNCTION(void, glFlush, (void), ())
+HOST_GL_FUNCTION(void, glFramebufferRenderbuffer, (GLenum target, GLenum attachment, GLenum renderbuffertarget, GLuint renderbuffer), (target, attachment, renderbuffertarget, renderbuffer))
+HOST_GL_FUNCTION(void, glFramebufferTexture2D, (GLenum target, GLenum attachment, GLenum textarget, GLuint texture, GLint level), (target, attachment, textarget, texture, level))
+HOST_GL_FUNCTION(void, glFrontFace, (GLenum mode), (mode))
+HOST_GL_FUNCTION(void, glGenBuffers, (GLsizei n, GLuint *buffers), (n, buffers))
+HOST_GL_FUNCTION(void, glGenerateMipmap, (GLenum target), (target))
+HOST_GL_FUNCTION(void, glGenFramebuffers, (GLsizei n, GLuint *framebuffers), (n, framebuffers))
+HOST_GL_FUNCTION(void, glGenRenderbuffers, (GLsizei n, GLuint *renderbuffers), (n, renderbuffers))
+HOST_GL_FUNCTION(void, glGenTextures, (GLsizei n, GLuint *textures), (n, textures))
+HOST_GL_FUNCTION(void, glGetActiveAttrib, (GLuint program, GLuint index, GLsizei bufSize, GLsizei *length, GLint *size, GLenum *type, GLchar *name), (program, index, bufSize, length, size, type, name))
+HOST_GL_FUNCTION(void, glGetActiveUniform, (GLuint program, GLuint index, GLsizei bufSize, GLsizei *length, GLint *size, GLenum *type, GLchar *name), (program, index, bufSize, length, size, type, name))
+HOST_GL_FUNCTION(void, glGetAttachedShaders, (GLuint program, GLsizei maxCount, GLsizei *count, GLuint *shaders), (program, maxCount, count, shaders))
+HOST_GL_FUNCTION(GLint, glGetAttribLocation, (GLuint program, const GLchar *name), (program, name))
+HOST_GL_FUNCTION(void, glGetBooleanv, (GLenum pname, GLboolean *data), (pname, data))
+HOST_GL_FUNCTION(void, glGetBufferParameteriv, (GLenum target, GLenum pname, GLint *params), (target, pname, params))
+HOST_GL_FUNCTION(GLenum, glGetError, (void), ())
+HOST_GL_FUNCTION(void, glGetFloatv, (GLenum pname, GLfloat *data), (pname, data))
+HOST_GL_FUNCTION(void, glGetFramebufferAttachmentParameteriv, (GLenum target, GLenum attachment, GLenum pname, GLint *params), (target, attachment, pname, params))
+HOST_GL_FUNCTION(void, glGetIntegerv, (GLenum pname, GLint *data), (pname, data))
+HOST_GL_FUNCTION(void, glGetProgramiv, (GLuint program, GLenum pname, GLint *params), (program, pname, params))
+HOST_GL_FUNCTION(void, glGetProgramInfoLog, (GLuint program, GLsizei bufSize, GLsizei *length, GLchar *infoLog), (program, bufSize, length, infoLog))
+HOST_GL_FUNCTION(void, glGetRenderbufferParameteriv, (GLenum target, GLenum pname, GLint *params), (target, pname, params))
+HOST_GL_FUNCTION(void, glGetShaderiv, (GLuint shader, GLenum pname, GLint *params), (shader, pname, params))
+HOST_GL_FUNCTION(void, glGetShaderInfoLog, (GLuint shader, GLsizei bufSize, GLsizei *length, GLchar *infoLog), (shader, bufSize, length, infoLog))
+HOST_GL_FUNCTION(void, glGetShaderPrecisionFormat, (GLenum shadertype, GLenum precisiontype, GLint *range, GLint *precision), (shadertype, precisiontype, range, precision))
+HOST_GL_FUNCTION(void, glGetShaderSource, (GLuint shader, GLsizei bufSize, GLsizei *length, GLchar *source), (shader, bufSize, length, source))
+HOST_GL_FUNCTION(const GLubyte *, glGetString, (GLenum name), (name))
+HOST_GL_FUNCTION(void, glGetTexParameterfv, (GLenum target, GLenum pname, GLfloat *params), (target, pname, params))
+HOST_GL_FUNCTION(void, glGetTexParameteriv, (GLenum target, GLenum pname, GLint *params), (target, pname, params))
+HOST_GL_FUNCTION(void, glGetUniformfv, (GLuint program, GLint location, GLfloat *params), (program, location, params))
+HOST_GL_FUNCTION(void, glGetUniformiv, (GLuint program, GLint location, GLint *params), (program, location, params))
+HOST_GL_FUNCTION(GLint, glGetUniformLocation, (GLuint program, const GLchar *name), (program, name))
+HOST_GL_FUNCTION(void, glGetVertexAttribfv, (GLuint index, GLenum pname, GLfloat *params), (index, pname, params))
+HOST_GL_FUNCTION(void, glGetVertexAttribiv, (GLuint index, GLenum pname, GLint *params), (index, pname, params))
+HOST_GL_FUNCTION(void, glGetVertexAttribPointerv, (GLuint index, GLenum pname, void **pointer), (index, pname, pointer))
+HOST_GL_FUNCTION(void, glHint, (GLenum target, GLenum mode), (target, mode))
+HOST_GL_FUNCTION(GLboolean, glIsBuffer, (GLuint buffer), (buffer))
+HOST_GL_FUNCTION(GLboolean, glIsEnabled, (GLenum cap), (cap))
+HOST_GL_FUNCTION(GLboolean, glIsFramebuffer, (GLuint framebuffer), (framebuffer))
+HOST_GL_FUNCTION(GLboolean, glIsProgram, (GLuint program), (program))
+HOST_GL_FUNCTION(GLboolean, glIsRenderbuffer, (GLuint renderbuffer), (renderbuffer))
+HOST_GL_FUNCTION(GLboolean, glIsShader, (GLuint shader), (shader))
+HOST_GL_FUNCTION(GLboolean, glIsTexture, (GLuint texture), (texture))
+HOST_GL_FUNCTION(void, glLineWidth, (GLfloat width), (width))
+HOST_GL_FUNCTION(void, glLinkProgram, (GLuint program), (program))
+HOST_GL_FUNCTION(void, glPixelStorei, (GLenum pname, GLint param), (pname, param))
+HOST_GL_FUNCTION(void, glPolygonOffset, (GLfloat factor, GLfloat units), (factor, units))
+HOST_GL_FUNCTION(void, glReadPixels, (GLint x, GLint y, GLsizei width, GLsizei height, GLenum format, GLenum type, void *pixels), (x, y, width, height, format, type, pixels))
+HOST_GL_FUNCTION(void, glReleaseShaderCompiler, (void), ())
+HOST_GL_FUNCTION(void, glRenderbufferStorage, (GLenum target, GLenum internalformat, GLsizei width, GLsizei height), (target, internalformat, width, height))
+HOST_GL_FUNCTION(void, glSampleCoverage, (GLfloat value, GLboolean invert), (value, invert))
+HOST_GL_FUNCTION(void, glScissor, (GLint x, GLint y, GLsizei width, GLsizei height), (x, y, width, height))
+HOST_GL_FUNCTION(void, glShaderBinary, (GLsizei count, const GLuint *shaders, GLenum binaryFormat, const void *binary, GLsizei length), (count, shaders, binaryFormat, binary, length))
+HOST_GL_FUNCTION(void, glShaderSource, (GLuint shader, GLsizei count, const GLchar *const*string, const GLint *length), (shader, count, string, length))
+HOST_GL_FUNCTION(void, glStencilFunc, (GLenum func, GLint ref, GLuint mask), (func, ref, mask))
+HOST_GL_FUNCTION(void, glStencilFuncSeparate, (GLenum face, GLenum func, GLint ref, GLuint mask), (face, func, ref, mask))
+HOST_GL_FUNCTION(void, glStencilMask, (GLuint mask), (mask))
+HOST_GL_FUNCTION(void, glStencilMaskSeparate, (GLenum face, GLuint mask), (face, mask))
+HOST_GL_FUNCTION(void, glStencilOp, (GLenum fail, GLenum zfail, GLenum zpass), (fail, zfail, zpass))
+HOST_GL_FUNCTION(void, glStencilOpSeparate, (GLenum face, GLenum sfail, GLenum dpfail, GLenum dppass), (face, sfail, dpfail, dppass))
+HOST_GL_FUNCTION(void, glTexImage2D, (GLenum target, GLint level, GLint internalformat, GLsizei width, GLsizei height, GLint border, GLenum format, GLenum type, const void *pixels), (target, level, internalformat, width, height, border, format, type, pixels))
+HOST_GL_FUNCTION(void, glTexParameterf, (GLenum target, GLenum pname, GLfloat param), (target, pname, param))
+HOST_GL_FUNCTION(void, glTexParameterfv, (GLenum target, GLenum pname, const GLfloat *params), (target, pname, params))
+HOST_GL_FUNCTION(void, glTexParameteri, (GLenum target, GLenum pname, GLint param), (target, pname, param))
+HOST_GL_FUNCTION(void, glTexParameteriv, (GLenum target, GLenum pname, const GLint *params), (target, pname, params))
+HOST_GL_FUNCTION(void, glTexSubImage2D, (GLenum target, GLint level, GLint xoffset, GLint yoffset, GLsizei width, GLsizei height, GLenum format, GLenum type, const void *pixels), (target, level, xoffset, yoffset, width, height, format, type, pixels))
+HOST_GL_FUNCTION(void, glUniform1f, (GLint location, GLfloat v0), (location, v0))
+HOST_GL_FUNCTION(void, glUniform1fv, (GLint location, GLsizei count, const GLfloat *value), (location, count, value))
+HOST_GL_FUNCTION(void, glUniform1i, (GLint location, GLint v0), (location, v0))
+HOST_GL_FUNCTION(void, glUniform1iv, (GLint location, GLsizei count, const GLint *value), (location, count, value))
+HOST_GL_FUNCTION(void, glUniform2f, (GLint location, GLfloat v0, GLfloat v1), (location, v0, v1))
+HOST_GL_FUNCTION(void, glUniform2fv, (GLint location, GLsizei count, const GLfloat *value), (location, count, value))
+HOST_GL_FUNCTION(void, glUniform2i, (GLint location, GLint v0, GLint v1), (location, v0, v1))
+HOST_GL_FUNCTION(void, glUniform2iv, (GLint location, GLsizei count, const GLint *value), (location, count, value))
+HOST_GL_FUNCTION(void, glUniform3f, (GLint location, GLfloat v0, GLfloat v1, GLfloat v2), (location, v0, v1, v2))
+HOST_GL_FUNCTION(void, glUniform3fv, (GLint location, GLsizei count, const GLfloat *value), (location, count, value))
+HOST_GL_FUNCTION(void, glUniform3i, (GLint location, GLint v0, GLint v1, GLint v2), (location, v0, v1, v2))
+HOST_GL_FUNCTION(void, glUniform3iv, (GLint location, GLsizei count, const GLint *value), (location, count, value))
+HOST_GL_FUNCTION(void, glUniform4f, (GLint location, GLfloat v0, GLfloat v1, GLfloat v2, GLfloat v3), (location, v0, v1, v2, v3))
+HOST_GL_FUNCTION(void, glUniform4fv, (GLint location, GLsizei count, const GLfloat *value), (location, count, value))
+HOST_GL_FUNCTION(void, glUniform4i, (GLint location, GLint v0, GLint v1, GLint v2, GLint v3), (location, v0, v1, v2, v3))
+HOST_GL_FUNCTION(void, glUniform4iv, (GLint location, GLsizei count, const GLint *value), (location, count, value))
+HOST_GL_FUNCTION(void, glUniformMatrix2fv, (GLint location, GLsizei count, GLboolean transpose, const GLfloat *value), (location, count, transpose, value))
+HOST_GL_FUNCTION(void, glUniformMatrix3fv, (GLint location, GLsizei count, GLboolean transpose, const GLfloat *value), (location, count, transpose, value))
+HOST_GL_FUNCTION(void, glUniformMatrix4fv, (GLint location, GLsizei count, GLboolean transpose, const GLfloat *value), (location, count, transpose, value))
+HOST_GL_FUNCTION(void, glUseProgram, (GLuint program), (program))
+HOST_GL_FUNCTION(void, glValidateProgram, (GLuint program), (program))
+HOST_GL_FUNCTION(void, glVertexAttrib1f, (GLuint index, GLfloat x), (index, x))
+HOST_GL_FUNCTION(void, glVertexAttrib1fv, (GLuint index, const GLfloat *v), (index, v))
+HOST_GL_FUNCTION(void, glVertexAttrib2f, (GLuint index, GLfloat x, GLfloat y), (index, x, y))
+HOST_GL_FUNCTION(void, glVertexAttrib2fv, (GLuint index, const GLfloat *v), (index, v))
+HOST_GL_FUNCTION(void, glVertexAttrib3f, (GLuint index, GLfloat x, GLfloat y, GLfloat z), (index, x, y, z))
+HOST_GL_FUNCTION(void, glVertexAttrib3fv, (GLuint index, const GLfloat *v), (index, v))
+HOST_GL_FUNCTION(void, glVertexAttrib4f, (GLuint index, GLfloat x, GLfloat y, GLfloat z, GLfloat w), (index, x, y, z, w))
+HOST_GL_FUNCTION(void, glVertexAttrib4fv, (GLuint index, const GLfloat *v), (index, v))
+HOST_GL_FUNCTION(void, glVertexAttribPointer, (GLuint index, GLint size, GLenum type, GLboolean normalized, GLsizei stride, const void *pointer), (index, size, type, normalized, stride, pointer))
+HOST_GL_FUNCTION(void, glViewport, (GLint x, GLint y, GLsizei width, GLsizei height), (x, y, width, height))
+
+#undef HOST_GL_FUNCTION
+#undef HOST_GL_DRAW_FUNCTION
+#undef HOST_GL_TEXTURE_BIND_FUNCTION
@@ -0,0 +1,196 @@
+/*
+ * Copyright (C) 2015 Sensics, Inc. and contributors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+
+#include "EGLFence.h"
+#include "FrameStats.h"
+
+#include "HostCounters.h"
+#include "HostCameraProducer.h"
+
+namespace OSVROpenGLHost {
+
+    typedef void *(EGLAPIENTRY *CreateImageFn)(EGLDisplay display, EGLContext context, EGLenum target,
+                                                EGLClientBuffer buffer, const EGLint *attribs);
+    typedef EGLBoolean (EGLAPIENTRY *DestroyImageFn)(EGLDisplay display, void *image);
+
+    HostCameraProducer::HostCameraProducer()
+        : mStream(0), mEGLImages(false), mWidth(0), mHeight(0), mFrameHz(0.0), mRunning(false), mProduced(0) {
+        memset(&mContext, 0, sizeof(mContext));
+        for (int i = 0; i < kBufferCount; i++) {
+            mTextures[i] = 0;
+            mImages[i] = nullptr;
+            mSlots[i] = -1;
+        }
+    }
+
+    HostCameraProducer::~HostCameraProducer() {
+        stop();
+        destroy();
+    }
+
+    bool HostCameraProducer::start(uint32_t stream, bool eglImages, int width, int height, double frameHz) {
+        mStream = stream;
+        mEGLImages = eglImages;
+        mWidth = width;
+        mHeight = height;
+        mFrameHz = frameHz;
+        if (eglImages) {
+            ScopedExternalCode camera;
+            if (!OSVROpenGL::createSharedGLContext(&mContext)) {
+                return false;
+            }
+        }
+        mRunning.store(true);
+        mThread = std::thread(&HostCameraProducer::run, this);
+        return true;
+    }
+
+    void HostCameraProducer::stop() {
+        mRunning.store(false);
+        if (mThread.joinable()) {
+            mThread.join();
+        }
+    }
+
+    // On the producer thread, with its context current for EGLImages.
+    bool HostCameraProducer::createBuffers() {
+        CreateImageFn createImage = (CreateImageFn) eglGetProcAddress("eglCreateImageKHR");
+        for (int i = 0; i < kBufferCount; i++) {
+            OSVROpenGL::ExternalBuffer buffer;
+            memset(&buffer, 0, sizeof(buffer));
+            buffer.width = static_cast<uint32_t>(mWidth);
+            buffer.height = static_cast<uint32_t>(mHeight);
+            buffer.stride = buffer.width * 4;
+            if (mEGLImages) {
+                glGenTextures(1, &mTextures[i]);
+                glBindTexture(GL_TEXTURE_2D, mTextures[i]);
+                glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, mWidth, mHeight, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+                glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+                const EGLint attribs[] = { EGL_IMAGE_PRESERVED_KHR, EGL_TRUE, EGL_NONE };
+                mImages[i] = createImage ? createImage(mContext.display, mContext.context, EGL_GL_TEXTURE_2D_KHR,
+                                                       reinterpret_cast<EGLClientBuffer>(
+                                                               static_cast<uintptr_t>(mTextures[i])),
+                                                       attribs) : nullptr;
+                if (!mImages[i]) {
+                    fprintf(stderr, "camera producer: could not make an EGLImage of a texture (error 0x%x)\n",
+                            eglGetError());
+                    return false;
+                }
+                buffer.type = OSVROpenGL::EXTERNAL_BUFFER_EGL_IMAGE;
+                buffer.handle = mImages[i];
+            } else {
+                mPixels[i].resize(static_cast<size_t>(buffer.stride) * mHeight);
+                buffer.type = OSVROpenGL::EXTERNAL_BUFFER_CPU;
+                buffer.pixels = mPixels[i].data();
+            }
+            mSlots[i] = OSVROpenGL::registerExternalBuffer(mStream, buffer);
+            if (mSlots[i] < 0) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // Diagonal bands moving a few pixels a frame.
+    void HostCameraProducer::fillFrame(uint8_t *pixels, uint64_t frame) {
+        uint32_t shift = static_cast<uint32_t>(frame * 4);
+        for (int y = 0; y < mHeight; y++) {
+            uint8_t *pixel = pixels + static_cast<size_t>(y) * mWidth * 4;
+            for (int x = 0; x < mWidth; x++, pixel += 4) {
+                uint32_t band = (static_cast<uint32_t>(x + y) + shift) & 255;
+                pixel[0] = static_cast<uint8_t>(band);
+                pixel[1] = static_cast<uint8_t>(255 - band);
+                pixel[2] = static_cast<uint8_t>(y * 255 / mHeight);
+                pixel[3] = 255;
+            }
+        }
+    }
+
+    void HostCameraProducer::run() {
+        // the camera's work is not the renderer's
+        ScopedExternalCode camera;
+        if (mEGLImages && !OSVROpenGL::makeSharedGLContextCurrent(&mContext)) {
+            return;
+        }
+        std::vector<uint8_t> frame(static_cast<size_t>(mWidth) * mHeight * 4);
+        if (createBuffers()) {
+            const std::chrono::nanoseconds period(static_cast<int64_t>(1.0e9 / mFrameHz));
+            std::chrono::steady_clock::time_point next = std::chrono::steady_clock::now();
+            uint64_t frameNumber = 0;
+            while (mRunning.load()) {
+                next += period;
+                std::this_thread::sleep_until(next);
+                int slot = OSVROpenGL::acquireExternalBuffer(mStream, 20000000);
+                if (slot < 0) {
+                    continue;
+                }
+                int buffer = 0;
+                while (mSlots[buffer] != slot) {
+                    buffer++;
+                }
+                OSVROpenGL::EGLFence ready = nullptr;
+                if (mEGLImages) {
+                    // what the camera's DMA into the buffer would be on a device
+                    fillFrame(frame.data(), frameNumber);
+                    glBindTexture(GL_TEXTURE_2D, mTextures[buffer]);
+                    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, mWidth, mHeight, GL_RGBA, GL_UNSIGNED_BYTE,
+                                    frame.data());
+                    ready = OSVROpenGL::createEGLFence();
+                    glFlush();
+                } else {
+                    fillFrame(mPixels[buffer].data(), frameNumber);
+                }
+                OSVROpenGL::queueExternalBuffer(mStream, slot, OSVROpenGL::frameStatsNowNs(), ready);
+                frameNumber++;
+                mProduced.store(frameNumber, std::memory_order_relaxed);
+            }
+        }
+        if (mEGLImages) {
+            // the EGLImages keep the texels
+            glDeleteTextures(kBufferCount, mTextures);
+            glFinish();
+            OSVROpenGL::makeSharedGLContextCurrent(nullptr);
+        }
+    }
+
+    void HostCameraProducer::destroy() {
+        ScopedExternalCode camera;
+        DestroyImageFn destroyImage = (DestroyImageFn) eglGetProcAddress("eglDestroyImageKHR");
+        for (int i = 0; i < kBufferCount; i++) {
+            if (mSlots[i] >= 0) {
+                OSVROpenGL::unregisterExternalBuffer(mStream, mSlots[i]);
+                mSlots[i] = -1;
+            }
+            if (mImages[i] && destroyImage) {
+                destroyImage(mContext.display, mImages[i]);
+            }
+            mImages[i] = nullptr;
+            mTextures[i] = 0;
+        }
+        if (mContext.context != EGL_NO_CONTEXT && mContext.display != EGL_NO_DISPLAY) {
+            OSVROpenGL::destroySharedGLContext(&mContext);
+            memset(&mContext, 0, sizeof(mContext));
+        }
+    }
+}
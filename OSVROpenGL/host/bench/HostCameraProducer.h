@@ -0,0 +1,76 @@
+/*
+ * Copyright (C) 2015 Sensics, Inc. and contributors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef OSVROPENGL_HOST_HOSTCAMERAPRODUCER_H
+#define OSVROPENGL_HOST_HOSTCAMERAPRODUCER_H
+
+#include <atomic>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+#include <GLES2/gl2.h>
+
+#include "ExternalImage.h"
+#include "Reprojection.h"
+
+namespace OSVROpenGLHost {
+
+    // A software camera for the external image path (see ExternalImage.h).
+    // On its own thread it writes frames into a ring of buffers it owns and
+    // hands them over through the stream: EGLImages of textures in a context
+    // of its own, standing in for the buffers a camera writes on a device,
+    // or CPU memory, for the upload fallback.
+    class HostCameraProducer {
+        static const int kBufferCount = 3;
+
+        uint32_t mStream;
+        bool mEGLImages;
+        int mWidth;
+        int mHeight;
+        double mFrameHz;
+        OSVROpenGL::SharedGLContext mContext;
+        GLuint mTextures[kBufferCount];
+        void *mImages[kBufferCount];
+        std::vector<uint8_t> mPixels[kBufferCount];
+        int mSlots[kBufferCount];
+        std::thread mThread;
+        std::atomic<bool> mRunning;
+        std::atomic<uint64_t> mProduced;
+
+        void run();
+        bool createBuffers();
+        void fillFrame(uint8_t *pixels, uint64_t frame);
+
+    public:
+        HostCameraProducer();
+        ~HostCameraProducer();
+
+        // Starts producing frameHz frames; call with the renderer's context
+        // current, as an EGLImage producer's context shares its display.
+        bool start(uint32_t stream, bool eglImages, int width, int height, double frameHz);
+        // Stops the thread. The buffers stay registered for destroy().
+        void stop();
+        // Unregisters and frees the buffers, once the renderer has let go of
+        // them (OSVROpenGL::stop() or releaseExternalImages()).
+        void destroy();
+
+        uint64_t framesProduced() const { return mProduced.load(std::memory_order_relaxed); }
+    };
+}
+
+#endif // OSVROPENGL_HOST_HOSTCAMERAPRODUCER_H
@@ -0,0 +1,218 @@
+/*
+ * Copyright (C) 2015 Sensics, Inc. and contributors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include <atomic>
+#include <cerrno>
+#include <cstddef>
+#include <cstring>
+
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#include <GLES2/gl2.h>
+
+#include <OSVRStub.h>
+
+#include "HostCounters.h"
+
+// glibc's own allocator entry points, so the interposers below can forward
+// without dlsym (which may itself allocate).
+extern "C" {
+    void *__libc_malloc(size_t size);
+    void *__libc_calloc(size_t count, size_t size);
+    void *__libc_realloc(void *ptr, size_t size);
+    void *__libc_memalign(size_t alignment, size_t size);
+    void __libc_free(void *ptr);
+}
+
+namespace OSVROpenGLHost {
+
+    static std::atomic<uint64_t> gGLCalls(0);
+    static std::atomic<uint64_t> gDrawCalls(0);
+    static std::atomic<uint64_t> gTextureBinds(0);
+    static std::atomic<uint64_t> gAllocations(0);
+    static std::atomic<uint64_t> gAllocatedBytes(0);
+
+    static std::atomic<bool> gCountAllocations(false);
+    static thread_local int tExternalDepth = 0;
+
+    void getHostCounters(HostCounters *countersOut) {
+        countersOut->glCalls = gGLCalls.load(std::memory_order_relaxed);
+        countersOut->drawCalls = gDrawCalls.load(std::memory_order_relaxed);
+        countersOut->textureBinds = gTextureBinds.load(std::memory_order_relaxed);
+        countersOut->allocations = gAllocations.load(std::memory_order_relaxed);
+        countersOut->allocatedBytes = gAllocatedBytes.load(std::memory_order_relaxed);
+    }
+
+    void setAllocationCountingEnabled(bool enabled) {
+        gCountAllocations.store(enabled, std::memory_order_relaxed);
+    }
+
+    void enterExternalCode() {
+        tExternalDepth++;
+    }
+
+    void leaveExternalCode() {
+        tExternalDepth--;
+    }
+
+    enum GLCallKind {
+        GL_CALL,
+        GL_DRAW_CALL,
+        GL_TEXTURE_BIND
+    };
+
+    static inline void countGLCall(GLCallKind kind) {
+        if (tExternalDepth == 0) {
+            gGLCalls.fetch_add(1, std::memory_order_relaxed);
+            if (kind == GL_DRAW_CALL) {
+                gDrawCalls.fetch_add(1, std::memory_order_relaxed);
+            } else if (kind == GL_TEXTURE_BIND) {
+                gTextureBinds.fetch_add(1, std::memory_order_relaxed);
+            }
+        }
+    }
+
+    static inline void countAllocation(size_t size) {
+        if (tExternalDepth == 0 && gCountAllocations.load(std::memory_order_relaxed)) {
+            gAllocations.fetch_add(1, std::memory_order_relaxed);
+            gAllocatedBytes.fetch_add(size, std::memory_order_relaxed);
+        }
+    }
+}
+
+using namespace OSVROpenGLHost;
+
+extern "C" {
+
+void osvrHostEnterLibrary(void) {
+    enterExternalCode();
+}
+
+void osvrHostLeaveLibrary(void) {
+    leaveExternalCode();
+}
+
+// GL interposers; the link adds --wrap=<name> for every entry of the list.
+#define HOST_GL_WRAP(ret, name, params, args, kind) \
+    ret __real_##name params; \
+    ret __wrap_##name params { \
+        countGLCall(kind); \
+        ScopedExternalCode driver; \
+        return __real_##name args; \
+    }
+#define HOST_GL_FUNCTION(ret, name, params, args) HOST_GL_WRAP(ret, name, params, args, GL_CALL)
+#define HOST_GL_DRAW_FUNCTION(ret, name, params, args) HOST_GL_WRAP(ret, name, params, args, GL_DRAW_CALL)
+#define HOST_GL_TEXTURE_BIND_FUNCTION(ret, name, params, args) HOST_GL_WRAP(ret, name, params, args, GL_TEXTURE_BIND)
+#include "GLFunctionList.h"
+#undef HOST_GL_WRAP
+
+// Extension entry points the app looks up at run time get past the link-time
+// wrapping, so eglGetProcAddress (itself wrapped) hands out counted versions
+// of the ones the rendering core uses.
+#define HOST_EXTENSION_FUNCTIONS(X) \
+    X(void, glGenQueriesEXT, (GLsizei n, GLuint *ids), (n, ids), true) \
+    X(void, glDeleteQueriesEXT, (GLsizei n, const GLuint *ids), (n, ids), true) \
+    X(void, glBeginQueryEXT, (GLenum target, GLuint id), (target, id), true) \
+    X(void, glEndQueryEXT, (GLenum target), (target), true) \
+    X(void, glGetQueryObjectuivEXT, (GLuint id, GLenum pname, GLuint *params), (id, pname, params), true) \
+    X(void, glGetQueryObjectui64vEXT, (GLuint id, GLenum pname, uint64_t *params), (id, pname, params), true) \
+    X(void *, glMapBufferRange, (GLenum target, GLintptr offset, GLsizeiptr length, GLbitfield access), \
+      (target, offset, length, access), true) \
+    X(GLboolean, glUnmapBuffer, (GLenum target), (target), true) \
+    X(void, glTexImage3D, (GLenum target, GLint level, GLint internalformat, GLsizei width, GLsizei height, \
+      GLsizei depth, GLint border, GLenum format, GLenum type, const void *pixels), \
+      (target, level, internalformat, width, height, depth, border, format, type, pixels), true) \
+    X(EGLSyncKHR, eglCreateSyncKHR, (EGLDisplay dpy, EGLenum type, const EGLint *attribs), (dpy, type, attribs), false) \
+    X(EGLBoolean, eglDestroySyncKHR, (EGLDisplay dpy, EGLSyncKHR sync), (dpy, sync), false) \
+    X(EGLint, eglClientWaitSyncKHR, (EGLDisplay dpy, EGLSyncKHR sync, EGLint flags, EGLTimeKHR timeout), \
+      (dpy, sync, flags, timeout), false)
+
+#define HOST_EXTENSION_WRAP(ret, name, params, args, isGL) \
+    static ret (*gReal_##name) params = nullptr; \
+    static ret hostWrapped_##name params { \
+        if (isGL) { \
+            countGLCall(GL_CALL); \
+        } \
+        ScopedExternalCode driver; \
+        return gReal_##name args; \
+    }
+HOST_EXTENSION_FUNCTIONS(HOST_EXTENSION_WRAP)
+#undef HOST_EXTENSION_WRAP
+
+__eglMustCastToProperFunctionPointerType __real_eglGetProcAddress(const char *procname);
+__eglMustCastToProperFunctionPointerType __wrap_eglGetProcAddress(const char *procname) {
+    __eglMustCastToProperFunctionPointerType real;
+    {
+        ScopedExternalCode driver;
+        real = __real_eglGetProcAddress(procname);
+    }
+#define HOST_EXTENSION_LOOKUP(ret, name, params, args, isGL) \
+    if (real && !strcmp(procname, #name)) { \
+        gReal_##name = reinterpret_cast<ret (*) params>(real); \
+        return reinterpret_cast<__eglMustCastToProperFunctionPointerType>(hostWrapped_##name); \
+    }
+    HOST_EXTENSION_FUNCTIONS(HOST_EXTENSION_LOOKUP)
+#undef HOST_EXTENSION_LOOKUP
+    return real;
+}
+
+// malloc interposers
+void *malloc(size_t size) {
+    countAllocation(size);
+    return __libc_malloc(size);
+}
+
+void *calloc(size_t count, size_t size) {
+    countAllocation(count * size);
+    return __libc_calloc(count, size);
+}
+
+void *realloc(void *ptr, size_t size) {
+    if (size) {
+        countAllocation(size);
+    }
+    return __libc_realloc(ptr, size);
+}
+
+void free(void *ptr) {
+    __libc_free(ptr);
+}
+
+void *memalign(size_t alignment, size_t size) {
+    countAllocation(size);
+    return __libc_memalign(alignment, size);
+}
+
+void *aligned_alloc(size_t alignment, size_t size) {
+    countAllocation(size);
+    return __libc_memalign(alignment, size);
+}
+
+int posix_memalign(void **ptr, size_t alignment, size_t size) {
+    if (alignment < sizeof(void *) || (alignment & (alignment - 1))) {
+        return EINVAL;
+    }
+    countAllocation(size);
+    void *ret = __libc_memalign(alignment, size);
+    if (!ret) {
+        return ENOMEM;
+    }
+    *ptr = ret;
+    return 0;
+}
+
+}
@@ -0,0 +1,58 @@
+/*
+ * Copyright (C) 2015 Sensics, Inc. and contributors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef OSVROPENGL_HOST_HOSTCOUNTERS_H
+#define OSVROPENGL_HOST_HOSTCOUNTERS_H
+
+#include <cstdint>
+
+namespace OSVROpenGLHost {
+
+    // Process-wide counters kept by the GL --wrap interposers and the malloc
+    // interposer in HostCounters.cpp.
+    //
+    // Only work done by the app itself is counted: GL calls and allocations
+    // made while "inside" the OSVR stub or the GL/EGL driver (see
+    // ScopedExternalCode and osvrHostEnterLibrary) are left out, so the numbers
+    // track what the rendering core is responsible for.
+    struct HostCounters {
+        uint64_t glCalls;
+        uint64_t drawCalls;
+        uint64_t textureBinds;      // glBindTexture, of any target
+        uint64_t allocations;       // malloc, calloc, realloc, memalign and friends (and so new)
+        uint64_t allocatedBytes;
+    };
+
+    void getHostCounters(HostCounters *countersOut);
+
+    // Allocations are counted while enabled, on every thread: the render
+    // thread, the app thread with async reprojection, the job workers and any
+    // other the renderer starts.
+    void setAllocationCountingEnabled(bool enabled);
+
+    // Marks the calling thread as running code outside the app.
+    void enterExternalCode();
+    void leaveExternalCode();
+
+    class ScopedExternalCode {
+    public:
+        ScopedExternalCode() { enterExternalCode(); }
+        ~ScopedExternalCode() { leaveExternalCode(); }
+    };
+}
+
+#endif // OSVROPENGL_HOST_HOSTCOUNTERS_H
@@ -0,0 +1,166 @@
+/*
+ * Copyright (C) 2015 Sensics, Inc. and contributors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include <cstdio>
+#include <cstring>
+
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+
+#include "HostCounters.h"
+#include "HostEGL.h"
+
+#ifndef EGL_PLATFORM_SURFACELESS_MESA
+#define EGL_PLATFORM_SURFACELESS_MESA 0x31DD
+#endif
+
+namespace OSVROpenGLHost {
+
+    static bool hasEGLExtension(const char *extensions, const char *name) {
+        size_t length = strlen(name);
+        for (const char *p = extensions; p && (p = strstr(p, name)); p += length) {
+            if ((p == extensions || p[-1] == ' ') && (p[length] == ' ' || p[length] == '\0')) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    static EGLDisplay openDisplay() {
+        EGLDisplay display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+        if (display != EGL_NO_DISPLAY && eglInitialize(display, nullptr, nullptr)) {
+            return display;
+        }
+
+        const char *clientExtensions = eglQueryString(EGL_NO_DISPLAY, EGL_EXTENSIONS);
+        if (!hasEGLExtension(clientExtensions, "EGL_MESA_platform_surfaceless")) {
+            return EGL_NO_DISPLAY;
+        }
+        PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay =
+                (PFNEGLGETPLATFORMDISPLAYEXTPROC) eglGetProcAddress("eglGetPlatformDisplayEXT");
+        if (!getPlatformDisplay) {
+            return EGL_NO_DISPLAY;
+        }
+        display = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr);
+        if (display != EGL_NO_DISPLAY && eglInitialize(display, nullptr, nullptr)) {
+            return display;
+        }
+        return EGL_NO_DISPLAY;
+    }
+
+    HostEGLContext::HostEGLContext()
+        : mDisplay(EGL_NO_DISPLAY), mConfig(nullptr), mSurface(EGL_NO_SURFACE), mContext(EGL_NO_CONTEXT) {
+    }
+
+    HostEGLContext::~HostEGLContext() {
+        destroy();
+    }
+
+    bool HostEGLContext::create(int width, int height) {
+        ScopedExternalCode driver;
+        mDisplay = openDisplay();
+        if (mDisplay == EGL_NO_DISPLAY) {
+            fprintf(stderr, "Could not open an EGL display (error 0x%x)\n", eglGetError());
+            return false;
+        }
+
+        const EGLint configAttribs[] = {
+                EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+                EGL_RENDERABLE_TYPE, EGL_OPENGL_ES2_BIT,
+                EGL_RED_SIZE, 8,
+                EGL_GREEN_SIZE, 8,
+                EGL_BLUE_SIZE, 8,
+                EGL_ALPHA_SIZE, 8,
+                EGL_DEPTH_SIZE, 16,
+                EGL_NONE
+        };
+        EGLint configCount = 0;
+        if (!eglChooseConfig(mDisplay, configAttribs, &mConfig, 1, &configCount) || configCount < 1) {
+            fprintf(stderr, "No pbuffer-capable ES2 EGL config (error 0x%x)\n", eglGetError());
+            return false;
+        }
+
+        const EGLint surfaceAttribs[] = { EGL_WIDTH, width, EGL_HEIGHT, height, EGL_NONE };
+        mSurface = eglCreatePbufferSurface(mDisplay, mConfig, surfaceAttribs);
+        if (mSurface == EGL_NO_SURFACE) {
+            fprintf(stderr, "Could not create a %dx%d pbuffer (error 0x%x)\n", width, height, eglGetError());
+            return false;
+        }
+
+        eglBindAPI(EGL_OPENGL_ES_API);
+        const EGLint contextAttribs[] = { EGL_CONTEXT_CLIENT_VERSION, 2, EGL_NONE };
+        mContext = eglCreateContext(mDisplay, mConfig, EGL_NO_CONTEXT, contextAttribs);
+        if (mContext == EGL_NO_CONTEXT) {
+            fprintf(stderr, "Could not create an ES2 context (error 0x%x)\n", eglGetError());
+            return false;
+        }
+        if (!eglMakeCurrent(mDisplay, mSurface, mSurface, mContext)) {
+            fprintf(stderr, "eglMakeCurrent failed (error 0x%x)\n", eglGetError());
+            return false;
+        }
+        return true;
+    }
+
+    void HostEGLContext::destroy() {
+        if (mDisplay == EGL_NO_DISPLAY) {
+            return;
+        }
+        ScopedExternalCode driver;
+        eglMakeCurrent(mDisplay, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+        if (mContext != EGL_NO_CONTEXT) {
+            eglDestroyContext(mDisplay, mContext);
+        }
+        if (mSurface != EGL_NO_SURFACE) {
+            eglDestroySurface(mDisplay, mSurface);
+        }
+        eglTerminate(mDisplay);
+        mDisplay = EGL_NO_DISPLAY;
+        mSurface = EGL_NO_SURFACE;
+        mContext = EGL_NO_CONTEXT;
+    }
+
+    bool HostEGLContext::recreateSurface(int width, int height) {
+        ScopedExternalCode driver;
+        eglMakeCurrent(mDisplay, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+        eglDestroySurface(mDisplay, mSurface);
+        const EGLint surfaceAttribs[] = { EGL_WIDTH, width, EGL_HEIGHT, height, EGL_NONE };
+        mSurface = eglCreatePbufferSurface(mDisplay, mConfig, surfaceAttribs);
+        if (mSurface == EGL_NO_SURFACE) {
+            fprintf(stderr, "Could not create a %dx%d pbuffer (error 0x%x)\n", width, height, eglGetError());
+            return false;
+        }
+        return eglMakeCurrent(mDisplay, mSurface, mSurface, mContext) == EGL_TRUE;
+    }
+
+    bool HostEGLContext::recreateContext() {
+        ScopedExternalCode driver;
+        eglMakeCurrent(mDisplay, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+        eglDestroyContext(mDisplay, mContext);
+        const EGLint contextAttribs[] = { EGL_CONTEXT_CLIENT_VERSION, 2, EGL_NONE };
+        mContext = eglCreateContext(mDisplay, mConfig, EGL_NO_CONTEXT, contextAttribs);
+        if (mContext == EGL_NO_CONTEXT) {
+            fprintf(stderr, "Could not create an ES2 context (error 0x%x)\n", eglGetError());
+            return false;
+        }
+        return eglMakeCurrent(mDisplay, mSurface, mSurface, mContext) == EGL_TRUE;
+    }
+
+    bool HostEGLContext::swapBuffers() {
+        ScopedExternalCode driver;
+        return eglSwapBuffers(mDisplay, mSurface) == EGL_TRUE;
+    }
+}
@@ -0,0 +1,51 @@
+/*
+ * Copyright (C) 2015 Sensics, Inc. and contributors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef OSVROPENGL_HOST_HOSTEGL_H
+#define OSVROPENGL_HOST_HOSTEGL_H
+
+#include <EGL/egl.h>
+
+namespace OSVROpenGLHost {
+
+    // An offscreen OpenGL ES 2 context on a pbuffer surface. Uses the default
+    // EGL display when there is one and falls back to Mesa's surfaceless
+    // platform otherwise, so it works on a headless machine with llvmpipe.
+    class HostEGLContext {
+        EGLDisplay mDisplay;
+        EGLConfig mConfig;
+        EGLSurface mSurface;
+        EGLContext mContext;
+
+    public:
+        HostEGLContext();
+        ~HostEGLContext();
+
+        // Creates the context and makes it current on the calling thread.
+        bool create(int width, int height);
+        void destroy();
+        bool swapBuffers();
+
+        // For the lifecycle tests: a new surface for the same context, as
+        // after a pause that kept the context, and a new context for the same
+        // surface, as after one that lost it. Both leave them current.
+        bool recreateSurface(int width, int height);
+        bool recreateContext();
+    };
+}
+
+#endif // OSVROPENGL_HOST_HOSTEGL_H
@@ -0,0 +1,100 @@
+/*
+ * Copyright (C) 2015 Sensics, Inc. and contributors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include <cmath>
+
+#include "HostThermalModel.h"
+
+namespace OSVROpenGLHost {
+
+    using OSVROpenGL::QualityTier;
+    using OSVROpenGL::ThermalReading;
+
+    // Shares of tier 0's power: what no tier changes (display, sensors, the
+    // OSVR client), the GPU's eye buffers (with a little more for MSAA), the
+    // camera uploads and the scene update.
+    static const float kBasePower = 0.3f;
+    static const float kEyeBufferPower = 0.5f;
+    static const float kSamplePower = 0.05f;
+    static const float kCameraPower = 0.1f;
+    static const float kScenePower = 0.1f;
+
+    static float rawTierPower(int tier) {
+        const QualityTier &quality = OSVROpenGL::qualityTier(tier);
+        float eyeBuffers = kEyeBufferPower * quality.renderScale * quality.renderScale *
+                           (1.0f + kSamplePower * (quality.maxEyeBufferSamples - 1));
+        return kBasePower + eyeBuffers + kCameraPower / quality.cameraUploadInterval +
+               kScenePower / quality.sceneAnimationInterval;
+    }
+
+    void HostThermalModel::defaultParams(Params *paramsOut) {
+        paramsOut->ambientC = 25.0f;
+        paramsOut->startC = 35.0f;
+        paramsOut->fullPowerRiseC = 65.0f;
+        paramsOut->timeConstantSeconds = 400.0f;
+        paramsOut->statusStartC = 80.0f;
+        paramsOut->statusStepC = 4.0f;
+        paramsOut->noiseC = 0.3f;
+    }
+
+    float HostThermalModel::tierPower(int tier) {
+        return rawTierPower(tier) / rawTierPower(0);
+    }
+
+    HostThermalModel::HostThermalModel(const Params &params)
+        : secondsPerFrame(1.0), mParams(params), mTier(0), mSeconds(0.0), mNextReadingSeconds(0.0),
+          mTemperatureC(params.startC), mNoiseState(12345u) {
+    }
+
+    void HostThermalModel::advance(double seconds) {
+        float settledC = mParams.ambientC + mParams.fullPowerRiseC * tierPower(mTier);
+        // exact for a step in power, so the step size doesn't matter
+        mTemperatureC = settledC + (mTemperatureC - settledC) *
+                                   static_cast<float>(std::exp(-seconds / mParams.timeConstantSeconds));
+        mSeconds += seconds;
+    }
+
+    int HostThermalModel::status() const {
+        if (mTemperatureC < mParams.statusStartC) {
+            return OSVROpenGL::THERMAL_STATUS_NONE;
+        }
+        int status = OSVROpenGL::THERMAL_STATUS_LIGHT +
+                     static_cast<int>((mTemperatureC - mParams.statusStartC) / mParams.statusStepC);
+        return status < OSVROpenGL::THERMAL_STATUS_SHUTDOWN ? status : OSVROpenGL::THERMAL_STATUS_SHUTDOWN;
+    }
+
+    ThermalReading HostThermalModel::read() {
+        mNoiseState = mNoiseState * 1664525u + 1013904223u;
+        float noise = (static_cast<float>(mNoiseState >> 8) / 8388608.0f - 1.0f) * mParams.noiseC;
+        ThermalReading reading;
+        reading.timeNs = static_cast<uint64_t>(std::llround(mSeconds * 1.0e9));
+        reading.temperatureC = mTemperatureC + noise;
+        reading.status = status();
+        return reading;
+    }
+
+    bool HostThermalModel::source(void *userdata, ThermalReading *readingOut) {
+        HostThermalModel *model = static_cast<HostThermalModel *>(userdata);
+        model->advance(model->secondsPerFrame);
+        if (model->mSeconds < model->mNextReadingSeconds) {
+            return false;
+        }
+        model->mNextReadingSeconds = std::floor(model->mSeconds) + 1.0;
+        *readingOut = model->read();
+        return true;
+    }
+}
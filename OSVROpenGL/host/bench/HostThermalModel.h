@@ -0,0 +1,76 @@
+/*
+ * Copyright (C) 2015 Sensics, Inc. and contributors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef OSVROPENGL_HOST_HOSTTHERMALMODEL_H
+#define OSVROPENGL_HOST_HOSTTHERMALMODEL_H
+
+#include <cstdint>
+
+#include "ThermalGovernor.h"
+
+namespace OSVROpenGLHost {
+
+    // A phone's SoC as a single thermal mass, heated by the rendering and
+    // cooling toward the ambient temperature, for the thermal governor (see
+    // ThermalGovernor.h) to be run against on the host. The power drawn goes
+    // with the quality tier, from what the tier turns down; the thermal
+    // status follows the temperature in steps, the way a device's thermal
+    // HAL maps its sensors; and the sensor is read with a little noise.
+    class HostThermalModel {
+    public:
+        struct Params {
+            float ambientC;
+            float startC;
+            float fullPowerRiseC;       // above ambient, once settled at tier 0
+            float timeConstantSeconds;
+            float statusStartC;         // THERMAL_STATUS_LIGHT from here...
+            float statusStepC;          // ...and the next status every this much more
+            float noiseC;               // the sensor's, either way
+        };
+        static void defaultParams(Params *paramsOut);
+
+        // The power a tier draws, relative to tier 0's.
+        static float tierPower(int tier);
+
+        explicit HostThermalModel(const Params &params);
+
+        void setTier(int tier) { mTier = tier; }
+        void advance(double seconds);
+        OSVROpenGL::ThermalReading read();
+
+        double seconds() const { return mSeconds; }
+        float temperatureC() const { return mTemperatureC; }
+        int status() const;
+
+        // A ThermalSourceFunction for OSVROpenGL::setThermalSource(), taking
+        // userdata as a HostThermalModel: each call is one rendered frame,
+        // advancing the model by secondsPerFrame, and a reading is taken
+        // every simulated second.
+        static bool source(void *userdata, OSVROpenGL::ThermalReading *readingOut);
+        double secondsPerFrame;
+
+    private:
+        Params mParams;
+        int mTier;
+        double mSeconds;
+        double mNextReadingSeconds;
+        float mTemperatureC;
+        uint32_t mNoiseState;
+    };
+}
+
+#endif // OSVROPENGL_HOST_HOSTTHERMALMODEL_H
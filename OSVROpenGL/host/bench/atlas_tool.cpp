@@ -0,0 +1,441 @@
+/*
+ * Copyright (C) 2015 Sensics, Inc. and contributors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+// Builds material texture atlases (see TextureAtlas.h) offline, so the app
+// maps the packed pages instead of packing them at load:
+//
+//   atlas_tool --build out.atlas [--materials N] [--page-size S] [--padding P] [in.ktx...]
+//                      packs the KTX files' top levels (decoded from ETC1/ETC2
+//                      to RGBA), or else N of the made-up materials (default
+//                      16, see Materials.h), into pages of S x S texels
+//                      (default 1024, a power of two) with P texels of
+//                      padding (default 4)
+//   atlas_tool --info file.atlas...
+//                      checks files and prints their packing
+//   atlas_tool --remap-mesh in.mesh out.mesh file.atlas entry
+//                      takes a mesh's texture coordinates into the atlas
+//                      entry's rectangle, for a model drawn with the atlas
+//                      page bound and no per-draw texture transform
+//   atlas_tool --self-check
+//                      packs, fills, writes and maps atlases and remaps a
+//                      mesh, failing (exit status 3) if a rectangle leaves
+//                      its page or overlaps another, the padding isn't the
+//                      image's edge, or anything doesn't round-trip
+//
+// renderer_bench --materials N --material-atlas file draws with one.
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <unistd.h>
+
+#include "Asset.h"
+#include "CompressedTexture.h"
+#include "Materials.h"
+#include "SceneMesh.h"
+#include "TextureAtlas.h"
+
+namespace OSVROpenGLHost {
+
+    using OSVROpenGL::TextureAtlasImage;
+    using OSVROpenGL::TextureAtlasRect;
+
+    static int gFailures = 0;
+
+    static void check(bool ok, const char *what) {
+        printf("  %-72s %s\n", what, ok ? "ok" : "FAILED");
+        if (!ok) {
+            gFailures++;
+        }
+    }
+
+    static double msSince(std::chrono::steady_clock::time_point start) {
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    // A KTX file's top level as RGBA.
+    static bool loadKtxImage(const char *path, std::vector<uint8_t> *rgbaOut, uint32_t *widthOut,
+                             uint32_t *heightOut) {
+        OSVROpenGL::MappedAsset file;
+        if (!OSVROpenGL::mapAsset(path, &file)) {
+            fprintf(stderr, "atlas_tool: could not open %s\n", path);
+            return false;
+        }
+        OSVROpenGL::KtxImage image;
+        bool ok = OSVROpenGL::parseKtx(file.data, file.bytes, &image);
+        if (ok && !OSVROpenGL::canDecodeCompressedFormat(image.format->glInternalFormat)) {
+            fprintf(stderr, "atlas_tool: %s is %s, which has no CPU decoder\n", path, image.format->name);
+            ok = false;
+        }
+        if (ok) {
+            rgbaOut->resize(static_cast<size_t>(image.width) * image.height * 4);
+            ok = OSVROpenGL::decodeCompressedImage(*image.format, image.levels[0].data, image.width, image.height,
+                                                   rgbaOut->data());
+            *widthOut = image.width;
+            *heightOut = image.height;
+        } else {
+            fprintf(stderr, "atlas_tool: could not read %s\n", path);
+        }
+        OSVROpenGL::unmapAsset(&file);
+        return ok;
+    }
+
+    static void printAtlas(const char *path, uint32_t pageSize, uint32_t pageCount, uint32_t padding,
+                           const TextureAtlasRect *rects, uint32_t count, size_t fileBytes, double ms,
+                           const char *verb) {
+        printf("%s: %u images in %u pages of %ux%u (padding %u), %.1f%% occupied, %.1f KB, %s in %.3f ms\n", path,
+               count, pageCount, pageSize, pageSize, padding,
+               OSVROpenGL::textureAtlasOccupancy(rects, count, pageSize, pageCount) * 100.0f, fileBytes / 1024.0,
+               verb, ms);
+    }
+
+    static int buildAtlas(const char *path, uint32_t materials, uint32_t pageSize, uint32_t padding,
+                          int inputCount, char **inputs) {
+        uint32_t count = inputCount ? static_cast<uint32_t>(inputCount) : materials;
+        std::vector<std::vector<uint8_t> > pixels(count);
+        std::vector<TextureAtlasImage> images(count);
+        for (uint32_t i = 0; i < count; i++) {
+            if (inputCount) {
+                if (!loadKtxImage(inputs[i], &pixels[i], &images[i].width, &images[i].height)) {
+                    return 1;
+                }
+            } else {
+                OSVROpenGL::makeMaterialImage(i, &pixels[i], &images[i].width, &images[i].height);
+            }
+            images[i].rgba = pixels[i].data();
+        }
+
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        std::vector<TextureAtlasRect> rects;
+        uint32_t pageCount;
+        if (!OSVROpenGL::packTextureAtlas(images.data(), count, pageSize, padding, &rects, &pageCount)) {
+            return 1;
+        }
+        std::vector<uint8_t> pages;
+        OSVROpenGL::fillTextureAtlasPages(images.data(), count, rects.data(), pageSize, pageCount, padding, &pages);
+        double packMs = msSince(start);
+        if (!OSVROpenGL::writeTextureAtlasFile(path, pageSize, pageCount, padding, rects, pages)) {
+            return 1;
+        }
+        OSVROpenGL::MappedTextureAtlas atlas;
+        if (!OSVROpenGL::mapTextureAtlasFile(path, &atlas)) {
+            return 1;
+        }
+        printAtlas(path, pageSize, pageCount, padding, rects.data(), count, atlas.file.bytes, packMs, "packed");
+        OSVROpenGL::unmapTextureAtlasFile(&atlas);
+        return 0;
+    }
+
+    static int describeFiles(int count, char **paths) {
+        int failures = 0;
+        for (int i = 0; i < count; i++) {
+            std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+            OSVROpenGL::MappedTextureAtlas atlas;
+            if (!OSVROpenGL::mapTextureAtlasFile(paths[i], &atlas)) {
+                printf("%s: INVALID\n", paths[i]);
+                failures++;
+                continue;
+            }
+            const OSVROpenGL::TextureAtlasFileHeader &header = *atlas.header;
+            printAtlas(paths[i], header.pageSize, header.pageCount, header.padding, atlas.entries,
+                       header.entryCount, atlas.file.bytes, msSince(start), "mapped");
+            OSVROpenGL::unmapTextureAtlasFile(&atlas);
+        }
+        return failures ? 3 : 0;
+    }
+
+    // Rewrites the mesh with its texture coordinates in the entry's rectangle.
+    static bool remapMesh(const char *inPath, const char *outPath, const OSVROpenGL::MappedTextureAtlas &atlas,
+                          uint32_t entry) {
+        if (entry >= atlas.header->entryCount) {
+            fprintf(stderr, "atlas_tool: the atlas has %u entries\n", atlas.header->entryCount);
+            return false;
+        }
+        OSVROpenGL::MappedSceneMesh mesh;
+        if (!OSVROpenGL::mapSceneMeshFile(inPath, &mesh)) {
+            return false;
+        }
+        const OSVROpenGL::SceneMeshFileHeader &header = *mesh.header;
+        std::vector<OSVROpenGL::SceneMeshVertex> vertices(mesh.vertices, mesh.vertices + header.vertexCount);
+        std::vector<uint32_t> indices(header.indexCount);
+        for (uint32_t i = 0; i < header.indexCount; i++) {
+            indices[i] = header.indexSize == 2 ? static_cast<const uint16_t *>(mesh.indices)[i]
+                                               : static_cast<const uint32_t *>(mesh.indices)[i];
+        }
+        float transform[4];
+        OSVROpenGL::textureAtlasUVTransform(atlas.entries[entry], atlas.header->pageSize, atlas.header->pageSize,
+                                            transform);
+        OSVROpenGL::transformSceneMeshUVs(vertices.data(), vertices.size(), transform);
+        bool ok = OSVROpenGL::writeSceneMeshFile(outPath, header.positionScale, header.positionOffset, vertices,
+                                                 indices);
+        OSVROpenGL::unmapSceneMeshFile(&mesh);
+        return ok;
+    }
+
+    static int remapMeshFile(const char *inPath, const char *outPath, const char *atlasPath, const char *entry) {
+        OSVROpenGL::MappedTextureAtlas atlas;
+        if (!OSVROpenGL::mapTextureAtlasFile(atlasPath, &atlas)) {
+            return 1;
+        }
+        bool ok = remapMesh(inPath, outPath, atlas, static_cast<uint32_t>(atoi(entry)));
+        if (ok) {
+            const TextureAtlasRect &rect = atlas.entries[atoi(entry)];
+            printf("%s: texture coordinates in page %u at %u,%u (%ux%u)\n", outPath, rect.page, rect.x, rect.y,
+                   rect.width, rect.height);
+        }
+        OSVROpenGL::unmapTextureAtlasFile(&atlas);
+        return ok ? 0 : 1;
+    }
+
+    static bool overlaps(const TextureAtlasRect &a, const TextureAtlasRect &b, uint32_t padding) {
+        return a.page == b.page &&
+               a.x < b.x + b.width + 2 * padding && b.x < a.x + a.width + 2 * padding &&
+               a.y < b.y + b.height + 2 * padding && b.y < a.y + a.height + 2 * padding;
+    }
+
+    static const uint8_t *texel(const std::vector<uint8_t> &pixels, uint32_t pageSize, uint32_t page, uint32_t x,
+                                uint32_t y) {
+        return &pixels[((static_cast<size_t>(page) * pageSize + y) * pageSize + x) * 4];
+    }
+
+    static std::string tempPath(const char *suffix) {
+        char path[] = "/tmp/atlas_toolXXXXXX";
+        int fd = mkstemp(path);
+        if (fd >= 0) {
+            close(fd);
+            unlink(path);
+        }
+        return std::string(path) + suffix;
+    }
+
+    static int selfCheck() {
+        printf("skyline packer:\n");
+        OSVROpenGL::SkylinePacker packer;
+        packer.reset(64, 64);
+        uint32_t x, y;
+        bool placed = packer.insert(32, 16, &x, &y) && x == 0 && y == 0;
+        placed = placed && packer.insert(32, 32, &x, &y) && x == 32 && y == 0;
+        placed = placed && packer.insert(32, 16, &x, &y) && x == 0 && y == 16;
+        check(placed, "places bottom-left first, lowest then leftmost");
+        check(packer.segmentCount() == 1 && packer.usedArea() == 32 * 16 * 2 + 32 * 32,
+              "merges the skyline back into one segment at the same height");
+        check(!packer.insert(65, 1, &x, &y) && !packer.insert(1, 33, &x, &y) && packer.segmentCount() == 1,
+              "rejects what doesn't fit, and changes nothing");
+        check(packer.insert(64, 32, &x, &y) && x == 0 && y == 32 && !packer.insert(1, 1, &x, &y),
+              "fills the page exactly, then takes nothing more");
+
+        printf("atlas packing:\n");
+        const uint32_t count = 40;
+        const uint32_t pageSize = 256;
+        const uint32_t padding = 4;
+        std::vector<std::vector<uint8_t> > pixels(count);
+        std::vector<TextureAtlasImage> images(count);
+        for (uint32_t i = 0; i < count; i++) {
+            OSVROpenGL::makeMaterialImage(i, &pixels[i], &images[i].width, &images[i].height);
+            images[i].rgba = pixels[i].data();
+        }
+        std::vector<TextureAtlasRect> rects;
+        uint32_t pageCount = 0;
+        bool packed = OSVROpenGL::packTextureAtlas(images.data(), count, pageSize, padding, &rects, &pageCount);
+        check(packed && rects.size() == count && pageCount >= 1, "packs the made-up materials");
+        bool inside = packed;
+        bool apart = packed;
+        for (uint32_t i = 0; packed && i < count; i++) {
+            const TextureAtlasRect &rect = rects[i];
+            inside = inside && rect.page < pageCount && rect.width == images[i].width &&
+                     rect.height == images[i].height && rect.x >= padding && rect.y >= padding &&
+                     rect.x + rect.width + padding <= pageSize && rect.y + rect.height + padding <= pageSize &&
+                     (rect.x - padding) % OSVROpenGL::kTextureAtlasAlignment == 0 &&
+                     (rect.y - padding) % OSVROpenGL::kTextureAtlasAlignment == 0;
+            for (uint32_t j = 0; j < i; j++) {
+                apart = apart && !overlaps(rect, rects[j], padding);
+            }
+        }
+        check(inside, "keeps every image and its padding aligned inside its page");
+        check(apart, "never overlaps two images' padded rectangles");
+        float occupancy = OSVROpenGL::textureAtlasOccupancy(rects.data(), count, pageSize, pageCount);
+        uint64_t imageTexels = 0;
+        for (uint32_t i = 0; i < count; i++) {
+            imageTexels += static_cast<uint64_t>(images[i].width) * images[i].height;
+        }
+        check(std::fabs(occupancy - static_cast<float>(imageTexels) / (pageSize * pageSize * pageCount)) < 1e-6f &&
+              occupancy > 0.5f, "fills more than half the pages");
+        std::vector<TextureAtlasRect> unused;
+        uint32_t unusedPages;
+        TextureAtlasImage tooBig = { pixels[0].data(), pageSize, 16 };
+        check(!OSVROpenGL::packTextureAtlas(&tooBig, 1, pageSize, padding, &unused, &unusedPages),
+              "rejects an image that can't fit a page with its padding");
+
+        printf("atlas pages:\n");
+        std::vector<uint8_t> pages;
+        OSVROpenGL::fillTextureAtlasPages(images.data(), count, rects.data(), pageSize, pageCount, padding, &pages);
+        bool copied = packed;
+        bool padded = packed;
+        for (uint32_t i = 0; packed && i < count; i++) {
+            const TextureAtlasRect &rect = rects[i];
+            const TextureAtlasImage &image = images[i];
+            for (uint32_t row = 0; row < image.height; row++) {
+                copied = copied && !memcmp(texel(pages, pageSize, rect.page, rect.x, rect.y + row),
+                                           image.rgba + static_cast<size_t>(row) * image.width * 4,
+                                           image.width * 4);
+            }
+            // the padding repeats the nearest edge texel, corners included
+            for (uint32_t p = 1; p <= padding; p++) {
+                uint32_t right = rect.x + rect.width - 1;
+                uint32_t top = rect.y + rect.height - 1;
+                padded = padded &&
+                         !memcmp(texel(pages, pageSize, rect.page, rect.x - p, rect.y),
+                                 texel(pages, pageSize, rect.page, rect.x, rect.y), 4) &&
+                         !memcmp(texel(pages, pageSize, rect.page, right + p, top),
+                                 texel(pages, pageSize, rect.page, right, top), 4) &&
+                         !memcmp(texel(pages, pageSize, rect.page, rect.x - p, top + p),
+                                 texel(pages, pageSize, rect.page, rect.x, top), 4) &&
+                         !memcmp(texel(pages, pageSize, rect.page, right, rect.y - p),
+                                 texel(pages, pageSize, rect.page, right, rect.y), 4);
+            }
+        }
+        check(copied, "copies every image to its rectangle");
+        check(padded, "pads every image with its edge texels");
+        float transform[4];
+        TextureAtlasRect rect = { 0, 64, 32, 16, 128 };
+        OSVROpenGL::textureAtlasUVTransform(rect, 256, 256, transform);
+        check(transform[0] == 0.0625f && transform[1] == 0.5f && transform[2] == 0.25f && transform[3] == 0.125f,
+              "takes [0,1] texture coordinates to the rectangle");
+
+        printf("atlas files:\n");
+        std::string atlasPath = tempPath(".atlas");
+        bool written = OSVROpenGL::writeTextureAtlasFile(atlasPath.c_str(), pageSize, pageCount, padding, rects,
+                                                         pages);
+        OSVROpenGL::MappedTextureAtlas atlas;
+        bool mapped = written && OSVROpenGL::mapTextureAtlasFile(atlasPath.c_str(), &atlas);
+        check(mapped && atlas.header->pageSize == pageSize && atlas.header->pageCount == pageCount &&
+              atlas.header->entryCount == count && atlas.header->padding == padding &&
+              !memcmp(atlas.entries, rects.data(), count * sizeof(TextureAtlasRect)) &&
+              !memcmp(atlas.pixels, pages.data(), pages.size()) &&
+              reinterpret_cast<uintptr_t>(atlas.pixels) % OSVROpenGL::kTextureAtlasFileAlignment == 0,
+              "writes and maps back the same packing and pages, page-aligned");
+
+        std::string meshPath = tempPath(".mesh");
+        std::string remappedPath = tempPath(".mesh");
+        std::vector<OSVROpenGL::SceneMeshVertex> vertices(3);
+        memset(vertices.data(), 0, vertices.size() * sizeof(vertices[0]));
+        const float uvs[3][2] = { { 0.0f, 0.0f }, { 1.0f, 0.0f }, { 0.5f, 1.0f } };
+        for (int i = 0; i < 3; i++) {
+            vertices[i].uv[0] = OSVROpenGL::floatToHalf(uvs[i][0]);
+            vertices[i].uv[1] = OSVROpenGL::floatToHalf(uvs[i][1]);
+        }
+        const std::vector<uint32_t> indices = { 0, 1, 2 };
+        const float scale[3] = { 1.0f, 1.0f, 1.0f };
+        const float offset[3] = { 0.0f, 0.0f, 0.0f };
+        bool remapped = mapped && OSVROpenGL::writeSceneMeshFile(meshPath.c_str(), scale, offset, vertices, indices) &&
+                        remapMesh(meshPath.c_str(), remappedPath.c_str(), atlas, 5);
+        OSVROpenGL::MappedSceneMesh mesh;
+        if (remapped && OSVROpenGL::mapSceneMeshFile(remappedPath.c_str(), &mesh)) {
+            float expected[4];
+            OSVROpenGL::textureAtlasUVTransform(rects[5], pageSize, pageSize, expected);
+            for (int i = 0; i < 3; i++) {
+                for (int axis = 0; axis < 2; axis++) {
+                    float uv = OSVROpenGL::halfToFloat(mesh.vertices[i].uv[axis]);
+                    float want = uvs[i][axis] * expected[axis] + expected[2 + axis];
+                    remapped = remapped && std::fabs(uv - want) <= want / 1024.0f + 1e-6f;
+                }
+            }
+            remapped = remapped && mesh.header->indexCount == 3;
+            OSVROpenGL::unmapSceneMeshFile(&mesh);
+        } else {
+            remapped = false;
+        }
+        check(remapped, "remaps a mesh's texture coordinates into an entry's rectangle");
+        if (mapped) {
+            OSVROpenGL::unmapTextureAtlasFile(&atlas);
+        }
+
+        FILE *file = fopen(atlasPath.c_str(), "r+b");
+        if (file) {
+            fseek(file, offsetof(OSVROpenGL::TextureAtlasFileHeader, pageSize), SEEK_SET);
+            uint32_t hugePage = OSVROpenGL::kTextureAtlasMaxPageSize * 2;
+            fwrite(&hugePage, sizeof(hugePage), 1, file);
+            fclose(file);
+        }
+        check(file && !OSVROpenGL::mapTextureAtlasFile(atlasPath.c_str(), &atlas), "rejects a damaged header");
+        unlink(atlasPath.c_str());
+        unlink(meshPath.c_str());
+        unlink(remappedPath.c_str());
+
+        if (gFailures) {
+            printf("%d checks FAILED\n", gFailures);
+            return 3;
+        }
+        printf("all checks passed\n");
+        return 0;
+    }
+
+    static void printUsage(const char *argv0) {
+        fprintf(stderr,
+                "usage: %s --build out.atlas [--materials N] [--page-size S] [--padding P] [in.ktx...]\n"
+                "       %s --info file.atlas...\n"
+                "       %s --remap-mesh in.mesh out.mesh file.atlas entry\n"
+                "       %s --self-check\n",
+                argv0, argv0, argv0, argv0);
+    }
+}
+
+int main(int argc, char **argv) {
+    OSVROpenGL::setAssetDirectory(OSVROPENGL_ASSET_DIR);
+    if (argc == 2 && !strcmp(argv[1], "--self-check")) {
+        return OSVROpenGLHost::selfCheck();
+    }
+    if (argc >= 3 && !strcmp(argv[1], "--info")) {
+        return OSVROpenGLHost::describeFiles(argc - 2, argv + 2);
+    }
+    if (argc == 6 && !strcmp(argv[1], "--remap-mesh")) {
+        return OSVROpenGLHost::remapMeshFile(argv[2], argv[3], argv[4], argv[5]);
+    }
+    if (argc >= 3 && !strcmp(argv[1], "--build")) {
+        int materials = 16;
+        int pageSize = 1024;
+        int padding = 4;
+        int i = 3;
+        for (; i + 1 < argc && argv[i][0] == '-'; i += 2) {
+            if (!strcmp(argv[i], "--materials")) {
+                materials = atoi(argv[i + 1]);
+            } else if (!strcmp(argv[i], "--page-size")) {
+                pageSize = atoi(argv[i + 1]);
+            } else if (!strcmp(argv[i], "--padding")) {
+                padding = atoi(argv[i + 1]);
+            } else {
+                break;
+            }
+        }
+        bool valid = materials > 0 && pageSize > 0 && (pageSize & (pageSize - 1)) == 0 &&
+                     pageSize <= static_cast<int>(OSVROpenGL::kTextureAtlasMaxPageSize) && padding >= 0 &&
+                     (i == argc || argv[i][0] != '-');
+        if (valid) {
+            return OSVROpenGLHost::buildAtlas(argv[2], static_cast<uint32_t>(materials),
+                                              static_cast<uint32_t>(pageSize), static_cast<uint32_t>(padding),
+                                              argc - i, argv + i);
+        }
+    }
+    OSVROpenGLHost::printUsage(argv[0]);
+    return 2;
+}
@@ -0,0 +1,357 @@
+/*
+ * Copyright (C) 2015 Sensics, Inc. and contributors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+// Checks the SIMD variants of the kernels in CpuDispatch.h against the scalar
+// ones, and times them:
+//
+//   cpu_kernel_tool                times each kernel at every level this CPU
+//                                  supports, on the scene_bench scene and a
+//                                  camera frame
+//   cpu_kernel_tool --self-check   runs every supported level on the same
+//                                  inputs (with odd counts, so the SIMD loops'
+//                                  tails run too) and fails (exit status 3)
+//                                  unless each gives the scalar results
+//
+// Pixels must match exactly. Matrices may differ by rounding, and a sphere's
+// visibility only where it touches a plane to within rounding: a compiler is
+// free to fuse the scalar code's multiplies and adds.
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#include "CpuDispatch.h"
+#include "Scene.h"
+
+namespace OSVROpenGLHost {
+
+    using OSVROpenGL::BoundingSphere;
+    using OSVROpenGL::CpuKernelLevel;
+    using OSVROpenGL::CpuKernels;
+    using OSVROpenGL::SpinningObject;
+
+    static uint32_t nextRandom(uint32_t *state) {
+        *state = *state * 1664525u + 1013904223u;
+        return *state;
+    }
+
+    static float randomRange(uint32_t *state, float low, float high) {
+        return low + (high - low) * static_cast<float>(nextRandom(state) >> 8) / 16777216.0f;
+    }
+
+    static void randomUnitVector(uint32_t *state, float *out) {
+        float z = randomRange(state, -1.0f, 1.0f);
+        float azimuth = randomRange(state, 0.0f, 6.2831853f);
+        float ring = std::sqrt(1.0f - z * z);
+        out[0] = ring * std::cos(azimuth);
+        out[1] = ring * std::sin(azimuth);
+        out[2] = z;
+    }
+
+    // Spinning cubes like the scene's; every 16th spins about z at scale 1, so
+    // its model matrix starts cos, sin.
+    static std::vector<SpinningObject> makeObjects(uint32_t count) {
+        std::vector<SpinningObject> objects(count);
+        uint32_t random = 0x2545f491u;
+        for (uint32_t i = 0; i < count; i++) {
+            SpinningObject &object = objects[i];
+            randomUnitVector(&random, object.position);
+            float distance = randomRange(&random, 0.4f, 0.9f);
+            for (int k = 0; k < 3; k++) {
+                object.position[k] *= distance;
+            }
+            object.scale = randomRange(&random, 0.01f, 0.04f);
+            randomUnitVector(&random, object.axis);
+            object.angularSpeed = randomRange(&random, -3.0f, 3.0f);
+            if (i % 16 == 0) {
+                object.scale = 1.0f;
+                object.axis[0] = 0.0f;
+                object.axis[1] = 0.0f;
+                object.axis[2] = 1.0f;
+            }
+        }
+        return objects;
+    }
+
+    // viewCount frusta of a head at the origin: 90 degree symmetric, from 0.1m
+    // to 100m, each turned further, as normalized planes.
+    static void makePlanes(uint32_t viewCount, float planes[][6][4]) {
+        for (uint32_t view = 0; view < viewCount; view++) {
+            float yaw = 0.7f * view;
+            float c = std::cos(yaw);
+            float s = std::sin(yaw);
+            // forward is -z turned by yaw; the side planes lean in at 45 degrees
+            float forward[3] = {-s, 0.0f, -c};
+            float right[3] = {c, 0.0f, -s};
+            float up[3] = {0.0f, 1.0f, 0.0f};
+            const float h = 0.70710678f;
+            float normals[6][3];
+            for (int k = 0; k < 3; k++) {
+                normals[0][k] = h * (forward[k] + right[k]);     // left
+                normals[1][k] = h * (forward[k] - right[k]);     // right
+                normals[2][k] = h * (forward[k] + up[k]);        // bottom
+                normals[3][k] = h * (forward[k] - up[k]);        // top
+                normals[4][k] = forward[k];                      // near
+                normals[5][k] = -forward[k];                     // far
+            }
+            for (int plane = 0; plane < 6; plane++) {
+                for (int k = 0; k < 3; k++) {
+                    planes[view][plane][k] = normals[plane][k];
+                }
+                planes[view][plane][3] = plane == 4 ? -0.1f : (plane == 5 ? 100.0f : 0.0f);
+            }
+        }
+    }
+
+    // Spheres around the frusta's edges, so plenty straddle a plane.
+    static std::vector<BoundingSphere> makeSpheres(uint32_t count) {
+        std::vector<BoundingSphere> spheres(count);
+        uint32_t random = 0x9e3779b9u;
+        for (uint32_t i = 0; i < count; i++) {
+            randomUnitVector(&random, spheres[i].center);
+            float distance = randomRange(&random, 0.05f, 2.0f);
+            for (int k = 0; k < 3; k++) {
+                spheres[i].center[k] *= distance;
+            }
+            spheres[i].radius = randomRange(&random, 0.0f, 0.1f);
+        }
+        return spheres;
+    }
+
+    static std::vector<uint8_t> makePixels(uint32_t bytes) {
+        std::vector<uint8_t> pixels(bytes);
+        uint32_t random = 0x12345678u;
+        for (uint32_t i = 0; i < bytes; i++) {
+            pixels[i] = static_cast<uint8_t>(nextRandom(&random) >> 24);
+        }
+        return pixels;
+    }
+
+    static const CpuKernels &kernelsAt(CpuKernelLevel level) {
+        OSVROpenGL::setCpuKernelLevel(level);
+        return OSVROpenGL::cpuKernels();
+    }
+
+    static bool checkAnimation(CpuKernelLevel level, double *maxErrorOut) {
+        static const uint32_t kCount = 1003;
+        static const float kTimes[] = {0.0f, 0.37f, 12.5f, 200.0f};
+        std::vector<SpinningObject> objects = makeObjects(kCount);
+        std::vector<float> expected(kCount * 16), models(kCount * 16);
+        std::vector<BoundingSphere> expectedBounds(kCount), bounds(kCount);
+        bool ok = true;
+        *maxErrorOut = 0.0;
+        for (size_t t = 0; t < sizeof(kTimes) / sizeof(kTimes[0]); t++) {
+            kernelsAt(OSVROpenGL::CPU_KERNELS_SCALAR).animateSpinningObjects(
+                    objects.data(), kCount, kTimes[t], expected.data(), expectedBounds.data());
+            kernelsAt(level).animateSpinningObjects(objects.data(), kCount, kTimes[t], models.data(), bounds.data());
+            for (uint32_t i = 0; i < kCount * 16; i++) {
+                double error = std::fabs(static_cast<double>(models[i]) - expected[i]);
+                ok = ok && error <= 1.0e-6 * (1.0 + std::fabs(expected[i]));
+            }
+            for (uint32_t i = 0; i < kCount; i++) {
+                for (int k = 0; k < 3; k++) {
+                    ok = ok && bounds[i].center[k] == expectedBounds[i].center[k];
+                }
+                ok = ok && std::fabs(bounds[i].radius - expectedBounds[i].radius) <= 1.0e-6f * bounds[i].radius;
+            }
+            // the z-axis cubes' sin and cos against the exact ones
+            for (uint32_t i = 0; i < kCount; i += 16) {
+                double angle = static_cast<double>(objects[i].angularSpeed * kTimes[t]);
+                double error = std::fmax(std::fabs(models[i * 16] - std::cos(angle)),
+                                         std::fabs(models[i * 16 + 1] - std::sin(angle)));
+                *maxErrorOut = std::fmax(*maxErrorOut, error);
+            }
+        }
+        return ok && *maxErrorOut < 2.0e-6;
+    }
+
+    static bool checkCulling(CpuKernelLevel level, uint32_t *visibleOut) {
+        static const uint32_t kCount = 1001;
+        std::vector<BoundingSphere> spheres = makeSpheres(kCount);
+        float planes[OSVROpenGL::kSceneMaxViews][6][4];
+        makePlanes(OSVROpenGL::kSceneMaxViews, planes);
+        bool ok = true;
+        *visibleOut = 0;
+        for (uint32_t viewCount = 1; viewCount <= 4; viewCount++) {
+            std::vector<uint8_t> expected(kCount), visibility(kCount, 0xff);
+            uint32_t expectedCounts[4] = {0, 0, 0, 0}, counts[4] = {0, 0, 0, 0};
+            kernelsAt(OSVROpenGL::CPU_KERNELS_SCALAR).cullSpheres(spheres.data(), kCount, planes, viewCount,
+                                                                 expected.data(), expectedCounts);
+            kernelsAt(level).cullSpheres(spheres.data(), kCount, planes, viewCount, visibility.data(), counts);
+            uint32_t fromBits[4] = {0, 0, 0, 0};
+            for (uint32_t i = 0; i < kCount; i++) {
+                for (uint32_t view = 0; view < viewCount; view++) {
+                    fromBits[view] += (visibility[i] >> view) & 1u;
+                    if (((visibility[i] ^ expected[i]) >> view) & 1u) {
+                        // fine only if the sphere touches a plane to within rounding
+                        double closest = 1.0e30;
+                        for (int plane = 0; plane < 6; plane++) {
+                            const float *p = planes[view][plane];
+                            double distance = static_cast<double>(p[0]) * spheres[i].center[0] +
+                                              static_cast<double>(p[1]) * spheres[i].center[1] +
+                                              static_cast<double>(p[2]) * spheres[i].center[2] + p[3] +
+                                              spheres[i].radius;
+                            closest = std::fmin(closest, std::fabs(distance));
+                        }
+                        ok = ok && closest < 1.0e-5;
+                    }
+                }
+                ok = ok && (visibility[i] >> viewCount) == 0;
+            }
+            for (uint32_t view = 0; view < viewCount; view++) {
+                ok = ok && counts[view] == fromBits[view];
+                *visibleOut += expectedCounts[view];
+            }
+        }
+        return ok;
+    }
+
+    static bool checkExpansion(CpuKernelLevel level) {
+        static const uint32_t kPixelCounts[] = {0, 1, 5, 10, 11, 15, 16, 17, 33, 1000, 4097};
+        static const uint32_t kChannels[] = {1, 3, 4};
+        bool ok = true;
+        for (size_t c = 0; c < sizeof(kChannels) / sizeof(kChannels[0]); c++) {
+            for (size_t n = 0; n < sizeof(kPixelCounts) / sizeof(kPixelCounts[0]); n++) {
+                uint32_t channels = kChannels[c];
+                uint32_t count = kPixelCounts[n];
+                std::vector<uint8_t> pixels = makePixels(count * channels);
+                // a guard past the end, which nothing may write
+                std::vector<uint8_t> expected(count * 4 + 64, 0xa5), rgba(count * 4 + 64, 0xa5);
+                kernelsAt(OSVROpenGL::CPU_KERNELS_SCALAR).expandToRGBA(pixels.data(), count, channels,
+                                                                      expected.data());
+                kernelsAt(level).expandToRGBA(pixels.data(), count, channels, rgba.data());
+                ok = ok && rgba == expected;
+            }
+        }
+        return ok;
+    }
+
+    static int selfCheck() {
+        int failures = 0;
+        printf("%-8s %-24s %-18s %s\n", "level", "animation (max error)", "culling", "pixels");
+        for (int level = 0; level < OSVROpenGL::CPU_KERNEL_LEVEL_COUNT; level++) {
+            CpuKernelLevel kernelLevel = static_cast<CpuKernelLevel>(level);
+            if (!OSVROpenGL::cpuKernelLevelSupported(kernelLevel)) {
+                printf("%-8s not supported here\n", OSVROpenGL::cpuKernelLevelName(kernelLevel));
+                continue;
+            }
+            double maxError;
+            uint32_t visible;
+            bool animationOk = checkAnimation(kernelLevel, &maxError);
+            bool cullingOk = checkCulling(kernelLevel, &visible);
+            bool pixelsOk = checkExpansion(kernelLevel);
+            char animation[32];
+            snprintf(animation, sizeof(animation), "%s (%.1e)", animationOk ? "ok" : "FAILED", maxError);
+            char culling[32];
+            snprintf(culling, sizeof(culling), "%s (%u visible)", cullingOk ? "ok" : "FAILED", visible);
+            printf("%-8s %-24s %-18s %s\n", OSVROpenGL::cpuKernelLevelName(kernelLevel), animation, culling,
+                   pixelsOk ? "ok" : "FAILED");
+            failures += (animationOk ? 0 : 1) + (cullingOk ? 0 : 1) + (pixelsOk ? 0 : 1);
+        }
+        if (failures) {
+            printf("self-check FAILED: %d kernels differ from the scalar ones\n", failures);
+            return 3;
+        }
+        printf("self-check passed\n");
+        return 0;
+    }
+
+    // Best of five runs of repeats calls, per call.
+    template <typename Function>
+    static double timeUs(int repeats, Function function) {
+        double best = 1.0e30;
+        for (int run = 0; run < 5; run++) {
+            auto start = std::chrono::steady_clock::now();
+            for (int i = 0; i < repeats; i++) {
+                function(i);
+            }
+            std::chrono::duration<double, std::micro> elapsed = std::chrono::steady_clock::now() - start;
+            best = std::fmin(best, elapsed.count() / repeats);
+        }
+        return best;
+    }
+
+    static int timeKernels() {
+        static const uint32_t kObjects = 10000;
+        static const uint32_t kCameraPixels = 640 * 480;
+        std::vector<SpinningObject> objects = makeObjects(kObjects);
+        std::vector<float> models(kObjects * 16);
+        std::vector<BoundingSphere> bounds(kObjects);
+        std::vector<uint8_t> visibility(kObjects);
+        float planes[2][6][4];
+        makePlanes(2, planes);
+        std::vector<uint8_t> pixels = makePixels(kCameraPixels * 3);
+        std::vector<uint8_t> rgba(kCameraPixels * 4);
+
+        const char *names[] = {"animate 10k objects", "cull 10k spheres x 2 eyes", "640x480 grey to RGBA",
+                               "640x480 RGB to RGBA"};
+        double times[OSVROpenGL::CPU_KERNEL_LEVEL_COUNT][4];
+        bool supported[OSVROpenGL::CPU_KERNEL_LEVEL_COUNT];
+        printf("cpu_kernel_tool: microseconds per call, best of 5\n\n%-28s", "kernel");
+        for (int level = 0; level < OSVROpenGL::CPU_KERNEL_LEVEL_COUNT; level++) {
+            CpuKernelLevel kernelLevel = static_cast<CpuKernelLevel>(level);
+            supported[level] = OSVROpenGL::cpuKernelLevelSupported(kernelLevel);
+            if (!supported[level]) {
+                continue;
+            }
+            printf(" %18s", OSVROpenGL::cpuKernelLevelName(kernelLevel));
+            const CpuKernels &kernels = kernelsAt(kernelLevel);
+            times[level][0] = timeUs(200, [&](int i) {
+                kernels.animateSpinningObjects(objects.data(), kObjects, i / 60.0f, models.data(), bounds.data());
+            });
+            times[level][1] = timeUs(200, [&](int) {
+                uint32_t counts[2] = {0, 0};
+                kernels.cullSpheres(bounds.data(), kObjects, planes, 2, visibility.data(), counts);
+            });
+            times[level][2] = timeUs(100, [&](int) {
+                kernels.expandToRGBA(pixels.data(), kCameraPixels, 1, rgba.data());
+            });
+            times[level][3] = timeUs(100, [&](int) {
+                kernels.expandToRGBA(pixels.data(), kCameraPixels, 3, rgba.data());
+            });
+        }
+        printf("\n");
+        for (int kernel = 0; kernel < 4; kernel++) {
+            printf("%-28s", names[kernel]);
+            for (int level = 0; level < OSVROpenGL::CPU_KERNEL_LEVEL_COUNT; level++) {
+                if (supported[level]) {
+                    printf(" %9.1f (%5.2fx)", times[level][kernel], times[0][kernel] / times[level][kernel]);
+                }
+            }
+            printf("\n");
+        }
+        return 0;
+    }
+
+    static void printUsage(const char *argv0) {
+        fprintf(stderr, "usage: %s [--self-check]\n", argv0);
+    }
+}
+
+int main(int argc, char **argv) {
+    if (argc == 2 && !strcmp(argv[1], "--self-check")) {
+        return OSVROpenGLHost::selfCheck();
+    }
+    if (argc != 1) {
+        OSVROpenGLHost::printUsage(argv[0]);
+        return 2;
+    }
+    return OSVROpenGLHost::timeKernels();
+}
@@ -0,0 +1,320 @@
+/*
+ * Copyright (C) 2015 Sensics, Inc. and contributors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+// Measures how far the distortion mesh's interpolated texture coordinates
+// stray from the exact lens polynomial at a range of grid sizes, so the
+// cheapest grid within tolerance can be picked:
+//
+//   distortion_mesh_tool [--config osvr_server_config.json] [--grids 8,16,24x16,...]
+//                        [--stride N] [--tolerance PX]
+//   distortion_mesh_tool [--config ...] --startup DIR
+//
+// The error is sampled every --stride display pixels (default 2) over each
+// eye and given in eye-texture pixels, the worst of the three channels.
+// Samples whose exact coordinate falls outside the eye texture are skipped:
+// they show black either way. The reported grid is the one with the fewest
+// vertices whose max error is within --tolerance (default 0.5 pixels).
+//
+// --startup times the ways the app can get the descriptor at launch, using
+// DIR as its files and cache directories: copying the config out of the
+// assets and reading that (what extracting it first costs), mapping the
+// asset and parsing it, and mapping it and taking the parsed descriptor
+// cached for its hash. The files stay in the page cache, so this is the CPU
+// side of a warm start; a cold start adds the storage reads the copy makes.
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "DistortionMesh.h"
+#include "FrameStats.h"
+#include "Asset.h"
+
+#ifndef OSVROPENGL_ASSET_DIR
+#define OSVROPENGL_ASSET_DIR "."
+#endif
+
+namespace OSVROpenGLHost {
+
+    static const int kMaxGrids = 32;
+    static const int kStartupRuns = 200;
+
+    struct MeshToolOptions {
+        const char *configPath;
+        int gridCount;
+        uint32_t gridWidths[kMaxGrids];
+        uint32_t gridHeights[kMaxGrids];
+        int stride;
+        double tolerancePx;
+        const char *startupDirectory;
+    };
+
+    struct MeshError {
+        double maxPx;
+        double meanPx;
+        uint64_t samples;
+    };
+
+    static void printUsage(const char *argv0) {
+        fprintf(stderr,
+                "usage: %s [--config osvr_server_config.json] [--grids 8,16,24x16,...]\n"
+                "          [--stride N] [--tolerance PX] [--startup DIR]\n", argv0);
+    }
+
+    // A comma separated list of N (for NxN) or WxH grids.
+    static bool parseGrids(const char *list, MeshToolOptions *options) {
+        options->gridCount = 0;
+        const char *p = list;
+        while (*p) {
+            if (options->gridCount == kMaxGrids) {
+                return false;
+            }
+            char *end;
+            long width = strtol(p, &end, 10);
+            long height = width;
+            if (*end == 'x') {
+                p = end + 1;
+                height = strtol(p, &end, 10);
+            }
+            if (end == p || width < 1 || height < 1 ||
+                width > static_cast<long>(OSVROpenGL::kDistortionMaxGridSize) ||
+                height > static_cast<long>(OSVROpenGL::kDistortionMaxGridSize)) {
+                return false;
+            }
+            options->gridWidths[options->gridCount] = static_cast<uint32_t>(width);
+            options->gridHeights[options->gridCount] = static_cast<uint32_t>(height);
+            options->gridCount++;
+            p = *end == ',' ? end + 1 : end;
+            if (*end && *end != ',') {
+                return false;
+            }
+        }
+        return options->gridCount > 0;
+    }
+
+    static bool parseOptions(int argc, char **argv, MeshToolOptions *options) {
+        for (int i = 1; i < argc; i++) {
+            const char *arg = argv[i];
+            const char *value = i + 1 < argc ? argv[i + 1] : nullptr;
+            if (!value) {
+                return false;
+            }
+            if (!strcmp(arg, "--config")) {
+                options->configPath = value;
+            } else if (!strcmp(arg, "--grids")) {
+                if (!parseGrids(value, options)) {
+                    return false;
+                }
+            } else if (!strcmp(arg, "--stride")) {
+                options->stride = atoi(value);
+            } else if (!strcmp(arg, "--tolerance")) {
+                options->tolerancePx = atof(value);
+            } else if (!strcmp(arg, "--startup")) {
+                options->startupDirectory = value;
+            } else {
+                return false;
+            }
+            i++;
+        }
+        return options->stride >= 1 && options->tolerancePx > 0.0;
+    }
+
+    static MeshError measureError(const OSVROpenGL::DistortionParams &params, uint32_t gridWidth,
+                                  uint32_t gridHeight, const std::vector<OSVROpenGL::DistortionVertex> &vertices,
+                                  int stride) {
+        // RenderManager's eye textures are the size of the eye's part of the display
+        uint32_t eyeWidth = params.displayWidth / params.eyeCount;
+        uint32_t eyeHeight = params.displayHeight;
+        uint32_t eyeVertexCount = (gridWidth + 1) * (gridHeight + 1);
+        MeshError error = {0.0, 0.0, 0};
+        double totalPx = 0.0;
+        for (uint32_t eye = 0; eye < params.eyeCount; eye++) {
+            const OSVROpenGL::DistortionVertex *eyeVertices = vertices.data() + eye * eyeVertexCount;
+            for (uint32_t y = 0; y < eyeHeight; y += stride) {
+                for (uint32_t x = 0; x < eyeWidth; x += stride) {
+                    float screenUV[2] = { (x + 0.5f) / eyeWidth, (y + 0.5f) / eyeHeight };
+                    double samplePx = 0.0;
+                    bool visible = false;
+                    for (int channel = 0; channel < 3; channel++) {
+                        float exact[2];
+                        float interpolated[2];
+                        OSVROpenGL::evaluateDistortion(params, eye, channel, screenUV, exact);
+                        if (exact[0] < 0.0f || exact[0] > 1.0f || exact[1] < 0.0f || exact[1] > 1.0f) {
+                            continue;
+                        }
+                        visible = true;
+                        OSVROpenGL::interpolateDistortionMesh(eyeVertices, gridWidth, gridHeight, channel,
+                                                              screenUV, interpolated);
+                        double dx = (interpolated[0] - exact[0]) * eyeWidth;
+                        double dy = (interpolated[1] - exact[1]) * eyeHeight;
+                        double px = std::sqrt(dx * dx + dy * dy);
+                        samplePx = px > samplePx ? px : samplePx;
+                    }
+                    if (visible) {
+                        error.maxPx = samplePx > error.maxPx ? samplePx : error.maxPx;
+                        totalPx += samplePx;
+                        error.samples++;
+                    }
+                }
+            }
+        }
+        error.meanPx = error.samples ? totalPx / error.samples : 0.0;
+        return error;
+    }
+
+    // What extracting the config first did: copy it out, then read the copy.
+    static bool copyAndLoad(const char *configPath, const std::string &copyPath,
+                            OSVROpenGL::DistortionParams *paramsOut) {
+        OSVROpenGL::MappedAsset config;
+        if (!OSVROpenGL::mapAsset(configPath, &config)) {
+            return false;
+        }
+        FILE *file = fopen(copyPath.c_str(), "wb");
+        bool copied = file && fwrite(config.data, 1, config.bytes, file) == config.bytes;
+        copied = file && fclose(file) == 0 && copied;
+        OSVROpenGL::unmapAsset(&config);
+        return copied && OSVROpenGL::loadDisplayDistortion(copyPath.c_str(), nullptr, paramsOut, nullptr);
+    }
+
+    static int compareNs(const void *a, const void *b) {
+        uint64_t x = *static_cast<const uint64_t *>(a);
+        uint64_t y = *static_cast<const uint64_t *>(b);
+        return x < y ? -1 : (x > y ? 1 : 0);
+    }
+
+    static int runStartup(const MeshToolOptions &options) {
+        std::string copyPath = std::string(options.startupDirectory) + "/osvr_server_config.json";
+        std::string cacheDirectory = options.startupDirectory;
+        OSVROpenGL::DistortionParams reference;
+        bool cached = false;
+        // the first load parses and writes the cached descriptor
+        uint64_t startNs = OSVROpenGL::frameStatsNowNs();
+        if (!OSVROpenGL::loadDisplayDistortion(options.configPath, cacheDirectory.c_str(), &reference, &cached)) {
+            fprintf(stderr, "Could not read the display distortion from %s\n", options.configPath);
+            return 1;
+        }
+        uint64_t firstNs = OSVROpenGL::frameStatsNowNs() - startNs;
+
+        static const char *const methods[] = { "copy out + read + parse", "map + parse", "map + cached" };
+        const int methodCount = sizeof(methods) / sizeof(methods[0]);
+        std::vector<uint64_t> runNs(kStartupRuns);
+        printf("distortion_mesh_tool: startup with %s, %d runs each\n", options.configPath, kStartupRuns);
+        printf("first load (parse + cache): %.3f ms\n\n", firstNs / 1.0e6);
+        printf("%-24s %10s %10s\n", "display config", "p50 (ms)", "p99 (ms)");
+        int status = 0;
+        for (int method = 0; method < methodCount; method++) {
+            for (int run = 0; run < kStartupRuns; run++) {
+                OSVROpenGL::DistortionParams params;
+                bool ok = false;
+                cached = false;
+                startNs = OSVROpenGL::frameStatsNowNs();
+                if (method == 0) {
+                    ok = copyAndLoad(options.configPath, copyPath, &params);
+                } else {
+                    ok = OSVROpenGL::loadDisplayDistortion(options.configPath,
+                                                           method == 2 ? cacheDirectory.c_str() : nullptr,
+                                                           &params, &cached);
+                }
+                runNs[run] = OSVROpenGL::frameStatsNowNs() - startNs;
+                // every way must come to the same descriptor, and the last from the cache
+                if (!ok || memcmp(&params, &reference, sizeof(params)) != 0 || cached != (method == 2)) {
+                    fprintf(stderr, "%s gave a different descriptor\n", methods[method]);
+                    status = 3;
+                }
+            }
+            qsort(runNs.data(), runNs.size(), sizeof(runNs[0]), compareNs);
+            printf("%-24s %10.4f %10.4f\n", methods[method], runNs[kStartupRuns / 2] / 1.0e6,
+                   runNs[kStartupRuns * 99 / 100] / 1.0e6);
+        }
+        remove(copyPath.c_str());
+        return status;
+    }
+
+    static int runTool(const MeshToolOptions &options) {
+        if (options.startupDirectory) {
+            return runStartup(options);
+        }
+        OSVROpenGL::DistortionParams params;
+        if (!OSVROpenGL::loadDisplayDistortion(options.configPath, nullptr, &params, nullptr)) {
+            fprintf(stderr, "Could not read the display distortion from %s\n", options.configPath);
+            return 1;
+        }
+        printf("distortion_mesh_tool: %s\n", options.configPath);
+        printf("%u eyes on a %ux%u display, sampled every %d pixels\n", params.eyeCount,
+               params.displayWidth, params.displayHeight, options.stride);
+        printf("\n");
+        printf("%-9s %9s %9s %10s %10s %10s %10s\n", "grid", "vertices", "triangles", "cache (KB)",
+               "build (ms)", "max (px)", "mean (px)");
+
+        int best = -1;
+        uint32_t bestVertices = 0;
+        for (int i = 0; i < options.gridCount; i++) {
+            uint32_t gridWidth = options.gridWidths[i];
+            uint32_t gridHeight = options.gridHeights[i];
+            std::vector<OSVROpenGL::DistortionVertex> vertices;
+            std::vector<uint16_t> indices;
+            uint64_t startNs = OSVROpenGL::frameStatsNowNs();
+            OSVROpenGL::buildDistortionMesh(params, gridWidth, gridHeight, &vertices, &indices);
+            uint64_t buildNs = OSVROpenGL::frameStatsNowNs() - startNs;
+            MeshError error = measureError(params, gridWidth, gridHeight, vertices, options.stride);
+
+            size_t cacheBytes = sizeof(OSVROpenGL::DistortionMeshCacheHeader) +
+                                vertices.size() * sizeof(vertices[0]) + indices.size() * sizeof(indices[0]);
+            uint32_t vertexCount = static_cast<uint32_t>(vertices.size());
+            char grid[24];
+            snprintf(grid, sizeof(grid), "%ux%u", gridWidth, gridHeight);
+            printf("%-9s %9u %9zu %10.1f %10.3f %10.3f %10.3f\n", grid, vertexCount,
+                   indices.size() / 3 * params.eyeCount, cacheBytes / 1024.0, buildNs / 1.0e6,
+                   error.maxPx, error.meanPx);
+            if (error.maxPx <= options.tolerancePx && (best < 0 || vertexCount < bestVertices)) {
+                best = i;
+                bestVertices = vertexCount;
+            }
+        }
+
+        printf("\n");
+        if (best < 0) {
+            printf("no grid within %.2f px; try denser ones\n", options.tolerancePx);
+            return 3;
+        }
+        printf("cheapest within %.2f px: %ux%u (%u vertices)\n", options.tolerancePx,
+               options.gridWidths[best], options.gridHeights[best], bestVertices);
+        return 0;
+    }
+}
+
+int main(int argc, char **argv) {
+    OSVROpenGLHost::MeshToolOptions options;
+    OSVROpenGL::setAssetDirectory(OSVROPENGL_ASSET_DIR);
+    options.configPath = "asset:osvr_server_config.json";
+    static const uint32_t defaultGrids[] = { 4, 8, 12, 16, 24, 32, 48, 64, 96, 128 };
+    options.gridCount = sizeof(defaultGrids) / sizeof(defaultGrids[0]);
+    for (int i = 0; i < options.gridCount; i++) {
+        options.gridWidths[i] = options.gridHeights[i] = defaultGrids[i];
+    }
+    options.stride = 2;
+    options.tolerancePx = 0.5;
+    options.startupDirectory = nullptr;
+    if (!OSVROpenGLHost::parseOptions(argc, argv, &options)) {
+        OSVROpenGLHost::printUsage(argv[0]);
+        return 2;
+    }
+    return OSVROpenGLHost::runTool(options);
+}
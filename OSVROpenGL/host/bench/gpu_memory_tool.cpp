@@ -0,0 +1,300 @@
+/*
+ * Copyright (C) 2015 Sensics, Inc. and contributors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+// Runs the GPU memory manager (see GpuMemory.h) against made-up textures,
+// without a GL context: the stand-in stage and upload functions only work
+// out the size a texture's mip chain would have.
+//
+//   gpu_memory_tool --self-check
+//                      tracks objects of every kind, then puts the manager
+//                      under budget pressure, a rising budget, an out of
+//                      memory error, a texture deleted while its levels
+//                      load and a texture whose levels can't be read, and
+//                      fails (exit status 3) unless it evicts the least
+//                      recently drawn first, gets under the budget, restores
+//                      only what is drawn, uploads at most one texture a
+//                      frame and settles
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "GpuMemory.h"
+
+namespace OSVROpenGLHost {
+
+    using OSVROpenGL::GpuMemoryStats;
+
+    static int gFailures = 0;
+
+    static void check(bool ok, const char *what) {
+        printf("  %-72s %s\n", what, ok ? "ok" : "FAILED");
+        if (!ok) {
+            gFailures++;
+        }
+    }
+
+    // Square RGBA textures with the full chain; the texture name is the
+    // index into these.
+    static const int kTextures = 4;
+    static const uint32_t kTextureSize = 1024;
+    static const uint32_t kTextureLevels = 11;
+    static uint32_t gFirstLevel[kTextures + 1];
+    static int gUploads = 0;
+    static int gFrameUploads = 0;
+    static int gStaleUploads = 0;
+    static std::atomic<bool> gHoldStage(false);
+
+    static uint64_t chainBytes(uint32_t firstLevel) {
+        uint64_t bytes = 0;
+        for (uint32_t level = firstLevel; level < kTextureLevels; level++) {
+            uint64_t size = kTextureSize >> level;
+            bytes += size * size * 4;
+        }
+        return bytes;
+    }
+
+    static bool stage(const std::string &source, uint32_t firstLevel, std::vector<uint8_t> *staged) {
+        while (gHoldStage.load()) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        staged->clear();
+        return source != "unreadable";
+    }
+
+    static uint64_t upload(GLuint texture, uint32_t firstLevel, const std::vector<uint8_t> &) {
+        if (texture == 0 || texture > kTextures) {
+            gStaleUploads++;
+            return 0;
+        }
+        gUploads++;
+        gFrameUploads++;
+        gFirstLevel[texture] = firstLevel;
+        return chainBytes(firstLevel);
+    }
+
+    static void addTexture(GLuint texture, const char *source) {
+        gFirstLevel[texture] = 0;
+        OSVROpenGL::trackGpuObject(OSVROpenGL::GPU_OBJECT_TEXTURE, texture, OSVROpenGL::GPU_MEMORY_TEXTURES,
+                                   chainBytes(0));
+        OSVROpenGL::makeGpuTextureEvictable(texture, source, kTextureLevels, stage, upload);
+    }
+
+    static GpuMemoryStats stats() {
+        GpuMemoryStats stats;
+        OSVROpenGL::getGpuMemoryStats(&stats);
+        return stats;
+    }
+
+    // Frames in which the given textures are drawn, each followed by enough
+    // of a wait for the loader; returns the most uploads a frame saw.
+    static int runFrames(int frames, const GLuint *drawn, int drawnCount) {
+        int maxUploads = 0;
+        for (int frame = 0; frame < frames; frame++) {
+            gFrameUploads = 0;
+            OSVROpenGL::updateGpuMemory();
+            for (int i = 0; i < drawnCount; i++) {
+                OSVROpenGL::useGpuTexture(drawn[i]);
+            }
+            maxUploads = std::max(maxUploads, gFrameUploads);
+            std::this_thread::sleep_for(std::chrono::microseconds(200));
+        }
+        return maxUploads;
+    }
+
+    static void start(uint64_t budgetBytes) {
+        OSVROpenGL::initGpuMemory();
+        OSVROpenGL::setGpuMemoryBudget(budgetBytes);
+        OSVROpenGL::resetGpuMemoryStats();
+        gUploads = gStaleUploads = 0;
+    }
+
+    static int selfCheck() {
+        const uint64_t MB = 1024 * 1024;
+        uint64_t full = chainBytes(0);
+        printf("a %ux%u RGBA texture with its chain: %.2f MB, %.2f MB without its top level\n", kTextureSize,
+               kTextureSize, full / 1048576.0, chainBytes(1) / 1048576.0);
+
+        printf("tracking:\n");
+        start(0);
+        OSVROpenGL::trackGpuObject(OSVROpenGL::GPU_OBJECT_TEXTURE, 1, OSVROpenGL::GPU_MEMORY_TEXTURES, 1000);
+        OSVROpenGL::trackGpuObject(OSVROpenGL::GPU_OBJECT_RENDERBUFFER, 1, OSVROpenGL::GPU_MEMORY_RENDER_TARGETS, 200);
+        OSVROpenGL::trackGpuObject(OSVROpenGL::GPU_OBJECT_BUFFER, 1, OSVROpenGL::GPU_MEMORY_BUFFERS, 30);
+        OSVROpenGL::trackGpuObject(OSVROpenGL::GPU_OBJECT_TEXTURE, 2, OSVROpenGL::GPU_MEMORY_RENDER_TARGETS, 4);
+        GpuMemoryStats tracked = stats();
+        check(tracked.usedBytes == 1234 && tracked.categoryBytes[OSVROpenGL::GPU_MEMORY_TEXTURES] == 1000 &&
+              tracked.categoryBytes[OSVROpenGL::GPU_MEMORY_RENDER_TARGETS] == 204 &&
+              tracked.categoryObjects[OSVROpenGL::GPU_MEMORY_RENDER_TARGETS] == 2,
+              "same names of different kinds are different objects");
+        // re-specified smaller, then deleted
+        OSVROpenGL::trackGpuObject(OSVROpenGL::GPU_OBJECT_TEXTURE, 1, OSVROpenGL::GPU_MEMORY_TEXTURES, 10);
+        OSVROpenGL::forgetGpuObject(OSVROpenGL::GPU_OBJECT_BUFFER, 1);
+        OSVROpenGL::forgetGpuObject(OSVROpenGL::GPU_OBJECT_BUFFER, 7);
+        tracked = stats();
+        check(tracked.usedBytes == 214 && tracked.categoryObjects[OSVROpenGL::GPU_MEMORY_BUFFERS] == 0 &&
+              tracked.peakUsedBytes == 1234, "a new size replaces the old one, and deleting forgets it");
+        for (GLuint name = 1; name <= OSVROpenGL::kMaxTrackedGpuObjects + 10; name++) {
+            OSVROpenGL::trackGpuObject(OSVROpenGL::GPU_OBJECT_BUFFER, name, OSVROpenGL::GPU_MEMORY_BUFFERS, 1);
+        }
+        tracked = stats();
+        check(tracked.untrackedObjects == 13, "objects past the table's size are counted as untracked");
+        OSVROpenGL::initGpuMemory();
+        check(stats().usedBytes == 0, "a new context starts from nothing");
+
+        // Four textures and 16 MB of eye buffers against 36 MB: one texture
+        // has to go to a quarter. Textures 1 and 2 are drawn every frame,
+        // 3 only at first and 4 never.
+        printf("budget pressure, 4 textures and 16 MB of render targets in 36 MB:\n");
+        start(0);
+        OSVROpenGL::trackGpuObject(OSVROpenGL::GPU_OBJECT_RENDERBUFFER, 1, OSVROpenGL::GPU_MEMORY_RENDER_TARGETS,
+                                   16 * MB);
+        for (GLuint texture = 1; texture <= kTextures; texture++) {
+            addTexture(texture, "texture");
+        }
+        const GLuint drawnFirst[] = { 1, 2, 3 };
+        const GLuint drawnAfter[] = { 1, 2 };
+        runFrames(5, drawnFirst, 3);
+        OSVROpenGL::setGpuMemoryBudget(36 * MB);
+        int maxUploads = runFrames(100, drawnAfter, 2);
+        GpuMemoryStats pressure = stats();
+        printf("    %.1f MB of %.1f MB after %u evictions, first levels %u %u %u %u\n",
+               pressure.usedBytes / 1048576.0, pressure.budgetBytes / 1048576.0, pressure.evictions,
+               gFirstLevel[1], gFirstLevel[2], gFirstLevel[3], gFirstLevel[4]);
+        check(pressure.usedBytes <= 36 * MB, "gets under the budget");
+        check(gFirstLevel[4] > 0 && gFirstLevel[1] == 0 && gFirstLevel[2] == 0,
+              "evicts the texture never drawn, and not the ones drawn every frame");
+        check(maxUploads <= 1, "uploads at most one texture a frame");
+        check(pressure.categoryEvictions[OSVROpenGL::GPU_MEMORY_TEXTURES] == pressure.evictions &&
+              pressure.droppedLevels > 0 && pressure.overBudgetFrames > 0, "counts the evictions as textures'");
+
+        printf("tighter, 26 MB:\n");
+        OSVROpenGL::setGpuMemoryBudget(26 * MB);
+        runFrames(100, drawnAfter, 2);
+        GpuMemoryStats tighter = stats();
+        printf("    %.1f MB, first levels %u %u %u %u\n", tighter.usedBytes / 1048576.0,
+               gFirstLevel[1], gFirstLevel[2], gFirstLevel[3], gFirstLevel[4]);
+        check(tighter.usedBytes <= 26 * MB && gFirstLevel[3] > 0, "evicts the one drawn less recently next");
+        int uploads = gUploads;
+        runFrames(300, drawnAfter, 2);
+        check(gUploads == uploads, "then settles");
+
+        printf("budget raised to 64 MB:\n");
+        OSVROpenGL::setGpuMemoryBudget(64 * MB);
+        maxUploads = runFrames(100, drawnAfter, 2);
+        GpuMemoryStats raised = stats();
+        printf("    %.1f MB after %u restores, first levels %u %u %u %u\n", raised.usedBytes / 1048576.0,
+               raised.restores, gFirstLevel[1], gFirstLevel[2], gFirstLevel[3], gFirstLevel[4]);
+        check(gFirstLevel[1] == 0 && gFirstLevel[2] == 0 && gFirstLevel[3] > 0 && gFirstLevel[4] > 0,
+              "leaves the textures not drawn as they are");
+        const GLuint drawnAll[] = { 1, 2, 3, 4 };
+        maxUploads = std::max(maxUploads, runFrames(100, drawnAll, 4));
+        raised = stats();
+        check(gFirstLevel[3] == 0 && gFirstLevel[4] == 0 && raised.usedBytes <= 64 * MB / 10 * 9,
+              "restores them once they are drawn, under 90% of the budget");
+        check(maxUploads <= 1, "uploads at most one texture a frame");
+
+        printf("budget just over what everything takes:\n");
+        OSVROpenGL::setGpuMemoryBudget(16 * MB + 4 * full + MB);
+        uploads = gUploads;
+        runFrames(600, drawnAll, 4);
+        check(gUploads == uploads, "no evictions and no restores");
+        OSVROpenGL::setGpuMemoryBudget(16 * MB + 4 * full - MB);
+        runFrames(100, drawnAll, 4);
+        uploads = gUploads;
+        runFrames(600, drawnAll, 4);
+        GpuMemoryStats edge = stats();
+        printf("    then just under: %.1f MB of %.1f MB\n", edge.usedBytes / 1048576.0, edge.budgetBytes / 1048576.0);
+        check(gUploads == uploads && edge.usedBytes <= edge.budgetBytes,
+              "just under it: evicts once and doesn't go back and forth");
+
+        printf("out of memory without a budget:\n");
+        start(0);
+        for (GLuint texture = 1; texture <= kTextures; texture++) {
+            addTexture(texture, "texture");
+        }
+        OSVROpenGL::noteGpuOutOfMemory();
+        runFrames(100, drawnAll, 4);
+        GpuMemoryStats outOfMemory = stats();
+        printf("    budget %.1f MB, %.1f MB after %u evictions\n", outOfMemory.budgetBytes / 1048576.0,
+               outOfMemory.usedBytes / 1048576.0, outOfMemory.evictions);
+        check(outOfMemory.outOfMemoryErrors == 1 && outOfMemory.budgetBytes == 4 * full / 10 * 9 &&
+              outOfMemory.usedBytes <= outOfMemory.budgetBytes, "lowers the budget under what it had, and evicts");
+        OSVROpenGL::setGpuMemoryBudget(0);
+        runFrames(100, drawnAll, 4);
+        check(stats().usedBytes == 4 * full, "setting the budget clears it");
+
+        printf("a texture deleted while its levels load:\n");
+        start(0);
+        addTexture(1, "texture");
+        addTexture(2, "texture");
+        OSVROpenGL::setGpuMemoryBudget(full + MB);
+        gHoldStage.store(true);
+        runFrames(3, drawnAfter, 2);
+        bool loading = stats().pendingLoads > 0;
+        OSVROpenGL::forgetGpuObject(OSVROpenGL::GPU_OBJECT_TEXTURE, 1);
+        OSVROpenGL::forgetGpuObject(OSVROpenGL::GPU_OBJECT_TEXTURE, 2);
+        // the name is used again for another texture
+        OSVROpenGL::trackGpuObject(OSVROpenGL::GPU_OBJECT_TEXTURE, 1, OSVROpenGL::GPU_MEMORY_TEXTURES, 100);
+        gHoldStage.store(false);
+        runFrames(20, drawnAfter, 2);
+        GpuMemoryStats deleted = stats();
+        check(loading && gUploads == 0 && deleted.pendingLoads == 0 && deleted.usedBytes == 100,
+              "its load is dropped, and not applied to the name's new texture");
+
+        printf("a texture whose levels can't be read:\n");
+        start(0);
+        addTexture(1, "texture");
+        addTexture(2, "unreadable");
+        const GLuint drawnOne[] = { 1 };
+        runFrames(2, drawnOne, 1);
+        OSVROpenGL::setGpuMemoryBudget(full);
+        runFrames(50, drawnOne, 1);
+        GpuMemoryStats unreadable = stats();
+        check(unreadable.failedLoads == 1 && gFirstLevel[1] > 0 && unreadable.evictableTextures == 1,
+              "fails once, stops evicting it and evicts the next one instead");
+
+        OSVROpenGL::releaseGpuMemory();
+        if (gFailures) {
+            printf("%d checks FAILED\n", gFailures);
+            return 3;
+        }
+        printf("all checks passed\n");
+        return 0;
+    }
+}
+
+int main(int argc, char **argv) {
+    bool selfCheck = false;
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "--self-check")) {
+            selfCheck = true;
+        } else {
+            fprintf(stderr, "Unknown option %s\n", argv[i]);
+            return 1;
+        }
+    }
+    if (!selfCheck) {
+        fprintf(stderr, "usage: gpu_memory_tool --self-check\n");
+        return 1;
+    }
+    return OSVROpenGLHost::selfCheck();
+}
@@ -0,0 +1,288 @@
+/*
+ * Copyright (C) 2015 Sensics, Inc. and contributors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+// Checks the input event ring the OSVR callbacks fill and the frame loop
+// drains (see InputEventQueue.h), and the record layout against what
+// InputEventBuffer.java reads.
+//
+//   input_event_tool --self-check
+//                      fills, drains, wraps and overfills small rings, runs
+//                      a producer thread against a consumer draining a few
+//                      events at a time, and compares PackedInputEvent's
+//                      size, offsets, field widths and enum values with the
+//                      constants and getters in InputEventBuffer.java; fails
+//                      (exit status 3) on any difference
+
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <thread>
+
+#include "InputEventQueue.h"
+
+namespace OSVROpenGLHost {
+
+    using OSVROpenGL::InputEventRing;
+    using OSVROpenGL::PackedInputEvent;
+
+    static int gFailures = 0;
+
+    static void check(bool ok, const char *what) {
+        printf("  %-72s %s\n", what, ok ? "ok" : "FAILED");
+        if (!ok) {
+            gFailures++;
+        }
+    }
+
+    static PackedInputEvent makeEvent(uint32_t sequence) {
+        PackedInputEvent event;
+        memset(&event, 0, sizeof(event));
+        event.type = OSVROpenGL::INPUT_EVENT_BUTTON;
+        event.source = static_cast<uint16_t>(sequence % 9);
+        event.sensor = sequence;
+        event.seconds = sequence / 1000;
+        event.microseconds = static_cast<int32_t>(sequence % 1000);
+        return event;
+    }
+
+    // True if events holds count events numbered from firstSequence on.
+    static bool inSequence(const PackedInputEvent *events, size_t count, uint32_t firstSequence) {
+        for (size_t i = 0; i < count; i++) {
+            PackedInputEvent expected = makeEvent(firstSequence + static_cast<uint32_t>(i));
+            if (memcmp(&events[i], &expected, sizeof(expected))) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    static void checkRing() {
+        printf("ring:\n");
+        InputEventRing<8> ring;
+        PackedInputEvent out[16];
+
+        check(ring.size() == 0 && ring.drainTo(out, sizeof(out)) == 0, "a new ring is empty");
+
+        bool pushed = true;
+        for (uint32_t i = 0; i < 8; i++) {
+            pushed = ring.push(makeEvent(i)) && pushed;
+        }
+        check(pushed && ring.size() == 8 && ring.droppedCount() == 0, "takes capacity() events");
+        check(!ring.push(makeEvent(8)) && !ring.push(makeEvent(9)) && ring.size() == 8 &&
+              ring.droppedCount() == 2, "drops and counts events pushed while full");
+
+        // room for 3 and most of a fourth: only whole events are written
+        memset(out, 0xab, sizeof(out));
+        size_t drained = ring.drainTo(out, 3 * sizeof(PackedInputEvent) + sizeof(PackedInputEvent) - 1);
+        unsigned char past[sizeof(PackedInputEvent)];
+        memset(past, 0xab, sizeof(past));
+        check(drained == 3 && inSequence(out, 3, 0) && !memcmp(&out[3], past, sizeof(past)),
+              "a partial drain writes the oldest whole events that fit");
+        check(ring.size() == 5, "and leaves the rest queued");
+        check(ring.push(makeEvent(100)) && ring.droppedCount() == 2, "frees the drained slots for new events");
+
+        // the queued events now run from slot 3 past the end to slot 0
+        drained = ring.drainTo(out, sizeof(out));
+        check(drained == 6 && inSequence(out, 5, 3) && inSequence(&out[5], 1, 100),
+              "drains across the end of the ring in order");
+        check(ring.size() == 0 && ring.drainTo(out, sizeof(out)) == 0, "and is empty afterwards");
+
+        // many laps, with the drain size never lining up with the capacity
+        bool ordered = true;
+        uint32_t next = 0;
+        uint32_t expected = 0;
+        for (int round = 0; round < 1000; round++) {
+            for (int i = 0; i < 5; i++) {
+                ordered = ring.push(makeEvent(next++)) && ordered;
+            }
+            size_t count = ring.drainTo(out, 3 * sizeof(PackedInputEvent));
+            ordered = inSequence(out, count, expected) && ordered;
+            expected += static_cast<uint32_t>(count);
+            count = ring.drainTo(out, sizeof(out));
+            ordered = inSequence(out, count, expected) && ordered;
+            expected += static_cast<uint32_t>(count);
+        }
+        check(ordered && expected == next && ring.droppedCount() == 2,
+              "keeps order over many laps of partial drains");
+
+        for (uint32_t i = 0; i < 4; i++) {
+            ring.push(makeEvent(i));
+        }
+        ring.clear();
+        check(ring.size() == 0 && ring.drainTo(out, sizeof(out)) == 0, "clear() empties it");
+        check(ring.push(makeEvent(7)) && ring.drainTo(out, sizeof(out)) == 1 && inSequence(out, 1, 7),
+              "and it is usable afterwards");
+    }
+
+    static void checkThreads() {
+        printf("producer and consumer threads:\n");
+        static InputEventRing<64> ring;
+        const uint32_t kEvents = 200000;
+        uint32_t accepted = 0;
+        std::thread producer([&accepted, kEvents]() {
+            for (uint32_t i = 0; i < kEvents; i++) {
+                if (ring.push(makeEvent(i))) {
+                    accepted++;
+                }
+            }
+        });
+
+        // sequence numbers must only go up, and whatever was accepted arrives
+        PackedInputEvent out[5];
+        uint32_t received = 0;
+        uint32_t last = 0;
+        bool ordered = true;
+        bool intact = true;
+        bool producing = true;
+        while (producing || ring.size()) {
+            producing = received + ring.droppedCount() < kEvents;
+            size_t count = ring.drainTo(out, sizeof(out));
+            for (size_t i = 0; i < count; i++) {
+                PackedInputEvent expected = makeEvent(out[i].sensor);
+                intact = !memcmp(&out[i], &expected, sizeof(expected)) && intact;
+                ordered = (received == 0 || out[i].sensor > last) && ordered;
+                last = out[i].sensor;
+                received++;
+            }
+        }
+        producer.join();
+        received += static_cast<uint32_t>(ring.drainTo(out, sizeof(out)));
+        check(ordered && intact, "events arrive whole and in order");
+        check(received == accepted && received + ring.droppedCount() == kEvents,
+              "every event is either received or counted as dropped");
+    }
+
+    static std::string readFile(const char *path) {
+        std::ifstream file(path);
+        std::stringstream contents;
+        contents << file.rdbuf();
+        return contents.str();
+    }
+
+    // "static final int NAME = value;" constants of the Java class
+    static std::map<std::string, long> javaConstants(const std::string &source) {
+        std::map<std::string, long> constants;
+        const std::string marker = "static final int ";
+        for (size_t at = source.find(marker); at != std::string::npos; at = source.find(marker, at + 1)) {
+            size_t nameBegin = at + marker.size();
+            size_t nameEnd = source.find_first_of(" =", nameBegin);
+            size_t equals = source.find('=', nameEnd);
+            if (nameEnd == std::string::npos || equals == std::string::npos) {
+                break;
+            }
+            constants[source.substr(nameBegin, nameEnd - nameBegin)] = strtol(source.c_str() + equals + 1, nullptr, 0);
+        }
+        return constants;
+    }
+
+    // The ByteBuffer get the Java getter for an offset uses, as a byte width
+    static size_t javaReadWidth(const std::string &source, const char *offsetName) {
+        static const struct { const char *get; size_t bytes; } kGets[] = {
+            {"getShort(", 2}, {"getInt(", 4}, {"getLong(", 8}, {"getDouble(", 8}, {"getFloat(", 4}, {"get(", 1}
+        };
+        size_t use = source.find(std::string("EVENT_SIZE + ") + offsetName + ")");
+        if (use == std::string::npos) {
+            return 0;
+        }
+        size_t call = source.rfind("mBuffer.", use);
+        for (const auto &get : kGets) {
+            if (call != std::string::npos && !source.compare(call + 8, strlen(get.get), get.get)) {
+                return get.bytes;
+            }
+        }
+        return 0;
+    }
+
+    static void checkJavaLayout(const char *path) {
+        printf("layout against %s:\n", path);
+        std::string source = readFile(path);
+        if (source.empty()) {
+            check(false, "InputEventBuffer.java can be read");
+            return;
+        }
+        std::map<std::string, long> constants = javaConstants(source);
+        auto constant = [&constants](const char *name) {
+            auto it = constants.find(name);
+            return it == constants.end() ? -1L : it->second;
+        };
+
+        check(constant("EVENT_SIZE") == static_cast<long>(sizeof(PackedInputEvent)),
+              "EVENT_SIZE is sizeof(PackedInputEvent)");
+
+#define INPUT_EVENT_FIELD(member, offsetName) \
+        check(constant(offsetName) == static_cast<long>(offsetof(PackedInputEvent, member)) && \
+              javaReadWidth(source, offsetName) == sizeof(PackedInputEvent::member), \
+              offsetName " matches " #member "'s offset and width");
+        INPUT_EVENT_FIELD(type, "OFFSET_TYPE")
+        INPUT_EVENT_FIELD(source, "OFFSET_SOURCE")
+        INPUT_EVENT_FIELD(sensor, "OFFSET_SENSOR")
+        INPUT_EVENT_FIELD(seconds, "OFFSET_SECONDS")
+        INPUT_EVENT_FIELD(microseconds, "OFFSET_MICROSECONDS")
+        INPUT_EVENT_FIELD(buttonState, "OFFSET_BUTTON_STATE")
+        INPUT_EVENT_FIELD(x, "OFFSET_X")
+        INPUT_EVENT_FIELD(y, "OFFSET_Y")
+#undef INPUT_EVENT_FIELD
+
+        check(constant("TYPE_BUTTON") == OSVROpenGL::INPUT_EVENT_BUTTON &&
+              constant("TYPE_LOCATION2D") == OSVROpenGL::INPUT_EVENT_LOCATION2D,
+              "TYPE_* match InputEventType");
+        check(constant("SOURCE_CENTER") == OSVROpenGL::INPUT_SOURCE_CENTER &&
+              constant("SOURCE_DOWN") == OSVROpenGL::INPUT_SOURCE_DOWN &&
+              constant("SOURCE_RIGHT") == OSVROpenGL::INPUT_SOURCE_RIGHT &&
+              constant("SOURCE_LEFT") == OSVROpenGL::INPUT_SOURCE_LEFT &&
+              constant("SOURCE_UP") == OSVROpenGL::INPUT_SOURCE_UP &&
+              constant("SOURCE_VOLUME_UP") == OSVROpenGL::INPUT_SOURCE_VOLUME_UP &&
+              constant("SOURCE_VOLUME_DOWN") == OSVROpenGL::INPUT_SOURCE_VOLUME_DOWN &&
+              constant("SOURCE_BACK") == OSVROpenGL::INPUT_SOURCE_BACK &&
+              constant("SOURCE_MOUSE") == OSVROpenGL::INPUT_SOURCE_MOUSE,
+              "SOURCE_* match InputEventSource");
+    }
+
+    static int selfCheck() {
+        checkRing();
+        checkThreads();
+        checkJavaLayout(OSVROPENGL_JAVA_DIR "/InputEventBuffer.java");
+        if (gFailures) {
+            printf("%d checks FAILED\n", gFailures);
+            return 3;
+        }
+        printf("all checks passed\n");
+        return 0;
+    }
+}
+
+int main(int argc, char **argv) {
+    bool selfCheck = false;
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "--self-check")) {
+            selfCheck = true;
+        } else {
+            fprintf(stderr, "Unknown option %s\n", argv[i]);
+            return 1;
+        }
+    }
+    if (!selfCheck) {
+        fprintf(stderr, "usage: input_event_tool --self-check\n");
+        return 1;
+    }
+    return OSVROpenGLHost::selfCheck();
+}
@@ -0,0 +1,327 @@
+/*
+ * Copyright (C) 2015 Sensics, Inc. and contributors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+// Checks KTX containers against what CompressedTexture.cpp accepts, and makes
+// test textures:
+//
+//   ktx_tool file.ktx...       validates each file's header and mip chain and
+//                              prints its format, levels and size against RGBA
+//   ktx_tool --write base      writes a 256x256 checkerboard with its full mip
+//                              chain as base.etc1.ktx and base.etc2.ktx
+//   ktx_tool --self-check      parses well-formed and broken containers built
+//                              in memory and decodes known ETC1/ETC2 data,
+//                              failing (exit status 3) on any surprise
+//
+// No GL context is involved: this is the container parsing and the CPU
+// decoder that the loader falls back to.
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "CompressedTexture.h"
+
+namespace OSVROpenGLHost {
+
+    static const uint8_t kKtxIdentifier[12] = { 0xAB, 'K', 'T', 'X', ' ', '1', '1', 0xBB, '\r', '\n', 0x1A, '\n' };
+
+    static void appendUint32(std::vector<uint8_t> *file, uint32_t value, bool swapped) {
+        if (swapped) {
+            value = __builtin_bswap32(value);
+        }
+        const uint8_t *bytes = reinterpret_cast<const uint8_t *>(&value);
+        file->insert(file->end(), bytes, bytes + 4);
+    }
+
+    // fillBlocks(level, levelWidth, levelHeight, blocks, bytes) writes a level's blocks.
+    typedef void (*FillBlocks)(uint32_t level, uint32_t width, uint32_t height, uint8_t *blocks, size_t bytes);
+
+    static std::vector<uint8_t> buildKtx(GLenum glInternalFormat, uint32_t width, uint32_t height,
+                                         uint32_t levelCount, FillBlocks fillBlocks, bool swapped) {
+        const OSVROpenGL::CompressedFormatInfo *format = OSVROpenGL::findCompressedFormat(glInternalFormat);
+        std::vector<uint8_t> file(kKtxIdentifier, kKtxIdentifier + sizeof(kKtxIdentifier));
+        const uint32_t header[13] = {
+                0x04030201, 0, 1, 0, glInternalFormat, format->hasAlpha ? 0x1908u : 0x1907u,  // GL_RGBA / GL_RGB
+                width, height, 0, 0, 1, levelCount, 0 };
+        for (int i = 0; i < 13; i++) {
+            appendUint32(&file, header[i], swapped);
+        }
+        for (uint32_t level = 0; level < levelCount; level++) {
+            uint32_t levelWidth = width >> level ? width >> level : 1;
+            uint32_t levelHeight = height >> level ? height >> level : 1;
+            std::vector<uint8_t> blocks(OSVROpenGL::compressedImageBytes(*format, levelWidth, levelHeight));
+            fillBlocks(level, levelWidth, levelHeight, blocks.data(), blocks.size());
+            appendUint32(&file, static_cast<uint32_t>(blocks.size()), swapped);
+            file.insert(file.end(), blocks.begin(), blocks.end());
+        }
+        return file;
+    }
+
+    static uint32_t fullMipChain(uint32_t width, uint32_t height) {
+        uint32_t levels = 1;
+        for (uint32_t size = width > height ? width : height; size > 1; size >>= 1) {
+            levels++;
+        }
+        return levels;
+    }
+
+    // A flat 4x4 ETC1 block (individual mode, smallest modifiers), which is
+    // also a valid ETC2 block.
+    static void writeFlatEtcBlock(uint8_t *block, uint8_t red, uint8_t green, uint8_t blue) {
+        block[0] = static_cast<uint8_t>((red & 0xF0) | (red >> 4));
+        block[1] = static_cast<uint8_t>((green & 0xF0) | (green >> 4));
+        block[2] = static_cast<uint8_t>((blue & 0xF0) | (blue >> 4));
+        block[3] = 0;
+        block[4] = block[5] = block[6] = block[7] = 0;
+    }
+
+    // 32 texel squares at the top level; levels whose blocks cover more than
+    // a square are the average gray.
+    static void checkerColor(uint32_t level, uint32_t blockX, uint32_t blockY, uint8_t *rgb) {
+        uint32_t scale = 4u << level;
+        bool light = (((blockX * scale) / 32 + (blockY * scale) / 32) & 1) != 0;
+        uint8_t value = scale > 32 ? 0x80 : (light ? 0xE0 : 0x20);
+        rgb[0] = value;
+        rgb[1] = light && scale <= 32 ? 0xE0 : value;
+        rgb[2] = light && scale <= 32 ? 0x60 : value;
+    }
+
+    static void fillCheckerEtc1(uint32_t level, uint32_t width, uint32_t height, uint8_t *blocks, size_t bytes) {
+        for (uint32_t y = 0; y < (height + 3) / 4; y++) {
+            for (uint32_t x = 0; x < (width + 3) / 4; x++, blocks += 8) {
+                uint8_t rgb[3];
+                checkerColor(level, x, y, rgb);
+                writeFlatEtcBlock(blocks, rgb[0], rgb[1], rgb[2]);
+            }
+        }
+    }
+
+    // The same with an opaque EAC alpha block (multiplier 0) in front.
+    static void fillCheckerEtc2(uint32_t level, uint32_t width, uint32_t height, uint8_t *blocks, size_t bytes) {
+        for (uint32_t y = 0; y < (height + 3) / 4; y++) {
+            for (uint32_t x = 0; x < (width + 3) / 4; x++, blocks += 16) {
+                memset(blocks, 0, 8);
+                blocks[0] = 0xFF;
+                uint8_t rgb[3];
+                checkerColor(level, x, y, rgb);
+                writeFlatEtcBlock(blocks + 8, rgb[0], rgb[1], rgb[2]);
+            }
+        }
+    }
+
+    // Deterministic noise; every bit pattern is a valid ETC2 block.
+    static uint32_t gNoiseState;
+
+    static void fillNoise(uint32_t level, uint32_t width, uint32_t height, uint8_t *blocks, size_t bytes) {
+        for (size_t i = 0; i < bytes; i++) {
+            gNoiseState = gNoiseState * 1664525u + 1013904223u;
+            blocks[i] = static_cast<uint8_t>(gNoiseState >> 24);
+        }
+    }
+
+    // ETC1 leaves a differential block whose second color overflows
+    // undefined (ETC2 gave those encodings new modes), so make them individual.
+    static void fillNoiseEtc1(uint32_t level, uint32_t width, uint32_t height, uint8_t *blocks, size_t bytes) {
+        fillNoise(level, width, height, blocks, bytes);
+        for (size_t i = 0; i < bytes; i += 8) {
+            for (int c = 0; c < 3; c++) {
+                int first = blocks[i + c] >> 3;
+                int delta = blocks[i + c] & 7;
+                int second = first + (delta >= 4 ? delta - 8 : delta);
+                if (second < 0 || second > 31) {
+                    blocks[i + 3] &= ~2;
+                }
+            }
+        }
+    }
+
+    static bool writeFile(const char *path, const std::vector<uint8_t> &data) {
+        FILE *file = fopen(path, "wb");
+        if (!file) {
+            fprintf(stderr, "Could not create %s\n", path);
+            return false;
+        }
+        bool written = fwrite(data.data(), 1, data.size(), file) == data.size();
+        written = fclose(file) == 0 && written;
+        if (!written) {
+            fprintf(stderr, "Could not write %s\n", path);
+        }
+        return written;
+    }
+
+    static int writeTestTextures(const char *base) {
+        uint32_t levels = fullMipChain(256, 256);
+        std::string etc1Path = std::string(base) + ".etc1.ktx";
+        std::string etc2Path = std::string(base) + ".etc2.ktx";
+        if (!writeFile(etc1Path.c_str(), buildKtx(GL_ETC1_RGB8_OES, 256, 256, levels, fillCheckerEtc1, false)) ||
+            !writeFile(etc2Path.c_str(), buildKtx(GL_COMPRESSED_RGBA8_ETC2_EAC, 256, 256, levels, fillCheckerEtc2,
+                                                  false))) {
+            return 1;
+        }
+        printf("wrote %s and %s\n", etc1Path.c_str(), etc2Path.c_str());
+        return 0;
+    }
+
+    static int describeFiles(int count, char **paths) {
+        int failures = 0;
+        for (int i = 0; i < count; i++) {
+            FILE *file = fopen(paths[i], "rb");
+            if (!file) {
+                printf("%s: could not open\n", paths[i]);
+                failures++;
+                continue;
+            }
+            std::vector<uint8_t> data;
+            uint8_t buffer[65536];
+            size_t read;
+            while ((read = fread(buffer, 1, sizeof(buffer), file)) > 0) {
+                data.insert(data.end(), buffer, buffer + read);
+            }
+            fclose(file);
+
+            OSVROpenGL::KtxImage image;
+            if (!OSVROpenGL::parseKtx(data.data(), data.size(), &image)) {
+                printf("%s: INVALID\n", paths[i]);
+                failures++;
+                continue;
+            }
+            size_t compressedBytes = 0;
+            size_t rgbaBytes = 0;
+            for (uint32_t level = 0; level < image.levelCount; level++) {
+                compressedBytes += image.levels[level].bytes;
+                rgbaBytes += static_cast<size_t>(image.levels[level].width) * image.levels[level].height * 4;
+            }
+            printf("%s: %s, %ux%u, %u levels, %.1f KB (%.1f KB as RGBA, %.0f%% saved)%s\n", paths[i],
+                   image.format->name, image.width, image.height, image.levelCount, compressedBytes / 1024.0,
+                   rgbaBytes / 1024.0, 100.0 - 100.0 * compressedBytes / rgbaBytes,
+                   OSVROpenGL::canDecodeCompressedFormat(image.format->glInternalFormat) ? "" : ", no CPU decoder");
+        }
+        return failures ? 3 : 0;
+    }
+
+    struct ContainerCase {
+        const char *name;
+        std::vector<uint8_t> file;
+        bool valid;
+    };
+
+    static uint64_t fnv1a(const std::vector<uint8_t> &data) {
+        uint64_t hash = 14695981039346656037ull;
+        for (size_t i = 0; i < data.size(); i++) {
+            hash = (hash ^ data[i]) * 1099511628211ull;
+        }
+        return hash;
+    }
+
+    static int selfCheck() {
+        int failures = 0;
+        std::vector<ContainerCase> cases;
+        uint32_t chain = fullMipChain(64, 32);
+        cases.push_back({ "full chain", buildKtx(GL_ETC1_RGB8_OES, 64, 32, chain, fillCheckerEtc1, false), true });
+        cases.push_back({ "one level", buildKtx(GL_ETC1_RGB8_OES, 64, 32, 1, fillCheckerEtc1, false), true });
+        cases.push_back({ "byte swapped", buildKtx(GL_ETC1_RGB8_OES, 64, 32, chain, fillCheckerEtc1, true), true });
+        cases.push_back({ "odd size, partial blocks",
+                          buildKtx(GL_COMPRESSED_RGBA8_ETC2_EAC, 30, 18, fullMipChain(30, 18), fillCheckerEtc2,
+                                   false), true });
+        cases.push_back({ "ASTC 8x8", buildKtx(0x93B7, 100, 60, fullMipChain(100, 60), fillNoise, false), true });
+        cases.push_back({ "partial chain", buildKtx(GL_ETC1_RGB8_OES, 64, 32, 3, fillCheckerEtc1, false), false });
+
+        ContainerCase truncated = { "truncated", buildKtx(GL_ETC1_RGB8_OES, 64, 32, chain, fillCheckerEtc1, false),
+                                    false };
+        truncated.file.resize(truncated.file.size() - 4);
+        cases.push_back(truncated);
+        ContainerCase wrongSize = { "wrong level size",
+                                    buildKtx(GL_ETC1_RGB8_OES, 64, 32, chain, fillCheckerEtc1, false), false };
+        wrongSize.file[64] += 8;     // level 0's imageSize
+        cases.push_back(wrongSize);
+        ContainerCase identifier = { "bad identifier",
+                                     buildKtx(GL_ETC1_RGB8_OES, 64, 32, 1, fillCheckerEtc1, false), false };
+        identifier.file[5] = '2';
+        cases.push_back(identifier);
+        ContainerCase uncompressed = { "uncompressed", buildKtx(GL_ETC1_RGB8_OES, 64, 32, 1, fillCheckerEtc1, false),
+                                       false };
+        uncompressed.file[16] = 0x01;    // glType GL_UNSIGNED_BYTE
+        uncompressed.file[17] = 0x14;
+        cases.push_back(uncompressed);
+        ContainerCase cubeMap = { "cube map", buildKtx(GL_ETC1_RGB8_OES, 64, 32, 1, fillCheckerEtc1, false), false };
+        cubeMap.file[52] = 6;            // numberOfFaces
+        cases.push_back(cubeMap);
+
+        printf("containers:\n");
+        for (size_t i = 0; i < cases.size(); i++) {
+            OSVROpenGL::KtxImage image;
+            bool parsed = OSVROpenGL::parseKtx(cases[i].file.data(), cases[i].file.size(), &image);
+            bool ok = parsed == cases[i].valid;
+            printf("  %-26s %-9s %s\n", cases[i].name, parsed ? "accepted" : "rejected", ok ? "ok" : "FAILED");
+            failures += ok ? 0 : 1;
+        }
+
+        // Known answers for decoding noise, taken from this decoder after it
+        // matched Mesa's bit for bit.
+        struct DecodeCase {
+            GLenum glInternalFormat;
+            FillBlocks fill;
+            uint64_t expectedHash;
+        };
+        const DecodeCase decodeCases[] = {
+                { GL_ETC1_RGB8_OES, fillNoiseEtc1, 0x7269239a54303642ull },
+                { GL_COMPRESSED_RGB8_ETC2, fillNoise, 0x316719e69ac7bb9eull },
+                { GL_COMPRESSED_RGBA8_ETC2_EAC, fillNoise, 0x7f43ceb491543586ull },
+        };
+        printf("decoder:\n");
+        for (size_t i = 0; i < sizeof(decodeCases) / sizeof(decodeCases[0]); i++) {
+            const OSVROpenGL::CompressedFormatInfo *format =
+                    OSVROpenGL::findCompressedFormat(decodeCases[i].glInternalFormat);
+            gNoiseState = 1;
+            std::vector<uint8_t> blocks(OSVROpenGL::compressedImageBytes(*format, 64, 64));
+            decodeCases[i].fill(0, 64, 64, blocks.data(), blocks.size());
+            std::vector<uint8_t> rgba(64 * 64 * 4);
+            OSVROpenGL::decodeCompressedImage(*format, blocks.data(), 64, 64, rgba.data());
+            uint64_t hash = fnv1a(rgba);
+            bool ok = hash == decodeCases[i].expectedHash;
+            printf("  %-26s %016llx %s\n", format->name, static_cast<unsigned long long>(hash), ok ? "ok" : "FAILED");
+            failures += ok ? 0 : 1;
+        }
+
+        if (failures) {
+            printf("self-check FAILED: %d surprises\n", failures);
+            return 3;
+        }
+        printf("self-check passed\n");
+        return 0;
+    }
+
+    static void printUsage(const char *argv0) {
+        fprintf(stderr, "usage: %s file.ktx... | --write base | --self-check\n", argv0);
+    }
+}
+
+int main(int argc, char **argv) {
+    if (argc == 2 && !strcmp(argv[1], "--self-check")) {
+        return OSVROpenGLHost::selfCheck();
+    }
+    if (argc == 3 && !strcmp(argv[1], "--write")) {
+        return OSVROpenGLHost::writeTestTextures(argv[2]);
+    }
+    if (argc < 2 || argv[1][0] == '-') {
+        OSVROpenGLHost::printUsage(argv[0]);
+        return 2;
+    }
+    return OSVROpenGLHost::describeFiles(argc - 1, argv + 1);
+}
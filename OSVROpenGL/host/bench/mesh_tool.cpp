@@ -0,0 +1,773 @@
+/*
+ * Copyright (C) 2015 Sensics, Inc. and contributors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+// Converts meshes to the scene mesh format (see SceneMesh.h) and reports
+// what the conversion did for the vertex cache:
+//
+//   mesh_tool in.obj out.mesh      converts a Wavefront OBJ file
+//   mesh_tool --samples dir        writes the sample models to dir
+//   mesh_tool --info file.mesh...  checks files and times mapping them
+//
+// Conversion quantizes and indexes the triangles, orders them with Tom
+// Forsyth's vertex cache optimization, regroups them into clusters (cut
+// where the cache starts over, so moving them costs next to nothing) sorted
+// outward-facing first against overdraw, and finally orders the vertices by
+// first use. ACMR (vertex shader runs per triangle) is measured on a
+// 16-entry FIFO cache, as found in mobile GPUs, in the input order, after
+// the cache ordering and after the overdraw ordering; ATVR is the same per
+// vertex, 1.0 being ideal. The samples are a cube, a UV sphere, a torus knot
+// and the sphere with its triangles shuffled, as an unordered export would
+// leave them. renderer_bench --mesh draws a converted file.
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "SceneMesh.h"
+
+namespace OSVROpenGLHost {
+
+    // A triangle corner with everything at full precision.
+    struct Corner {
+        float position[3];
+        float normal[3];
+        float color[4];
+        float uv[2];
+    };
+
+    struct ConversionReport {
+        uint32_t triangles;
+        uint32_t vertices;
+        double inputAcmr;
+        double cacheAcmr;
+        double overdrawAcmr;
+        double atvr;
+        uint32_t clusters;
+        float maxPositionError;
+        size_t floatBytes;      // the same triangles as unindexed float arrays, as the cube is drawn
+        size_t fileBytes;
+        double convertMs;
+        double mapMs;
+    };
+
+    static const uint32_t kFifoCacheSize = 16;
+
+    // Vertex shader invocations per triangle on a FIFO post-transform cache.
+    static uint32_t countCacheMisses(const std::vector<uint32_t> &indices, uint32_t vertexCount,
+                                     uint32_t begin = 0, uint32_t end = UINT32_MAX) {
+        std::vector<uint32_t> insertedAt(vertexCount, 0);
+        uint32_t clock = kFifoCacheSize + 1;
+        uint32_t misses = 0;
+        end = std::min<uint32_t>(end, static_cast<uint32_t>(indices.size()));
+        for (uint32_t i = begin; i < end; i++) {
+            uint32_t vertex = indices[i];
+            if (clock - insertedAt[vertex] > kFifoCacheSize) {
+                insertedAt[vertex] = clock++;
+                misses++;
+            }
+        }
+        return misses;
+    }
+
+    static double acmr(const std::vector<uint32_t> &indices, uint32_t vertexCount) {
+        return indices.empty() ? 0.0 : 3.0 * countCacheMisses(indices, vertexCount) / indices.size();
+    }
+
+    // Tom Forsyth, "Linear-Speed Vertex Cache Optimisation" (2006): greedily
+    // emits the best scoring triangle, where vertices score for sitting in a
+    // modelled LRU cache and for having few triangles left.
+    // Forsyth's 32; it also beats a model matching the 16-entry FIFO measured on.
+    static const int kForsythCacheSize = 32;
+
+    static float forsythVertexScore(int cachePosition, uint32_t remainingTriangles) {
+        if (remainingTriangles == 0) {
+            return -1.0f;
+        }
+        float score = 0.0f;
+        if (cachePosition >= 0) {
+            if (cachePosition < 3) {
+                score = 0.75f;      // used by the last triangle
+            } else {
+                score = powf(1.0f - (cachePosition - 3) / static_cast<float>(kForsythCacheSize - 3), 1.5f);
+            }
+        }
+        return score + 2.0f * powf(static_cast<float>(remainingTriangles), -0.5f);
+    }
+
+    static std::vector<uint32_t> optimizeVertexCache(const std::vector<uint32_t> &indices, uint32_t vertexCount) {
+        uint32_t triangleCount = static_cast<uint32_t>(indices.size() / 3);
+        std::vector<uint32_t> triangleStart(vertexCount + 1, 0);
+        for (size_t i = 0; i < indices.size(); i++) {
+            triangleStart[indices[i] + 1]++;
+        }
+        for (uint32_t v = 0; v < vertexCount; v++) {
+            triangleStart[v + 1] += triangleStart[v];
+        }
+        std::vector<uint32_t> vertexTriangles(indices.size());
+        std::vector<uint32_t> remaining(vertexCount, 0);
+        for (uint32_t t = 0; t < triangleCount; t++) {
+            for (int c = 0; c < 3; c++) {
+                uint32_t v = indices[t * 3 + c];
+                vertexTriangles[triangleStart[v] + remaining[v]++] = t;
+            }
+        }
+
+        std::vector<int> cachePosition(vertexCount, -1);
+        std::vector<float> vertexScore(vertexCount);
+        for (uint32_t v = 0; v < vertexCount; v++) {
+            vertexScore[v] = forsythVertexScore(-1, remaining[v]);
+        }
+        std::vector<float> triangleScore(triangleCount);
+        std::vector<bool> emitted(triangleCount, false);
+        for (uint32_t t = 0; t < triangleCount; t++) {
+            triangleScore[t] = vertexScore[indices[t * 3]] + vertexScore[indices[t * 3 + 1]] +
+                               vertexScore[indices[t * 3 + 2]];
+        }
+
+        std::vector<uint32_t> output;
+        output.reserve(indices.size());
+        std::vector<uint32_t> cache;
+        cache.reserve(kForsythCacheSize + 3);
+        uint32_t scanCursor = 0;
+        int64_t best = -1;
+        while (output.size() < indices.size()) {
+            if (best < 0) {
+                // nothing in the cache touches a triangle left: take the best remaining one
+                float bestScore = -1.0f;
+                while (scanCursor < triangleCount && emitted[scanCursor]) {
+                    scanCursor++;
+                }
+                for (uint32_t t = scanCursor; t < triangleCount; t++) {
+                    if (!emitted[t] && triangleScore[t] > bestScore) {
+                        bestScore = triangleScore[t];
+                        best = t;
+                    }
+                }
+            }
+            uint32_t triangle = static_cast<uint32_t>(best);
+            emitted[triangle] = true;
+
+            // the triangle's vertices move to the front of the cache, and lose it as a remaining triangle
+            std::vector<uint32_t> newCache;
+            newCache.reserve(kForsythCacheSize + 3);
+            for (int c = 0; c < 3; c++) {
+                uint32_t v = indices[triangle * 3 + c];
+                output.push_back(v);
+                newCache.push_back(v);
+                uint32_t *begin = &vertexTriangles[triangleStart[v]];
+                uint32_t *end = begin + remaining[v];
+                *std::find(begin, end, triangle) = *(end - 1);
+                remaining[v]--;
+            }
+            for (size_t i = 0; i < cache.size(); i++) {
+                uint32_t v = cache[i];
+                if (v != newCache[0] && v != newCache[1] && v != newCache[2]) {
+                    newCache.push_back(v);
+                }
+            }
+            for (size_t i = kForsythCacheSize; i < newCache.size(); i++) {
+                cachePosition[newCache[i]] = -1;
+                vertexScore[newCache[i]] = forsythVertexScore(-1, remaining[newCache[i]]);
+            }
+            if (newCache.size() > static_cast<size_t>(kForsythCacheSize)) {
+                newCache.resize(kForsythCacheSize);
+            }
+            cache.swap(newCache);
+
+            // rescore what is in the cache; the next triangle is the best one touching it
+            for (size_t i = 0; i < cache.size(); i++) {
+                cachePosition[cache[i]] = static_cast<int>(i);
+                vertexScore[cache[i]] = forsythVertexScore(static_cast<int>(i), remaining[cache[i]]);
+            }
+            best = -1;
+            float bestScore = -1.0f;
+            for (size_t i = 0; i < cache.size(); i++) {
+                uint32_t v = cache[i];
+                for (uint32_t j = triangleStart[v]; j < triangleStart[v] + remaining[v]; j++) {
+                    uint32_t t = vertexTriangles[j];
+                    triangleScore[t] = vertexScore[indices[t * 3]] + vertexScore[indices[t * 3 + 1]] +
+                                       vertexScore[indices[t * 3 + 2]];
+                    if (triangleScore[t] > bestScore) {
+                        bestScore = triangleScore[t];
+                        best = t;
+                    }
+                }
+            }
+        }
+        return output;
+    }
+
+    // Cuts the cache ordered triangles into clusters, then puts the clusters
+    // facing away from the mesh's center first, as Tipsify's overdraw pass
+    // does: from outside, those are the ones in front, so the depth test
+    // rejects more of what comes later. Clusters start where a triangle misses
+    // the cache with all three vertices (the cache starts over there anyway),
+    // and within those wherever the cluster so far has got its ACMR down to
+    // kOverdrawAcmrThreshold times that of the whole; the cache is taken to
+    // start over there too, so no order of the clusters costs more than that.
+    static const double kOverdrawAcmrThreshold = 1.05;
+
+    static std::vector<uint32_t> optimizeOverdraw(const std::vector<uint32_t> &indices,
+                                                  const std::vector<Corner> &vertices, uint32_t *clusterCountOut) {
+        uint32_t triangleCount = static_cast<uint32_t>(indices.size() / 3);
+        std::vector<uint32_t> hardStart;
+        std::vector<uint32_t> insertedAt(vertices.size(), 0);
+        uint32_t clock = kFifoCacheSize + 1;
+        for (uint32_t t = 0; t < triangleCount; t++) {
+            uint32_t misses = 0;
+            for (int c = 0; c < 3; c++) {
+                uint32_t v = indices[t * 3 + c];
+                if (clock - insertedAt[v] > kFifoCacheSize) {
+                    insertedAt[v] = clock++;
+                    misses++;
+                }
+            }
+            if (t == 0 || misses == 3) {
+                hardStart.push_back(t);
+            }
+        }
+        hardStart.push_back(triangleCount);
+
+        std::vector<uint32_t> clusterStart;
+        for (size_t hard = 0; hard + 1 < hardStart.size(); hard++) {
+            uint32_t begin = hardStart[hard];
+            uint32_t end = hardStart[hard + 1];
+            double target = kOverdrawAcmrThreshold * countCacheMisses(indices, static_cast<uint32_t>(vertices.size()),
+                                                                      begin * 3, end * 3) / (end - begin);
+            clock += kFifoCacheSize + 1;
+            clusterStart.push_back(begin);
+            uint32_t runningMisses = 0;
+            uint32_t runningTriangles = 0;
+            for (uint32_t t = begin; t < end; t++) {
+                for (int c = 0; c < 3; c++) {
+                    uint32_t v = indices[t * 3 + c];
+                    if (clock - insertedAt[v] > kFifoCacheSize) {
+                        insertedAt[v] = clock++;
+                        runningMisses++;
+                    }
+                }
+                runningTriangles++;
+                if (t + 1 < end && runningMisses <= target * runningTriangles) {
+                    clusterStart.push_back(t + 1);
+                    clock += kFifoCacheSize + 1;
+                    runningMisses = runningTriangles = 0;
+                }
+            }
+        }
+        clusterStart.push_back(triangleCount);
+        uint32_t clusterCount = static_cast<uint32_t>(clusterStart.size() - 1);
+
+        double meshCenter[3] = { 0.0, 0.0, 0.0 };
+        double totalArea = 0.0;
+        std::vector<double> clusterKey(clusterCount);
+        std::vector<double> clusterCentroid(clusterCount * 3, 0.0);
+        std::vector<double> clusterNormal(clusterCount * 3, 0.0);
+        std::vector<double> clusterArea(clusterCount, 0.0);
+        for (uint32_t cluster = 0; cluster < clusterCount; cluster++) {
+            for (uint32_t t = clusterStart[cluster]; t < clusterStart[cluster + 1]; t++) {
+                const float *p0 = vertices[indices[t * 3]].position;
+                const float *p1 = vertices[indices[t * 3 + 1]].position;
+                const float *p2 = vertices[indices[t * 3 + 2]].position;
+                double e1[3] = { p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2] };
+                double e2[3] = { p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2] };
+                double normal[3] = { e1[1] * e2[2] - e1[2] * e2[1], e1[2] * e2[0] - e1[0] * e2[2],
+                                     e1[0] * e2[1] - e1[1] * e2[0] };
+                double area = 0.5 * sqrt(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+                for (int axis = 0; axis < 3; axis++) {
+                    double centroid = (p0[axis] + p1[axis] + p2[axis]) / 3.0;
+                    clusterCentroid[cluster * 3 + axis] += centroid * area;
+                    clusterNormal[cluster * 3 + axis] += normal[axis];
+                    meshCenter[axis] += centroid * area;
+                }
+                clusterArea[cluster] += area;
+                totalArea += area;
+            }
+        }
+        for (int axis = 0; axis < 3 && totalArea > 0.0; axis++) {
+            meshCenter[axis] /= totalArea;
+        }
+        for (uint32_t cluster = 0; cluster < clusterCount; cluster++) {
+            double length = 0.0;
+            double key = 0.0;
+            for (int axis = 0; axis < 3; axis++) {
+                length += clusterNormal[cluster * 3 + axis] * clusterNormal[cluster * 3 + axis];
+            }
+            length = sqrt(length);
+            for (int axis = 0; axis < 3 && length > 0.0 && clusterArea[cluster] > 0.0; axis++) {
+                double centroid = clusterCentroid[cluster * 3 + axis] / clusterArea[cluster];
+                key += (centroid - meshCenter[axis]) * clusterNormal[cluster * 3 + axis] / length;
+            }
+            clusterKey[cluster] = key;
+        }
+
+        std::vector<uint32_t> order(clusterCount);
+        for (uint32_t cluster = 0; cluster < clusterCount; cluster++) {
+            order[cluster] = cluster;
+        }
+        std::stable_sort(order.begin(), order.end(), [&clusterKey](uint32_t a, uint32_t b) {
+            return clusterKey[a] > clusterKey[b];
+        });
+        std::vector<uint32_t> output;
+        output.reserve(indices.size());
+        for (uint32_t i = 0; i < clusterCount; i++) {
+            uint32_t cluster = order[i];
+            output.insert(output.end(), indices.begin() + clusterStart[cluster] * 3,
+                          indices.begin() + clusterStart[cluster + 1] * 3);
+        }
+        *clusterCountOut = clusterCount;
+        return output;
+    }
+
+    static int16_t quantizeSnorm16(float value) {
+        value = value < -1.0f ? -1.0f : (value > 1.0f ? 1.0f : value);
+        return static_cast<int16_t>(lrintf(value * 32767.0f));
+    }
+
+    static int8_t quantizeSnorm8(float value) {
+        value = value < -1.0f ? -1.0f : (value > 1.0f ? 1.0f : value);
+        return static_cast<int8_t>(lrintf(value * 127.0f));
+    }
+
+    static uint8_t quantizeUnorm8(float value) {
+        value = value < 0.0f ? 0.0f : (value > 1.0f ? 1.0f : value);
+        return static_cast<uint8_t>(lrintf(value * 255.0f));
+    }
+
+    static bool convertCorners(const std::vector<Corner> &corners, const char *outputPath,
+                               ConversionReport *reportOut) {
+        auto startTime = std::chrono::steady_clock::now();
+        ConversionReport &report = *reportOut;
+        memset(&report, 0, sizeof(report));
+        report.triangles = static_cast<uint32_t>(corners.size() / 3);
+        report.floatBytes = corners.size() * (3 + 4 + 2) * sizeof(float);
+        if (corners.empty() || corners.size() % 3 != 0) {
+            fprintf(stderr, "%s: no triangles\n", outputPath);
+            return false;
+        }
+
+        float minimum[3] = { INFINITY, INFINITY, INFINITY };
+        float maximum[3] = { -INFINITY, -INFINITY, -INFINITY };
+        for (size_t i = 0; i < corners.size(); i++) {
+            for (int axis = 0; axis < 3; axis++) {
+                minimum[axis] = std::min(minimum[axis], corners[i].position[axis]);
+                maximum[axis] = std::max(maximum[axis], corners[i].position[axis]);
+            }
+        }
+        float scale[3];
+        float offset[3];
+        for (int axis = 0; axis < 3; axis++) {
+            offset[axis] = 0.5f * (minimum[axis] + maximum[axis]);
+            scale[axis] = 0.5f * (maximum[axis] - minimum[axis]);
+            if (!(scale[axis] > 0.0f)) {
+                scale[axis] = 1.0f;     // flat along this axis
+            }
+        }
+
+        // Quantize, then index: corners that quantize the same are one vertex.
+        std::vector<OSVROpenGL::SceneMeshVertex> quantized;
+        std::vector<Corner> unique;
+        std::vector<uint32_t> indices(corners.size());
+        std::unordered_map<std::string, uint32_t> vertexIndex;
+        for (size_t i = 0; i < corners.size(); i++) {
+            const Corner &corner = corners[i];
+            OSVROpenGL::SceneMeshVertex vertex;
+            memset(&vertex, 0, sizeof(vertex));
+            for (int axis = 0; axis < 3; axis++) {
+                vertex.position[axis] = quantizeSnorm16((corner.position[axis] - offset[axis]) / scale[axis]);
+                vertex.normal[axis] = quantizeSnorm8(corner.normal[axis]);
+                float error = fabsf(vertex.position[axis] / 32767.0f * scale[axis] + offset[axis] -
+                                    corner.position[axis]);
+                report.maxPositionError = std::max(report.maxPositionError, error);
+            }
+            for (int channel = 0; channel < 4; channel++) {
+                vertex.color[channel] = quantizeUnorm8(corner.color[channel]);
+            }
+            vertex.uv[0] = OSVROpenGL::floatToHalf(corner.uv[0]);
+            vertex.uv[1] = OSVROpenGL::floatToHalf(corner.uv[1]);
+            std::string key(reinterpret_cast<const char *>(&vertex), sizeof(vertex));
+            auto found = vertexIndex.find(key);
+            if (found == vertexIndex.end()) {
+                found = vertexIndex.emplace(key, static_cast<uint32_t>(quantized.size())).first;
+                quantized.push_back(vertex);
+                unique.push_back(corner);
+            }
+            indices[i] = found->second;
+        }
+        uint32_t vertexCount = static_cast<uint32_t>(quantized.size());
+        report.vertices = vertexCount;
+        report.inputAcmr = acmr(indices, vertexCount);
+
+        indices = optimizeVertexCache(indices, vertexCount);
+        report.cacheAcmr = acmr(indices, vertexCount);
+        indices = optimizeOverdraw(indices, unique, &report.clusters);
+        report.overdrawAcmr = acmr(indices, vertexCount);
+        report.atvr = static_cast<double>(countCacheMisses(indices, vertexCount)) / vertexCount;
+
+        // vertices in the order the triangles first use them, for fetch locality
+        std::vector<uint32_t> remap(vertexCount, UINT32_MAX);
+        std::vector<OSVROpenGL::SceneMeshVertex> ordered;
+        ordered.reserve(vertexCount);
+        for (size_t i = 0; i < indices.size(); i++) {
+            uint32_t &newIndex = remap[indices[i]];
+            if (newIndex == UINT32_MAX) {
+                newIndex = static_cast<uint32_t>(ordered.size());
+                ordered.push_back(quantized[indices[i]]);
+            }
+            indices[i] = newIndex;
+        }
+
+        if (!OSVROpenGL::writeSceneMeshFile(outputPath, scale, offset, ordered, indices)) {
+            return false;
+        }
+        report.convertMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() -
+                                                                     startTime).count();
+
+        // the loader's side: map and check (the GL upload is timed by renderer_bench --mesh)
+        auto mapStart = std::chrono::steady_clock::now();
+        OSVROpenGL::MappedSceneMesh mapped;
+        if (!OSVROpenGL::mapSceneMeshFile(outputPath, &mapped)) {
+            return false;
+        }
+        report.fileBytes = mapped.file.bytes;
+        OSVROpenGL::unmapSceneMeshFile(&mapped);
+        report.mapMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() -
+                                                                 mapStart).count();
+        return true;
+    }
+
+    static void printReportHeader() {
+        printf("%-14s %9s %9s  %-21s %6s %8s  %9s %9s %9s %8s %8s\n", "model", "triangles", "vertices",
+               "ACMR in/cache/overdraw", "ATVR", "clusters", "float KB", "file KB", "max error", "convert",
+               "map");
+    }
+
+    static void printReport(const char *name, const ConversionReport &report) {
+        printf("%-14s %9u %9u  %5.3f / %5.3f / %5.3f %6.3f %8u  %9.1f %9.1f %9.2e %6.2fms %6.3fms\n", name,
+               report.triangles, report.vertices, report.inputAcmr, report.cacheAcmr, report.overdrawAcmr,
+               report.atvr, report.clusters, report.floatBytes / 1024.0, report.fileBytes / 1024.0,
+               report.maxPositionError, report.convertMs, report.mapMs);
+    }
+
+    static void addTriangle(std::vector<Corner> *corners, const Corner &a, const Corner &b, const Corner &c) {
+        corners->push_back(a);
+        corners->push_back(b);
+        corners->push_back(c);
+    }
+
+    static Corner makeCorner(float x, float y, float z, float nx, float ny, float nz, float u, float v) {
+        Corner corner = { { x, y, z }, { nx, ny, nz }, { 1.0f, 1.0f, 1.0f, 1.0f }, { u, v } };
+        return corner;
+    }
+
+    // The renderer's cube: unit half extent, a face per axis direction.
+    static std::vector<Corner> makeCube() {
+        std::vector<Corner> corners;
+        for (int face = 0; face < 6; face++) {
+            int axis = face / 2;
+            float sign = face % 2 ? -1.0f : 1.0f;
+            Corner quad[4];
+            for (int i = 0; i < 4; i++) {
+                float a = (i == 1 || i == 2) ? 1.0f : -1.0f;
+                float b = i >= 2 ? 1.0f : -1.0f;
+                float position[3];
+                float normal[3] = { 0.0f, 0.0f, 0.0f };
+                position[axis] = sign;
+                position[(axis + 1) % 3] = a * sign;
+                position[(axis + 2) % 3] = b;
+                normal[axis] = sign;
+                quad[i] = makeCorner(position[0], position[1], position[2], normal[0], normal[1], normal[2],
+                                     (a + 1.0f) * 0.5f, (b + 1.0f) * 0.5f);
+            }
+            addTriangle(&corners, quad[0], quad[1], quad[2]);
+            addTriangle(&corners, quad[0], quad[2], quad[3]);
+        }
+        return corners;
+    }
+
+    // Latitude-longitude grid; the seam and pole vertices differ in uv.
+    static std::vector<Corner> makeSphere(int slices, int stacks) {
+        std::vector<Corner> grid;
+        for (int stack = 0; stack <= stacks; stack++) {
+            float v = static_cast<float>(stack) / stacks;
+            float theta = v * static_cast<float>(M_PI);
+            for (int slice = 0; slice <= slices; slice++) {
+                float u = static_cast<float>(slice) / slices;
+                float phi = u * 2.0f * static_cast<float>(M_PI);
+                float x = sinf(theta) * cosf(phi);
+                float y = cosf(theta);
+                float z = sinf(theta) * sinf(phi);
+                grid.push_back(makeCorner(x, y, z, x, y, z, u, v));
+            }
+        }
+        std::vector<Corner> corners;
+        for (int stack = 0; stack < stacks; stack++) {
+            for (int slice = 0; slice < slices; slice++) {
+                int a = stack * (slices + 1) + slice;
+                int b = a + slices + 1;
+                if (stack > 0) {
+                    addTriangle(&corners, grid[a], grid[a + 1], grid[b]);
+                }
+                if (stack < stacks - 1) {
+                    addTriangle(&corners, grid[a + 1], grid[b + 1], grid[b]);
+                }
+            }
+        }
+        return corners;
+    }
+
+    // A (2,3) torus knot swept with a circle: long, thin and self-overlapping.
+    static std::vector<Corner> makeTorusKnot(int segments, int sides) {
+        const float tubeRadius = 0.12f;
+        std::vector<Corner> grid;
+        for (int segment = 0; segment <= segments; segment++) {
+            float t = 2.0f * static_cast<float>(M_PI) * segment / segments;
+            float center[3];
+            float ahead[3];
+            for (int k = 0; k < 2; k++) {
+                float s = t + k * 0.01f;
+                float r = 0.55f + 0.25f * cosf(3.0f * s);
+                float *p = k == 0 ? center : ahead;
+                p[0] = r * cosf(2.0f * s);
+                p[1] = r * sinf(2.0f * s);
+                p[2] = 0.25f * sinf(3.0f * s);
+            }
+            float tangent[3] = { ahead[0] - center[0], ahead[1] - center[1], ahead[2] - center[2] };
+            float length = sqrtf(tangent[0] * tangent[0] + tangent[1] * tangent[1] + tangent[2] * tangent[2]);
+            for (int axis = 0; axis < 3; axis++) {
+                tangent[axis] /= length;
+            }
+            // frame from the tangent and the z axis
+            float side[3] = { tangent[1], -tangent[0], 0.0f };
+            length = sqrtf(side[0] * side[0] + side[1] * side[1]);
+            side[0] /= length;
+            side[1] /= length;
+            float up[3] = { tangent[1] * side[2] - tangent[2] * side[1], tangent[2] * side[0] - tangent[0] * side[2],
+                            tangent[0] * side[1] - tangent[1] * side[0] };
+            for (int around = 0; around <= sides; around++) {
+                float angle = 2.0f * static_cast<float>(M_PI) * around / sides;
+                float normal[3];
+                for (int axis = 0; axis < 3; axis++) {
+                    normal[axis] = cosf(angle) * side[axis] + sinf(angle) * up[axis];
+                }
+                grid.push_back(makeCorner(center[0] + tubeRadius * normal[0], center[1] + tubeRadius * normal[1],
+                                          center[2] + tubeRadius * normal[2], normal[0], normal[1], normal[2],
+                                          static_cast<float>(segment) / segments,
+                                          static_cast<float>(around) / sides));
+            }
+        }
+        std::vector<Corner> corners;
+        for (int segment = 0; segment < segments; segment++) {
+            for (int around = 0; around < sides; around++) {
+                int a = segment * (sides + 1) + around;
+                int b = a + sides + 1;
+                addTriangle(&corners, grid[a], grid[b], grid[a + 1]);
+                addTriangle(&corners, grid[a + 1], grid[b], grid[b + 1]);
+            }
+        }
+        return corners;
+    }
+
+    static std::vector<Corner> shuffleTriangles(std::vector<Corner> corners) {
+        uint32_t state = 1;
+        for (size_t i = corners.size() / 3; i > 1; i--) {
+            state = state * 1664525u + 1013904223u;
+            size_t j = state % i;
+            std::swap_ranges(corners.begin() + (i - 1) * 3, corners.begin() + i * 3, corners.begin() + j * 3);
+        }
+        return corners;
+    }
+
+    static int writeSamples(const char *directory) {
+        struct Sample {
+            const char *name;
+            std::vector<Corner> corners;
+        };
+        std::vector<Sample> samples;
+        samples.push_back({ "cube", makeCube() });
+        samples.push_back({ "sphere", makeSphere(128, 64) });
+        samples.push_back({ "torus_knot", makeTorusKnot(512, 24) });
+        samples.push_back({ "sphere_shuffled", shuffleTriangles(makeSphere(128, 64)) });
+
+        printReportHeader();
+        for (size_t i = 0; i < samples.size(); i++) {
+            std::string path = std::string(directory) + "/" + samples[i].name + ".mesh";
+            ConversionReport report;
+            if (!convertCorners(samples[i].corners, path.c_str(), &report)) {
+                return 1;
+            }
+            printReport(samples[i].name, report);
+        }
+        return 0;
+    }
+
+    // v x y z [r g b], vt u v, vn x y z and f with any of the v, v/vt, v//vn
+    // and v/vt/vn forms (negative indices count back); polygons become fans.
+    static bool readObj(const char *path, std::vector<Corner> *cornersOut) {
+        FILE *file = fopen(path, "r");
+        if (!file) {
+            fprintf(stderr, "Could not open %s\n", path);
+            return false;
+        }
+        std::vector<float> positions;
+        std::vector<float> colors;
+        std::vector<float> uvs;
+        std::vector<float> normals;
+        char line[4096];
+        int lineNumber = 0;
+        bool ok = true;
+        while (ok && fgets(line, sizeof(line), file)) {
+            lineNumber++;
+            float values[6];
+            if (!strncmp(line, "v ", 2)) {
+                int count = sscanf(line + 2, "%f %f %f %f %f %f", &values[0], &values[1], &values[2],
+                                   &values[3], &values[4], &values[5]);
+                if (count < 3) {
+                    ok = false;
+                    break;
+                }
+                positions.insert(positions.end(), values, values + 3);
+                colors.push_back(count == 6 ? values[3] : 1.0f);
+                colors.push_back(count == 6 ? values[4] : 1.0f);
+                colors.push_back(count == 6 ? values[5] : 1.0f);
+            } else if (!strncmp(line, "vt ", 3)) {
+                values[1] = 0.0f;
+                if (sscanf(line + 3, "%f %f", &values[0], &values[1]) < 1) {
+                    ok = false;
+                    break;
+                }
+                uvs.insert(uvs.end(), values, values + 2);
+            } else if (!strncmp(line, "vn ", 3)) {
+                if (sscanf(line + 3, "%f %f %f", &values[0], &values[1], &values[2]) != 3) {
+                    ok = false;
+                    break;
+                }
+                float length = sqrtf(values[0] * values[0] + values[1] * values[1] + values[2] * values[2]);
+                for (int axis = 0; axis < 3 && length > 0.0f; axis++) {
+                    values[axis] /= length;
+                }
+                normals.insert(normals.end(), values, values + 3);
+            } else if (!strncmp(line, "f ", 2)) {
+                std::vector<Corner> polygon;
+                for (char *token = strtok(line + 2, " \t\r\n"); token; token = strtok(nullptr, " \t\r\n")) {
+                    long index[3] = { 0, 0, 0 };
+                    const long count[3] = { static_cast<long>(positions.size() / 3),
+                                            static_cast<long>(uvs.size() / 2),
+                                            static_cast<long>(normals.size() / 3) };
+                    char *cursor = token;
+                    for (int part = 0; part < 3 && *cursor; part++) {
+                        if (*cursor != '/') {
+                            index[part] = strtol(cursor, &cursor, 10);
+                            index[part] = index[part] < 0 ? count[part] + index[part] + 1 : index[part];
+                            if (index[part] < 1 || index[part] > count[part]) {
+                                ok = false;
+                            }
+                        }
+                        if (*cursor == '/') {
+                            cursor++;
+                        }
+                    }
+                    if (!ok || index[0] == 0) {
+                        ok = false;
+                        break;
+                    }
+                    Corner corner;
+                    memset(&corner, 0, sizeof(corner));
+                    memcpy(corner.position, &positions[(index[0] - 1) * 3], sizeof(corner.position));
+                    memcpy(corner.color, &colors[(index[0] - 1) * 3], 3 * sizeof(float));
+                    corner.color[3] = 1.0f;
+                    if (index[1]) {
+                        memcpy(corner.uv, &uvs[(index[1] - 1) * 2], sizeof(corner.uv));
+                    }
+                    if (index[2]) {
+                        memcpy(corner.normal, &normals[(index[2] - 1) * 3], sizeof(corner.normal));
+                    }
+                    polygon.push_back(corner);
+                }
+                for (size_t i = 2; ok && i < polygon.size(); i++) {
+                    addTriangle(cornersOut, polygon[0], polygon[i - 1], polygon[i]);
+                }
+            }
+        }
+        fclose(file);
+        if (!ok) {
+            fprintf(stderr, "%s:%d: could not read this line\n", path, lineNumber);
+        }
+        return ok;
+    }
+
+    static int describeFiles(int count, char **paths) {
+        int failures = 0;
+        for (int i = 0; i < count; i++) {
+            auto startTime = std::chrono::steady_clock::now();
+            OSVROpenGL::MappedSceneMesh mapped;
+            if (!OSVROpenGL::mapSceneMeshFile(paths[i], &mapped)) {
+                printf("%s: INVALID\n", paths[i]);
+                failures++;
+                continue;
+            }
+            double mapMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() -
+                                                                     startTime).count();
+            const OSVROpenGL::SceneMeshFileHeader &header = *mapped.header;
+            std::vector<uint32_t> indices(header.indexCount);
+            for (uint32_t j = 0; j < header.indexCount; j++) {
+                indices[j] = header.indexSize == 2 ? static_cast<const uint16_t *>(mapped.indices)[j]
+                                                   : static_cast<const uint32_t *>(mapped.indices)[j];
+            }
+            printf("%s: %u triangles, %u vertices, %u-bit indices, ACMR %.3f, ATVR %.3f, %.1f KB, mapped in %.3f ms\n",
+                   paths[i], header.indexCount / 3, header.vertexCount, header.indexSize * 8,
+                   acmr(indices, header.vertexCount),
+                   static_cast<double>(countCacheMisses(indices, header.vertexCount)) / header.vertexCount,
+                   mapped.file.bytes / 1024.0, mapMs);
+            OSVROpenGL::unmapSceneMeshFile(&mapped);
+        }
+        return failures ? 3 : 0;
+    }
+
+    static void printUsage(const char *argv0) {
+        fprintf(stderr, "usage: %s in.obj out.mesh | --samples dir | --info file.mesh...\n", argv0);
+    }
+}
+
+int main(int argc, char **argv) {
+    if (argc == 3 && !strcmp(argv[1], "--samples")) {
+        return OSVROpenGLHost::writeSamples(argv[2]);
+    }
+    if (argc >= 3 && !strcmp(argv[1], "--info")) {
+        return OSVROpenGLHost::describeFiles(argc - 2, argv + 2);
+    }
+    if (argc != 3 || argv[1][0] == '-') {
+        OSVROpenGLHost::printUsage(argv[0]);
+        return 2;
+    }
+    std::vector<OSVROpenGLHost::Corner> corners;
+    if (!OSVROpenGLHost::readObj(argv[1], &corners)) {
+        return 1;
+    }
+    OSVROpenGLHost::ConversionReport report;
+    if (!OSVROpenGLHost::convertCorners(corners, argv[2], &report)) {
+        return 1;
+    }
+    OSVROpenGLHost::printReportHeader();
+    OSVROpenGLHost::printReport(argv[1], report);
+    return 0;
+}
@@ -0,0 +1,1376 @@
+/*
+ * Copyright (C) 2015 Sensics, Inc. and contributors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+// Runs the rendering core headless against the OSVR stub and reports frame
+// times, GL call counts and allocation counts:
+//
+//   renderer_bench [--frames N] [--warmup N] [--width W] [--height H]
+//                  [--camera-every N] [--camera-size WxH] [--trace out.json]
+//                  [--record out.bin | --replay in.bin [--replay-speed S]] [--checksum]
+//                  [--latency [--latency-pattern]] [--alloc-gate N]
+//                  [--frames-in-flight N] [--jit [--display-hz H]]
+//                  [--objects N] [--workers N]
+//                  [--async-reprojection] [--slow-frame-ms N [--slow-every N]]
+//                  [--distortion-mesh config.json [--distortion-grid WxH] [--distortion-cache dir]]
+//                  [--texture path] [--mesh file] [--lifecycle-cycles N]
+//                  [--camera-layer] [--layer-compare] [--external-camera egl|cpu]
+//                  [--camera-channels 1|3|4] [--cpu-kernels scalar|neon|sse4.1|avx2]
+//                  [--thermal-sim [--thermal-seconds-per-frame S] [--thermal-trace out.csv]]
+//                  [--eye-buffer-samples N]
+//                  [--capture dir [--capture-every N] [--capture-format png|pam]
+//                   [--capture-window] [--capture-latency N] [--golden dir [--golden-tolerance N]]]
+//                  [--gpu-budget KB [--gpu-budget-at FRAME:KB]]
+//                  [--materials N [--texture-batching none|atlas|array] [--material-atlas file]]
+//
+// Each measured frame is renderFrame() plus eglSwapBuffers(), exactly as the
+// GLSurfaceView drives it on device.
+//
+// --record captures the stub's reports and head poses; --replay renders from
+// such a recording instead (one recorded frame per rendered frame unless a
+// --replay-speed is given, looping at the end). --checksum prints a hash of
+// the last frame's pixels, so two runs can be checked for identical output.
+//
+// --latency adds the motion-to-photon stages to the table, measured against
+// the stub's head pose: its timestamps are synthetic, but real time passes
+// between an update and "now", so the ages are the renderer's own.
+// --latency-pattern also draws the flash-on-motion patch.
+//
+// --alloc-gate N makes the run fail (exit status 3) if any frame from the Nth
+// on, warmup included, allocates on any thread: the steady-state frame must
+// not touch the heap.
+//
+// --frames-in-flight sets the frame pacer's depth (1-3, default 2) and --jit
+// turns on its just-in-time start against a --display-hz display (default 60).
+// A pbuffer swap never waits for vsync, so here the idle only shows up when
+// a frame's CPU work is well under the display period.
+//
+// --objects surrounds the room cube with spinning cubes (N includes the room
+// cube, default 1) and --workers sets the job worker threads that update them
+// besides the render thread (default: one per spare core). See scene_bench
+// for the update on its own.
+//
+// --async-reprojection moves the app's frames to their own thread and makes
+// renderFrame() the display side, rotating the last finished frame to the
+// newest pose whenever the app's next one isn't done. The display loop is
+// then paced to --display-hz, as vsync would, and the run reports how many
+// display frames were fresh and how many reprojected. --slow-frame-ms makes
+// every --slow-every'th frame (default every one) that much slower, to show
+// it off; it slows the synchronous path just the same.
+//
+// --distortion-mesh presents through the lens distortion mesh built from the
+// server config's display descriptor (--distortion-grid cells per eye, default
+// 32x32) instead of through RenderManager. With --distortion-cache the mesh is
+// written there on the first run and mapped on later ones, and so is the
+// parsed display descriptor. See distortion_mesh_tool for picking the grid.
+//
+// Paths starting with "asset:" (e.g. asset:osvr_server_config.json) are
+// opened from the app's assets directory, as the app opens them from its APK.
+//
+// --texture puts a KTX texture on the cubes instead of the camera feed: the
+// file itself, or the best variant of path.{astc,etc2,etc1}.ktx the context
+// samples from (see ktx_tool --write for some). The run reports its texture
+// memory against the same texture as RGBA.
+//
+// --mesh draws every object with a mesh converted by mesh_tool instead of the
+// built-in cube, depth tested, and reports how long mapping and uploading it took.
+//
+// --lifecycle-cycles N then takes the renderer through N rounds of pause and
+// resume of each kind: with the context kept (a new surface), with the
+// context kept and a config change (one stale resource), with the context
+// lost (a new context), and the full stop and restart resuming used to be.
+// Each reports the GPU resources rebuilt and the time from resume to the first
+// frame; the run fails (exit status 3) if any round rebuilt other than it should.
+//
+// --camera-layer shows the camera feed on a head-locked quad layer instead of
+// on the cubes, and reports how many pixels compositing it shaded per frame:
+// with --distortion-mesh it is composited at display resolution in the present
+// step, otherwise drawn into the eye buffers before RenderManager gets them.
+//
+// --layer-compare renders nothing else: it puts a --camera-size zone plate on
+// that layer and presents it through the distortion mesh (--distortion-mesh,
+// default asset:osvr_server_config.json) both ways, drawn into eye buffers
+// of a range of sizes and then warped, and composited straight through the
+// mesh. Each is timed over --frames presents and compared against the layer
+// sampled exactly on the CPU (the mesh's texture coordinates, the layer's
+// homography, a bilinear lookup), as PSNR over the pixels the layer covers.
+//
+// --external-camera feeds the camera layer from a producer thread instead of
+// the stub's imaging reports, through the external image stream: egl hands
+// over EGLImages of textures in the producer's own context, which are
+// sampled where they are; cpu hands over buffers in memory, which are
+// uploaded. Frames come at --display-hz / --camera-every. The run reports
+// the copies the imports avoided and each frame's latency from being
+// handed over to being latched.
+//
+// --camera-channels makes the stub's camera frames grey or RGB, which the
+// renderer expands to RGBA before uploading them. --cpu-kernels runs the
+// scene and pixel kernels at that level instead of the best the CPU has (see
+// cpu_kernel_tool for checking the levels against each other).
+//
+// --thermal-sim turns on the thermal governor with the host thermal model
+// (see HostThermalModel.h) as its sensor, each frame standing for
+// --thermal-seconds-per-frame of the model's time (default 2, so a 1200
+// frame run covers 40 minutes), and reports the time spent in each quality
+// tier and the temperature reached. --thermal-trace writes the governor's
+// readings and decisions as CSV, which thermal_tool replays against the
+// policy. --eye-buffer-samples asks for multisampled eye buffers (the
+// governor's tiers cap it further); it needs
+// EXT_multisampled_render_to_texture, which llvmpipe doesn't have.
+//
+// --capture writes the eye buffers of every --capture-every'th frame (default
+// every one) to dir through the asynchronous readback the app uses, and the
+// window too with --capture-window, collecting each frame's copies
+// --capture-latency frames later (default 3). The run reports what the
+// captures cost the render thread and how long the writer took.
+// --golden then compares each image in its dir with the capture's image of
+// the same name and fails the run (exit status 3) if any is missing, of
+// another size, or off by more than --golden-tolerance (default 0) in any
+// channel. Capture a --replay run once to make the golden images.
+//
+// The run always reports the GPU memory the renderer has asked for, by
+// category. --gpu-budget holds it to that many KB: over it, the --texture's
+// top mip levels are dropped (read back from the file on a loader thread)
+// until it fits, and brought back when there is room again. --gpu-budget-at
+// changes the budget at that frame (0 for none), e.g. to relax it again
+// after a tight start. The run reports the evictions, the restores and the
+// longest a frame spent uploading levels.
+//
+// --materials gives the spinning cubes N materials (see Materials.h), taken
+// in turn, as --texture-batching says: none binds a texture per material,
+// atlas (the default) packs them into atlas pages at load, or takes them as
+// packed in a --material-atlas built by atlas_tool, and array puts them in
+// the layers of a texture array. The run reports the texture binds and
+// draws per frame, and the draws saved by merging objects that share a page.
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <dirent.h>
+
+#include <GLES2/gl2.h>
+
+#include <OSVRStub.h>
+
+#include "Renderer.h"
+#include "DistortionMesh.h"
+#include "CompressedTexture.h"
+#include "GpuMemory.h"
+#include "CpuDispatch.h"
+#include "SceneMesh.h"
+#include "FrameStats.h"
+#include "Trace.h"
+#include "Recording.h"
+#include "LatencyMonitor.h"
+#include "FramePacer.h"
+#include "JobSystem.h"
+#include "Lifecycle.h"
+#include "Layers.h"
+#include "ExternalImage.h"
+#include "Reprojection.h"
+#include "Scene.h"
+#include "Asset.h"
+#include "ThermalGovernor.h"
+#include "FrameCapture.h"
+#include "Materials.h"
+
+#include "HostCameraProducer.h"
+#include "HostCounters.h"
+#include "HostEGL.h"
+#include "HostThermalModel.h"
+
+namespace OSVROpenGLHost {
+
+    struct BenchOptions {
+        int frames;
+        int warmupFrames;
+        int width;
+        int height;
+        int cameraEveryNUpdates;
+        int cameraWidth;
+        int cameraHeight;
+        const char *tracePath;
+        const char *recordPath;
+        const char *replayPath;
+        double replaySpeed;
+        bool checksum;
+        bool latency;
+        bool latencyPattern;
+        int allocGateFrame;         // -1 when off
+        int framesInFlight;
+        bool justInTime;
+        double displayHz;
+        int objects;
+        int workerThreads;          // -1 for the default
+        bool asyncReprojection;
+        int slowFrameMs;
+        int slowEveryNFrames;
+        const char *distortionConfigPath;
+        const char *distortionCacheDirectory;
+        int distortionGridWidth;
+        int distortionGridHeight;
+        const char *texturePath;
+        const char *meshPath;
+        int lifecycleCycles;
+        bool cameraLayer;
+        bool layerCompare;
+        const char *externalCamera;     // "egl", "cpu" or null
+        int cameraChannels;
+        int cpuKernelLevel;             // -1 for the best the CPU has
+        bool thermalSim;
+        double thermalSecondsPerFrame;
+        const char *thermalTracePath;
+        int eyeBufferSamples;
+        const char *captureDirectory;
+        int captureEveryNFrames;
+        int captureFormat;
+        bool captureWindow;
+        int captureLatencyFrames;
+        const char *goldenDirectory;
+        int goldenTolerance;
+        long gpuBudgetKB;               // 0 for none
+        int gpuBudgetChangeFrame;       // -1 for none
+        long gpuBudgetChangeKB;
+        int materials;
+        int textureBatching;
+        const char *materialAtlasPath;
+    };
+
+    static void printUsage(const char *argv0) {
+        fprintf(stderr,
+                "usage: %s [--frames N] [--warmup N] [--width W] [--height H]\n"
+                "          [--camera-every N] [--camera-size WxH] [--trace out.json]\n"
+                "          [--record out.bin | --replay in.bin [--replay-speed S]] [--checksum]\n"
+                "          [--latency [--latency-pattern]] [--alloc-gate N]\n"
+                "          [--frames-in-flight N] [--jit [--display-hz H]]\n"
+                "          [--objects N] [--workers N]\n"
+                "          [--async-reprojection] [--slow-frame-ms N [--slow-every N]]\n"
+                "          [--distortion-mesh config.json [--distortion-grid WxH] [--distortion-cache dir]]\n"
+                "          [--texture path] [--mesh file] [--lifecycle-cycles N]\n"
+                "          [--camera-layer] [--layer-compare] [--external-camera egl|cpu]\n"
+                "          [--camera-channels 1|3|4] [--cpu-kernels scalar|neon|sse4.1|avx2]\n"
+                "          [--thermal-sim [--thermal-seconds-per-frame S] [--thermal-trace out.csv]]\n"
+                "          [--eye-buffer-samples N]\n"
+                "          [--capture dir [--capture-every N] [--capture-format png|pam]\n"
+                "           [--capture-window] [--capture-latency N] [--golden dir [--golden-tolerance N]]]\n"
+                "          [--gpu-budget KB [--gpu-budget-at FRAME:KB]]\n"
+                "          [--materials N [--texture-batching none|atlas|array] [--material-atlas file]]\n",
+                argv0);
+    }
+
+    static bool parseOptions(int argc, char **argv, BenchOptions *options) {
+        for (int i = 1; i < argc; i++) {
+            const char *arg = argv[i];
+            if (!strcmp(arg, "--checksum")) {
+                options->checksum = true;
+                continue;
+            }
+            if (!strcmp(arg, "--latency")) {
+                options->latency = true;
+                continue;
+            }
+            if (!strcmp(arg, "--latency-pattern")) {
+                options->latencyPattern = true;
+                continue;
+            }
+            if (!strcmp(arg, "--jit")) {
+                options->justInTime = true;
+                continue;
+            }
+            if (!strcmp(arg, "--async-reprojection")) {
+                options->asyncReprojection = true;
+                continue;
+            }
+            if (!strcmp(arg, "--camera-layer")) {
+                options->cameraLayer = true;
+                continue;
+            }
+            if (!strcmp(arg, "--layer-compare")) {
+                options->layerCompare = true;
+                continue;
+            }
+            if (!strcmp(arg, "--thermal-sim")) {
+                options->thermalSim = true;
+                continue;
+            }
+            if (!strcmp(arg, "--capture-window")) {
+                options->captureWindow = true;
+                continue;
+            }
+            const char *value = i + 1 < argc ? argv[i + 1] : nullptr;
+            if (!value) {
+                return false;
+            }
+            if (!strcmp(arg, "--frames")) {
+                options->frames = atoi(value);
+            } else if (!strcmp(arg, "--warmup")) {
+                options->warmupFrames = atoi(value);
+            } else if (!strcmp(arg, "--width")) {
+                options->width = atoi(value);
+            } else if (!strcmp(arg, "--height")) {
+                options->height = atoi(value);
+            } else if (!strcmp(arg, "--camera-every")) {
+                options->cameraEveryNUpdates = atoi(value);
+            } else if (!strcmp(arg, "--camera-size")) {
+                if (sscanf(value, "%dx%d", &options->cameraWidth, &options->cameraHeight) != 2) {
+                    return false;
+                }
+            } else if (!strcmp(arg, "--trace")) {
+                options->tracePath = value;
+            } else if (!strcmp(arg, "--record")) {
+                options->recordPath = value;
+            } else if (!strcmp(arg, "--replay")) {
+                options->replayPath = value;
+            } else if (!strcmp(arg, "--replay-speed")) {
+                options->replaySpeed = atof(value);
+            } else if (!strcmp(arg, "--alloc-gate")) {
+                options->allocGateFrame = atoi(value);
+                if (options->allocGateFrame < 0) {
+                    return false;
+                }
+            } else if (!strcmp(arg, "--frames-in-flight")) {
+                options->framesInFlight = atoi(value);
+            } else if (!strcmp(arg, "--display-hz")) {
+                options->displayHz = atof(value);
+            } else if (!strcmp(arg, "--objects")) {
+                options->objects = atoi(value);
+            } else if (!strcmp(arg, "--workers")) {
+                options->workerThreads = atoi(value);
+                if (options->workerThreads < 0) {
+                    return false;
+                }
+            } else if (!strcmp(arg, "--slow-frame-ms")) {
+                options->slowFrameMs = atoi(value);
+            } else if (!strcmp(arg, "--slow-every")) {
+                options->slowEveryNFrames = atoi(value);
+            } else if (!strcmp(arg, "--distortion-mesh")) {
+                options->distortionConfigPath = value;
+            } else if (!strcmp(arg, "--distortion-grid")) {
+                if (sscanf(value, "%dx%d", &options->distortionGridWidth, &options->distortionGridHeight) != 2) {
+                    return false;
+                }
+            } else if (!strcmp(arg, "--distortion-cache")) {
+                options->distortionCacheDirectory = value;
+            } else if (!strcmp(arg, "--texture")) {
+                options->texturePath = value;
+            } else if (!strcmp(arg, "--mesh")) {
+                options->meshPath = value;
+            } else if (!strcmp(arg, "--external-camera")) {
+                if (strcmp(value, "egl") && strcmp(value, "cpu")) {
+                    return false;
+                }
+                options->externalCamera = value;
+                options->cameraLayer = true;
+            } else if (!strcmp(arg, "--camera-channels")) {
+                options->cameraChannels = atoi(value);
+                if (options->cameraChannels != 1 && options->cameraChannels != 3 && options->cameraChannels != 4) {
+                    return false;
+                }
+            } else if (!strcmp(arg, "--cpu-kernels")) {
+                options->cpuKernelLevel = -1;
+                for (int level = 0; level < OSVROpenGL::CPU_KERNEL_LEVEL_COUNT; level++) {
+                    if (!strcmp(value, OSVROpenGL::cpuKernelLevelName(static_cast<OSVROpenGL::CpuKernelLevel>(level)))) {
+                        options->cpuKernelLevel = level;
+                    }
+                }
+                if (options->cpuKernelLevel < 0) {
+                    return false;
+                }
+            } else if (!strcmp(arg, "--thermal-seconds-per-frame")) {
+                options->thermalSecondsPerFrame = atof(value);
+            } else if (!strcmp(arg, "--thermal-trace")) {
+                options->thermalTracePath = value;
+            } else if (!strcmp(arg, "--eye-buffer-samples")) {
+                options->eyeBufferSamples = atoi(value);
+                if (options->eyeBufferSamples < 1) {
+                    return false;
+                }
+            } else if (!strcmp(arg, "--capture")) {
+                options->captureDirectory = value;
+            } else if (!strcmp(arg, "--capture-every")) {
+                options->captureEveryNFrames = atoi(value);
+            } else if (!strcmp(arg, "--capture-format")) {
+                if (!strcmp(value, "png")) {
+                    options->captureFormat = OSVROpenGL::FRAME_CAPTURE_PNG;
+                } else if (!strcmp(value, "pam")) {
+                    options->captureFormat = OSVROpenGL::FRAME_CAPTURE_PAM;
+                } else {
+                    return false;
+                }
+            } else if (!strcmp(arg, "--capture-latency")) {
+                options->captureLatencyFrames = atoi(value);
+            } else if (!strcmp(arg, "--golden")) {
+                options->goldenDirectory = value;
+            } else if (!strcmp(arg, "--golden-tolerance")) {
+                options->goldenTolerance = atoi(value);
+            } else if (!strcmp(arg, "--gpu-budget")) {
+                options->gpuBudgetKB = atol(value);
+            } else if (!strcmp(arg, "--gpu-budget-at")) {
+                if (sscanf(value, "%d:%ld", &options->gpuBudgetChangeFrame, &options->gpuBudgetChangeKB) != 2 ||
+                    options->gpuBudgetChangeFrame < 0) {
+                    return false;
+                }
+            } else if (!strcmp(arg, "--materials")) {
+                options->materials = atoi(value);
+            } else if (!strcmp(arg, "--texture-batching")) {
+                options->textureBatching = -1;
+                for (int batching = 0; batching < OSVROpenGL::kTextureBatchingModes; batching++) {
+                    if (!strcmp(value, OSVROpenGL::textureBatchingName(static_cast<OSVROpenGL::TextureBatching>(batching)))) {
+                        options->textureBatching = batching;
+                    }
+                }
+                if (options->textureBatching < 0) {
+                    return false;
+                }
+            } else if (!strcmp(arg, "--material-atlas")) {
+                options->materialAtlasPath = value;
+            } else if (!strcmp(arg, "--lifecycle-cycles")) {
+                options->lifecycleCycles = atoi(value);
+                if (options->lifecycleCycles < 0) {
+                    return false;
+                }
+            } else {
+                return false;
+            }
+            i++;
+        }
+        return options->frames > 0 && options->warmupFrames >= 0 &&
+               options->width > 0 && options->height > 0 &&
+               options->cameraWidth > 0 && options->cameraHeight > 0 &&
+               !(options->recordPath && options->replayPath) &&
+               (options->latency || !options->latencyPattern) &&
+               options->framesInFlight >= 1 && options->framesInFlight <= OSVROpenGL::kFramePacerMaxDepth &&
+               options->displayHz > 0.0 && options->objects > 0 &&
+               options->slowFrameMs >= 0 && options->slowEveryNFrames >= 1 &&
+               options->distortionGridWidth >= 1 && options->distortionGridHeight >= 1 &&
+               options->distortionGridWidth <= static_cast<int>(OSVROpenGL::kDistortionMaxGridSize) &&
+               options->distortionGridHeight <= static_cast<int>(OSVROpenGL::kDistortionMaxGridSize) &&
+               !(options->externalCamera && options->lifecycleCycles) &&
+               options->thermalSecondsPerFrame > 0.0 &&
+               (options->thermalSim || !options->thermalTracePath) &&
+               options->captureEveryNFrames >= 1 && options->captureLatencyFrames >= 0 &&
+               options->goldenTolerance >= 0 &&
+               options->gpuBudgetKB >= 0 && options->gpuBudgetChangeKB >= 0 &&
+               options->materials >= 0 && (options->materials || !options->materialAtlasPath) &&
+               (options->captureDirectory || (!options->captureWindow && !options->goldenDirectory));
+    }
+
+    static double toMs(uint64_t ns) {
+        return ns / 1.0e6;
+    }
+
+    // Compares every image in the golden directory with the capture's image of
+    // the same name. Returns false if any is missing, of another size or off
+    // by more than the tolerance in any channel.
+    static bool compareGoldenImages(const BenchOptions &options) {
+        std::vector<std::string> names;
+        if (DIR *dir = opendir(options.goldenDirectory)) {
+            while (dirent *entry = readdir(dir)) {
+                size_t length = strlen(entry->d_name);
+                if (length > 4 && (!strcmp(entry->d_name + length - 4, ".png") ||
+                                   !strcmp(entry->d_name + length - 4, ".pam"))) {
+                    names.push_back(entry->d_name);
+                }
+            }
+            closedir(dir);
+        }
+        std::sort(names.begin(), names.end());
+        if (names.empty()) {
+            printf("golden images:   none in %s\n", options.goldenDirectory);
+            return false;
+        }
+
+        int failures = 0;
+        int worstChannel = 0;
+        double worstPsnr = INFINITY;
+        for (size_t i = 0; i < names.size(); i++) {
+            std::string goldenPath = std::string(options.goldenDirectory) + "/" + names[i];
+            std::string capturedPath = std::string(options.captureDirectory) + "/" + names[i];
+            std::vector<uint8_t> golden, captured;
+            uint32_t goldenWidth, goldenHeight, capturedWidth, capturedHeight;
+            if (!OSVROpenGL::loadCapturedImage(goldenPath.c_str(), &golden, &goldenWidth, &goldenHeight) ||
+                !OSVROpenGL::loadCapturedImage(capturedPath.c_str(), &captured, &capturedWidth, &capturedHeight)) {
+                printf("  %-32s missing or unreadable\n", names[i].c_str());
+                failures++;
+                continue;
+            }
+            if (goldenWidth != capturedWidth || goldenHeight != capturedHeight) {
+                printf("  %-32s %ux%u, golden %ux%u\n", names[i].c_str(), capturedWidth, capturedHeight,
+                       goldenWidth, goldenHeight);
+                failures++;
+                continue;
+            }
+            int maxChannel = 0;
+            double squaredError = 0.0;
+            for (size_t byte = 0; byte < golden.size(); byte++) {
+                int difference = abs(static_cast<int>(golden[byte]) - static_cast<int>(captured[byte]));
+                maxChannel = std::max(maxChannel, difference);
+                squaredError += static_cast<double>(difference) * difference;
+            }
+            double mse = squaredError / golden.size();
+            double psnr = mse > 0.0 ? 10.0 * log10(255.0 * 255.0 / mse) : INFINITY;
+            worstChannel = std::max(worstChannel, maxChannel);
+            worstPsnr = std::min(worstPsnr, psnr);
+            if (maxChannel > options.goldenTolerance) {
+                printf("  %-32s off by up to %d (PSNR %.1f dB)\n", names[i].c_str(), maxChannel, psnr);
+                failures++;
+            }
+        }
+        printf("golden images:   %u compared, %d failed; worst channel difference %d, worst PSNR %.1f dB\n",
+               static_cast<unsigned>(names.size()), failures, worstChannel, worstPsnr);
+        return failures == 0;
+    }
+
+    // FNV-1a over the display's pixels.
+    static uint64_t displayChecksum(int width, int height) {
+        std::vector<uint8_t> pixels(static_cast<size_t>(width) * height * 4);
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+        uint64_t hash = 14695981039346656037ull;
+        for (size_t i = 0; i < pixels.size(); i++) {
+            hash = (hash ^ pixels[i]) * 1099511628211ull;
+        }
+        return hash;
+    }
+
+    enum LifecycleCycle {
+        CYCLE_SURFACE_ONLY,
+        CYCLE_CONFIG_CHANGE,
+        CYCLE_CONTEXT_LOST,
+        CYCLE_RESTART,
+        CYCLE_COUNT
+    };
+
+    static const char *const kLifecycleCycleNames[CYCLE_COUNT] = {
+        "context kept", "config change", "context lost", "full restart"
+    };
+
+    struct LifecycleCycleTotals {
+        int cycles;
+        int failures;
+        double rebuildMs;
+        double resumeToFrameMs;
+        double maxResumeToFrameMs;
+    };
+
+    // One pause (or stop) and resume of the given kind, then one frame.
+    // resourceCount is how many GPU resources a new context rebuilds.
+    static void runLifecycleCycle(LifecycleCycle cycle, const BenchOptions &options, HostEGLContext *egl,
+                                  uint32_t resourceCount, LifecycleCycleTotals *totals) {
+        OSVROpenGL::LifecycleStats before;
+        OSVROpenGL::getLifecycleStats(&before);
+        if (cycle == CYCLE_RESTART) {
+            OSVROpenGL::stop();
+        } else {
+            OSVROpenGL::pause();
+        }
+        if (cycle == CYCLE_CONFIG_CHANGE) {
+            // the same texture, but it is reloaded all the same
+            OSVROpenGL::setSceneTexturePath(options.texturePath);
+        }
+        bool ok = cycle == CYCLE_SURFACE_ONLY || cycle == CYCLE_CONFIG_CHANGE ?
+                  egl->recreateSurface(options.width, options.height) : egl->recreateContext();
+        OSVROpenGL::resume();
+        ok = ok && OSVROpenGL::setupGraphics(options.width, options.height) && OSVROpenGL::setupOSVR();
+        OSVROpenGL::renderFrame();
+        egl->swapBuffers();
+
+        OSVROpenGL::LifecycleStats after;
+        OSVROpenGL::getLifecycleStats(&after);
+        bool newContext = after.newContexts == before.newContexts + 1 &&
+                          after.surfaceOnlyChanges == before.surfaceOnlyChanges;
+        bool contextKept = after.surfaceOnlyChanges == before.surfaceOnlyChanges + 1 &&
+                           after.newContexts == before.newContexts;
+        uint32_t expectedRebuilt = cycle == CYCLE_SURFACE_ONLY ? 0 :
+                                   cycle == CYCLE_CONFIG_CHANGE ? 1 : resourceCount;
+        bool expectNewContext = cycle == CYCLE_CONTEXT_LOST || cycle == CYCLE_RESTART;
+        ok = ok && (expectNewContext ? newContext : contextKept) &&
+             after.lastRebuiltResources == expectedRebuilt &&
+             after.state == OSVROpenGL::LIFECYCLE_RUNNING &&
+             after.resumedFrames == before.resumedFrames + 1;
+        if (!ok) {
+            fprintf(stderr, "lifecycle: %s rebuilt %u resources (expected %u) with %s context\n",
+                    kLifecycleCycleNames[cycle], after.lastRebuiltResources, expectedRebuilt,
+                    newContext ? "a new" : "the same");
+            totals->failures++;
+        }
+        totals->cycles++;
+        totals->rebuildMs += after.lastRebuildMs;
+        totals->resumeToFrameMs += after.lastResumeToFrameMs;
+        if (after.lastResumeToFrameMs > totals->maxResumeToFrameMs) {
+            totals->maxResumeToFrameMs = after.lastResumeToFrameMs;
+        }
+    }
+
+    // Returns false if any cycle rebuilt the wrong resources.
+    static bool runLifecycleCycles(const BenchOptions &options, HostEGLContext *egl, uint32_t resourceCount) {
+        LifecycleCycleTotals totals[CYCLE_COUNT];
+        memset(totals, 0, sizeof(totals));
+        for (int round = 0; round < options.lifecycleCycles; round++) {
+            for (int cycle = 0; cycle < CYCLE_COUNT; cycle++) {
+                runLifecycleCycle(static_cast<LifecycleCycle>(cycle), options, egl, resourceCount, &totals[cycle]);
+            }
+        }
+
+        bool ok = true;
+        printf("\n");
+        printf("%-24s %8s %9s %9s %9s\n", "lifecycle (ms)", "cycles", "rebuild", "to frame", "max");
+        for (int cycle = 0; cycle < CYCLE_COUNT; cycle++) {
+            const LifecycleCycleTotals &cycleTotals = totals[cycle];
+            printf("%-24s %8d %9.3f %9.3f %9.3f%s\n", kLifecycleCycleNames[cycle], cycleTotals.cycles,
+                   cycleTotals.rebuildMs / cycleTotals.cycles, cycleTotals.resumeToFrameMs / cycleTotals.cycles,
+                   cycleTotals.maxResumeToFrameMs, cycleTotals.failures ? "  FAILED" : "");
+            ok = ok && !cycleTotals.failures;
+        }
+        return ok;
+    }
+
+    static int runBench(const BenchOptions &options) {
+        OSVRStubConfig config;
+        osvrStubGetDefaultConfig(&config);
+        config.displayWidth = options.width;
+        config.displayHeight = options.height;
+        config.cameraEveryNUpdates = options.cameraEveryNUpdates;
+        config.cameraWidth = options.cameraWidth;
+        config.cameraHeight = options.cameraHeight;
+        config.cameraChannels = options.cameraChannels;
+        osvrStubSetConfig(&config);
+
+        if (options.cpuKernelLevel >= 0 &&
+            !OSVROpenGL::setCpuKernelLevel(static_cast<OSVROpenGL::CpuKernelLevel>(options.cpuKernelLevel))) {
+            fprintf(stderr, "renderer_bench: this CPU can't run the %s kernels\n",
+                    OSVROpenGL::cpuKernelLevelName(static_cast<OSVROpenGL::CpuKernelLevel>(options.cpuKernelLevel)));
+            return 1;
+        }
+
+        OSVROpenGL::setSceneObjectCount(static_cast<uint32_t>(options.objects));
+        OSVROpenGL::setSceneWorkerThreads(options.workerThreads);
+        OSVROpenGL::setDistortionMeshConfig(options.distortionConfigPath, options.distortionCacheDirectory,
+                                            static_cast<uint32_t>(options.distortionGridWidth),
+                                            static_cast<uint32_t>(options.distortionGridHeight));
+        OSVROpenGL::setSceneTexturePath(options.texturePath);
+        OSVROpenGL::setSceneMeshPath(options.meshPath);
+        OSVROpenGL::setSceneMaterials(static_cast<uint32_t>(options.materials),
+                                      static_cast<OSVROpenGL::TextureBatching>(options.textureBatching),
+                                      options.materialAtlasPath);
+
+        HostEGLContext egl;
+        if (!egl.create(options.width, options.height)) {
+            return 1;
+        }
+        OSVROpenGL::resume();
+        if (!OSVROpenGL::setupGraphics(options.width, options.height) || !OSVROpenGL::setupOSVR()) {
+            fprintf(stderr, "Renderer setup failed\n");
+            return 1;
+        }
+        OSVROpenGL::LifecycleStats launch;
+        OSVROpenGL::getLifecycleStats(&launch);
+        uint32_t resourceCount = launch.lastRebuiltResources;
+        if (options.tracePath) {
+            OSVROpenGL::startTracing();
+        }
+        OSVROpenGL::setLatencyMeasurementEnabled(options.latency);
+        OSVROpenGL::setLatencyTestPatternEnabled(options.latencyPattern);
+        OSVROpenGL::setFramePacerDisplayPeriod(static_cast<uint64_t>(1.0e9 / options.displayHz));
+        OSVROpenGL::setFramePacing(options.framesInFlight, options.justInTime);
+        OSVROpenGL::setSimulatedFrameDelay(static_cast<uint32_t>(options.slowFrameMs),
+                                           static_cast<uint32_t>(options.slowEveryNFrames));
+        OSVROpenGL::setAsyncReprojectionEnabled(options.asyncReprojection);
+        OSVROpenGL::setCameraLayerEnabled(options.cameraLayer);
+        OSVROpenGL::setEyeBufferSamples(options.eyeBufferSamples);
+        HostThermalModel::Params thermalParams;
+        HostThermalModel::defaultParams(&thermalParams);
+        HostThermalModel thermalModel(thermalParams);
+        thermalModel.secondsPerFrame = options.thermalSecondsPerFrame;
+        if (options.thermalSim) {
+            if (options.thermalTracePath && !OSVROpenGL::setThermalTraceFile(options.thermalTracePath)) {
+                return 1;
+            }
+            OSVROpenGL::setThermalSource(HostThermalModel::source, &thermalModel);
+            OSVROpenGL::setThermalGovernorEnabled(true);
+        }
+        if (options.captureDirectory) {
+            OSVROpenGL::FrameCaptureConfig capture;
+            OSVROpenGL::defaultFrameCaptureConfig(&capture);
+            capture.directory = options.captureDirectory;
+            capture.everyNFrames = static_cast<uint32_t>(options.captureEveryNFrames);
+            capture.latencyFrames = static_cast<uint32_t>(options.captureLatencyFrames);
+            capture.window = options.captureWindow;
+            capture.format = options.captureFormat;
+            OSVROpenGL::setFrameCapture(&capture);
+        }
+        OSVROpenGL::setGpuMemoryBudget(static_cast<uint64_t>(options.gpuBudgetKB) * 1024);
+        if (options.recordPath && !OSVROpenGL::startRecording(options.recordPath, true)) {
+            return 1;
+        }
+        if (options.replayPath && !OSVROpenGL::startReplay(options.replayPath, options.replaySpeed, true)) {
+            return 1;
+        }
+        HostCameraProducer cameraProducer;
+        if (options.externalCamera &&
+            !cameraProducer.start(OSVROpenGL::kCameraImageStream, !strcmp(options.externalCamera, "egl"),
+                                  options.cameraWidth, options.cameraHeight,
+                                  options.displayHz / options.cameraEveryNUpdates)) {
+            return 1;
+        }
+
+        OSVROpenGL::FrameTimeHistogram frameTimes;
+        uint64_t glCalls = 0;
+        uint64_t drawCalls = 0;
+        uint64_t textureBinds = 0;
+        uint64_t allocations = 0;
+        uint64_t allocatedBytes = 0;
+        uint64_t maxFrameAllocations = 0;
+        uint64_t totalNs = 0;
+        int firstGatedAllocFrame = -1;
+        uint64_t gatedAllocations = 0;
+
+        // stands in for vsync when the display side runs on its own
+        const std::chrono::nanoseconds displayPeriod(static_cast<int64_t>(1.0e9 / options.displayHz));
+        std::chrono::steady_clock::time_point nextVsync = std::chrono::steady_clock::now();
+
+        setAllocationCountingEnabled(true);
+        for (int frame = 0; frame < options.warmupFrames + options.frames; frame++) {
+            bool measured = frame >= options.warmupFrames;
+            if (frame == options.warmupFrames) {
+                OSVROpenGL::resetFrameStats();
+                OSVROpenGL::resetReprojectionStats();
+                OSVROpenGL::resetQuadLayerStats();
+                OSVROpenGL::resetExternalImageStats();
+                OSVROpenGL::resetThermalGovernorStats();
+                OSVROpenGL::resetFrameCaptureStats();
+                OSVROpenGL::resetGpuMemoryStats();
+                OSVROpenGL::resetMaterialStats();
+            }
+            if (frame == options.gpuBudgetChangeFrame) {
+                OSVROpenGL::setGpuMemoryBudget(static_cast<uint64_t>(options.gpuBudgetChangeKB) * 1024);
+            }
+            if (options.asyncReprojection) {
+                nextVsync += displayPeriod;
+                std::this_thread::sleep_until(nextVsync);
+            }
+
+            HostCounters before;
+            getHostCounters(&before);
+            uint64_t startNs = OSVROpenGL::frameStatsNowNs();
+
+            OSVROpenGL::renderFrame();
+            egl.swapBuffers();
+            OSVROpenGL::latencyFramePresented();
+
+            uint64_t endNs = OSVROpenGL::frameStatsNowNs();
+            HostCounters after;
+            getHostCounters(&after);
+            if (options.thermalSim) {
+                OSVROpenGL::ThermalGovernorStats thermal;
+                OSVROpenGL::getThermalGovernorStats(&thermal);
+                thermalModel.setTier(thermal.tier);
+            }
+
+            uint64_t frameAllocations = after.allocations - before.allocations;
+            if (options.allocGateFrame >= 0 && frame >= options.allocGateFrame && frameAllocations) {
+                if (firstGatedAllocFrame < 0) {
+                    firstGatedAllocFrame = frame;
+                }
+                gatedAllocations += frameAllocations;
+            }
+
+            if (measured) {
+                frameTimes.record(endNs - startNs);
+                totalNs += endNs - startNs;
+                glCalls += after.glCalls - before.glCalls;
+                drawCalls += after.drawCalls - before.drawCalls;
+                textureBinds += after.textureBinds - before.textureBinds;
+                allocations += frameAllocations;
+                allocatedBytes += after.allocatedBytes - before.allocatedBytes;
+                if (frameAllocations > maxFrameAllocations) {
+                    maxFrameAllocations = frameAllocations;
+                }
+            }
+        }
+        setAllocationCountingEnabled(false);
+        OSVROpenGL::ReprojectionStats reprojection;
+        OSVROpenGL::getReprojectionStats(&reprojection);
+        OSVROpenGL::stopAsyncReprojection();
+        OSVROpenGL::stopFrameCapture();
+        cameraProducer.stop();
+        OSVROpenGL::stopRecording();
+        OSVROpenGL::stopReplay();
+        OSVROpenGL::setThermalGovernorEnabled(false);
+        OSVROpenGL::setThermalTraceFile(nullptr);
+
+        double frames = options.frames;
+        printf("renderer_bench: %d frames (+%d warmup) at %dx%d, camera %dx%d every %d updates\n",
+               options.frames, options.warmupFrames, options.width, options.height,
+               options.cameraWidth, options.cameraHeight, options.cameraEveryNUpdates);
+        printf("GL_RENDERER: %s\n", reinterpret_cast<const char *>(glGetString(GL_RENDERER)));
+        printf("CPU kernels: %s, camera frames with %d channels\n",
+               OSVROpenGL::cpuKernelLevelName(OSVROpenGL::cpuKernelLevel()), options.cameraChannels);
+        printf("\n");
+        printf("frame time (ms): mean %.3f  p50 %.3f  p90 %.3f  p99 %.3f  max %.3f  (%.1f fps)\n",
+               toMs(totalNs) / frames,
+               toMs(frameTimes.percentileNs(50.0)), toMs(frameTimes.percentileNs(90.0)),
+               toMs(frameTimes.percentileNs(99.0)), toMs(frameTimes.maxNs()),
+               totalNs ? frames * 1.0e9 / totalNs : 0.0);
+        printf("GL calls/frame:  %.1f (%.1f draws, %.1f texture binds)\n", glCalls / frames, drawCalls / frames,
+               textureBinds / frames);
+        printf("allocs/frame:    %.2f (%.0f bytes, max %llu in one frame)\n",
+               allocations / frames, allocatedBytes / frames,
+               static_cast<unsigned long long>(maxFrameAllocations));
+        OSVROpenGL::FramePacerStats pacer;
+        OSVROpenGL::getFramePacerStats(&pacer);
+        printf("frame pacing:    depth %d, %d in flight at the last submit%s\n",
+               pacer.maxFramesInFlight, pacer.framesInFlight,
+               options.justInTime ? ", just-in-time start" : "");
+        printf("scene:           %u objects, %d job workers\n",
+               OSVROpenGL::sceneObjectCount(), OSVROpenGL::jobWorkerCount());
+        if (options.asyncReprojection) {
+            uint64_t displayFrames = reprojection.freshFrames + reprojection.reprojectedFrames;
+            printf("reprojection:    %llu app frames; %llu fresh, %llu reprojected display frames (%.1f%%)\n",
+                   static_cast<unsigned long long>(reprojection.appFrames),
+                   static_cast<unsigned long long>(reprojection.freshFrames),
+                   static_cast<unsigned long long>(reprojection.reprojectedFrames),
+                   displayFrames ? 100.0 * reprojection.reprojectedFrames / displayFrames : 0.0);
+        }
+        if (options.cameraLayer) {
+            OSVROpenGL::QuadLayerStats layers;
+            OSVROpenGL::getQuadLayerStats(&layers);
+            printf("camera layer:    %s, %.1f draws and %.0f pixels shaded/frame, %llu new images\n",
+                   OSVROpenGL::isDistortionMeshReady() ? "composited through the distortion mesh" :
+                   "drawn into the eye buffers",
+                   layers.composited / frames, layers.shadedPixels / frames,
+                   static_cast<unsigned long long>(layers.contentChanges));
+        }
+        if (options.externalCamera) {
+            OSVROpenGL::ExternalImageStats external;
+            OSVROpenGL::getExternalImageStats(&external);
+            double latched = external.latched ? static_cast<double>(external.latched) : 1.0;
+            printf("external camera: %s buffers, %llu frames latched: %llu imported, %llu uploaded "
+                   "(%llu replaced unseen, %llu producer waits)\n",
+                   options.externalCamera, static_cast<unsigned long long>(external.latched),
+                   static_cast<unsigned long long>(external.imported),
+                   static_cast<unsigned long long>(external.uploaded),
+                   static_cast<unsigned long long>(external.replaced),
+                   static_cast<unsigned long long>(external.producerWaits));
+            printf("                 copies avoided: %llu (%.1f KB/frame), handed over to latched: mean %.3f ms, "
+                   "max %.3f ms, latching %.3f ms/frame\n",
+                   static_cast<unsigned long long>(external.imported), external.bytesNotCopied / 1024.0 / frames,
+                   toMs(external.latencyNs) / latched, toMs(external.maxLatencyNs), toMs(external.latchNs) / latched);
+        }
+        if (options.texturePath) {
+            OSVROpenGL::TextureMemoryStats textureMemory;
+            OSVROpenGL::getTextureMemoryStats(&textureMemory);
+            printf("textures:        %u, %.1f KB (%.1f KB as RGBA, %.0f%% saved)%s\n", textureMemory.textureCount,
+                   textureMemory.gpuBytes / 1024.0, textureMemory.rgbaBytes / 1024.0,
+                   textureMemory.rgbaBytes ? 100.0 - 100.0 * textureMemory.gpuBytes / textureMemory.rgbaBytes : 0.0,
+                   textureMemory.droppedLevels ? ", top levels evicted" : "");
+        }
+        OSVROpenGL::GpuMemoryStats gpuMemory;
+        OSVROpenGL::getGpuMemoryStats(&gpuMemory);
+        printf("gpu memory:      %.1f KB (peak %.1f KB):", gpuMemory.usedBytes / 1024.0, gpuMemory.peakUsedBytes / 1024.0);
+        for (int category = 0; category < OSVROpenGL::kGpuMemoryCategories; category++) {
+            printf("%s %s %.1f KB in %u", category ? "," : "",
+                   OSVROpenGL::gpuMemoryCategoryName(static_cast<OSVROpenGL::GpuMemoryCategory>(category)),
+                   gpuMemory.categoryBytes[category] / 1024.0, gpuMemory.categoryObjects[category]);
+        }
+        printf("\n");
+        if (gpuMemory.budgetBytes || gpuMemory.evictions || gpuMemory.restores || gpuMemory.outOfMemoryErrors) {
+            printf("gpu budget:      %.1f KB, over it %u frames; %u evictions (%.1f KB), %u restores (%.1f KB), "
+                   "%u levels dropped now, %u failed, %u out of memory\n",
+                   gpuMemory.budgetBytes / 1024.0, gpuMemory.overBudgetFrames, gpuMemory.evictions,
+                   gpuMemory.evictedBytes / 1024.0, gpuMemory.restores, gpuMemory.restoredBytes / 1024.0,
+                   gpuMemory.droppedLevels, gpuMemory.failedLoads, gpuMemory.outOfMemoryErrors);
+            unsigned loads = gpuMemory.evictions + gpuMemory.restores;
+            printf("                 levels read on the loader thread in %.3f ms/load, longest upload %.3f ms\n",
+                   loads ? toMs(gpuMemory.stageNs) / loads : 0.0, toMs(gpuMemory.maxUploadNs));
+        }
+        if (options.meshPath) {
+            OSVROpenGL::SceneMeshInfo mesh;
+            OSVROpenGL::getSceneMeshInfo(&mesh);
+            printf("mesh:            %u triangles, %u vertices, %.1f KB, loaded in %.3f ms\n", mesh.triangleCount,
+                   mesh.vertexCount, mesh.fileBytes / 1024.0, mesh.loadMs);
+        }
+        if (options.materials) {
+            OSVROpenGL::MaterialStats materials;
+            OSVROpenGL::getMaterialStats(&materials);
+            double objects = materials.objects ? static_cast<double>(materials.objects) : 1.0;
+            printf("materials:       %u in %u textures (%s%s, %.0f%% occupied), loaded in %.3f ms\n",
+                   materials.materials, materials.textures, OSVROpenGL::textureBatchingName(materials.batching),
+                   materials.prepacked ? ", packed offline" : "", materials.occupancy * 100.0f, materials.loadMs);
+            printf("                 %.1f objects/frame in %.1f draws with %.1f texture binds, "
+                   "%.1f draws merged (%.1f objects/draw)\n",
+                   materials.objects / frames, materials.draws / frames, materials.textureBinds / frames,
+                   materials.mergedDraws / frames, materials.draws ? objects / materials.draws : 0.0);
+        }
+        if (options.thermalSim) {
+            OSVROpenGL::ThermalGovernorStats thermal;
+            OSVROpenGL::getThermalGovernorStats(&thermal);
+            printf("thermal:         %.0f s simulated, tier %d at %.1f C (status %d), %u steps down, %u up\n",
+                   thermalModel.seconds(), thermal.tier, thermalModel.temperatureC(), thermalModel.status(),
+                   thermal.stepsDown, thermal.stepsUp);
+            printf("                 time in tier:");
+            for (int tier = 0; tier < OSVROpenGL::kQualityTierCount; tier++) {
+                printf(" %d: %.0f s (x%.1f)", tier, thermal.tierTimeNs[tier] / 1.0e9,
+                       OSVROpenGL::qualityTier(tier).renderScale);
+            }
+            printf("\n");
+        }
+        if (options.captureDirectory) {
+            OSVROpenGL::FrameCaptureStats capture;
+            OSVROpenGL::getFrameCaptureStats(&capture);
+            double capturedFrames = capture.frames ? static_cast<double>(capture.frames) : 1.0;
+            double written = capture.written ? static_cast<double>(capture.written) : 1.0;
+            printf("capture:         %llu frames through %s: %llu images copied, %llu written (%.1f MB), "
+                   "%llu dropped, %llu failed\n",
+                   static_cast<unsigned long long>(capture.frames),
+                   capture.packBuffers ? "pixel pack buffers" : "staging textures",
+                   static_cast<unsigned long long>(capture.copied), static_cast<unsigned long long>(capture.written),
+                   capture.bytesWritten / 1048576.0, static_cast<unsigned long long>(capture.dropped),
+                   static_cast<unsigned long long>(capture.failed));
+            printf("                 render thread %.3f ms/frame (max %.3f), collected %.1f frames after copying, "
+                   "writer %.3f ms/image\n",
+                   toMs(capture.renderThreadNs) / capturedFrames, toMs(capture.maxRenderThreadNs),
+                   capture.copied ? static_cast<double>(capture.latencyFrames) / capture.copied : 0.0,
+                   toMs(capture.writerNs) / written);
+        }
+        if (options.checksum) {
+            printf("last frame checksum: %016llx\n",
+                   static_cast<unsigned long long>(displayChecksum(options.width, options.height)));
+        }
+        printf("\n");
+        printf("%-24s %8s %9s %9s %9s %9s\n", "stage (ms)", "count", "p50", "p90", "p99", "max");
+        for (int stage = 0; stage < OSVROpenGL::FRAME_STAGE_COUNT; stage++) {
+            OSVROpenGL::FrameStageSummary summary;
+            OSVROpenGL::getFrameStageSummary(static_cast<OSVROpenGL::FrameStage>(stage), &summary);
+            if (!summary.count) {
+                continue;
+            }
+            printf("%-24s %8llu %9.3f %9.3f %9.3f %9.3f\n", OSVROpenGL::frameStageName(stage),
+                   static_cast<unsigned long long>(summary.count),
+                   toMs(summary.p50Ns), toMs(summary.p90Ns), toMs(summary.p99Ns), toMs(summary.maxNs));
+        }
+
+        bool lifecycleOk = true;
+        if (options.lifecycleCycles > 0) {
+            lifecycleOk = runLifecycleCycles(options, &egl, resourceCount);
+        }
+
+        if (options.tracePath) {
+            OSVROpenGL::stopTracing();
+            if (!OSVROpenGL::dumpTrace(options.tracePath)) {
+                return 1;
+            }
+        }
+
+        OSVROpenGL::stop();
+        cameraProducer.destroy();
+        OSVROpenGL::shutdownScene();
+        egl.destroy();
+
+        if (options.allocGateFrame >= 0) {
+            if (firstGatedAllocFrame >= 0) {
+                printf("\nalloc gate FAILED: %llu allocations from frame %d on, first in frame %d\n",
+                       static_cast<unsigned long long>(gatedAllocations), options.allocGateFrame,
+                       firstGatedAllocFrame);
+                return 3;
+            }
+            printf("\nalloc gate passed: no allocations from frame %d on\n", options.allocGateFrame);
+        }
+        if (options.goldenDirectory) {
+            printf("\n");
+            if (!compareGoldenImages(options)) {
+                printf("\ngolden images FAILED: the capture in %s doesn't match %s\n", options.captureDirectory,
+                       options.goldenDirectory);
+                return 3;
+            }
+        }
+        if (!lifecycleOk) {
+            printf("\nlifecycle FAILED: a pause and resume rebuilt the wrong GPU resources\n");
+            return 3;
+        }
+        return 0;
+    }
+
+    // The zone plate --layer-compare puts on the layer: rings from flat in
+    // the middle to a quarter of the sample rate at the corners, with the
+    // channels a little apart so the lens' chromatic correction shows.
+    static void makeZonePlate(int width, int height, std::vector<uint8_t> *pixelsOut) {
+        pixelsOut->resize(static_cast<size_t>(width) * height * 4);
+        double halfDiagonal = 0.5 * sqrt(static_cast<double>(width) * width + static_cast<double>(height) * height);
+        for (int y = 0; y < height; y++) {
+            for (int x = 0; x < width; x++) {
+                double dx = x + 0.5 - width * 0.5;
+                double dy = y + 0.5 - height * 0.5;
+                double phase = M_PI * (dx * dx + dy * dy) / (4.0 * halfDiagonal);
+                uint8_t *pixel = &(*pixelsOut)[(static_cast<size_t>(y) * width + x) * 4];
+                for (int channel = 0; channel < 3; channel++) {
+                    double value = 0.5 + 0.5 * cos(phase * (0.9 + 0.1 * channel));
+                    pixel[channel] = static_cast<uint8_t>(value * 255.0 + 0.5);
+                }
+                pixel[3] = 255;
+            }
+        }
+    }
+
+    // What GL_LINEAR with clamping samples from one channel of the image.
+    static double sampleBilinear(const std::vector<uint8_t> &pixels, int width, int height, int channel,
+                                 double u, double v) {
+        double x = u * width - 0.5;
+        double y = v * height - 0.5;
+        int x0 = static_cast<int>(floor(x));
+        int y0 = static_cast<int>(floor(y));
+        double fx = x - x0;
+        double fy = y - y0;
+        double value = 0.0;
+        for (int corner = 0; corner < 4; corner++) {
+            int cx = x0 + (corner & 1);
+            int cy = y0 + (corner >> 1);
+            cx = cx < 0 ? 0 : (cx >= width ? width - 1 : cx);
+            cy = cy < 0 ? 0 : (cy >= height ? height - 1 : cy);
+            double weight = (corner & 1 ? fx : 1.0 - fx) * (corner >> 1 ? fy : 1.0 - fy);
+            value += weight * pixels[(static_cast<size_t>(cy) * width + cx) * 4 + channel];
+        }
+        return value;
+    }
+
+    static GLuint createTexture(int width, int height, const void *pixels) {
+        GLuint texture = 0;
+        glGenTextures(1, &texture);
+        glBindTexture(GL_TEXTURE_2D, texture);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        return texture;
+    }
+
+    // The exact layer over the display, per channel; negative where the layer
+    // is not, or is too near its edge for clamping to be the same both ways.
+    static void referenceLayerImage(const OSVROpenGL::DistortionParams &params,
+                                    const std::vector<OSVROpenGL::DistortionVertex> &meshVertices,
+                                    uint32_t gridWidth, uint32_t gridHeight, const float (*homographies)[9],
+                                    const std::vector<uint8_t> &image, int imageWidth, int imageHeight,
+                                    int width, int height, std::vector<double> *referenceOut) {
+        referenceOut->assign(static_cast<size_t>(width) * height * 3, -1.0);
+        int eyeWidth = width / static_cast<int>(params.eyeCount);
+        uint32_t eyeVertexCount = (gridWidth + 1) * (gridHeight + 1);
+        double marginU = 2.0 / imageWidth;
+        double marginV = 2.0 / imageHeight;
+        for (int y = 0; y < height; y++) {
+            for (int x = 0; x < eyeWidth * static_cast<int>(params.eyeCount); x++) {
+                uint32_t eye = static_cast<uint32_t>(x / eyeWidth);
+                const float *h = homographies[eye];
+                float screenUV[2] = { (x - static_cast<int>(eye) * eyeWidth + 0.5f) / eyeWidth,
+                                      (y + 0.5f) / height };
+                double layerUV[3][2];
+                bool inside = true;
+                for (int channel = 0; channel < 3 && inside; channel++) {
+                    float uv[2];
+                    OSVROpenGL::interpolateDistortionMesh(&meshVertices[eye * eyeVertexCount], gridWidth, gridHeight,
+                                                          channel, screenUV, uv);
+                    double lx = h[0] * uv[0] + h[3] * uv[1] + h[6];
+                    double ly = h[1] * uv[0] + h[4] * uv[1] + h[7];
+                    double lz = h[2] * uv[0] + h[5] * uv[1] + h[8];
+                    if (lz <= 0.0) {
+                        inside = false;
+                        break;
+                    }
+                    layerUV[channel][0] = lx / lz;
+                    layerUV[channel][1] = ly / lz;
+                    inside = layerUV[channel][0] > marginU && layerUV[channel][0] < 1.0 - marginU &&
+                             layerUV[channel][1] > marginV && layerUV[channel][1] < 1.0 - marginV;
+                }
+                if (!inside) {
+                    continue;
+                }
+                double *reference = &(*referenceOut)[(static_cast<size_t>(y) * width + x) * 3];
+                for (int channel = 0; channel < 3; channel++) {
+                    reference[channel] = sampleBilinear(image, imageWidth, imageHeight, channel,
+                                                        layerUV[channel][0], layerUV[channel][1]);
+                }
+            }
+        }
+    }
+
+    // PSNR of the display's pixels against the reference where it has one.
+    static double layerPSNR(const std::vector<double> &reference, int width, int height) {
+        std::vector<uint8_t> pixels(static_cast<size_t>(width) * height * 4);
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+        double squaredError = 0.0;
+        uint64_t samples = 0;
+        for (size_t pixel = 0; pixel < static_cast<size_t>(width) * height; pixel++) {
+            for (int channel = 0; channel < 3; channel++) {
+                double expected = reference[pixel * 3 + channel];
+                if (expected < 0.0) {
+                    continue;
+                }
+                double error = pixels[pixel * 4 + channel] - expected;
+                squaredError += error * error;
+                samples++;
+            }
+        }
+        if (!samples) {
+            return 0.0;
+        }
+        if (squaredError == 0.0) {
+            return INFINITY;
+        }
+        return 10.0 * log10(255.0 * 255.0 * samples / squaredError);
+    }
+
+    struct EyeBuffer {
+        GLuint texture;
+        GLuint framebuffer;
+    };
+
+    // One present of the layer: the eye buffers cleared (the scene would be
+    // drawn there), the layer drawn into them when eyeBufferPath, both warped
+    // through the mesh, and the layer composited over that when not.
+    static void presentLayer(bool eyeBufferPath, const EyeBuffer *eyeBuffers, int eyeBufferWidth,
+                             int eyeBufferHeight, const OSVROpenGL::SceneView *views, uint32_t eyeCount,
+                             int width, int height) {
+        const int eyeViewport[4] = { 0, 0, eyeBufferWidth, eyeBufferHeight };
+        for (uint32_t eye = 0; eye < eyeCount; eye++) {
+            glBindFramebuffer(GL_FRAMEBUFFER, eyeBuffers[eye].framebuffer);
+            glViewport(0, 0, eyeBufferWidth, eyeBufferHeight);
+            glClear(GL_COLOR_BUFFER_BIT);
+            if (eyeBufferPath) {
+                OSVROpenGL::drawQuadLayersIntoEye(eye, views, eyeCount, eyeViewport);
+            }
+        }
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        glViewport(0, 0, width, height);
+        glClear(GL_COLOR_BUFFER_BIT);
+        for (uint32_t eye = 0; eye < eyeCount; eye++) {
+            OSVROpenGL::drawDistortionMesh(eye, eyeBuffers[eye].texture, 1.0f);
+            if (!eyeBufferPath) {
+                OSVROpenGL::compositeQuadLayers(eye, views, eyeCount, width, height);
+            }
+        }
+    }
+
+    static int runLayerCompare(const BenchOptions &options) {
+        const char *configPath = options.distortionConfigPath ? options.distortionConfigPath :
+                                 "asset:osvr_server_config.json";
+        uint32_t gridWidth = static_cast<uint32_t>(options.distortionGridWidth);
+        uint32_t gridHeight = static_cast<uint32_t>(options.distortionGridHeight);
+        OSVROpenGL::DistortionParams params;
+        if (!OSVROpenGL::loadDisplayDistortion(configPath, nullptr, &params, nullptr)) {
+            return 1;
+        }
+        std::vector<OSVROpenGL::DistortionVertex> meshVertices;
+        std::vector<uint16_t> meshIndices;
+        OSVROpenGL::buildDistortionMesh(params, gridWidth, gridHeight, &meshVertices, &meshIndices);
+
+        HostEGLContext egl;
+        if (!egl.create(options.width, options.height)) {
+            return 1;
+        }
+        OSVROpenGL::setDistortionMeshConfig(configPath, options.distortionCacheDirectory, gridWidth, gridHeight);
+        if (!OSVROpenGL::setupDistortionMesh() || !OSVROpenGL::initQuadLayers()) {
+            fprintf(stderr, "Distortion mesh or layer setup failed\n");
+            return 1;
+        }
+
+        // the eyes side by side, 64 mm apart, with a 90 degree symmetric field of view
+        uint32_t eyeCount = params.eyeCount;
+        int eyeWidth = options.width / static_cast<int>(eyeCount);
+        OSVROpenGL::SceneView views[OSVROpenGL::kDistortionMaxEyes];
+        memset(views, 0, sizeof(views));
+        double aspect = static_cast<double>(eyeWidth) / options.height;
+        const double nearZ = 0.1;
+        const double farZ = 100.0;
+        for (uint32_t eye = 0; eye < eyeCount; eye++) {
+            float *view = views[eye].view;
+            view[0] = view[5] = view[10] = view[15] = 1.0f;
+            view[12] = eyeCount == 1 ? 0.0f : (eye == 0 ? 0.032f : -0.032f);
+            float *projection = views[eye].projection;
+            projection[0] = static_cast<float>(1.0 / aspect);
+            projection[5] = 1.0f;
+            projection[10] = static_cast<float>(-(farZ + nearZ) / (farZ - nearZ));
+            projection[11] = -1.0f;
+            projection[14] = static_cast<float>(-2.0 * farZ * nearZ / (farZ - nearZ));
+        }
+
+        // the camera layer as the renderer puts it
+        std::vector<uint8_t> image;
+        makeZonePlate(options.cameraWidth, options.cameraHeight, &image);
+        OSVROpenGL::QuadLayer layer;
+        memset(&layer, 0, sizeof(layer));
+        layer.texture = createTexture(options.cameraWidth, options.cameraHeight, image.data());
+        layer.target = GL_TEXTURE_2D;
+        layer.space = OSVROpenGL::QUAD_LAYER_HEAD;
+        layer.center[2] = -1.5f;
+        layer.size[0] = 1.6f;
+        layer.size[1] = 1.6f * options.cameraHeight / options.cameraWidth;
+        layer.topRowFirst = true;
+        OSVROpenGL::setQuadLayer(0, layer);
+
+        float homographies[OSVROpenGL::kDistortionMaxEyes][9];
+        for (uint32_t eye = 0; eye < eyeCount; eye++) {
+            float uvMin[2];
+            float uvMax[2];
+            if (!OSVROpenGL::computeQuadLayerHomography(layer, views, eyeCount, eye, homographies[eye],
+                                                        uvMin, uvMax)) {
+                fprintf(stderr, "The layer is not in view\n");
+                return 1;
+            }
+        }
+        std::vector<double> reference;
+        referenceLayerImage(params, meshVertices, gridWidth, gridHeight, homographies, image,
+                            options.cameraWidth, options.cameraHeight, options.width, options.height, &reference);
+
+        printf("layer_compare: %dx%d layer on a %dx%d display, %ux%u mesh, %d presents each\n",
+               options.cameraWidth, options.cameraHeight, options.width, options.height,
+               gridWidth, gridHeight, options.frames);
+        printf("GL_RENDERER: %s\n", reinterpret_cast<const char *>(glGetString(GL_RENDERER)));
+        printf("\n");
+        printf("%-28s %12s %14s %10s %10s\n", "path", "eye buffer", "layer px/eye", "ms", "PSNR dB");
+
+        static const double kEyeBufferScales[] = { 0.75, 1.0, 1.5 };
+        const int pathCount = static_cast<int>(sizeof(kEyeBufferScales) / sizeof(kEyeBufferScales[0])) + 1;
+        glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+        for (int path = 0; path < pathCount; path++) {
+            bool eyeBufferPath = path < pathCount - 1;
+            double scale = eyeBufferPath ? kEyeBufferScales[path] : 1.0;
+            int eyeBufferWidth = static_cast<int>(eyeWidth * scale + 0.5);
+            int eyeBufferHeight = static_cast<int>(options.height * scale + 0.5);
+            EyeBuffer eyeBuffers[OSVROpenGL::kDistortionMaxEyes];
+            for (uint32_t eye = 0; eye < eyeCount; eye++) {
+                eyeBuffers[eye].texture = createTexture(eyeBufferWidth, eyeBufferHeight, nullptr);
+                glGenFramebuffers(1, &eyeBuffers[eye].framebuffer);
+                glBindFramebuffer(GL_FRAMEBUFFER, eyeBuffers[eye].framebuffer);
+                glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D,
+                                       eyeBuffers[eye].texture, 0);
+            }
+
+            presentLayer(eyeBufferPath, eyeBuffers, eyeBufferWidth, eyeBufferHeight, views, eyeCount,
+                         options.width, options.height);
+            double psnr = layerPSNR(reference, options.width, options.height);
+
+            OSVROpenGL::resetQuadLayerStats();
+            glFinish();
+            uint64_t startNs = OSVROpenGL::frameStatsNowNs();
+            for (int run = 0; run < options.frames; run++) {
+                presentLayer(eyeBufferPath, eyeBuffers, eyeBufferWidth, eyeBufferHeight, views, eyeCount,
+                             options.width, options.height);
+                glFinish();
+            }
+            uint64_t totalNs = OSVROpenGL::frameStatsNowNs() - startNs;
+            OSVROpenGL::QuadLayerStats stats;
+            OSVROpenGL::getQuadLayerStats(&stats);
+
+            char name[64];
+            char size[32];
+            if (eyeBufferPath) {
+                snprintf(name, sizeof(name), "into eye buffers, %.2fx", scale);
+                snprintf(size, sizeof(size), "%dx%d", eyeBufferWidth, eyeBufferHeight);
+            } else {
+                snprintf(name, sizeof(name), "composited through the mesh");
+                snprintf(size, sizeof(size), "-");
+            }
+            printf("%-28s %12s %14.0f %10.3f %10.2f\n", name, size,
+                   stats.composited ? static_cast<double>(stats.shadedPixels) / stats.composited : 0.0,
+                   toMs(totalNs) / options.frames, psnr);
+
+            for (uint32_t eye = 0; eye < eyeCount; eye++) {
+                glDeleteFramebuffers(1, &eyeBuffers[eye].framebuffer);
+                glDeleteTextures(1, &eyeBuffers[eye].texture);
+            }
+        }
+
+        OSVROpenGL::clearQuadLayer(0);
+        glDeleteTextures(1, &layer.texture);
+        OSVROpenGL::releaseQuadLayers();
+        OSVROpenGL::releaseDistortionMesh();
+        egl.destroy();
+        return 0;
+    }
+}
+
+int main(int argc, char **argv) {
+    OSVROpenGL::setAssetDirectory(OSVROPENGL_ASSET_DIR);
+    OSVROpenGLHost::BenchOptions options;
+    options.frames = 600;
+    options.warmupFrames = 30;
+    options.width = 1280;
+    options.height = 720;
+    options.cameraEveryNUpdates = 2;
+    options.cameraWidth = 640;
+    options.cameraHeight = 480;
+    options.tracePath = nullptr;
+    options.recordPath = nullptr;
+    options.replayPath = nullptr;
+    options.replaySpeed = 0.0;
+    options.checksum = false;
+    options.latency = false;
+    options.latencyPattern = false;
+    options.allocGateFrame = -1;
+    options.framesInFlight = 2;
+    options.justInTime = false;
+    options.displayHz = 60.0;
+    options.objects = 1;
+    options.workerThreads = -1;
+    options.asyncReprojection = false;
+    options.slowFrameMs = 0;
+    options.slowEveryNFrames = 1;
+    options.distortionConfigPath = nullptr;
+    options.distortionCacheDirectory = nullptr;
+    options.distortionGridWidth = 32;
+    options.distortionGridHeight = 32;
+    options.texturePath = nullptr;
+    options.meshPath = nullptr;
+    options.lifecycleCycles = 0;
+    options.cameraLayer = false;
+    options.layerCompare = false;
+    options.externalCamera = nullptr;
+    options.cameraChannels = 4;
+    options.cpuKernelLevel = -1;
+    options.thermalSim = false;
+    options.thermalSecondsPerFrame = 2.0;
+    options.thermalTracePath = nullptr;
+    options.eyeBufferSamples = 1;
+    options.captureDirectory = nullptr;
+    options.captureEveryNFrames = 1;
+    options.captureFormat = OSVROpenGL::FRAME_CAPTURE_PNG;
+    options.captureWindow = false;
+    options.captureLatencyFrames = 3;
+    options.goldenDirectory = nullptr;
+    options.goldenTolerance = 0;
+    options.gpuBudgetKB = 0;
+    options.gpuBudgetChangeFrame = -1;
+    options.gpuBudgetChangeKB = 0;
+    options.materials = 0;
+    options.textureBatching = OSVROpenGL::TEXTURE_BATCHING_ATLAS;
+    options.materialAtlasPath = nullptr;
+    if (!OSVROpenGLHost::parseOptions(argc, argv, &options)) {
+        OSVROpenGLHost::printUsage(argv[0]);
+        return 2;
+    }
+    if (options.layerCompare) {
+        return OSVROpenGLHost::runLayerCompare(options);
+    }
+    return OSVROpenGLHost::runBench(options);
+}
@@ -0,0 +1,282 @@
+/*
+ * Copyright (C) 2015 Sensics, Inc. and contributors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+// Runs the scene update (animation, culling and draw list building) on 1 to N
+// job workers and reports how it scales:
+//
+//   scene_bench [--objects N] [--frames N] [--warmup N] [--max-workers N] [--verify]
+//               [--cpu-kernels scalar|neon|sse4.1|avx2]
+//
+// Each measured update is beginSceneFrame() plus buildSceneDrawLists() for two
+// eyes whose head turns a little every frame, so what's culled keeps changing.
+// Workers count the calling thread, so 1 is the serial baseline.
+//
+// --verify hashes every frame's draw lists and fails (exit status 3) unless
+// every worker count produced exactly what the serial run did. Build with
+// -DOSVROPENGL_SANITIZE_THREAD=ON to run it under ThreadSanitizer.
+//
+// --cpu-kernels animates and culls with that level's kernels instead of the
+// best the CPU has; cpu_kernel_tool times the kernels on their own.
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+
+#include "CpuDispatch.h"
+#include "FrameStats.h"
+#include "JobSystem.h"
+#include "Scene.h"
+
+namespace OSVROpenGLHost {
+
+    struct SceneBenchOptions {
+        int objects;
+        int frames;
+        int warmupFrames;
+        int maxWorkers;
+        bool verify;
+        int cpuKernelLevel;     // -1 for the best the CPU has
+    };
+
+    struct SceneBenchResult {
+        uint64_t totalNs;
+        uint64_t p50Ns;
+        uint64_t p99Ns;
+        uint64_t drawListHash;
+        double visiblePerEye;
+        double stolenPerFrame;
+    };
+
+    static void printUsage(const char *argv0) {
+        fprintf(stderr,
+                "usage: %s [--objects N] [--frames N] [--warmup N] [--max-workers N] [--verify]\n"
+                "          [--cpu-kernels scalar|neon|sse4.1|avx2]\n",
+                argv0);
+    }
+
+    static bool parseOptions(int argc, char **argv, SceneBenchOptions *options) {
+        for (int i = 1; i < argc; i++) {
+            const char *arg = argv[i];
+            if (!strcmp(arg, "--verify")) {
+                options->verify = true;
+                continue;
+            }
+            const char *value = i + 1 < argc ? argv[i + 1] : nullptr;
+            if (!value) {
+                return false;
+            }
+            if (!strcmp(arg, "--objects")) {
+                options->objects = atoi(value);
+            } else if (!strcmp(arg, "--frames")) {
+                options->frames = atoi(value);
+            } else if (!strcmp(arg, "--warmup")) {
+                options->warmupFrames = atoi(value);
+            } else if (!strcmp(arg, "--max-workers")) {
+                options->maxWorkers = atoi(value);
+            } else if (!strcmp(arg, "--cpu-kernels")) {
+                options->cpuKernelLevel = -1;
+                for (int level = 0; level < OSVROpenGL::CPU_KERNEL_LEVEL_COUNT; level++) {
+                    if (!strcmp(value, OSVROpenGL::cpuKernelLevelName(static_cast<OSVROpenGL::CpuKernelLevel>(level)))) {
+                        options->cpuKernelLevel = level;
+                    }
+                }
+                if (options->cpuKernelLevel < 0) {
+                    return false;
+                }
+            } else {
+                return false;
+            }
+            i++;
+        }
+        return options->objects > 0 && options->frames > 0 && options->warmupFrames >= 0 &&
+               options->maxWorkers >= 1 && options->maxWorkers <= OSVROpenGL::kMaxJobWorkers;
+    }
+
+    static double toMs(uint64_t ns) {
+        return ns / 1.0e6;
+    }
+
+    // Both eyes of a head at the origin turned by yaw radians: 64mm IPD,
+    // 90 degree symmetric frusta from 0.1m to 100m.
+    static void makeViews(float yaw, OSVROpenGL::SceneView views[2]) {
+        const float nearClip = 0.1f;
+        const float farClip = 100.0f;
+        float c = std::cos(yaw);
+        float s = std::sin(yaw);
+        for (int eye = 0; eye < 2; eye++) {
+            OSVROpenGL::SceneView &view = views[eye];
+            memset(&view, 0, sizeof(view));
+            view.view[0] = c;
+            view.view[2] = -s;
+            view.view[5] = 1.0f;
+            view.view[8] = s;
+            view.view[10] = c;
+            view.view[12] = eye == 0 ? 0.032f : -0.032f;
+            view.view[15] = 1.0f;
+
+            view.projection[0] = 1.0f;
+            view.projection[5] = 1.0f;
+            view.projection[10] = -(farClip + nearClip) / (farClip - nearClip);
+            view.projection[11] = -1.0f;
+            view.projection[14] = -2.0f * farClip * nearClip / (farClip - nearClip);
+        }
+    }
+
+    // FNV-1a over both eyes' draw lists.
+    static uint64_t drawListHash(uint64_t hash, uint32_t *visibleOut) {
+        *visibleOut = 0;
+        for (uint32_t eye = 0; eye < 2; eye++) {
+            uint32_t count;
+            const OSVROpenGL::SceneDrawCommand *drawList = OSVROpenGL::getSceneDrawList(eye, &count);
+            *visibleOut += count;
+            const unsigned char *bytes = reinterpret_cast<const unsigned char *>(drawList);
+            size_t size = count * sizeof(OSVROpenGL::SceneDrawCommand);
+            hash = (hash ^ count) * 1099511628211ull;
+            for (size_t i = 0; i < size; i++) {
+                hash = (hash ^ bytes[i]) * 1099511628211ull;
+            }
+        }
+        return hash;
+    }
+
+    static uint32_t visibleCount() {
+        uint32_t total = 0;
+        for (uint32_t eye = 0; eye < 2; eye++) {
+            uint32_t count;
+            OSVROpenGL::getSceneDrawList(eye, &count);
+            total += count;
+        }
+        return total;
+    }
+
+    static bool runScene(const SceneBenchOptions &options, int workers, SceneBenchResult *resultOut) {
+        OSVROpenGL::setSceneObjectCount(static_cast<uint32_t>(options.objects));
+        OSVROpenGL::setSceneWorkerThreads(workers - 1);
+        if (!OSVROpenGL::setupScene()) {
+            return false;
+        }
+
+        OSVROpenGL::FrameTimeHistogram updateTimes;
+        uint64_t totalNs = 0;
+        uint64_t hash = 14695981039346656037ull;
+        uint64_t visible = 0;
+        OSVROpenGL::JobSystemStats statsBefore = {0, 0};
+        for (int frame = 0; frame < options.warmupFrames + options.frames; frame++) {
+            bool measured = frame >= options.warmupFrames;
+            if (frame == options.warmupFrames) {
+                OSVROpenGL::getJobSystemStats(&statsBefore);
+            }
+            OSVROpenGL::SceneView views[2];
+            makeViews(frame * 0.02f, views);
+
+            uint64_t startNs = OSVROpenGL::frameStatsNowNs();
+            OSVROpenGL::beginSceneFrame();
+            OSVROpenGL::buildSceneDrawLists(views, 2);
+            uint64_t endNs = OSVROpenGL::frameStatsNowNs();
+
+            uint32_t frameVisible;
+            if (options.verify) {
+                hash = drawListHash(hash, &frameVisible);
+            } else {
+                frameVisible = visibleCount();
+            }
+            if (measured) {
+                updateTimes.record(endNs - startNs);
+                totalNs += endNs - startNs;
+                visible += frameVisible;
+            }
+        }
+        OSVROpenGL::JobSystemStats statsAfter;
+        OSVROpenGL::getJobSystemStats(&statsAfter);
+        OSVROpenGL::shutdownScene();
+
+        resultOut->totalNs = totalNs;
+        resultOut->p50Ns = updateTimes.percentileNs(50.0);
+        resultOut->p99Ns = updateTimes.percentileNs(99.0);
+        resultOut->drawListHash = hash;
+        resultOut->visiblePerEye = visible / (2.0 * options.frames);
+        resultOut->stolenPerFrame =
+                static_cast<double>(statsAfter.jobsStolen - statsBefore.jobsStolen) / options.frames;
+        return true;
+    }
+
+    static int runBench(const SceneBenchOptions &options) {
+        if (options.cpuKernelLevel >= 0 &&
+            !OSVROpenGL::setCpuKernelLevel(static_cast<OSVROpenGL::CpuKernelLevel>(options.cpuKernelLevel))) {
+            fprintf(stderr, "scene_bench: this CPU can't run the %s kernels\n",
+                    OSVROpenGL::cpuKernelLevelName(static_cast<OSVROpenGL::CpuKernelLevel>(options.cpuKernelLevel)));
+            return 1;
+        }
+        printf("scene_bench: %d objects, %d updates (+%d warmup), 1-%d workers, %u cores, %s kernels\n",
+               options.objects, options.frames, options.warmupFrames, options.maxWorkers,
+               std::thread::hardware_concurrency(),
+               OSVROpenGL::cpuKernelLevelName(OSVROpenGL::cpuKernelLevel()));
+        printf("\n");
+        printf("%-8s %9s %9s %9s %8s %10s%s\n", "workers", "mean (ms)", "p50", "p99", "speedup",
+               "steals/fr", options.verify ? "  draw lists" : "");
+
+        SceneBenchResult serial;
+        bool mismatch = false;
+        for (int workers = 1; workers <= options.maxWorkers; workers++) {
+            SceneBenchResult result;
+            if (!runScene(options, workers, &result)) {
+                fprintf(stderr, "Scene setup failed\n");
+                return 1;
+            }
+            if (workers == 1) {
+                serial = result;
+            }
+            const char *verdict = "";
+            if (options.verify) {
+                verdict = result.drawListHash == serial.drawListHash ? "  match" : "  MISMATCH";
+                mismatch = mismatch || result.drawListHash != serial.drawListHash;
+            }
+            printf("%-8d %9.3f %9.3f %9.3f %7.2fx %10.2f%s\n", workers,
+                   toMs(result.totalNs) / options.frames, toMs(result.p50Ns), toMs(result.p99Ns),
+                   result.totalNs ? static_cast<double>(serial.totalNs) / result.totalNs : 0.0,
+                   result.stolenPerFrame, verdict);
+        }
+        printf("\n%.1f of %d objects drawn per eye\n", serial.visiblePerEye, options.objects);
+        if (options.verify) {
+            printf("draw list hash %016llx\n", static_cast<unsigned long long>(serial.drawListHash));
+            if (mismatch) {
+                printf("verify FAILED: the draw lists depend on the worker count\n");
+                return 3;
+            }
+            printf("verify passed: every worker count built the serial draw lists\n");
+        }
+        return 0;
+    }
+}
+
+int main(int argc, char **argv) {
+    OSVROpenGLHost::SceneBenchOptions options;
+    options.objects = 10000;
+    options.frames = 300;
+    options.warmupFrames = 30;
+    int cores = static_cast<int>(std::thread::hardware_concurrency());
+    options.maxWorkers = cores < 1 ? 1 : (cores > OSVROpenGL::kMaxJobWorkers ? OSVROpenGL::kMaxJobWorkers : cores);
+    options.verify = false;
+    options.cpuKernelLevel = -1;
+    if (!OSVROpenGLHost::parseOptions(argc, argv, &options)) {
+        OSVROpenGLHost::printUsage(argv[0]);
+        return 2;
+    }
+    return OSVROpenGLHost::runBench(options);
+}
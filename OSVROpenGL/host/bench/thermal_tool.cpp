@@ -0,0 +1,344 @@
+/*
+ * Copyright (C) 2015 Sensics, Inc. and contributors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+// Runs the thermal governor's policy (see ThermalGovernor.h) over thermal
+// traces:
+//
+//   thermal_tool --self-check [--verbose]
+//                      runs the policy against the host thermal model and a
+//                      few made-up traces, and fails (exit status 3) unless
+//                      it steps down ahead of throttling, settles, steps
+//                      back up once cool and doesn't chase sensor noise
+//   thermal_tool trace.csv...
+//                      replays traces recorded with setThermalTraceFile()
+//                      (renderer_bench --thermal-trace, or the app's
+//                      THERMAL_TRACE extra) and fails (exit status 3) if the
+//                      policy now takes other decisions than it did then
+//
+// --verbose prints every tier change.
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#include "HostThermalModel.h"
+#include "ThermalGovernor.h"
+
+namespace OSVROpenGLHost {
+
+    using OSVROpenGL::ThermalPolicyConfig;
+    using OSVROpenGL::ThermalPolicyState;
+    using OSVROpenGL::ThermalReading;
+
+    static bool gVerbose = false;
+
+    struct PolicyRun {
+        int finalTier;
+        int stepsDown;
+        int stepsUp;
+        double shortestGapInLastHalf;  // between tier changes; negative if there were none
+        float maxTemperatureC;
+        int maxStatus;
+        double firstStepDownSeconds;    // negative if it never stepped down
+        float firstStepDownC;
+        double shortestStepUpGapSeconds;// since the change before it; negative if it never stepped up
+    };
+
+    static void startRun(PolicyRun *run) {
+        memset(run, 0, sizeof(*run));
+        run->maxTemperatureC = -1000.0f;
+        run->firstStepDownSeconds = -1.0;
+        run->shortestStepUpGapSeconds = -1.0;
+        run->shortestGapInLastHalf = -1.0;
+    }
+
+    // Books one reading's decision.
+    static void recordDecision(PolicyRun *run, const ThermalReading &reading, double seconds, double totalSeconds,
+                               int previousTier, int tier, int reason, double *lastChangeSeconds) {
+        if (!std::isnan(reading.temperatureC) && reading.temperatureC > run->maxTemperatureC) {
+            run->maxTemperatureC = reading.temperatureC;
+        }
+        if (reading.status > run->maxStatus) {
+            run->maxStatus = reading.status;
+        }
+        if (tier == previousTier) {
+            return;
+        }
+        if (gVerbose) {
+            printf("    %7.0f s  %5.1f C  status %d  tier %d -> %d (%s)\n", seconds, reading.temperatureC,
+                   reading.status, previousTier, tier, OSVROpenGL::tierChangeReasonName(reason));
+        }
+        double gap = seconds - *lastChangeSeconds;
+        if (tier > previousTier) {
+            run->stepsDown++;
+            if (run->firstStepDownSeconds < 0.0) {
+                run->firstStepDownSeconds = seconds;
+                run->firstStepDownC = reading.temperatureC;
+            }
+        } else {
+            run->stepsUp++;
+            if (run->shortestStepUpGapSeconds < 0.0 || gap < run->shortestStepUpGapSeconds) {
+                run->shortestStepUpGapSeconds = gap;
+            }
+        }
+        if (seconds >= totalSeconds / 2.0 &&
+            (run->shortestGapInLastHalf < 0.0 || gap < run->shortestGapInLastHalf)) {
+            run->shortestGapInLastHalf = gap;
+        }
+        *lastChangeSeconds = seconds;
+    }
+
+    // The model heated by whatever tier the policy picks (or tier 0 throughout
+    // if not governed), read once a second. Until statusSeconds the platform
+    // reports status instead of the model's.
+    static PolicyRun runModel(const HostThermalModel::Params &params, double totalSeconds, bool governed,
+                              float frameCostMs, int status, double statusSeconds) {
+        ThermalPolicyConfig config;
+        OSVROpenGL::defaultThermalPolicyConfig(&config);
+        ThermalPolicyState state;
+        OSVROpenGL::initThermalPolicy(&state, config);
+        HostThermalModel model(params);
+        // what it would have done is beside the point
+        bool verbose = gVerbose;
+        gVerbose = gVerbose && governed;
+        PolicyRun run;
+        startRun(&run);
+        double lastChangeSeconds = 0.0;
+        for (double seconds = 1.0; seconds <= totalSeconds; seconds += 1.0) {
+            model.setTier(governed ? state.tier : 0);
+            model.advance(1.0);
+            ThermalReading reading = model.read();
+            if (seconds < statusSeconds) {
+                reading.status = status;
+            }
+            int previousTier = state.tier;
+            int reason = OSVROpenGL::updateThermalPolicy(&state, reading, frameCostMs);
+            recordDecision(&run, reading, seconds, totalSeconds, previousTier, state.tier, reason,
+                           &lastChangeSeconds);
+        }
+        run.finalTier = state.tier;
+        gVerbose = verbose;
+        return run;
+    }
+
+    static int gFailures = 0;
+
+    static void check(bool ok, const char *what) {
+        printf("  %-72s %s\n", what, ok ? "ok" : "FAILED");
+        if (!ok) {
+            gFailures++;
+        }
+    }
+
+    static int selfCheck() {
+        ThermalPolicyConfig config;
+        OSVROpenGL::defaultThermalPolicyConfig(&config);
+        float budgetMs = static_cast<float>(config.displayPeriodNs * 1.0e-6);
+        float lightFrameMs = budgetMs * 0.5f;
+        uint64_t stepUpHoldSeconds = config.stepUpHoldNs / 1000000000ull;
+
+        printf("tier power (relative to tier 0):");
+        for (int tier = 0; tier < OSVROpenGL::kQualityTierCount; tier++) {
+            printf(" %.2f", HostThermalModel::tierPower(tier));
+        }
+        printf("\n");
+
+        // A long session on a phone that would settle well past throttling at full quality
+        HostThermalModel::Params hot;
+        HostThermalModel::defaultParams(&hot);
+        printf("sustained load, 40 min:\n");
+        PolicyRun ungoverned = runModel(hot, 2400.0, false, lightFrameMs, OSVROpenGL::THERMAL_STATUS_UNKNOWN, 0.0);
+        printf("    ungoverned: up to %.1f C, status %d\n", ungoverned.maxTemperatureC, ungoverned.maxStatus);
+        PolicyRun sustained = runModel(hot, 2400.0, true, lightFrameMs, OSVROpenGL::THERMAL_STATUS_UNKNOWN, 0.0);
+        printf("    governed: up to %.1f C, status %d, first step down at %.0f s (%.1f C), "
+               "%d down / %d up, tier %d at the end\n",
+               sustained.maxTemperatureC, sustained.maxStatus, sustained.firstStepDownSeconds,
+               sustained.firstStepDownC, sustained.stepsDown, sustained.stepsUp, sustained.finalTier);
+        check(ungoverned.maxStatus >= OSVROpenGL::THERMAL_STATUS_MODERATE, "ungoverned, the platform throttles");
+        check(sustained.firstStepDownSeconds > 0.0 && sustained.firstStepDownC < config.throttleTemperatureC,
+              "steps down before reaching the throttling temperature");
+        check(sustained.maxStatus <= OSVROpenGL::THERMAL_STATUS_NONE, "never reaches a throttling status");
+        check(sustained.shortestGapInLastHalf < 0.0 || sustained.shortestGapInLastHalf >= 300.0,
+              "settles: in the second half, tier changes at least 5 min apart");
+        check(sustained.shortestStepUpGapSeconds < 0.0 ||
+              sustained.shortestStepUpGapSeconds >= static_cast<double>(stepUpHoldSeconds),
+              "steps up only after the hold");
+
+        // The platform reports a severe status for the first two minutes (e.g.
+        // it was charging), on a phone that stays cool at full quality
+        HostThermalModel::Params cool = hot;
+        cool.fullPowerRiseC = 40.0f;
+        printf("severe status for 2 min, then a cool phone, 20 min:\n");
+        PolicyRun recovery = runModel(cool, 1200.0, true, lightFrameMs, OSVROpenGL::THERMAL_STATUS_SEVERE, 120.0);
+        printf("    first step down at %.0f s, %d down / %d up, tier %d at the end\n",
+               recovery.firstStepDownSeconds, recovery.stepsDown, recovery.stepsUp, recovery.finalTier);
+        check(recovery.firstStepDownSeconds == 1.0 && recovery.stepsDown == 1,
+              "takes the status' tier at once, in one step");
+        check(recovery.finalTier == 0, "steps back up to full quality");
+        check(recovery.shortestStepUpGapSeconds >= static_cast<double>(stepUpHoldSeconds),
+              "one step up per hold");
+
+        // A sensor sitting just under where stepping up stops, with noise
+        // that makes the trend swing both ways
+        printf("noisy sensor under the step up margin, 30 min:\n");
+        ThermalPolicyState state;
+        OSVROpenGL::initThermalPolicy(&state, config);
+        PolicyRun noisy;
+        startRun(&noisy);
+        double lastChangeSeconds = 0.0;
+        uint32_t noise = 99u;
+        for (int second = 1; second <= 1800; second++) {
+            noise = noise * 1664525u + 1013904223u;
+            ThermalReading reading;
+            reading.timeNs = static_cast<uint64_t>(second) * 1000000000ull;
+            reading.temperatureC = config.throttleTemperatureC - config.stepUpMarginC - 1.0f +
+                                   (static_cast<float>(noise >> 8) / 8388608.0f - 1.0f) * 1.5f;
+            reading.status = OSVROpenGL::THERMAL_STATUS_NONE;
+            int previousTier = state.tier;
+            int reason = OSVROpenGL::updateThermalPolicy(&state, reading, lightFrameMs);
+            recordDecision(&noisy, reading, second, 1800.0, previousTier, state.tier, reason, &lastChangeSeconds);
+        }
+        noisy.finalTier = state.tier;
+        printf("    %d down / %d up\n", noisy.stepsDown, noisy.stepsUp);
+        check(noisy.stepsDown + noisy.stepsUp == 0, "stays at full quality");
+
+        // No sensors: only the frames, which cost 17 ms at full quality and
+        // less with the render scale
+        printf("frame times only, 17 ms frames at tier 0, 10 min:\n");
+        OSVROpenGL::initThermalPolicy(&state, config);
+        PolicyRun frames;
+        startRun(&frames);
+        lastChangeSeconds = 0.0;
+        for (int second = 1; second <= 600; second++) {
+            float scale = OSVROpenGL::qualityTier(state.tier).renderScale;
+            ThermalReading reading;
+            reading.timeNs = static_cast<uint64_t>(second) * 1000000000ull;
+            reading.temperatureC = NAN;
+            reading.status = OSVROpenGL::THERMAL_STATUS_UNKNOWN;
+            int previousTier = state.tier;
+            int reason = OSVROpenGL::updateThermalPolicy(&state, reading, 17.0f * (0.4f + 0.6f * scale * scale));
+            recordDecision(&frames, reading, second, 600.0, previousTier, state.tier, reason, &lastChangeSeconds);
+        }
+        frames.finalTier = state.tier;
+        printf("    %d down / %d up, tier %d at the end\n", frames.stepsDown, frames.stepsUp, frames.finalTier);
+        check(frames.finalTier > 0 && frames.stepsUp == 0,
+              "steps down to fit the display period and stays there");
+        check(17.0f * (0.4f + 0.6f * std::pow(OSVROpenGL::qualityTier(frames.finalTier).renderScale, 2.0f)) <=
+              config.frameBudgetHigh * budgetMs, "its frames fit");
+
+        if (gFailures) {
+            printf("%d checks FAILED\n", gFailures);
+            return 3;
+        }
+        printf("all checks passed\n");
+        return 0;
+    }
+
+    // Replays a trace; returns the number of readings the policy now decides
+    // differently on, or -1 if the file can't be read.
+    static int replayTrace(const char *path) {
+        FILE *file = fopen(path, "r");
+        if (!file) {
+            fprintf(stderr, "Could not open %s\n", path);
+            return -1;
+        }
+        ThermalPolicyConfig config;
+        OSVROpenGL::defaultThermalPolicyConfig(&config);
+        ThermalPolicyState state;
+        OSVROpenGL::initThermalPolicy(&state, config);
+        PolicyRun run;
+        startRun(&run);
+        double lastChangeSeconds = 0.0;
+        double firstSeconds = -1.0, seconds = 0.0;
+        int readings = 0, mismatches = 0;
+        char line[256];
+        while (fgets(line, sizeof(line), file)) {
+            if (line[0] == '#' || line[0] == '\n') {
+                continue;
+            }
+            double timeSeconds, periodMs;
+            float frameCostMs;
+            int recordedTier, recordedReason;
+            ThermalReading reading;
+            if (sscanf(line, "%lf,%f,%d,%f,%lf,%d,%d", &timeSeconds, &reading.temperatureC, &reading.status,
+                       &frameCostMs, &periodMs, &recordedTier, &recordedReason) != 7) {
+                fprintf(stderr, "%s: bad line: %s", path, line);
+                fclose(file);
+                return -1;
+            }
+            reading.timeNs = static_cast<uint64_t>(std::llround(timeSeconds * 1.0e9));
+            if (firstSeconds < 0.0) {
+                firstSeconds = timeSeconds;
+            }
+            seconds = timeSeconds - firstSeconds;
+            state.config.displayPeriodNs = static_cast<uint64_t>(std::llround(periodMs * 1.0e6));
+            int previousTier = state.tier;
+            int reason = OSVROpenGL::updateThermalPolicy(&state, reading, frameCostMs);
+            recordDecision(&run, reading, seconds, 0.0, previousTier, state.tier, reason, &lastChangeSeconds);
+            if (state.tier != recordedTier) {
+                if (!mismatches) {
+                    printf("    first difference at %.0f s: tier %d, recorded %d\n", seconds, state.tier,
+                           recordedTier);
+                }
+                mismatches++;
+            }
+            readings++;
+        }
+        fclose(file);
+        printf("%s: %d readings over %.0f s, up to %.1f C, status %d; %d down / %d up, tier %d at the end; "
+               "%d decisions differ\n", path, readings, seconds, run.maxTemperatureC, run.maxStatus,
+               run.stepsDown, run.stepsUp, state.tier, mismatches);
+        return mismatches;
+    }
+}
+
+int main(int argc, char **argv) {
+    bool selfCheck = false;
+    std::vector<const char *> traces;
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "--self-check")) {
+            selfCheck = true;
+        } else if (!strcmp(argv[i], "--verbose")) {
+            OSVROpenGLHost::gVerbose = true;
+        } else if (argv[i][0] == '-') {
+            fprintf(stderr, "Unknown option %s\n", argv[i]);
+            return 1;
+        } else {
+            traces.push_back(argv[i]);
+        }
+    }
+    if (selfCheck) {
+        return OSVROpenGLHost::selfCheck();
+    }
+    if (traces.empty()) {
+        fprintf(stderr, "usage: thermal_tool --self-check | trace.csv...\n");
+        return 1;
+    }
+    int status = 0;
+    for (size_t i = 0; i < traces.size(); i++) {
+        int mismatches = OSVROpenGLHost::replayTrace(traces[i]);
+        if (mismatches < 0) {
+            return 2;
+        }
+        if (mismatches > 0) {
+            status = 3;
+        }
+    }
+    return status;
+}
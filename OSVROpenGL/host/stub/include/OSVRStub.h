@@ -0,0 +1,66 @@
+/*
+ * Copyright (C) 2015 Sensics, Inc. and contributors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+// Controls for the host stand-in of OSVR ClientKit and RenderManager. The stub
+// feeds the sample synthetic data: a head pose that slowly sweeps yaw and pitch,
+// a side-by-side two eye display, a scrolling RGBA camera image and periodic
+// button / location2D reports. Everything is driven by osvrClientUpdate, so a
+// fixed update interval makes runs reproducible.
+
+#ifndef OSVR_HOST_STUB_OSVRSTUB_H
+#define OSVR_HOST_STUB_OSVRSTUB_H
+
+#include <osvr/Util/StubTypesC.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct OSVRStubConfig {
+    int displayWidth;               // whole display; each eye gets half the width
+    int displayHeight;
+    double updateIntervalSeconds;   // synthetic time per osvrClientUpdate, 0 for wall clock
+    int cameraEveryNUpdates;        // 0 disables the camera
+    int cameraWidth;
+    int cameraHeight;
+    int cameraChannels;             // 1 (grey), 3 (RGB) or 4 (RGBA)
+    int buttonEveryNUpdates;        // 0 disables button reports
+    int location2DEveryNUpdates;    // 0 disables location2D reports
+} OSVRStubConfig;
+
+void osvrStubGetDefaultConfig(OSVRStubConfig *configOut);
+
+// Takes effect for contexts and render managers created afterwards.
+void osvrStubSetConfig(const OSVRStubConfig *config);
+void osvrStubGetConfig(OSVRStubConfig *configOut);
+
+// The stub's notion of "now", as used for report timestamps and poses.
+void osvrStubGetTime(OSVR_TimeValue *timeOut);
+
+// Head pose at the given time.
+void osvrStubGetHeadPose(const OSVR_TimeValue *time, OSVR_PoseState *poseOut);
+
+// Optional hooks, defined by the host harness, bracketing work done "inside the
+// OSVR libraries" so it can be told apart from the app's own (e.g. when
+// counting allocations). Report callbacks into the app run outside the bracket.
+void osvrHostEnterLibrary(void) __attribute__((weak));
+void osvrHostLeaveLibrary(void) __attribute__((weak));
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // OSVR_HOST_STUB_OSVRSTUB_H
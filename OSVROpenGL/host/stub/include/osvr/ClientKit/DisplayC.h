@@ -0,0 +1,27 @@
+/*
+ * Copyright (C) 2015 Sensics, Inc. and contributors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+// Host build stand-in for <osvr/ClientKit/DisplayC.h>, implemented by the OSVR stub library.
+
+#ifndef OSVR_HOST_STUB_DISPLAYC_H
+#define OSVR_HOST_STUB_DISPLAYC_H
+
+#include <osvr/Util/StubTypesC.h>
+
+// The display config API is not used by the sample.
+
+#endif // OSVR_HOST_STUB_DISPLAYC_H
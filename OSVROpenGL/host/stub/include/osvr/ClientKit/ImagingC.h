@@ -0,0 +1,38 @@
+/*
+ * Copyright (C) 2015 Sensics, Inc. and contributors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+// Host build stand-in for <osvr/ClientKit/ImagingC.h>, implemented by the OSVR stub library.
+
+#ifndef OSVR_HOST_STUB_IMAGINGC_H
+#define OSVR_HOST_STUB_IMAGINGC_H
+
+#include <osvr/Util/StubTypesC.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef void (*OSVR_ImagingCallback)(void *userdata, const OSVR_TimeValue *timestamp, const OSVR_ImagingReport *report);
+
+OSVR_ReturnCode osvrRegisterImagingCallback(OSVR_ClientInterface iface, OSVR_ImagingCallback cb, void *userdata);
+OSVR_ReturnCode osvrClientFreeImage(OSVR_ClientContext ctx, OSVR_ImageBufferElement *buf);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // OSVR_HOST_STUB_IMAGINGC_H
@@ -0,0 +1,46 @@
+/*
+ * Copyright (C) 2015 Sensics, Inc. and contributors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+// Host build stand-in for <osvr/RenderKit/RenderKitGraphicsTransforms.h>, implemented by the OSVR stub library.
+
+#ifndef OSVR_HOST_STUB_RENDERKITGRAPHICSTRANSFORMS_H
+#define OSVR_HOST_STUB_RENDERKITGRAPHICSTRANSFORMS_H
+
+#include <osvr/RenderKit/RenderManagerC.h>
+
+#define OSVR_MATRIX_SIZE 16
+
+namespace osvr {
+namespace renderkit {
+    typedef struct OSVR_ProjectionMatrix {
+        double left;
+        double right;
+        double top;
+        double bottom;
+        double nearClip;
+        double farClip;
+    } OSVR_ProjectionMatrix;
+}
+}
+
+// Column-major OpenGL view matrix (the inverse of the pose).
+bool OSVR_PoseState_to_OpenGL(double *OpenGL_out, const OSVR_PoseState &state_in);
+
+// Column-major OpenGL projection matrix (glFrustum).
+bool OSVR_Projection_to_OpenGL(double *OpenGL_out, const OSVR_ProjectionMatrix &projection_in);
+
+#endif // OSVR_HOST_STUB_RENDERKITGRAPHICSTRANSFORMS_H
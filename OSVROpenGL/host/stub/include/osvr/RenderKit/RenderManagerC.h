@@ -0,0 +1,86 @@
+/*
+ * Copyright (C) 2015 Sensics, Inc. and contributors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+// Host build stand-in for <osvr/RenderKit/RenderManagerC.h>, implemented by the OSVR stub library.
+
+#ifndef OSVR_HOST_STUB_RENDERMANAGERC_H
+#define OSVR_HOST_STUB_RENDERMANAGERC_H
+
+#include <osvr/Util/StubTypesC.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef void *OSVR_RenderManager;
+typedef void *OSVR_RenderInfoCollection;
+typedef void *OSVR_RenderManagerPresentState;
+typedef void *OSVR_RenderManagerRegisterBufferState;
+typedef size_t OSVR_RenderInfoCount;
+
+typedef enum OSVR_OpenStatus {
+    OSVR_OPEN_STATUS_FAILURE,
+    OSVR_OPEN_STATUS_PARTIAL,
+    OSVR_OPEN_STATUS_COMPLETE
+} OSVR_OpenStatus;
+
+typedef struct OSVR_ViewportDescription {
+    double left;
+    double lower;
+    double width;
+    double height;
+} OSVR_ViewportDescription;
+
+// Clipping planes at the near clip distance.
+typedef struct OSVR_ProjectionMatrix {
+    double left;
+    double right;
+    double top;
+    double bottom;
+    double nearClip;
+    double farClip;
+} OSVR_ProjectionMatrix;
+
+typedef struct OSVR_RenderParams {
+    OSVR_PoseState *worldFromRoomAppend;
+    OSVR_PoseState *roomFromHeadReplace;
+    double nearClipDistanceMeters;
+    double farClipDistanceMeters;
+} OSVR_RenderParams;
+
+OSVR_ReturnCode osvrDestroyRenderManager(OSVR_RenderManager renderManager);
+OSVR_ReturnCode osvrRenderManagerGetDefaultRenderParams(OSVR_RenderParams *renderParamsOut);
+
+OSVR_ReturnCode osvrRenderManagerGetRenderInfoCollection(OSVR_RenderManager renderManager,
+        OSVR_RenderParams renderParams, OSVR_RenderInfoCollection *renderInfoCollectionOut);
+OSVR_ReturnCode osvrRenderManagerReleaseRenderInfoCollection(OSVR_RenderInfoCollection renderInfoCollection);
+OSVR_ReturnCode osvrRenderManagerGetNumRenderInfoInCollection(OSVR_RenderInfoCollection renderInfoCollection,
+        OSVR_RenderInfoCount *countOut);
+
+OSVR_ReturnCode osvrRenderManagerStartPresentRenderBuffers(OSVR_RenderManagerPresentState *presentStateOut);
+OSVR_ReturnCode osvrRenderManagerFinishPresentRenderBuffers(OSVR_RenderManager renderManager,
+        OSVR_RenderManagerPresentState presentState, OSVR_RenderParams renderParams, OSVR_CBool shouldFlipY);
+
+OSVR_ReturnCode osvrRenderManagerStartRegisterRenderBuffers(OSVR_RenderManagerRegisterBufferState *registerBufferStateOut);
+OSVR_ReturnCode osvrRenderManagerFinishRegisterRenderBuffers(OSVR_RenderManager renderManager,
+        OSVR_RenderManagerRegisterBufferState registerBufferState, OSVR_CBool appWillNotOverwriteBeforeNewPresent);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // OSVR_HOST_STUB_RENDERMANAGERC_H
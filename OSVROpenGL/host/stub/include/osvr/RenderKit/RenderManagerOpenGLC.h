@@ -0,0 +1,105 @@
+/*
+ * Copyright (C) 2015 Sensics, Inc. and contributors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+// Host build stand-in for <osvr/RenderKit/RenderManagerOpenGLC.h>, implemented by the OSVR stub library.
+
+#ifndef OSVR_HOST_STUB_RENDERMANAGEROPENGLC_H
+#define OSVR_HOST_STUB_RENDERMANAGEROPENGLC_H
+
+#include <osvr/RenderKit/RenderManagerC.h>
+
+#include <GLES2/gl2.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef void *OSVR_RenderManagerOpenGL;
+
+typedef struct OSVR_OpenGLContextParams {
+    const char *windowTitle;
+    OSVR_CBool fullScreen;
+    int width;
+    int height;
+    int xPos;
+    int yPos;
+    int bitsPerPixel;
+    unsigned numBuffers;
+    OSVR_CBool visible;
+} OSVR_OpenGLContextParams;
+
+typedef struct OSVR_OpenGLToolkitFunctions {
+    size_t size;
+    void *data;
+    void (*create)(void *data);
+    void (*destroy)(void *data);
+    OSVR_CBool (*addOpenGLContext)(void *data, const OSVR_OpenGLContextParams *p);
+    OSVR_CBool (*removeOpenGLContexts)(void *data);
+    OSVR_CBool (*makeCurrent)(void *data, size_t display);
+    OSVR_CBool (*swapBuffers)(void *data, size_t display);
+    OSVR_CBool (*setVerticalSync)(void *data, OSVR_CBool verticalSync);
+    OSVR_CBool (*handleEvents)(void *data);
+    OSVR_CBool (*getDisplayFrameBuffer)(void *data, size_t display, GLuint *displayFrameBufferOut);
+    OSVR_CBool (*getDisplaySizeOverride)(void *data, size_t display, int *width, int *height);
+} OSVR_OpenGLToolkitFunctions;
+
+typedef struct OSVR_GraphicsLibraryOpenGL {
+    const OSVR_OpenGLToolkitFunctions *toolkit;
+} OSVR_GraphicsLibraryOpenGL;
+
+typedef struct OSVR_RenderBufferOpenGL {
+    GLuint colorBufferName;
+    GLuint depthStencilBufferName;
+} OSVR_RenderBufferOpenGL;
+
+typedef struct OSVR_RenderInfoOpenGL {
+    OSVR_GraphicsLibraryOpenGL library;
+    OSVR_ViewportDescription viewport;
+    OSVR_PoseState pose;
+    OSVR_ProjectionMatrix projection;
+} OSVR_RenderInfoOpenGL;
+
+typedef struct OSVR_OpenResultsOpenGL {
+    OSVR_OpenStatus status;
+    OSVR_GraphicsLibraryOpenGL library;
+    OSVR_RenderBufferOpenGL buffers;
+} OSVR_OpenResultsOpenGL;
+
+OSVR_ReturnCode osvrCreateRenderManagerOpenGL(OSVR_ClientContext clientContext,
+        const char graphicsLibraryName[], OSVR_GraphicsLibraryOpenGL graphicsLibrary,
+        OSVR_RenderManager *renderManagerOut, OSVR_RenderManagerOpenGL *renderManagerOpenGLOut);
+OSVR_ReturnCode osvrRenderManagerOpenDisplayOpenGL(OSVR_RenderManagerOpenGL renderManager,
+        OSVR_OpenResultsOpenGL *openResultsOut);
+
+OSVR_ReturnCode osvrRenderManagerGetRenderInfoFromCollectionOpenGL(OSVR_RenderInfoCollection renderInfoCollection,
+        OSVR_RenderInfoCount index, OSVR_RenderInfoOpenGL *renderInfoOut);
+
+OSVR_ReturnCode osvrRenderManagerCreateColorBufferOpenGL(GLsizei width, GLsizei height, GLenum format,
+        GLuint *colorBufferNameOut);
+OSVR_ReturnCode osvrRenderManagerCreateDepthBufferOpenGL(GLsizei width, GLsizei height, GLuint *depthBufferNameOut);
+
+OSVR_ReturnCode osvrRenderManagerPresentRenderBufferOpenGL(OSVR_RenderManagerPresentState presentState,
+        OSVR_RenderBufferOpenGL buffer, OSVR_RenderInfoOpenGL renderInfoUsed,
+        OSVR_ViewportDescription normalizedCroppingViewport);
+OSVR_ReturnCode osvrRenderManagerRegisterRenderBufferOpenGL(OSVR_RenderManagerRegisterBufferState registerBufferState,
+        OSVR_RenderBufferOpenGL renderBuffer);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // OSVR_HOST_STUB_RENDERMANAGEROPENGLC_H
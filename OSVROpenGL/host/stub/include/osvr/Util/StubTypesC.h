@@ -0,0 +1,101 @@
+/*
+ * Copyright (C) 2015 Sensics, Inc. and contributors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+// Host build stand-in for the OSVR Util C types used by the sample. Only what
+// the rendering core touches is declared, with the same names and layouts as
+// the real OSVR-Core headers.
+
+#ifndef OSVR_HOST_STUB_TYPESC_H
+#define OSVR_HOST_STUB_TYPESC_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+typedef char OSVR_ReturnCode;
+#define OSVR_RETURN_SUCCESS (0)
+#define OSVR_RETURN_FAILURE (1)
+
+typedef uint8_t OSVR_CBool;
+#define OSVR_TRUE (1)
+#define OSVR_FALSE (0)
+
+typedef struct OSVR_ClientContextObject *OSVR_ClientContext;
+typedef struct OSVR_ClientInterfaceObject *OSVR_ClientInterface;
+
+typedef int64_t OSVR_TimeValue_Seconds;
+typedef int32_t OSVR_TimeValue_Microseconds;
+typedef struct OSVR_TimeValue {
+    OSVR_TimeValue_Seconds seconds;
+    OSVR_TimeValue_Microseconds microseconds;
+} OSVR_TimeValue;
+
+typedef uint32_t OSVR_ChannelCount;
+
+typedef struct OSVR_Vec2 { double data[2]; } OSVR_Vec2;
+typedef struct OSVR_Vec3 { double data[3]; } OSVR_Vec3;
+// w, x, y, z
+typedef struct OSVR_Quaternion { double data[4]; } OSVR_Quaternion;
+typedef struct OSVR_PoseState {
+    OSVR_Vec3 translation;
+    OSVR_Quaternion rotation;
+} OSVR_PoseState;
+
+typedef uint8_t OSVR_ButtonState;
+#define OSVR_BUTTON_PRESSED (1)
+#define OSVR_BUTTON_NOT_PRESSED (0)
+typedef struct OSVR_ButtonReport {
+    int32_t sensor;
+    OSVR_ButtonState state;
+} OSVR_ButtonReport;
+
+typedef OSVR_Vec2 OSVR_Location2DState;
+typedef struct OSVR_Location2DReport {
+    OSVR_ChannelCount sensor;
+    OSVR_Location2DState location;
+} OSVR_Location2DReport;
+
+typedef struct OSVR_PoseReport {
+    int32_t sensor;
+    OSVR_PoseState pose;
+} OSVR_PoseReport;
+
+typedef unsigned char OSVR_ImageBufferElement;
+typedef uint32_t OSVR_ImageDimension;
+typedef uint8_t OSVR_ImageChannels;
+typedef uint8_t OSVR_ImageDepth;
+typedef enum OSVR_ImagingValueType {
+    OSVR_IVT_UNSIGNED_INT = 0,
+    OSVR_IVT_SIGNED_INT = 1,
+    OSVR_IVT_FLOATING_POINT = 2
+} OSVR_ImagingValueType;
+typedef struct OSVR_ImagingMetadata {
+    OSVR_ImageDimension height;
+    OSVR_ImageDimension width;
+    OSVR_ImageChannels channels;
+    OSVR_ImageDepth depth;
+    OSVR_ImagingValueType type;
+} OSVR_ImagingMetadata;
+typedef struct OSVR_ImagingState {
+    OSVR_ImagingMetadata metadata;
+    OSVR_ImageBufferElement *data;
+} OSVR_ImagingState;
+typedef struct OSVR_ImagingReport {
+    OSVR_ChannelCount sensor;
+    OSVR_ImagingState state;
+} OSVR_ImagingReport;
+
+#endif // OSVR_HOST_STUB_TYPESC_H
@@ -0,0 +1,36 @@
+/*
+ * Copyright (C) 2015 Sensics, Inc. and contributors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include <cstdarg>
+#include <cstdio>
+#include <cstring>
+
+#include <android/log.h>
+
+extern "C" int __android_log_print(int prio, const char *tag, const char *fmt, ...) {
+    static const char kPriorities[] = "??VDIWEFS";
+    char priority = prio >= 0 && prio < static_cast<int>(sizeof(kPriorities) - 1) ? kPriorities[prio] : '?';
+    fprintf(stderr, "%c/%s: ", priority, tag ? tag : "");
+    va_list args;
+    va_start(args, fmt);
+    int ret = vfprintf(stderr, fmt, args);
+    va_end(args);
+    if (fmt[0] && fmt[strlen(fmt) - 1] != '\n') {
+        fputc('\n', stderr);
+    }
+    return ret;
+}
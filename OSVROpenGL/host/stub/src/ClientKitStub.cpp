@@ -0,0 +1,364 @@
+/*
+ * Copyright (C) 2015 Sensics, Inc. and contributors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <string>
+#include <vector>
+
+#include <osvr/ClientKit/ContextC.h>
+#include <osvr/ClientKit/InterfaceC.h>
+#include <osvr/ClientKit/InterfaceStateC.h>
+#include <osvr/ClientKit/InterfaceCallbackC.h>
+#include <osvr/ClientKit/ImagingC.h>
+#include <osvr/ClientKit/ServerAutoStartC.h>
+#include <osvr/Util/TimeValueC.h>
+
+#include "StubInternal.h"
+
+struct OSVR_ClientInterfaceObject {
+    std::string path;
+    OSVR_ButtonCallback buttonCallback;
+    void *buttonUserdata;
+    OSVR_Location2DCallback location2DCallback;
+    void *location2DUserdata;
+    OSVR_ImagingCallback imagingCallback;
+    void *imagingUserdata;
+    OSVR_PoseCallback poseCallback;
+    void *poseUserdata;
+    OSVR_ButtonState buttonState;
+};
+
+struct OSVR_ClientContextObject {
+    std::vector<OSVR_ClientInterfaceObject *> interfaces;
+    uint64_t updateCount;
+    size_t nextButton;
+};
+
+namespace osvrstub {
+
+    static OSVRStubConfig gConfig;
+    static bool gConfigSet = false;
+    static uint64_t gUpdateCount = 0;
+    static uint64_t gWallClockStartNs = 0;
+    static uint64_t gLastUpdateNs = 0;
+
+    static uint64_t monotonicNs() {
+        timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return static_cast<uint64_t>(ts.tv_sec) * 1000000000ull + static_cast<uint64_t>(ts.tv_nsec);
+    }
+
+    const OSVRStubConfig &config() {
+        if (!gConfigSet) {
+            osvrStubGetDefaultConfig(&gConfig);
+            gConfigSet = true;
+        }
+        return gConfig;
+    }
+
+    void advanceTime() {
+        gUpdateCount++;
+        gLastUpdateNs = monotonicNs();
+    }
+
+    static void toTimeValue(uint64_t ns, OSVR_TimeValue *out) {
+        out->seconds = static_cast<OSVR_TimeValue_Seconds>(ns / 1000000000ull);
+        out->microseconds = static_cast<OSVR_TimeValue_Microseconds>((ns % 1000000000ull) / 1000ull);
+    }
+
+    static double toSeconds(const OSVR_TimeValue &time) {
+        return static_cast<double>(time.seconds) + time.microseconds / 1.0e6;
+    }
+
+    static void quaternionFromYawPitch(double yaw, double pitch, OSVR_Quaternion *out) {
+        // yaw about +Y, then pitch about +X
+        double cy = cos(yaw * 0.5), sy = sin(yaw * 0.5);
+        double cp = cos(pitch * 0.5), sp = sin(pitch * 0.5);
+        out->data[0] = cy * cp;
+        out->data[1] = cy * sp;
+        out->data[2] = sy * cp;
+        out->data[3] = -sy * sp;
+    }
+
+    // A scrolling diagonal gradient, so consecutive frames differ. Grey frames
+    // get its blue channel.
+    static void fillCameraImage(OSVR_ImageBufferElement *data, int width, int height, int channels,
+                                uint64_t frame) {
+        for (int y = 0; y < height; y++) {
+            OSVR_ImageBufferElement *row = data + static_cast<size_t>(y) * width * channels;
+            uint32_t base = static_cast<uint32_t>(y + frame * 4);
+            for (int x = 0; x < width; x++) {
+                uint32_t v = (base + x) & 0xff;
+                OSVR_ImageBufferElement rgba[4] = {
+                    static_cast<OSVR_ImageBufferElement>(v * 3), static_cast<OSVR_ImageBufferElement>(255 - v),
+                    static_cast<OSVR_ImageBufferElement>(v), 0xff
+                };
+                memcpy(row + x * channels, channels == 1 ? rgba + 2 : rgba, channels);
+            }
+        }
+    }
+}
+
+using namespace osvrstub;
+
+extern "C" {
+
+void osvrStubGetDefaultConfig(OSVRStubConfig *configOut) {
+    configOut->displayWidth = 1280;
+    configOut->displayHeight = 720;
+    configOut->updateIntervalSeconds = 1.0 / 60.0;
+    configOut->cameraEveryNUpdates = 2;
+    configOut->cameraWidth = 640;
+    configOut->cameraHeight = 480;
+    configOut->cameraChannels = 4;
+    configOut->buttonEveryNUpdates = 90;
+    configOut->location2DEveryNUpdates = 15;
+}
+
+void osvrStubSetConfig(const OSVRStubConfig *config) {
+    gConfig = *config;
+    gConfigSet = true;
+}
+
+void osvrStubGetConfig(OSVRStubConfig *configOut) {
+    *configOut = config();
+}
+
+void osvrStubGetTime(OSVR_TimeValue *timeOut) {
+    // Synthetic time starts at an arbitrary, fixed epoch so runs are repeatable.
+    const uint64_t epochNs = 1000ull * 1000000000ull;
+    if (config().updateIntervalSeconds > 0.0) {
+        toTimeValue(epochNs + static_cast<uint64_t>(gUpdateCount * config().updateIntervalSeconds * 1.0e9), timeOut);
+    } else {
+        if (!gWallClockStartNs) {
+            gWallClockStartNs = monotonicNs();
+        }
+        toTimeValue(epochNs + (monotonicNs() - gWallClockStartNs), timeOut);
+    }
+}
+
+void osvrTimeValueGetNow(OSVR_TimeValue *dest) {
+    osvrStubGetTime(dest);
+    if (config().updateIntervalSeconds > 0.0 && gLastUpdateNs) {
+        // Synthetic time stands still between updates; let real time pass on top
+        // of it so that "now" minus a report's timestamp is a real age.
+        uint64_t sinceUpdateNs = monotonicNs() - gLastUpdateNs;
+        uint64_t ns = static_cast<uint64_t>(dest->seconds) * 1000000000ull +
+                      static_cast<uint64_t>(dest->microseconds) * 1000ull + sinceUpdateNs;
+        toTimeValue(ns, dest);
+    }
+}
+
+void osvrStubGetHeadPose(const OSVR_TimeValue *time, OSVR_PoseState *poseOut) {
+    const double twoPi = 6.283185307179586;
+    double t = toSeconds(*time);
+    double yaw = 0.6 * sin(twoPi * 0.2 * t);
+    double pitch = 0.25 * sin(twoPi * 0.13 * t);
+    memset(poseOut, 0, sizeof(*poseOut));
+    quaternionFromYawPitch(yaw, pitch, &poseOut->rotation);
+}
+
+OSVR_ClientContext osvrClientInit(const char applicationIdentifier[], uint32_t flags) {
+    LibraryScope scope;
+    OSVR_ClientContextObject *ctx = new OSVR_ClientContextObject();
+    ctx->updateCount = 0;
+    ctx->nextButton = 0;
+    return ctx;
+}
+
+OSVR_ReturnCode osvrClientUpdate(OSVR_ClientContext ctx) {
+    if (!ctx) {
+        return OSVR_RETURN_FAILURE;
+    }
+    LibraryScope scope;
+    advanceTime();
+    ctx->updateCount++;
+    const OSVRStubConfig &cfg = config();
+
+    OSVR_TimeValue now;
+    osvrStubGetTime(&now);
+
+    for (size_t i = 0; i < ctx->interfaces.size(); i++) {
+        OSVR_ClientInterfaceObject *iface = ctx->interfaces[i];
+
+        if (iface->imagingCallback && cfg.cameraEveryNUpdates > 0 &&
+            ctx->updateCount % cfg.cameraEveryNUpdates == 0) {
+            size_t size = static_cast<size_t>(cfg.cameraWidth) * cfg.cameraHeight * cfg.cameraChannels;
+            OSVR_ImageBufferElement *data = static_cast<OSVR_ImageBufferElement *>(malloc(size));
+            fillCameraImage(data, cfg.cameraWidth, cfg.cameraHeight, cfg.cameraChannels, ctx->updateCount);
+
+            OSVR_ImagingReport report;
+            memset(&report, 0, sizeof(report));
+            report.state.metadata.width = static_cast<OSVR_ImageDimension>(cfg.cameraWidth);
+            report.state.metadata.height = static_cast<OSVR_ImageDimension>(cfg.cameraHeight);
+            report.state.metadata.channels = static_cast<OSVR_ImageChannels>(cfg.cameraChannels);
+            report.state.metadata.depth = 1;
+            report.state.metadata.type = OSVR_IVT_UNSIGNED_INT;
+            report.state.data = data;
+            AppScope app;
+            iface->imagingCallback(iface->imagingUserdata, &now, &report);
+        }
+
+        if (iface->location2DCallback && cfg.location2DEveryNUpdates > 0 &&
+            ctx->updateCount % cfg.location2DEveryNUpdates == 0) {
+            double t = static_cast<double>(ctx->updateCount);
+            OSVR_Location2DReport report;
+            report.sensor = 0;
+            report.location.data[0] = 0.5 + 0.5 * sin(t * 0.01);
+            report.location.data[1] = 0.5 + 0.5 * cos(t * 0.013);
+            AppScope app;
+            iface->location2DCallback(iface->location2DUserdata, &now, &report);
+        }
+
+        if (iface->poseCallback) {
+            OSVR_PoseReport report;
+            report.sensor = 0;
+            osvrStubGetHeadPose(&now, &report.pose);
+            AppScope app;
+            iface->poseCallback(iface->poseUserdata, &now, &report);
+        }
+    }
+
+    // Press/release the button interfaces one after another.
+    if (cfg.buttonEveryNUpdates > 0 && ctx->updateCount % cfg.buttonEveryNUpdates == 0) {
+        for (size_t tries = 0; tries < ctx->interfaces.size(); tries++) {
+            OSVR_ClientInterfaceObject *iface = ctx->interfaces[ctx->nextButton % ctx->interfaces.size()];
+            ctx->nextButton++;
+            if (iface->buttonCallback) {
+                iface->buttonState = iface->buttonState ? OSVR_BUTTON_NOT_PRESSED : OSVR_BUTTON_PRESSED;
+                OSVR_ButtonReport report;
+                report.sensor = 0;
+                report.state = iface->buttonState;
+                AppScope app;
+                iface->buttonCallback(iface->buttonUserdata, &now, &report);
+                break;
+            }
+        }
+    }
+    return OSVR_RETURN_SUCCESS;
+}
+
+OSVR_ReturnCode osvrClientCheckStatus(OSVR_ClientContext ctx) {
+    return ctx ? OSVR_RETURN_SUCCESS : OSVR_RETURN_FAILURE;
+}
+
+OSVR_ReturnCode osvrClientShutdown(OSVR_ClientContext ctx) {
+    if (!ctx) {
+        return OSVR_RETURN_FAILURE;
+    }
+    LibraryScope scope;
+    for (size_t i = 0; i < ctx->interfaces.size(); i++) {
+        delete ctx->interfaces[i];
+    }
+    delete ctx;
+    return OSVR_RETURN_SUCCESS;
+}
+
+OSVR_ReturnCode osvrClientGetInterface(OSVR_ClientContext ctx, const char path[], OSVR_ClientInterface *iface) {
+    if (!ctx || !path || !iface) {
+        return OSVR_RETURN_FAILURE;
+    }
+    LibraryScope scope;
+    OSVR_ClientInterfaceObject *ret = new OSVR_ClientInterfaceObject();
+    memset(static_cast<void *>(&ret->buttonCallback), 0,
+           sizeof(OSVR_ClientInterfaceObject) - offsetof(OSVR_ClientInterfaceObject, buttonCallback));
+    ret->path = path;
+    ctx->interfaces.push_back(ret);
+    *iface = ret;
+    return OSVR_RETURN_SUCCESS;
+}
+
+OSVR_ReturnCode osvrClientFreeInterface(OSVR_ClientContext ctx, OSVR_ClientInterface iface) {
+    if (!ctx || !iface) {
+        return OSVR_RETURN_FAILURE;
+    }
+    LibraryScope scope;
+    for (size_t i = 0; i < ctx->interfaces.size(); i++) {
+        if (ctx->interfaces[i] == iface) {
+            ctx->interfaces.erase(ctx->interfaces.begin() + i);
+            delete iface;
+            return OSVR_RETURN_SUCCESS;
+        }
+    }
+    return OSVR_RETURN_FAILURE;
+}
+
+OSVR_ReturnCode osvrGetPoseState(OSVR_ClientInterface iface, OSVR_TimeValue *timestamp, OSVR_PoseState *state) {
+    if (!iface) {
+        return OSVR_RETURN_FAILURE;
+    }
+    OSVR_TimeValue now;
+    osvrStubGetTime(&now);
+    if (timestamp) {
+        *timestamp = now;
+    }
+    osvrStubGetHeadPose(&now, state);
+    return OSVR_RETURN_SUCCESS;
+}
+
+OSVR_ReturnCode osvrRegisterButtonCallback(OSVR_ClientInterface iface, OSVR_ButtonCallback cb, void *userdata) {
+    if (!iface) {
+        return OSVR_RETURN_FAILURE;
+    }
+    iface->buttonCallback = cb;
+    iface->buttonUserdata = userdata;
+    return OSVR_RETURN_SUCCESS;
+}
+
+OSVR_ReturnCode osvrRegisterLocation2DCallback(OSVR_ClientInterface iface, OSVR_Location2DCallback cb, void *userdata) {
+    if (!iface) {
+        return OSVR_RETURN_FAILURE;
+    }
+    iface->location2DCallback = cb;
+    iface->location2DUserdata = userdata;
+    return OSVR_RETURN_SUCCESS;
+}
+
+OSVR_ReturnCode osvrRegisterPoseCallback(OSVR_ClientInterface iface, OSVR_PoseCallback cb, void *userdata) {
+    if (!iface) {
+        return OSVR_RETURN_FAILURE;
+    }
+    iface->poseCallback = cb;
+    iface->poseUserdata = userdata;
+    return OSVR_RETURN_SUCCESS;
+}
+
+OSVR_ReturnCode osvrRegisterImagingCallback(OSVR_ClientInterface iface, OSVR_ImagingCallback cb, void *userdata) {
+    if (!iface) {
+        return OSVR_RETURN_FAILURE;
+    }
+    iface->imagingCallback = cb;
+    iface->imagingUserdata = userdata;
+    return OSVR_RETURN_SUCCESS;
+}
+
+OSVR_ReturnCode osvrClientFreeImage(OSVR_ClientContext ctx, OSVR_ImageBufferElement *buf) {
+    LibraryScope scope;
+    free(buf);
+    return OSVR_RETURN_SUCCESS;
+}
+
+void osvrClientAttemptServerAutoStart() {
+}
+
+void osvrClientReleaseAutoStartedServer() {
+}
+
+}
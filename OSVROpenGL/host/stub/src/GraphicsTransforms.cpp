@@ -0,0 +1,69 @@
+/*
+ * Copyright (C) 2015 Sensics, Inc. and contributors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include <osvr/RenderKit/RenderKitGraphicsTransforms.h>
+
+bool OSVR_PoseState_to_OpenGL(double *OpenGL_out, const OSVR_PoseState &state_in) {
+    const double w = state_in.rotation.data[0];
+    const double x = state_in.rotation.data[1];
+    const double y = state_in.rotation.data[2];
+    const double z = state_in.rotation.data[3];
+
+    // Rotation of the pose, row-major
+    double r[3][3] = {
+        { 1 - 2 * (y * y + z * z), 2 * (x * y - w * z), 2 * (x * z + w * y) },
+        { 2 * (x * y + w * z), 1 - 2 * (x * x + z * z), 2 * (y * z - w * x) },
+        { 2 * (x * z - w * y), 2 * (y * z + w * x), 1 - 2 * (x * x + y * y) }
+    };
+    const double *t = state_in.translation.data;
+
+    // The view matrix is the inverse: transposed rotation, rotated and negated translation.
+    for (int col = 0; col < 3; col++) {
+        for (int row = 0; row < 3; row++) {
+            OpenGL_out[col * 4 + row] = r[col][row];
+        }
+        OpenGL_out[col * 4 + 3] = 0.0;
+    }
+    for (int row = 0; row < 3; row++) {
+        OpenGL_out[12 + row] = -(r[0][row] * t[0] + r[1][row] * t[1] + r[2][row] * t[2]);
+    }
+    OpenGL_out[15] = 1.0;
+    return true;
+}
+
+bool OSVR_Projection_to_OpenGL(double *OpenGL_out, const OSVR_ProjectionMatrix &projection_in) {
+    const double l = projection_in.left;
+    const double r = projection_in.right;
+    const double b = projection_in.bottom;
+    const double t = projection_in.top;
+    const double n = projection_in.nearClip;
+    const double f = projection_in.farClip;
+    if (r == l || t == b || f == n) {
+        return false;
+    }
+    for (int i = 0; i < OSVR_MATRIX_SIZE; i++) {
+        OpenGL_out[i] = 0.0;
+    }
+    OpenGL_out[0] = 2 * n / (r - l);
+    OpenGL_out[5] = 2 * n / (t - b);
+    OpenGL_out[8] = (r + l) / (r - l);
+    OpenGL_out[9] = (t + b) / (t - b);
+    OpenGL_out[10] = -(f + n) / (f - n);
+    OpenGL_out[11] = -1.0;
+    OpenGL_out[14] = -2 * f * n / (f - n);
+    return true;
+}
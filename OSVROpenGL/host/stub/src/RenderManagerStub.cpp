@@ -0,0 +1,390 @@
+/*
+ * Copyright (C) 2015 Sensics, Inc. and contributors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+#include <osvr/RenderKit/RenderManagerC.h>
+#include <osvr/RenderKit/RenderManagerOpenGLC.h>
+
+#include "StubInternal.h"
+
+namespace osvrstub {
+
+    static const size_t kEyeCount = 2;
+    static const double kEyeOffsetMeters = 0.0315;
+    // 90 degrees horizontal, ~101 degrees vertical per eye
+    static const double kTanHalfFovX = 1.0;
+    static const double kTanHalfFovY = 1.2185;
+
+    struct RenderManagerStub {
+        OSVR_ClientContext context;
+        OSVR_GraphicsLibraryOpenGL library;
+        int displayWidth;
+        int displayHeight;
+        GLuint program;
+        GLint textureUniform;
+    };
+
+    struct RenderInfoCollectionStub {
+        OSVR_RenderInfoOpenGL infos[kEyeCount];
+    };
+
+    struct PresentStateStub {
+        OSVR_RenderBufferOpenGL buffers[kEyeCount];
+        OSVR_ViewportDescription croppingViewports[kEyeCount];
+        size_t count;
+    };
+
+    struct RegisterBufferStateStub {
+        std::vector<OSVR_RenderBufferOpenGL> buffers;
+    };
+
+    static const char *kPresentVertexShader =
+            "attribute vec2 position;\n"
+            "attribute vec2 texCoord;\n"
+            "varying vec2 vTexCoord;\n"
+            "void main() {\n"
+            "    gl_Position = vec4(position, 0.0, 1.0);\n"
+            "    vTexCoord = texCoord;\n"
+            "}\n";
+
+    static const char *kPresentFragmentShader =
+            "precision mediump float;\n"
+            "uniform sampler2D uTexture;\n"
+            "varying vec2 vTexCoord;\n"
+            "void main() {\n"
+            "    gl_FragColor = texture2D(uTexture, vTexCoord);\n"
+            "}\n";
+
+    static GLuint compileShader(GLenum type, const char *source) {
+        GLuint shader = glCreateShader(type);
+        glShaderSource(shader, 1, &source, nullptr);
+        glCompileShader(shader);
+        GLint compiled = 0;
+        glGetShaderiv(shader, GL_COMPILE_STATUS, &compiled);
+        if (!compiled) {
+            glDeleteShader(shader);
+            return 0;
+        }
+        return shader;
+    }
+
+    static GLuint createPresentProgram() {
+        GLuint vertexShader = compileShader(GL_VERTEX_SHADER, kPresentVertexShader);
+        GLuint fragmentShader = compileShader(GL_FRAGMENT_SHADER, kPresentFragmentShader);
+        if (!vertexShader || !fragmentShader) {
+            return 0;
+        }
+        GLuint program = glCreateProgram();
+        glAttachShader(program, vertexShader);
+        glAttachShader(program, fragmentShader);
+        glBindAttribLocation(program, 0, "position");
+        glBindAttribLocation(program, 1, "texCoord");
+        glLinkProgram(program);
+        glDeleteShader(vertexShader);
+        glDeleteShader(fragmentShader);
+        GLint linked = 0;
+        glGetProgramiv(program, GL_LINK_STATUS, &linked);
+        if (!linked) {
+            glDeleteProgram(program);
+            return 0;
+        }
+        return program;
+    }
+
+    static void fillRenderInfo(const RenderManagerStub *rm, const OSVR_RenderParams &params, size_t eye,
+                               OSVR_RenderInfoOpenGL *infoOut) {
+        memset(infoOut, 0, sizeof(*infoOut));
+        infoOut->library = rm->library;
+
+        infoOut->viewport.left = 0;
+        infoOut->viewport.lower = 0;
+        infoOut->viewport.width = rm->displayWidth / 2;
+        infoOut->viewport.height = rm->displayHeight;
+
+        OSVR_TimeValue now;
+        osvrStubGetTime(&now);
+        osvrStubGetHeadPose(&now, &infoOut->pose);
+        if (params.roomFromHeadReplace) {
+            infoOut->pose = *params.roomFromHeadReplace;
+        }
+
+        // Offset the eye along the head's x axis.
+        const double *q = infoOut->pose.rotation.data;
+        double offset = eye == 0 ? -kEyeOffsetMeters : kEyeOffsetMeters;
+        infoOut->pose.translation.data[0] += offset * (1.0 - 2.0 * (q[2] * q[2] + q[3] * q[3]));
+        infoOut->pose.translation.data[1] += offset * (2.0 * (q[1] * q[2] + q[0] * q[3]));
+        infoOut->pose.translation.data[2] += offset * (2.0 * (q[1] * q[3] - q[0] * q[2]));
+
+        double nearClip = params.nearClipDistanceMeters;
+        infoOut->projection.nearClip = nearClip;
+        infoOut->projection.farClip = params.farClipDistanceMeters;
+        infoOut->projection.left = -kTanHalfFovX * nearClip;
+        infoOut->projection.right = kTanHalfFovX * nearClip;
+        infoOut->projection.bottom = -kTanHalfFovY * nearClip;
+        infoOut->projection.top = kTanHalfFovY * nearClip;
+    }
+}
+
+using namespace osvrstub;
+
+extern "C" {
+
+OSVR_ReturnCode osvrCreateRenderManagerOpenGL(OSVR_ClientContext clientContext,
+        const char graphicsLibraryName[], OSVR_GraphicsLibraryOpenGL graphicsLibrary,
+        OSVR_RenderManager *renderManagerOut, OSVR_RenderManagerOpenGL *renderManagerOpenGLOut) {
+    if (!clientContext || !graphicsLibrary.toolkit) {
+        return OSVR_RETURN_FAILURE;
+    }
+    LibraryScope scope;
+    RenderManagerStub *rm = new RenderManagerStub();
+    rm->context = clientContext;
+    rm->library = graphicsLibrary;
+    rm->displayWidth = config().displayWidth;
+    rm->displayHeight = config().displayHeight;
+    rm->program = 0;
+    rm->textureUniform = -1;
+    *renderManagerOut = rm;
+    *renderManagerOpenGLOut = rm;
+    return OSVR_RETURN_SUCCESS;
+}
+
+OSVR_ReturnCode osvrRenderManagerOpenDisplayOpenGL(OSVR_RenderManagerOpenGL renderManager,
+        OSVR_OpenResultsOpenGL *openResultsOut) {
+    RenderManagerStub *rm = static_cast<RenderManagerStub *>(renderManager);
+    if (!rm) {
+        return OSVR_RETURN_FAILURE;
+    }
+    LibraryScope scope;
+    memset(openResultsOut, 0, sizeof(*openResultsOut));
+    openResultsOut->library = rm->library;
+
+    const OSVR_OpenGLToolkitFunctions *toolkit = rm->library.toolkit;
+    OSVR_OpenGLContextParams params;
+    memset(&params, 0, sizeof(params));
+    params.windowTitle = "OSVR";
+    params.width = rm->displayWidth;
+    params.height = rm->displayHeight;
+    params.bitsPerPixel = 32;
+    params.numBuffers = 2;
+    params.visible = OSVR_TRUE;
+    if (!toolkit->addOpenGLContext(toolkit->data, &params) || !toolkit->makeCurrent(toolkit->data, 0)) {
+        openResultsOut->status = OSVR_OPEN_STATUS_FAILURE;
+        return OSVR_RETURN_FAILURE;
+    }
+
+    rm->program = createPresentProgram();
+    if (!rm->program) {
+        openResultsOut->status = OSVR_OPEN_STATUS_FAILURE;
+        return OSVR_RETURN_FAILURE;
+    }
+    rm->textureUniform = glGetUniformLocation(rm->program, "uTexture");
+    openResultsOut->status = OSVR_OPEN_STATUS_COMPLETE;
+    return OSVR_RETURN_SUCCESS;
+}
+
+OSVR_ReturnCode osvrDestroyRenderManager(OSVR_RenderManager renderManager) {
+    RenderManagerStub *rm = static_cast<RenderManagerStub *>(renderManager);
+    if (!rm) {
+        return OSVR_RETURN_FAILURE;
+    }
+    LibraryScope scope;
+    if (rm->program) {
+        glDeleteProgram(rm->program);
+    }
+    const OSVR_OpenGLToolkitFunctions *toolkit = rm->library.toolkit;
+    toolkit->removeOpenGLContexts(toolkit->data);
+    toolkit->destroy(toolkit->data);
+    delete rm;
+    return OSVR_RETURN_SUCCESS;
+}
+
+OSVR_ReturnCode osvrRenderManagerGetDefaultRenderParams(OSVR_RenderParams *renderParamsOut) {
+    renderParamsOut->worldFromRoomAppend = nullptr;
+    renderParamsOut->roomFromHeadReplace = nullptr;
+    renderParamsOut->nearClipDistanceMeters = 0.1;
+    renderParamsOut->farClipDistanceMeters = 100.0;
+    return OSVR_RETURN_SUCCESS;
+}
+
+OSVR_ReturnCode osvrRenderManagerGetRenderInfoCollection(OSVR_RenderManager renderManager,
+        OSVR_RenderParams renderParams, OSVR_RenderInfoCollection *renderInfoCollectionOut) {
+    RenderManagerStub *rm = static_cast<RenderManagerStub *>(renderManager);
+    if (!rm) {
+        return OSVR_RETURN_FAILURE;
+    }
+    LibraryScope scope;
+    RenderInfoCollectionStub *collection = new RenderInfoCollectionStub();
+    for (size_t eye = 0; eye < kEyeCount; eye++) {
+        fillRenderInfo(rm, renderParams, eye, &collection->infos[eye]);
+    }
+    *renderInfoCollectionOut = collection;
+    return OSVR_RETURN_SUCCESS;
+}
+
+OSVR_ReturnCode osvrRenderManagerReleaseRenderInfoCollection(OSVR_RenderInfoCollection renderInfoCollection) {
+    LibraryScope scope;
+    delete static_cast<RenderInfoCollectionStub *>(renderInfoCollection);
+    return OSVR_RETURN_SUCCESS;
+}
+
+OSVR_ReturnCode osvrRenderManagerGetNumRenderInfoInCollection(OSVR_RenderInfoCollection renderInfoCollection,
+        OSVR_RenderInfoCount *countOut) {
+    if (!renderInfoCollection) {
+        return OSVR_RETURN_FAILURE;
+    }
+    *countOut = kEyeCount;
+    return OSVR_RETURN_SUCCESS;
+}
+
+OSVR_ReturnCode osvrRenderManagerGetRenderInfoFromCollectionOpenGL(OSVR_RenderInfoCollection renderInfoCollection,
+        OSVR_RenderInfoCount index, OSVR_RenderInfoOpenGL *renderInfoOut) {
+    if (!renderInfoCollection || index >= kEyeCount) {
+        return OSVR_RETURN_FAILURE;
+    }
+    *renderInfoOut = static_cast<RenderInfoCollectionStub *>(renderInfoCollection)->infos[index];
+    return OSVR_RETURN_SUCCESS;
+}
+
+OSVR_ReturnCode osvrRenderManagerCreateColorBufferOpenGL(GLsizei width, GLsizei height, GLenum format,
+        GLuint *colorBufferNameOut) {
+    LibraryScope scope;
+    glGenTextures(1, colorBufferNameOut);
+    glBindTexture(GL_TEXTURE_2D, *colorBufferNameOut);
+    glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, nullptr);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    return OSVR_RETURN_SUCCESS;
+}
+
+OSVR_ReturnCode osvrRenderManagerCreateDepthBufferOpenGL(GLsizei width, GLsizei height, GLuint *depthBufferNameOut) {
+    LibraryScope scope;
+    glGenRenderbuffers(1, depthBufferNameOut);
+    glBindRenderbuffer(GL_RENDERBUFFER, *depthBufferNameOut);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT16, width, height);
+    return OSVR_RETURN_SUCCESS;
+}
+
+OSVR_ReturnCode osvrRenderManagerStartRegisterRenderBuffers(OSVR_RenderManagerRegisterBufferState *registerBufferStateOut) {
+    LibraryScope scope;
+    *registerBufferStateOut = new RegisterBufferStateStub();
+    return OSVR_RETURN_SUCCESS;
+}
+
+OSVR_ReturnCode osvrRenderManagerRegisterRenderBufferOpenGL(OSVR_RenderManagerRegisterBufferState registerBufferState,
+        OSVR_RenderBufferOpenGL renderBuffer) {
+    if (!registerBufferState) {
+        return OSVR_RETURN_FAILURE;
+    }
+    LibraryScope scope;
+    static_cast<RegisterBufferStateStub *>(registerBufferState)->buffers.push_back(renderBuffer);
+    return OSVR_RETURN_SUCCESS;
+}
+
+OSVR_ReturnCode osvrRenderManagerFinishRegisterRenderBuffers(OSVR_RenderManager renderManager,
+        OSVR_RenderManagerRegisterBufferState registerBufferState, OSVR_CBool appWillNotOverwriteBeforeNewPresent) {
+    if (!renderManager || !registerBufferState) {
+        return OSVR_RETURN_FAILURE;
+    }
+    LibraryScope scope;
+    delete static_cast<RegisterBufferStateStub *>(registerBufferState);
+    return OSVR_RETURN_SUCCESS;
+}
+
+OSVR_ReturnCode osvrRenderManagerStartPresentRenderBuffers(OSVR_RenderManagerPresentState *presentStateOut) {
+    LibraryScope scope;
+    PresentStateStub *state = new PresentStateStub();
+    state->count = 0;
+    *presentStateOut = state;
+    return OSVR_RETURN_SUCCESS;
+}
+
+OSVR_ReturnCode osvrRenderManagerPresentRenderBufferOpenGL(OSVR_RenderManagerPresentState presentState,
+        OSVR_RenderBufferOpenGL buffer, OSVR_RenderInfoOpenGL renderInfoUsed,
+        OSVR_ViewportDescription normalizedCroppingViewport) {
+    PresentStateStub *state = static_cast<PresentStateStub *>(presentState);
+    if (!state || state->count >= kEyeCount) {
+        return OSVR_RETURN_FAILURE;
+    }
+    state->buffers[state->count] = buffer;
+    state->croppingViewports[state->count] = normalizedCroppingViewport;
+    state->count++;
+    return OSVR_RETURN_SUCCESS;
+}
+
+// Draws each presented buffer into its half of the display, side by side.
+OSVR_ReturnCode osvrRenderManagerFinishPresentRenderBuffers(OSVR_RenderManager renderManager,
+        OSVR_RenderManagerPresentState presentState, OSVR_RenderParams renderParams, OSVR_CBool shouldFlipY) {
+    RenderManagerStub *rm = static_cast<RenderManagerStub *>(renderManager);
+    PresentStateStub *state = static_cast<PresentStateStub *>(presentState);
+    if (!rm || !state) {
+        return OSVR_RETURN_FAILURE;
+    }
+    LibraryScope scope;
+    const OSVR_OpenGLToolkitFunctions *toolkit = rm->library.toolkit;
+    GLuint displayFrameBuffer = 0;
+    toolkit->getDisplayFrameBuffer(toolkit->data, 0, &displayFrameBuffer);
+
+    // Leave the app's depth test setting as it was.
+    GLboolean depthTest = glIsEnabled(GL_DEPTH_TEST);
+    glBindFramebuffer(GL_FRAMEBUFFER, displayFrameBuffer);
+    glViewport(0, 0, rm->displayWidth, rm->displayHeight);
+    glDisable(GL_DEPTH_TEST);
+    glUseProgram(rm->program);
+    glUniform1i(rm->textureUniform, 0);
+    glActiveTexture(GL_TEXTURE0);
+    glEnableVertexAttribArray(0);
+    glEnableVertexAttribArray(1);
+
+    for (size_t i = 0; i < state->count; i++) {
+        float x0 = -1.0f + i * (2.0f / kEyeCount);
+        float x1 = x0 + 2.0f / kEyeCount;
+        const OSVR_ViewportDescription &crop = state->croppingViewports[i];
+        float u0 = static_cast<float>(crop.left);
+        float u1 = static_cast<float>(crop.left + crop.width);
+        float v0 = static_cast<float>(crop.lower);
+        float v1 = static_cast<float>(crop.lower + crop.height);
+        if (shouldFlipY) {
+            float v = v0;
+            v0 = v1;
+            v1 = v;
+        }
+        const GLfloat positions[] = { x0, -1.0f, x1, -1.0f, x0, 1.0f, x1, 1.0f };
+        const GLfloat texCoords[] = { u0, v0, u1, v0, u0, v1, u1, v1 };
+        glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 0, positions);
+        glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 0, texCoords);
+        glBindTexture(GL_TEXTURE_2D, state->buffers[i].colorBufferName);
+        glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+    }
+
+    glDisableVertexAttribArray(0);
+    glDisableVertexAttribArray(1);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    if (depthTest) {
+        glEnable(GL_DEPTH_TEST);
+    }
+
+    toolkit->swapBuffers(toolkit->data, 0);
+    delete state;
+    return OSVR_RETURN_SUCCESS;
+}
+
+}
@@ -0,0 +1,61 @@
+/*
+ * Copyright (C) 2015 Sensics, Inc. and contributors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef OSVR_HOST_STUB_STUBINTERNAL_H
+#define OSVR_HOST_STUB_STUBINTERNAL_H
+
+#include <OSVRStub.h>
+
+namespace osvrstub {
+
+    // Brackets code that runs "inside OSVR", see osvrHostEnterLibrary.
+    class LibraryScope {
+    public:
+        LibraryScope() {
+            if (osvrHostEnterLibrary) {
+                osvrHostEnterLibrary();
+            }
+        }
+        ~LibraryScope() {
+            if (osvrHostLeaveLibrary) {
+                osvrHostLeaveLibrary();
+            }
+        }
+    };
+
+    // Temporarily steps back out of a LibraryScope, around calls into the app.
+    class AppScope {
+    public:
+        AppScope() {
+            if (osvrHostLeaveLibrary) {
+                osvrHostLeaveLibrary();
+            }
+        }
+        ~AppScope() {
+            if (osvrHostEnterLibrary) {
+                osvrHostEnterLibrary();
+            }
+        }
+    };
+
+    const OSVRStubConfig &config();
+
+    // Advances the synthetic clock by one update.
+    void advanceTime();
+}
+
+#endif // OSVR_HOST_STUB_STUBINTERNAL_H
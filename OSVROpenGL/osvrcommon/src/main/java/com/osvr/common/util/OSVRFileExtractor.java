@@ -68,7 +68,10 @@ public class OSVRFileExtractor {
         }
     }
 
-    private static String getAppRoot(ContextWrapper context) {
+    /**
+     * @return the directory the osvr files are extracted to
+     */
+    public static String getAppRoot(ContextWrapper context) {
         return "/sdcard/osvr";
         //return context.getFilesDir().getAbsolutePath();
         //return "/data/data/" + context.getPackageName() + "/files";